@@ -0,0 +1,3213 @@
+//benchmarks for the portable (GPU-less) code paths
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common.h"
+#include "Models.h"
+#include "Timer.h"
+#include "CpuCompute.h"
+#include "Math3D.h"
+#include "SoaTransform.h"
+#include "SoaAnimation.h"
+#include "MeshOptimize.h"
+#include "MeshPack.h"
+#include "CpuFence.h"
+#include "UploadRing.h"
+#include "ReadbackArena.h"
+#include "ResultSink.h"
+#include "HeapAllocator.h"
+#include "ResidencyManager.h"
+#include "CpuQueue.h"
+#include "FenceTimeline.h"
+#include "ResourceStateTracker.h"
+#include "SubmissionBatcher.h"
+#include "CommandAllocatorPool.h"
+#include "TraceEvents.h"
+#include "StreamPipeline.h"
+#include "Scan.h"
+#include "RadixSort.h"
+#include "Culling.h"
+#include "Bvh.h"
+#include "RayQuery.h"
+
+#include <thread>
+#include <deque>
+#include <algorithm>
+
+#define BENCH_NUM_GROUPS (1u << 20)
+#define BENCH_REPEATS 5
+
+//cost of each group is the index count of the mesh it would process, stored in t0
+inline
+void UnevenMeshKernel( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 *pIndexCounts = (const u32*)pRoot->pVerticesAndIndices;
+	u32 dwHash = Gid.x;
+	for( u32 dwIdx = 0; dwIdx < pIndexCounts[Gid.x]; ++dwIdx )
+	{
+		dwHash = dwHash * 1664525u + 1013904223u;
+	}
+	pRoot->pOut[Gid.x].dwData[0] = dwHash;
+}
+
+//the first 1/16th of the grid are large meshes, which is the worst case for a static split
+void InitUnevenIndexCounts( u32 *pIndexCounts, u32 dwNumGroups )
+{
+	u32 dwState = 1;
+	for( u32 dwIdx = 0; dwIdx < dwNumGroups; ++dwIdx )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		pIndexCounts[dwIdx] = dwIdx < dwNumGroups / 16 ? 512 + ( dwState >> 23 ) : 6 + ( dwState >> 28 );
+	}
+}
+
+f64 TimeDispatch( CpuComputeDevice *pDevice, CpuComputeKernel *pKernel, CpuComputeRootArgs *pRoot, u32 dwNumGroups )
+{
+	f64 fBestMs = 1e30;
+	for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+	{
+		u64 qwStart = GetTimeNs();
+		CpuDispatch( pDevice, pKernel, pRoot, dwNumGroups, 1, 1 );
+		f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+		fBestMs = fMs < fBestMs ? fMs : fBestMs;
+	}
+	return fBestMs;
+}
+
+void BenchWorkStealingScaling()
+{
+	u32 *pIndexCounts = (u32*)malloc( BENCH_NUM_GROUPS * sizeof(u32) );
+	ModelOutData *pStaticOut = (ModelOutData*)malloc( BENCH_NUM_GROUPS * sizeof(ModelOutData) );
+	ModelOutData *pStealOut = (ModelOutData*)malloc( BENCH_NUM_GROUPS * sizeof(ModelOutData) );
+	InitUnevenIndexCounts( pIndexCounts, BENCH_NUM_GROUPS );
+
+	CpuComputeKernel kernel;
+	memset( &kernel, 0, sizeof(CpuComputeKernel) );
+	kernel.pfnGroup = UnevenMeshKernel;
+	kernel.dwNumThreads[0] = 1;
+	kernel.dwNumThreads[1] = 1;
+	kernel.dwNumThreads[2] = 1;
+
+	CpuComputeRootArgs root;
+	memset( &root, 0, sizeof(CpuComputeRootArgs) );
+	root.pVerticesAndIndices = (const u8*)pIndexCounts;
+	root.qwVerticesAndIndicesSize = BENCH_NUM_GROUPS * sizeof(u32);
+	root.qwOutCount = BENCH_NUM_GROUPS;
+
+	printf( "work stealing scaling, %u groups with uneven cost\n", BENCH_NUM_GROUPS );
+	printf( "%8s %12s %12s %10s %10s\n", "workers", "static ms", "steal ms", "steal x", "speedup" );
+	const u32 dwNumCores = CpuComputeNumCores();
+	f64 fSingleWorkerMs = 0;
+	for( u32 dwWorkers = 1; ; dwWorkers = dwWorkers*2 < dwNumCores ? dwWorkers*2 : dwNumCores )
+	{
+		CpuComputeDevice *pDevice = new CpuComputeDevice;
+		if( !InitCpuComputeDevice( pDevice, dwWorkers ) )
+		{
+			printf( "Failed to create cpu compute device!\n" );
+			delete pDevice;
+			break;
+		}
+
+		pDevice->eSchedule = CPU_COMPUTE_SCHEDULE_STATIC;
+		root.pOut = pStaticOut;
+		f64 fStaticMs = TimeDispatch( pDevice, &kernel, &root, BENCH_NUM_GROUPS );
+
+		pDevice->eSchedule = CPU_COMPUTE_SCHEDULE_WORK_STEALING;
+		root.pOut = pStealOut;
+		f64 fStealMs = TimeDispatch( pDevice, &kernel, &root, BENCH_NUM_GROUPS );
+		if( dwWorkers == 1 )
+		{
+			fSingleWorkerMs = fStealMs;
+		}
+
+		if( memcmp( pStaticOut, pStealOut, BENCH_NUM_GROUPS * sizeof(ModelOutData) ) != 0 )
+		{
+			printf( "static and work stealing outputs differ!\n" );
+		}
+		printf( "%8u %12.3f %12.3f %10.2f %10.2f\n", dwWorkers, fStaticMs, fStealMs, fStaticMs / fStealMs, fSingleWorkerMs / fStealMs );
+
+		DestroyCpuComputeDevice( pDevice );
+		delete pDevice;
+		if( dwWorkers == dwNumCores )
+		{
+			break;
+		}
+	}
+
+	free( pIndexCounts );
+	free( pStaticOut );
+	free( pStealOut );
+}
+
+#define BENCH_NUM_VERTICES (1u << 18)
+
+f32 BenchRandomFloat( u32 *pState )
+{
+	*pState = *pState * 1664525u + 1013904223u;
+	return ( *pState >> 8 ) * ( 2.0f / 16777216.0f ) - 1.0f;
+}
+
+void PrintTransformResult( const char *pName, u64 qwNs, f64 fBaselineNs )
+{
+	printf( "%-34s %10.3f ms %10.1f Mverts/s %8.2fx\n", pName, qwNs / 1e6, BENCH_NUM_VERTICES / ( qwNs / 1e3 ), fBaselineNs / qwNs );
+}
+
+void BenchSoaTransform()
+{
+	const u32 dwFloatsPerVertex = MODEL_VERTEX_STRIDE / sizeof(f32);
+	f32 *pInterleaved = (f32*)malloc( (u64)BENCH_NUM_VERTICES * MODEL_VERTEX_STRIDE );
+	f32 *pInterleavedOut = (f32*)malloc( (u64)BENCH_NUM_VERTICES * MODEL_VERTEX_STRIDE );
+	u32 dwState = 7;
+	for( u32 dwIdx = 0; dwIdx < BENCH_NUM_VERTICES * dwFloatsPerVertex; ++dwIdx )
+	{
+		pInterleaved[dwIdx] = BenchRandomFloat( &dwState );
+	}
+
+	Vec3f vAxis = { { { 0.f, 0.6f, 0.8f } } };
+	Vec3f vPos = { { { 1.f, 2.f, 3.f } } };
+	Quatf qRot;
+	InitUnitQuatf( &qRot, 30.f, &vAxis );
+	Mat4f model;
+	InitModelMat4ByQuatf( &model, &qRot, &vPos );
+	Mat3x4f normalMat;
+	InverseTransposeUpper3x3Mat4f( &model, &normalMat );
+
+	printf( "\nSoA transform, %u vertices (40 byte interleaved)\n", BENCH_NUM_VERTICES );
+
+	//baseline: a Mat4fMult per element, the vertex is row 0 of a matrix
+	u64 qwStart = GetTimeNs();
+	for( u32 dwIdx = 0; dwIdx < BENCH_NUM_VERTICES; ++dwIdx )
+	{
+		f32 *pVertex = pInterleaved + (u64)dwIdx * dwFloatsPerVertex;
+		f32 *pOut = pInterleavedOut + (u64)dwIdx * dwFloatsPerVertex;
+		Mat4f rows = {};
+		Mat4f result;
+		rows.m[0][0] = pVertex[0]; rows.m[0][1] = pVertex[1]; rows.m[0][2] = pVertex[2]; rows.m[0][3] = 1.f;
+		rows.m[1][0] = pVertex[3]; rows.m[1][1] = pVertex[4]; rows.m[1][2] = pVertex[5];
+		Mat4fMult( &rows, &model, &result );
+		pOut[0] = result.m[0][0]; pOut[1] = result.m[0][1]; pOut[2] = result.m[0][2];
+		Vec3f vNrm = { { { pVertex[3], pVertex[4], pVertex[5] } } };
+		Vec3f vOutNrm;
+		Vec3fTransformDirMat3x4f( &vNrm, &normalMat, &vOutNrm );
+		Vec3fNormalize( &vOutNrm, (Vec3f*)( pOut + 3 ) );
+	}
+	u64 qwMat4fMultNs = GetTimeNs() - qwStart;
+	PrintTransformResult( "Mat4fMult per element", qwMat4fMultNs, (f64)qwMat4fMultNs );
+
+	//baseline: rotation only through Vec3fRotByUnitQuat
+	qwStart = GetTimeNs();
+	for( u32 dwIdx = 0; dwIdx < BENCH_NUM_VERTICES; ++dwIdx )
+	{
+		Vec3f *pVertex = (Vec3f*)( pInterleaved + (u64)dwIdx * dwFloatsPerVertex );
+		Vec3f *pOut = (Vec3f*)( pInterleavedOut + (u64)dwIdx * dwFloatsPerVertex );
+		Vec3fRotByUnitQuat( &pVertex[0], &qRot, &pOut[0] );
+		Vec3fAdd( &pOut[0], &vPos, &pOut[0] );
+		Vec3fRotByUnitQuat( &pVertex[1], &qRot, &pOut[1] );
+	}
+	PrintTransformResult( "Vec3fRotByUnitQuat per element", GetTimeNs() - qwStart, (f64)qwMat4fMultNs );
+
+	VertexStreamsSoA streams;
+	VertexStreamsSoA scalarOut;
+	VertexStreamsSoA simdOut;
+	AllocVertexStreamsSoA( &streams, BENCH_NUM_VERTICES );
+	AllocVertexStreamsSoA( &scalarOut, BENCH_NUM_VERTICES );
+	AllocVertexStreamsSoA( &simdOut, BENCH_NUM_VERTICES );
+
+	qwStart = GetTimeNs();
+	DeinterleaveVertices( pInterleaved, BENCH_NUM_VERTICES, &streams );
+	PrintTransformResult( "deinterleave to SoA", GetTimeNs() - qwStart, (f64)qwMat4fMultNs );
+
+	qwStart = GetTimeNs();
+	TransformVertexStreamsScalar( &streams, &model, true, &scalarOut );
+	PrintTransformResult( "SoA scalar", GetTimeNs() - qwStart, (f64)qwMat4fMultNs );
+
+	qwStart = GetTimeNs();
+	TransformVertexStreams( &streams, &model, true, &simdOut );
+	PrintTransformResult( "SoA AVX2", GetTimeNs() - qwStart, (f64)qwMat4fMultNs );
+
+	f32 fMaxError = 0.f;
+	for( u32 dwStream = 0; dwStream < 6; ++dwStream )
+	{
+		for( u32 dwIdx = 0; dwIdx < BENCH_NUM_VERTICES; ++dwIdx )
+		{
+			f32 fError = fabsf( scalarOut.pStreams[dwStream][dwIdx] - simdOut.pStreams[dwStream][dwIdx] );
+			fMaxError = fError > fMaxError ? fError : fMaxError;
+		}
+	}
+	printf( "max abs difference AVX2 vs scalar: %g\n", fMaxError );
+
+	FreeVertexStreamsSoA( &streams );
+	FreeVertexStreamsSoA( &scalarOut );
+	FreeVertexStreamsSoA( &simdOut );
+	free( pInterleaved );
+	free( pInterleavedOut );
+}
+
+#define BENCH_ANIM_INSTANCES 200003 //not a multiple of 8 so the tail block is covered
+#define BENCH_ANIM_KEYS 32
+
+f32 BenchMaxMat4fError( const Mat4f *pLeft, const Mat4f *pRight, u32 dwCount )
+{
+	f32 fMaxError = 0.f;
+	for( u32 dwIdx = 0; dwIdx < dwCount * 16; ++dwIdx )
+	{
+		f32 fError = fabsf( ( &pLeft[0].m[0][0] )[dwIdx] - ( &pRight[0].m[0][0] )[dwIdx] );
+		fMaxError = fError > fMaxError ? fError : fMaxError;
+	}
+	return fMaxError;
+}
+
+//every instance spins around its own axis, fDegreesPerKey sets the key to key angle, every third key is stored as -q
+void BenchFillAnimationKeys( AnimationStreamsSoA *pStreams, f32 fDegreesPerKey )
+{
+	u32 dwState = 11;
+	for( u32 dwIdx = 0; dwIdx < pStreams->dwCount; ++dwIdx )
+	{
+		Vec3f vAxis = { { { BenchRandomFloat( &dwState ), BenchRandomFloat( &dwState ), BenchRandomFloat( &dwState ) + 2.f } } };
+		Vec3fNormalize( &vAxis, &vAxis );
+		const f32 fStart = BenchRandomFloat( &dwState ) * 180.f;
+		const f32 fStep = fDegreesPerKey * ( 0.5f + 0.5f * BenchRandomFloat( &dwState ) );
+		Vec3f vOrigin = { { { BenchRandomFloat( &dwState ) * 100.f, BenchRandomFloat( &dwState ) * 100.f, BenchRandomFloat( &dwState ) * 100.f } } };
+		for( u32 dwKey = 0; dwKey < pStreams->dwKeyCount; ++dwKey )
+		{
+			Quatf qRot;
+			InitUnitQuatf( &qRot, fStart + fStep * dwKey, &vAxis );
+			if( dwKey % 3 == 2 )
+			{
+				qRot.w = -qRot.w;
+				qRot.x = -qRot.x;
+				qRot.y = -qRot.y;
+				qRot.z = -qRot.z;
+			}
+			Vec3f vPos = { { { vOrigin.x + dwKey * 0.1f, vOrigin.y, vOrigin.z - dwKey * 0.05f } } };
+			SetAnimationKey( pStreams, dwIdx, dwKey, &qRot, &vPos );
+		}
+	}
+}
+
+void PrintAnimationResult( const char *pName, u64 qwNs, f64 fBaselineNs, f32 fMaxError )
+{
+	printf( "%-34s %10.3f ms %10.1f Minst/s %8.2fx %12g\n", pName, qwNs / 1e6, BENCH_ANIM_INSTANCES / ( qwNs / 1e3 ), fBaselineNs / qwNs, fMaxError );
+}
+
+u64 BenchTimeAnimation( const AnimationStreamsSoA *pStreams, const f32 *pKeyTimes, u32 dwMode, bool bScalar, Mat4f *pOut )
+{
+	u64 qwBest = ~0ull;
+	for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+	{
+		const u64 qwStart = GetTimeNs();
+		if( bScalar )
+		{
+			SampleAnimationStreamsScalar( pStreams, 0, pStreams->dwCount, pKeyTimes, 7.3f, dwMode, pOut );
+		}
+		else
+		{
+			SampleAnimationStreams( pStreams, 0, pStreams->dwCount, pKeyTimes, 7.3f, dwMode, pOut );
+		}
+		const u64 qwNs = GetTimeNs() - qwStart;
+		qwBest = qwNs < qwBest ? qwNs : qwBest;
+	}
+	return qwBest;
+}
+
+void BenchSoaAnimation()
+{
+	AnimationStreamsSoA streams;
+	f32 *pKeyTimes = (f32*)malloc( BENCH_ANIM_INSTANCES * sizeof(f32) );
+	u8 *pScalarAllocation = (u8*)malloc( BENCH_ANIM_INSTANCES * sizeof(Mat4f) + ANIM_STREAM_ALIGNMENT );
+	u8 *pSimdAllocation = (u8*)malloc( BENCH_ANIM_INSTANCES * sizeof(Mat4f) + ANIM_STREAM_ALIGNMENT );
+	if( !pKeyTimes || !pScalarAllocation || !pSimdAllocation || !AllocAnimationStreamsSoA( &streams, BENCH_ANIM_INSTANCES, BENCH_ANIM_KEYS ) )
+	{
+		printf( "animation sampling out of memory\n" );
+		free( pKeyTimes );
+		free( pScalarAllocation );
+		free( pSimdAllocation );
+		return;
+	}
+	//aligned so SampleAnimationStreams() streams the matrices out
+	Mat4f *pScalarOut = (Mat4f*)( ( (uintptr_t)pScalarAllocation + ANIM_STREAM_ALIGNMENT - 1 ) & ~(uintptr_t)( ANIM_STREAM_ALIGNMENT - 1 ) );
+	Mat4f *pSimdOut = (Mat4f*)( ( (uintptr_t)pSimdAllocation + ANIM_STREAM_ALIGNMENT - 1 ) & ~(uintptr_t)( ANIM_STREAM_ALIGNMENT - 1 ) );
+	streams.dwCount = BENCH_ANIM_INSTANCES;
+	u32 dwState = 5;
+	for( u32 dwIdx = 0; dwIdx < BENCH_ANIM_INSTANCES; ++dwIdx )
+	{
+		pKeyTimes[dwIdx] = ( BenchRandomFloat( &dwState ) + 1.f ) * BENCH_ANIM_KEYS * 2.f; //wraps the track up to 4 times
+	}
+
+	printf( "\nanimation sampling to Mat4f, %u instances, %u keys (max error vs scalar)\n", BENCH_ANIM_INSTANCES, BENCH_ANIM_KEYS );
+	const f32 stepDegrees[] = { 1.f, 40.f }; //within QUATF_NLERP_MIN_COS (nlerp fast path) and far outside it
+	for( u32 dwSteps = 0; dwSteps < sizeof(stepDegrees) / sizeof(stepDegrees[0]); ++dwSteps )
+	{
+		BenchFillAnimationKeys( &streams, stepDegrees[dwSteps] );
+		printf( "up to %.0f degrees per key\n", stepDegrees[dwSteps] );
+		for( u32 dwMode = ANIM_SAMPLE_NLERP; dwMode <= ANIM_SAMPLE_SLERP; ++dwMode )
+		{
+			const char *pMode = dwMode == ANIM_SAMPLE_SLERP ? "slerp" : "nlerp";
+			char name[64];
+			const u64 qwScalarNs = BenchTimeAnimation( &streams, NULL, dwMode, true, pScalarOut );
+			snprintf( name, sizeof(name), "%s scalar, shared time", pMode );
+			PrintAnimationResult( name, qwScalarNs, (f64)qwScalarNs, 0.f );
+			u64 qwNs = BenchTimeAnimation( &streams, NULL, dwMode, false, pSimdOut );
+			snprintf( name, sizeof(name), "%s AVX2, shared time", pMode );
+			PrintAnimationResult( name, qwNs, (f64)qwScalarNs, BenchMaxMat4fError( pScalarOut, pSimdOut, BENCH_ANIM_INSTANCES ) );
+
+			const u64 qwScalarGatherNs = BenchTimeAnimation( &streams, pKeyTimes, dwMode, true, pScalarOut );
+			snprintf( name, sizeof(name), "%s scalar, time per instance", pMode );
+			PrintAnimationResult( name, qwScalarGatherNs, (f64)qwScalarGatherNs, 0.f );
+			qwNs = BenchTimeAnimation( &streams, pKeyTimes, dwMode, false, pSimdOut );
+			snprintf( name, sizeof(name), "%s AVX2, time per instance", pMode );
+			PrintAnimationResult( name, qwNs, (f64)qwScalarGatherNs, BenchMaxMat4fError( pScalarOut, pSimdOut, BENCH_ANIM_INSTANCES ) );
+		}
+		//how far nlerp drifts from slerp at this key spacing
+		SampleAnimationStreamsScalar( &streams, 0, BENCH_ANIM_INSTANCES, pKeyTimes, 0.f, ANIM_SAMPLE_NLERP, pScalarOut );
+		SampleAnimationStreamsScalar( &streams, 0, BENCH_ANIM_INSTANCES, pKeyTimes, 0.f, ANIM_SAMPLE_SLERP, pSimdOut );
+		printf( "%-34s %12g\n", "max difference nlerp vs slerp", BenchMaxMat4fError( pScalarOut, pSimdOut, BENCH_ANIM_INSTANCES ) );
+	}
+
+	FreeAnimationStreamsSoA( &streams );
+	free( pKeyTimes );
+	free( pScalarAllocation );
+	free( pSimdAllocation );
+}
+
+#define BENCH_GRID_SIZE 256
+
+//unwelded grid (every triangle has its own 3 vertices) with shuffled triangles, close to what an exporter without an optimizer produces
+void BenchMeshOptimize()
+{
+	const u32 dwTriangleCount = BENCH_GRID_SIZE * BENCH_GRID_SIZE * 2;
+	const u32 dwFloatsPerVertex = MODEL_VERTEX_STRIDE / sizeof(f32);
+	f32 *pVertices = (f32*)malloc( (u64)dwTriangleCount * 3 * MODEL_VERTEX_STRIDE );
+	u32 *pIndices = (u32*)malloc( (u64)dwTriangleCount * 3 * sizeof(u32) );
+	u32 *pOrder = (u32*)malloc( (u64)dwTriangleCount * sizeof(u32) );
+	u32 dwState = 3;
+	for( u32 dwTriangle = 0; dwTriangle < dwTriangleCount; ++dwTriangle )
+	{
+		pOrder[dwTriangle] = dwTriangle;
+	}
+	for( u32 dwTriangle = dwTriangleCount - 1; dwTriangle > 0; --dwTriangle )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		u32 dwSwap = dwState % ( dwTriangle + 1 );
+		u32 dwTmp = pOrder[dwTriangle]; pOrder[dwTriangle] = pOrder[dwSwap]; pOrder[dwSwap] = dwTmp;
+	}
+	for( u32 dwIdx = 0; dwIdx < dwTriangleCount; ++dwIdx )
+	{
+		u32 dwTriangle = pOrder[dwIdx];
+		u32 dwQuad = dwTriangle / 2;
+		u32 dwX = dwQuad % BENCH_GRID_SIZE;
+		u32 dwZ = dwQuad / BENCH_GRID_SIZE;
+		static const u32 quadCorners[2][3][2] = { { {0,0}, {1,0}, {0,1} }, { {1,0}, {1,1}, {0,1} } };
+		for( u32 dwCorner = 0; dwCorner < 3; ++dwCorner )
+		{
+			f32 *pVertex = pVertices + ( (u64)dwIdx * 3 + dwCorner ) * dwFloatsPerVertex;
+			pVertex[0] = (f32)( dwX + quadCorners[dwTriangle & 1][dwCorner][0] );
+			pVertex[1] = 0.f;
+			pVertex[2] = (f32)( dwZ + quadCorners[dwTriangle & 1][dwCorner][1] );
+			pVertex[3] = 0.f; pVertex[4] = 1.f; pVertex[5] = 0.f;
+			pVertex[6] = 0.5882f; pVertex[7] = 0.2941f; pVertex[8] = 0.f; pVertex[9] = 1.f;
+			pIndices[dwIdx * 3 + dwCorner] = dwIdx * 3 + dwCorner;
+		}
+	}
+
+	MeshData optimized;
+	MeshOptimizeStats stats;
+	u64 qwStart = GetTimeNs();
+	bool bOptimized = OptimizeMesh( (const u8*)pVertices, dwTriangleCount * 3, MODEL_VERTEX_STRIDE, pIndices, dwTriangleCount * 3, &optimized, &stats );
+	u64 qwNs = GetTimeNs() - qwStart;
+	printf( "\nmesh optimize, %u triangle unwelded shuffled grid\n", dwTriangleCount );
+	if( bOptimized )
+	{
+		PrintMeshOptimizeStats( "grid", &stats );
+		printf( "%.3f ms, %.1f Mtris/s\n", qwNs / 1e6, dwTriangleCount / ( qwNs / 1e3 ) );
+		FreeMeshData( &optimized );
+	}
+	free( pVertices );
+	free( pIndices );
+	free( pOrder );
+}
+
+#define BENCH_UPLOAD_RING_SIZE (1u << 20)
+#define BENCH_NUM_UPLOADS (1u << 17)
+#define BENCH_UPLOADS_PER_SUBMIT 8
+
+typedef struct BenchCopy
+{
+	u64 qwOffset;
+	u64 qwSize;
+	u32 dwSeed;
+} BenchCopy;
+
+typedef struct BenchCopySubmit
+{
+	BenchCopy copies[BENCH_UPLOADS_PER_SUBMIT];
+	u32 dwCopyCount;
+	u64 qwFenceValue;
+} BenchCopySubmit;
+
+//stand in for the streaming queue, copies out of the ring and checks the data the producer wrote, then signals the fence
+typedef struct BenchCopyQueue
+{
+	std::deque<BenchCopySubmit> submits;
+	std::mutex lock;
+	std::condition_variable submitCondition;
+	CpuFence fence;
+	const u8 *pRing;
+	u8 *pDestination;
+	u64 qwMismatches;
+} BenchCopyQueue;
+
+void BenchCopyQueueMain( BenchCopyQueue *pQueue )
+{
+	for( ;; )
+	{
+		BenchCopySubmit submit;
+		{
+			std::unique_lock<std::mutex> guard( pQueue->lock );
+			pQueue->submitCondition.wait( guard, [&]{ return !pQueue->submits.empty(); } );
+			submit = pQueue->submits.front();
+			pQueue->submits.pop_front();
+		}
+		if( submit.dwCopyCount == 0 )
+		{
+			return;
+		}
+		for( u32 dwCopy = 0; dwCopy < submit.dwCopyCount; ++dwCopy )
+		{
+			const BenchCopy *pCopy = &submit.copies[dwCopy];
+			memcpy( pQueue->pDestination, pQueue->pRing + pCopy->qwOffset, pCopy->qwSize );
+			const u32 *pWords = (const u32*)pQueue->pDestination;
+			for( u64 qwWord = 0; qwWord < pCopy->qwSize / sizeof(u32); ++qwWord )
+			{
+				pQueue->qwMismatches += pWords[qwWord] != pCopy->dwSeed + (u32)qwWord;
+			}
+		}
+		CpuFenceSignal( &pQueue->fence, submit.qwFenceValue );
+	}
+}
+
+void BenchCopyQueueSubmit( BenchCopyQueue *pQueue, const BenchCopySubmit *pSubmit )
+{
+	{
+		std::lock_guard<std::mutex> guard( pQueue->lock );
+		pQueue->submits.push_back( *pSubmit );
+	}
+	pQueue->submitCondition.notify_one();
+}
+
+//streams far more data than the ring holds through a mock copy queue, any reuse of memory that is still being read shows up as a mismatch
+void BenchUploadRing()
+{
+	const u32 dwMaxUploadSize = 64 * 1024;
+	u8 *pRingMemory = (u8*)malloc( BENCH_UPLOAD_RING_SIZE );
+	BenchCopyQueue *pQueue = new BenchCopyQueue;
+	InitCpuFence( &pQueue->fence, 0 );
+	pQueue->pRing = pRingMemory;
+	pQueue->pDestination = (u8*)malloc( dwMaxUploadSize );
+	pQueue->qwMismatches = 0;
+	std::thread copyThread( BenchCopyQueueMain, pQueue );
+
+	UploadRing ring;
+	InitUploadRing( &ring, pRingMemory, BENCH_UPLOAD_RING_SIZE );
+	BenchCopySubmit submit;
+	submit.dwCopyCount = 0;
+	u64 qwFenceValue = 0;
+	u64 qwBytes = 0;
+	u32 dwStalls = 0;
+	u32 dwState = 7;
+	u64 qwStart = GetTimeNs();
+	for( u32 dwUpload = 0; dwUpload < BENCH_NUM_UPLOADS; ++dwUpload )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		const u64 qwSize = ( 64 + ( dwState >> 8 ) % ( dwMaxUploadSize - 64 ) ) & ~3ull;
+		UploadRingAllocation allocation;
+		UploadRingRetire( &ring, CpuFenceGetCompletedValue( &pQueue->fence ) );
+		while( !UploadRingAlloc( &ring, qwSize, UPLOAD_RING_ALIGNMENT, &allocation ) )
+		{
+			++dwStalls;
+			CpuFenceWait( &pQueue->fence, UploadRingOldestFenceValue( &ring ) );
+			UploadRingRetire( &ring, CpuFenceGetCompletedValue( &pQueue->fence ) );
+		}
+		u32 *pWords = (u32*)allocation.pCpuAddress;
+		for( u64 qwWord = 0; qwWord < qwSize / sizeof(u32); ++qwWord )
+		{
+			pWords[qwWord] = dwUpload + (u32)qwWord;
+		}
+		BenchCopy *pCopy = &submit.copies[submit.dwCopyCount++];
+		pCopy->qwOffset = allocation.qwOffset;
+		pCopy->qwSize = qwSize;
+		pCopy->dwSeed = dwUpload;
+		qwBytes += qwSize;
+		if( submit.dwCopyCount == BENCH_UPLOADS_PER_SUBMIT || dwUpload + 1 == BENCH_NUM_UPLOADS )
+		{
+			submit.qwFenceValue = ++qwFenceValue;
+			BenchCopyQueueSubmit( pQueue, &submit );
+			UploadRingSubmit( &ring, qwFenceValue );
+			submit.dwCopyCount = 0;
+		}
+	}
+	CpuFenceWait( &pQueue->fence, qwFenceValue );
+	u64 qwNs = GetTimeNs() - qwStart;
+	submit.dwCopyCount = 0; //stops the copy thread
+	BenchCopyQueueSubmit( pQueue, &submit );
+	copyThread.join();
+	UploadRingRetire( &ring, CpuFenceGetCompletedValue( &pQueue->fence ) );
+
+	printf( "\nupload ring, %u uploads through a %u KB ring\n", BENCH_NUM_UPLOADS, BENCH_UPLOAD_RING_SIZE / 1024 );
+	printf( "%.1f MB streamed, %.1f MB/s, peak %llu KB in flight, %u full ring stalls, %llu mismatched words, %llu bytes left in use\n",
+			qwBytes / 1e6, qwBytes / ( qwNs / 1e3 ), (unsigned long long)( ring.qwPeakUsed / 1024 ), dwStalls,
+			(unsigned long long)pQueue->qwMismatches, (unsigned long long)UploadRingUsed( &ring ) );
+	free( pQueue->pDestination );
+	delete pQueue;
+	free( pRingMemory );
+}
+
+#define BENCH_READBACK_RECORDS ( 4u << 20 )        //64MB of ModelOutData
+#define BENCH_READBACK_BATCH_RECORDS ( 64u << 10 ) //1MB per copy
+#define BENCH_READBACK_ARENA_SIZE ( 16u << 20 )
+#define BENCH_READBACK_IN_FLIGHT 4
+
+typedef struct BenchReadbackCopy
+{
+	const ModelOutData *pSource;
+	u8 *pDestination;
+	u32 dwCount;
+} BenchReadbackCopy;
+
+//the copy queue's CopyBufferRegion into readback memory
+void BenchReadbackCopyWork( void *pContext )
+{
+	const BenchReadbackCopy *pCopy = (const BenchReadbackCopy*)pContext;
+	memcpy( pCopy->pDestination, pCopy->pSource, pCopy->dwCount * sizeof(ModelOutData) );
+}
+
+typedef struct BenchReadbackBatch
+{
+	const ModelOutData *pResults;
+	u32 dwFirst;
+	u32 dwCount;
+	u64 qwFenceValue;
+} BenchReadbackBatch;
+
+//what a consumer does with the results, a checksum and a check that every record is the one the "dispatch" wrote
+u64 BenchReadbackConsume( const ModelOutData *pResults, u32 dwFirst, u32 dwCount, u64 *pMismatches )
+{
+	u64 qwSum = 0;
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		*pMismatches += pResults[dwIdx].dwData[0] != dwFirst + dwIdx;
+		qwSum += pResults[dwIdx].dwData[0] + pResults[dwIdx].dwData[1] + pResults[dwIdx].dwData[2] + pResults[dwIdx].dwData[3];
+	}
+	return qwSum;
+}
+
+//millions of ModelOutData through a cpu copy queue in 1MB copies, read the old way (a readback buffer per slot, memcpy into
+//the result array after the fence wait) and in place from spans of a persistently mapped arena released by fence value
+void BenchReadbackArena()
+{
+	ModelOutData *pDevice = (ModelOutData*)malloc( BENCH_READBACK_RECORDS * sizeof(ModelOutData) );
+	for( u32 dwRecord = 0; dwRecord < BENCH_READBACK_RECORDS; ++dwRecord )
+	{
+		pDevice[dwRecord].dwData[0] = dwRecord;
+		pDevice[dwRecord].dwData[1] = dwRecord * 3;
+		pDevice[dwRecord].dwData[2] = dwRecord ^ 0x5a5a5a5au;
+		pDevice[dwRecord].dwData[3] = ~dwRecord;
+	}
+	const u32 dwBatchCount = BENCH_READBACK_RECORDS / BENCH_READBACK_BATCH_RECORDS;
+	BenchReadbackCopy copies[BENCH_READBACK_IN_FLIGHT + 1];
+	CpuQueue *pQueue = new CpuQueue;
+	CpuFence fence;
+	u64 qwFenceValue = 0;
+	printf( "\nreadback of %u ModelOutData in %u record copies, %u in flight\n", BENCH_READBACK_RECORDS, BENCH_READBACK_BATCH_RECORDS, BENCH_READBACK_IN_FLIGHT );
+
+	//memcpy out of a readback buffer per slot
+	{
+		InitCpuQueue( pQueue, "copy" );
+		InitCpuFence( &fence, 0 );
+		ModelOutData *pResults = (ModelOutData*)malloc( BENCH_READBACK_RECORDS * sizeof(ModelOutData) );
+		u8 *pSlots[BENCH_READBACK_IN_FLIGHT];
+		BenchReadbackBatch slotBatches[BENCH_READBACK_IN_FLIGHT];
+		for( u32 dwSlot = 0; dwSlot < BENCH_READBACK_IN_FLIGHT; ++dwSlot )
+		{
+			pSlots[dwSlot] = (u8*)malloc( BENCH_READBACK_BATCH_RECORDS * sizeof(ModelOutData) );
+			slotBatches[dwSlot].qwFenceValue = 0;
+		}
+		u64 qwSum = 0;
+		u64 qwMismatches = 0;
+		const u64 qwStart = GetTimeNs();
+		for( u32 dwBatch = 0; dwBatch < dwBatchCount + BENCH_READBACK_IN_FLIGHT; ++dwBatch )
+		{
+			const u32 dwSlot = dwBatch % BENCH_READBACK_IN_FLIGHT;
+			BenchReadbackBatch *pBatch = &slotBatches[dwSlot];
+			if( pBatch->qwFenceValue != 0 )
+			{
+				CpuFenceWait( &fence, pBatch->qwFenceValue );
+				memcpy( &pResults[pBatch->dwFirst], pSlots[dwSlot], pBatch->dwCount * sizeof(ModelOutData) );
+				qwSum += BenchReadbackConsume( &pResults[pBatch->dwFirst], pBatch->dwFirst, pBatch->dwCount, &qwMismatches );
+				pBatch->qwFenceValue = 0;
+			}
+			if( dwBatch < dwBatchCount )
+			{
+				BenchReadbackCopy *pCopy = &copies[dwSlot];
+				pCopy->pSource = &pDevice[dwBatch * BENCH_READBACK_BATCH_RECORDS];
+				pCopy->pDestination = pSlots[dwSlot];
+				pCopy->dwCount = BENCH_READBACK_BATCH_RECORDS;
+				CpuQueueExecute( pQueue, BenchReadbackCopyWork, pCopy );
+				CpuQueueSignal( pQueue, &fence, ++qwFenceValue );
+				pBatch->dwFirst = dwBatch * BENCH_READBACK_BATCH_RECORDS;
+				pBatch->dwCount = BENCH_READBACK_BATCH_RECORDS;
+				pBatch->qwFenceValue = qwFenceValue;
+			}
+		}
+		const u64 qwNs = GetTimeNs() - qwStart;
+		DestroyCpuQueue( pQueue );
+		printf( "slot buffers + memcpy     %7.1f ms, %5.2f ns/record, %6.1f MB copied by the host, checksum %016llx, %llu mismatches\n",
+				qwNs / 1e6, (f64)qwNs / BENCH_READBACK_RECORDS, BENCH_READBACK_RECORDS * sizeof(ModelOutData) / 1e6,
+				(unsigned long long)qwSum, (unsigned long long)qwMismatches );
+		for( u32 dwSlot = 0; dwSlot < BENCH_READBACK_IN_FLIGHT; ++dwSlot )
+		{
+			free( pSlots[dwSlot] );
+		}
+		free( pResults );
+	}
+
+	//in place from the arena, the arena holds a quarter of the results so spans have to be released for it to keep going
+	{
+		InitCpuQueue( pQueue, "copy" );
+		InitCpuFence( &fence, 0 );
+		qwFenceValue = 0;
+		u8 *pArenaMemory = (u8*)malloc( BENCH_READBACK_ARENA_SIZE );
+		ReadbackArena arena;
+		InitReadbackArena( &arena, pArenaMemory, BENCH_READBACK_ARENA_SIZE );
+		std::deque<BenchReadbackBatch> outstanding;
+		u64 qwSum = 0;
+		u64 qwMismatches = 0;
+		u32 dwFullArena = 0;
+		const u64 qwStart = GetTimeNs();
+		for( u32 dwBatch = 0; dwBatch <= dwBatchCount; ++dwBatch )
+		{
+			//the consumer reads the oldest span where it landed and hands it back by fence value
+			while( !outstanding.empty() && ( outstanding.size() >= BENCH_READBACK_IN_FLIGHT || dwBatch == dwBatchCount ) )
+			{
+				const BenchReadbackBatch batch = outstanding.front();
+				outstanding.pop_front();
+				CpuFenceWait( &fence, batch.qwFenceValue );
+				qwSum += BenchReadbackConsume( batch.pResults, batch.dwFirst, batch.dwCount, &qwMismatches );
+				ReadbackArenaRelease( &arena, batch.qwFenceValue );
+			}
+			if( dwBatch == dwBatchCount )
+			{
+				break;
+			}
+			ReadbackSpan span;
+			if( !ReadbackArenaAlloc( &arena, BENCH_READBACK_BATCH_RECORDS * sizeof(ModelOutData), READBACK_ARENA_ALIGNMENT, &span ) )
+			{
+				++dwFullArena; //can't happen with BENCH_READBACK_IN_FLIGHT spans in a 16 span arena
+				break;
+			}
+			BenchReadbackCopy *pCopy = &copies[dwBatch % ( BENCH_READBACK_IN_FLIGHT + 1 )];
+			pCopy->pSource = &pDevice[dwBatch * BENCH_READBACK_BATCH_RECORDS];
+			pCopy->pDestination = (u8*)span.pData;
+			pCopy->dwCount = BENCH_READBACK_BATCH_RECORDS;
+			CpuQueueExecute( pQueue, BenchReadbackCopyWork, pCopy );
+			CpuQueueSignal( pQueue, &fence, ++qwFenceValue );
+			ReadbackArenaSubmit( &arena, qwFenceValue );
+			BenchReadbackBatch batch;
+			batch.pResults = (const ModelOutData*)span.pData;
+			batch.dwFirst = dwBatch * BENCH_READBACK_BATCH_RECORDS;
+			batch.dwCount = BENCH_READBACK_BATCH_RECORDS;
+			batch.qwFenceValue = qwFenceValue;
+			outstanding.push_back( batch );
+		}
+		const u64 qwNs = GetTimeNs() - qwStart;
+		DestroyCpuQueue( pQueue );
+		printf( "arena spans in place      %7.1f ms, %5.2f ns/record, %6.1f MB copied by the host, checksum %016llx, %llu mismatches, peak %llu KB of %u KB, %llu bytes left in use%s\n",
+				qwNs / 1e6, (f64)qwNs / BENCH_READBACK_RECORDS, 0.0, (unsigned long long)qwSum, (unsigned long long)qwMismatches,
+				(unsigned long long)( arena.ring.qwPeakUsed / 1024 ), BENCH_READBACK_ARENA_SIZE / 1024, (unsigned long long)ReadbackArenaUsed( &arena ),
+				dwFullArena ? " (arena full!)" : "" );
+		free( pArenaMemory );
+	}
+	delete pQueue;
+	free( pDevice );
+}
+
+#define BENCH_SINK_BYTES ( 128u << 20 )
+#define BENCH_SINK_REGION_SIZE ( 1u << 20 )
+#define BENCH_SINK_ARENA_SIZE ( 16u << 20 )
+#define BENCH_SINK_PATH "BenchResults.bin"
+
+typedef struct BenchSinkRegion
+{
+	const u8 *pData;
+	u64 qwSize;
+	u64 qwFenceValue;
+} BenchSinkRegion;
+
+//readback regions of a cpu copy queue go through a readback arena to a file, the arena is recycled from what the sink polled
+//synchronous is the old way, the writer waits for every region to be written before it releases it
+//arena stalls are copies that could not be submitted because the arena was full of results still waiting for the disk
+void BenchResultSink()
+{
+	u8 *pDevice = (u8*)malloc( BENCH_SINK_BYTES );
+	for( u32 dwWord = 0; dwWord < BENCH_SINK_BYTES / sizeof(u32); ++dwWord )
+	{
+		( (u32*)pDevice )[dwWord] = dwWord * 2654435761u;
+	}
+	u8 *pArenaAllocation = (u8*)malloc( BENCH_SINK_ARENA_SIZE + RESULT_SINK_DIRECT_ALIGNMENT );
+	u8 *pArenaMemory = (u8*)AlignUp( (u64)pArenaAllocation, RESULT_SINK_DIRECT_ALIGNMENT );
+	BenchReadbackCopy copies[BENCH_SINK_ARENA_SIZE / ( BENCH_SINK_REGION_SIZE - 16 ) + 1];
+
+	printf( "\nresult sink, %u MB of readback regions through a %u MB readback arena to %s\n", BENCH_SINK_BYTES >> 20, BENCH_SINK_ARENA_SIZE >> 20, BENCH_SINK_PATH );
+	typedef struct BenchSinkConfig
+	{
+		const char *pName;
+		u32 dwQueueDepth;
+		bool bSynchronous;
+		bool bRegister;
+		u32 dwRegionSize; //not a multiple of the block size goes through the page cache
+	} BenchSinkConfig;
+	static const BenchSinkConfig configs[] =
+	{
+		{ "synchronous", 1, true, false, BENCH_SINK_REGION_SIZE },
+		{ "depth 4", 4, false, false, BENCH_SINK_REGION_SIZE },
+		{ "depth 8", 8, false, false, BENCH_SINK_REGION_SIZE },
+		{ "depth 8 registered", 8, false, true, BENCH_SINK_REGION_SIZE },
+		{ "depth 8 buffered", 8, false, true, BENCH_SINK_REGION_SIZE - 16 },
+	};
+	for( u32 dwConfig = 0; dwConfig < sizeof(configs) / sizeof(configs[0]); ++dwConfig )
+	{
+		const BenchSinkConfig *pConfig = &configs[dwConfig];
+		ResultSink *pSink = new ResultSink;
+		if( !OpenResultSink( pSink, BENCH_SINK_PATH, pConfig->dwQueueDepth ) )
+		{
+			printf( "Failed to open the result sink!\n" );
+			delete pSink;
+			break;
+		}
+		const bool bRegistered = pConfig->bRegister && ResultSinkRegisterBuffer( pSink, pArenaMemory, BENCH_SINK_ARENA_SIZE );
+		ReadbackArena arena;
+		InitReadbackArena( &arena, pArenaMemory, BENCH_SINK_ARENA_SIZE );
+		CpuQueue *pQueue = new CpuQueue;
+		InitCpuQueue( pQueue, "copy" );
+		CpuFence fence;
+		InitCpuFence( &fence, 0 );
+		u64 qwFenceValue = 0;
+		std::deque<BenchSinkRegion> copying; //submitted copies the sink does not have yet
+		u64 qwArenaStalls = 0;
+		u64 qwAppendNs = 0;
+
+		const u64 qwRegionCount = BENCH_SINK_BYTES / pConfig->dwRegionSize;
+		const u64 qwStart = GetTimeNs();
+		for( u64 qwRegion = 0; qwRegion <= qwRegionCount && !pSink->bFailed; ++qwRegion )
+		{
+			//copies that are done go to the sink, everything written goes back to the arena
+			while( !copying.empty() && ( CpuFenceGetCompletedValue( &fence ) >= copying.front().qwFenceValue || qwRegion == qwRegionCount ) )
+			{
+				const BenchSinkRegion region = copying.front();
+				copying.pop_front();
+				CpuFenceWait( &fence, region.qwFenceValue );
+				const u64 qwAppendStart = GetTimeNs();
+				ResultSinkAppend( pSink, region.pData, region.qwSize, region.qwFenceValue );
+				if( pConfig->bSynchronous )
+				{
+					ResultSinkFlush( pSink );
+				}
+				qwAppendNs += GetTimeNs() - qwAppendStart;
+			}
+			ReadbackArenaRelease( &arena, ResultSinkPoll( pSink ) );
+			if( qwRegion == qwRegionCount )
+			{
+				break;
+			}
+
+			ReadbackSpan span;
+			while( !ReadbackArenaAlloc( &arena, pConfig->dwRegionSize, RESULT_SINK_DIRECT_ALIGNMENT, &span ) )
+			{
+				++qwArenaStalls;
+				if( !copying.empty() )
+				{
+					const BenchSinkRegion region = copying.front();
+					copying.pop_front();
+					CpuFenceWait( &fence, region.qwFenceValue );
+					ResultSinkAppend( pSink, region.pData, region.qwSize, region.qwFenceValue );
+				}
+				ReadbackArenaRelease( &arena, ResultSinkWait( pSink ) );
+			}
+			BenchReadbackCopy *pCopy = &copies[qwRegion % ( sizeof(copies) / sizeof(copies[0]) )];
+			pCopy->pSource = (const ModelOutData*)( pDevice + qwRegion * pConfig->dwRegionSize );
+			pCopy->pDestination = (u8*)span.pData;
+			pCopy->dwCount = pConfig->dwRegionSize / sizeof(ModelOutData);
+			CpuQueueExecute( pQueue, BenchReadbackCopyWork, pCopy );
+			CpuQueueSignal( pQueue, &fence, ++qwFenceValue );
+			ReadbackArenaSubmit( &arena, qwFenceValue );
+			BenchSinkRegion region;
+			region.pData = span.pData;
+			region.qwSize = pConfig->dwRegionSize;
+			region.qwFenceValue = qwFenceValue;
+			copying.push_back( region );
+		}
+		ResultSinkFlush( pSink );
+		ReadbackArenaRelease( &arena, ResultSinkPoll( pSink ) );
+		const u64 qwNs = GetTimeNs() - qwStart;
+		DestroyCpuQueue( pQueue );
+		delete pQueue;
+		const bool bClosed = CloseResultSink( pSink );
+
+		MappedFile written;
+		bool bMatch = bClosed && OpenMappedFile( BENCH_SINK_PATH, &written, false );
+		if( bMatch )
+		{
+			bMatch = written.qwSize == qwRegionCount * pConfig->dwRegionSize && memcmp( written.pBase, pDevice, written.qwSize ) == 0;
+			CloseMappedFile( &written );
+		}
+		printf( "%-20s %7.1f MB/s, latency p50 %7.1f us p99 %7.1f us p99.9 %7.1f us max %7.1f us, %5.1f us/region in append, "
+				"%llu arena stalls, %llu sink stalls, %llu/%llu direct, %llu fixed, %llu short, %llu KB left in use, file %s\n",
+				pConfig->pName, pSink->qwBytesWritten / ( qwNs / 1e3 ),
+				ResultSinkLatencyPercentileNs( pSink, 50.0 ) / 1e3, ResultSinkLatencyPercentileNs( pSink, 99.0 ) / 1e3,
+				ResultSinkLatencyPercentileNs( pSink, 99.9 ) / 1e3, pSink->qwMaxLatencyNs / 1e3, qwAppendNs / 1e3 / qwRegionCount,
+				(unsigned long long)qwArenaStalls, (unsigned long long)pSink->qwFullStalls, (unsigned long long)pSink->qwDirectWrites,
+				(unsigned long long)pSink->qwWrites, (unsigned long long)pSink->qwFixedWrites, (unsigned long long)pSink->qwShortWrites,
+				(unsigned long long)( ReadbackArenaUsed( &arena ) / 1024 ), bMatch ? "ok" : ( bRegistered || !pConfig->bRegister ? "MISMATCH" : "MISMATCH (not registered)" ) );
+		delete pSink;
+		remove( BENCH_SINK_PATH );
+	}
+	free( pArenaAllocation );
+	free( pDevice );
+}
+
+#define BENCH_HEAP_SIZE (256ull << 20)
+#define BENCH_HEAP_OPERATIONS (1u << 20)
+
+//thousands of small compute buffers churning in one heap, random frees keep the free space broken up
+//the live count climbs to dwMaxLive and then hovers around it
+void BenchHeapAllocatorChurn( const char *pName, u64 qwAlignment, u32 dwMaxSize, u32 dwMaxLive )
+{
+	HeapAllocator allocator;
+	if( !InitHeapAllocator( &allocator, BENCH_HEAP_SIZE, dwMaxLive * 2 + 1 ) )
+	{
+		return;
+	}
+	HeapAllocation *pLive = (HeapAllocation*)malloc( dwMaxLive * sizeof(HeapAllocation) );
+	u32 dwLiveCount = 0;
+	u32 dwFailed = 0;
+	u32 dwState = 11;
+	u64 qwStart = GetTimeNs();
+	for( u32 dwOp = 0; dwOp < BENCH_HEAP_OPERATIONS; ++dwOp )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		if( dwLiveCount == dwMaxLive || ( dwLiveCount > 0 && ( dwState >> 30 ) == 0 ) )
+		{
+			const u32 dwVictim = ( dwState >> 8 ) % dwLiveCount;
+			HeapFree( &allocator, &pLive[dwVictim] );
+			pLive[dwVictim] = pLive[--dwLiveCount];
+		}
+		else
+		{
+			const u64 qwSize = 16 + ( dwState >> 8 ) % dwMaxSize;
+			if( HeapAlloc( &allocator, qwSize, qwAlignment, &pLive[dwLiveCount] ) )
+			{
+				++dwLiveCount;
+			}
+			else
+			{
+				++dwFailed;
+			}
+		}
+	}
+	u64 qwNs = GetTimeNs() - qwStart;
+
+	HeapAllocatorStats stats;
+	GetHeapAllocatorStats( &allocator, &stats );
+	printf( "%-28s %6.1f ns/op, %u live, %.1f MB used of %.1f MB requested (%.1f%% waste), %u free blocks, largest %.1f MB, fragmentation %.3f, %u failed, %s\n",
+			pName, (f64)qwNs / BENCH_HEAP_OPERATIONS, stats.dwAllocationCount, stats.qwAllocatedBytes / 1e6, stats.qwRequestedBytes / 1e6,
+			100.0 * stats.qwWastedBytes / ( stats.qwAllocatedBytes ? stats.qwAllocatedBytes : 1 ), stats.dwFreeBlockCount,
+			stats.qwLargestFreeBlock / 1e6, stats.fFragmentation, dwFailed, ValidateHeapAllocator( &allocator ) ? "valid" : "CORRUPT" );
+
+	for( u32 dwIdx = 0; dwIdx < dwLiveCount; ++dwIdx )
+	{
+		HeapFree( &allocator, &pLive[dwIdx] );
+	}
+	GetHeapAllocatorStats( &allocator, &stats );
+	if( stats.dwFreeBlockCount != 1 || stats.qwFreeBytes != stats.qwHeapSize )
+	{
+		printf( "heap did not coalesce back into one block!\n" );
+	}
+	free( pLive );
+	DestroyHeapAllocator( &allocator );
+}
+
+void BenchHeapAllocator()
+{
+	printf( "\nheap allocator, %u alloc/free in a %llu MB heap\n", BENCH_HEAP_OPERATIONS, (unsigned long long)( BENCH_HEAP_SIZE >> 20 ) );
+	BenchHeapAllocatorChurn( "buffers, 64KB placement", 65536, 16 * 1024, 2048 );
+	BenchHeapAllocatorChurn( "raw views, 256B aligned", 256, 16 * 1024, 8192 );
+	BenchHeapAllocatorChurn( "up to 1MB, 4KB aligned", 4096, 1024 * 1024, 384 );
+}
+
+#define BENCH_INFLIGHT_DISPATCHES 1024
+#define BENCH_MAX_INFLIGHT 4
+#define BENCH_COMPUTE_DEVICE_US 150 //time a dispatch keeps the (simulated) gpu busy
+#define BENCH_COPY_DEVICE_US 100    //time a readback copy keeps the copy engine busy
+#define BENCH_READBACK_CPU_US 50    //cpu work per result once it is read back
+
+void BenchBusyWaitUs( u32 dwUs )
+{
+	const u64 qwEnd = GetTimeNs() + dwUs * 1000ull;
+	while( GetTimeNs() < qwEnd )
+	{
+	}
+}
+
+//same shape as ComputeSlot in main.cpp, the queues read the contexts when they get to the work
+typedef struct BenchComputeSlot
+{
+	CpuComputeDevice *pDevice;
+	CpuComputeKernel *pKernel;
+	CpuComputeRootArgs root;
+	ModelOutData computeOutput;
+	ModelOutData readback;
+	u64 qwReadbackFenceValue;
+	u32 dwDispatch;
+} BenchComputeSlot;
+
+void BenchSlotDispatch( void *pContext )
+{
+	BenchComputeSlot *pSlot = (BenchComputeSlot*)pContext;
+	CpuDispatch( pSlot->pDevice, pSlot->pKernel, &pSlot->root, 1, 1, 1 );
+	std::this_thread::sleep_for( std::chrono::microseconds( BENCH_COMPUTE_DEVICE_US ) );
+}
+
+void BenchSlotCopy( void *pContext )
+{
+	BenchComputeSlot *pSlot = (BenchComputeSlot*)pContext;
+	memcpy( &pSlot->readback, &pSlot->computeOutput, sizeof(ModelOutData) );
+	std::this_thread::sleep_for( std::chrono::microseconds( BENCH_COPY_DEVICE_US ) );
+}
+
+//RunComputeDispatches() from main.cpp on cpu queues, the gpu time is simulated with sleeps so the queues don't compete with the cpu side
+void BenchComputeInFlight()
+{
+	CpuComputeDevice *pDevice = new CpuComputeDevice;
+	if( !InitCpuComputeDevice( pDevice, 1 ) ) //the compute queue thread is the only worker
+	{
+		delete pDevice;
+		return;
+	}
+	CpuComputeKernel kernel;
+	InitComputeShaderMainCpuKernel( &kernel );
+	CpuQueue *pComputeQueue = new CpuQueue;
+	CpuQueue *pCopyQueue = new CpuQueue;
+	CpuFence *pComputeFence = new CpuFence;
+	CpuFence *pCopyFence = new CpuFence;
+	InitCpuQueue( pComputeQueue, "compute" );
+	InitCpuQueue( pCopyQueue, "copy" );
+	InitCpuFence( pComputeFence, 0 );
+	InitCpuFence( pCopyFence, 0 );
+	u64 qwComputeFenceValue = 0;
+	u64 qwCopyFenceValue = 0;
+	BenchComputeSlot slots[BENCH_MAX_INFLIGHT];
+	ModelOutData *pResults = (ModelOutData*)malloc( BENCH_INFLIGHT_DISPATCHES * sizeof(ModelOutData) );
+
+	printf( "\ncompute slots in flight, %u dispatches, %u us dispatch + %u us copy on the queues, %u us cpu per result\n",
+			BENCH_INFLIGHT_DISPATCHES, BENCH_COMPUTE_DEVICE_US, BENCH_COPY_DEVICE_US, BENCH_READBACK_CPU_US );
+	f64 fLockstepRate = 0.0;
+	for( u32 dwInFlight = 1; dwInFlight <= BENCH_MAX_INFLIGHT; ++dwInFlight )
+	{
+		for( u32 dwSlot = 0; dwSlot < BENCH_MAX_INFLIGHT; ++dwSlot )
+		{
+			slots[dwSlot].pDevice = pDevice;
+			slots[dwSlot].pKernel = &kernel;
+			slots[dwSlot].root.pVerticesAndIndices = NULL;
+			slots[dwSlot].root.qwVerticesAndIndicesSize = 0;
+			slots[dwSlot].root.pOut = &slots[dwSlot].computeOutput;
+			slots[dwSlot].root.qwOutCount = 1;
+			slots[dwSlot].qwReadbackFenceValue = 0;
+		}
+		u32 dwMismatches = 0;
+		u64 qwStart = GetTimeNs();
+		for( u32 dwDispatch = 0; dwDispatch < BENCH_INFLIGHT_DISPATCHES + dwInFlight; ++dwDispatch )
+		{
+			BenchComputeSlot *pSlot = &slots[dwDispatch % dwInFlight];
+			if( pSlot->qwReadbackFenceValue != 0 )
+			{
+				CpuFenceWait( pCopyFence, pSlot->qwReadbackFenceValue );
+				pResults[pSlot->dwDispatch] = pSlot->readback;
+				dwMismatches += pSlot->readback.dwData[0] != 2 * ( pSlot->dwDispatch*4 );
+				BenchBusyWaitUs( BENCH_READBACK_CPU_US );
+				pSlot->qwReadbackFenceValue = 0;
+			}
+			if( dwDispatch >= BENCH_INFLIGHT_DISPATCHES )
+			{
+				continue; //draining
+			}
+			for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+			{
+				pSlot->root.cb.dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
+			}
+			CpuQueueExecute( pComputeQueue, BenchSlotDispatch, pSlot );
+			CpuQueueSignal( pComputeQueue, pComputeFence, ++qwComputeFenceValue );
+			CpuQueueWait( pCopyQueue, pComputeFence, qwComputeFenceValue );
+			CpuQueueExecute( pCopyQueue, BenchSlotCopy, pSlot );
+			CpuQueueSignal( pCopyQueue, pCopyFence, ++qwCopyFenceValue );
+			pSlot->qwReadbackFenceValue = qwCopyFenceValue;
+			pSlot->dwDispatch = dwDispatch;
+		}
+		u64 qwNs = GetTimeNs() - qwStart;
+		const f64 fRate = BENCH_INFLIGHT_DISPATCHES / ( qwNs / 1e9 );
+		if( dwInFlight == 1 )
+		{
+			fLockstepRate = fRate;
+		}
+		printf( "%u in flight%s: %7.0f dispatches/s, %6.1f us each, %.2fx lockstep, %u mismatches\n", dwInFlight, dwInFlight == 1 ? " (lockstep)" : "",
+				fRate, qwNs / 1e3 / BENCH_INFLIGHT_DISPATCHES, fRate / fLockstepRate, dwMismatches );
+	}
+
+	DestroyCpuQueue( pComputeQueue );
+	DestroyCpuQueue( pCopyQueue );
+	DestroyCpuComputeDevice( pDevice );
+	free( pResults );
+	delete pComputeQueue;
+	delete pCopyQueue;
+	delete pComputeFence;
+	delete pCopyFence;
+	delete pDevice;
+}
+
+#define BENCH_RESIDENCY_HEAPS 64
+#define BENCH_RESIDENCY_HEAP_SIZE ( 1u << 20 )
+#define BENCH_RESIDENCY_HOT_HEAPS 12      //80% of the uses, 12MB
+#define BENCH_RESIDENCY_HEAPS_PER_SUBMIT 3
+#define BENCH_RESIDENCY_SUBMITS_PER_PHASE 2000
+#define BENCH_RESIDENCY_IN_FLIGHT 4
+#define BENCH_RESIDENCY_DEVICE_US 300
+
+//the budget is whatever the bench says it is, the os lowering it is a store to qwBudget
+typedef struct BenchResidencySource
+{
+	CpuFence fence;
+	u64 qwBudget;
+	u32 *pHeaps[BENCH_RESIDENCY_HEAPS];
+	u64 qwRestoreNs;
+} BenchResidencySource;
+
+typedef struct BenchResidencySubmit
+{
+	const u32 *pHeaps[BENCH_RESIDENCY_HEAPS_PER_SUBMIT];
+	u32 dwHeaps[BENCH_RESIDENCY_HEAPS_PER_SUBMIT];
+	u64 *pqwCorrupt;
+} BenchResidencySubmit;
+
+u32 BenchResidencyWord( u32 dwHeap, u32 dwWord )
+{
+	return dwHeap * 0x9e3779b9u + dwWord;
+}
+
+u64 BenchResidencyBudget( void *pContext, u32 dwSegment )
+{
+	return dwSegment == RESIDENCY_SEGMENT_LOCAL ? ( (BenchResidencySource*)pContext )->qwBudget : RESIDENCY_NO_LIMIT;
+}
+
+u64 BenchResidencyCompleted( void *pContext, u32 dwQueue )
+{
+	return CpuFenceGetCompletedValue( &( (BenchResidencySource*)pContext )->fence );
+}
+
+//worst case eviction, the contents are gone (poisoned so a heap evicted under a running submit shows up as corrupt)
+bool BenchResidencyEvict( void *pContext, void *pHeap )
+{
+	memset( pHeap, 0xdd, BENCH_RESIDENCY_HEAP_SIZE );
+	return true;
+}
+
+//the re-upload
+bool BenchResidencyRestore( void *pContext, void *pHeap )
+{
+	BenchResidencySource *pSource = (BenchResidencySource*)pContext;
+	const u64 qwStart = GetTimeNs();
+	u32 *pWords = (u32*)pHeap;
+	u32 dwHeap = 0;
+	while( pSource->pHeaps[dwHeap] != pWords )
+	{
+		++dwHeap;
+	}
+	for( u32 dwWord = 0; dwWord < BENCH_RESIDENCY_HEAP_SIZE / sizeof(u32); ++dwWord )
+	{
+		pWords[dwWord] = BenchResidencyWord( dwHeap, dwWord );
+	}
+	pSource->qwRestoreNs += GetTimeNs() - qwStart;
+	return true;
+}
+
+//the "gpu" reads a word per page of every heap of the submit, at the end so the heaps have to stay resident the whole time
+void BenchResidencyExecute( void *pContext )
+{
+	const BenchResidencySubmit *pSubmit = (const BenchResidencySubmit*)pContext;
+	std::this_thread::sleep_for( std::chrono::microseconds( BENCH_RESIDENCY_DEVICE_US ) );
+	for( u32 dwIdx = 0; dwIdx < BENCH_RESIDENCY_HEAPS_PER_SUBMIT; ++dwIdx )
+	{
+		for( u32 dwWord = 0; dwWord < BENCH_RESIDENCY_HEAP_SIZE / sizeof(u32); dwWord += 1024 )
+		{
+			*pSubmit->pqwCorrupt += pSubmit->pHeaps[dwIdx][dwWord] != BenchResidencyWord( pSubmit->dwHeaps[dwIdx], dwWord );
+		}
+	}
+}
+
+//64 1MB heaps on a mock budget, every submit uses 3 of them (80% out of a 12MB hot set) with 4 submits in flight
+//the budget drops below the hot set in the middle phase, the os taking memory away, and then comes back above it
+//corrupt words are reads of heaps evicted while a submit still used them, has to be 0
+void BenchResidency()
+{
+	BenchResidencySource *pSource = new BenchResidencySource;
+	InitCpuFence( &pSource->fence, 0 );
+	pSource->qwRestoreNs = 0;
+	ResidencyCallbacks callbacks;
+	callbacks.pfnBudget = BenchResidencyBudget;
+	callbacks.pfnCompletedFenceValue = BenchResidencyCompleted;
+	callbacks.pfnEvict = BenchResidencyEvict;
+	callbacks.pfnMakeResident = BenchResidencyRestore;
+	callbacks.pContext = pSource;
+	ResidencyManager *pManager = new ResidencyManager;
+	InitResidencyManager( pManager, &callbacks, 1 );
+
+	static const u64 phaseBudgets[] = { 24ull << 20, 10ull << 20, 40ull << 20 };
+	pSource->qwBudget = phaseBudgets[0];
+	u32 dwHandles[BENCH_RESIDENCY_HEAPS];
+	for( u32 dwHeap = 0; dwHeap < BENCH_RESIDENCY_HEAPS; ++dwHeap )
+	{
+		pSource->pHeaps[dwHeap] = (u32*)malloc( BENCH_RESIDENCY_HEAP_SIZE );
+		BenchResidencyRestore( pSource, pSource->pHeaps[dwHeap] ); //created with its contents
+		dwHandles[dwHeap] = ResidencyTrackHeap( pManager, pSource->pHeaps[dwHeap], BENCH_RESIDENCY_HEAP_SIZE, RESIDENCY_SEGMENT_LOCAL, "bench", false );
+	}
+	const u32 dwSubmitCount = BENCH_RESIDENCY_SUBMITS_PER_PHASE * ( sizeof(phaseBudgets) / sizeof(phaseBudgets[0]) );
+	BenchResidencySubmit *pSubmits = (BenchResidencySubmit*)malloc( dwSubmitCount * sizeof(BenchResidencySubmit) );
+	u64 qwCorrupt = 0;
+	CpuQueue *pQueue = new CpuQueue;
+	InitCpuQueue( pQueue, "gpu" );
+	u64 qwFenceValue = 0;
+	u32 dwRandom = 0x12345678u;
+
+	printf( "\nresidency, %u heaps of %u MB, %u per submit (80%% from %u hot ones), %u in flight\n", BENCH_RESIDENCY_HEAPS,
+			BENCH_RESIDENCY_HEAP_SIZE >> 20, BENCH_RESIDENCY_HEAPS_PER_SUBMIT, BENCH_RESIDENCY_HOT_HEAPS, BENCH_RESIDENCY_IN_FLIGHT );
+	for( u32 dwPhase = 0; dwPhase < sizeof(phaseBudgets) / sizeof(phaseBudgets[0]); ++dwPhase )
+	{
+		pSource->qwBudget = phaseBudgets[dwPhase];
+		ResidencyTrim( pManager ); //everything is idle between phases
+		const ResidencyStats before = pManager->stats;
+		const u64 qwRestoreNsBefore = pSource->qwRestoreNs;
+		pManager->qwPeakResidentBytes[RESIDENCY_SEGMENT_LOCAL] = pManager->qwResidentBytes[RESIDENCY_SEGMENT_LOCAL];
+		u64 qwWaits = 0;
+		u64 qwNoFit = 0;
+		u64 qwOverBudget = 0;
+		const u64 qwStart = GetTimeNs();
+		for( u32 dwSubmit = dwPhase * BENCH_RESIDENCY_SUBMITS_PER_PHASE; dwSubmit < ( dwPhase + 1 ) * BENCH_RESIDENCY_SUBMITS_PER_PHASE; ++dwSubmit )
+		{
+			if( qwFenceValue >= BENCH_RESIDENCY_IN_FLIGHT )
+			{
+				CpuFenceWait( &pSource->fence, qwFenceValue - BENCH_RESIDENCY_IN_FLIGHT + 1 );
+			}
+			qwOverBudget += !ResidencyTrim( pManager );
+			BenchResidencySubmit *pSubmit = &pSubmits[dwSubmit];
+			pSubmit->pqwCorrupt = &qwCorrupt;
+			for( u32 dwIdx = 0; dwIdx < BENCH_RESIDENCY_HEAPS_PER_SUBMIT; ++dwIdx )
+			{
+				dwRandom ^= dwRandom << 13;
+				dwRandom ^= dwRandom >> 17;
+				dwRandom ^= dwRandom << 5;
+				const u32 dwHeap = dwRandom % 10 < 8 ? ( dwRandom >> 8 ) % BENCH_RESIDENCY_HOT_HEAPS : ( dwRandom >> 8 ) % BENCH_RESIDENCY_HEAPS;
+				//UseResidentHeap() in main.cpp
+				while( !ResidencyUse( pManager, dwHandles[dwHeap], 0, qwFenceValue + 1 ) )
+				{
+					u32 dwBusyQueue;
+					u64 qwBusyValue;
+					if( !ResidencyOldestBusy( pManager, RESIDENCY_SEGMENT_LOCAL, &dwBusyQueue, &qwBusyValue ) || qwBusyValue > qwFenceValue )
+					{
+						++qwNoFit;
+						break;
+					}
+					CpuFenceWait( &pSource->fence, qwBusyValue );
+					++qwWaits;
+				}
+				pSubmit->pHeaps[dwIdx] = pSource->pHeaps[dwHeap];
+				pSubmit->dwHeaps[dwIdx] = dwHeap;
+			}
+			CpuQueueExecute( pQueue, BenchResidencyExecute, pSubmit );
+			CpuQueueSignal( pQueue, &pSource->fence, ++qwFenceValue );
+		}
+		CpuFenceWait( &pSource->fence, qwFenceValue );
+		const u64 qwNs = GetTimeNs() - qwStart;
+		const ResidencyStats *pStats = &pManager->stats;
+		printf( "budget %2llu MB %7.1f us/submit, %5llu evictions, %5llu restores, %7.1f MB re-uploaded in %6.1f ms, %4llu waits for the gpu, "
+				"%llu did not fit, %llu trims over budget, peak %2llu MB resident\n",
+				(unsigned long long)( phaseBudgets[dwPhase] >> 20 ), qwNs / 1e3 / BENCH_RESIDENCY_SUBMITS_PER_PHASE,
+				(unsigned long long)( pStats->qwEvictions - before.qwEvictions ), (unsigned long long)( pStats->qwRestores - before.qwRestores ),
+				( pStats->qwRestoredBytes - before.qwRestoredBytes ) / 1048576.0, ( pSource->qwRestoreNs - qwRestoreNsBefore ) / 1e6,
+				(unsigned long long)qwWaits, (unsigned long long)qwNoFit, (unsigned long long)qwOverBudget,
+				(unsigned long long)( pManager->qwPeakResidentBytes[RESIDENCY_SEGMENT_LOCAL] >> 20 ) );
+	}
+	DestroyCpuQueue( pQueue );
+
+	//the accounting has to match the heaps that are actually resident
+	u64 qwResident = 0;
+	for( u32 dwHeap = 0; dwHeap < BENCH_RESIDENCY_HEAPS; ++dwHeap )
+	{
+		qwResident += pManager->heaps[dwHandles[dwHeap]].bResident ? BENCH_RESIDENCY_HEAP_SIZE : 0;
+	}
+	printf( "%llu corrupt words read, %llu MB resident, accounting %s\n", (unsigned long long)qwCorrupt, (unsigned long long)( qwResident >> 20 ),
+			qwResident == pManager->qwResidentBytes[RESIDENCY_SEGMENT_LOCAL] ? "ok" : "MISMATCH" );
+	for( u32 dwHeap = 0; dwHeap < BENCH_RESIDENCY_HEAPS; ++dwHeap )
+	{
+		ResidencyUntrackHeap( pManager, dwHandles[dwHeap] );
+		free( pSource->pHeaps[dwHeap] );
+	}
+	free( pSubmits );
+	delete pQueue;
+	delete pManager;
+	delete pSource;
+}
+
+#define BENCH_TIMELINE_JOBS 1024
+#define BENCH_TIMELINE_VALUES 256
+
+//a queue and the fence it signals, submit + signal happen under one lock so fence values reach the queue in order
+typedef struct BenchTimelineQueue
+{
+	CpuQueue queue;
+	CpuFence fence;
+	std::mutex submitLock;
+	u64 qwFenceValue;
+} BenchTimelineQueue;
+
+u64 BenchTimelineSubmit( BenchTimelineQueue *pQueue, PFN_CpuQueueWork pfnWork, void *pContext )
+{
+	std::lock_guard<std::mutex> guard( pQueue->submitLock );
+	CpuQueueExecute( &pQueue->queue, pfnWork, pContext );
+	CpuQueueSignal( &pQueue->queue, &pQueue->fence, ++pQueue->qwFenceValue );
+	return pQueue->qwFenceValue;
+}
+
+//FenceTimelineCallbacks on CpuFence + CpuEvent
+u64 BenchTimelineCompletedValue( void *pContext, void *pFence )
+{
+	return CpuFenceGetCompletedValue( (CpuFence*)pFence );
+}
+
+void BenchTimelineSetEventOnCompletion( void *pContext, void *pFence, u64 qwValue, void *pEvent )
+{
+	CpuFenceSetEventOnCompletion( (CpuFence*)pFence, qwValue, (CpuEvent*)pEvent );
+}
+
+void BenchTimelineWait( void *pContext, void *pFence, u64 qwValue )
+{
+	CpuFenceWait( (CpuFence*)pFence, qwValue );
+}
+
+void BenchTimelineSetEvent( void *pContext, void *pEvent )
+{
+	CpuEventSet( (CpuEvent*)pEvent );
+}
+
+void BenchTimelineWaitEvent( void *pContext, void *pEvent )
+{
+	CpuEventWait( (CpuEvent*)pEvent );
+}
+
+typedef struct BenchTimelineJob
+{
+	u32 input[BENCH_TIMELINE_VALUES];
+	u32 gpuInput[BENCH_TIMELINE_VALUES];
+	u32 gpuOutput[BENCH_TIMELINE_VALUES];
+	u32 readback[BENCH_TIMELINE_VALUES];
+	u32 dwJob;
+	u32 dwChecksum;
+} BenchTimelineJob;
+
+typedef struct BenchTimelineShared
+{
+	BenchTimelineQueue copyQueue;
+	BenchTimelineQueue computeQueue;
+	FenceTimeline timeline;
+	CpuEvent wakeEvent;
+	std::atomic<u32> dwRemaining;
+	std::atomic<u32> dwMismatches;
+	CpuEvent doneEvent;
+} BenchTimelineShared;
+
+void BenchTimelineUpload( void *pContext )
+{
+	BenchTimelineJob *pJob = (BenchTimelineJob*)pContext;
+	memcpy( pJob->gpuInput, pJob->input, sizeof(pJob->input) );
+}
+
+//same math as ComputeShaderMainCpu
+void BenchTimelineCompute( void *pContext )
+{
+	BenchTimelineJob *pJob = (BenchTimelineJob*)pContext;
+	for( u32 dwIdx = 0; dwIdx < BENCH_TIMELINE_VALUES; ++dwIdx )
+	{
+		pJob->gpuOutput[dwIdx] = 2 * pJob->gpuInput[dwIdx];
+	}
+}
+
+void BenchTimelineReadback( void *pContext )
+{
+	BenchTimelineJob *pJob = (BenchTimelineJob*)pContext;
+	memcpy( pJob->readback, pJob->gpuOutput, sizeof(pJob->readback) );
+}
+
+void BenchTimelinePostProcess( BenchTimelineShared *pShared, BenchTimelineJob *pJob )
+{
+	u32 dwMismatches = 0;
+	for( u32 dwIdx = 0; dwIdx < BENCH_TIMELINE_VALUES; ++dwIdx )
+	{
+		pJob->dwChecksum += pJob->readback[dwIdx];
+		dwMismatches += pJob->readback[dwIdx] != 2 * ( pJob->dwJob + dwIdx );
+	}
+	pShared->dwMismatches += dwMismatches;
+}
+
+//upload -> compute -> readback -> post process, every arrow is a fence wait that doesn't hold a thread
+FenceTimelineJob BenchTimelineRunJob( BenchTimelineShared *pShared, BenchTimelineJob *pJob )
+{
+	u64 qwValue = BenchTimelineSubmit( &pShared->copyQueue, BenchTimelineUpload, pJob );
+	co_await FenceTimelineAwait( &pShared->timeline, &pShared->copyQueue.fence, qwValue );
+	qwValue = BenchTimelineSubmit( &pShared->computeQueue, BenchTimelineCompute, pJob );
+	co_await FenceTimelineAwait( &pShared->timeline, &pShared->computeQueue.fence, qwValue );
+	qwValue = BenchTimelineSubmit( &pShared->copyQueue, BenchTimelineReadback, pJob );
+	co_await FenceTimelineAwait( &pShared->timeline, &pShared->copyQueue.fence, qwValue );
+	BenchTimelinePostProcess( pShared, pJob );
+	if( --pShared->dwRemaining == 0 )
+	{
+		CpuEventSet( &pShared->doneEvent );
+	}
+}
+
+//the same chain with a blocking wait per step, so one os thread per job in flight
+void BenchTimelineRunJobBlocking( BenchTimelineShared *pShared, BenchTimelineJob *pJob )
+{
+	CpuFenceWait( &pShared->copyQueue.fence, BenchTimelineSubmit( &pShared->copyQueue, BenchTimelineUpload, pJob ) );
+	CpuFenceWait( &pShared->computeQueue.fence, BenchTimelineSubmit( &pShared->computeQueue, BenchTimelineCompute, pJob ) );
+	CpuFenceWait( &pShared->copyQueue.fence, BenchTimelineSubmit( &pShared->copyQueue, BenchTimelineReadback, pJob ) );
+	BenchTimelinePostProcess( pShared, pJob );
+}
+
+void BenchTimelineInitShared( BenchTimelineShared *pShared, BenchTimelineJob *pJobs )
+{
+	InitCpuQueue( &pShared->copyQueue.queue );
+	InitCpuQueue( &pShared->computeQueue.queue );
+	InitCpuFence( &pShared->copyQueue.fence, 0 );
+	InitCpuFence( &pShared->computeQueue.fence, 0 );
+	pShared->copyQueue.qwFenceValue = 0;
+	pShared->computeQueue.qwFenceValue = 0;
+	pShared->dwRemaining = BENCH_TIMELINE_JOBS;
+	pShared->dwMismatches = 0;
+	InitCpuEvent( &pShared->doneEvent );
+	InitCpuEvent( &pShared->wakeEvent );
+	for( u32 dwJob = 0; dwJob < BENCH_TIMELINE_JOBS; ++dwJob )
+	{
+		pJobs[dwJob].dwJob = dwJob;
+		pJobs[dwJob].dwChecksum = 0;
+		for( u32 dwIdx = 0; dwIdx < BENCH_TIMELINE_VALUES; ++dwIdx )
+		{
+			pJobs[dwJob].input[dwIdx] = dwJob + dwIdx;
+		}
+	}
+}
+
+void BenchFenceTimeline()
+{
+	BenchTimelineJob *pJobs = (BenchTimelineJob*)malloc( BENCH_TIMELINE_JOBS * sizeof(BenchTimelineJob) );
+	printf( "\nfence timeline, %u independent upload -> compute -> readback -> post process jobs\n", BENCH_TIMELINE_JOBS );
+
+	BenchTimelineShared *pShared = new BenchTimelineShared;
+	BenchTimelineInitShared( pShared, pJobs );
+	FenceTimelineCallbacks callbacks;
+	callbacks.pfnCompletedValue = BenchTimelineCompletedValue;
+	callbacks.pfnSetEventOnCompletion = BenchTimelineSetEventOnCompletion;
+	callbacks.pfnWait = BenchTimelineWait;
+	callbacks.pfnSetEvent = BenchTimelineSetEvent;
+	callbacks.pfnWaitEvent = BenchTimelineWaitEvent;
+	callbacks.pContext = NULL;
+	InitFenceTimeline( &pShared->timeline, &callbacks, &pShared->wakeEvent );
+	u64 qwStart = GetTimeNs();
+	for( u32 dwJob = 0; dwJob < BENCH_TIMELINE_JOBS; ++dwJob )
+	{
+		BenchTimelineRunJob( pShared, &pJobs[dwJob] );
+	}
+	CpuEventWait( &pShared->doneEvent );
+	u64 qwNs = GetTimeNs() - qwStart;
+	DestroyFenceTimeline( &pShared->timeline );
+	printf( "coroutines:     %7.3f ms, 1 waiter thread, %llu resumes from %llu wakes, %u mismatches\n", qwNs / 1e6,
+			(unsigned long long)pShared->timeline.qwResumedCount, (unsigned long long)pShared->timeline.qwWakeCount, pShared->dwMismatches.load() );
+	DestroyCpuQueue( &pShared->copyQueue.queue );
+	DestroyCpuQueue( &pShared->computeQueue.queue );
+	delete pShared;
+
+	pShared = new BenchTimelineShared;
+	BenchTimelineInitShared( pShared, pJobs );
+	std::thread *pThreads = new std::thread[BENCH_TIMELINE_JOBS];
+	qwStart = GetTimeNs();
+	for( u32 dwJob = 0; dwJob < BENCH_TIMELINE_JOBS; ++dwJob )
+	{
+		pThreads[dwJob] = std::thread( BenchTimelineRunJobBlocking, pShared, &pJobs[dwJob] );
+	}
+	for( u32 dwJob = 0; dwJob < BENCH_TIMELINE_JOBS; ++dwJob )
+	{
+		pThreads[dwJob].join();
+	}
+	qwNs = GetTimeNs() - qwStart;
+	printf( "thread per job: %7.3f ms, %u waiting threads, %u mismatches\n", qwNs / 1e6, BENCH_TIMELINE_JOBS, pShared->dwMismatches.load() );
+	delete[] pThreads;
+	DestroyCpuQueue( &pShared->copyQueue.queue );
+	DestroyCpuQueue( &pShared->computeQueue.queue );
+	delete pShared;
+	free( pJobs );
+}
+
+#define BENCH_BARRIER_FRAMES 64
+#define BENCH_BARRIER_DISPATCHES 512 //per frame, all recorded into one compute list
+#define BENCH_BARRIER_CHAINS 8       //independent ping pong passes interleaved in the list
+#define BENCH_BARRIER_COPY_EVERY 64  //dispatches between copies of every chain output
+#define BENCH_BARRIER_RESOURCES ( BENCH_BARRIER_CHAINS * 2 + 2 )
+#define BENCH_BARRIER_MAX_USES 3
+
+//one Dispatch or Copy and the resources it declares, resource 0 is the model buffer, 1 a histogram every 4th dispatch accumulates into
+typedef struct BenchBarrierCommand
+{
+	u32 dwUseCount;
+	u32 resources[BENCH_BARRIER_MAX_USES];
+	u32 states[BENCH_BARRIER_MAX_USES];
+} BenchBarrierCommand;
+
+u32 BenchBarrierFrame( BenchBarrierCommand *pCommands )
+{
+	u32 dwCount = 0;
+	for( u32 dwDispatch = 0; dwDispatch < BENCH_BARRIER_DISPATCHES; ++dwDispatch )
+	{
+		const u32 dwChain = dwDispatch % BENCH_BARRIER_CHAINS;
+		const u32 dwPing = ( dwDispatch / BENCH_BARRIER_CHAINS ) & 1;
+		BenchBarrierCommand *pCommand = &pCommands[dwCount++];
+		pCommand->dwUseCount = 3;
+		pCommand->resources[0] = 0;
+		pCommand->states[0] = TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE;
+		pCommand->resources[1] = 2 + dwChain * 2 + dwPing;
+		pCommand->states[1] = TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE;
+		pCommand->resources[2] = 2 + dwChain * 2 + ( dwPing ^ 1 );
+		pCommand->states[2] = TRACKED_STATE_UNORDERED_ACCESS;
+		if( ( dwDispatch & 3 ) == 3 )
+		{
+			pCommand->resources[0] = 1;
+			pCommand->states[0] = TRACKED_STATE_UNORDERED_ACCESS;
+		}
+		if( ( dwDispatch + 1 ) % BENCH_BARRIER_COPY_EVERY == 0 )
+		{
+			for( u32 dwCopy = 0; dwCopy < BENCH_BARRIER_CHAINS; ++dwCopy )
+			{
+				pCommand = &pCommands[dwCount++];
+				pCommand->dwUseCount = 1;
+				pCommand->resources[0] = 2 + dwCopy * 2 + ( ( ( dwDispatch / BENCH_BARRIER_CHAINS ) & 1 ) ^ 1 );
+				pCommand->states[0] = TRACKED_STATE_COPY_SOURCE;
+			}
+		}
+	}
+	return dwCount;
+}
+
+//applies the emitted barriers to what the device would see and checks every use finds its resource in a usable state
+//buffers start every list in COMMON, the first use promotes them (read states keep accumulating)
+bool BenchBarrierValidate( u32 *pDeviceStates, u32 *pUsedMask, const ResourceBarrierDesc *pBarriers, u32 dwBarrierCount, TrackedResource *pResources, const BenchBarrierCommand *pCommand )
+{
+	for( u32 dwBarrier = 0; dwBarrier < dwBarrierCount; ++dwBarrier )
+	{
+		const u32 dwResource = (u32)( (TrackedResource*)pBarriers[dwBarrier].pResource - pResources );
+		if( pBarriers[dwBarrier].eType == RESOURCE_BARRIER_TRANSITION )
+		{
+			if( pDeviceStates[dwResource] != pBarriers[dwBarrier].dwStateBefore )
+			{
+				return false;
+			}
+			pDeviceStates[dwResource] = pBarriers[dwBarrier].dwStateAfter;
+		}
+		pUsedMask[dwResource] |= 2; //a barrier ends the promotion window
+	}
+	for( u32 dwUse = 0; dwUse < pCommand->dwUseCount; ++dwUse )
+	{
+		const u32 dwResource = pCommand->resources[dwUse];
+		const u32 dwState = pCommand->states[dwUse];
+		u32 *pState = &pDeviceStates[dwResource];
+		if( *pState == TRACKED_STATE_COMMON || ( pUsedMask[dwResource] == 1 && TrackedStateIsReadOnly( *pState ) && TrackedStateIsReadOnly( dwState ) ) )
+		{
+			*pState |= dwState;
+		}
+		else if( ( *pState & dwState ) != dwState )
+		{
+			return false;
+		}
+		pUsedMask[dwResource] |= 1;
+	}
+	return true;
+}
+
+//hundreds of dispatches in one list, every transition written by hand as its own ResourceBarrier( 1, ... ) versus tracked and batched
+void BenchResourceStateTracker()
+{
+	BenchBarrierCommand *pCommands = (BenchBarrierCommand*)malloc( ( BENCH_BARRIER_DISPATCHES * 2 ) * sizeof(BenchBarrierCommand) );
+	const u32 dwCommandCount = BenchBarrierFrame( pCommands );
+	printf( "\nresource state tracker, %u dispatches + %u copies per list, %u lists\n", BENCH_BARRIER_DISPATCHES, dwCommandCount - BENCH_BARRIER_DISPATCHES, BENCH_BARRIER_FRAMES );
+
+	//hand written: whoever writes the list knows the previous state, but each transition is its own call and nothing relies on promotion
+	u32 handStates[BENCH_BARRIER_RESOURCES];
+	u32 dwHandCalls = 0;
+	for( u32 dwFrame = 0; dwFrame < BENCH_BARRIER_FRAMES; ++dwFrame )
+	{
+		for( u32 dwResource = 0; dwResource < BENCH_BARRIER_RESOURCES; ++dwResource )
+		{
+			handStates[dwResource] = dwResource == 0 ? TRACKED_STATE_COPY_DEST : TRACKED_STATE_UNORDERED_ACCESS;
+		}
+		for( u32 dwCommand = 0; dwCommand < dwCommandCount; ++dwCommand )
+		{
+			for( u32 dwUse = 0; dwUse < pCommands[dwCommand].dwUseCount; ++dwUse )
+			{
+				const u32 dwResource = pCommands[dwCommand].resources[dwUse];
+				dwHandCalls += handStates[dwResource] != pCommands[dwCommand].states[dwUse] || pCommands[dwCommand].states[dwUse] == TRACKED_STATE_UNORDERED_ACCESS;
+				handStates[dwResource] = pCommands[dwCommand].states[dwUse];
+			}
+		}
+	}
+
+	TrackedResource resources[BENCH_BARRIER_RESOURCES];
+	for( u32 dwResource = 0; dwResource < BENCH_BARRIER_RESOURCES; ++dwResource )
+	{
+		InitTrackedResource( &resources[dwResource], &resources[dwResource], TRACKED_STATE_COMMON, true );
+	}
+	ResourceStateTracker *pTracker = (ResourceStateTracker*)malloc( sizeof(ResourceStateTracker) );
+	InitResourceStateTracker( pTracker );
+	ResourceBarrierDesc barriers[RESOURCE_TRACKER_MAX_BARRIERS];
+	u32 dwInvalid = 0;
+	u64 qwStart = GetTimeNs();
+	for( u32 dwFrame = 0; dwFrame < BENCH_BARRIER_FRAMES; ++dwFrame )
+	{
+		u32 deviceStates[BENCH_BARRIER_RESOURCES] = {};
+		u32 usedMask[BENCH_BARRIER_RESOURCES] = {};
+		for( u32 dwCommand = 0; dwCommand < dwCommandCount; ++dwCommand )
+		{
+			for( u32 dwUse = 0; dwUse < pCommands[dwCommand].dwUseCount; ++dwUse )
+			{
+				TrackResourceState( pTracker, &resources[pCommands[dwCommand].resources[dwUse]], pCommands[dwCommand].states[dwUse] );
+			}
+			const u32 dwBarrierCount = FlushResourceBarriers( pTracker, barriers );
+			//only the first list is checked so the timing stays about the tracker
+			if( dwFrame == 0 && !BenchBarrierValidate( deviceStates, usedMask, barriers, dwBarrierCount, resources, &pCommands[dwCommand] ) )
+			{
+				++dwInvalid;
+			}
+		}
+		ResourceStateTrackerClose( pTracker );
+	}
+	u64 qwNs = GetTimeNs() - qwStart;
+
+	const ResourceStateTrackerStats *pStats = &pTracker->stats;
+	printf( "hand written: %6u ResourceBarrier calls per list, 1 barrier each\n", dwHandCalls / BENCH_BARRIER_FRAMES );
+	printf( "tracked:      %6u ResourceBarrier calls per list, %u barriers, %u promotions and %u redundant transitions dropped, %.1f ns per declared use, %u invalid\n",
+			pStats->dwBarrierCalls / BENCH_BARRIER_FRAMES, pStats->dwEmittedBarriers / BENCH_BARRIER_FRAMES, pStats->dwImplicitPromotions / BENCH_BARRIER_FRAMES,
+			pStats->dwDroppedTransitions / BENCH_BARRIER_FRAMES, (f64)qwNs / pStats->dwDeclaredUses, dwInvalid );
+	free( pTracker );
+	free( pCommands );
+}
+
+#define BENCH_BATCH_JOBS 16384
+#define BENCH_BATCH_ARRIVAL_NS 4000   //a job every 4 us, 250k jobs/s offered
+#define BENCH_BATCH_DEADLINE_US 500
+#define BENCH_BATCH_SUBMIT_CPU_US 10  //ExecuteCommandLists + Signal on the submitting thread
+#define BENCH_BATCH_RECORD_CPU_NS 300 //recording one dispatch
+#define BENCH_BATCH_LIST_DEVICE_US 30 //fixed cost of a command list on the queue
+#define BENCH_BATCH_JOB_DEVICE_NS 1000
+#define BENCH_BATCH_CONTEXTS 256      //more than the batches the cpu queue can hold
+
+//the command list of one batch, alive until the queue ran it
+typedef struct BenchBatchList
+{
+	SubmissionJob jobs[SUBMISSION_BATCHER_MAX_JOBS];
+	u32 dwJobCount;
+	u64 qwFirstTicket;
+	u64 *pDoneNs;
+} BenchBatchList;
+
+typedef struct BenchBatchContext
+{
+	SubmissionBatcher batcher;
+	CpuQueue queue;
+	CpuFence fence;
+	u64 qwFenceValue;
+	BenchBatchList lists[BENCH_BATCH_CONTEXTS];
+	u64 *pEnqueueNs;
+	u64 *pDoneNs;
+	ModelOutData *pOutputs;
+} BenchBatchContext;
+
+//same math as ComputeShaderMainCpu, one job per dispatch, the device time is one sleep per list
+void BenchBatchExecute( void *pContext )
+{
+	BenchBatchList *pList = (BenchBatchList*)pContext;
+	std::this_thread::sleep_for( std::chrono::nanoseconds( BENCH_BATCH_LIST_DEVICE_US * 1000ull + pList->dwJobCount * (u64)BENCH_BATCH_JOB_DEVICE_NS ) );
+	for( u32 dwJob = 0; dwJob < pList->dwJobCount; ++dwJob )
+	{
+		ModelOutData *pOut = (ModelOutData*)pList->jobs[dwJob].pUav;
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			pOut->dwData[dwIdx] = 2 * pList->jobs[dwJob].constants.dwOffsetsAndStrides0[dwIdx];
+		}
+	}
+	const u64 qwNow = GetTimeNs();
+	for( u32 dwJob = 0; dwJob < pList->dwJobCount; ++dwJob )
+	{
+		pList->pDoneNs[pList->qwFirstTicket + dwJob] = qwNow;
+	}
+}
+
+u64 BenchBatchRecord( void *pContext, const SubmissionJob *pJobs, u32 dwJobCount )
+{
+	BenchBatchContext *pBatch = (BenchBatchContext*)pContext;
+	BenchBatchList *pList = &pBatch->lists[pBatch->batcher.qwBatchCount % BENCH_BATCH_CONTEXTS];
+	//the list is free again once the fence passed the batch that used it last
+	if( pBatch->qwFenceValue >= BENCH_BATCH_CONTEXTS )
+	{
+		CpuFenceWait( &pBatch->fence, pBatch->qwFenceValue + 1 - BENCH_BATCH_CONTEXTS );
+	}
+	memcpy( pList->jobs, pJobs, dwJobCount * sizeof(SubmissionJob) );
+	pList->dwJobCount = dwJobCount;
+	pList->qwFirstTicket = pBatch->batcher.qwNextTicket - dwJobCount;
+	pList->pDoneNs = pBatch->pDoneNs;
+	const u64 qwEnd = GetTimeNs() + BENCH_BATCH_SUBMIT_CPU_US * 1000ull + dwJobCount * (u64)BENCH_BATCH_RECORD_CPU_NS;
+	while( GetTimeNs() < qwEnd )
+	{
+	}
+	CpuQueueExecute( &pBatch->queue, BenchBatchExecute, pList );
+	CpuQueueSignal( &pBatch->queue, &pBatch->fence, ++pBatch->qwFenceValue );
+	return pBatch->qwFenceValue;
+}
+
+int BenchCompareU64( const void *pLeft, const void *pRight )
+{
+	const u64 qwLeft = *(const u64*)pLeft;
+	const u64 qwRight = *(const u64*)pRight;
+	return qwLeft < qwRight ? -1 : qwLeft > qwRight ? 1 : 0;
+}
+
+//an open loop stream of single dispatch jobs, batch size sweeps from one list per job up, the deadline caps the wait of a partial batch
+void BenchSubmissionBatcher()
+{
+	printf( "\nsubmission batching, %u jobs arriving every %.1f us, %u us deadline, %u us + %u ns per job to submit, %u us + %u ns per job on the queue\n",
+			BENCH_BATCH_JOBS, BENCH_BATCH_ARRIVAL_NS / 1e3, BENCH_BATCH_DEADLINE_US, BENCH_BATCH_SUBMIT_CPU_US, BENCH_BATCH_RECORD_CPU_NS,
+			BENCH_BATCH_LIST_DEVICE_US, BENCH_BATCH_JOB_DEVICE_NS );
+	BenchBatchContext *pBatch = new BenchBatchContext;
+	pBatch->pEnqueueNs = (u64*)malloc( ( BENCH_BATCH_JOBS + 1 ) * sizeof(u64) );
+	pBatch->pDoneNs = (u64*)malloc( ( BENCH_BATCH_JOBS + 1 ) * sizeof(u64) );
+	pBatch->pOutputs = (ModelOutData*)malloc( BENCH_BATCH_JOBS * sizeof(ModelOutData) );
+	u64 *pLatencies = (u64*)malloc( BENCH_BATCH_JOBS * sizeof(u64) );
+
+	const u32 batchSizes[] = { 1, 4, 16, 64, 256, 1024 };
+	for( u32 dwSize = 0; dwSize < sizeof(batchSizes) / sizeof(batchSizes[0]); ++dwSize )
+	{
+		InitCpuQueue( &pBatch->queue );
+		InitCpuFence( &pBatch->fence, 0 );
+		pBatch->qwFenceValue = 0;
+		InitSubmissionBatcher( &pBatch->batcher, batchSizes[dwSize], BENCH_BATCH_DEADLINE_US * 1000ull, BenchBatchRecord, pBatch );
+
+		const u64 qwStart = GetTimeNs();
+		for( u32 dwJob = 0; dwJob < BENCH_BATCH_JOBS; ++dwJob )
+		{
+			const u64 qwArrival = qwStart + dwJob * (u64)BENCH_BATCH_ARRIVAL_NS;
+			u64 qwNow = GetTimeNs();
+			while( qwNow < qwArrival )
+			{
+				SubmissionBatcherPoll( &pBatch->batcher, qwNow );
+				qwNow = GetTimeNs();
+			}
+			SubmissionJob job;
+			for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+			{
+				job.constants.dwOffsetsAndStrides0[dwIdx] = dwJob*4 + dwIdx;
+			}
+			job.pSrv = NULL;
+			job.pUav = &pBatch->pOutputs[dwJob];
+			job.dwGroupCount = 1;
+			//a late job arrived when it was due, not when the submitter got around to it
+			pBatch->pEnqueueNs[pBatch->batcher.qwNextTicket] = qwArrival;
+			SubmissionBatcherEnqueue( &pBatch->batcher, &job, qwNow );
+		}
+		//the tail waits for its deadline like any other partial batch
+		while( !SubmissionBatcherPoll( &pBatch->batcher, GetTimeNs() ) && pBatch->batcher.dwJobCount > 0 )
+		{
+		}
+		const u64 qwLastFenceValue = SubmissionBatcherFenceValue( &pBatch->batcher, BENCH_BATCH_JOBS );
+		CpuFenceWait( &pBatch->fence, qwLastFenceValue );
+		const u64 qwNs = GetTimeNs() - qwStart;
+		DestroyCpuQueue( &pBatch->queue );
+
+		u32 dwMismatches = qwLastFenceValue != pBatch->qwFenceValue;
+		f64 fLatencySum = 0.0;
+		for( u32 dwJob = 0; dwJob < BENCH_BATCH_JOBS; ++dwJob )
+		{
+			pLatencies[dwJob] = pBatch->pDoneNs[dwJob + 1] - pBatch->pEnqueueNs[dwJob + 1];
+			fLatencySum += (f64)pLatencies[dwJob];
+			dwMismatches += pBatch->pOutputs[dwJob].dwData[3] != 2 * ( dwJob*4 + 3 );
+		}
+		qsort( pLatencies, BENCH_BATCH_JOBS, sizeof(u64), BenchCompareU64 );
+		printf( "batch %4u: %5llu submits (%llu full, %llu deadline), %7.0f jobs/s, latency mean %8.1f us, p50 %8.1f us, p99 %8.1f us, %u mismatches\n",
+				batchSizes[dwSize], (unsigned long long)pBatch->batcher.qwBatchCount, (unsigned long long)pBatch->batcher.qwFullFlushes,
+				(unsigned long long)pBatch->batcher.qwDeadlineFlushes, BENCH_BATCH_JOBS / ( qwNs / 1e9 ), fLatencySum / BENCH_BATCH_JOBS / 1e3,
+				pLatencies[BENCH_BATCH_JOBS / 2] / 1e3, pLatencies[BENCH_BATCH_JOBS * 99 / 100] / 1e3, dwMismatches );
+	}
+
+	free( pLatencies );
+	free( pBatch->pOutputs );
+	free( pBatch->pDoneNs );
+	free( pBatch->pEnqueueNs );
+	delete pBatch;
+}
+
+#define BENCH_RECORD_FRAMES 256
+#define BENCH_RECORD_DISPATCHES 1024   //per frame, split over the workers
+#define BENCH_RECORD_CPU_NS 400        //root constants, bindings and barriers for one dispatch
+#define BENCH_RECORD_DEVICE_US 100     //queue time per frame
+#define BENCH_RECORD_ALLOCATORS 4      //per worker
+
+typedef struct BenchRecordedDispatch
+{
+	u32 dwItem;
+	ComputeShaderCB cb;
+} BenchRecordedDispatch;
+
+//stand in for a command allocator, the recorded commands live in it until it is reset
+typedef struct BenchCommandAllocator
+{
+	BenchRecordedDispatch commands[BENCH_RECORD_DISPATCHES];
+	u32 dwCount;
+} BenchCommandAllocator;
+
+//the lists of one frame in submission order
+typedef struct BenchRecordSubmit
+{
+	BenchCommandAllocator *pLists[PARALLEL_RECORD_MAX_WORKERS];
+	u32 dwListCount;
+	u32 *pNextItem;
+	u32 *pMismatches;
+} BenchRecordSubmit;
+
+typedef struct BenchRecordContext
+{
+	ParallelRecorder recorder;
+	CpuQueue queue;
+	CpuFence fence;
+	u64 qwFenceValue;
+	BenchCommandAllocator *pListAllocators[PARALLEL_RECORD_MAX_WORKERS]; //what each worker's list records into
+	BenchCommandAllocator *pAllocatorStorage;
+	std::atomic<u32> dwCreatedAllocators;
+	u32 dwFrame;
+	u32 dwNextItem; //only touched by the queue
+	u32 dwMismatches;
+	BenchRecordSubmit submits[BENCH_RECORD_FRAMES];
+} BenchRecordContext;
+
+void *BenchCreateCommandAllocator( void *pContext )
+{
+	BenchRecordContext *pRecord = (BenchRecordContext*)pContext;
+	const u32 dwAllocator = pRecord->dwCreatedAllocators++;
+	return dwAllocator < PARALLEL_RECORD_MAX_WORKERS * BENCH_RECORD_ALLOCATORS ? &pRecord->pAllocatorStorage[dwAllocator] : NULL;
+}
+
+void BenchRecordRange( void *pContext, u32 dwWorker, void *pAllocator, u32 dwBegin, u32 dwEnd )
+{
+	BenchRecordContext *pRecord = (BenchRecordContext*)pContext;
+	BenchCommandAllocator *pList = (BenchCommandAllocator*)pAllocator;
+	pList->dwCount = 0; //Reset
+	for( u32 dwItem = dwBegin; dwItem < dwEnd; ++dwItem )
+	{
+		const u64 qwEnd = GetTimeNs() + BENCH_RECORD_CPU_NS;
+		BenchRecordedDispatch *pDispatch = &pList->commands[pList->dwCount++];
+		pDispatch->dwItem = pRecord->dwFrame * BENCH_RECORD_DISPATCHES + dwItem;
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			pDispatch->cb.dwOffsetsAndStrides0[dwIdx] = pDispatch->dwItem*4 + dwIdx;
+		}
+		while( GetTimeNs() < qwEnd )
+		{
+		}
+	}
+	pRecord->pListAllocators[dwWorker] = pList;
+}
+
+u64 BenchRecordCompletedValue( void *pContext )
+{
+	return CpuFenceGetCompletedValue( &( (BenchRecordContext*)pContext )->fence );
+}
+
+void BenchRecordWait( void *pContext, u64 qwValue )
+{
+	CpuFenceWait( &( (BenchRecordContext*)pContext )->fence, qwValue );
+}
+
+//ExecuteCommandLists of every worker's list, the dispatches have to show up in item order
+void BenchRecordExecute( void *pContext )
+{
+	BenchRecordSubmit *pSubmit = (BenchRecordSubmit*)pContext;
+	for( u32 dwList = 0; dwList < pSubmit->dwListCount; ++dwList )
+	{
+		const BenchCommandAllocator *pList = pSubmit->pLists[dwList];
+		for( u32 dwCommand = 0; dwCommand < pList->dwCount; ++dwCommand )
+		{
+			const BenchRecordedDispatch *pDispatch = &pList->commands[dwCommand];
+			*pSubmit->pMismatches += pDispatch->dwItem != *pSubmit->pNextItem || pDispatch->cb.dwOffsetsAndStrides0[3] != pDispatch->dwItem*4 + 3;
+			++*pSubmit->pNextItem;
+		}
+	}
+	std::this_thread::sleep_for( std::chrono::microseconds( BENCH_RECORD_DEVICE_US ) );
+}
+
+//one frame of dispatches recorded by 1..n threads each with its own allocator pool, submitted in worker order
+void BenchParallelRecording()
+{
+	printf( "\nparallel recording, %u frames of %u dispatches at %u ns each, %u us per frame on the queue, %u allocators per worker, %u cores\n",
+			BENCH_RECORD_FRAMES, BENCH_RECORD_DISPATCHES, BENCH_RECORD_CPU_NS, BENCH_RECORD_DEVICE_US, BENCH_RECORD_ALLOCATORS, CpuComputeNumCores() );
+	BenchRecordContext *pRecord = new BenchRecordContext;
+	pRecord->pAllocatorStorage = new BenchCommandAllocator[PARALLEL_RECORD_MAX_WORKERS * BENCH_RECORD_ALLOCATORS];
+	f64 fSingleRate = 0.0;
+	for( u32 dwWorkers = 1; dwWorkers <= 8; dwWorkers *= 2 )
+	{
+		InitCpuQueue( &pRecord->queue );
+		InitCpuFence( &pRecord->fence, 0 );
+		pRecord->qwFenceValue = 0;
+		pRecord->dwCreatedAllocators = 0;
+		pRecord->dwNextItem = 0;
+		pRecord->dwMismatches = 0;
+		InitParallelRecorder( &pRecord->recorder, dwWorkers, BENCH_RECORD_ALLOCATORS, BenchCreateCommandAllocator, BenchRecordRange,
+							  BenchRecordCompletedValue, BenchRecordWait, pRecord );
+
+		const u64 qwStart = GetTimeNs();
+		for( pRecord->dwFrame = 0; pRecord->dwFrame < BENCH_RECORD_FRAMES; ++pRecord->dwFrame )
+		{
+			ParallelRecord( &pRecord->recorder, BENCH_RECORD_DISPATCHES, pRecord->qwFenceValue + 1 );
+			BenchRecordSubmit *pSubmit = &pRecord->submits[pRecord->dwFrame];
+			for( u32 dwWorker = 0; dwWorker < dwWorkers; ++dwWorker )
+			{
+				pSubmit->pLists[dwWorker] = pRecord->pListAllocators[dwWorker];
+			}
+			pSubmit->dwListCount = dwWorkers;
+			pSubmit->pNextItem = &pRecord->dwNextItem;
+			pSubmit->pMismatches = &pRecord->dwMismatches;
+			CpuQueueExecute( &pRecord->queue, BenchRecordExecute, pSubmit );
+			CpuQueueSignal( &pRecord->queue, &pRecord->fence, ++pRecord->qwFenceValue );
+		}
+		CpuFenceWait( &pRecord->fence, pRecord->qwFenceValue );
+		const u64 qwNs = GetTimeNs() - qwStart;
+		DestroyParallelRecorder( &pRecord->recorder );
+		DestroyCpuQueue( &pRecord->queue );
+
+		const f64 fRate = (f64)BENCH_RECORD_FRAMES * BENCH_RECORD_DISPATCHES / ( qwNs / 1e9 );
+		if( dwWorkers == 1 )
+		{
+			fSingleRate = fRate;
+		}
+		printf( "%u recording threads: %8.0f dispatches/s, %.2fx one thread, %u allocators created, %u pool waits, %u mismatches\n", dwWorkers, fRate,
+				fRate / fSingleRate, pRecord->dwCreatedAllocators.load(), pRecord->recorder.dwFenceWaits,
+				pRecord->dwMismatches + ( pRecord->dwNextItem != BENCH_RECORD_FRAMES * BENCH_RECORD_DISPATCHES ) );
+	}
+	delete[] pRecord->pAllocatorStorage;
+	delete pRecord;
+}
+
+#define BENCH_SCAN_COUNT ( 1u << 24 )
+#define BENCH_SCAN_SEGMENT_MEAN 64 //elements per segment on average
+
+//sequential scan to check the passes against
+void BenchScanReference( const u32 *pValues, const u32 *pHeads, u32 dwCount, u32 dwFlags, u32 *pOut )
+{
+	u32 dwRunning = 0;
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		if( pHeads && pHeads[dwIdx] )
+		{
+			dwRunning = 0;
+		}
+		pOut[dwIdx] = ( dwFlags & SCAN_FLAG_INCLUSIVE ) ? dwRunning + pValues[dwIdx] : dwRunning;
+		dwRunning += pValues[dwIdx];
+	}
+}
+
+//device wide scan/reduce on 1..n workers, GB/s counts the bytes of input (values and heads) once
+void BenchScan()
+{
+	//t0 holds the values then the head flags, like a ByteAddressBuffer with two offsets
+	u32 *pInput = (u32*)malloc( (u64)BENCH_SCAN_COUNT * 2 * sizeof(u32) );
+	u32 *pOut = (u32*)malloc( (u64)BENCH_SCAN_COUNT * sizeof(u32) );
+	u32 *pReference = (u32*)malloc( (u64)BENCH_SCAN_COUNT * sizeof(u32) );
+	u8 *pPartials = (u8*)malloc( ScanScratchSize( BENCH_SCAN_COUNT ) );
+	u32 *pHeads = pInput + BENCH_SCAN_COUNT;
+	u32 dwState = 11;
+	u32 dwTotal = 0;
+	for( u32 dwIdx = 0; dwIdx < BENCH_SCAN_COUNT; ++dwIdx )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		pInput[dwIdx] = dwState; //full range so the sums wrap
+		pHeads[dwIdx] = ( dwState >> 7 ) % BENCH_SCAN_SEGMENT_MEAN == 0;
+		dwTotal += dwState;
+	}
+
+	ScanKernels kernels;
+	InitScanKernels( &kernels );
+	CpuComputeRootArgs root;
+	memset( &root, 0, sizeof(CpuComputeRootArgs) );
+	root.pVerticesAndIndices = (const u8*)pInput;
+	root.qwVerticesAndIndicesSize = (u64)BENCH_SCAN_COUNT * 2 * sizeof(u32);
+	root.pUavs[0] = (u8*)pOut;
+	root.pUavs[1] = pPartials;
+
+	typedef struct BenchScanMode
+	{
+		const char *pName;
+		u32 dwHeadsOffset;
+		u32 dwFlags;
+		bool bReduce;
+	} BenchScanMode;
+	const BenchScanMode modes[] =
+	{
+		{ "reduce", SCAN_NO_SEGMENTS, 0, true },
+		{ "exclusive scan", SCAN_NO_SEGMENTS, 0, false },
+		{ "inclusive scan", SCAN_NO_SEGMENTS, SCAN_FLAG_INCLUSIVE, false },
+		{ "segmented exclusive scan", BENCH_SCAN_COUNT * sizeof(u32), 0, false },
+		{ "segmented inclusive scan", BENCH_SCAN_COUNT * sizeof(u32), SCAN_FLAG_INCLUSIVE, false },
+	};
+
+	printf( "\nscan, %u u32s (%u MB), segments of %u on average\n", BENCH_SCAN_COUNT, (u32)( (u64)BENCH_SCAN_COUNT * sizeof(u32) >> 20 ), BENCH_SCAN_SEGMENT_MEAN );
+	printf( "%-26s %8s %10s %10s %10s\n", "", "workers", "ms", "GB/s", "result" );
+	const u32 dwNumCores = CpuComputeNumCores();
+	for( u32 dwWorkers = 1; ; dwWorkers = dwWorkers*2 < dwNumCores ? dwWorkers*2 : dwNumCores )
+	{
+		CpuComputeDevice *pDevice = new CpuComputeDevice;
+		if( !InitCpuComputeDevice( pDevice, dwWorkers ) )
+		{
+			printf( "Failed to create cpu compute device!\n" );
+			delete pDevice;
+			break;
+		}
+		for( u32 dwMode = 0; dwMode < sizeof(modes)/sizeof(modes[0]); ++dwMode )
+		{
+			const BenchScanMode *pMode = &modes[dwMode];
+			root.cb = MakeScanCB( 0, BENCH_SCAN_COUNT, pMode->dwHeadsOffset, pMode->dwFlags );
+			f64 fBestMs = 1e30;
+			u32 dwReduced = 0;
+			for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+			{
+				u64 qwStart = GetTimeNs();
+				if( pMode->bReduce )
+				{
+					dwReduced = CpuReduce( pDevice, &kernels, &root );
+				}
+				else
+				{
+					CpuScan( pDevice, &kernels, &root );
+				}
+				f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+				fBestMs = fMs < fBestMs ? fMs : fBestMs;
+			}
+
+			bool bMatch;
+			if( pMode->bReduce )
+			{
+				bMatch = dwReduced == dwTotal;
+			}
+			else
+			{
+				BenchScanReference( pInput, pMode->dwHeadsOffset == SCAN_NO_SEGMENTS ? NULL : pHeads, BENCH_SCAN_COUNT, pMode->dwFlags, pReference );
+				bMatch = memcmp( pOut, pReference, (u64)BENCH_SCAN_COUNT * sizeof(u32) ) == 0;
+			}
+			const u64 qwBytes = (u64)BENCH_SCAN_COUNT * sizeof(u32) * ( pMode->dwHeadsOffset == SCAN_NO_SEGMENTS ? 1 : 2 );
+			printf( "%-26s %8u %10.3f %10.2f %10s\n", pMode->pName, dwWorkers, fBestMs, qwBytes / ( fBestMs * 1e6 ), bMatch ? "ok" : "MISMATCH" );
+		}
+		DestroyCpuComputeDevice( pDevice );
+		delete pDevice;
+		if( dwWorkers == dwNumCores )
+		{
+			break;
+		}
+	}
+	free( pInput );
+	free( pOut );
+	free( pReference );
+	free( pPartials );
+}
+
+#define BENCH_RADIX_MAX_KEYS 100000000
+#define BENCH_RADIX_MAX_KEYS64 10000000 //u64 keys with payloads and the std::sort copy need 4x the memory
+
+typedef struct BenchKey64
+{
+	u64 qwKey;
+	u32 dwPayload;
+} BenchKey64;
+
+//payloads are the original indices, so the sort is right when every key went with its payload and equal keys kept their order
+bool BenchRadixCheck( const u32 *pKeys, const u32 *pPayload, const u32 *pOriginalKeys, u32 dwCount, bool bKey64 )
+{
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		u64 qwKey = bKey64 ? ( (const u64*)pKeys )[dwIdx] : pKeys[dwIdx];
+		u64 qwOriginal = bKey64 ? ( (const u64*)pOriginalKeys )[pPayload[dwIdx]] : pOriginalKeys[pPayload[dwIdx]];
+		if( qwKey != qwOriginal )
+		{
+			return false;
+		}
+		if( dwIdx > 0 )
+		{
+			u64 qwPrev = bKey64 ? ( (const u64*)pKeys )[dwIdx - 1] : pKeys[dwIdx - 1];
+			if( qwPrev > qwKey || ( qwPrev == qwKey && pPayload[dwIdx - 1] > pPayload[dwIdx] ) )
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//1K to 100M keys with u32 payloads on every core, against std::sort of the same (key, payload) pairs
+void BenchRadixSort()
+{
+	CpuComputeDevice *pDevice = new CpuComputeDevice;
+	if( !InitCpuComputeDevice( pDevice, 0 ) )
+	{
+		printf( "Failed to create cpu compute device!\n" );
+		delete pDevice;
+		return;
+	}
+	RadixSortKernels kernels;
+	InitRadixSortKernels( &kernels );
+
+	printf( "\nradix sort with u32 payloads, %u workers\n", pDevice->dwNumWorkers );
+	printf( "%10s %6s %12s %12s %12s %10s %8s %8s\n", "keys", "key", "radix ms", "Mkeys/s", "std::sort ms", "speedup", "skipped", "result" );
+	for( u32 dwKeyBits = 32; dwKeyBits <= 64; dwKeyBits += 32 )
+	{
+		const bool bKey64 = dwKeyBits == 64;
+		const u32 dwKeyWords = bKey64 ? 2 : 1;
+		for( u32 dwCount = 1000; dwCount <= ( bKey64 ? BENCH_RADIX_MAX_KEYS64 : BENCH_RADIX_MAX_KEYS ); dwCount *= 10 )
+		{
+			RadixSortBuffers buffers;
+			u32 *pOriginal = (u32*)malloc( (u64)dwCount * dwKeyWords * sizeof(u32) );
+			buffers.pKeys = (u32*)malloc( (u64)dwCount * dwKeyWords * sizeof(u32) );
+			buffers.pKeysAlt = (u32*)malloc( (u64)dwCount * dwKeyWords * sizeof(u32) );
+			buffers.pPayload = (u32*)malloc( (u64)dwCount * sizeof(u32) );
+			buffers.pPayloadAlt = (u32*)malloc( (u64)dwCount * sizeof(u32) );
+			buffers.pBlockHistograms = (u32*)malloc( (u64)RadixHistogramCount( dwCount, RADIX_CPU_TILE ) * sizeof(u32) );
+			buffers.pDigitOffsets = (u32*)malloc( (u64)RadixHistogramCount( dwCount, RADIX_CPU_TILE ) * sizeof(u32) );
+			buffers.pScanPartials = (u8*)malloc( RadixScanScratchSize( dwCount, RADIX_CPU_TILE ) );
+			if( !pOriginal || !buffers.pKeys || !buffers.pKeysAlt || !buffers.pPayload || !buffers.pPayloadAlt )
+			{
+				printf( "%10u %6u out of memory\n", dwCount, dwKeyBits );
+			}
+			else
+			{
+				//depth/material style keys: the top bits are mostly the same, so the last pass of u32 keys is skipped
+				u64 qwState = 0x9E3779B97F4A7C15ull;
+				for( u32 dwIdx = 0; dwIdx < dwCount * dwKeyWords; ++dwIdx )
+				{
+					qwState = qwState * 6364136223846793005ull + 1442695040888963407ull;
+					pOriginal[dwIdx] = bKey64 ? (u32)( qwState >> 32 ) : (u32)( qwState >> 40 );
+				}
+				memcpy( buffers.pKeys, pOriginal, (u64)dwCount * dwKeyWords * sizeof(u32) );
+				for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+				{
+					buffers.pPayload[dwIdx] = dwIdx;
+				}
+
+				RadixSortStats stats;
+				u64 qwStart = GetTimeNs();
+				CpuRadixSort( pDevice, &kernels, &buffers, 0, dwCount, bKey64, &stats );
+				f64 fRadixMs = ( GetTimeNs() - qwStart ) / 1e6;
+				bool bMatch = BenchRadixCheck( buffers.pKeys, buffers.pPayload, pOriginal, dwCount, bKey64 );
+
+				//std::sort on (key, payload) gives the same order as a stable sort by key, reuses the alt buffers
+				f64 fStdMs;
+				if( bKey64 )
+				{
+					BenchKey64 *pPairs = (BenchKey64*)malloc( (u64)dwCount * sizeof(BenchKey64) );
+					for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+					{
+						pPairs[dwIdx].qwKey = ( (const u64*)pOriginal )[dwIdx];
+						pPairs[dwIdx].dwPayload = dwIdx;
+					}
+					qwStart = GetTimeNs();
+					std::sort( pPairs, pPairs + dwCount, []( const BenchKey64 &a, const BenchKey64 &b ) { return a.qwKey < b.qwKey || ( a.qwKey == b.qwKey && a.dwPayload < b.dwPayload ); } );
+					fStdMs = ( GetTimeNs() - qwStart ) / 1e6;
+					for( u32 dwIdx = 0; dwIdx < dwCount && bMatch; ++dwIdx )
+					{
+						bMatch = pPairs[dwIdx].dwPayload == buffers.pPayload[dwIdx];
+					}
+					free( pPairs );
+				}
+				else
+				{
+					u64 *pPairs = (u64*)malloc( (u64)dwCount * sizeof(u64) );
+					for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+					{
+						pPairs[dwIdx] = ( (u64)pOriginal[dwIdx] << 32 ) | dwIdx;
+					}
+					qwStart = GetTimeNs();
+					std::sort( pPairs, pPairs + dwCount );
+					fStdMs = ( GetTimeNs() - qwStart ) / 1e6;
+					for( u32 dwIdx = 0; dwIdx < dwCount && bMatch; ++dwIdx )
+					{
+						bMatch = (u32)pPairs[dwIdx] == buffers.pPayload[dwIdx];
+					}
+					free( pPairs );
+				}
+				printf( "%10u %6u %12.3f %12.1f %12.3f %10.2f %5u/%u %8s\n", dwCount, dwKeyBits, fRadixMs, dwCount / ( fRadixMs * 1e3 ), fStdMs, fStdMs / fRadixMs,
+						stats.dwSkippedPasses, stats.dwPasses, bMatch ? "ok" : "MISMATCH" );
+			}
+			free( pOriginal );
+			free( buffers.pKeys );
+			free( buffers.pKeysAlt );
+			free( buffers.pPayload );
+			free( buffers.pPayloadAlt );
+			free( buffers.pBlockHistograms );
+			free( buffers.pDigitOffsets );
+			free( buffers.pScanPartials );
+		}
+	}
+	DestroyCpuComputeDevice( pDevice );
+	delete pDevice;
+}
+
+#define BENCH_CULL_INSTANCES 1000000
+
+//1M instances scattered around a camera at the origin, the AVX2 path against the scalar one on 1 worker and on every core
+void BenchCulling()
+{
+	const u32 dwCount = BENCH_CULL_INSTANCES;
+	f32 *pSpheres = (f32*)malloc( (u64)dwCount * 16 );
+	f32 *pBoxes = (f32*)malloc( (u64)dwCount * 32 );
+	u8 *pScratch = (u8*)malloc( CullScratchSize( dwCount ) );
+	u8 *pList = (u8*)malloc( CullListSize( dwCount ) );
+	u8 *pReferenceList = (u8*)malloc( CullListSize( dwCount ) );
+	u32 dwState = 1;
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		f32 pos[4];
+		for( u32 dwAxis = 0; dwAxis < 4; ++dwAxis )
+		{
+			dwState = dwState * 1664525u + 1013904223u;
+			pos[dwAxis] = ( dwState >> 8 ) / (f32)( 1 << 24 );
+		}
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			pSpheres[dwIdx * 4 + dwAxis] = pos[dwAxis] * 1000.f - 500.f;
+			pBoxes[dwIdx * 8 + dwAxis] = pos[dwAxis] * 1000.f - 500.f;
+			pBoxes[dwIdx * 8 + 4 + dwAxis] = 0.25f + pos[3] * ( dwAxis + 1 );
+		}
+		pSpheres[dwIdx * 4 + 3] = 0.5f + pos[3] * 2.f;
+		pBoxes[dwIdx * 8 + 3] = 0.f;
+		pBoxes[dwIdx * 8 + 7] = 0.f;
+	}
+
+	Mat4f view;
+	Mat4f proj;
+	Mat4f viewProj;
+	Quatf rot;
+	Vec3f axis = { { { 0.f, 1.f, 0.f } } };
+	Vec3f pos = { { { 0.f, 0.f, 0.f } } };
+	InitUnitQuatf( &rot, 30.f, &axis );
+	InitViewMat4ByQuatf( &view, &rot, &pos );
+	InitPerspectiveProjectionMat4fDirectXRH( &proj, 1920, 1080, 90.f, 59.f, 0.1f, 1000.f );
+	Mat4fMult( &view, &proj, &viewProj );
+	Vec4f planes[6];
+	ExtractFrustumPlanesMat4f( &viewProj, planes );
+
+	CullKernels kernels;
+	InitCullKernels( &kernels );
+	printf( "\nfrustum culling of %u instances, target 1 ms\n", dwCount );
+	printf( "%8s %8s %8s %10s %10s %12s %8s\n", "shape", "path", "workers", "ms", "Minst/s", "visible", "result" );
+	for( u32 dwShape = CULL_SHAPE_SPHERE; dwShape <= CULL_SHAPE_AABB; ++dwShape )
+	{
+		const void *pBounds = dwShape == CULL_SHAPE_AABB ? (const void*)pBoxes : (const void*)pSpheres;
+		u32 dwWorkerCounts[2] = { 1, CpuComputeNumCores() };
+		for( u32 dwRun = 0; dwRun < ( dwWorkerCounts[1] > 1 ? 2u : 1u ); ++dwRun )
+		{
+			CpuComputeDevice *pDevice = new CpuComputeDevice;
+			if( !InitCpuComputeDevice( pDevice, dwWorkerCounts[dwRun] ) )
+			{
+				printf( "Failed to create cpu compute device!\n" );
+				delete pDevice;
+				break;
+			}
+			for( u32 dwFlags = CULL_CPU_FLAG_SCALAR; ; dwFlags = 0 )
+			{
+				u8 *pOut = dwFlags ? pReferenceList : pList;
+				u32 dwVisible = 0;
+				f64 fBestMs = 1e30;
+				for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+				{
+					u64 qwStart = GetTimeNs();
+					dwVisible = CpuCullInstances( pDevice, &kernels, planes, pBounds, 0, dwCount, dwShape, dwFlags, pScratch, pOut );
+					f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+					fBestMs = fMs < fBestMs ? fMs : fBestMs;
+				}
+				//the scalar path is the reference, the AVX2 one has to give the same list
+				const bool bMatch = dwFlags || memcmp( pList, pReferenceList, CullListSize( dwVisible ) ) == 0;
+				printf( "%8s %8s %8u %10.3f %10.1f %12u %8s\n", dwShape == CULL_SHAPE_AABB ? "aabb" : "sphere", dwFlags ? "scalar" : "avx2",
+						pDevice->dwNumWorkers, fBestMs, dwCount / ( fBestMs * 1e3 ), dwVisible, bMatch ? "ok" : "MISMATCH" );
+				if( !dwFlags )
+				{
+					break;
+				}
+			}
+			DestroyCpuComputeDevice( pDevice );
+			delete pDevice;
+		}
+	}
+	free( pSpheres );
+	free( pBoxes );
+	free( pScratch );
+	free( pList );
+	free( pReferenceList );
+}
+
+//displaced dwSide x dwSide grid, 2 triangles per cell, in the verticesAndIndices layout of the built in meshes
+bool BenchMakeGridMesh( u32 dwSide, MeshData *pMesh )
+{
+	const u32 dwRow = dwSide + 1;
+	if( !AllocMeshData( pMesh, dwRow * dwRow, MODEL_VERTEX_STRIDE, dwSide * dwSide * 6 ) )
+	{
+		return false;
+	}
+	for( u32 dwZ = 0; dwZ < dwRow; ++dwZ )
+	{
+		for( u32 dwX = 0; dwX < dwRow; ++dwX )
+		{
+			f32 *pVertex = (f32*)( pMesh->pVertices + (u64)( dwZ * dwRow + dwX ) * MODEL_VERTEX_STRIDE );
+			memset( pVertex, 0, MODEL_VERTEX_STRIDE );
+			pVertex[0] = (f32)dwX - dwSide * 0.5f;
+			pVertex[1] = 8.f * sinf( dwX * 0.05f ) * cosf( dwZ * 0.07f );
+			pVertex[2] = (f32)dwZ - dwSide * 0.5f;
+			pVertex[4] = 1.f;
+		}
+	}
+	u32 *pIndex = pMesh->pIndices;
+	for( u32 dwZ = 0; dwZ < dwSide; ++dwZ )
+	{
+		for( u32 dwX = 0; dwX < dwSide; ++dwX )
+		{
+			const u32 dwCorner = dwZ * dwRow + dwX;
+			*pIndex++ = dwCorner;
+			*pIndex++ = dwCorner + dwRow;
+			*pIndex++ = dwCorner + 1;
+			*pIndex++ = dwCorner + 1;
+			*pIndex++ = dwCorner + dwRow;
+			*pIndex++ = dwCorner + dwRow + 1;
+		}
+	}
+	return true;
+}
+
+//built in meshes one bvh each, then grids up to 4M triangles, full rebuilds and refits on their own
+void BenchBvh()
+{
+	CpuComputeDevice *pDevice = new CpuComputeDevice;
+	if( !InitCpuComputeDevice( pDevice, 0 ) )
+	{
+		printf( "Failed to create cpu compute device!\n" );
+		delete pDevice;
+		return;
+	}
+	BvhKernels kernels;
+	InitBvhKernels( &kernels );
+
+	MeshData builtinMeshes[BUILTIN_MESH_COUNT];
+	MeshPackEntry entries[BUILTIN_MESH_COUNT];
+	u8 *pBuiltinBlob = NULL;
+	u64 qwBuiltinSize = 0;
+	if( OptimizeBuiltinMeshes( builtinMeshes ) )
+	{
+		qwBuiltinSize = PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, NULL, NULL );
+		pBuiltinBlob = (u8*)malloc( qwBuiltinSize );
+		PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, pBuiltinBlob, entries );
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_PLANE] );
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_CUBE] );
+	}
+
+	printf( "\nlbvh build, %u workers\n", pDevice->dwNumWorkers );
+	printf( "%10s %10s %12s %10s %10s %10s %10s %10s %8s\n", "mesh", "triangles", "build ms", "ms/Mtri", "morton ms", "sort ms", "emit ms", "refit ms", "result" );
+	const u32 gridSides[] = { 0, 0, 224, 708, 1415 }; //the built in plane and cube, then ~100K, 1M and 4M triangles
+	for( u32 dwMesh = 0; dwMesh < sizeof(gridSides) / sizeof(gridSides[0]); ++dwMesh )
+	{
+		const u8 *pVerticesAndIndices;
+		u64 qwSize;
+		ComputeShaderCB cb;
+		MeshData grid;
+		char name[32];
+		memset( &grid, 0, sizeof(MeshData) );
+		if( gridSides[dwMesh] == 0 )
+		{
+			if( !pBuiltinBlob )
+			{
+				continue;
+			}
+			const MeshPackEntry *pEntry = &entries[dwMesh == 0 ? BUILTIN_MESH_PLANE : BUILTIN_MESH_CUBE];
+			pVerticesAndIndices = pBuiltinBlob;
+			qwSize = qwBuiltinSize;
+			cb = MakeBvhCB( (u32)pEntry->qwVertexOffset, (u32)pEntry->qwIndexOffset, pEntry->dwIndexCount / 3, pEntry->dwVertexStride );
+			snprintf( name, sizeof(name), "%s", dwMesh == 0 ? "plane" : "cube" );
+		}
+		else
+		{
+			if( !BenchMakeGridMesh( gridSides[dwMesh], &grid ) )
+			{
+				printf( "%10s out of memory\n", "grid" );
+				continue;
+			}
+			pVerticesAndIndices = grid.pVertices;
+			qwSize = MeshDataSize( &grid );
+			cb = MakeBvhCB( 0, (u32)MeshDataVertexSize( &grid ), grid.dwIndexCount / 3, grid.dwVertexStride );
+			snprintf( name, sizeof(name), "grid%u", gridSides[dwMesh] );
+		}
+
+		const u32 dwTriangles = cb.dwOffsetsAndStrides0[2];
+		BvhBuildBuffers buffers;
+		if( AllocBvhBuildBuffers( dwTriangles, &buffers ) )
+		{
+			BvhBuildStats best;
+			memset( &best, 0, sizeof(BvhBuildStats) );
+			f64 fBestMs = 1e30;
+			for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+			{
+				BvhBuildStats stats;
+				u64 qwStart = GetTimeNs();
+				CpuBuildBvh( pDevice, &kernels, pVerticesAndIndices, qwSize, &cb, &buffers, &stats );
+				f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+				if( fMs < fBestMs )
+				{
+					fBestMs = fMs;
+					best = stats;
+				}
+			}
+			bool bOk = CheckBvh( buffers.pNodes, buffers.pParents, pVerticesAndIndices, &cb );
+
+			//a refit after the vertices moved has to give valid boxes again without a rebuild
+			f64 fRefitMs = 0;
+			if( grid.pVertices )
+			{
+				for( u32 dwVertex = 0; dwVertex < grid.dwVertexCount; ++dwVertex )
+				{
+					( (f32*)( grid.pVertices + (u64)dwVertex * grid.dwVertexStride ) )[1] += 0.5f * ( dwVertex & 7 );
+				}
+				fRefitMs = 1e30;
+				for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+				{
+					u64 qwStart = GetTimeNs();
+					CpuRefitBvh( pDevice, &kernels, pVerticesAndIndices, qwSize, &cb, &buffers );
+					f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+					fRefitMs = fMs < fRefitMs ? fMs : fRefitMs;
+				}
+				bOk = bOk && CheckBvh( buffers.pNodes, buffers.pParents, pVerticesAndIndices, &cb );
+			}
+			printf( "%10s %10u %12.3f %10.1f %10.3f %10.3f %10.3f %10.3f %8s\n", name, dwTriangles, fBestMs, fBestMs * 1e6 / dwTriangles,
+					best.qwMortonNs / 1e6, best.qwSortNs / 1e6, best.qwEmitNs / 1e6, best.qwRefitNs / 1e6, bOk ? "ok" : "MISMATCH" );
+			if( grid.pVertices )
+			{
+				printf( "%10s %10u %12s %10s %10s %10s %10s %10.3f %8s\n", name, dwTriangles, "refit only", "", "", "", "", fRefitMs, bOk ? "ok" : "MISMATCH" );
+			}
+		}
+		else
+		{
+			printf( "%10s %10u out of memory\n", name, dwTriangles );
+		}
+		FreeBvhBuildBuffers( &buffers );
+		FreeMeshData( &grid );
+	}
+	free( pBuiltinBlob );
+	DestroyCpuComputeDevice( pDevice );
+	delete pDevice;
+}
+
+#define BENCH_RAY_QUERY_SIDE 512 //camera rays per side
+
+//rays from random points in the box in random directions, the incoherent worst case for packets
+void BenchMakeRandomRays( const BvhNode *pBounds, u32 dwCount, BvhRay *pRays )
+{
+	u32 dwState = 0x2545F491;
+	for( u32 dwRay = 0; dwRay < dwCount; ++dwRay )
+	{
+		BvhRay *pRay = &pRays[dwRay];
+		f32 fLength = 0.f;
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			const f32 fT = BenchRandomFloat( &dwState ) * 0.5f + 0.5f;
+			pRay->fOrigin[dwAxis] = pBounds->fMin[dwAxis] + ( pBounds->fMax[dwAxis] - pBounds->fMin[dwAxis] ) * fT;
+			pRay->fDir[dwAxis] = BenchRandomFloat( &dwState );
+			fLength += pRay->fDir[dwAxis] * pRay->fDir[dwAxis];
+		}
+		fLength = 1.f / sqrtf( fLength );
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			pRay->fDir[dwAxis] *= fLength;
+		}
+		pRay->fTMin = 0.f;
+		pRay->fTMax = 1e30f;
+	}
+}
+
+//brute force over every triangle for a sample of the rays, the tie break makes the closest hit unique so it has to match exactly
+bool BenchRayQueryCheck( const u8 *pVerticesAndIndices, u64 qwSize, const ComputeShaderCB *pCB, const BvhRay *pRays, const BvhHit *pHits, u32 dwRayCount, u32 dwSamples )
+{
+	CpuComputeRootArgs root;
+	memset( &root, 0, sizeof(CpuComputeRootArgs) );
+	root.cb = *pCB;
+	root.pVerticesAndIndices = pVerticesAndIndices;
+	root.qwVerticesAndIndicesSize = qwSize;
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	for( u32 dwSample = 0; dwSample < dwSamples; ++dwSample )
+	{
+		const u32 dwRay = (u32)( (u64)dwSample * dwRayCount / dwSamples );
+		BvhHit hit = { BVH_INVALID_NODE, pRays[dwRay].fTMax, 0.f, 0.f };
+		for( u32 dwTriangle = 0; dwTriangle < dwCount; ++dwTriangle )
+		{
+			RayQueryHitTriangle( &root, dwTriangle, &pRays[dwRay], &hit );
+		}
+		if( memcmp( &hit, &pHits[dwRay], sizeof(BvhHit) ) != 0 )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void BenchRayQuery()
+{
+	CpuComputeDevice *pDevice = new CpuComputeDevice;
+	if( !InitCpuComputeDevice( pDevice, 0 ) )
+	{
+		printf( "Failed to create cpu compute device!\n" );
+		delete pDevice;
+		return;
+	}
+	BvhKernels bvhKernels;
+	InitBvhKernels( &bvhKernels );
+	RayQueryKernels kernels;
+	InitRayQueryKernels( &kernels );
+
+	MeshData builtinMeshes[BUILTIN_MESH_COUNT];
+	MeshPackEntry entries[BUILTIN_MESH_COUNT];
+	u8 *pBuiltinBlob = NULL;
+	u64 qwBuiltinSize = 0;
+	if( OptimizeBuiltinMeshes( builtinMeshes ) )
+	{
+		qwBuiltinSize = PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, NULL, NULL );
+		pBuiltinBlob = (u8*)malloc( qwBuiltinSize );
+		PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, pBuiltinBlob, entries );
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_PLANE] );
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_CUBE] );
+	}
+
+	u32 dwRayCount = BENCH_RAY_QUERY_SIDE * BENCH_RAY_QUERY_SIDE;
+	BvhRay *pRays = (BvhRay*)malloc( (u64)dwRayCount * sizeof(BvhRay) );
+	BvhHit *pHits = (BvhHit*)malloc( (u64)dwRayCount * sizeof(BvhHit) );
+	BvhHit *pPacketHits = (BvhHit*)malloc( (u64)dwRayCount * sizeof(BvhHit) );
+	if( !pRays || !pHits || !pPacketHits )
+	{
+		printf( "ray query out of memory\n" );
+		dwRayCount = 0;
+	}
+
+	printf( "\nray query closest hit, %u rays, %u workers\n", dwRayCount, pDevice->dwNumWorkers );
+	printf( "%10s %10s %8s %10s %14s %14s %8s %8s\n", "mesh", "triangles", "rays", "hit %", "scalar Mray/s", "packet Mray/s", "speedup", "result" );
+	const u32 gridSides[] = { 0, 0, 224, 708, 1415 }; //the built in plane and cube, then ~100K, 1M and 4M triangles
+	for( u32 dwMesh = 0; dwRayCount && dwMesh < sizeof(gridSides) / sizeof(gridSides[0]); ++dwMesh )
+	{
+		const u8 *pVerticesAndIndices;
+		u64 qwSize;
+		ComputeShaderCB cb;
+		MeshData grid;
+		char name[32];
+		memset( &grid, 0, sizeof(MeshData) );
+		if( gridSides[dwMesh] == 0 )
+		{
+			if( !pBuiltinBlob )
+			{
+				continue;
+			}
+			const MeshPackEntry *pEntry = &entries[dwMesh == 0 ? BUILTIN_MESH_PLANE : BUILTIN_MESH_CUBE];
+			pVerticesAndIndices = pBuiltinBlob;
+			qwSize = qwBuiltinSize;
+			cb = MakeBvhCB( (u32)pEntry->qwVertexOffset, (u32)pEntry->qwIndexOffset, pEntry->dwIndexCount / 3, pEntry->dwVertexStride );
+			snprintf( name, sizeof(name), "%s", dwMesh == 0 ? "plane" : "cube" );
+		}
+		else
+		{
+			if( !BenchMakeGridMesh( gridSides[dwMesh], &grid ) )
+			{
+				printf( "%10s out of memory\n", "grid" );
+				continue;
+			}
+			pVerticesAndIndices = grid.pVertices;
+			qwSize = MeshDataSize( &grid );
+			cb = MakeBvhCB( 0, (u32)MeshDataVertexSize( &grid ), grid.dwIndexCount / 3, grid.dwVertexStride );
+			snprintf( name, sizeof(name), "grid%u", gridSides[dwMesh] );
+		}
+
+		const u32 dwTriangles = cb.dwOffsetsAndStrides0[2];
+		BvhBuildBuffers buffers;
+		if( AllocBvhBuildBuffers( dwTriangles, &buffers ) )
+		{
+			CpuBuildBvh( pDevice, &bvhKernels, pVerticesAndIndices, qwSize, &cb, &buffers );
+			const ComputeShaderCB rayCB = MakeRayQueryCB( cb.dwOffsetsAndStrides0[0], cb.dwOffsetsAndStrides0[1], dwRayCount, cb.dwOffsetsAndStrides0[3] );
+			for( u32 dwRaySet = 0; dwRaySet < 2; ++dwRaySet )
+			{
+				if( dwRaySet == 0 )
+				{
+					MakeCameraRays( &buffers.pNodes[0], BENCH_RAY_QUERY_SIDE, pRays );
+				}
+				else
+				{
+					BenchMakeRandomRays( &buffers.pNodes[0], dwRayCount, pRays );
+				}
+				f64 fBestMs[2] = { 1e30, 1e30 };
+				for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+				{
+					for( u32 dwPackets = 0; dwPackets < 2; ++dwPackets )
+					{
+						u64 qwStart = GetTimeNs();
+						CpuRayQueryClosestHit( pDevice, &kernels, dwPackets != 0, pVerticesAndIndices, qwSize, &rayCB, buffers.pNodes, buffers.pParents, pRays,
+											   dwPackets ? pPacketHits : pHits );
+						f64 fMs = ( GetTimeNs() - qwStart ) / 1e6;
+						fBestMs[dwPackets] = fMs < fBestMs[dwPackets] ? fMs : fBestMs[dwPackets];
+					}
+				}
+				u32 dwHitCount = 0;
+				for( u32 dwRay = 0; dwRay < dwRayCount; ++dwRay )
+				{
+					dwHitCount += pHits[dwRay].dwTriangle != BVH_INVALID_NODE;
+				}
+				//the check uses the bvh cb, it has the triangle count where rayCB has the ray count
+				const bool bOk = memcmp( pHits, pPacketHits, (u64)dwRayCount * sizeof(BvhHit) ) == 0 &&
+								 BenchRayQueryCheck( pVerticesAndIndices, qwSize, &cb, pRays, pHits, dwRayCount,
+													 dwTriangles > 100000 ? 16 : 256 );
+				printf( "%10s %10u %8s %10.1f %14.2f %14.2f %8.2f %8s\n", name, dwTriangles, dwRaySet == 0 ? "camera" : "random",
+						100.0 * dwHitCount / dwRayCount, dwRayCount / ( fBestMs[0] * 1e3 ), dwRayCount / ( fBestMs[1] * 1e3 ), fBestMs[0] / fBestMs[1],
+						bOk ? "ok" : "MISMATCH" );
+			}
+		}
+		else
+		{
+			printf( "%10s %10u out of memory\n", name, dwTriangles );
+		}
+		FreeBvhBuildBuffers( &buffers );
+		FreeMeshData( &grid );
+	}
+	free( pRays );
+	free( pHits );
+	free( pPacketHits );
+	free( pBuiltinBlob );
+	DestroyCpuComputeDevice( pDevice );
+	delete pDevice;
+}
+
+#define BENCH_TRANSIENT_GRID_SIDE 708 //~1M triangles
+#define BENCH_TRANSIENT_CULL_INSTANCES 1000000
+#define BENCH_TRANSIENT_POISON 0xcd
+
+//culling as RecordCullInstances() records it, followed by the indirect dispatch over the visible list
+enum BenchCullPass
+{
+	BENCH_CULL_PASS_CULL,
+	BENCH_CULL_PASS_SCAN,
+	BENCH_CULL_PASS_COMPACT,
+	BENCH_CULL_PASS_DISPATCH_VISIBLE
+};
+
+void BenchTransientReport( const char *pName, const TransientPlan *pPlan )
+{
+	printf( "%-24s %7u %6u %9.2f MB %9.2f MB %9.2f MB %6.1f%% %8u\n", pName, pPlan->dwResourceCount, pPlan->dwPassCount,
+			pPlan->qwUnaliasedSize / 1048576.0, pPlan->qwHeapSize / 1048576.0, pPlan->qwPeakLiveBytes / 1048576.0,
+			100.0 * ( 1.0 - (f64)pPlan->qwHeapSize / pPlan->qwUnaliasedSize ), pPlan->dwAliasCount );
+}
+
+//the buffers of a plan carved out of one allocation at their offsets, poisoned so anything read before it is written shows up
+u8 *BenchTransientCarve( const TransientPlan *pPlan, const RayQueryTransients *pIndices, BvhBuildBuffers *pBuffers, BvhRay **ppRays, BvhHit **ppHits )
+{
+	u8 *pArena = (u8*)malloc( pPlan->qwHeapSize + 64 ); //the cpu kernels may read a little past the end of a buffer
+	if( !pArena )
+	{
+		return NULL;
+	}
+	memset( pArena, BENCH_TRANSIENT_POISON, pPlan->qwHeapSize + 64 );
+	const TransientResource *pResources = pPlan->resources;
+	pBuffers->pNodes = (BvhNode*)( pArena + pResources[pIndices->dwNodes].qwOffset );
+	pBuffers->pParents = (u32*)( pArena + pResources[pIndices->dwParents].qwOffset );
+	pBuffers->pScratch = pArena + pResources[pIndices->dwScratch].qwOffset;
+	pBuffers->sort.pKeys = (u32*)( pArena + pResources[pIndices->dwKeys].qwOffset );
+	pBuffers->sort.pPayload = (u32*)( pArena + pResources[pIndices->dwPayload].qwOffset );
+	pBuffers->sort.pKeysAlt = (u32*)( pArena + pResources[pIndices->dwKeysAlt].qwOffset );
+	pBuffers->sort.pPayloadAlt = (u32*)( pArena + pResources[pIndices->dwPayloadAlt].qwOffset );
+	pBuffers->sort.pBlockHistograms = (u32*)( pArena + pResources[pIndices->dwBlockHistograms].qwOffset );
+	pBuffers->sort.pDigitOffsets = (u32*)( pArena + pResources[pIndices->dwDigitOffsets].qwOffset );
+	pBuffers->sort.pScanPartials = pArena + pResources[pIndices->dwScanPartials].qwOffset;
+	*ppRays = (BvhRay*)( pArena + pResources[pIndices->dwRays].qwOffset );
+	*ppHits = (BvhHit*)( pArena + pResources[pIndices->dwHits].qwOffset );
+	return pArena;
+}
+
+//peak memory of the multi-pass graphs with every buffer at its own offset and with lifetimes packed into shared offsets
+//(gpu block sizes, 64KB placement), then the bvh build + ray query runs on the cpu in buffers carved from the aliased plan
+//and has to give the same bvh and hits as separate buffers
+void BenchTransientAliasing()
+{
+	const u32 dwGridTriangles = BENCH_TRANSIENT_GRID_SIDE * BENCH_TRANSIENT_GRID_SIDE * 2;
+	const u32 dwRayCount = BENCH_RAY_QUERY_SIDE * BENCH_RAY_QUERY_SIDE;
+	printf( "\ntransient aliasing, peak memory of the compute graphs\n" );
+	printf( "%-24s %7s %6s %12s %12s %12s %7s %8s\n", "graph", "buffers", "passes", "unaliased", "aliased", "live peak", "saved", "barriers" );
+	TransientPlan *pPlan = new TransientPlan;
+	RayQueryTransients indices;
+	const u32 triangleCounts[] = { 100000, 1000000, 4000000 };
+	for( u32 dwGraph = 0; dwGraph < sizeof(triangleCounts) / sizeof(triangleCounts[0]); ++dwGraph )
+	{
+		const u32 dwTriangles = triangleCounts[dwGraph];
+		InitTransientPlan( pPlan );
+		DeclareRayQueryTransients( pPlan, dwTriangles, dwRayCount, RADIX_BLOCK_SIZE, BVH_BLOCK_SIZE, 65536, &indices );
+		TransientPlanBuild( pPlan );
+		char name[32];
+		snprintf( name, sizeof(name), "bvh+rays %uK tris", dwTriangles / 1000 );
+		BenchTransientReport( name, pPlan );
+	}
+	{
+		const u32 dwCount = BENCH_TRANSIENT_CULL_INSTANCES;
+		InitTransientPlan( pPlan );
+		TransientPlanDeclare( pPlan, "visible flags", (u64)dwCount * sizeof(u32), 65536, BENCH_CULL_PASS_CULL, BENCH_CULL_PASS_COMPACT );
+		TransientPlanDeclare( pPlan, "visible offsets", (u64)dwCount * sizeof(u32), 65536, BENCH_CULL_PASS_SCAN, BENCH_CULL_PASS_COMPACT );
+		TransientPlanDeclare( pPlan, "scan partials", ScanScratchSize( dwCount ), 65536, BENCH_CULL_PASS_SCAN, BENCH_CULL_PASS_SCAN );
+		TransientPlanDeclare( pPlan, "visible instances", CullListSize( dwCount ), 65536, BENCH_CULL_PASS_COMPACT, BENCH_CULL_PASS_DISPATCH_VISIBLE );
+		TransientPlanBuild( pPlan );
+		BenchTransientReport( "culling 1M instances", pPlan );
+	}
+
+	CpuComputeDevice *pDevice = new CpuComputeDevice;
+	BvhKernels bvhKernels;
+	InitBvhKernels( &bvhKernels );
+	RayQueryKernels kernels;
+	InitRayQueryKernels( &kernels );
+	MeshData grid;
+	memset( &grid, 0, sizeof(MeshData) );
+	if( !InitCpuComputeDevice( pDevice, 0 ) || !BenchMakeGridMesh( BENCH_TRANSIENT_GRID_SIDE, &grid ) )
+	{
+		printf( "transient aliasing out of memory\n" );
+		FreeMeshData( &grid );
+		delete pDevice;
+		delete pPlan;
+		return;
+	}
+	const ComputeShaderCB cb = MakeBvhCB( 0, (u32)MeshDataVertexSize( &grid ), grid.dwIndexCount / 3, grid.dwVertexStride );
+	const ComputeShaderCB rayCB = MakeRayQueryCB( cb.dwOffsetsAndStrides0[0], cb.dwOffsetsAndStrides0[1], dwRayCount, cb.dwOffsetsAndStrides0[3] );
+	const u64 qwMeshSize = MeshDataSize( &grid );
+
+	//separate buffers
+	BvhBuildBuffers separate;
+	BvhRay *pRays = (BvhRay*)malloc( (u64)dwRayCount * sizeof(BvhRay) );
+	BvhHit *pHits = (BvhHit*)malloc( (u64)dwRayCount * sizeof(BvhHit) );
+	bool bOk = AllocBvhBuildBuffers( dwGridTriangles, &separate ) && pRays && pHits;
+	u64 qwStart = GetTimeNs();
+	if( bOk )
+	{
+		CpuBuildBvh( pDevice, &bvhKernels, grid.pVertices, qwMeshSize, &cb, &separate );
+		MakeCameraRays( &separate.pNodes[0], BENCH_RAY_QUERY_SIDE, pRays );
+		CpuRayQueryClosestHit( pDevice, &kernels, true, grid.pVertices, qwMeshSize, &rayCB, separate.pNodes, separate.pParents, pRays, pHits );
+	}
+	const f64 fSeparateMs = ( GetTimeNs() - qwStart ) / 1e6;
+
+	//the same graph in one aliased allocation
+	InitTransientPlan( pPlan );
+	DeclareRayQueryTransients( pPlan, dwGridTriangles, dwRayCount, RADIX_CPU_TILE, BVH_CPU_TILE, 64, &indices );
+	TransientPlanBuild( pPlan );
+	BvhBuildBuffers aliased;
+	BvhRay *pAliasedRays;
+	BvhHit *pAliasedHits;
+	u8 *pArena = bOk ? BenchTransientCarve( pPlan, &indices, &aliased, &pAliasedRays, &pAliasedHits ) : NULL;
+	bOk = pArena != NULL;
+	qwStart = GetTimeNs();
+	if( bOk )
+	{
+		CpuBuildBvh( pDevice, &bvhKernels, grid.pVertices, qwMeshSize, &cb, &aliased );
+		MakeCameraRays( &aliased.pNodes[0], BENCH_RAY_QUERY_SIDE, pAliasedRays );
+		CpuRayQueryClosestHit( pDevice, &kernels, true, grid.pVertices, qwMeshSize, &rayCB, aliased.pNodes, aliased.pParents, pAliasedRays, pAliasedHits );
+	}
+	const f64 fAliasedMs = ( GetTimeNs() - qwStart ) / 1e6;
+	const u64 qwNodeCount = BvhNodeCount( dwGridTriangles );
+	bOk = bOk && memcmp( separate.pNodes, aliased.pNodes, qwNodeCount * sizeof(BvhNode) ) == 0 &&
+		  memcmp( separate.pParents, aliased.pParents, qwNodeCount * sizeof(u32) ) == 0 &&
+		  memcmp( pHits, pAliasedHits, (u64)dwRayCount * sizeof(BvhHit) ) == 0;
+	printf( "cpu bvh build + %u rays over %u triangles: separate %.2f MB %.1f ms, aliased %.2f MB %.1f ms, %u aliasing points, result %s\n",
+			dwRayCount, dwGridTriangles, pPlan->qwUnaliasedSize / 1048576.0, fSeparateMs, pPlan->qwHeapSize / 1048576.0, fAliasedMs,
+			pPlan->dwAliasCount, bOk ? "ok" : "MISMATCH" );
+
+	free( pArena );
+	free( pRays );
+	free( pHits );
+	FreeBvhBuildBuffers( &separate );
+	FreeMeshData( &grid );
+	DestroyCpuComputeDevice( pDevice );
+	delete pDevice;
+	delete pPlan;
+}
+
+#define BENCH_TRACE_EVENTS ( 1u << 22 )
+#define BENCH_TRACE_THREADS 4
+#define BENCH_TRACE_THREAD_EVENTS ( TRACE_RING_CAPACITY * 3 + 123 ) //wraps every ring a few times
+#define BENCH_TRACE_SUBMITS 256
+#define BENCH_TRACE_PATH "BenchTrace.json"
+
+//every event carries its index so the rings can be checked for holes after the wrap
+void BenchTraceRecordThread( u32 dwThread )
+{
+	char name[TRACE_MAX_THREAD_NAME];
+	snprintf( name, sizeof(name), "recorder %u", dwThread );
+	TraceSetThreadName( name );
+	for( u32 dwEvent = 0; dwEvent < BENCH_TRACE_THREAD_EVENTS; ++dwEvent )
+	{
+		TraceEnd( TraceBegin(), TRACE_KIND_MEMCPY, "BenchTraceRecord", NULL, dwEvent, dwThread );
+	}
+}
+
+void BenchTraceQueueWork( void *pContext )
+{
+	u32 *pData = (u32*)pContext;
+	for( u32 dwIdx = 0; dwIdx < 4096; ++dwIdx )
+	{
+		pData[dwIdx] = pData[dwIdx] * 1664525u + 1013904223u;
+	}
+}
+
+//cost of an event with recording off and on, then several threads recording at once plus a traced queue round trip
+void BenchTraceEvents()
+{
+	u64 qwNs[2];
+	for( u32 dwEnabled = 0; dwEnabled < 2; ++dwEnabled )
+	{
+		TraceEnable( dwEnabled != 0 );
+		qwNs[dwEnabled] = ~0ull;
+		for( u32 dwRepeat = 0; dwRepeat < BENCH_REPEATS; ++dwRepeat )
+		{
+			const u64 qwStart = GetTimeNs();
+			for( u32 dwEvent = 0; dwEvent < BENCH_TRACE_EVENTS; ++dwEvent )
+			{
+				TraceEnd( TraceBegin(), TRACE_KIND_SIGNAL, "BenchTraceOverhead", "bench", dwEvent );
+			}
+			const u64 qwElapsed = GetTimeNs() - qwStart;
+			qwNs[dwEnabled] = qwElapsed < qwNs[dwEnabled] ? qwElapsed : qwNs[dwEnabled];
+		}
+	}
+	printf( "\ntrace events: %.2f ns/event recording off, %.2f ns/event recording on\n",
+			(f64)qwNs[0] / BENCH_TRACE_EVENTS, (f64)qwNs[1] / BENCH_TRACE_EVENTS );
+
+	const u32 dwFirstRing = traceState.dwRingCount.load( std::memory_order_acquire );
+	std::thread threads[BENCH_TRACE_THREADS];
+	const u64 qwStart = GetTimeNs();
+	for( u32 dwThread = 0; dwThread < BENCH_TRACE_THREADS; ++dwThread )
+	{
+		threads[dwThread] = std::thread( BenchTraceRecordThread, dwThread );
+	}
+	for( u32 dwThread = 0; dwThread < BENCH_TRACE_THREADS; ++dwThread )
+	{
+		threads[dwThread].join();
+	}
+	const u64 qwThreadsNs = GetTimeNs() - qwStart;
+
+	//each ring has to hold exactly the last TRACE_RING_CAPACITY events of its thread, in order
+	bool bRingsOk = traceState.dwRingCount.load( std::memory_order_acquire ) == dwFirstRing + BENCH_TRACE_THREADS;
+	for( u32 dwRing = dwFirstRing; bRingsOk && dwRing < dwFirstRing + BENCH_TRACE_THREADS; ++dwRing )
+	{
+		TraceRing *pRing = traceState.rings[dwRing].load( std::memory_order_acquire );
+		const u64 qwHead = pRing->qwHead.load( std::memory_order_acquire );
+		bRingsOk &= qwHead == BENCH_TRACE_THREAD_EVENTS;
+		for( u64 qwIndex = qwHead - TRACE_RING_CAPACITY; bRingsOk && qwIndex < qwHead; ++qwIndex )
+		{
+			TraceEvent event;
+			bRingsOk &= TraceReadEvent( pRing, qwIndex, &event ) && event.qwArg0 == qwIndex && event.qwArg1 == pRing->events[0].qwArg1;
+		}
+	}
+	printf( "%u threads x %u events: %.2f ns/event per thread, rings %s\n", BENCH_TRACE_THREADS, BENCH_TRACE_THREAD_EVENTS,
+			(f64)qwThreadsNs / BENCH_TRACE_THREAD_EVENTS, bRingsOk ? "ok" : "MISMATCH" );
+
+	//execute + signal on a cpu queue and host waits on its fence, what a RunComputeDispatches() trace looks like
+	CpuQueue *pQueue = new CpuQueue;
+	CpuFence *pFence = new CpuFence;
+	InitCpuQueue( pQueue, "compute" );
+	InitCpuFence( pFence, 0 );
+	u32 *pData = (u32*)calloc( 4096, sizeof(u32) );
+	TraceSetThreadName( "main" );
+	for( u64 qwSubmit = 1; qwSubmit <= BENCH_TRACE_SUBMITS; ++qwSubmit )
+	{
+		u64 qwTraceStart = TraceBegin();
+		CpuQueueExecute( pQueue, BenchTraceQueueWork, pData );
+		TraceEnd( qwTraceStart, TRACE_KIND_EXECUTE, "ExecuteCommandLists", "compute", 1 );
+		qwTraceStart = TraceBegin();
+		CpuQueueSignal( pQueue, pFence, qwSubmit );
+		TraceEnd( qwTraceStart, TRACE_KIND_SIGNAL, "Signal", "compute", qwSubmit );
+		const u64 qwCompletedValue = CpuFenceGetCompletedValue( pFence );
+		qwTraceStart = TraceBegin();
+		CpuFenceWait( pFence, qwSubmit );
+		TraceEnd( qwTraceStart, TRACE_KIND_HOST_WAIT, "WaitForFenceValue", "compute", qwSubmit, qwCompletedValue );
+		qwTraceStart = TraceBegin();
+		u32 readback[4];
+		memcpy( readback, pData, sizeof(readback) );
+		TraceEnd( qwTraceStart, TRACE_KIND_MEMCPY, "Readback", "compute", sizeof(readback) );
+	}
+	DestroyCpuQueue( pQueue );
+
+	const u64 qwWriteStart = GetTimeNs();
+	const s64 qwWritten = WriteTraceJson( BENCH_TRACE_PATH, "Bench" );
+	const u64 qwWriteNs = GetTimeNs() - qwWriteStart;
+	TraceEnable( false );
+	//the main and recorder rings wrapped, the queue thread recorded an execute and a signal per submit
+	const s64 qwExpected = (s64)TRACE_RING_CAPACITY * ( 1 + BENCH_TRACE_THREADS ) + BENCH_TRACE_SUBMITS * 2;
+	printf( "%lld events written to %s in %.1f ms (%lld expected)\n", (long long)qwWritten, BENCH_TRACE_PATH, qwWriteNs / 1e6, (long long)qwExpected );
+	free( pData );
+	delete pFence;
+	delete pQueue;
+}
+
+#define BENCH_STREAM_ELEMENTS ( ( 16u << 20 ) + 777 ) //64MB of u32, the last chunk is partial
+#define BENCH_STREAM_CHUNK_ELEMENTS ( 256u << 10 )      //1MB chunks
+#define BENCH_STREAM_COPY_US 400     //a 1MB copy on the (simulated) copy engine, ~2.5GB/s
+#define BENCH_STREAM_COMPUTE_US 500  //the kernel over one chunk
+#define BENCH_STREAM_INPUT_PATH "BenchStreamIn.bin"
+#define BENCH_STREAM_OUTPUT_PATH "BenchStreamOut.bin"
+
+inline
+u32 BenchStreamKernel( u32 dwValue )
+{
+	return dwValue * 2654435761u + 12345u;
+}
+
+struct BenchStreamContext;
+
+typedef struct BenchStreamWork
+{
+	BenchStreamContext *pContext;
+	u32 dwSlot;
+	u32 dwElementCount;
+	u32 eStage;
+} BenchStreamWork;
+
+//cpu queues stand in for the copy and compute queues, the readback queue is the upload queue unless bSeparateReadbackQueue
+//each slot has upload staging, device input and output, and readback staging, like main.cpp's StreamSlot
+typedef struct BenchStreamContext
+{
+	CpuQueue queues[STREAM_STAGE_COUNT];
+	CpuFence fences[STREAM_STAGE_COUNT];
+	u64 qwFenceValues[STREAM_STAGE_COUNT];
+	CpuQueue *pStageQueues[STREAM_STAGE_COUNT];
+	CpuFence *pStageFences[STREAM_STAGE_COUNT];
+	u64 *pStageFenceValues[STREAM_STAGE_COUNT];
+	u8 *pUploadStaging[STREAM_PIPELINE_MAX_DEPTH];
+	u32 *pDeviceInput[STREAM_PIPELINE_MAX_DEPTH];
+	u32 *pDeviceOutput[STREAM_PIPELINE_MAX_DEPTH];
+	u8 *pReadbackStaging[STREAM_PIPELINE_MAX_DEPTH];
+	BenchStreamWork work[STREAM_PIPELINE_MAX_DEPTH][STREAM_STAGE_COUNT];
+	std::atomic<u64> qwQueueBusyNs[STREAM_STAGE_COUNT]; //per queue, what the stage ran on
+} BenchStreamContext;
+
+//runs on the queue threads, the real copy/kernel plus a sleep up to the simulated device time
+void BenchStreamQueueWork( void *pWorkContext )
+{
+	BenchStreamWork *pWork = (BenchStreamWork*)pWorkContext;
+	BenchStreamContext *pContext = pWork->pContext;
+	const u64 qwStartNs = GetTimeNs();
+	const u64 qwBytes = (u64)pWork->dwElementCount * sizeof(u32);
+	u32 dwDeviceUs = BENCH_STREAM_COPY_US;
+	if( pWork->eStage == STREAM_STAGE_UPLOAD )
+	{
+		memcpy( pContext->pDeviceInput[pWork->dwSlot], pContext->pUploadStaging[pWork->dwSlot], qwBytes );
+	}
+	else if( pWork->eStage == STREAM_STAGE_COMPUTE )
+	{
+		const u32 *pInput = pContext->pDeviceInput[pWork->dwSlot];
+		u32 *pOutput = pContext->pDeviceOutput[pWork->dwSlot];
+		for( u32 dwIdx = 0; dwIdx < pWork->dwElementCount; ++dwIdx )
+		{
+			pOutput[dwIdx] = BenchStreamKernel( pInput[dwIdx] );
+		}
+		dwDeviceUs = BENCH_STREAM_COMPUTE_US;
+	}
+	else
+	{
+		memcpy( pContext->pReadbackStaging[pWork->dwSlot], pContext->pDeviceOutput[pWork->dwSlot], qwBytes );
+	}
+	//partial chunks take their share of the time
+	const u64 qwDeviceNs = dwDeviceUs * 1000ull * pWork->dwElementCount / BENCH_STREAM_CHUNK_ELEMENTS;
+	std::this_thread::sleep_until( std::chrono::steady_clock::time_point( std::chrono::nanoseconds( qwStartNs + qwDeviceNs ) ) );
+	const CpuQueue *pQueue = pContext->pStageQueues[pWork->eStage];
+	pContext->qwQueueBusyNs[pQueue - pContext->queues].fetch_add( GetTimeNs() - qwStartNs, std::memory_order_relaxed );
+}
+
+//PFN_StreamStage for all three, the upload also does the host memcpy from the mapped file into the slot's staging
+u64 BenchStreamStage( BenchStreamContext *pContext, const StreamChunk *pChunk, u32 eStage, u64 qwWaitValue )
+{
+	if( eStage == STREAM_STAGE_UPLOAD )
+	{
+		memcpy( pContext->pUploadStaging[pChunk->dwSlot], pChunk->pInput, pChunk->qwInputSize );
+	}
+	else
+	{
+		CpuQueueWait( pContext->pStageQueues[eStage], pContext->pStageFences[eStage - 1], qwWaitValue );
+	}
+	BenchStreamWork *pWork = &pContext->work[pChunk->dwSlot][eStage];
+	pWork->pContext = pContext;
+	pWork->dwSlot = pChunk->dwSlot;
+	pWork->dwElementCount = pChunk->dwElementCount;
+	pWork->eStage = eStage;
+	CpuQueueExecute( pContext->pStageQueues[eStage], BenchStreamQueueWork, pWork );
+	const u64 qwFenceValue = ++*pContext->pStageFenceValues[eStage];
+	CpuQueueSignal( pContext->pStageQueues[eStage], pContext->pStageFences[eStage], qwFenceValue );
+	return qwFenceValue;
+}
+
+u64 BenchStreamUpload( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	return BenchStreamStage( (BenchStreamContext*)pContext, pChunk, STREAM_STAGE_UPLOAD, qwWaitValue );
+}
+
+u64 BenchStreamCompute( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	return BenchStreamStage( (BenchStreamContext*)pContext, pChunk, STREAM_STAGE_COMPUTE, qwWaitValue );
+}
+
+u64 BenchStreamReadback( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	return BenchStreamStage( (BenchStreamContext*)pContext, pChunk, STREAM_STAGE_READBACK, qwWaitValue );
+}
+
+const u8 *BenchStreamAcquireOutput( void *pContext, const StreamChunk *pChunk )
+{
+	BenchStreamContext *pStream = (BenchStreamContext*)pContext;
+	CpuFenceWait( pStream->pStageFences[STREAM_STAGE_READBACK], pChunk->qwFenceValues[STREAM_STAGE_READBACK] );
+	return pStream->pReadbackStaging[pChunk->dwSlot];
+}
+
+void BenchStreamReleaseOutput( void *pContext, const StreamChunk *pChunk )
+{
+}
+
+bool BenchStreamCheckOutput( const char *pInputPath, const char *pOutputPath )
+{
+	MappedFile input;
+	MappedFile output;
+	if( !OpenMappedFile( pInputPath, &input, false ) )
+	{
+		return false;
+	}
+	if( !OpenMappedFile( pOutputPath, &output, false ) )
+	{
+		CloseMappedFile( &input );
+		return false;
+	}
+	bool bMatch = input.qwSize == output.qwSize;
+	const u32 *pInput = (const u32*)input.pBase;
+	const u32 *pOutput = (const u32*)output.pBase;
+	for( u64 qwIdx = 0; bMatch && qwIdx < input.qwSize / sizeof(u32); ++qwIdx )
+	{
+		bMatch = pOutput[qwIdx] == BenchStreamKernel( pInput[qwIdx] );
+	}
+	CloseMappedFile( &input );
+	CloseMappedFile( &output );
+	return bMatch;
+}
+
+//a file through upload -> compute -> readback in 1MB chunks with the device times simulated on cpu queues
+//lockstep waits for every chunk before the next one, the pipeline overlaps three chunks
+//overlap efficiency is how busy the busiest engine (queue or host) was, 100% means the pipeline runs at the speed of its slowest one
+void BenchStreamPipeline()
+{
+	FILE *pFile = fopen( BENCH_STREAM_INPUT_PATH, "wb" );
+	if( !pFile )
+	{
+		printf( "Failed to create %s!\n", BENCH_STREAM_INPUT_PATH );
+		return;
+	}
+	u32 *pBlock = (u32*)malloc( BENCH_STREAM_CHUNK_ELEMENTS * sizeof(u32) );
+	u32 dwState = 1;
+	for( u32 dwWritten = 0; dwWritten < BENCH_STREAM_ELEMENTS; )
+	{
+		const u32 dwCount = BENCH_STREAM_ELEMENTS - dwWritten < BENCH_STREAM_CHUNK_ELEMENTS ? BENCH_STREAM_ELEMENTS - dwWritten : BENCH_STREAM_CHUNK_ELEMENTS;
+		for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+		{
+			dwState = dwState * 1664525u + 1013904223u;
+			pBlock[dwIdx] = dwState;
+		}
+		fwrite( pBlock, sizeof(u32), dwCount, pFile );
+		dwWritten += dwCount;
+	}
+	fclose( pFile );
+	free( pBlock );
+
+	printf( "\nstreaming %.1f MB in %u element chunks, %u us copies, %u us compute per chunk\n", BENCH_STREAM_ELEMENTS * 4.0 / ( 1 << 20 ),
+			BENCH_STREAM_CHUNK_ELEMENTS, BENCH_STREAM_COPY_US, BENCH_STREAM_COMPUTE_US );
+	typedef struct BenchStreamConfig
+	{
+		const char *pName;
+		u32 dwDepth;
+		bool bLockstep;
+		bool bSeparateReadbackQueue;
+	} BenchStreamConfig;
+	static const BenchStreamConfig configs[] =
+	{
+		{ "lockstep, 1 copy queue", STREAM_PIPELINE_MIN_DEPTH, true, false },
+		{ "depth 3, 1 copy queue", 3, false, false },
+		{ "depth 4, 1 copy queue", 4, false, false },
+		{ "depth 3, 2 copy queues", 3, false, true },
+		{ "depth 4, 2 copy queues", 4, false, true },
+	};
+	for( u32 dwConfig = 0; dwConfig < sizeof(configs) / sizeof(configs[0]); ++dwConfig )
+	{
+		const BenchStreamConfig *pConfig = &configs[dwConfig];
+		BenchStreamContext *pContext = new BenchStreamContext;
+		for( u32 dwStage = 0; dwStage < STREAM_STAGE_COUNT; ++dwStage )
+		{
+			static const char *queueNames[STREAM_STAGE_COUNT] = { "copy", "compute", "readback" };
+			InitCpuQueue( &pContext->queues[dwStage], queueNames[dwStage] );
+			InitCpuFence( &pContext->fences[dwStage], 0 );
+			pContext->qwFenceValues[dwStage] = 0;
+			pContext->qwQueueBusyNs[dwStage] = 0;
+			const u32 dwQueue = dwStage == STREAM_STAGE_READBACK && !pConfig->bSeparateReadbackQueue ? STREAM_STAGE_UPLOAD : dwStage;
+			pContext->pStageQueues[dwStage] = &pContext->queues[dwQueue];
+			pContext->pStageFences[dwStage] = &pContext->fences[dwQueue];
+			pContext->pStageFenceValues[dwStage] = &pContext->qwFenceValues[dwQueue];
+		}
+		StreamPipelineDesc desc;
+		desc.pfnStages[STREAM_STAGE_UPLOAD] = BenchStreamUpload;
+		desc.pfnStages[STREAM_STAGE_COMPUTE] = BenchStreamCompute;
+		desc.pfnStages[STREAM_STAGE_READBACK] = BenchStreamReadback;
+		desc.pfnAcquireOutput = BenchStreamAcquireOutput;
+		desc.pfnReleaseOutput = BenchStreamReleaseOutput;
+		desc.pContext = pContext;
+		desc.dwDepth = pConfig->dwDepth;
+		desc.dwChunkElements = BENCH_STREAM_CHUNK_ELEMENTS;
+		desc.dwInputElementSize = sizeof(u32);
+		desc.dwOutputElementSize = sizeof(u32);
+		for( u32 dwSlot = 0; dwSlot < desc.dwDepth; ++dwSlot )
+		{
+			pContext->pUploadStaging[dwSlot] = (u8*)malloc( StreamSlotInputSize( &desc ) );
+			pContext->pDeviceInput[dwSlot] = (u32*)malloc( StreamSlotInputSize( &desc ) );
+			pContext->pDeviceOutput[dwSlot] = (u32*)malloc( StreamSlotOutputSize( &desc ) );
+			pContext->pReadbackStaging[dwSlot] = (u8*)malloc( StreamSlotOutputSize( &desc ) );
+		}
+
+		StreamPipeline *pPipeline = new StreamPipeline;
+		if( !OpenStreamPipeline( pPipeline, &desc, BENCH_STREAM_INPUT_PATH, BENCH_STREAM_OUTPUT_PATH ) )
+		{
+			printf( "Failed to open the stream pipeline!\n" );
+			delete pPipeline;
+			delete pContext;
+			break;
+		}
+		u64 qwMaxInFlight = 0;
+		bool bRan = true;
+		if( pConfig->bLockstep )
+		{
+			//the same stages and drain one chunk at a time, what a single use of the queues in InitDirectX12() does
+			pPipeline->qwStartNs = GetTimeNs();
+			for( u64 qwChunk = 0; bRan && qwChunk < pPipeline->qwChunkCount; ++qwChunk )
+			{
+				StreamChunk *pChunk = &pPipeline->chunks[qwChunk % desc.dwDepth];
+				const u64 qwFirstElement = qwChunk * desc.dwChunkElements;
+				const u64 qwElementCount = pPipeline->input.qwSize / sizeof(u32);
+				pChunk->qwIndex = qwChunk;
+				pChunk->dwSlot = (u32)( qwChunk % desc.dwDepth );
+				pChunk->dwElementCount = (u32)( qwElementCount - qwFirstElement < desc.dwChunkElements ? qwElementCount - qwFirstElement : desc.dwChunkElements );
+				pChunk->pInput = pPipeline->input.pBase + qwFirstElement * sizeof(u32);
+				pChunk->qwInputSize = pChunk->dwElementCount * sizeof(u32);
+				pChunk->qwOutputSize = pChunk->qwInputSize;
+				u64 qwWaitValue = 0;
+				for( u32 dwStage = 0; dwStage < STREAM_STAGE_COUNT; ++dwStage )
+				{
+					pChunk->qwFenceValues[dwStage] = qwWaitValue = desc.pfnStages[dwStage]( pContext, pChunk, qwWaitValue );
+				}
+				pPipeline->qwBytesRead += pChunk->qwInputSize;
+				StreamPipelineDrainOldest( pPipeline );
+				bRan = !pPipeline->bFailed;
+				qwMaxInFlight = 1;
+			}
+			pPipeline->qwEndNs = GetTimeNs();
+		}
+		else
+		{
+			while( StreamPipelineStep( pPipeline ) )
+			{
+				const u64 qwUploaded = pPipeline->qwStep < pPipeline->qwChunkCount ? pPipeline->qwStep : pPipeline->qwChunkCount;
+				const u64 qwInFlight = qwUploaded - pPipeline->qwDrainedChunks;
+				qwMaxInFlight = qwInFlight > qwMaxInFlight ? qwInFlight : qwMaxInFlight;
+			}
+			bRan = !pPipeline->bFailed;
+		}
+		CloseStreamPipeline( pPipeline );
+		bRan &= !pPipeline->bFailed;
+		for( u32 dwStage = 0; dwStage < STREAM_STAGE_COUNT; ++dwStage )
+		{
+			DestroyCpuQueue( &pContext->queues[dwStage] );
+		}
+
+		const u64 qwWallNs = pPipeline->qwEndNs - pPipeline->qwStartNs;
+		//the host thread is an engine too, it copies into staging and writes the output file whenever it is not waiting
+		static const char *engineNames[STREAM_STAGE_COUNT] = { "copy", "compute", "readback" };
+		const char *pBusiestName = "host";
+		u64 qwBusiestNs = qwWallNs - pPipeline->qwOutputWaitNs;
+		for( u32 dwQueue = 0; dwQueue < STREAM_STAGE_COUNT; ++dwQueue )
+		{
+			const u64 qwBusyNs = pContext->qwQueueBusyNs[dwQueue].load( std::memory_order_relaxed );
+			if( qwBusyNs > qwBusiestNs )
+			{
+				qwBusiestNs = qwBusyNs;
+				pBusiestName = engineNames[dwQueue];
+			}
+		}
+		const bool bMatch = bRan && BenchStreamCheckOutput( BENCH_STREAM_INPUT_PATH, BENCH_STREAM_OUTPUT_PATH );
+		printf( "%-24s %8.1f ms %7.1f MB/s, overlap efficiency %5.1f%% (%-8s bound), host waited %7.1f ms, wrote %6.1f ms, %llu chunks, %llu in flight, %5.1f MB staging, output %s\n",
+				pConfig->pName, qwWallNs / 1e6, pPipeline->qwBytesRead / ( qwWallNs / 1e3 ), 100.0 * qwBusiestNs / qwWallNs, pBusiestName, pPipeline->qwOutputWaitNs / 1e6,
+				pPipeline->qwWriteNs / 1e6, (unsigned long long)pPipeline->qwDrainedChunks, (unsigned long long)qwMaxInFlight,
+				( pConfig->bLockstep ? 1 : desc.dwDepth ) * ( StreamSlotInputSize( &desc ) + StreamSlotOutputSize( &desc ) ) / ( 1024.0 * 1024.0 ),
+				bMatch ? "ok" : "MISMATCH" );
+		for( u32 dwSlot = 0; dwSlot < desc.dwDepth; ++dwSlot )
+		{
+			free( pContext->pUploadStaging[dwSlot] );
+			free( pContext->pDeviceInput[dwSlot] );
+			free( pContext->pDeviceOutput[dwSlot] );
+			free( pContext->pReadbackStaging[dwSlot] );
+		}
+		delete pPipeline;
+		delete pContext;
+	}
+	remove( BENCH_STREAM_INPUT_PATH );
+	remove( BENCH_STREAM_OUTPUT_PATH );
+}
+
+int main()
+{
+	BenchWorkStealingScaling();
+	BenchSoaTransform();
+	BenchSoaAnimation();
+	BenchMeshOptimize();
+	BenchUploadRing();
+	BenchReadbackArena();
+	BenchResultSink();
+	BenchHeapAllocator();
+	BenchComputeInFlight();
+	BenchResidency();
+	BenchFenceTimeline();
+	BenchResourceStateTracker();
+	BenchSubmissionBatcher();
+	BenchParallelRecording();
+	BenchScan();
+	BenchRadixSort();
+	BenchCulling();
+	BenchBvh();
+	BenchRayQuery();
+	BenchTransientAliasing();
+	BenchTraceEvents();
+	BenchStreamPipeline();
+	return 0;
+}
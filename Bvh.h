@@ -0,0 +1,518 @@
+#ifndef BVH_H
+#define BVH_H
+
+//cpu version of Bvh.hlsl, linear bvh over the triangles of a mesh laid out like verticesAndIndices (position first in every vertex, R32_UINT indices)
+//same passes with the same buffer layouts, the cpu groups are BVH_CPU_TILE triangles and the morton codes are sorted with CpuRadixSort()
+//root constants: vertex byte offset, index byte offset, triangle count, vertex stride (MODEL_VERTEX_STRIDE for the built in meshes)
+//t0 is the mesh, u0 the nodes, u1 the parents, u2 the morton codes, u3 the triangle indices, u4 the scratch (BvhScratchSize())
+//the node array is internal nodes [0, count - 1) then leaves [count - 1, 2 * count - 1), the root is node 0
+
+#include "Common.h"
+#include "CpuCompute.h"
+#include "RadixSort.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+
+#include <atomic>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define BVH_THREADS 256
+#define BVH_ITEMS_PER_THREAD 4
+#define BVH_BLOCK_SIZE 1024 //BVH_THREADS * BVH_ITEMS_PER_THREAD, gpu
+#define BVH_LEAF_FLAG 0x80000000
+#define BVH_INVALID_NODE 0xFFFFFFFF
+#define BVH_MAX_TRIANGLES ( 65535u * BVH_THREADS )
+
+#define BVH_CPU_TILE 16384 //triangles per cpu group
+
+//must match the layout in Bvh.hlsl
+typedef struct BvhNode
+{
+	f32 fMin[3];
+	u32 dwLeft;  //child node, or BVH_LEAF_FLAG | triangle index for a leaf
+	f32 fMax[3];
+	u32 dwRight; //child node, 0 for a leaf
+} BvhNode;
+
+//u0..u4 of Bvh.hlsl, sort.pKeys are the morton codes and sort.pPayload the triangle indices
+typedef struct BvhBuildBuffers
+{
+	BvhNode *pNodes;        //BvhNodeCount() nodes
+	u32 *pParents;          //BvhNodeCount() u32s
+	RadixSortBuffers sort;  //for the triangle count with RADIX_CPU_TILE
+	u8 *pScratch;           //BvhScratchSize( count, BVH_CPU_TILE ) bytes
+} BvhBuildBuffers;
+
+typedef struct BvhKernels
+{
+	CpuComputeKernel centroidBounds;
+	CpuComputeKernel mortonCodes;
+	CpuComputeKernel emitHierarchy;
+	CpuComputeKernel refit;
+	RadixSortKernels sort;
+} BvhKernels;
+
+typedef struct BvhBuildStats
+{
+	u64 qwMortonNs; //centroid bounds and codes
+	u64 qwSortNs;
+	u64 qwEmitNs;
+	u64 qwRefitNs;
+} BvhBuildStats;
+
+inline
+u32 BvhNodeCount( u32 dwTriangleCount )
+{
+	return dwTriangleCount ? 2 * dwTriangleCount - 1 : 0;
+}
+
+//block bounds during the build, the refit counters after it
+inline
+u64 BvhScratchSize( u32 dwTriangleCount, u32 dwBlockSize )
+{
+	const u64 qwBounds = (u64)( ( dwTriangleCount + dwBlockSize - 1 ) / dwBlockSize ) * 6 * sizeof(f32);
+	const u64 qwCounters = (u64)dwTriangleCount * sizeof(u32);
+	return qwBounds > qwCounters ? qwBounds : qwCounters;
+}
+
+inline
+ComputeShaderCB MakeBvhCB( u32 dwVertexOffset, u32 dwIndexOffset, u32 dwTriangleCount, u32 dwVertexStride )
+{
+	ComputeShaderCB cb;
+	cb.dwOffsetsAndStrides0[0] = dwVertexOffset;
+	cb.dwOffsetsAndStrides0[1] = dwIndexOffset;
+	cb.dwOffsetsAndStrides0[2] = dwTriangleCount;
+	cb.dwOffsetsAndStrides0[3] = dwVertexStride;
+	return cb;
+}
+
+inline
+u32 BvhCountLeadingZeros( u32 dwValue )
+{
+#if defined(_MSC_VER)
+	unsigned long dwIndex;
+	return _BitScanReverse( &dwIndex, dwValue ) ? 31 - (u32)dwIndex : 32;
+#else
+	return dwValue ? (u32)__builtin_clz( dwValue ) : 32;
+#endif
+}
+
+inline
+const f32* BvhLoadVertex( const CpuComputeRootArgs *pRoot, u32 dwIndex )
+{
+	const u32 *pCB = pRoot->cb.dwOffsetsAndStrides0;
+	return (const f32*)( pRoot->pVerticesAndIndices + pCB[0] + (u64)dwIndex * pCB[3] );
+}
+
+inline
+void BvhLoadTriangle( const CpuComputeRootArgs *pRoot, u32 dwTriangle, const f32 **ppV0, const f32 **ppV1, const f32 **ppV2 )
+{
+	const u32 *pIndices = (const u32*)( pRoot->pVerticesAndIndices + pRoot->cb.dwOffsetsAndStrides0[1] ) + (u64)dwTriangle * 3;
+	*ppV0 = BvhLoadVertex( pRoot, pIndices[0] );
+	*ppV1 = BvhLoadVertex( pRoot, pIndices[1] );
+	*ppV2 = BvhLoadVertex( pRoot, pIndices[2] );
+}
+
+inline
+void BvhTriangleCentroid( const CpuComputeRootArgs *pRoot, u32 dwTriangle, f32 *pCentroid )
+{
+	const f32 *v0, *v1, *v2;
+	BvhLoadTriangle( pRoot, dwTriangle, &v0, &v1, &v2 );
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		pCentroid[dwAxis] = ( v0[dwAxis] + v1[dwAxis] + v2[dwAxis] ) * ( 1.f / 3.f );
+	}
+}
+
+//triangles of tile dwTile
+inline
+u32 BvhTileRange( const CpuComputeRootArgs *pRoot, u32 dwTile, u32 *pEnd )
+{
+	const u32 dwCount = pRoot->cb.dwOffsetsAndStrides0[2];
+	const u32 dwBegin = dwTile * BVH_CPU_TILE;
+	*pEnd = dwCount - dwBegin < BVH_CPU_TILE ? dwCount : dwBegin + BVH_CPU_TILE;
+	return dwBegin;
+}
+
+//BvhCentroidBounds in Bvh.hlsl
+inline
+void BvhCentroidBoundsCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	u32 dwEnd;
+	const u32 dwBegin = BvhTileRange( pRoot, Gid.x, &dwEnd );
+	f32 bounds[6] = { FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for( u32 dwTriangle = dwBegin; dwTriangle < dwEnd; ++dwTriangle )
+	{
+		f32 centroid[3];
+		BvhTriangleCentroid( pRoot, dwTriangle, centroid );
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			bounds[dwAxis] = centroid[dwAxis] < bounds[dwAxis] ? centroid[dwAxis] : bounds[dwAxis];
+			bounds[3 + dwAxis] = centroid[dwAxis] > bounds[3 + dwAxis] ? centroid[dwAxis] : bounds[3 + dwAxis];
+		}
+	}
+	memcpy( pRoot->pUavs[4] + (u64)Gid.x * sizeof(bounds), bounds, sizeof(bounds) );
+}
+
+//10 bits spread to every third bit
+inline
+u32 BvhExpandBits( u32 dwValue )
+{
+	dwValue = ( dwValue * 0x00010001u ) & 0xFF0000FFu;
+	dwValue = ( dwValue * 0x00000101u ) & 0x0F00F00Fu;
+	dwValue = ( dwValue * 0x00000011u ) & 0xC30C30C3u;
+	dwValue = ( dwValue * 0x00000005u ) & 0x49249249u;
+	return dwValue;
+}
+
+//BvhMortonCodes in Bvh.hlsl
+inline
+void BvhMortonCodesCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	u32 dwEnd;
+	const u32 dwBegin = BvhTileRange( pRoot, Gid.x, &dwEnd );
+	const u32 dwTiles = ( pRoot->cb.dwOffsetsAndStrides0[2] + BVH_CPU_TILE - 1 ) / BVH_CPU_TILE;
+	const f32 *pTileBounds = (const f32*)pRoot->pUavs[4];
+	f32 bounds[6] = { FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for( u32 dwTile = 0; dwTile < dwTiles; ++dwTile )
+	{
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			bounds[dwAxis] = pTileBounds[dwTile * 6 + dwAxis] < bounds[dwAxis] ? pTileBounds[dwTile * 6 + dwAxis] : bounds[dwAxis];
+			bounds[3 + dwAxis] = pTileBounds[dwTile * 6 + 3 + dwAxis] > bounds[3 + dwAxis] ? pTileBounds[dwTile * 6 + 3 + dwAxis] : bounds[3 + dwAxis];
+		}
+	}
+	f32 scale[3];
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		const f32 fExtent = bounds[3 + dwAxis] - bounds[dwAxis];
+		scale[dwAxis] = fExtent > 0.f ? 1024.f / fExtent : 0.f;
+	}
+
+	u32 *pCodes = (u32*)pRoot->pUavs[2];
+	u32 *pPrimIndices = (u32*)pRoot->pUavs[3];
+	for( u32 dwTriangle = dwBegin; dwTriangle < dwEnd; ++dwTriangle )
+	{
+		f32 centroid[3];
+		BvhTriangleCentroid( pRoot, dwTriangle, centroid );
+		u32 cell[3];
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			const f32 fCell = ( centroid[dwAxis] - bounds[dwAxis] ) * scale[dwAxis];
+			cell[dwAxis] = fCell <= 0.f ? 0 : fCell >= 1023.f ? 1023 : (u32)fCell;
+		}
+		pCodes[dwTriangle] = ( BvhExpandBits( cell[0] ) << 2 ) | ( BvhExpandBits( cell[1] ) << 1 ) | BvhExpandBits( cell[2] );
+		pPrimIndices[dwTriangle] = dwTriangle;
+	}
+}
+
+//length of the common prefix of sorted codes i and j, equal codes fall back to the indices so every key is unique
+inline
+s32 BvhCommonPrefix( const u32 *pCodes, u32 dwCount, u32 dwI, s64 j )
+{
+	if( j < 0 || j >= (s64)dwCount )
+	{
+		return -1;
+	}
+	const u32 dwCodeI = pCodes[dwI];
+	const u32 dwCodeJ = pCodes[j];
+	if( dwCodeI == dwCodeJ )
+	{
+		return 32 + (s32)BvhCountLeadingZeros( dwI ^ (u32)j );
+	}
+	return (s32)BvhCountLeadingZeros( dwCodeI ^ dwCodeJ );
+}
+
+//BvhEmitHierarchy in Bvh.hlsl
+inline
+void BvhEmitHierarchyCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 dwCount = pRoot->cb.dwOffsetsAndStrides0[2];
+	const u32 dwLeafBase = dwCount - 1;
+	const u32 *pCodes = (const u32*)pRoot->pUavs[2];
+	const u32 *pPrimIndices = (const u32*)pRoot->pUavs[3];
+	BvhNode *pNodes = (BvhNode*)pRoot->pUavs[0];
+	u32 *pParents = (u32*)pRoot->pUavs[1];
+	u32 *pCounters = (u32*)pRoot->pUavs[4];
+	u32 dwEnd;
+	const u32 dwBegin = BvhTileRange( pRoot, Gid.x, &dwEnd );
+	if( dwBegin == 0 )
+	{
+		pParents[0] = BVH_INVALID_NODE;
+	}
+	for( u32 i = dwBegin; i < dwEnd; ++i )
+	{
+		pNodes[dwLeafBase + i].dwLeft = BVH_LEAF_FLAG | pPrimIndices[i];
+		pNodes[dwLeafBase + i].dwRight = 0;
+		if( i >= dwLeafBase )
+		{
+			continue;
+		}
+
+		//direction and far end of the range this node covers
+		const s64 d = BvhCommonPrefix( pCodes, dwCount, i, (s64)i + 1 ) - BvhCommonPrefix( pCodes, dwCount, i, (s64)i - 1 ) >= 0 ? 1 : -1;
+		const s32 dwMinPrefix = BvhCommonPrefix( pCodes, dwCount, i, (s64)i - d );
+		u64 qwMaxLength = 2;
+		while( BvhCommonPrefix( pCodes, dwCount, i, (s64)i + (s64)qwMaxLength * d ) > dwMinPrefix )
+		{
+			qwMaxLength <<= 1;
+		}
+		u64 qwLength = 0;
+		for( u64 t = qwMaxLength >> 1; t > 0; t >>= 1 )
+		{
+			if( BvhCommonPrefix( pCodes, dwCount, i, (s64)i + (s64)( qwLength + t ) * d ) > dwMinPrefix )
+			{
+				qwLength += t;
+			}
+		}
+		const s64 j = (s64)i + (s64)qwLength * d;
+
+		//split position, the last element of the first half
+		const s32 dwNodePrefix = BvhCommonPrefix( pCodes, dwCount, i, j );
+		u64 qwSplit = 0;
+		u64 t = qwLength;
+		do
+		{
+			t = ( t + 1 ) >> 1;
+			if( BvhCommonPrefix( pCodes, dwCount, i, (s64)i + (s64)( qwSplit + t ) * d ) > dwNodePrefix )
+			{
+				qwSplit += t;
+			}
+		}
+		while( t > 1 );
+		const u32 dwGamma = (u32)( (s64)i + (s64)qwSplit * d + ( d < 0 ? d : 0 ) );
+
+		const u32 dwLeft = ( (s64)i < j ? (s64)i : j ) == (s64)dwGamma ? dwLeafBase + dwGamma : dwGamma;
+		const u32 dwRight = ( (s64)i > j ? (s64)i : j ) == (s64)dwGamma + 1 ? dwLeafBase + dwGamma + 1 : dwGamma + 1;
+		pNodes[i].dwLeft = dwLeft;
+		pNodes[i].dwRight = dwRight;
+		pParents[dwLeft] = i;
+		pParents[dwRight] = i;
+		pCounters[i] = 0;
+	}
+}
+
+//BvhRefit in Bvh.hlsl, the counter add is acq_rel so the second child to arrive sees the box the first one wrote
+inline
+void BvhRefitCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 dwLeafBase = pRoot->cb.dwOffsetsAndStrides0[2] - 1;
+	BvhNode *pNodes = (BvhNode*)pRoot->pUavs[0];
+	const u32 *pParents = (const u32*)pRoot->pUavs[1];
+	u32 *pCounters = (u32*)pRoot->pUavs[4];
+	u32 dwEnd;
+	const u32 dwBegin = BvhTileRange( pRoot, Gid.x, &dwEnd );
+	for( u32 dwLeaf = dwBegin; dwLeaf < dwEnd; ++dwLeaf )
+	{
+		u32 dwNode = dwLeafBase + dwLeaf;
+		BvhNode *pLeaf = &pNodes[dwNode];
+		const f32 *v0, *v1, *v2;
+		BvhLoadTriangle( pRoot, pLeaf->dwLeft & ~BVH_LEAF_FLAG, &v0, &v1, &v2 );
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			const f32 fMin = v0[dwAxis] < v1[dwAxis] ? v0[dwAxis] : v1[dwAxis];
+			const f32 fMax = v0[dwAxis] > v1[dwAxis] ? v0[dwAxis] : v1[dwAxis];
+			pLeaf->fMin[dwAxis] = fMin < v2[dwAxis] ? fMin : v2[dwAxis];
+			pLeaf->fMax[dwAxis] = fMax > v2[dwAxis] ? fMax : v2[dwAxis];
+		}
+
+		dwNode = pParents[dwNode];
+		while( dwNode != BVH_INVALID_NODE )
+		{
+			std::atomic_ref<u32> counter( pCounters[dwNode] );
+			if( counter.fetch_add( 1, std::memory_order_acq_rel ) == 0 )
+			{
+				break;
+			}
+			counter.store( 0, std::memory_order_relaxed );
+			BvhNode *pNode = &pNodes[dwNode];
+			const BvhNode *pLeft = &pNodes[pNode->dwLeft];
+			const BvhNode *pRight = &pNodes[pNode->dwRight];
+			for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+			{
+				pNode->fMin[dwAxis] = pLeft->fMin[dwAxis] < pRight->fMin[dwAxis] ? pLeft->fMin[dwAxis] : pRight->fMin[dwAxis];
+				pNode->fMax[dwAxis] = pLeft->fMax[dwAxis] > pRight->fMax[dwAxis] ? pLeft->fMax[dwAxis] : pRight->fMax[dwAxis];
+			}
+			dwNode = pParents[dwNode];
+		}
+	}
+}
+
+inline
+void InitBvhKernel( CpuComputeKernel *pKernel, PFN_CpuComputeGroup pfnGroup )
+{
+	memset( pKernel, 0, sizeof(CpuComputeKernel) );
+	pKernel->pfnGroup = pfnGroup;
+	pKernel->dwNumThreads[0] = BVH_THREADS;
+	pKernel->dwNumThreads[1] = 1;
+	pKernel->dwNumThreads[2] = 1;
+}
+
+inline
+void InitBvhKernels( BvhKernels *pKernels )
+{
+	InitBvhKernel( &pKernels->centroidBounds, BvhCentroidBoundsCpu );
+	InitBvhKernel( &pKernels->mortonCodes, BvhMortonCodesCpu );
+	InitBvhKernel( &pKernels->emitHierarchy, BvhEmitHierarchyCpu );
+	InitBvhKernel( &pKernels->refit, BvhRefitCpu );
+	InitRadixSortKernels( &pKernels->sort );
+}
+
+inline
+void InitBvhRootArgs( CpuComputeRootArgs *pRoot, const u8 *pVerticesAndIndices, u64 qwSize, const ComputeShaderCB *pCB, const BvhBuildBuffers *pBuffers )
+{
+	memset( pRoot, 0, sizeof(CpuComputeRootArgs) );
+	pRoot->cb = *pCB;
+	pRoot->pVerticesAndIndices = pVerticesAndIndices;
+	pRoot->qwVerticesAndIndicesSize = qwSize;
+	pRoot->pUavs[0] = (u8*)pBuffers->pNodes;
+	pRoot->pUavs[1] = (u8*)pBuffers->pParents;
+	pRoot->pUavs[2] = (u8*)pBuffers->sort.pKeys;
+	pRoot->pUavs[3] = (u8*)pBuffers->sort.pPayload;
+	pRoot->pUavs[4] = pBuffers->pScratch;
+}
+
+//updates the boxes after vertices moved, the hierarchy stays as it was built (the scratch has to be left as a build or refit left it)
+inline
+void CpuRefitBvh( CpuComputeDevice *pDevice, const BvhKernels *pKernels, const u8 *pVerticesAndIndices, u64 qwSize, const ComputeShaderCB *pCB,
+				  const BvhBuildBuffers *pBuffers )
+{
+	CpuComputeRootArgs root;
+	InitBvhRootArgs( &root, pVerticesAndIndices, qwSize, pCB, pBuffers );
+	const u32 dwTiles = ( pCB->dwOffsetsAndStrides0[2] + BVH_CPU_TILE - 1 ) / BVH_CPU_TILE;
+	CpuDispatch( pDevice, &pKernels->refit, &root, dwTiles, 1, 1 );
+}
+
+//the same passes as RecordBuildBvh() in main.cpp, pCB comes from MakeBvhCB(), pStats can be NULL
+inline
+void CpuBuildBvh( CpuComputeDevice *pDevice, const BvhKernels *pKernels, const u8 *pVerticesAndIndices, u64 qwSize, const ComputeShaderCB *pCB,
+				  const BvhBuildBuffers *pBuffers, BvhBuildStats *pStats = NULL )
+{
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	const u32 dwTiles = ( dwCount + BVH_CPU_TILE - 1 ) / BVH_CPU_TILE;
+	BvhBuildStats stats;
+	memset( &stats, 0, sizeof(BvhBuildStats) );
+	if( dwCount > 0 )
+	{
+		CpuComputeRootArgs root;
+		InitBvhRootArgs( &root, pVerticesAndIndices, qwSize, pCB, pBuffers );
+		u64 qwStart = GetTimeNs();
+		CpuDispatch( pDevice, &pKernels->centroidBounds, &root, dwTiles, 1, 1 );
+		CpuDispatch( pDevice, &pKernels->mortonCodes, &root, dwTiles, 1, 1 );
+		u64 qwNow = GetTimeNs();
+		stats.qwMortonNs = qwNow - qwStart;
+		qwStart = qwNow;
+		CpuRadixSort( pDevice, &pKernels->sort, &pBuffers->sort, 0, dwCount, false );
+		qwNow = GetTimeNs();
+		stats.qwSortNs = qwNow - qwStart;
+		qwStart = qwNow;
+		CpuDispatch( pDevice, &pKernels->emitHierarchy, &root, dwTiles, 1, 1 );
+		qwNow = GetTimeNs();
+		stats.qwEmitNs = qwNow - qwStart;
+		qwStart = qwNow;
+		CpuDispatch( pDevice, &pKernels->refit, &root, dwTiles, 1, 1 );
+		stats.qwRefitNs = GetTimeNs() - qwStart;
+	}
+	if( pStats )
+	{
+		*pStats = stats;
+	}
+}
+
+//cpu buffers of CpuBuildBvh() for dwTriangleCount triangles, one element more each so no triangles still gives valid pointers
+inline
+bool AllocBvhBuildBuffers( u32 dwTriangleCount, BvhBuildBuffers *pBuffers )
+{
+	const u32 dwHistogramCount = RadixHistogramCount( dwTriangleCount, RADIX_CPU_TILE );
+	pBuffers->pNodes = (BvhNode*)malloc( (u64)BvhNodeCount( dwTriangleCount ) * sizeof(BvhNode) + sizeof(BvhNode) );
+	pBuffers->pParents = (u32*)malloc( (u64)BvhNodeCount( dwTriangleCount ) * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pKeys = (u32*)malloc( (u64)dwTriangleCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pPayload = (u32*)malloc( (u64)dwTriangleCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pKeysAlt = (u32*)malloc( (u64)dwTriangleCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pPayloadAlt = (u32*)malloc( (u64)dwTriangleCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pBlockHistograms = (u32*)malloc( (u64)dwHistogramCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pDigitOffsets = (u32*)malloc( (u64)dwHistogramCount * sizeof(u32) + sizeof(u32) );
+	pBuffers->sort.pScanPartials = (u8*)malloc( RadixScanScratchSize( dwTriangleCount, RADIX_CPU_TILE ) );
+	pBuffers->pScratch = (u8*)malloc( BvhScratchSize( dwTriangleCount, BVH_CPU_TILE ) + sizeof(u32) );
+	return pBuffers->pNodes && pBuffers->pParents && pBuffers->sort.pKeys && pBuffers->sort.pPayload && pBuffers->sort.pKeysAlt &&
+		   pBuffers->sort.pPayloadAlt && pBuffers->sort.pBlockHistograms && pBuffers->sort.pDigitOffsets && pBuffers->sort.pScanPartials && pBuffers->pScratch;
+}
+
+inline
+void FreeBvhBuildBuffers( BvhBuildBuffers *pBuffers )
+{
+	free( pBuffers->pNodes );
+	free( pBuffers->pParents );
+	free( pBuffers->sort.pKeys );
+	free( pBuffers->sort.pPayload );
+	free( pBuffers->sort.pKeysAlt );
+	free( pBuffers->sort.pPayloadAlt );
+	free( pBuffers->sort.pBlockHistograms );
+	free( pBuffers->sort.pDigitOffsets );
+	free( pBuffers->sort.pScanPartials );
+	free( pBuffers->pScratch );
+}
+
+//a build of either backend: every triangle in exactly one leaf, every node reachable once from the root, parents match and every box holds its children
+inline
+bool CheckBvh( const BvhNode *pNodes, const u32 *pParents, const u8 *pVerticesAndIndices, const ComputeShaderCB *pCB )
+{
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	u8 *pSeen = (u8*)calloc( (u64)BvhNodeCount( dwCount ) + dwCount, 1 );
+	u8 *pTriangleSeen = pSeen + BvhNodeCount( dwCount );
+	u32 *pStack = (u32*)malloc( ( (u64)dwCount + 1 ) * sizeof(u32) );
+	bool bOk = pParents[0] == BVH_INVALID_NODE;
+	u32 dwStackSize = 0;
+	u32 dwLeaves = 0;
+	pStack[dwStackSize++] = 0;
+	while( dwStackSize && bOk )
+	{
+		const u32 dwNode = pStack[--dwStackSize];
+		const BvhNode *pNode = &pNodes[dwNode];
+		bOk = !pSeen[dwNode];
+		pSeen[dwNode] = 1;
+		if( pNode->dwLeft & BVH_LEAF_FLAG )
+		{
+			const u32 dwTriangle = pNode->dwLeft & ~BVH_LEAF_FLAG;
+			bOk = bOk && dwNode >= dwCount - 1 && dwTriangle < dwCount && !pTriangleSeen[dwTriangle];
+			if( bOk )
+			{
+				pTriangleSeen[dwTriangle] = 1;
+				const u32 *pIndices = (const u32*)( pVerticesAndIndices + pCB->dwOffsetsAndStrides0[1] ) + (u64)dwTriangle * 3;
+				for( u32 dwCorner = 0; dwCorner < 3; ++dwCorner )
+				{
+					const f32 *pPos = (const f32*)( pVerticesAndIndices + pCB->dwOffsetsAndStrides0[0] + (u64)pIndices[dwCorner] * pCB->dwOffsetsAndStrides0[3] );
+					for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+					{
+						bOk = bOk && pPos[dwAxis] >= pNode->fMin[dwAxis] && pPos[dwAxis] <= pNode->fMax[dwAxis];
+					}
+				}
+			}
+			++dwLeaves;
+			continue;
+		}
+		const u32 children[2] = { pNode->dwLeft, pNode->dwRight };
+		for( u32 dwChild = 0; dwChild < 2 && bOk; ++dwChild )
+		{
+			const BvhNode *pChild = &pNodes[children[dwChild]];
+			bOk = children[dwChild] < BvhNodeCount( dwCount ) && pParents[children[dwChild]] == dwNode;
+			for( u32 dwAxis = 0; dwAxis < 3 && bOk; ++dwAxis )
+			{
+				bOk = pChild->fMin[dwAxis] >= pNode->fMin[dwAxis] && pChild->fMax[dwAxis] <= pNode->fMax[dwAxis];
+			}
+			pStack[dwStackSize++] = children[dwChild];
+		}
+	}
+	bOk = bOk && dwLeaves == dwCount;
+	free( pSeen );
+	free( pStack );
+	return bOk;
+}
+
+#endif
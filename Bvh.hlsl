@@ -0,0 +1,260 @@
+//cs_5_0 way
+//linear bvh (karras 2012) over the triangles of a mesh in verticesAndIndices, a build is:
+//BvhCentroidBounds  one group per BVH_BLOCK_SIZE triangles, writes the block's centroid bounds to Scratch
+//BvhMortonCodes     one thread per triangle, reduces the block bounds and writes the 30 bit morton code of the centroid and the triangle index
+//RadixSort.hlsl     sorts the codes with the triangle indices as payload
+//BvhEmitHierarchy   one thread per sorted triangle, writes internal node i (karras split search) and leaf i, zeroes the refit counters
+//BvhRefit           one thread per leaf, writes the leaf box then walks up, the second thread to reach a node writes its box
+//a refit on its own updates the boxes of moved vertices without touching the hierarchy. Bvh.h is the cpu version
+cbuffer globalCB : register(b0)
+{
+    uint4 dwOffsetsAndStrides0; //x vertex byte offset, y index byte offset, z triangle count, w vertex stride
+};
+
+#define BVH_THREADS 256
+#define BVH_ITEMS_PER_THREAD 4
+#define BVH_BLOCK_SIZE 1024 //BVH_THREADS * BVH_ITEMS_PER_THREAD
+#define BVH_LEAF_FLAG 0x80000000
+#define BVH_INVALID_NODE 0xFFFFFFFF
+#define BVH_NODE_SIZE 32
+
+ByteAddressBuffer verticesAndIndices : register( t0 );
+globallycoherent RWByteAddressBuffer Nodes : register( u0 ); //internal nodes [0, count - 1), leaves [count - 1, 2 * count - 1), the root is node 0
+RWByteAddressBuffer Parents : register( u1 );                //a u32 per node
+RWByteAddressBuffer MortonCodes : register( u2 );
+RWByteAddressBuffer PrimIndices : register( u3 );
+globallycoherent RWByteAddressBuffer Scratch : register( u4 ); //block bounds (6 floats per block) during the build, refit counters (a u32 per internal node) after it
+
+#define BVH_ROOT_SIGNATURE "RootFlags( 0 ), RootConstants( num32BitConstants=4, b0, space = 0, visibility=SHADER_VISIBILITY_ALL ), SRV(t0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u1, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u2, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u3, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u4, space=0, visibility=SHADER_VISIBILITY_ALL)"
+
+groupshared float3 bvhMin[BVH_THREADS];
+groupshared float3 bvhMax[BVH_THREADS];
+
+uint TriangleCount()
+{
+	return dwOffsetsAndStrides0.z;
+}
+
+float3 LoadVertex( uint dwIndex )
+{
+	return asfloat( verticesAndIndices.Load3( dwOffsetsAndStrides0.x + dwIndex * dwOffsetsAndStrides0.w ) );
+}
+
+void LoadTriangle( uint dwTriangle, out float3 v0, out float3 v1, out float3 v2 )
+{
+	const uint3 indices = verticesAndIndices.Load3( dwOffsetsAndStrides0.y + dwTriangle * 12 );
+	v0 = LoadVertex( indices.x );
+	v1 = LoadVertex( indices.y );
+	v2 = LoadVertex( indices.z );
+}
+
+float3 TriangleCentroid( uint dwTriangle )
+{
+	float3 v0, v1, v2;
+	LoadTriangle( dwTriangle, v0, v1, v2 );
+	return ( v0 + v1 + v2 ) * ( 1.0 / 3.0 );
+}
+
+//min and max of bvhMin/bvhMax end up in element 0
+void ReduceGroupBounds( float3 minimum, float3 maximum, uint GI )
+{
+	bvhMin[GI] = minimum;
+	bvhMax[GI] = maximum;
+	GroupMemoryBarrierWithGroupSync();
+	[unroll]
+	for( uint dwStride = BVH_THREADS / 2; dwStride > 0; dwStride >>= 1 )
+	{
+		if( GI < dwStride )
+		{
+			bvhMin[GI] = min( bvhMin[GI], bvhMin[GI + dwStride] );
+			bvhMax[GI] = max( bvhMax[GI], bvhMax[GI + dwStride] );
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
+
+[RootSignature(BVH_ROOT_SIGNATURE)]
+[numthreads(BVH_THREADS, 1, 1)]
+void BvhCentroidBounds( uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex )
+{
+	float3 minimum = asfloat( 0x7F800000 ).xxx;
+	float3 maximum = -minimum;
+	[unroll]
+	for( uint dwItem = 0; dwItem < BVH_ITEMS_PER_THREAD; ++dwItem )
+	{
+		const uint dwTriangle = Gid.x * BVH_BLOCK_SIZE + dwItem * BVH_THREADS + GI;
+		if( dwTriangle < TriangleCount() )
+		{
+			const float3 centroid = TriangleCentroid( dwTriangle );
+			minimum = min( minimum, centroid );
+			maximum = max( maximum, centroid );
+		}
+	}
+	ReduceGroupBounds( minimum, maximum, GI );
+	if( GI == 0 )
+	{
+		Scratch.Store3( Gid.x * 24, asuint( bvhMin[0] ) );
+		Scratch.Store3( Gid.x * 24 + 12, asuint( bvhMax[0] ) );
+	}
+}
+
+//10 bits spread to every third bit
+uint ExpandBits( uint dwValue )
+{
+	dwValue = ( dwValue * 0x00010001u ) & 0xFF0000FFu;
+	dwValue = ( dwValue * 0x00000101u ) & 0x0F00F00Fu;
+	dwValue = ( dwValue * 0x00000011u ) & 0xC30C30C3u;
+	dwValue = ( dwValue * 0x00000005u ) & 0x49249249u;
+	return dwValue;
+}
+
+[RootSignature(BVH_ROOT_SIGNATURE)]
+[numthreads(BVH_THREADS, 1, 1)]
+void BvhMortonCodes( uint3 DTid : SV_DispatchThreadID, uint GI : SV_GroupIndex )
+{
+	//every group reduces the block bounds again, cheaper than another dispatch and a barrier
+	const uint dwBlockCount = ( TriangleCount() + BVH_BLOCK_SIZE - 1 ) / BVH_BLOCK_SIZE;
+	float3 minimum = asfloat( 0x7F800000 ).xxx;
+	float3 maximum = -minimum;
+	for( uint dwBlock = GI; dwBlock < dwBlockCount; dwBlock += BVH_THREADS )
+	{
+		minimum = min( minimum, asfloat( Scratch.Load3( dwBlock * 24 ) ) );
+		maximum = max( maximum, asfloat( Scratch.Load3( dwBlock * 24 + 12 ) ) );
+	}
+	ReduceGroupBounds( minimum, maximum, GI );
+	if( DTid.x >= TriangleCount() )
+	{
+		return;
+	}
+	const float3 sceneMin = bvhMin[0];
+	const float3 extent = bvhMax[0] - sceneMin;
+	const float3 scale = float3( extent.x > 0 ? 1024.0 / extent.x : 0, extent.y > 0 ? 1024.0 / extent.y : 0, extent.z > 0 ? 1024.0 / extent.z : 0 );
+	const uint3 cell = (uint3)clamp( ( TriangleCentroid( DTid.x ) - sceneMin ) * scale, 0, 1023 );
+	MortonCodes.Store( DTid.x * 4, ( ExpandBits( cell.x ) << 2 ) | ( ExpandBits( cell.y ) << 1 ) | ExpandBits( cell.z ) );
+	PrimIndices.Store( DTid.x * 4, DTid.x );
+}
+
+//length of the common prefix of sorted codes i and j, equal codes fall back to the indices so every key is unique
+int CommonPrefix( uint dwI, int j )
+{
+	if( j < 0 || j >= (int)TriangleCount() )
+	{
+		return -1;
+	}
+	const uint dwCodeI = MortonCodes.Load( dwI * 4 );
+	const uint dwCodeJ = MortonCodes.Load( j * 4 );
+	if( dwCodeI == dwCodeJ )
+	{
+		return 32 + 31 - firstbithigh( dwI ^ (uint)j );
+	}
+	return 31 - firstbithigh( dwCodeI ^ dwCodeJ );
+}
+
+void StoreChildren( uint dwNode, uint dwLeft, uint dwRight )
+{
+	Nodes.Store( dwNode * BVH_NODE_SIZE + 12, dwLeft );
+	Nodes.Store( dwNode * BVH_NODE_SIZE + 28, dwRight );
+}
+
+[RootSignature(BVH_ROOT_SIGNATURE)]
+[numthreads(BVH_THREADS, 1, 1)]
+void BvhEmitHierarchy( uint3 DTid : SV_DispatchThreadID )
+{
+	const uint dwCount = TriangleCount();
+	const uint i = DTid.x;
+	if( i >= dwCount )
+	{
+		return;
+	}
+	const uint dwLeafBase = dwCount - 1;
+	StoreChildren( dwLeafBase + i, BVH_LEAF_FLAG | PrimIndices.Load( i * 4 ), 0 );
+	if( i == 0 )
+	{
+		Parents.Store( 0, BVH_INVALID_NODE );
+	}
+	if( i >= dwLeafBase )
+	{
+		return;
+	}
+
+	//direction and far end of the range this node covers
+	const int d = CommonPrefix( i, i + 1 ) - CommonPrefix( i, (int)i - 1 ) >= 0 ? 1 : -1;
+	const int dwMinPrefix = CommonPrefix( i, (int)i - d );
+	uint dwMaxLength = 2;
+	while( CommonPrefix( i, (int)i + (int)dwMaxLength * d ) > dwMinPrefix )
+	{
+		dwMaxLength <<= 1;
+	}
+	uint dwLength = 0;
+	for( uint t = dwMaxLength >> 1; t > 0; t >>= 1 )
+	{
+		if( CommonPrefix( i, (int)i + (int)( dwLength + t ) * d ) > dwMinPrefix )
+		{
+			dwLength += t;
+		}
+	}
+	const int j = (int)i + (int)dwLength * d;
+
+	//split position, the last element of the first half
+	const int dwNodePrefix = CommonPrefix( i, j );
+	uint dwSplit = 0;
+	uint t = dwLength;
+	do
+	{
+		t = ( t + 1 ) >> 1;
+		if( CommonPrefix( i, (int)i + (int)( dwSplit + t ) * d ) > dwNodePrefix )
+		{
+			dwSplit += t;
+		}
+	}
+	while( t > 1 );
+	const uint dwGamma = (uint)( (int)i + (int)dwSplit * d + min( d, 0 ) );
+
+	const uint dwLeft = min( (int)i, j ) == (int)dwGamma ? dwLeafBase + dwGamma : dwGamma;
+	const uint dwRight = max( (int)i, j ) == (int)dwGamma + 1 ? dwLeafBase + dwGamma + 1 : dwGamma + 1;
+	StoreChildren( i, dwLeft, dwRight );
+	Parents.Store( dwLeft * 4, i );
+	Parents.Store( dwRight * 4, i );
+	Scratch.Store( i * 4, 0 );
+}
+
+void StoreBox( uint dwNode, float3 minimum, float3 maximum )
+{
+	Nodes.Store3( dwNode * BVH_NODE_SIZE, asuint( minimum ) );
+	Nodes.Store3( dwNode * BVH_NODE_SIZE + 16, asuint( maximum ) );
+}
+
+[RootSignature(BVH_ROOT_SIGNATURE)]
+[numthreads(BVH_THREADS, 1, 1)]
+void BvhRefit( uint3 DTid : SV_DispatchThreadID )
+{
+	const uint dwCount = TriangleCount();
+	if( DTid.x >= dwCount )
+	{
+		return;
+	}
+	uint dwNode = dwCount - 1 + DTid.x;
+	float3 v0, v1, v2;
+	LoadTriangle( Nodes.Load( dwNode * BVH_NODE_SIZE + 12 ) & ~BVH_LEAF_FLAG, v0, v1, v2 );
+	StoreBox( dwNode, min( v0, min( v1, v2 ) ), max( v0, max( v1, v2 ) ) );
+
+	//the first child to arrive stops, the second one sees both boxes and carries on, it also leaves the counter at 0 for the next refit
+	dwNode = Parents.Load( dwNode * 4 );
+	while( dwNode != BVH_INVALID_NODE )
+	{
+		DeviceMemoryBarrier();
+		uint dwArrived;
+		Scratch.InterlockedAdd( dwNode * 4, 1, dwArrived );
+		if( dwArrived == 0 )
+		{
+			return;
+		}
+		Scratch.Store( dwNode * 4, 0 );
+		const uint dwLeft = Nodes.Load( dwNode * BVH_NODE_SIZE + 12 );
+		const uint dwRight = Nodes.Load( dwNode * BVH_NODE_SIZE + 28 );
+		const float3 minimum = min( asfloat( Nodes.Load3( dwLeft * BVH_NODE_SIZE ) ), asfloat( Nodes.Load3( dwRight * BVH_NODE_SIZE ) ) );
+		const float3 maximum = max( asfloat( Nodes.Load3( dwLeft * BVH_NODE_SIZE + 16 ) ), asfloat( Nodes.Load3( dwRight * BVH_NODE_SIZE + 16 ) ) );
+		StoreBox( dwNode, minimum, maximum );
+		dwNode = Parents.Load( dwNode * 4 );
+	}
+}
@@ -0,0 +1,255 @@
+#ifndef COMMAND_ALLOCATOR_POOL_H
+#define COMMAND_ALLOCATOR_POOL_H
+
+//command allocators recycled by fence value, plus a set of threads recording command lists in parallel
+//an allocator can only be Reset once the gpu is done with every list recorded from it, so it goes back to its pool tagged
+//with the fence value signaled after its lists and is handed out again once the fence completed that value
+//pools are per recording thread (an allocator can't be recorded into from two threads at once) and take no locks
+//ParallelRecord() splits a range of items into one contiguous slice per worker, worker n records slice n into its own list,
+//the caller submits the lists in worker order so the gpu sees the items in the same order no matter which thread finished first
+
+#include "Common.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define COMMAND_ALLOCATOR_POOL_CAPACITY 64 //allocators one thread can have in flight
+#define PARALLEL_RECORD_MAX_WORKERS 16
+
+//ID3D12Device::CreateCommandAllocator, NULL on failure
+typedef void *(*PFN_CreateCommandAllocator)( void *pContext );
+
+typedef struct CommandAllocatorPool
+{
+	void *freeAllocators[COMMAND_ALLOCATOR_POOL_CAPACITY];
+	u32 dwFreeCount;
+	void *pendingAllocators[COMMAND_ALLOCATOR_POOL_CAPACITY]; //fifo, fence values only grow so the front completes first
+	u64 pendingFenceValues[COMMAND_ALLOCATOR_POOL_CAPACITY];
+	u32 dwFirstPending;
+	u32 dwPendingCount;
+	u32 dwCreatedCount;
+	u32 dwMaxAllocators;
+	PFN_CreateCommandAllocator pfnCreate;
+	void *pContext;
+} CommandAllocatorPool;
+
+inline
+void InitCommandAllocatorPool( CommandAllocatorPool *pPool, u32 dwMaxAllocators, PFN_CreateCommandAllocator pfnCreate, void *pContext )
+{
+	pPool->dwFreeCount = 0;
+	pPool->dwFirstPending = 0;
+	pPool->dwPendingCount = 0;
+	pPool->dwCreatedCount = 0;
+	pPool->dwMaxAllocators = dwMaxAllocators < COMMAND_ALLOCATOR_POOL_CAPACITY ? dwMaxAllocators : COMMAND_ALLOCATOR_POOL_CAPACITY;
+	pPool->pfnCreate = pfnCreate;
+	pPool->pContext = pContext;
+}
+
+//an allocator the gpu is done with (it still needs a Reset), NULL when all of them are in flight and the pool is at its maximum
+//wait for CommandAllocatorPoolOldestFenceValue() and try again then
+inline
+void *CommandAllocatorPoolAcquire( CommandAllocatorPool *pPool, u64 qwCompletedFenceValue )
+{
+	while( pPool->dwPendingCount > 0 && pPool->pendingFenceValues[pPool->dwFirstPending] <= qwCompletedFenceValue )
+	{
+		pPool->freeAllocators[pPool->dwFreeCount++] = pPool->pendingAllocators[pPool->dwFirstPending];
+		pPool->dwFirstPending = ( pPool->dwFirstPending + 1 ) % COMMAND_ALLOCATOR_POOL_CAPACITY;
+		--pPool->dwPendingCount;
+	}
+	if( pPool->dwFreeCount > 0 )
+	{
+		return pPool->freeAllocators[--pPool->dwFreeCount];
+	}
+	if( pPool->dwCreatedCount == pPool->dwMaxAllocators )
+	{
+		return NULL;
+	}
+	void *pAllocator = pPool->pfnCreate( pPool->pContext );
+	pPool->dwCreatedCount += pAllocator != NULL;
+	return pAllocator;
+}
+
+//qwFenceValue is the value the queue signals after the last list recorded from the allocator, values have to grow from call to call
+inline
+void CommandAllocatorPoolRelease( CommandAllocatorPool *pPool, void *pAllocator, u64 qwFenceValue )
+{
+	const u32 dwPending = ( pPool->dwFirstPending + pPool->dwPendingCount ) % COMMAND_ALLOCATOR_POOL_CAPACITY;
+	pPool->pendingAllocators[dwPending] = pAllocator;
+	pPool->pendingFenceValues[dwPending] = qwFenceValue;
+	++pPool->dwPendingCount;
+}
+
+//0 when nothing is in flight
+inline
+u64 CommandAllocatorPoolOldestFenceValue( const CommandAllocatorPool *pPool )
+{
+	return pPool->dwPendingCount > 0 ? pPool->pendingFenceValues[pPool->dwFirstPending] : 0;
+}
+
+//hands every allocator the pool created to the caller to be released, the gpu has to be done with all of them
+inline
+u32 CommandAllocatorPoolTakeAll( CommandAllocatorPool *pPool, void **ppAllocators )
+{
+	u32 dwCount = 0;
+	for( u32 dwFree = 0; dwFree < pPool->dwFreeCount; ++dwFree )
+	{
+		ppAllocators[dwCount++] = pPool->freeAllocators[dwFree];
+	}
+	for( u32 dwPending = 0; dwPending < pPool->dwPendingCount; ++dwPending )
+	{
+		ppAllocators[dwCount++] = pPool->pendingAllocators[( pPool->dwFirstPending + dwPending ) % COMMAND_ALLOCATOR_POOL_CAPACITY];
+	}
+	pPool->dwFreeCount = 0;
+	pPool->dwPendingCount = 0;
+	pPool->dwCreatedCount = 0;
+	return dwCount;
+}
+
+//records items [dwBegin, dwEnd) into the list of dwWorker using pAllocator, which the callback Resets first
+typedef void (*PFN_RecordCommandRange)( void *pContext, u32 dwWorker, void *pAllocator, u32 dwBegin, u32 dwEnd );
+//ID3D12Fence::GetCompletedValue and a blocking wait for a value
+typedef u64 (*PFN_CompletedFenceValue)( void *pContext );
+typedef void (*PFN_WaitForFenceValue)( void *pContext, u64 qwValue );
+
+typedef struct ParallelRecorder
+{
+	std::thread workers[PARALLEL_RECORD_MAX_WORKERS]; //worker 0 is the thread calling ParallelRecord
+	u32 dwNumWorkers;
+	CommandAllocatorPool pools[PARALLEL_RECORD_MAX_WORKERS];
+
+	PFN_RecordCommandRange pfnRecord;
+	PFN_CompletedFenceValue pfnCompletedValue;
+	PFN_WaitForFenceValue pfnWait;
+	void *pContext;
+
+	std::mutex lock;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	u64 qwGeneration;
+	u32 dwPendingWorkers;
+	bool bQuit;
+
+	//current recording
+	u32 dwItemCount;
+	u64 qwSubmitFenceValue;
+	u32 dwFenceWaits; //times a worker found its pool exhausted
+} ParallelRecorder;
+
+inline
+void ParallelRecordWorker( ParallelRecorder *pRecorder, u32 dwWorker )
+{
+	const u32 dwBegin = (u32)( (u64)pRecorder->dwItemCount * dwWorker / pRecorder->dwNumWorkers );
+	const u32 dwEnd = (u32)( (u64)pRecorder->dwItemCount * ( dwWorker + 1 ) / pRecorder->dwNumWorkers );
+	CommandAllocatorPool *pPool = &pRecorder->pools[dwWorker];
+	void *pAllocator = CommandAllocatorPoolAcquire( pPool, pRecorder->pfnCompletedValue( pRecorder->pContext ) );
+	while( !pAllocator )
+	{
+		const u64 qwOldest = CommandAllocatorPoolOldestFenceValue( pPool );
+		if( qwOldest == 0 )
+		{
+			return; //creating an allocator failed, the caller sees it through its own list
+		}
+		{
+			std::lock_guard<std::mutex> guard( pRecorder->lock );
+			++pRecorder->dwFenceWaits;
+		}
+		pRecorder->pfnWait( pRecorder->pContext, qwOldest );
+		pAllocator = CommandAllocatorPoolAcquire( pPool, pRecorder->pfnCompletedValue( pRecorder->pContext ) );
+	}
+	pRecorder->pfnRecord( pRecorder->pContext, dwWorker, pAllocator, dwBegin, dwEnd );
+	CommandAllocatorPoolRelease( pPool, pAllocator, pRecorder->qwSubmitFenceValue );
+}
+
+inline
+void ParallelRecordArriveAtJoin( ParallelRecorder *pRecorder )
+{
+	std::lock_guard<std::mutex> guard( pRecorder->lock );
+	if( --pRecorder->dwPendingWorkers == 0 )
+	{
+		pRecorder->doneCondition.notify_one();
+	}
+}
+
+inline
+void ParallelRecorderMain( ParallelRecorder *pRecorder, u32 dwWorker )
+{
+	u64 qwSeenGeneration = 0;
+	for( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> guard( pRecorder->lock );
+			pRecorder->wakeCondition.wait( guard, [&]{ return pRecorder->bQuit || pRecorder->qwGeneration != qwSeenGeneration; } );
+			if( pRecorder->bQuit )
+			{
+				return;
+			}
+			qwSeenGeneration = pRecorder->qwGeneration;
+		}
+
+		ParallelRecordWorker( pRecorder, dwWorker );
+		ParallelRecordArriveAtJoin( pRecorder );
+	}
+}
+
+//every worker gets a pool of up to dwMaxAllocatorsPerWorker allocators created with pfnCreate
+inline
+void InitParallelRecorder( ParallelRecorder *pRecorder, u32 dwNumWorkers, u32 dwMaxAllocatorsPerWorker, PFN_CreateCommandAllocator pfnCreate,
+						   PFN_RecordCommandRange pfnRecord, PFN_CompletedFenceValue pfnCompletedValue, PFN_WaitForFenceValue pfnWait, void *pContext )
+{
+	dwNumWorkers = dwNumWorkers == 0 ? 1 : dwNumWorkers > PARALLEL_RECORD_MAX_WORKERS ? PARALLEL_RECORD_MAX_WORKERS : dwNumWorkers;
+	pRecorder->dwNumWorkers = dwNumWorkers;
+	pRecorder->pfnRecord = pfnRecord;
+	pRecorder->pfnCompletedValue = pfnCompletedValue;
+	pRecorder->pfnWait = pfnWait;
+	pRecorder->pContext = pContext;
+	pRecorder->qwGeneration = 0;
+	pRecorder->dwPendingWorkers = 0;
+	pRecorder->bQuit = false;
+	pRecorder->dwItemCount = 0;
+	pRecorder->qwSubmitFenceValue = 0;
+	pRecorder->dwFenceWaits = 0;
+	for( u32 dwWorker = 0; dwWorker < dwNumWorkers; ++dwWorker )
+	{
+		InitCommandAllocatorPool( &pRecorder->pools[dwWorker], dwMaxAllocatorsPerWorker, pfnCreate, pContext );
+	}
+	for( u32 dwWorker = 1; dwWorker < dwNumWorkers; ++dwWorker )
+	{
+		pRecorder->workers[dwWorker] = std::thread( ParallelRecorderMain, pRecorder, dwWorker );
+	}
+}
+
+//the allocators themselves belong to the caller, they are still in the pools
+inline
+void DestroyParallelRecorder( ParallelRecorder *pRecorder )
+{
+	{
+		std::lock_guard<std::mutex> guard( pRecorder->lock );
+		pRecorder->bQuit = true;
+	}
+	pRecorder->wakeCondition.notify_all();
+	for( u32 dwWorker = 1; dwWorker < pRecorder->dwNumWorkers; ++dwWorker )
+	{
+		pRecorder->workers[dwWorker].join();
+	}
+}
+
+//returns once every worker recorded its slice, qwSubmitFenceValue is the value the caller signals after submitting the lists in worker order
+inline
+void ParallelRecord( ParallelRecorder *pRecorder, u32 dwItemCount, u64 qwSubmitFenceValue )
+{
+	{
+		std::lock_guard<std::mutex> guard( pRecorder->lock );
+		pRecorder->dwItemCount = dwItemCount;
+		pRecorder->qwSubmitFenceValue = qwSubmitFenceValue;
+		pRecorder->dwPendingWorkers = pRecorder->dwNumWorkers - 1;
+		++pRecorder->qwGeneration;
+	}
+	pRecorder->wakeCondition.notify_all();
+	ParallelRecordWorker( pRecorder, 0 );
+
+	std::unique_lock<std::mutex> guard( pRecorder->lock );
+	pRecorder->doneCondition.wait( guard, [&]{ return pRecorder->dwPendingWorkers == 0; } );
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+//shared between main.cpp (D3D12) and the portable (GPU-less) targets, so no windows.h in here
+
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef float    f32; //floating 32
+typedef double   f64; //floating 64
+
+//qwAlignment must be a power of two
+inline
+u64 AlignUp( u64 qwValue, u64 qwAlignment )
+{
+	return ( qwValue + qwAlignment - 1 ) & ~( qwAlignment - 1 );
+}
+
+//must match the layouts in ComputeShader.hlsl
+typedef struct ComputeShaderCB
+{
+	u32 dwOffsetsAndStrides0[4];
+} ComputeShaderCB;
+
+typedef struct ModelOutData
+{
+	u32 dwData[4];
+} ModelOutData;
+
+#endif
@@ -12,10 +12,18 @@ if "%Platform%" neq "x64" (
 )
 
 set COMPUTEHADER=ComputeShader.hlsl
+set SCANSHADER=Scan.hlsl
+set RADIXSHADER=RadixSort.hlsl
+set CULLSHADER=Culling.hlsl
+set BVHSHADER=Bvh.hlsl
+set RAYQUERYSHADER=RayQuery.hlsl
 set FILES=main.cpp
+set CPUFILES=CpuMain.cpp
+set BENCHFILES=Bench.cpp
+set MICROBENCHFILES=MicroBench.cpp
 
-set RELEASEFLAGS=/O2 /DMAIN_DEBUG=0 /DRUNTIME_DEBUG_COMPILE=0 /DCOMPILED_DEBUG_CSO=0
-set DEBUGFLAGS=/Zi /DMAIN_DEBUG=1 /DRUNTIME_DEBUG_COMPILE=0 /DCOMPILED_DEBUG_CSO=0
+set RELEASEFLAGS=/O2 /DMAIN_DEBUG=0 /DRUNTIME_DEBUG_COMPILE=0 /DCOMPILED_DEBUG_CSO=0 /DMEASURE_COMPUTE_RATE=0 /DMAIN_TRACE=1 /DMAIN_RESULTS=0 /DMAIN_GPU_CHECKS=0
+set DEBUGFLAGS=/Zi /DMAIN_DEBUG=1 /DRUNTIME_DEBUG_COMPILE=0 /DCOMPILED_DEBUG_CSO=0 /DMEASURE_COMPUTE_RATE=0 /DMAIN_TRACE=1 /DMAIN_RESULTS=0 /DMAIN_GPU_CHECKS=1
 
 ::TODO only link with d3dcompiler.lib if RUNTIME_DEBUG_COMPILE is 1
 set LIBS=d3d12.lib dxgi.lib d3dcompiler.lib dxguid.lib kernel32.lib user32.lib gdi32.lib
@@ -24,8 +32,42 @@ set LIBS=d3d12.lib dxgi.lib d3dcompiler.lib dxguid.lib kernel32.lib user32.lib g
 
 ::Release
 fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv %COMPUTEHADER% /Fh computeShader.h /Vn computeShaderBlob
-cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 %RELEASEFLAGS% %FILES% /Fe: FPSCameraBasic.exe %LIBS% /link /incremental:no /opt:icf /opt:ref /subsystem:console
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E ScanReduceBlocks %SCANSHADER% /Fh scanReduceBlocksShader.h /Vn scanReduceBlocksBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E ScanBlockPartials %SCANSHADER% /Fh scanBlockPartialsShader.h /Vn scanBlockPartialsBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E ScanDownsweep %SCANSHADER% /Fh scanDownsweepShader.h /Vn scanDownsweepBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E RadixUpsweep %RADIXSHADER% /Fh radixUpsweepShader.h /Vn radixUpsweepBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E RadixScatter %RADIXSHADER% /Fh radixScatterShader.h /Vn radixScatterBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E CullInstances %CULLSHADER% /Fh cullInstancesShader.h /Vn cullInstancesBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E CullCompact %CULLSHADER% /Fh cullCompactShader.h /Vn cullCompactBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E CullGatherVisible %CULLSHADER% /Fh cullGatherVisibleShader.h /Vn cullGatherVisibleBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E BvhCentroidBounds %BVHSHADER% /Fh bvhCentroidBoundsShader.h /Vn bvhCentroidBoundsBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E BvhMortonCodes %BVHSHADER% /Fh bvhMortonCodesShader.h /Vn bvhMortonCodesBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E BvhEmitHierarchy %BVHSHADER% /Fh bvhEmitHierarchyShader.h /Vn bvhEmitHierarchyBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E BvhRefit %BVHSHADER% /Fh bvhRefitShader.h /Vn bvhRefitBlob
+fxc /nologo /T cs_5_0 /O3 /WX  /Qstrip_reflect /Qstrip_debug /Qstrip_priv /E RayQueryClosestHit %RAYQUERYSHADER% /Fh rayQueryClosestHitShader.h /Vn rayQueryClosestHitBlob
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 %RELEASEFLAGS% %FILES% /Fe: FPSCameraBasic.exe %LIBS% /link /incremental:no /opt:icf /opt:ref /subsystem:console
 
 ::Debug
 fxc /nologo /T cs_5_0 /Zi /WX %COMPUTEHADER% /Fh computeShaderDebug.h /Vn computeShaderBlob
-cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 %DEBUGFLAGS% %FILES% /FC /Fe: FPSCameraBasicDebug.exe %LIBS% /link /incremental:no /opt:icf /opt:ref /subsystem:console
+fxc /nologo /T cs_5_0 /Zi /WX /E ScanReduceBlocks %SCANSHADER% /Fh scanReduceBlocksShaderDebug.h /Vn scanReduceBlocksBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E ScanBlockPartials %SCANSHADER% /Fh scanBlockPartialsShaderDebug.h /Vn scanBlockPartialsBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E ScanDownsweep %SCANSHADER% /Fh scanDownsweepShaderDebug.h /Vn scanDownsweepBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E RadixUpsweep %RADIXSHADER% /Fh radixUpsweepShaderDebug.h /Vn radixUpsweepBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E RadixScatter %RADIXSHADER% /Fh radixScatterShaderDebug.h /Vn radixScatterBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E CullInstances %CULLSHADER% /Fh cullInstancesShaderDebug.h /Vn cullInstancesBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E CullCompact %CULLSHADER% /Fh cullCompactShaderDebug.h /Vn cullCompactBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E CullGatherVisible %CULLSHADER% /Fh cullGatherVisibleShaderDebug.h /Vn cullGatherVisibleBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E BvhCentroidBounds %BVHSHADER% /Fh bvhCentroidBoundsShaderDebug.h /Vn bvhCentroidBoundsBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E BvhMortonCodes %BVHSHADER% /Fh bvhMortonCodesShaderDebug.h /Vn bvhMortonCodesBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E BvhEmitHierarchy %BVHSHADER% /Fh bvhEmitHierarchyShaderDebug.h /Vn bvhEmitHierarchyBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E BvhRefit %BVHSHADER% /Fh bvhRefitShaderDebug.h /Vn bvhRefitBlob
+fxc /nologo /T cs_5_0 /Zi /WX /E RayQueryClosestHit %RAYQUERYSHADER% /Fh rayQueryClosestHitShaderDebug.h /Vn rayQueryClosestHitBlob
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 %DEBUGFLAGS% %FILES% /FC /Fe: FPSCameraBasicDebug.exe %LIBS% /link /incremental:no /opt:icf /opt:ref /subsystem:console
+
+::CPU backend (no d3d12 device needed)
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 /EHsc %RELEASEFLAGS% %CPUFILES% /Fe: CpuCompute.exe /link /incremental:no /opt:icf /opt:ref /subsystem:console
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 /EHsc %DEBUGFLAGS% %CPUFILES% /FC /Fe: CpuComputeDebug.exe /link /incremental:no /opt:icf /opt:ref /subsystem:console
+
+::Benchmarks (release only)
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 /EHsc %RELEASEFLAGS% %BENCHFILES% /Fe: Bench.exe /link /incremental:no /opt:icf /opt:ref /subsystem:console
+cl /nologo /W3 /GS- /Gs999999 /arch:AVX2 /std:c++20 /EHsc %RELEASEFLAGS% %MICROBENCHFILES% /Fe: MicroBench.exe /link /incremental:no /opt:icf /opt:ref /subsystem:console
@@ -0,0 +1,22 @@
+#!/bin/sh
+#portable (GPU-less) targets, the D3D12 targets are in Compile.bat
+set -e
+
+CXX=${CXX:-g++}
+CPUFILES=CpuMain.cpp
+BENCHFILES=Bench.cpp
+MICROBENCHFILES=MicroBench.cpp
+
+COMMONFLAGS="-std=c++20 -Wall -mavx2 -mfma -pthread"
+RELEASEFLAGS="-O2 -DMAIN_DEBUG=0"
+DEBUGFLAGS="-g -DMAIN_DEBUG=1"
+
+#Release
+$CXX $COMMONFLAGS $RELEASEFLAGS $CPUFILES -o CpuCompute
+
+#Debug
+$CXX $COMMONFLAGS $DEBUGFLAGS $CPUFILES -o CpuComputeDebug
+
+#Benchmarks (release only)
+$CXX $COMMONFLAGS $RELEASEFLAGS $BENCHFILES -o Bench
+$CXX $COMMONFLAGS $RELEASEFLAGS $MICROBENCHFILES -o MicroBench
@@ -0,0 +1,385 @@
+#ifndef CPU_COMPUTE_H
+#define CPU_COMPUTE_H
+
+//CPU execution backend for compute kernels, runs the same dispatch model as ComputeShader.hlsl on machines without a d3d12 device
+//kernels are plain c++ functions that get SV_GroupID/SV_GroupThreadID/SV_DispatchThreadID/SV_GroupIndex, thread groups are spread across all cores
+
+#include "Common.h"
+#include "CpuFence.h"
+#include "WorkStealing.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define CPU_COMPUTE_MAX_WORKERS 256
+#define CPU_COMPUTE_MAX_PHASES 8
+#define CPU_COMPUTE_MAX_GROUPSHARED 32768 //same as the d3d12 cs_5_0 groupshared limit
+#define CPU_COMPUTE_MAX_UAVS 5
+
+enum CpuComputeSchedule
+{
+	CPU_COMPUTE_SCHEDULE_STATIC = 0,        //one contiguous slice of groups per worker
+	CPU_COMPUTE_SCHEDULE_WORK_STEALING = 1, //slices are split into stealable chunks, for grids with uneven per group cost
+};
+
+typedef struct CpuUint3
+{
+	u32 x;
+	u32 y;
+	u32 z;
+} CpuUint3;
+
+//Mirrors the [RootSignature] in ComputeShader.hlsl: RootConstants(num32BitConstants=4, b0), SRV(t0), UAV(u0)
+typedef struct CpuComputeRootArgs
+{
+	ComputeShaderCB cb;                //b0 dwOffsetsAndStrides0
+	const u8 *pCbv;                    //b1 root CBV of kernels that have one (Culling.hlsl)
+	const u8 *pVerticesAndIndices;     //t0 ByteAddressBuffer
+	u64 qwVerticesAndIndicesSize;
+	ModelOutData *pOut;                //u0 RWStructuredBuffer<ModelOutData>
+	u64 qwOutCount;
+	//kernels with their own root signature (Scan.hlsl, RadixSort.hlsl, ...) bind raw buffers instead of Out
+	u8 *pUavs[CPU_COMPUTE_MAX_UAVS];   //u0.. RWByteAddressBuffer/RWStructuredBuffer<uint>
+} CpuComputeRootArgs;
+
+typedef struct CpuComputeThreadIds
+{
+	CpuUint3 Gid;  //SV_GroupID
+	CpuUint3 GTid; //SV_GroupThreadID
+	CpuUint3 DTid; //SV_DispatchThreadID
+	u32 GI;        //SV_GroupIndex
+} CpuComputeThreadIds;
+
+//one call per thread of the group, every thread of a group finishes a phase before any thread starts the next one (acts as GroupMemoryBarrierWithGroupSync)
+typedef void (*PFN_CpuComputePhase)( const CpuComputeRootArgs *pRoot, const CpuComputeThreadIds *pIds, void *pGroupShared );
+//one call per group, the kernel loops over its own threads (lets a kernel vectorize across the group)
+typedef void (*PFN_CpuComputeGroup)( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared );
+
+typedef struct CpuComputeKernel
+{
+	PFN_CpuComputePhase pfnPhases[CPU_COMPUTE_MAX_PHASES];
+	u32 dwNumPhases;
+	PFN_CpuComputeGroup pfnGroup; //if set pfnPhases are ignored
+	u32 dwNumThreads[3];          //[numthreads(x,y,z)]
+	u32 dwGroupSharedSize;        //bytes of groupshared memory, zeroed at the start of every group
+} CpuComputeKernel;
+
+typedef struct CpuComputeDevice
+{
+	std::thread workers[CPU_COMPUTE_MAX_WORKERS]; //worker 0 is the thread calling CpuDispatch
+	u32 dwNumWorkers;
+	u8 *pGroupSharedMem; //CPU_COMPUTE_MAX_GROUPSHARED per worker
+
+	WorkDeque *pDeques;  //one per worker
+	CpuComputeSchedule eSchedule;
+	u64 qwStealGrain;    //groups per chunk, 0 picks one from the grid size
+
+	std::mutex lock;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	u64 qwGeneration;
+	u32 dwPendingWorkers; //join barrier
+	bool bQuit;
+
+	//current dispatch
+	const CpuComputeKernel *pKernel;
+	CpuComputeRootArgs root;
+	u32 dwGroupCount[3];
+	u64 qwGrain;
+	std::atomic<u64> qwGroupsRemaining;
+	CpuFence *pSignalFence;
+	u64 qwSignalValue;
+} CpuComputeDevice;
+
+inline
+u32 CpuComputeNumCores()
+{
+	u32 dwCores = std::thread::hardware_concurrency();
+	return dwCores ? dwCores : 1;
+}
+
+inline
+void CpuComputeRunGroup( const CpuComputeKernel *pKernel, const CpuComputeRootArgs *pRoot, const u32 dwGroupCount[3], u64 qwGroupIdx, u8 *pGroupShared )
+{
+	CpuComputeThreadIds ids;
+	ids.Gid.x = (u32)( qwGroupIdx % dwGroupCount[0] );
+	ids.Gid.y = (u32)( ( qwGroupIdx / dwGroupCount[0] ) % dwGroupCount[1] );
+	ids.Gid.z = (u32)( qwGroupIdx / ( (u64)dwGroupCount[0] * dwGroupCount[1] ) );
+
+	if( pKernel->dwGroupSharedSize )
+	{
+		memset( pGroupShared, 0, pKernel->dwGroupSharedSize );
+	}
+
+	if( pKernel->pfnGroup )
+	{
+		pKernel->pfnGroup( pRoot, ids.Gid, pGroupShared );
+		return;
+	}
+
+	for( u32 dwPhase = 0; dwPhase < pKernel->dwNumPhases; ++dwPhase )
+	{
+		ids.GI = 0;
+		for( u32 dwZ = 0; dwZ < pKernel->dwNumThreads[2]; ++dwZ )
+		{
+			for( u32 dwY = 0; dwY < pKernel->dwNumThreads[1]; ++dwY )
+			{
+				for( u32 dwX = 0; dwX < pKernel->dwNumThreads[0]; ++dwX )
+				{
+					ids.GTid.x = dwX;
+					ids.GTid.y = dwY;
+					ids.GTid.z = dwZ;
+					ids.DTid.x = ids.Gid.x * pKernel->dwNumThreads[0] + dwX;
+					ids.DTid.y = ids.Gid.y * pKernel->dwNumThreads[1] + dwY;
+					ids.DTid.z = ids.Gid.z * pKernel->dwNumThreads[2] + dwZ;
+					pKernel->pfnPhases[dwPhase]( pRoot, &ids, pGroupShared );
+					++ids.GI;
+				}
+			}
+		}
+	}
+}
+
+//static split, worker n gets the nth contiguous slice of the flattened group grid
+inline
+WorkRange CpuComputeWorkerSlice( CpuComputeDevice *pDevice, u32 dwWorker )
+{
+	const u64 qwTotalGroups = (u64)pDevice->dwGroupCount[0] * pDevice->dwGroupCount[1] * pDevice->dwGroupCount[2];
+	WorkRange slice;
+	slice.qwBegin = ( qwTotalGroups * dwWorker ) / pDevice->dwNumWorkers;
+	slice.qwEnd = ( qwTotalGroups * ( dwWorker + 1 ) ) / pDevice->dwNumWorkers;
+	return slice;
+}
+
+inline
+void CpuComputeRunRange( CpuComputeDevice *pDevice, WorkRange range, u8 *pGroupShared )
+{
+	for( u64 qwGroupIdx = range.qwBegin; qwGroupIdx < range.qwEnd; ++qwGroupIdx )
+	{
+		CpuComputeRunGroup( pDevice->pKernel, &pDevice->root, pDevice->dwGroupCount, qwGroupIdx, pGroupShared );
+	}
+}
+
+//every worker starts on its static slice, once its own deque runs dry it steals chunks from random victims until the whole grid is done
+inline
+void CpuComputeRunWorkStealing( CpuComputeDevice *pDevice, u32 dwWorker, u8 *pGroupShared )
+{
+	WorkDeque *pOwn = &pDevice->pDeques[dwWorker];
+	WorkRange range = CpuComputeWorkerSlice( pDevice, dwWorker );
+	if( range.qwEnd > range.qwBegin )
+	{
+		WorkDequePush( pOwn, range );
+	}
+
+	u32 dwRandomState = 0x9E3779B9u * ( dwWorker + 1 );
+	while( pDevice->qwGroupsRemaining.load( std::memory_order_acquire ) > 0 )
+	{
+		bool bFound = WorkDequePop( pOwn, &range );
+		for( u32 dwAttempt = 0; !bFound && dwAttempt < pDevice->dwNumWorkers; ++dwAttempt )
+		{
+			u32 dwVictim = WorkStealRandom( &dwRandomState ) % pDevice->dwNumWorkers;
+			if( dwVictim != dwWorker )
+			{
+				bFound = WorkDequeSteal( &pDevice->pDeques[dwVictim], &range );
+			}
+		}
+		if( !bFound )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		range = WorkDequeSplit( pOwn, range, pDevice->qwGrain );
+		CpuComputeRunRange( pDevice, range, pGroupShared );
+		pDevice->qwGroupsRemaining.fetch_sub( range.qwEnd - range.qwBegin, std::memory_order_acq_rel );
+	}
+}
+
+inline
+void CpuComputeRunWorkerShare( CpuComputeDevice *pDevice, u32 dwWorker )
+{
+	u8 *pGroupShared = pDevice->pGroupSharedMem + (u64)dwWorker * CPU_COMPUTE_MAX_GROUPSHARED;
+	if( pDevice->eSchedule == CPU_COMPUTE_SCHEDULE_WORK_STEALING )
+	{
+		CpuComputeRunWorkStealing( pDevice, dwWorker, pGroupShared );
+	}
+	else
+	{
+		CpuComputeRunRange( pDevice, CpuComputeWorkerSlice( pDevice, dwWorker ), pGroupShared );
+	}
+}
+
+//join barrier, the last worker out signals the fence the same way computeQueue->Signal( computeFence, ... ) does after a Dispatch
+inline
+void CpuComputeArriveAtJoin( CpuComputeDevice *pDevice )
+{
+	std::lock_guard<std::mutex> guard( pDevice->lock );
+	if( --pDevice->dwPendingWorkers == 0 )
+	{
+		if( pDevice->pSignalFence )
+		{
+			CpuFenceSignal( pDevice->pSignalFence, pDevice->qwSignalValue );
+		}
+		pDevice->doneCondition.notify_one();
+	}
+}
+
+inline
+void CpuComputeWorkerMain( CpuComputeDevice *pDevice, u32 dwWorker )
+{
+	u64 qwSeenGeneration = 0;
+	for( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> guard( pDevice->lock );
+			pDevice->wakeCondition.wait( guard, [&]{ return pDevice->bQuit || pDevice->qwGeneration != qwSeenGeneration; } );
+			if( pDevice->bQuit )
+			{
+				return;
+			}
+			qwSeenGeneration = pDevice->qwGeneration;
+		}
+
+		CpuComputeRunWorkerShare( pDevice, dwWorker );
+		CpuComputeArriveAtJoin( pDevice );
+	}
+}
+
+//dwNumWorkers of 0 uses every core
+inline
+bool InitCpuComputeDevice( CpuComputeDevice *pDevice, u32 dwNumWorkers )
+{
+	if( dwNumWorkers == 0 )
+	{
+		dwNumWorkers = CpuComputeNumCores();
+	}
+	if( dwNumWorkers > CPU_COMPUTE_MAX_WORKERS )
+	{
+		dwNumWorkers = CPU_COMPUTE_MAX_WORKERS;
+	}
+
+	pDevice->pGroupSharedMem = (u8*)malloc( (u64)dwNumWorkers * CPU_COMPUTE_MAX_GROUPSHARED );
+	if( !pDevice->pGroupSharedMem )
+	{
+		return false;
+	}
+	pDevice->pDeques = new WorkDeque[dwNumWorkers];
+	for( u32 dwWorker = 0; dwWorker < dwNumWorkers; ++dwWorker )
+	{
+		InitWorkDeque( &pDevice->pDeques[dwWorker] );
+	}
+	pDevice->eSchedule = CPU_COMPUTE_SCHEDULE_WORK_STEALING;
+	pDevice->qwStealGrain = 0;
+	pDevice->dwNumWorkers = dwNumWorkers;
+	pDevice->qwGeneration = 0;
+	pDevice->dwPendingWorkers = 0;
+	pDevice->bQuit = false;
+	pDevice->pKernel = NULL;
+
+	for( u32 dwWorker = 1; dwWorker < dwNumWorkers; ++dwWorker )
+	{
+		pDevice->workers[dwWorker] = std::thread( CpuComputeWorkerMain, pDevice, dwWorker );
+	}
+	return true;
+}
+
+inline
+void DestroyCpuComputeDevice( CpuComputeDevice *pDevice )
+{
+	{
+		std::lock_guard<std::mutex> guard( pDevice->lock );
+		pDevice->bQuit = true;
+	}
+	pDevice->wakeCondition.notify_all();
+	for( u32 dwWorker = 1; dwWorker < pDevice->dwNumWorkers; ++dwWorker )
+	{
+		pDevice->workers[dwWorker].join();
+	}
+	free( pDevice->pGroupSharedMem );
+	pDevice->pGroupSharedMem = NULL;
+	delete[] pDevice->pDeques;
+	pDevice->pDeques = NULL;
+}
+
+//equivalent of SetComputeRoot* + Dispatch(x,y,z) + Signal( pFence, qwFenceValue ), returns once every group has run
+//pFence can be NULL
+inline
+void CpuDispatch( CpuComputeDevice *pDevice, const CpuComputeKernel *pKernel, const CpuComputeRootArgs *pRoot, u32 dwGroupCountX, u32 dwGroupCountY, u32 dwGroupCountZ, CpuFence *pFence = NULL, u64 qwFenceValue = 0 )
+{
+#if MAIN_DEBUG
+	assert( pKernel->dwGroupSharedSize <= CPU_COMPUTE_MAX_GROUPSHARED );
+	assert( pKernel->pfnGroup || ( pKernel->dwNumPhases > 0 && pKernel->dwNumPhases <= CPU_COMPUTE_MAX_PHASES ) );
+#endif
+	const u64 qwTotalGroups = (u64)dwGroupCountX * dwGroupCountY * dwGroupCountZ;
+	if( qwTotalGroups == 0 )
+	{
+		if( pFence )
+		{
+			CpuFenceSignal( pFence, qwFenceValue );
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard( pDevice->lock );
+		pDevice->pKernel = pKernel;
+		pDevice->root = *pRoot;
+		pDevice->dwGroupCount[0] = dwGroupCountX;
+		pDevice->dwGroupCount[1] = dwGroupCountY;
+		pDevice->dwGroupCount[2] = dwGroupCountZ;
+		//~16 chunks per worker keeps the steal traffic low while still evening out uneven groups
+		pDevice->qwGrain = pDevice->qwStealGrain ? pDevice->qwStealGrain : qwTotalGroups / ( (u64)pDevice->dwNumWorkers * 16 );
+		if( pDevice->qwGrain == 0 )
+		{
+			pDevice->qwGrain = 1;
+		}
+		pDevice->qwGroupsRemaining.store( qwTotalGroups, std::memory_order_relaxed );
+		pDevice->pSignalFence = pFence;
+		pDevice->qwSignalValue = qwFenceValue;
+		pDevice->dwPendingWorkers = pDevice->dwNumWorkers;
+		++pDevice->qwGeneration;
+	}
+	pDevice->wakeCondition.notify_all();
+
+	CpuComputeRunWorkerShare( pDevice, 0 );
+	CpuComputeArriveAtJoin( pDevice );
+
+	std::unique_lock<std::mutex> guard( pDevice->lock );
+	pDevice->doneCondition.wait( guard, [&]{ return pDevice->dwPendingWorkers == 0; } );
+}
+
+//C++ port of main() in ComputeShader.hlsl
+#define INDEX_BLOCK_SIZE 1
+
+inline
+void ComputeShaderMainCpu( const CpuComputeRootArgs *pRoot, const CpuComputeThreadIds *pIds, void *pGroupShared )
+{
+	//out of bounds uav writes are dropped on the gpu, do the same here
+	if( pRoot->qwOutCount == 0 )
+	{
+		return;
+	}
+	for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+	{
+		pRoot->pOut[0].dwData[dwIdx] = 2 * pRoot->cb.dwOffsetsAndStrides0[dwIdx];
+	}
+}
+
+inline
+void InitComputeShaderMainCpuKernel( CpuComputeKernel *pKernel )
+{
+	memset( pKernel, 0, sizeof(CpuComputeKernel) );
+	pKernel->pfnPhases[0] = ComputeShaderMainCpu;
+	pKernel->dwNumPhases = 1;
+	pKernel->dwNumThreads[0] = INDEX_BLOCK_SIZE;
+	pKernel->dwNumThreads[1] = 1;
+	pKernel->dwNumThreads[2] = 1;
+}
+
+#endif
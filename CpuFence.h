@@ -0,0 +1,148 @@
+#ifndef CPU_FENCE_H
+#define CPU_FENCE_H
+
+//cpu stand in for ID3D12Fence, a monotonically increasing value that can be signaled and waited on
+
+#include "Common.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#define CPU_FENCE_MAX_EVENTS 16
+
+//cpu stand in for an auto reset event HANDLE (CreateEvent( NULL, FALSE, FALSE, NULL ))
+typedef struct CpuEvent
+{
+	std::mutex lock;
+	std::condition_variable setCondition;
+	bool bSet;
+} CpuEvent;
+
+inline
+void InitCpuEvent( CpuEvent *pEvent )
+{
+	pEvent->bSet = false;
+}
+
+//SetEvent
+inline
+void CpuEventSet( CpuEvent *pEvent )
+{
+	{
+		std::lock_guard<std::mutex> guard( pEvent->lock );
+		pEvent->bSet = true;
+	}
+	pEvent->setCondition.notify_one();
+}
+
+//WaitForSingleObject( ..., INFINITE ), resets the event
+inline
+void CpuEventWait( CpuEvent *pEvent )
+{
+	std::unique_lock<std::mutex> guard( pEvent->lock );
+	pEvent->setCondition.wait( guard, [&]{ return pEvent->bSet; } );
+	pEvent->bSet = false;
+}
+
+typedef struct CpuFenceEvent
+{
+	CpuEvent *pEvent;
+	u64 qwValue;
+} CpuFenceEvent;
+
+typedef struct CpuFence
+{
+	std::atomic<u64> qwCompletedValue;
+	std::mutex lock;
+	std::condition_variable completedCondition;
+	CpuFenceEvent events[CPU_FENCE_MAX_EVENTS]; //pending SetEventOnCompletion calls, guarded by lock
+	u32 dwEventCount;
+} CpuFence;
+
+inline
+void InitCpuFence( CpuFence *pFence, u64 qwInitialValue )
+{
+	pFence->qwCompletedValue.store( qwInitialValue, std::memory_order_relaxed );
+	pFence->dwEventCount = 0;
+}
+
+//ID3D12Fence::GetCompletedValue
+inline
+u64 CpuFenceGetCompletedValue( CpuFence *pFence )
+{
+	return pFence->qwCompletedValue.load( std::memory_order_acquire );
+}
+
+//ID3D12CommandQueue::Signal, everything written before the signal is visible to whoever observes the value
+inline
+void CpuFenceSignal( CpuFence *pFence, u64 qwValue )
+{
+	CpuEvent *pReached[CPU_FENCE_MAX_EVENTS];
+	u32 dwReachedCount = 0;
+	{
+		std::lock_guard<std::mutex> guard( pFence->lock );
+		pFence->qwCompletedValue.store( qwValue, std::memory_order_release );
+		for( u32 dwEvent = 0; dwEvent < pFence->dwEventCount; )
+		{
+			if( pFence->events[dwEvent].qwValue <= qwValue )
+			{
+				pReached[dwReachedCount++] = pFence->events[dwEvent].pEvent;
+				pFence->events[dwEvent] = pFence->events[--pFence->dwEventCount];
+			}
+			else
+			{
+				++dwEvent;
+			}
+		}
+	}
+	pFence->completedCondition.notify_all();
+	for( u32 dwEvent = 0; dwEvent < dwReachedCount; ++dwEvent )
+	{
+		CpuEventSet( pReached[dwEvent] );
+	}
+}
+
+//ID3D12Fence::SetEventOnCompletion, the event is set right away if the value is already reached
+//registering an event that is already pending keeps the lower of the two values, and when every slot is taken the event
+//is set early, so waiters have to recheck the completed value like they would after a spurious wake
+inline
+void CpuFenceSetEventOnCompletion( CpuFence *pFence, u64 qwValue, CpuEvent *pEvent )
+{
+	{
+		std::lock_guard<std::mutex> guard( pFence->lock );
+		if( pFence->qwCompletedValue.load( std::memory_order_relaxed ) < qwValue )
+		{
+			for( u32 dwEvent = 0; dwEvent < pFence->dwEventCount; ++dwEvent )
+			{
+				if( pFence->events[dwEvent].pEvent == pEvent )
+				{
+					pFence->events[dwEvent].qwValue = qwValue < pFence->events[dwEvent].qwValue ? qwValue : pFence->events[dwEvent].qwValue;
+					return;
+				}
+			}
+		}
+		if( pFence->qwCompletedValue.load( std::memory_order_relaxed ) < qwValue && pFence->dwEventCount < CPU_FENCE_MAX_EVENTS )
+		{
+			pFence->events[pFence->dwEventCount].pEvent = pEvent;
+			pFence->events[pFence->dwEventCount].qwValue = qwValue;
+			++pFence->dwEventCount;
+			return;
+		}
+	}
+	CpuEventSet( pEvent );
+}
+
+//SetEventOnCompletion + WaitForSingleObject( ..., INFINITE )
+inline
+void CpuFenceWait( CpuFence *pFence, u64 qwValue )
+{
+	if( CpuFenceGetCompletedValue( pFence ) >= qwValue )
+	{
+		return;
+	}
+	std::unique_lock<std::mutex> guard( pFence->lock );
+	pFence->completedCondition.wait( guard, [&]{ return pFence->qwCompletedValue.load( std::memory_order_acquire ) >= qwValue; } );
+}
+
+#endif
@@ -0,0 +1,203 @@
+//GPU-less entry point, runs the dispatches from InitDirectX12() on the cpu backend and checks the readback values
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common.h"
+#include "Models.h"
+#include "MeshOptimize.h"
+#include "MeshPack.h"
+#include "CpuCompute.h"
+#include "TraceEvents.h"
+#include "ResultSink.h"
+
+CpuComputeDevice cpuDevice;
+
+u8 *pVerticesAndIndices;
+u64 qwVerticesAndIndicesSize;
+
+ModelOutData computeOutput[2];
+
+#define MODEL_PACK_PATH "Models.mpk"
+#define RESULTS_QUEUE_DEPTH 16
+
+MeshPackFile modelPack;
+u8 *pBuiltinBlob;
+
+//same sources as UploadModels(), the mapped pack blob is bound as t0 directly since there is no upload heap to copy into
+bool UploadModelsCpu( const char *pPackPath )
+{
+	if( OpenMeshPack( pPackPath, &modelPack ) && modelPack.pHeader->dwMeshCount >= BUILTIN_MESH_COUNT )
+	{
+		pVerticesAndIndices = (u8*)MeshPackBlob( &modelPack );
+		qwVerticesAndIndicesSize = modelPack.pHeader->qwBlobSize;
+		return true;
+	}
+	CloseMeshPack( &modelPack );
+
+	MeshData builtinMeshes[BUILTIN_MESH_COUNT];
+	if( !OptimizeBuiltinMeshes( builtinMeshes ) )
+	{
+		return false;
+	}
+	qwVerticesAndIndicesSize = PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, NULL, NULL );
+	pBuiltinBlob = (u8*)malloc( qwVerticesAndIndicesSize );
+	if( pBuiltinBlob )
+	{
+		PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, pBuiltinBlob, NULL );
+	}
+	FreeMeshData( &builtinMeshes[BUILTIN_MESH_PLANE] );
+	FreeMeshData( &builtinMeshes[BUILTIN_MESH_CUBE] );
+	pVerticesAndIndices = pBuiltinBlob;
+	return pBuiltinBlob != NULL;
+}
+
+void ReleaseModelsCpu()
+{
+	CloseMeshPack( &modelPack );
+	free( pBuiltinBlob );
+	pBuiltinBlob = NULL;
+	pVerticesAndIndices = NULL;
+}
+
+//writes the optimized built in meshes as a mesh pack for UploadModels()
+bool BakeModels( const char *pPath )
+{
+	MeshData builtinMeshes[BUILTIN_MESH_COUNT];
+	if( !OptimizeBuiltinMeshes( builtinMeshes ) )
+	{
+		return false;
+	}
+	bool bWritten = WriteMeshPack( pPath, builtinMeshes, BUILTIN_MESH_COUNT );
+	FreeMeshData( &builtinMeshes[BUILTIN_MESH_PLANE] );
+	FreeMeshData( &builtinMeshes[BUILTIN_MESH_CUBE] );
+	return bWritten;
+}
+
+//the readback values as they would leave InitDirectX12() with MAIN_RESULTS=1, through the result sink
+bool WriteResultsCpu( const char *pResultsPath )
+{
+	ResultSink *pSink = (ResultSink*)malloc( sizeof(ResultSink) );
+	bool bWritten = OpenResultSink( pSink, pResultsPath, RESULTS_QUEUE_DEPTH );
+	if( bWritten )
+	{
+		const u64 qwTraceStart = TraceBegin();
+		bWritten = ResultSinkAppend( pSink, (const u8*)computeOutput, sizeof(computeOutput), 1 );
+		bWritten &= CloseResultSink( pSink );
+		TraceEnd( qwTraceStart, TRACE_KIND_MEMCPY, "Write results", NULL, sizeof(computeOutput) );
+	}
+	free( pSink );
+	return bWritten;
+}
+
+bool RunComputeCpu( const char *pPackPath, const char *pResultsPath )
+{
+	if( !InitCpuComputeDevice( &cpuDevice, 0 ) )
+	{
+		printf( "Failed to create cpu compute device!\n" );
+		return false;
+	}
+	const u64 qwTraceStart = TraceBegin();
+	if( !UploadModelsCpu( pPackPath ) )
+	{
+		printf( "Failed to upload models!\n" );
+		return false;
+	}
+	TraceEnd( qwTraceStart, TRACE_KIND_MEMCPY, "Upload models", NULL, qwVerticesAndIndicesSize );
+
+	CpuComputeKernel kernel;
+	InitComputeShaderMainCpuKernel( &kernel );
+
+	CpuComputeRootArgs root;
+	root.pVerticesAndIndices = pVerticesAndIndices;
+	root.qwVerticesAndIndicesSize = qwVerticesAndIndicesSize;
+	root.qwOutCount = 1;
+	for( u32 dwDispatch = 0; dwDispatch < 2; ++dwDispatch )
+	{
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			root.cb.dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
+		}
+		root.pOut = &computeOutput[dwDispatch];
+		const u64 qwDispatchTraceStart = TraceBegin();
+		CpuDispatch( &cpuDevice, &kernel, &root, 1, 1, 1 );
+		TraceEnd( qwDispatchTraceStart, TRACE_KIND_EXECUTE, "CpuDispatch", "compute", 1 );
+	}
+
+	printf("%u %u %u %u\n%u %u %u %u\n",computeOutput[0].dwData[0],computeOutput[0].dwData[1],computeOutput[0].dwData[2],computeOutput[0].dwData[3],
+										computeOutput[1].dwData[0],computeOutput[1].dwData[1],computeOutput[1].dwData[2],computeOutput[1].dwData[3]);
+
+	//expected values are what InitDirectX12() prints on a gpu
+	bool bMatch = true;
+	for( u32 dwDispatch = 0; dwDispatch < 2; ++dwDispatch )
+	{
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			bMatch &= computeOutput[dwDispatch].dwData[dwIdx] == 2 * ( dwDispatch*4 + dwIdx );
+		}
+	}
+
+	DestroyCpuComputeDevice( &cpuDevice );
+	ReleaseModelsCpu();
+	if( !bMatch )
+	{
+		printf( "Readback mismatch!\n" );
+	}
+	if( pResultsPath && !WriteResultsCpu( pResultsPath ) )
+	{
+		printf( "Failed to write results %s!\n", pResultsPath );
+		return false;
+	}
+	return bMatch;
+}
+
+//CpuCompute [--models path]      run the InitDirectX12() dispatches, uses the mesh pack at path (default Models.mpk) when it exists
+//CpuCompute --bake-models path    write the built in meshes as a mesh pack
+//CpuCompute --trace path          also write a chrome trace of the run to path
+//CpuCompute --results path        also write the readback values to path
+int main( int argc, char **argv )
+{
+	const char *pPackPath = MODEL_PACK_PATH;
+	const char *pTracePath = NULL;
+	const char *pResultsPath = NULL;
+	for( int dwArg = 1; dwArg + 1 < argc; dwArg += 2 )
+	{
+		if( strcmp( argv[dwArg], "--bake-models" ) == 0 )
+		{
+			if( !BakeModels( argv[dwArg + 1] ) )
+			{
+				printf( "Failed to write mesh pack %s!\n", argv[dwArg + 1] );
+				return -1;
+			}
+			return 0;
+		}
+		if( strcmp( argv[dwArg], "--models" ) == 0 )
+		{
+			pPackPath = argv[dwArg + 1];
+		}
+		if( strcmp( argv[dwArg], "--trace" ) == 0 )
+		{
+			pTracePath = argv[dwArg + 1];
+		}
+		if( strcmp( argv[dwArg], "--results" ) == 0 )
+		{
+			pResultsPath = argv[dwArg + 1];
+		}
+	}
+
+	if( pTracePath )
+	{
+		TraceSetThreadName( "main" );
+		TraceEnable( true );
+	}
+	if( !RunComputeCpu( pPackPath, pResultsPath ) )
+	{
+		return -1;
+	}
+	if( pTracePath && WriteTraceJson( pTracePath, "CpuCompute" ) < 0 )
+	{
+		printf( "Failed to write trace %s!\n", pTracePath );
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef CPU_QUEUE_H
+#define CPU_QUEUE_H
+
+//cpu stand in for ID3D12CommandQueue, a thread that runs submitted work in order so it is asynchronous to the submitter
+//ExecuteCommandLists, Signal and Wait are all just entries in one fifo, exactly like they are on a real queue
+
+#include "Common.h"
+#include "CpuFence.h"
+#include "TraceEvents.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define CPU_QUEUE_CAPACITY 256 //submitting to a full queue blocks until the queue catches up
+
+typedef void (*PFN_CpuQueueWork)( void *pContext );
+
+enum CpuQueueCommandType
+{
+	CPU_QUEUE_COMMAND_EXECUTE,
+	CPU_QUEUE_COMMAND_SIGNAL,
+	CPU_QUEUE_COMMAND_WAIT,
+	CPU_QUEUE_COMMAND_EXIT
+};
+
+typedef struct CpuQueueCommand
+{
+	u32 eType;
+	PFN_CpuQueueWork pfnWork;
+	void *pContext;
+	CpuFence *pFence;
+	u64 qwValue;
+} CpuQueueCommand;
+
+typedef struct CpuQueue
+{
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable submitCondition;
+	std::condition_variable spaceCondition;
+	CpuQueueCommand commands[CPU_QUEUE_CAPACITY];
+	u32 dwFirst;
+	u32 dwCount;
+	const char *pName; //track name of the queue thread in the trace, its events are what the gpu timeline would show
+} CpuQueue;
+
+inline
+void CpuQueueMain( CpuQueue *pQueue )
+{
+	TraceSetThreadName( pQueue->pName );
+	for( ;; )
+	{
+		CpuQueueCommand command;
+		{
+			std::unique_lock<std::mutex> guard( pQueue->lock );
+			pQueue->submitCondition.wait( guard, [&]{ return pQueue->dwCount > 0; } );
+			command = pQueue->commands[pQueue->dwFirst];
+			pQueue->dwFirst = ( pQueue->dwFirst + 1 ) % CPU_QUEUE_CAPACITY;
+			--pQueue->dwCount;
+		}
+		pQueue->spaceCondition.notify_one();
+
+		const u64 qwTraceStart = TraceBegin();
+		switch( command.eType )
+		{
+			case CPU_QUEUE_COMMAND_EXECUTE:
+				command.pfnWork( command.pContext );
+				TraceEnd( qwTraceStart, TRACE_KIND_EXECUTE, "Execute", pQueue->pName, 1 );
+				break;
+			case CPU_QUEUE_COMMAND_SIGNAL:
+				CpuFenceSignal( command.pFence, command.qwValue );
+				TraceEnd( qwTraceStart, TRACE_KIND_SIGNAL, "Signal", pQueue->pName, command.qwValue );
+				break;
+			case CPU_QUEUE_COMMAND_WAIT:
+				CpuFenceWait( command.pFence, command.qwValue );
+				TraceEnd( qwTraceStart, TRACE_KIND_QUEUE_WAIT, "Wait", pQueue->pName, command.qwValue );
+				break;
+			default:
+				return;
+		}
+	}
+}
+
+inline
+void CpuQueueSubmit( CpuQueue *pQueue, const CpuQueueCommand *pCommand )
+{
+	{
+		std::unique_lock<std::mutex> guard( pQueue->lock );
+		pQueue->spaceCondition.wait( guard, [&]{ return pQueue->dwCount < CPU_QUEUE_CAPACITY; } );
+		pQueue->commands[( pQueue->dwFirst + pQueue->dwCount ) % CPU_QUEUE_CAPACITY] = *pCommand;
+		++pQueue->dwCount;
+	}
+	pQueue->submitCondition.notify_one();
+}
+
+inline
+void InitCpuQueue( CpuQueue *pQueue, const char *pName = "CpuQueue" )
+{
+	pQueue->dwFirst = 0;
+	pQueue->dwCount = 0;
+	pQueue->pName = pName;
+	pQueue->thread = std::thread( CpuQueueMain, pQueue );
+}
+
+//everything already submitted still runs
+inline
+void DestroyCpuQueue( CpuQueue *pQueue )
+{
+	CpuQueueCommand command = {};
+	command.eType = CPU_QUEUE_COMMAND_EXIT;
+	CpuQueueSubmit( pQueue, &command );
+	pQueue->thread.join();
+}
+
+//ID3D12CommandQueue::ExecuteCommandLists, pContext has to stay alive until the work ran (signal a fence after it to know when)
+inline
+void CpuQueueExecute( CpuQueue *pQueue, PFN_CpuQueueWork pfnWork, void *pContext )
+{
+	CpuQueueCommand command = {};
+	command.eType = CPU_QUEUE_COMMAND_EXECUTE;
+	command.pfnWork = pfnWork;
+	command.pContext = pContext;
+	CpuQueueSubmit( pQueue, &command );
+}
+
+//ID3D12CommandQueue::Signal
+inline
+void CpuQueueSignal( CpuQueue *pQueue, CpuFence *pFence, u64 qwValue )
+{
+	CpuQueueCommand command = {};
+	command.eType = CPU_QUEUE_COMMAND_SIGNAL;
+	command.pFence = pFence;
+	command.qwValue = qwValue;
+	CpuQueueSubmit( pQueue, &command );
+}
+
+//ID3D12CommandQueue::Wait, stalls this queue (not the caller) until the fence reaches qwValue
+inline
+void CpuQueueWait( CpuQueue *pQueue, CpuFence *pFence, u64 qwValue )
+{
+	CpuQueueCommand command = {};
+	command.eType = CPU_QUEUE_COMMAND_WAIT;
+	command.pFence = pFence;
+	command.qwValue = qwValue;
+	CpuQueueSubmit( pQueue, &command );
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+//cpu version of Culling.hlsl, frustum culls instance bounds into a compacted list of visible instance indices in the same layout:
+//CULL_HEADER_SIZE bytes of header (visible count, then D3D12_DISPATCH_ARGUMENTS for CULL_INDIRECT_GROUP_SIZE threads per group) and the indices
+//the cpu keeps the visibility as one bit per instance and the count per tile instead of a u32 flag per instance, the tile counts are few
+//enough for the calling thread to scan them, so it is two dispatches instead of three. The order is the same as on the gpu (instance order)
+//the AVX2 path tests 8 instances per plane with fmas, the scalar path does the same fmas in the same order so both give the same list
+//root constants: first instance, instance count, CULL_SHAPE_*, CULL_CPU_FLAG_*. b1 (pCbv) holds the 6 planes of ExtractFrustumPlanesMat4f()
+
+#include "Common.h"
+#include "Math3D.h"
+#include "CpuCompute.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define CULL_THREADS 64
+#define CULL_SHAPE_SPHERE 0 //float4 center, radius
+#define CULL_SHAPE_AABB 1   //float4 center, float4 extents (w unused)
+#define CULL_INDIRECT_GROUP_SIZE 64 //threads per group of the dispatch that consumes the list
+#define CULL_HEADER_SIZE 16
+#define CULL_MAX_COUNT ( 65535u * CULL_THREADS )
+
+#define CULL_CPU_TILE 8192      //instances per cpu group
+#define CULL_CPU_FLAG_SCALAR 1  //skip the AVX2 path, reference for checking it
+
+//what ends up at the start of the visible instance list
+typedef struct CullListHeader
+{
+	u32 dwVisibleCount;
+	u32 dwThreadGroupCount[3]; //D3D12_DISPATCH_ARGUMENTS
+} CullListHeader;
+
+typedef struct CullKernels
+{
+	CpuComputeKernel test;
+	CpuComputeKernel compact;
+} CullKernels;
+
+inline
+u32 CullTileCount( u32 dwCount )
+{
+	return ( dwCount + CULL_CPU_TILE - 1 ) / CULL_CPU_TILE;
+}
+
+//visibility bits then the per tile counts
+inline
+u64 CullScratchSize( u32 dwCount )
+{
+	return (u64)CullTileCount( dwCount ) * ( CULL_CPU_TILE / 8 + sizeof(u32) );
+}
+
+//bytes of the visible instance list for dwCount instances
+inline
+u64 CullListSize( u32 dwCount )
+{
+	return CULL_HEADER_SIZE + (u64)dwCount * sizeof(u32);
+}
+
+inline
+ComputeShaderCB MakeCullCB( u32 dwFirst, u32 dwCount, u32 dwShape, u32 dwFlags )
+{
+	ComputeShaderCB cb;
+	cb.dwOffsetsAndStrides0[0] = dwFirst;
+	cb.dwOffsetsAndStrides0[1] = dwCount;
+	cb.dwOffsetsAndStrides0[2] = dwShape;
+	cb.dwOffsetsAndStrides0[3] = dwFlags;
+	return cb;
+}
+
+inline
+u32 CullBitScanForward( u64 qwValue )
+{
+#if defined(_MSC_VER)
+	unsigned long dwIndex;
+	_BitScanForward64( &dwIndex, qwValue );
+	return (u32)dwIndex;
+#else
+	return (u32)__builtin_ctzll( qwValue );
+#endif
+}
+
+inline
+u32 CullBitCount64( u64 qwBits )
+{
+	qwBits = qwBits - ( ( qwBits >> 1 ) & 0x5555555555555555ull );
+	qwBits = ( qwBits & 0x3333333333333333ull ) + ( ( qwBits >> 2 ) & 0x3333333333333333ull );
+	qwBits = ( qwBits + ( qwBits >> 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+	return (u32)( ( qwBits * 0x0101010101010101ull ) >> 56 );
+}
+
+inline
+bool CullSphere( const Vec4f *pPlanes, const f32 *pSphere )
+{
+	bool bVisible = true;
+	for( u32 dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		const Vec4f *p = &pPlanes[dwPlane];
+		const f32 fDist = fmaf( p->x, pSphere[0], fmaf( p->y, pSphere[1], fmaf( p->z, pSphere[2], p->w ) ) );
+		bVisible &= fDist >= -pSphere[3];
+	}
+	return bVisible;
+}
+
+inline
+bool CullAABB( const Vec4f *pPlanes, const f32 *pCenter, const f32 *pExtents )
+{
+	bool bVisible = true;
+	for( u32 dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		const Vec4f *p = &pPlanes[dwPlane];
+		const f32 fDist = fmaf( p->x, pCenter[0], fmaf( p->y, pCenter[1], fmaf( p->z, pCenter[2], p->w ) ) );
+		const f32 fRadius = fmaf( fabsf( p->x ), pExtents[0], fmaf( fabsf( p->y ), pExtents[1], fabsf( p->z ) * pExtents[2] ) );
+		bVisible &= fDist >= -fRadius;
+	}
+	return bVisible;
+}
+
+#if defined(__AVX2__)
+//8 float4s dwStride floats apart into x, y, z, w registers
+inline
+void CullTranspose8( const f32 *p, u32 dwStride, __m256 *pX, __m256 *pY, __m256 *pZ, __m256 *pW )
+{
+	const __m256 r0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p ) ), _mm_loadu_ps( p + 4 * dwStride ), 1 );
+	const __m256 r1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + dwStride ) ), _mm_loadu_ps( p + 5 * dwStride ), 1 );
+	const __m256 r2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 2 * dwStride ) ), _mm_loadu_ps( p + 6 * dwStride ), 1 );
+	const __m256 r3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 3 * dwStride ) ), _mm_loadu_ps( p + 7 * dwStride ), 1 );
+	const __m256 t0 = _mm256_unpacklo_ps( r0, r1 ); //x0 x1 y0 y1 | x4 x5 y4 y5
+	const __m256 t1 = _mm256_unpacklo_ps( r2, r3 );
+	const __m256 t2 = _mm256_unpackhi_ps( r0, r1 ); //z0 z1 w0 w1 | z4 z5 w4 w5
+	const __m256 t3 = _mm256_unpackhi_ps( r2, r3 );
+	*pX = _mm256_shuffle_ps( t0, t1, 0x44 );
+	*pY = _mm256_shuffle_ps( t0, t1, 0xEE );
+	*pZ = _mm256_shuffle_ps( t2, t3, 0x44 );
+	*pW = _mm256_shuffle_ps( t2, t3, 0xEE );
+}
+
+//planes broadcast as nx, ny, nz, w, |nx|, |ny|, |nz| per plane
+typedef struct CullPlanes8
+{
+	__m256 p[6][7];
+} CullPlanes8;
+
+inline
+void InitCullPlanes8( CullPlanes8 *pOut, const Vec4f *pPlanes )
+{
+	for( u32 dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			pOut->p[dwPlane][dwIdx] = _mm256_set1_ps( pPlanes[dwPlane].v[dwIdx] );
+		}
+		for( u32 dwIdx = 0; dwIdx < 3; ++dwIdx )
+		{
+			pOut->p[dwPlane][4 + dwIdx] = _mm256_set1_ps( fabsf( pPlanes[dwPlane].v[dwIdx] ) );
+		}
+	}
+}
+
+//bit i set when sphere i is visible
+inline
+u32 CullSpheres8( const CullPlanes8 *pPlanes, const f32 *pSpheres )
+{
+	__m256 x, y, z, r;
+	CullTranspose8( pSpheres, 4, &x, &y, &z, &r );
+	const __m256 negR = _mm256_xor_ps( r, _mm256_set1_ps( -0.f ) );
+	__m256 visible = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+	for( u32 dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		const __m256 *p = pPlanes->p[dwPlane];
+		const __m256 dist = _mm256_fmadd_ps( p[0], x, _mm256_fmadd_ps( p[1], y, _mm256_fmadd_ps( p[2], z, p[3] ) ) );
+		visible = _mm256_and_ps( visible, _mm256_cmp_ps( dist, negR, _CMP_GE_OQ ) );
+	}
+	return (u32)_mm256_movemask_ps( visible );
+}
+
+inline
+u32 CullAABBs8( const CullPlanes8 *pPlanes, const f32 *pBoxes )
+{
+	__m256 cx, cy, cz, ex, ey, ez, unused;
+	CullTranspose8( pBoxes, 8, &cx, &cy, &cz, &unused );
+	CullTranspose8( pBoxes + 4, 8, &ex, &ey, &ez, &unused );
+	__m256 visible = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+	for( u32 dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		const __m256 *p = pPlanes->p[dwPlane];
+		const __m256 dist = _mm256_fmadd_ps( p[0], cx, _mm256_fmadd_ps( p[1], cy, _mm256_fmadd_ps( p[2], cz, p[3] ) ) );
+		const __m256 radius = _mm256_fmadd_ps( p[4], ex, _mm256_fmadd_ps( p[5], ey, _mm256_mul_ps( p[6], ez ) ) );
+		visible = _mm256_and_ps( visible, _mm256_cmp_ps( dist, _mm256_xor_ps( radius, _mm256_set1_ps( -0.f ) ), _CMP_GE_OQ ) );
+	}
+	return (u32)_mm256_movemask_ps( visible );
+}
+#endif
+
+//instances of tile dwTile
+inline
+u32 CullTileRange( const CpuComputeRootArgs *pRoot, u32 dwTile, u32 *pEnd )
+{
+	const u32 dwCount = pRoot->cb.dwOffsetsAndStrides0[1];
+	const u32 dwBegin = dwTile * CULL_CPU_TILE;
+	*pEnd = dwCount - dwBegin < CULL_CPU_TILE ? dwCount : dwBegin + CULL_CPU_TILE;
+	return dwBegin;
+}
+
+//CullInstances in Culling.hlsl, writes the tile's visibility bits to u0 and its visible count to u2
+inline
+void CullInstancesCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 *pCB = pRoot->cb.dwOffsetsAndStrides0;
+	const Vec4f *pPlanes = (const Vec4f*)pRoot->pCbv;
+	u32 dwEnd;
+	const u32 dwBegin = CullTileRange( pRoot, Gid.x, &dwEnd );
+	const u32 dwFloats = pCB[2] == CULL_SHAPE_AABB ? 8 : 4;
+	const f32 *pBounds = (const f32*)pRoot->pVerticesAndIndices + ( (u64)pCB[0] + dwBegin ) * dwFloats;
+	u64 *pBits = (u64*)pRoot->pUavs[0] + (u64)Gid.x * ( CULL_CPU_TILE / 64 );
+	memset( pBits, 0, CULL_CPU_TILE / 8 );
+
+	const u32 dwCount = dwEnd - dwBegin;
+	u32 dwInstance = 0;
+	u32 dwVisible = 0;
+#if defined(__AVX2__)
+	if( !( pCB[3] & CULL_CPU_FLAG_SCALAR ) )
+	{
+		//a word of bits at a time, the shape check is hoisted out of the loop
+		CullPlanes8 planes;
+		InitCullPlanes8( &planes, pPlanes );
+		for( ; dwInstance + 64 <= dwCount; dwInstance += 64 )
+		{
+			const f32 *p = pBounds + (u64)dwInstance * dwFloats;
+			u64 qwWord = 0;
+			if( dwFloats == 8 )
+			{
+				for( u32 dwGroup = 0; dwGroup < 8; ++dwGroup )
+				{
+					qwWord |= (u64)CullAABBs8( &planes, p + dwGroup * 64 ) << ( dwGroup * 8 );
+				}
+			}
+			else
+			{
+				for( u32 dwGroup = 0; dwGroup < 8; ++dwGroup )
+				{
+					qwWord |= (u64)CullSpheres8( &planes, p + dwGroup * 32 ) << ( dwGroup * 8 );
+				}
+			}
+			pBits[dwInstance / 64] = qwWord;
+			dwVisible += CullBitCount64( qwWord );
+		}
+	}
+#endif
+	for( ; dwInstance < dwCount; ++dwInstance )
+	{
+		const f32 *p = pBounds + (u64)dwInstance * dwFloats;
+		const bool bVisible = dwFloats == 8 ? CullAABB( pPlanes, p, p + 4 ) : CullSphere( pPlanes, p );
+		pBits[dwInstance / 64] |= (u64)bVisible << ( dwInstance & 63 );
+		dwVisible += bVisible;
+	}
+	( (u32*)pRoot->pUavs[2] )[Gid.x] = dwVisible;
+}
+
+//CullCompact in Culling.hlsl, u2 holds the exclusive scan of the tile counts by now
+inline
+void CullCompactCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	u32 dwEnd;
+	const u32 dwBegin = CullTileRange( pRoot, Gid.x, &dwEnd );
+	const u64 *pBits = (const u64*)pRoot->pUavs[0] + (u64)Gid.x * ( CULL_CPU_TILE / 64 );
+	u32 *pOut = (u32*)( pRoot->pUavs[1] + CULL_HEADER_SIZE ) + ( (const u32*)pRoot->pUavs[2] )[Gid.x];
+	const u32 dwFirst = pRoot->cb.dwOffsetsAndStrides0[0] + dwBegin;
+	const u32 dwWords = ( dwEnd - dwBegin + 63 ) / 64;
+	for( u32 dwWord = 0; dwWord < dwWords; ++dwWord )
+	{
+		u64 qwBits = pBits[dwWord];
+		while( qwBits )
+		{
+			*pOut++ = dwFirst + dwWord * 64 + CullBitScanForward( qwBits );
+			qwBits &= qwBits - 1;
+		}
+	}
+}
+
+inline
+void InitCullKernels( CullKernels *pKernels )
+{
+	memset( &pKernels->test, 0, sizeof(CpuComputeKernel) );
+	pKernels->test.pfnGroup = CullInstancesCpu;
+	pKernels->test.dwNumThreads[0] = CULL_THREADS;
+	pKernels->test.dwNumThreads[1] = 1;
+	pKernels->test.dwNumThreads[2] = 1;
+	pKernels->compact = pKernels->test;
+	pKernels->compact.pfnGroup = CullCompactCpu;
+}
+
+//culls instances [dwFirst, dwFirst + dwCount) of pBounds (CULL_SHAPE_* layout) against the 6 planes of ExtractFrustumPlanesMat4f()
+//pList gets CullListSize( dwCount ) bytes in the layout RecordCullInstances() in main.cpp produces, pScratch needs CullScratchSize( dwCount )
+//returns the visible count
+inline
+u32 CpuCullInstances( CpuComputeDevice *pDevice, const CullKernels *pKernels, const Vec4f *pPlanes, const void *pBounds,
+					  u32 dwFirst, u32 dwCount, u32 dwShape, u32 dwFlags, u8 *pScratch, u8 *pList )
+{
+	const u32 dwTiles = CullTileCount( dwCount );
+	CpuComputeRootArgs root;
+	memset( &root, 0, sizeof(CpuComputeRootArgs) );
+	root.cb = MakeCullCB( dwFirst, dwCount, dwShape, dwFlags );
+	root.pCbv = (const u8*)pPlanes;
+	root.pVerticesAndIndices = (const u8*)pBounds;
+	root.qwVerticesAndIndicesSize = ( (u64)dwFirst + dwCount ) * ( dwShape == CULL_SHAPE_AABB ? 32 : 16 );
+	root.pUavs[0] = pScratch;
+	root.pUavs[1] = pList;
+	root.pUavs[2] = pScratch + (u64)dwTiles * ( CULL_CPU_TILE / 8 );
+	CpuDispatch( pDevice, &pKernels->test, &root, dwTiles, 1, 1 );
+
+	u32 *pTileCounts = (u32*)root.pUavs[2];
+	u32 dwVisible = 0;
+	for( u32 dwTile = 0; dwTile < dwTiles; ++dwTile )
+	{
+		const u32 dwTileCount = pTileCounts[dwTile];
+		pTileCounts[dwTile] = dwVisible;
+		dwVisible += dwTileCount;
+	}
+	CpuDispatch( pDevice, &pKernels->compact, &root, dwTiles, 1, 1 );
+
+	CullListHeader header;
+	header.dwVisibleCount = dwVisible;
+	header.dwThreadGroupCount[0] = ( dwVisible + CULL_INDIRECT_GROUP_SIZE - 1 ) / CULL_INDIRECT_GROUP_SIZE;
+	header.dwThreadGroupCount[1] = 1;
+	header.dwThreadGroupCount[2] = 1;
+	memcpy( pList, &header, sizeof(CullListHeader) );
+	return dwVisible;
+}
+
+//CullGatherVisible in Culling.hlsl, the bounds of every instance of a CpuCullInstances() list in list order, returns the bytes written to pOut
+inline
+u64 CpuGatherVisible( const void *pBounds, const u8 *pList, u32 dwShape, u8 *pOut )
+{
+	const u64 qwStride = dwShape == CULL_SHAPE_AABB ? 32 : 16;
+	const u32 dwVisible = ( (const CullListHeader*)pList )->dwVisibleCount;
+	const u32 *pIndices = (const u32*)( pList + CULL_HEADER_SIZE );
+	for( u32 dwIdx = 0; dwIdx < dwVisible; ++dwIdx )
+	{
+		memcpy( pOut + dwIdx * qwStride, (const u8*)pBounds + pIndices[dwIdx] * qwStride, qwStride );
+	}
+	return dwVisible * qwStride;
+}
+
+#endif
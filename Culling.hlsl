@@ -0,0 +1,118 @@
+//cs_5_0 way
+//frustum culling of instance bounds into a compacted list of visible instance indices, three dispatches:
+//CullInstances  one thread per instance, writes 1/0 to VisibleFlags
+//Scan.hlsl      exclusive scan of VisibleFlags into VisibleOffsets
+//CullCompact    one thread per instance, visible ones write their index to their offset, the last one writes the header
+//CullGatherVisible is the consumer of the list, dispatched indirectly with the header's group count
+//the scan keeps the list in instance order so the result does not depend on scheduling. Culling.h is the cpu version
+cbuffer globalCB : register(b0)
+{
+    uint4 dwOffsetsAndStrides0; //x first instance, y instance count, z CULL_SHAPE_*
+};
+
+cbuffer frustumCB : register(b1)
+{
+	float4 frustumPlanes[6]; //ExtractFrustumPlanesMat4f(), inside when dot(xyz, p) + w >= 0
+};
+
+#define CULL_THREADS 64
+#define CULL_SHAPE_SPHERE 0 //float4 center, radius
+#define CULL_SHAPE_AABB 1   //float4 center, float4 extents (w unused)
+#define CULL_INDIRECT_GROUP_SIZE 64 //threads per group of the dispatch that consumes the list
+
+ByteAddressBuffer InstanceBounds : register( t0 );
+ByteAddressBuffer VisibleOffsets : register( t1 );
+RWByteAddressBuffer VisibleFlags : register( u0 );
+RWByteAddressBuffer VisibleInstances : register( u1 ); //visible count, D3D12_DISPATCH_ARGUMENTS, then the indices
+
+#define CULL_ROOT_SIGNATURE "RootFlags( 0 ), RootConstants( num32BitConstants=4, b0, space = 0, visibility=SHADER_VISIBILITY_ALL ), CBV(b1, space=0, visibility=SHADER_VISIBILITY_ALL), SRV(t0, space=0, visibility=SHADER_VISIBILITY_ALL), SRV(t1, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u1, space=0, visibility=SHADER_VISIBILITY_ALL)"
+#define CULL_HEADER_SIZE 16
+
+bool CullSphere( float4 sphere )
+{
+	bool bVisible = true;
+	[unroll]
+	for( uint dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		bVisible = bVisible && dot( frustumPlanes[dwPlane].xyz, sphere.xyz ) + frustumPlanes[dwPlane].w >= -sphere.w;
+	}
+	return bVisible;
+}
+
+bool CullAABB( float3 center, float3 extents )
+{
+	bool bVisible = true;
+	[unroll]
+	for( uint dwPlane = 0; dwPlane < 6; ++dwPlane )
+	{
+		bVisible = bVisible && dot( frustumPlanes[dwPlane].xyz, center ) + frustumPlanes[dwPlane].w >= -dot( abs( frustumPlanes[dwPlane].xyz ), extents );
+	}
+	return bVisible;
+}
+
+[RootSignature(CULL_ROOT_SIGNATURE)]
+[numthreads(CULL_THREADS, 1, 1)]
+void CullInstances( uint3 DTid : SV_DispatchThreadID )
+{
+	if( DTid.x >= dwOffsetsAndStrides0.y )
+	{
+		return;
+	}
+	const uint dwInstance = dwOffsetsAndStrides0.x + DTid.x;
+	bool bVisible;
+	if( dwOffsetsAndStrides0.z == CULL_SHAPE_AABB )
+	{
+		bVisible = CullAABB( asfloat( InstanceBounds.Load3( dwInstance * 32 ) ), asfloat( InstanceBounds.Load3( dwInstance * 32 + 16 ) ) );
+	}
+	else
+	{
+		bVisible = CullSphere( asfloat( InstanceBounds.Load4( dwInstance * 16 ) ) );
+	}
+	VisibleFlags.Store( DTid.x * 4, bVisible ? 1 : 0 );
+}
+
+//dispatched with at least one group so an empty list still gets its header
+[RootSignature(CULL_ROOT_SIGNATURE)]
+[numthreads(CULL_THREADS, 1, 1)]
+void CullCompact( uint3 DTid : SV_DispatchThreadID )
+{
+	const uint dwCount = dwOffsetsAndStrides0.y;
+	uint dwOffset = 0;
+	uint dwFlag = 0;
+	if( DTid.x < dwCount )
+	{
+		dwOffset = VisibleOffsets.Load( DTid.x * 4 );
+		dwFlag = VisibleFlags.Load( DTid.x * 4 );
+		if( dwFlag )
+		{
+			VisibleInstances.Store( CULL_HEADER_SIZE + dwOffset * 4, dwOffsetsAndStrides0.x + DTid.x );
+		}
+	}
+	if( DTid.x == max( dwCount, 1 ) - 1 )
+	{
+		const uint dwVisible = dwOffset + dwFlag;
+		VisibleInstances.Store4( 0, uint4( dwVisible, ( dwVisible + CULL_INDIRECT_GROUP_SIZE - 1 ) / CULL_INDIRECT_GROUP_SIZE, 1, 1 ) );
+	}
+}
+
+//one thread per visible instance, ExecuteIndirect() of the header: copies the bounds of the list's instances to VisibleFlags in list order
+//VisibleOffsets is the list here and VisibleInstances is bound to the same buffer as VisibleFlags, it is not used
+[RootSignature(CULL_ROOT_SIGNATURE)]
+[numthreads(CULL_INDIRECT_GROUP_SIZE, 1, 1)]
+void CullGatherVisible( uint3 DTid : SV_DispatchThreadID )
+{
+	if( DTid.x >= VisibleOffsets.Load( 0 ) )
+	{
+		return;
+	}
+	const uint dwInstance = VisibleOffsets.Load( CULL_HEADER_SIZE + DTid.x * 4 );
+	if( dwOffsetsAndStrides0.z == CULL_SHAPE_AABB )
+	{
+		VisibleFlags.Store4( DTid.x * 32, InstanceBounds.Load4( dwInstance * 32 ) );
+		VisibleFlags.Store4( DTid.x * 32 + 16, InstanceBounds.Load4( dwInstance * 32 + 16 ) );
+	}
+	else
+	{
+		VisibleFlags.Store4( DTid.x * 16, InstanceBounds.Load4( dwInstance * 16 ) );
+	}
+}
@@ -0,0 +1,253 @@
+#ifndef FENCE_TIMELINE_H
+#define FENCE_TIMELINE_H
+
+//lets C++20 coroutines co_await fence values instead of blocking a thread per wait
+//one waiter thread sleeps on a single event that every tracked fence is asked to set (SetEventOnCompletion) at the lowest
+//value anyone is waiting for, when it wakes it resumes every coroutine whose value completed, in value order per fence
+//continuations run on the waiter thread, keep them short (record + submit the next step) or they delay every other job
+//fences and the wake event are opaque and only touched through FenceTimelineCallbacks, main.cpp binds them to
+//ID3D12Fence + an auto reset event HANDLE and Bench to CpuFence + CpuEvent
+
+#include "Common.h"
+
+#include <stdlib.h>
+
+#include <coroutine>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+
+#define FENCE_TIMELINE_MAX_FENCES 8
+
+//ID3D12Fence::GetCompletedValue
+typedef u64 (*PFN_FenceTimelineCompletedValue)( void *pContext, void *pFence );
+//ID3D12Fence::SetEventOnCompletion, the event is the wake event handed to InitFenceTimeline()
+typedef void (*PFN_FenceTimelineSetEventOnCompletion)( void *pContext, void *pFence, u64 qwValue, void *pEvent );
+//blocks the calling thread until the fence reaches qwValue, only for the waits the timeline has no room for
+typedef void (*PFN_FenceTimelineWait)( void *pContext, void *pFence, u64 qwValue );
+//SetEvent
+typedef void (*PFN_FenceTimelineSetEvent)( void *pContext, void *pEvent );
+//WaitForSingleObject( ..., INFINITE ) on an auto reset event
+typedef void (*PFN_FenceTimelineWaitEvent)( void *pContext, void *pEvent );
+
+typedef struct FenceTimelineCallbacks
+{
+	PFN_FenceTimelineCompletedValue pfnCompletedValue;
+	PFN_FenceTimelineSetEventOnCompletion pfnSetEventOnCompletion;
+	PFN_FenceTimelineWait pfnWait;
+	PFN_FenceTimelineSetEvent pfnSetEvent;
+	PFN_FenceTimelineWaitEvent pfnWaitEvent;
+	void *pContext;
+} FenceTimelineCallbacks;
+
+typedef struct FenceTimelineWait
+{
+	u64 qwValue;
+	std::coroutine_handle<> continuation;
+} FenceTimelineWait;
+
+//min heap on qwValue
+inline
+bool FenceTimelineWaitLater( const FenceTimelineWait &left, const FenceTimelineWait &right )
+{
+	return left.qwValue > right.qwValue;
+}
+
+typedef struct FenceTimelineFence
+{
+	void *pFence;
+	std::vector<FenceTimelineWait> waits;
+} FenceTimelineFence;
+
+typedef struct FenceTimeline
+{
+	std::thread waiter;
+	std::mutex lock;
+	FenceTimelineCallbacks callbacks;
+	void *pWakeEvent;
+	FenceTimelineFence fences[FENCE_TIMELINE_MAX_FENCES];
+	u32 dwFenceCount;
+	u64 qwPendingCount;
+	u64 qwResumedCount;
+	u64 qwWakeCount;
+	bool bExit;
+} FenceTimeline;
+
+inline
+void FenceTimelineWaiterMain( FenceTimeline *pTimeline )
+{
+	std::vector<std::coroutine_handle<>> ready;
+	for( ;; )
+	{
+		ready.clear();
+		{
+			std::lock_guard<std::mutex> guard( pTimeline->lock );
+			for( u32 dwFence = 0; dwFence < pTimeline->dwFenceCount; ++dwFence )
+			{
+				FenceTimelineFence *pTracked = &pTimeline->fences[dwFence];
+				const u64 qwCompleted = pTimeline->callbacks.pfnCompletedValue( pTimeline->callbacks.pContext, pTracked->pFence );
+				while( !pTracked->waits.empty() && pTracked->waits.front().qwValue <= qwCompleted )
+				{
+					ready.push_back( pTracked->waits.front().continuation );
+					std::pop_heap( pTracked->waits.begin(), pTracked->waits.end(), FenceTimelineWaitLater );
+					pTracked->waits.pop_back();
+				}
+			}
+			pTimeline->qwPendingCount -= ready.size();
+			pTimeline->qwResumedCount += ready.size();
+			if( ready.empty() )
+			{
+				if( pTimeline->bExit && pTimeline->qwPendingCount == 0 )
+				{
+					return;
+				}
+				//a fence that completed since it was read above sets the event right away, so nothing is missed
+				for( u32 dwFence = 0; dwFence < pTimeline->dwFenceCount; ++dwFence )
+				{
+					FenceTimelineFence *pTracked = &pTimeline->fences[dwFence];
+					if( !pTracked->waits.empty() )
+					{
+						pTimeline->callbacks.pfnSetEventOnCompletion( pTimeline->callbacks.pContext, pTracked->pFence, pTracked->waits.front().qwValue, pTimeline->pWakeEvent );
+					}
+				}
+			}
+		}
+		if( ready.empty() )
+		{
+			pTimeline->callbacks.pfnWaitEvent( pTimeline->callbacks.pContext, pTimeline->pWakeEvent );
+			++pTimeline->qwWakeCount;
+			continue;
+		}
+		for( size_t dwReady = 0; dwReady < ready.size(); ++dwReady )
+		{
+			ready[dwReady].resume();
+		}
+	}
+}
+
+//pWakeEvent is an auto reset event only the timeline uses, it stays owned by the caller
+inline
+void InitFenceTimeline( FenceTimeline *pTimeline, const FenceTimelineCallbacks *pCallbacks, void *pWakeEvent )
+{
+	pTimeline->callbacks = *pCallbacks;
+	pTimeline->pWakeEvent = pWakeEvent;
+	pTimeline->dwFenceCount = 0;
+	pTimeline->qwPendingCount = 0;
+	pTimeline->qwResumedCount = 0;
+	pTimeline->qwWakeCount = 0;
+	pTimeline->bExit = false;
+	pTimeline->waiter = std::thread( FenceTimelineWaiterMain, pTimeline );
+}
+
+//returns once every pending wait has been resumed, so the fences have to keep making progress
+inline
+void DestroyFenceTimeline( FenceTimeline *pTimeline )
+{
+	{
+		std::lock_guard<std::mutex> guard( pTimeline->lock );
+		pTimeline->bExit = true;
+	}
+	pTimeline->callbacks.pfnSetEvent( pTimeline->callbacks.pContext, pTimeline->pWakeEvent );
+	pTimeline->waiter.join();
+}
+
+//false when the fence isn't tracked yet and there is no room to track it
+inline
+bool FenceTimelineAdd( FenceTimeline *pTimeline, void *pFence, u64 qwValue, std::coroutine_handle<> continuation )
+{
+	{
+		std::lock_guard<std::mutex> guard( pTimeline->lock );
+		u32 dwFence = 0;
+		while( dwFence < pTimeline->dwFenceCount && pTimeline->fences[dwFence].pFence != pFence )
+		{
+			++dwFence;
+		}
+		if( dwFence == pTimeline->dwFenceCount )
+		{
+			if( dwFence == FENCE_TIMELINE_MAX_FENCES )
+			{
+				return false;
+			}
+			pTimeline->fences[dwFence].pFence = pFence;
+			++pTimeline->dwFenceCount;
+		}
+		FenceTimelineFence *pTracked = &pTimeline->fences[dwFence];
+		FenceTimelineWait wait;
+		wait.qwValue = qwValue;
+		wait.continuation = continuation;
+		pTracked->waits.push_back( wait );
+		std::push_heap( pTracked->waits.begin(), pTracked->waits.end(), FenceTimelineWaitLater );
+		++pTimeline->qwPendingCount;
+	}
+	//the waiter may be asleep on a later value of this fence
+	pTimeline->callbacks.pfnSetEvent( pTimeline->callbacks.pContext, pTimeline->pWakeEvent );
+	return true;
+}
+
+typedef struct FenceTimelineAwaiter
+{
+	FenceTimeline *pTimeline;
+	void *pFence;
+	u64 qwValue;
+
+	bool await_ready() const
+	{
+		return pTimeline->callbacks.pfnCompletedValue( pTimeline->callbacks.pContext, pFence ) >= qwValue;
+	}
+
+	bool await_suspend( std::coroutine_handle<> continuation )
+	{
+		if( FenceTimelineAdd( pTimeline, pFence, qwValue, continuation ) )
+		{
+			return true;
+		}
+		//too many distinct fences, block this one wait instead
+		pTimeline->callbacks.pfnWait( pTimeline->callbacks.pContext, pFence, qwValue );
+		return false;
+	}
+
+	void await_resume() const
+	{
+	}
+} FenceTimelineAwaiter;
+
+//co_await FenceTimelineAwait( &timeline, &fence, qwValue );
+inline
+FenceTimelineAwaiter FenceTimelineAwait( FenceTimeline *pTimeline, void *pFence, u64 qwValue )
+{
+	FenceTimelineAwaiter awaiter;
+	awaiter.pTimeline = pTimeline;
+	awaiter.pFence = pFence;
+	awaiter.qwValue = qwValue;
+	return awaiter;
+}
+
+//fire and forget coroutine, runs on the caller until its first wait and frees itself when it returns
+typedef struct FenceTimelineJob
+{
+	struct promise_type
+	{
+		FenceTimelineJob get_return_object()
+		{
+			return FenceTimelineJob();
+		}
+		std::suspend_never initial_suspend() noexcept
+		{
+			return std::suspend_never();
+		}
+		std::suspend_never final_suspend() noexcept
+		{
+			return std::suspend_never();
+		}
+		void return_void()
+		{
+		}
+		void unhandled_exception()
+		{
+			abort();
+		}
+	};
+} FenceTimelineJob;
+
+#endif
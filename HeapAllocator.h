@@ -0,0 +1,415 @@
+#ifndef HEAP_ALLOCATOR_H
+#define HEAP_ALLOCATOR_H
+
+//TLSF (two level segregated fit) suballocator for offsets inside an ID3D12Heap, knows nothing about d3d12 so it runs anywhere
+//sizes are rounded to HEAP_ALLOCATOR_GRANULARITY, free blocks are bucketed by log2 size (first level) and 16 linear
+//steps inside that power of two (second level), a bitmap per level makes finding a big enough block O(1)
+//alignment padding in front of an allocation goes back on the free lists so it is never lost, only the size round up is waste
+//blocks live in a fixed pool and reference each other by index, physical neighbours are merged on free
+
+#include "Common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define HEAP_ALLOCATOR_GRANULARITY 256 //smallest alignment a placed buffer can have in a heap is 64KB, but constant/raw buffer views go down to 256
+#define HEAP_ALLOCATOR_SL_LOG2 4
+#define HEAP_ALLOCATOR_SL_COUNT ( 1u << HEAP_ALLOCATOR_SL_LOG2 )
+#define HEAP_ALLOCATOR_FL_COUNT 48 //2^48 granules is more than any heap
+#define HEAP_ALLOCATOR_NONE 0xFFFFFFFFu
+
+typedef struct HeapBlock
+{
+	u64 qwOffset;
+	u64 qwSize;
+	u32 dwPrevPhysical;
+	u32 dwNextPhysical;
+	u32 dwPrevFree; //also links the unused block pool
+	u32 dwNextFree;
+	u32 bFree;
+	u32 dwPad;
+} HeapBlock;
+
+typedef struct HeapAllocation
+{
+	u64 qwOffset;
+	u64 qwSize; //requested size, the block itself can be larger
+	u32 dwBlock;
+} HeapAllocation;
+
+typedef struct HeapAllocatorStats
+{
+	u64 qwHeapSize;
+	u64 qwAllocatedBytes; //block sizes, including the granularity round up
+	u64 qwRequestedBytes;
+	u64 qwWastedBytes;    //qwAllocatedBytes - qwRequestedBytes
+	u64 qwFreeBytes;
+	u64 qwLargestFreeBlock;
+	u32 dwAllocationCount;
+	u32 dwFreeBlockCount;
+	f32 fFragmentation;   //1 - largest free block / free bytes, 0 when all free space is one block
+} HeapAllocatorStats;
+
+typedef struct HeapAllocator
+{
+	u64 qwSize;
+	u64 qwAllocatedBytes;
+	u64 qwRequestedBytes;
+	u32 dwAllocationCount;
+	u32 dwFreeBlockCount;
+	u64 qwFirstLevelBitmap;
+	u32 secondLevelBitmaps[HEAP_ALLOCATOR_FL_COUNT];
+	u32 freeLists[HEAP_ALLOCATOR_FL_COUNT][HEAP_ALLOCATOR_SL_COUNT];
+	HeapBlock *pBlocks;
+	u32 dwMaxBlocks;
+	u32 dwUnusedBlocks; //head of the pool of block records not describing any range
+} HeapAllocator;
+
+inline
+u32 HeapAllocatorBitScanForward( u64 qwValue )
+{
+#if defined(_MSC_VER)
+	unsigned long dwIndex;
+	_BitScanForward64( &dwIndex, qwValue );
+	return (u32)dwIndex;
+#else
+	return (u32)__builtin_ctzll( qwValue );
+#endif
+}
+
+inline
+u32 HeapAllocatorBitScanReverse( u64 qwValue )
+{
+#if defined(_MSC_VER)
+	unsigned long dwIndex;
+	_BitScanReverse64( &dwIndex, qwValue );
+	return (u32)dwIndex;
+#else
+	return 63u - (u32)__builtin_clzll( qwValue );
+#endif
+}
+
+//size in granules to (first level, second level), sizes below HEAP_ALLOCATOR_SL_COUNT granules all share first level 0
+inline
+void HeapAllocatorMapping( u64 qwGranules, u32 *pFirstLevel, u32 *pSecondLevel )
+{
+	if( qwGranules < HEAP_ALLOCATOR_SL_COUNT )
+	{
+		*pFirstLevel = 0;
+		*pSecondLevel = (u32)qwGranules;
+		return;
+	}
+	const u32 dwLog2 = HeapAllocatorBitScanReverse( qwGranules );
+	*pFirstLevel = dwLog2 - HEAP_ALLOCATOR_SL_LOG2 + 1;
+	*pSecondLevel = (u32)( qwGranules >> ( dwLog2 - HEAP_ALLOCATOR_SL_LOG2 ) ) - HEAP_ALLOCATOR_SL_COUNT;
+}
+
+//rounds up to the next second level step so every block in the list found is big enough
+inline
+void HeapAllocatorMappingSearch( u64 qwGranules, u32 *pFirstLevel, u32 *pSecondLevel )
+{
+	if( qwGranules >= HEAP_ALLOCATOR_SL_COUNT )
+	{
+		qwGranules += ( 1ull << ( HeapAllocatorBitScanReverse( qwGranules ) - HEAP_ALLOCATOR_SL_LOG2 ) ) - 1;
+	}
+	HeapAllocatorMapping( qwGranules, pFirstLevel, pSecondLevel );
+}
+
+inline
+void HeapAllocatorInsertFree( HeapAllocator *pAllocator, u32 dwBlock )
+{
+	HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+	u32 dwFirstLevel, dwSecondLevel;
+	HeapAllocatorMapping( pBlock->qwSize / HEAP_ALLOCATOR_GRANULARITY, &dwFirstLevel, &dwSecondLevel );
+	const u32 dwHead = pAllocator->freeLists[dwFirstLevel][dwSecondLevel];
+	pBlock->bFree = 1;
+	pBlock->dwPrevFree = HEAP_ALLOCATOR_NONE;
+	pBlock->dwNextFree = dwHead;
+	if( dwHead != HEAP_ALLOCATOR_NONE )
+	{
+		pAllocator->pBlocks[dwHead].dwPrevFree = dwBlock;
+	}
+	pAllocator->freeLists[dwFirstLevel][dwSecondLevel] = dwBlock;
+	pAllocator->qwFirstLevelBitmap |= 1ull << dwFirstLevel;
+	pAllocator->secondLevelBitmaps[dwFirstLevel] |= 1u << dwSecondLevel;
+	++pAllocator->dwFreeBlockCount;
+}
+
+inline
+void HeapAllocatorRemoveFree( HeapAllocator *pAllocator, u32 dwBlock )
+{
+	HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+	u32 dwFirstLevel, dwSecondLevel;
+	HeapAllocatorMapping( pBlock->qwSize / HEAP_ALLOCATOR_GRANULARITY, &dwFirstLevel, &dwSecondLevel );
+	if( pBlock->dwPrevFree != HEAP_ALLOCATOR_NONE )
+	{
+		pAllocator->pBlocks[pBlock->dwPrevFree].dwNextFree = pBlock->dwNextFree;
+	}
+	else
+	{
+		pAllocator->freeLists[dwFirstLevel][dwSecondLevel] = pBlock->dwNextFree;
+		if( pBlock->dwNextFree == HEAP_ALLOCATOR_NONE )
+		{
+			pAllocator->secondLevelBitmaps[dwFirstLevel] &= ~( 1u << dwSecondLevel );
+			if( pAllocator->secondLevelBitmaps[dwFirstLevel] == 0 )
+			{
+				pAllocator->qwFirstLevelBitmap &= ~( 1ull << dwFirstLevel );
+			}
+		}
+	}
+	if( pBlock->dwNextFree != HEAP_ALLOCATOR_NONE )
+	{
+		pAllocator->pBlocks[pBlock->dwNextFree].dwPrevFree = pBlock->dwPrevFree;
+	}
+	pBlock->bFree = 0;
+	--pAllocator->dwFreeBlockCount;
+}
+
+inline
+u32 HeapAllocatorNewBlock( HeapAllocator *pAllocator )
+{
+	const u32 dwBlock = pAllocator->dwUnusedBlocks;
+	if( dwBlock != HEAP_ALLOCATOR_NONE )
+	{
+		pAllocator->dwUnusedBlocks = pAllocator->pBlocks[dwBlock].dwNextFree;
+	}
+	return dwBlock;
+}
+
+inline
+void HeapAllocatorReleaseBlock( HeapAllocator *pAllocator, u32 dwBlock )
+{
+	pAllocator->pBlocks[dwBlock].dwNextFree = pAllocator->dwUnusedBlocks;
+	pAllocator->dwUnusedBlocks = dwBlock;
+}
+
+//new block for the range [qwOffset, qwOffset + qwSize) taken out of dwBlock, placed after or before it physically
+inline
+u32 HeapAllocatorSplit( HeapAllocator *pAllocator, u32 dwBlock, u64 qwOffset, u64 qwSize, bool bAfter )
+{
+	const u32 dwNew = HeapAllocatorNewBlock( pAllocator );
+	HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+	HeapBlock *pNew = &pAllocator->pBlocks[dwNew];
+	pNew->qwOffset = qwOffset;
+	pNew->qwSize = qwSize;
+	pBlock->qwSize -= qwSize;
+	if( bAfter )
+	{
+		pNew->dwPrevPhysical = dwBlock;
+		pNew->dwNextPhysical = pBlock->dwNextPhysical;
+		if( pBlock->dwNextPhysical != HEAP_ALLOCATOR_NONE )
+		{
+			pAllocator->pBlocks[pBlock->dwNextPhysical].dwPrevPhysical = dwNew;
+		}
+		pBlock->dwNextPhysical = dwNew;
+	}
+	else
+	{
+		pNew->dwNextPhysical = dwBlock;
+		pNew->dwPrevPhysical = pBlock->dwPrevPhysical;
+		if( pBlock->dwPrevPhysical != HEAP_ALLOCATOR_NONE )
+		{
+			pAllocator->pBlocks[pBlock->dwPrevPhysical].dwNextPhysical = dwNew;
+		}
+		pBlock->dwPrevPhysical = dwNew;
+		pBlock->qwOffset += qwSize;
+	}
+	return dwNew;
+}
+
+//dwMaxBlocks bounds live allocations + free ranges, every allocation can add at most two blocks
+inline
+bool InitHeapAllocator( HeapAllocator *pAllocator, u64 qwHeapSize, u32 dwMaxBlocks )
+{
+	memset( pAllocator, 0, sizeof(HeapAllocator) );
+	memset( pAllocator->freeLists, 0xFF, sizeof(pAllocator->freeLists) );
+	pAllocator->pBlocks = (HeapBlock*)malloc( (u64)dwMaxBlocks * sizeof(HeapBlock) );
+	if( !pAllocator->pBlocks || dwMaxBlocks == 0 )
+	{
+		free( pAllocator->pBlocks );
+		pAllocator->pBlocks = NULL;
+		return false;
+	}
+	pAllocator->dwMaxBlocks = dwMaxBlocks;
+	pAllocator->qwSize = qwHeapSize & ~(u64)( HEAP_ALLOCATOR_GRANULARITY - 1 );
+	for( u32 dwBlock = 1; dwBlock < dwMaxBlocks; ++dwBlock )
+	{
+		pAllocator->pBlocks[dwBlock].dwNextFree = dwBlock + 1 < dwMaxBlocks ? dwBlock + 1 : HEAP_ALLOCATOR_NONE;
+	}
+	pAllocator->dwUnusedBlocks = dwMaxBlocks > 1 ? 1 : HEAP_ALLOCATOR_NONE;
+
+	HeapBlock *pWhole = &pAllocator->pBlocks[0];
+	pWhole->qwOffset = 0;
+	pWhole->qwSize = pAllocator->qwSize;
+	pWhole->dwPrevPhysical = HEAP_ALLOCATOR_NONE;
+	pWhole->dwNextPhysical = HEAP_ALLOCATOR_NONE;
+	HeapAllocatorInsertFree( pAllocator, 0 );
+	return true;
+}
+
+inline
+void DestroyHeapAllocator( HeapAllocator *pAllocator )
+{
+	free( pAllocator->pBlocks );
+	pAllocator->pBlocks = NULL;
+}
+
+//qwAlignment is D3D12_RESOURCE_ALLOCATION_INFO::Alignment (a power of two), qwSize its SizeInBytes
+inline
+bool HeapAlloc( HeapAllocator *pAllocator, u64 qwSize, u64 qwAlignment, HeapAllocation *pAllocation )
+{
+	const u64 qwBlockSize = AlignUp( qwSize > 0 ? qwSize : 1, HEAP_ALLOCATOR_GRANULARITY );
+	qwAlignment = qwAlignment > HEAP_ALLOCATOR_GRANULARITY ? qwAlignment : HEAP_ALLOCATOR_GRANULARITY;
+	//worst case padding so any block from the list found can be aligned in place
+	const u64 qwSearchSize = qwBlockSize + qwAlignment - HEAP_ALLOCATOR_GRANULARITY;
+	if( qwSearchSize > pAllocator->qwSize )
+	{
+		return false;
+	}
+
+	u32 dwFirstLevel, dwSecondLevel;
+	HeapAllocatorMappingSearch( qwSearchSize / HEAP_ALLOCATOR_GRANULARITY, &dwFirstLevel, &dwSecondLevel );
+	if( dwFirstLevel >= HEAP_ALLOCATOR_FL_COUNT )
+	{
+		return false;
+	}
+	u32 dwSecondLevelMap = pAllocator->secondLevelBitmaps[dwFirstLevel] & ( ~0u << dwSecondLevel );
+	if( dwSecondLevelMap == 0 )
+	{
+		const u64 qwFirstLevelMap = dwFirstLevel + 1 < 64 ? pAllocator->qwFirstLevelBitmap & ( ~0ull << ( dwFirstLevel + 1 ) ) : 0;
+		if( qwFirstLevelMap == 0 )
+		{
+			return false;
+		}
+		dwFirstLevel = HeapAllocatorBitScanForward( qwFirstLevelMap );
+		dwSecondLevelMap = pAllocator->secondLevelBitmaps[dwFirstLevel];
+	}
+	dwSecondLevel = HeapAllocatorBitScanForward( dwSecondLevelMap );
+	const u32 dwBlock = pAllocator->freeLists[dwFirstLevel][dwSecondLevel];
+
+	//a split needs up to two spare block records, fail before touching anything
+	const u32 dwSpare = pAllocator->dwUnusedBlocks;
+	if( dwSpare == HEAP_ALLOCATOR_NONE || pAllocator->pBlocks[dwSpare].dwNextFree == HEAP_ALLOCATOR_NONE )
+	{
+		return false;
+	}
+
+	HeapAllocatorRemoveFree( pAllocator, dwBlock );
+	HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+	const u64 qwPadding = AlignUp( pBlock->qwOffset, qwAlignment ) - pBlock->qwOffset;
+	if( qwPadding > 0 )
+	{
+		const u32 dwFront = HeapAllocatorSplit( pAllocator, dwBlock, pBlock->qwOffset, qwPadding, false );
+		HeapAllocatorInsertFree( pAllocator, dwFront );
+	}
+	if( pBlock->qwSize > qwBlockSize )
+	{
+		const u32 dwBack = HeapAllocatorSplit( pAllocator, dwBlock, pBlock->qwOffset + qwBlockSize, pBlock->qwSize - qwBlockSize, true );
+		HeapAllocatorInsertFree( pAllocator, dwBack );
+	}
+
+	pAllocator->qwAllocatedBytes += pBlock->qwSize;
+	pAllocator->qwRequestedBytes += qwSize;
+	++pAllocator->dwAllocationCount;
+	pAllocation->qwOffset = pBlock->qwOffset;
+	pAllocation->qwSize = qwSize;
+	pAllocation->dwBlock = dwBlock;
+	return true;
+}
+
+inline
+void HeapFree( HeapAllocator *pAllocator, const HeapAllocation *pAllocation )
+{
+	u32 dwBlock = pAllocation->dwBlock;
+	HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+	pAllocator->qwAllocatedBytes -= pBlock->qwSize;
+	pAllocator->qwRequestedBytes -= pAllocation->qwSize;
+	--pAllocator->dwAllocationCount;
+
+	const u32 dwPrev = pBlock->dwPrevPhysical;
+	if( dwPrev != HEAP_ALLOCATOR_NONE && pAllocator->pBlocks[dwPrev].bFree )
+	{
+		//grow the previous block over this one
+		HeapAllocatorRemoveFree( pAllocator, dwPrev );
+		HeapBlock *pPrev = &pAllocator->pBlocks[dwPrev];
+		pPrev->qwSize += pBlock->qwSize;
+		pPrev->dwNextPhysical = pBlock->dwNextPhysical;
+		if( pBlock->dwNextPhysical != HEAP_ALLOCATOR_NONE )
+		{
+			pAllocator->pBlocks[pBlock->dwNextPhysical].dwPrevPhysical = dwPrev;
+		}
+		HeapAllocatorReleaseBlock( pAllocator, dwBlock );
+		dwBlock = dwPrev;
+		pBlock = pPrev;
+	}
+	const u32 dwNext = pBlock->dwNextPhysical;
+	if( dwNext != HEAP_ALLOCATOR_NONE && pAllocator->pBlocks[dwNext].bFree )
+	{
+		HeapAllocatorRemoveFree( pAllocator, dwNext );
+		HeapBlock *pNext = &pAllocator->pBlocks[dwNext];
+		pBlock->qwSize += pNext->qwSize;
+		pBlock->dwNextPhysical = pNext->dwNextPhysical;
+		if( pNext->dwNextPhysical != HEAP_ALLOCATOR_NONE )
+		{
+			pAllocator->pBlocks[pNext->dwNextPhysical].dwPrevPhysical = dwBlock;
+		}
+		HeapAllocatorReleaseBlock( pAllocator, dwNext );
+	}
+	HeapAllocatorInsertFree( pAllocator, dwBlock );
+}
+
+//walks the physical chain, so it costs O(blocks), meant for debug output and benchmarks
+inline
+void GetHeapAllocatorStats( const HeapAllocator *pAllocator, HeapAllocatorStats *pStats )
+{
+	pStats->qwHeapSize = pAllocator->qwSize;
+	pStats->qwAllocatedBytes = pAllocator->qwAllocatedBytes;
+	pStats->qwRequestedBytes = pAllocator->qwRequestedBytes;
+	pStats->qwWastedBytes = pAllocator->qwAllocatedBytes - pAllocator->qwRequestedBytes;
+	pStats->qwFreeBytes = pAllocator->qwSize - pAllocator->qwAllocatedBytes;
+	pStats->dwAllocationCount = pAllocator->dwAllocationCount;
+	pStats->dwFreeBlockCount = pAllocator->dwFreeBlockCount;
+	pStats->qwLargestFreeBlock = 0;
+	if( pAllocator->qwFirstLevelBitmap != 0 )
+	{
+		//the largest block is in the highest non empty list, but that list isn't sorted
+		const u32 dwFirstLevel = HeapAllocatorBitScanReverse( pAllocator->qwFirstLevelBitmap );
+		const u32 dwSecondLevel = HeapAllocatorBitScanReverse( pAllocator->secondLevelBitmaps[dwFirstLevel] );
+		for( u32 dwBlock = pAllocator->freeLists[dwFirstLevel][dwSecondLevel]; dwBlock != HEAP_ALLOCATOR_NONE; dwBlock = pAllocator->pBlocks[dwBlock].dwNextFree )
+		{
+			if( pAllocator->pBlocks[dwBlock].qwSize > pStats->qwLargestFreeBlock )
+			{
+				pStats->qwLargestFreeBlock = pAllocator->pBlocks[dwBlock].qwSize;
+			}
+		}
+	}
+	pStats->fFragmentation = pStats->qwFreeBytes > 0 ? 1.f - (f32)( (f64)pStats->qwLargestFreeBlock / (f64)pStats->qwFreeBytes ) : 0.f;
+}
+
+//checks the physical chain covers the heap without gaps and no two free blocks are neighbours
+inline
+bool ValidateHeapAllocator( const HeapAllocator *pAllocator )
+{
+	u64 qwOffset = 0;
+	u64 qwFree = 0;
+	u32 dwPrev = HEAP_ALLOCATOR_NONE;
+	//block 0 starts at offset 0 so it never gets padding split off in front or merged into a previous block
+	for( u32 dwBlock = 0; dwBlock != HEAP_ALLOCATOR_NONE; dwPrev = dwBlock, dwBlock = pAllocator->pBlocks[dwBlock].dwNextPhysical )
+	{
+		const HeapBlock *pBlock = &pAllocator->pBlocks[dwBlock];
+		if( pBlock->qwOffset != qwOffset || pBlock->dwPrevPhysical != dwPrev || pBlock->qwSize == 0 ||
+			( pBlock->bFree && dwPrev != HEAP_ALLOCATOR_NONE && pAllocator->pBlocks[dwPrev].bFree ) )
+		{
+			return false;
+		}
+		qwFree += pBlock->bFree ? pBlock->qwSize : 0;
+		qwOffset += pBlock->qwSize;
+	}
+	return qwOffset == pAllocator->qwSize && qwFree == pAllocator->qwSize - pAllocator->qwAllocatedBytes;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+//read only memory mapping of a whole file, the pages come in on first touch so files bigger than memory are fine
+//as long as they are walked front to back
+
+#include "Common.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef struct MappedFile
+{
+	const u8 *pBase;
+	u64 qwSize;
+#if defined(_WIN32)
+	HANDLE hFile;
+	HANDLE hMapping;
+#endif
+} MappedFile;
+
+inline
+void CloseMappedFile( MappedFile *pFile )
+{
+#if defined(_WIN32)
+	if( pFile->pBase )
+	{
+		UnmapViewOfFile( pFile->pBase );
+	}
+	if( pFile->hMapping )
+	{
+		CloseHandle( pFile->hMapping );
+	}
+	if( pFile->hFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( pFile->hFile );
+	}
+	pFile->hMapping = NULL;
+	pFile->hFile = INVALID_HANDLE_VALUE;
+#else
+	if( pFile->pBase )
+	{
+		munmap( (void*)pFile->pBase, pFile->qwSize );
+	}
+#endif
+	pFile->pBase = NULL;
+	pFile->qwSize = 0;
+}
+
+//bWillNeed also starts reading the whole file in, only worth it for files that are read right away and fit in memory
+inline
+bool OpenMappedFile( const char *pPath, MappedFile *pFile, bool bWillNeed )
+{
+	pFile->pBase = NULL;
+	pFile->qwSize = 0;
+#if defined(_WIN32)
+	pFile->hMapping = NULL;
+	pFile->hFile = CreateFileA( pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if( pFile->hFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( pFile->hFile, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		CloseMappedFile( pFile );
+		return false;
+	}
+	pFile->hMapping = CreateFileMappingA( pFile->hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( !pFile->hMapping )
+	{
+		CloseMappedFile( pFile );
+		return false;
+	}
+	pFile->pBase = (const u8*)MapViewOfFile( pFile->hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !pFile->pBase )
+	{
+		CloseMappedFile( pFile );
+		return false;
+	}
+	pFile->qwSize = (u64)fileSize.QuadPart;
+	if( bWillNeed )
+	{
+		WIN32_MEMORY_RANGE_ENTRY range = { (void*)pFile->pBase, (SIZE_T)pFile->qwSize };
+		PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+	}
+#else
+	int fd = open( pPath, O_RDONLY );
+	if( fd < 0 )
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if( fstat( fd, &fileStat ) != 0 || fileStat.st_size == 0 )
+	{
+		close( fd );
+		return false;
+	}
+	void *pMapped = mmap( NULL, (u64)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd ); //the mapping keeps the file alive
+	if( pMapped == MAP_FAILED )
+	{
+		return false;
+	}
+	pFile->pBase = (const u8*)pMapped;
+	pFile->qwSize = (u64)fileStat.st_size;
+	madvise( pMapped, pFile->qwSize, MADV_SEQUENTIAL );
+	if( bWillNeed )
+	{
+		madvise( pMapped, pFile->qwSize, MADV_WILLNEED );
+	}
+#endif
+	return true;
+}
+
+#endif
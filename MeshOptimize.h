@@ -0,0 +1,380 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+//mesh optimization before the upload: weld identical vertices, reorder triangles for the post transform vertex cache, reorder vertices for fetch locality
+//Tipsify: https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+
+#include "Common.h"
+#include "Models.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define MESH_OPTIMIZE_CACHE_SIZE 16 //fifo size used for Tipsify and for reporting ACMR
+#define MESH_INVALID_INDEX 0xFFFFFFFFu
+
+typedef struct MeshOptimizeStats
+{
+	u32 dwVertexCountBefore;
+	u32 dwVertexCountAfter;
+	f32 fACMRBefore; //average cache miss ratio, post transform cache misses per triangle (0.5 is the best case, 3 the worst)
+	f32 fACMRAfter;
+	u64 qwBytesBefore;
+	u64 qwBytesAfter;
+} MeshOptimizeStats;
+
+inline
+bool AllocMeshData( MeshData *pMesh, u32 dwVertexCount, u32 dwVertexStride, u32 dwIndexCount )
+{
+#if MAIN_DEBUG
+	assert( ( dwVertexStride % sizeof(u32) ) == 0 ); //keeps the index blob 4 byte aligned
+#endif
+	pMesh->dwVertexCount = dwVertexCount;
+	pMesh->dwVertexStride = dwVertexStride;
+	pMesh->dwIndexCount = dwIndexCount;
+	pMesh->pVertices = (u8*)malloc( MeshDataSize( pMesh ) );
+	if( !pMesh->pVertices )
+	{
+		return false;
+	}
+	pMesh->pIndices = (u32*)( pMesh->pVertices + MeshDataVertexSize( pMesh ) );
+	return true;
+}
+
+inline
+void FreeMeshData( MeshData *pMesh )
+{
+	free( pMesh->pVertices );
+	pMesh->pVertices = NULL;
+	pMesh->pIndices = NULL;
+}
+
+//fifo cache simulation
+inline
+f32 ComputeACMR( const u32 *pIndices, u32 dwIndexCount, u32 dwVertexCount, u32 dwCacheSize )
+{
+	if( dwIndexCount < 3 )
+	{
+		return 0.f;
+	}
+	//timestamp of when each vertex entered the cache, it is still cached while fewer than dwCacheSize misses happened since
+	u32 *pCacheTime = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	if( !pCacheTime )
+	{
+		return 0.f;
+	}
+	memset( pCacheTime, 0, (u64)dwVertexCount * sizeof(u32) );
+	u32 dwMisses = 0;
+	u32 dwTime = dwCacheSize + 1;
+	for( u32 dwIdx = 0; dwIdx < dwIndexCount; ++dwIdx )
+	{
+		u32 dwVertex = pIndices[dwIdx];
+		if( dwTime - pCacheTime[dwVertex] > dwCacheSize )
+		{
+			pCacheTime[dwVertex] = dwTime++;
+			++dwMisses;
+		}
+	}
+	free( pCacheTime );
+	return dwMisses / (f32)( dwIndexCount / 3 );
+}
+
+inline
+u32 HashVertexBytes( const u8 *pVertex, u32 dwStride )
+{
+	//FNV-1a
+	u32 dwHash = 2166136261u;
+	for( u32 dwIdx = 0; dwIdx < dwStride; ++dwIdx )
+	{
+		dwHash = ( dwHash ^ pVertex[dwIdx] ) * 16777619u;
+	}
+	return dwHash;
+}
+
+//writes a remap table from old vertex to welded vertex, vertices are welded when every byte matches, returns the unique vertex count
+//unique vertices keep their first occurrence order
+inline
+u32 WeldVertices( const u8 *pVertices, u32 dwVertexCount, u32 dwStride, u32 *pRemap, u32 *pUniqueToOld )
+{
+	u64 qwTableSize = 1;
+	while( qwTableSize < (u64)dwVertexCount * 2 )
+	{
+		qwTableSize <<= 1;
+	}
+	u32 *pTable = (u32*)malloc( qwTableSize * sizeof(u32) );
+	if( !pTable )
+	{
+		return 0;
+	}
+	memset( pTable, 0xFF, qwTableSize * sizeof(u32) );
+
+	u32 dwUniqueCount = 0;
+	for( u32 dwVertex = 0; dwVertex < dwVertexCount; ++dwVertex )
+	{
+		const u8 *pVertex = pVertices + (u64)dwVertex * dwStride;
+		u64 qwSlot = HashVertexBytes( pVertex, dwStride ) & ( qwTableSize - 1 );
+		for( ;; )
+		{
+			u32 dwUnique = pTable[qwSlot];
+			if( dwUnique == MESH_INVALID_INDEX )
+			{
+				pTable[qwSlot] = dwUniqueCount;
+				pUniqueToOld[dwUniqueCount] = dwVertex;
+				pRemap[dwVertex] = dwUniqueCount++;
+				break;
+			}
+			if( memcmp( pVertices + (u64)pUniqueToOld[dwUnique] * dwStride, pVertex, dwStride ) == 0 )
+			{
+				pRemap[dwVertex] = dwUnique;
+				break;
+			}
+			qwSlot = ( qwSlot + 1 ) & ( qwTableSize - 1 );
+		}
+	}
+	free( pTable );
+	return dwUniqueCount;
+}
+
+//Tipsify, fans around the vertex that is most likely still in the cache, pOutIndices can not alias pIndices
+inline
+bool OptimizeVertexCacheTipsify( const u32 *pIndices, u32 dwIndexCount, u32 dwVertexCount, u32 dwCacheSize, u32 *pOutIndices )
+{
+	const u32 dwTriangleCount = dwIndexCount / 3;
+	if( dwTriangleCount == 0 )
+	{
+		return true;
+	}
+
+	//vertex -> triangle adjacency
+	u32 *pAdjOffsets = (u32*)malloc( ( (u64)dwVertexCount + 1 ) * sizeof(u32) );
+	u32 *pAdjTriangles = (u32*)malloc( (u64)dwTriangleCount * 3 * sizeof(u32) );
+	u32 *pLiveTriangles = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	u32 *pCacheTime = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	u32 *pDeadEnd = (u32*)malloc( (u64)dwTriangleCount * 3 * sizeof(u32) );
+	u8 *pEmitted = (u8*)malloc( dwTriangleCount );
+	if( !pAdjOffsets || !pAdjTriangles || !pLiveTriangles || !pCacheTime || !pDeadEnd || !pEmitted )
+	{
+		free( pAdjOffsets ); free( pAdjTriangles ); free( pLiveTriangles ); free( pCacheTime ); free( pDeadEnd ); free( pEmitted );
+		return false;
+	}
+	memset( pLiveTriangles, 0, (u64)dwVertexCount * sizeof(u32) );
+	memset( pCacheTime, 0, (u64)dwVertexCount * sizeof(u32) );
+	memset( pEmitted, 0, dwTriangleCount );
+	for( u32 dwIdx = 0; dwIdx < dwTriangleCount * 3; ++dwIdx )
+	{
+		++pLiveTriangles[pIndices[dwIdx]];
+	}
+	pAdjOffsets[0] = 0;
+	for( u32 dwVertex = 0; dwVertex < dwVertexCount; ++dwVertex )
+	{
+		pAdjOffsets[dwVertex + 1] = pAdjOffsets[dwVertex] + pLiveTriangles[dwVertex];
+	}
+	//pCacheTime doubles as the fill cursor while building the adjacency
+	for( u32 dwIdx = 0; dwIdx < dwTriangleCount * 3; ++dwIdx )
+	{
+		u32 dwVertex = pIndices[dwIdx];
+		pAdjTriangles[pAdjOffsets[dwVertex] + pCacheTime[dwVertex]++] = dwIdx / 3;
+	}
+	memset( pCacheTime, 0, (u64)dwVertexCount * sizeof(u32) );
+
+	u32 dwOut = 0;
+	u32 dwDeadEndTop = 0;
+	u32 dwTime = dwCacheSize + 1;
+	u32 dwCursor = 0;
+	s64 qwFanning = 0;
+	while( qwFanning >= 0 )
+	{
+		const u32 dwFanning = (u32)qwFanning;
+		//candidates are the vertices of the triangles emitted from this fan, they sit right behind them in the output
+		const u32 dwCandidateBegin = dwOut;
+		for( u32 dwAdj = pAdjOffsets[dwFanning]; dwAdj < pAdjOffsets[dwFanning + 1]; ++dwAdj )
+		{
+			u32 dwTriangle = pAdjTriangles[dwAdj];
+			if( pEmitted[dwTriangle] )
+			{
+				continue;
+			}
+			for( u32 dwCorner = 0; dwCorner < 3; ++dwCorner )
+			{
+				u32 dwVertex = pIndices[dwTriangle * 3 + dwCorner];
+				pOutIndices[dwOut++] = dwVertex;
+				pDeadEnd[dwDeadEndTop++] = dwVertex;
+				--pLiveTriangles[dwVertex];
+				if( dwTime - pCacheTime[dwVertex] > dwCacheSize )
+				{
+					pCacheTime[dwVertex] = dwTime++;
+				}
+			}
+			pEmitted[dwTriangle] = 1;
+		}
+
+		//next fanning vertex, prefer one that will still be in the cache after its remaining triangles are emitted
+		qwFanning = -1;
+		s64 qwBestPriority = -1;
+		for( u32 dwCandidate = dwCandidateBegin; dwCandidate < dwOut; ++dwCandidate )
+		{
+			u32 dwVertex = pOutIndices[dwCandidate];
+			if( pLiveTriangles[dwVertex] == 0 )
+			{
+				continue;
+			}
+			s64 qwPriority = 0;
+			if( dwTime - pCacheTime[dwVertex] + 2 * pLiveTriangles[dwVertex] <= dwCacheSize )
+			{
+				qwPriority = dwTime - pCacheTime[dwVertex];
+			}
+			if( qwPriority > qwBestPriority )
+			{
+				qwBestPriority = qwPriority;
+				qwFanning = dwVertex;
+			}
+		}
+
+		//dead end, walk back through recently used vertices, then scan forward through the input
+		while( qwFanning < 0 && dwDeadEndTop > 0 )
+		{
+			u32 dwVertex = pDeadEnd[--dwDeadEndTop];
+			if( pLiveTriangles[dwVertex] > 0 )
+			{
+				qwFanning = dwVertex;
+			}
+		}
+		while( qwFanning < 0 && dwCursor < dwVertexCount )
+		{
+			if( pLiveTriangles[dwCursor] > 0 )
+			{
+				qwFanning = dwCursor;
+			}
+			++dwCursor;
+		}
+	}
+#if MAIN_DEBUG
+	assert( dwOut == dwTriangleCount * 3 );
+#endif
+
+	free( pAdjOffsets ); free( pAdjTriangles ); free( pLiveTriangles ); free( pCacheTime ); free( pDeadEnd ); free( pEmitted );
+	return true;
+}
+
+//renumbers vertices in the order the index buffer first touches them, unreferenced vertices are dropped, returns the vertex count
+//returns 0 when an index is out of range
+inline
+u32 BuildVertexFetchRemap( u32 *pIndices, u32 dwIndexCount, u32 dwVertexCount, u32 *pNewToOld )
+{
+	u32 *pOldToNew = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	if( !pOldToNew )
+	{
+		return 0;
+	}
+	memset( pOldToNew, 0xFF, (u64)dwVertexCount * sizeof(u32) );
+	u32 dwNext = 0;
+	for( u32 dwIdx = 0; dwIdx < dwIndexCount; ++dwIdx )
+	{
+		u32 dwOld = pIndices[dwIdx];
+		if( dwOld >= dwVertexCount )
+		{
+			free( pOldToNew );
+			return 0;
+		}
+		if( pOldToNew[dwOld] == MESH_INVALID_INDEX )
+		{
+			pNewToOld[dwNext] = dwOld;
+			pOldToNew[dwOld] = dwNext++;
+		}
+		pIndices[dwIdx] = pOldToNew[dwOld];
+	}
+	free( pOldToNew );
+	return dwNext;
+}
+
+//weld -> Tipsify -> vertex fetch reorder, pOut is allocated with AllocMeshData
+//fails on a partial triangle or an index past dwVertexCount, Tipsify only writes whole triangles
+inline
+bool OptimizeMesh( const u8 *pVertices, u32 dwVertexCount, u32 dwStride, const u32 *pIndices, u32 dwIndexCount, MeshData *pOut, MeshOptimizeStats *pStats )
+{
+	if( dwIndexCount % 3 != 0 )
+	{
+		return false;
+	}
+	for( u32 dwIdx = 0; dwIdx < dwIndexCount; ++dwIdx )
+	{
+		if( pIndices[dwIdx] >= dwVertexCount )
+		{
+			return false;
+		}
+	}
+
+	u32 *pRemap = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	u32 *pUniqueToOld = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	u32 *pWeldedIndices = (u32*)malloc( (u64)dwIndexCount * sizeof(u32) );
+	u32 *pCacheIndices = (u32*)malloc( (u64)dwIndexCount * sizeof(u32) );
+	u32 *pNewToUnique = (u32*)malloc( (u64)dwVertexCount * sizeof(u32) );
+	bool bSuccess = false;
+	if( pRemap && pUniqueToOld && pWeldedIndices && pCacheIndices && pNewToUnique )
+	{
+		u32 dwUniqueCount = WeldVertices( pVertices, dwVertexCount, dwStride, pRemap, pUniqueToOld );
+		for( u32 dwIdx = 0; dwIdx < dwIndexCount; ++dwIdx )
+		{
+			pWeldedIndices[dwIdx] = pRemap[pIndices[dwIdx]];
+		}
+		if( dwUniqueCount > 0 && OptimizeVertexCacheTipsify( pWeldedIndices, dwIndexCount, dwUniqueCount, MESH_OPTIMIZE_CACHE_SIZE, pCacheIndices ) )
+		{
+			u32 dwFinalCount = BuildVertexFetchRemap( pCacheIndices, dwIndexCount, dwUniqueCount, pNewToUnique );
+			if( ( dwFinalCount > 0 || dwIndexCount == 0 ) && AllocMeshData( pOut, dwFinalCount, dwStride, dwIndexCount ) )
+			{
+				for( u32 dwVertex = 0; dwVertex < dwFinalCount; ++dwVertex )
+				{
+					memcpy( pOut->pVertices + (u64)dwVertex * dwStride, pVertices + (u64)pUniqueToOld[pNewToUnique[dwVertex]] * dwStride, dwStride );
+				}
+				memcpy( pOut->pIndices, pCacheIndices, (u64)dwIndexCount * sizeof(u32) );
+				bSuccess = true;
+			}
+		}
+	}
+
+	if( bSuccess && pStats )
+	{
+		pStats->dwVertexCountBefore = dwVertexCount;
+		pStats->dwVertexCountAfter = pOut->dwVertexCount;
+		pStats->fACMRBefore = ComputeACMR( pIndices, dwIndexCount, dwVertexCount, MESH_OPTIMIZE_CACHE_SIZE );
+		pStats->fACMRAfter = ComputeACMR( pOut->pIndices, dwIndexCount, pOut->dwVertexCount, MESH_OPTIMIZE_CACHE_SIZE );
+		pStats->qwBytesBefore = (u64)dwVertexCount * dwStride + (u64)dwIndexCount * sizeof(u32);
+		pStats->qwBytesAfter = MeshDataSize( pOut );
+	}
+
+	free( pRemap ); free( pUniqueToOld ); free( pWeldedIndices ); free( pCacheIndices ); free( pNewToUnique );
+	return bSuccess;
+}
+
+inline
+void PrintMeshOptimizeStats( const char *pName, const MeshOptimizeStats *pStats )
+{
+	printf( "%s: vertices %u -> %u, ACMR %.3f -> %.3f, bytes %llu -> %llu (saved %llu)\n", pName,
+			pStats->dwVertexCountBefore, pStats->dwVertexCountAfter, pStats->fACMRBefore, pStats->fACMRAfter,
+			(unsigned long long)pStats->qwBytesBefore, (unsigned long long)pStats->qwBytesAfter, (unsigned long long)( pStats->qwBytesBefore - pStats->qwBytesAfter ) );
+}
+
+//optimized copies of the meshes in Models.h, indexed by BUILTIN_MESH_*
+inline
+bool OptimizeBuiltinMeshes( MeshData *pMeshes )
+{
+	MeshOptimizeStats stats[BUILTIN_MESH_COUNT];
+	if( !OptimizeMesh( (const u8*)planeVertices, sizeof(planeVertices)/MODEL_VERTEX_STRIDE, MODEL_VERTEX_STRIDE, planeIndices, sizeof(planeIndices)/sizeof(u32), &pMeshes[BUILTIN_MESH_PLANE], &stats[BUILTIN_MESH_PLANE] ) )
+	{
+		return false;
+	}
+	if( !OptimizeMesh( (const u8*)cubeVertices, sizeof(cubeVertices)/MODEL_VERTEX_STRIDE, MODEL_VERTEX_STRIDE, cubeIndicies, sizeof(cubeIndicies)/sizeof(u32), &pMeshes[BUILTIN_MESH_CUBE], &stats[BUILTIN_MESH_CUBE] ) )
+	{
+		FreeMeshData( &pMeshes[BUILTIN_MESH_PLANE] );
+		return false;
+	}
+#if MAIN_DEBUG
+	PrintMeshOptimizeStats( "plane", &stats[BUILTIN_MESH_PLANE] );
+	PrintMeshOptimizeStats( "cube", &stats[BUILTIN_MESH_CUBE] );
+#endif
+	return true;
+}
+
+#endif
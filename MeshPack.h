@@ -0,0 +1,200 @@
+#ifndef MESH_PACK_H
+#define MESH_PACK_H
+
+//binary mesh container, memory mapped and copied straight into the upload heap
+//layout: MeshPackHeader | MeshPackEntry[dwMeshCount] | padding | blob (vertex and index data, each aligned to MESH_PACK_BLOB_ALIGNMENT)
+//entry offsets are relative to the start of the blob so the whole blob is one memcpy and views are base address + offset
+
+#include "Common.h"
+#include "Models.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MESH_PACK_MAGIC 0x314B504Du //"MPK1"
+#define MESH_PACK_VERSION 1
+#define MESH_PACK_BLOB_ALIGNMENT 256
+#define MESH_PACK_INDEX_FORMAT_R32_UINT 42 //DXGI_FORMAT_R32_UINT
+
+typedef struct MeshPackHeader
+{
+	u32 dwMagic;
+	u32 dwVersion;
+	u32 dwMeshCount;
+	u32 dwReserved;
+	u64 qwEntriesOffset; //from the start of the file
+	u64 qwBlobOffset;    //from the start of the file, aligned to MESH_PACK_BLOB_ALIGNMENT
+	u64 qwBlobSize;
+} MeshPackHeader;
+
+typedef struct MeshPackEntry
+{
+	u64 qwVertexOffset; //from the start of the blob
+	u64 qwIndexOffset;  //from the start of the blob
+	u32 dwVertexCount;
+	u32 dwVertexStride;
+	u32 dwIndexCount;
+	u32 dwIndexFormat;  //DXGI_FORMAT
+} MeshPackEntry;
+
+//same layouts as D3D12_VERTEX_BUFFER_VIEW and D3D12_INDEX_BUFFER_VIEW
+typedef struct MeshVertexBufferView
+{
+	u64 BufferLocation;
+	u32 SizeInBytes;
+	u32 StrideInBytes;
+} MeshVertexBufferView;
+
+typedef struct MeshIndexBufferView
+{
+	u64 BufferLocation;
+	u32 SizeInBytes;
+	u32 Format;
+} MeshIndexBufferView;
+
+typedef struct MeshPackFile
+{
+	MappedFile file;
+	const MeshPackHeader *pHeader;
+	const MeshPackEntry *pEntries;
+} MeshPackFile;
+
+inline
+u64 MeshPackAlign( u64 qwValue )
+{
+	return AlignUp( qwValue, MESH_PACK_BLOB_ALIGNMENT );
+}
+
+//lays out meshes inside a blob, returns the blob size, pBlob can be NULL to only size it
+inline
+u64 PackMeshBlob( const MeshData *pMeshes, u32 dwMeshCount, u8 *pBlob, MeshPackEntry *pEntries )
+{
+	u64 qwOffset = 0;
+	for( u32 dwMesh = 0; dwMesh < dwMeshCount; ++dwMesh )
+	{
+		const MeshData *pMesh = &pMeshes[dwMesh];
+		MeshPackEntry entry;
+		entry.qwVertexOffset = qwOffset;
+		entry.qwIndexOffset = MeshPackAlign( qwOffset + MeshDataVertexSize( pMesh ) );
+		entry.dwVertexCount = pMesh->dwVertexCount;
+		entry.dwVertexStride = pMesh->dwVertexStride;
+		entry.dwIndexCount = pMesh->dwIndexCount;
+		entry.dwIndexFormat = MESH_PACK_INDEX_FORMAT_R32_UINT;
+		qwOffset = MeshPackAlign( entry.qwIndexOffset + (u64)pMesh->dwIndexCount * sizeof(u32) );
+		if( pBlob )
+		{
+			memset( pBlob + entry.qwVertexOffset, 0, qwOffset - entry.qwVertexOffset );
+			memcpy( pBlob + entry.qwVertexOffset, pMesh->pVertices, MeshDataVertexSize( pMesh ) );
+			memcpy( pBlob + entry.qwIndexOffset, pMesh->pIndices, (u64)pMesh->dwIndexCount * sizeof(u32) );
+		}
+		if( pEntries )
+		{
+			pEntries[dwMesh] = entry;
+		}
+	}
+	return qwOffset;
+}
+
+inline
+bool WriteMeshPack( const char *pPath, const MeshData *pMeshes, u32 dwMeshCount )
+{
+	MeshPackHeader header;
+	header.dwMagic = MESH_PACK_MAGIC;
+	header.dwVersion = MESH_PACK_VERSION;
+	header.dwMeshCount = dwMeshCount;
+	header.dwReserved = 0;
+	header.qwEntriesOffset = sizeof(MeshPackHeader);
+	header.qwBlobOffset = MeshPackAlign( header.qwEntriesOffset + (u64)dwMeshCount * sizeof(MeshPackEntry) );
+	header.qwBlobSize = PackMeshBlob( pMeshes, dwMeshCount, NULL, NULL );
+
+	const u64 qwFileSize = header.qwBlobOffset + header.qwBlobSize;
+	u8 *pFile = (u8*)malloc( qwFileSize );
+	if( !pFile )
+	{
+		return false;
+	}
+	memset( pFile, 0, header.qwBlobOffset );
+	memcpy( pFile, &header, sizeof(MeshPackHeader) );
+	PackMeshBlob( pMeshes, dwMeshCount, pFile + header.qwBlobOffset, (MeshPackEntry*)( pFile + header.qwEntriesOffset ) );
+
+	FILE *pOut = fopen( pPath, "wb" );
+	bool bWritten = pOut && fwrite( pFile, 1, qwFileSize, pOut ) == qwFileSize;
+	if( pOut )
+	{
+		bWritten &= fclose( pOut ) == 0;
+	}
+	free( pFile );
+	return bWritten;
+}
+
+inline
+void CloseMeshPack( MeshPackFile *pPack )
+{
+	CloseMappedFile( &pPack->file );
+	pPack->pHeader = NULL;
+	pPack->pEntries = NULL;
+}
+
+//maps the file read only, nothing is parsed or copied, only the header and offset table are validated
+//the blob is read front to back exactly once by the upload memcpy, so the whole file is read ahead
+inline
+bool OpenMeshPack( const char *pPath, MeshPackFile *pPack )
+{
+	pPack->pHeader = NULL;
+	pPack->pEntries = NULL;
+	if( !OpenMappedFile( pPath, &pPack->file, true ) )
+	{
+		return false;
+	}
+	if( pPack->file.qwSize < sizeof(MeshPackHeader) )
+	{
+		CloseMeshPack( pPack );
+		return false;
+	}
+
+	const MeshPackHeader *pHeader = (const MeshPackHeader*)pPack->file.pBase;
+	bool bValid = pHeader->dwMagic == MESH_PACK_MAGIC && pHeader->dwVersion == MESH_PACK_VERSION &&
+				  pHeader->qwEntriesOffset <= pPack->file.qwSize &&
+				  (u64)pHeader->dwMeshCount * sizeof(MeshPackEntry) <= pPack->file.qwSize - pHeader->qwEntriesOffset &&
+				  ( pHeader->qwEntriesOffset % sizeof(u64) ) == 0 &&
+				  pHeader->qwBlobOffset <= pPack->file.qwSize && pHeader->qwBlobSize <= pPack->file.qwSize - pHeader->qwBlobOffset;
+	const MeshPackEntry *pEntries = (const MeshPackEntry*)( pPack->file.pBase + pHeader->qwEntriesOffset );
+	for( u32 dwMesh = 0; bValid && dwMesh < pHeader->dwMeshCount; ++dwMesh )
+	{
+		const MeshPackEntry *pEntry = &pEntries[dwMesh];
+		bValid = pEntry->dwIndexFormat == MESH_PACK_INDEX_FORMAT_R32_UINT &&
+				 pEntry->qwVertexOffset <= pHeader->qwBlobSize &&
+				 (u64)pEntry->dwVertexCount * pEntry->dwVertexStride <= pHeader->qwBlobSize - pEntry->qwVertexOffset &&
+				 pEntry->qwIndexOffset <= pHeader->qwBlobSize &&
+				 (u64)pEntry->dwIndexCount * sizeof(u32) <= pHeader->qwBlobSize - pEntry->qwIndexOffset;
+	}
+	if( !bValid )
+	{
+		CloseMeshPack( pPack );
+		return false;
+	}
+	pPack->pHeader = pHeader;
+	pPack->pEntries = pEntries;
+	return true;
+}
+
+inline
+const u8 *MeshPackBlob( const MeshPackFile *pPack )
+{
+	return pPack->file.pBase + pPack->pHeader->qwBlobOffset;
+}
+
+//views for a mesh whose blob was copied to qwBlobAddress (a gpu virtual address or a cpu pointer)
+inline
+void GetMeshPackViews( const MeshPackEntry *pEntry, u64 qwBlobAddress, MeshVertexBufferView *pVertexView, MeshIndexBufferView *pIndexView )
+{
+	pVertexView->BufferLocation = qwBlobAddress + pEntry->qwVertexOffset;
+	pVertexView->SizeInBytes = pEntry->dwVertexCount * pEntry->dwVertexStride;
+	pVertexView->StrideInBytes = pEntry->dwVertexStride;
+	pIndexView->BufferLocation = qwBlobAddress + pEntry->qwIndexOffset;
+	pIndexView->SizeInBytes = pEntry->dwIndexCount * (u32)sizeof(u32);
+	pIndexView->Format = pEntry->dwIndexFormat;
+}
+
+#endif
@@ -0,0 +1,500 @@
+//microbenchmarks of every Math3D routine and of the cpu backend dispatch -> readback round trip
+//reports ns/op (best and median batch), Mops/s and rdtsc cycles/op, --json writes the same numbers for tracking between releases
+//and --compare checks them against an earlier --json run
+//
+//MicroBench [--filter text] [--min-ms n] [--workers n] [--json path] [--compare path] [--threshold percent]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Common.h"
+#include "Models.h"
+#include "Timer.h"
+#include "Math3D.h"
+#include "CpuFence.h"
+#include "CpuQueue.h"
+#include "CpuCompute.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#define MICRO_STRINGIFY2( x ) #x
+#define MICRO_STRINGIFY( x ) MICRO_STRINGIFY2( x )
+#define MICRO_COMPILER "msvc " MICRO_STRINGIFY( _MSC_FULL_VER )
+#elif defined(__clang__)
+#define MICRO_COMPILER __VERSION__
+#else
+#define MICRO_COMPILER "gcc " __VERSION__
+#endif
+
+#define MICRO_ELEMENTS 1024 //inputs per routine, 64KB of Mat4f so the loads come from L2 at worst
+#define MICRO_ELEMENT_MASK ( MICRO_ELEMENTS - 1 )
+#define MICRO_MATH_BATCH 4096
+#define MICRO_MIN_BATCHES 16
+#define MICRO_MAX_BATCHES 4096
+#define MICRO_DEFAULT_MIN_MS 100
+#define MICRO_DEFAULT_THRESHOLD 10.0 //percent slower than the baseline that counts as a regression
+#define MICRO_MAX_RESULTS 64
+#define MICRO_READBACK_GROUPS 65536
+
+typedef struct MicroBenchData
+{
+	Mat4f mats[MICRO_ELEMENTS];
+	Mat4f matsOut[MICRO_ELEMENTS];
+	Mat3x4f mats3x4Out[MICRO_ELEMENTS];
+	Quatf quats[MICRO_ELEMENTS];
+	Quatf quatsOut[MICRO_ELEMENTS];
+	Vec3f vecs[MICRO_ELEMENTS];
+	Vec3f vecsOut[MICRO_ELEMENTS];
+	Vec4f planesOut[MICRO_ELEMENTS][6];
+	f32 fScalars[MICRO_ELEMENTS]; //in [0,1), interpolation factors and angles
+	f32 fScalarsOut[MICRO_ELEMENTS];
+} MicroBenchData;
+
+typedef struct MicroBenchContext
+{
+	MicroBenchData *pData;
+	CpuComputeDevice *pDevice;
+	CpuQueue queue;
+	CpuFence fence;
+	u64 qwFenceValue;
+	CpuComputeKernel mainKernel;   //ComputeShaderMainCpu, what InitDirectX12() dispatches
+	CpuComputeKernel writeKernel;  //one ModelOutData per group
+	CpuComputeRootArgs root;
+	u32 dwGroups;
+	ModelOutData *pOut;            //MICRO_READBACK_GROUPS, stands in for the default heap uav
+	ModelOutData *pReadback;       //MICRO_READBACK_GROUPS, stands in for the readback heap
+} MicroBenchContext;
+
+typedef void (*PFN_MicroBatch)( MicroBenchContext *pContext, u32 dwCount );
+
+typedef struct MicroBench
+{
+	const char *pName;
+	const char *pGroup;
+	PFN_MicroBatch pfnBatch;
+	u32 dwOpsPerBatch;
+	u32 dwBytesPerOp; //readback bytes, 0 for the math routines
+} MicroBench;
+
+typedef struct MicroBenchResult
+{
+	const char *pName;
+	const char *pGroup;
+	u64 qwOps;
+	f64 fNsPerOp;       //best batch
+	f64 fMedianNsPerOp;
+	f64 fCyclesPerOp;   //rdtsc of the best batch, reference cycles so they do not follow turbo
+	f64 fMopsPerSec;
+	f64 fBytesPerSec;
+} MicroBenchResult;
+
+//every op reads element i (and i+1 where it needs two inputs) and writes element i, so calls are independent
+#define MICRO_MATH_OP( name, body ) \
+void Micro##name( MicroBenchContext *pContext, u32 dwCount ) \
+{ \
+	MicroBenchData *p = pContext->pData; \
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx ) \
+	{ \
+		const u32 i = dwIdx & MICRO_ELEMENT_MASK; \
+		const u32 j = ( dwIdx + 1 ) & MICRO_ELEMENT_MASK; \
+		(void)j; \
+		body; \
+	} \
+}
+
+MICRO_MATH_OP( InitMat3f, InitMat3f( (Mat3f*)&p->mats3x4Out[i] ) )
+MICRO_MATH_OP( InitMat4f, InitMat4f( &p->matsOut[i] ) )
+MICRO_MATH_OP( InitTransMat4f, InitTransMat4f( &p->matsOut[i], &p->vecs[i] ) )
+MICRO_MATH_OP( InitRotArbAxisMat4f, InitRotArbAxisMat4f( &p->matsOut[i], &p->vecs[i], p->fScalars[i] * 360.f ) )
+MICRO_MATH_OP( InitPerspectiveProjectionMat4fDirectXRH, InitPerspectiveProjectionMat4fDirectXRH( &p->matsOut[i], 1920, 1080, 60.f + p->fScalars[i], 40.f, 0.1f, 1000.f ) )
+MICRO_MATH_OP( InitPerspectiveProjectionMat4fDirectXLH, InitPerspectiveProjectionMat4fDirectXLH( &p->matsOut[i], 1920, 1080, 60.f + p->fScalars[i], 40.f, 0.1f, 1000.f ) )
+MICRO_MATH_OP( ExtractFrustumPlanesMat4f, ExtractFrustumPlanesMat4f( &p->mats[i], p->planesOut[i] ) )
+MICRO_MATH_OP( DeterminantUpper3x3Mat4f, p->fScalarsOut[i] = DeterminantUpper3x3Mat4f( &p->mats[i] ) )
+MICRO_MATH_OP( InverseUpper3x3Mat4f, InverseUpper3x3Mat4f( &p->mats[i], &p->matsOut[i] ) )
+MICRO_MATH_OP( InverseTransposeUpper3x3Mat4f, InverseTransposeUpper3x3Mat4f( &p->mats[i], &p->matsOut[i] ) )
+MICRO_MATH_OP( InverseTransposeUpper3x3Mat3x4f, InverseTransposeUpper3x3Mat4f( &p->mats[i], &p->mats3x4Out[i] ) )
+MICRO_MATH_OP( Mat4fMult, Mat4fMult( &p->mats[i], &p->mats[j], &p->matsOut[i] ) )
+MICRO_MATH_OP( Vec3fTransformPointMat4f, Vec3fTransformPointMat4f( &p->vecs[i], &p->mats[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fTransformDirMat3x4f, Vec3fTransformDirMat3x4f( &p->vecs[i], (Mat3x4f*)&p->mats[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fAdd, Vec3fAdd( &p->vecs[i], &p->vecs[j], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fSub, Vec3fSub( &p->vecs[i], &p->vecs[j], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fMult, Vec3fMult( &p->vecs[i], &p->vecs[j], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fCross, Vec3fCross( &p->vecs[i], &p->vecs[j], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fScale, Vec3fScale( &p->vecs[i], p->fScalars[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fScaleAdd, Vec3fScaleAdd( &p->vecs[i], p->fScalars[i], &p->vecs[j], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fDot, p->fScalarsOut[i] = Vec3fDot( &p->vecs[i], &p->vecs[j] ) )
+MICRO_MATH_OP( Vec3fNormalize, Vec3fNormalize( &p->vecs[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fLerp, Vec3fLerp( &p->vecs[i], &p->vecs[j], p->fScalars[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fRotByUnitQuat, Vec3fRotByUnitQuat( &p->vecs[i], &p->quats[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( Vec3fRotByUnitQuatExpanded, Vec3fRotByUnitQuatExpanded( &p->vecs[i], &p->quats[i], &p->vecsOut[i] ) )
+MICRO_MATH_OP( InitUnitQuatf, InitUnitQuatf( &p->quatsOut[i], p->fScalars[i] * 360.f, &p->vecs[i] ) )
+MICRO_MATH_OP( QuatfMult, QuatfMult( &p->quats[i], &p->quats[j], &p->quatsOut[i] ) )
+MICRO_MATH_OP( QuatfSub, QuatfSub( &p->quats[i], &p->quats[j], &p->quatsOut[i] ) )
+MICRO_MATH_OP( QuatfScaleAdd, QuatfScaleAdd( &p->quats[i], p->fScalars[i], &p->quats[j], &p->quatsOut[i] ) )
+MICRO_MATH_OP( QuatfNormalize, QuatfNormalize( &p->quats[i], &p->quatsOut[i] ) )
+MICRO_MATH_OP( QuatfDot, p->fScalarsOut[i] = QuatfDot( &p->quats[i], &p->quats[j] ) )
+MICRO_MATH_OP( QuatfNormLerp, QuatfNormLerp( &p->quats[i], &p->quats[j], p->fScalars[i], &p->quatsOut[i] ) )
+MICRO_MATH_OP( QuatfSlerp, QuatfSlerp( &p->quats[i], &p->quats[j], p->fScalars[i], &p->quatsOut[i] ) )
+MICRO_MATH_OP( InitViewMat4ByQuatf, InitViewMat4ByQuatf( &p->matsOut[i], &p->quats[i], &p->vecs[i] ) )
+MICRO_MATH_OP( InitModelMat4ByQuatf, InitModelMat4ByQuatf( &p->matsOut[i], &p->quats[i], &p->vecs[i] ) )
+
+//InitDirectX12(): one group of the compute shader, then the 16 byte result is copied out of the readback heap
+void MicroDispatchReadback( MicroBenchContext *pContext, u32 dwCount )
+{
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		pContext->root.cb.dwOffsetsAndStrides0[0] = dwIdx;
+		CpuDispatch( pContext->pDevice, &pContext->mainKernel, &pContext->root, 1, 1, 1 );
+		memcpy( pContext->pReadback, pContext->root.pOut, sizeof(ModelOutData) );
+	}
+}
+
+void MicroQueueDispatch( void *pContext )
+{
+	MicroBenchContext *pBench = (MicroBenchContext*)pContext;
+	CpuDispatch( pBench->pDevice, pBench->dwGroups == 1 ? &pBench->mainKernel : &pBench->writeKernel, &pBench->root, pBench->dwGroups, 1, 1 );
+}
+
+//the asynchronous version: ExecuteCommandLists + Signal on the queue thread, the caller blocks on the fence and then reads back
+void MicroQueueDispatchReadback( MicroBenchContext *pContext, u32 dwCount )
+{
+	pContext->dwGroups = 1;
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		pContext->root.cb.dwOffsetsAndStrides0[0] = dwIdx;
+		CpuQueueExecute( &pContext->queue, MicroQueueDispatch, pContext );
+		CpuQueueSignal( &pContext->queue, &pContext->fence, ++pContext->qwFenceValue );
+		CpuFenceWait( &pContext->fence, pContext->qwFenceValue );
+		memcpy( pContext->pReadback, pContext->root.pOut, sizeof(ModelOutData) );
+	}
+}
+
+void MicroWriteGroupCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+	{
+		pRoot->pOut[Gid.x].dwData[dwIdx] = Gid.x * 4 + dwIdx + pRoot->cb.dwOffsetsAndStrides0[0];
+	}
+}
+
+//a wide dispatch through the queue with the whole uav read back, an op is one group
+void MicroQueueWideDispatchReadback( MicroBenchContext *pContext, u32 dwCount )
+{
+	pContext->dwGroups = MICRO_READBACK_GROUPS;
+	for( u32 dwIdx = 0; dwIdx < dwCount; dwIdx += MICRO_READBACK_GROUPS )
+	{
+		pContext->root.cb.dwOffsetsAndStrides0[0] = dwIdx;
+		CpuQueueExecute( &pContext->queue, MicroQueueDispatch, pContext );
+		CpuQueueSignal( &pContext->queue, &pContext->fence, ++pContext->qwFenceValue );
+		CpuFenceWait( &pContext->fence, pContext->qwFenceValue );
+		memcpy( pContext->pReadback, pContext->root.pOut, (u64)MICRO_READBACK_GROUPS * sizeof(ModelOutData) );
+	}
+}
+
+#define MICRO_MATH( name ) { #name, "math", Micro##name, MICRO_MATH_BATCH, 0 }
+
+static const MicroBench microBenches[] =
+{
+	MICRO_MATH( InitMat3f ),
+	MICRO_MATH( InitMat4f ),
+	MICRO_MATH( InitTransMat4f ),
+	MICRO_MATH( InitRotArbAxisMat4f ),
+	MICRO_MATH( InitPerspectiveProjectionMat4fDirectXRH ),
+	MICRO_MATH( InitPerspectiveProjectionMat4fDirectXLH ),
+	MICRO_MATH( ExtractFrustumPlanesMat4f ),
+	MICRO_MATH( DeterminantUpper3x3Mat4f ),
+	MICRO_MATH( InverseUpper3x3Mat4f ),
+	MICRO_MATH( InverseTransposeUpper3x3Mat4f ),
+	MICRO_MATH( InverseTransposeUpper3x3Mat3x4f ),
+	MICRO_MATH( Mat4fMult ),
+	MICRO_MATH( Vec3fTransformPointMat4f ),
+	MICRO_MATH( Vec3fTransformDirMat3x4f ),
+	MICRO_MATH( Vec3fAdd ),
+	MICRO_MATH( Vec3fSub ),
+	MICRO_MATH( Vec3fMult ),
+	MICRO_MATH( Vec3fCross ),
+	MICRO_MATH( Vec3fScale ),
+	MICRO_MATH( Vec3fScaleAdd ),
+	MICRO_MATH( Vec3fDot ),
+	MICRO_MATH( Vec3fNormalize ),
+	MICRO_MATH( Vec3fLerp ),
+	MICRO_MATH( Vec3fRotByUnitQuat ),
+	MICRO_MATH( Vec3fRotByUnitQuatExpanded ),
+	MICRO_MATH( InitUnitQuatf ),
+	MICRO_MATH( QuatfMult ),
+	MICRO_MATH( QuatfSub ),
+	MICRO_MATH( QuatfScaleAdd ),
+	MICRO_MATH( QuatfNormalize ),
+	MICRO_MATH( QuatfDot ),
+	MICRO_MATH( QuatfNormLerp ),
+	MICRO_MATH( QuatfSlerp ),
+	MICRO_MATH( InitViewMat4ByQuatf ),
+	MICRO_MATH( InitModelMat4ByQuatf ),
+	{ "DispatchReadback", "dispatch", MicroDispatchReadback, 256, sizeof(ModelOutData) },
+	{ "QueueDispatchSignalWaitReadback", "dispatch", MicroQueueDispatchReadback, 256, sizeof(ModelOutData) },
+	{ "QueueWideDispatchReadback", "dispatch", MicroQueueWideDispatchReadback, MICRO_READBACK_GROUPS * 4, sizeof(ModelOutData) },
+};
+
+f32 MicroRandomFloat( u32 *pState )
+{
+	*pState = *pState * 1664525u + 1013904223u;
+	return ( *pState >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+//unit quaternions, vectors around the unit sphere and invertible affine matrices (rotation, scale 0.5 to 1.5, translation)
+void InitMicroBenchData( MicroBenchData *p )
+{
+	memset( p, 0, sizeof(MicroBenchData) );
+	u32 dwState = 17;
+	for( u32 dwIdx = 0; dwIdx < MICRO_ELEMENTS; ++dwIdx )
+	{
+		Vec3f vAxis = { { { MicroRandomFloat( &dwState ) - 0.5f, MicroRandomFloat( &dwState ) - 0.5f, MicroRandomFloat( &dwState ) + 0.1f } } };
+		Vec3fNormalize( &vAxis, &vAxis );
+		InitUnitQuatf( &p->quats[dwIdx], MicroRandomFloat( &dwState ) * 360.f, &vAxis );
+		p->vecs[dwIdx] = vAxis;
+		p->fScalars[dwIdx] = MicroRandomFloat( &dwState );
+		Vec3f vPos = { { { MicroRandomFloat( &dwState ) * 10.f, MicroRandomFloat( &dwState ) * 10.f, MicroRandomFloat( &dwState ) * 10.f } } };
+		InitModelMat4ByQuatf( &p->mats[dwIdx], &p->quats[dwIdx], &vPos );
+		const f32 fScale = 0.5f + MicroRandomFloat( &dwState );
+		for( u32 dwRow = 0; dwRow < 3; ++dwRow )
+		{
+			for( u32 dwCol = 0; dwCol < 3; ++dwCol )
+			{
+				p->mats[dwIdx].m[dwRow][dwCol] *= fScale;
+			}
+		}
+	}
+}
+
+//rdtsc ticks per ns, the cycle counts are in these reference cycles
+f64 MeasureTscGhz()
+{
+	const u64 qwStartNs = GetTimeNs();
+	const u64 qwStartCycles = ReadCycleCounter();
+	while( GetTimeNs() - qwStartNs < 50000000 )
+	{
+	}
+	return (f64)( ReadCycleCounter() - qwStartCycles ) / (f64)( GetTimeNs() - qwStartNs );
+}
+
+void RunMicroBench( MicroBenchContext *pContext, const MicroBench *pBench, u64 qwMinNs, MicroBenchResult *pResult )
+{
+	static f64 batchNsPerOp[MICRO_MAX_BATCHES];
+	pBench->pfnBatch( pContext, pBench->dwOpsPerBatch ); //warm up caches and the workers
+	u32 dwBatches = 0;
+	f64 fBestNsPerOp = 1e30;
+	f64 fBestCyclesPerOp = 0;
+	const u64 qwStart = GetTimeNs();
+	while( dwBatches < MICRO_MAX_BATCHES && ( dwBatches < MICRO_MIN_BATCHES || GetTimeNs() - qwStart < qwMinNs ) )
+	{
+		const u64 qwBatchStart = GetTimeNs();
+		const u64 qwCycleStart = ReadCycleCounter();
+		pBench->pfnBatch( pContext, pBench->dwOpsPerBatch );
+		const u64 qwCycles = ReadCycleCounter() - qwCycleStart;
+		const f64 fNsPerOp = (f64)( GetTimeNs() - qwBatchStart ) / pBench->dwOpsPerBatch;
+		batchNsPerOp[dwBatches++] = fNsPerOp;
+		if( fNsPerOp < fBestNsPerOp )
+		{
+			fBestNsPerOp = fNsPerOp;
+			fBestCyclesPerOp = (f64)qwCycles / pBench->dwOpsPerBatch;
+		}
+	}
+	std::nth_element( batchNsPerOp, batchNsPerOp + dwBatches / 2, batchNsPerOp + dwBatches );
+	pResult->pName = pBench->pName;
+	pResult->pGroup = pBench->pGroup;
+	pResult->qwOps = (u64)dwBatches * pBench->dwOpsPerBatch;
+	pResult->fNsPerOp = fBestNsPerOp;
+	pResult->fMedianNsPerOp = batchNsPerOp[dwBatches / 2];
+	pResult->fCyclesPerOp = fBestCyclesPerOp;
+	pResult->fMopsPerSec = 1e3 / fBestNsPerOp;
+	pResult->fBytesPerSec = pBench->dwBytesPerOp * 1e9 / fBestNsPerOp;
+}
+
+//one result per line so --compare can read it back without a json parser
+bool WriteMicroBenchJson( const char *pPath, const MicroBenchResult *pResults, u32 dwCount, u32 dwWorkers, f64 fTscGhz )
+{
+	FILE *pFile = strcmp( pPath, "-" ) == 0 ? stdout : fopen( pPath, "w" );
+	if( !pFile )
+	{
+		return false;
+	}
+	fprintf( pFile, "{\n\t\"suite\": \"MicroBench\",\n\t\"timestamp\": %llu,\n\t\"compiler\": \"%s\",\n\t\"avx2\": %s,\n\t\"workers\": %u,\n\t\"tsc_ghz\": %.4f,\n\t\"results\":\n\t[\n",
+			 (unsigned long long)time( NULL ), MICRO_COMPILER,
+#if defined(__AVX2__)
+			 "true",
+#else
+			 "false",
+#endif
+			 dwWorkers, fTscGhz );
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		const MicroBenchResult *pResult = &pResults[dwIdx];
+		fprintf( pFile, "\t\t{ \"name\": \"%s\", \"group\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.4f, \"ns_per_op_median\": %.4f, \"cycles_per_op\": %.3f, \"mops_per_sec\": %.3f, \"bytes_per_sec\": %.0f }%s\n",
+				 pResult->pName, pResult->pGroup, (unsigned long long)pResult->qwOps, pResult->fNsPerOp, pResult->fMedianNsPerOp, pResult->fCyclesPerOp,
+				 pResult->fMopsPerSec, pResult->fBytesPerSec, dwIdx + 1 < dwCount ? "," : "" );
+	}
+	fprintf( pFile, "\t]\n}\n" );
+	if( pFile != stdout )
+	{
+		fclose( pFile );
+	}
+	return true;
+}
+
+//best ns/op against a --json file of an earlier run, returns the number of routines more than fThreshold percent slower
+u32 CompareMicroBenchJson( const char *pPath, const MicroBenchResult *pResults, u32 dwCount, f64 fThreshold )
+{
+	FILE *pFile = fopen( pPath, "r" );
+	if( !pFile )
+	{
+		printf( "Failed to open baseline %s!\n", pPath );
+		return 0;
+	}
+	printf( "\nagainst %s (regression above %.1f%%)\n", pPath, fThreshold );
+	printf( "%-42s %12s %12s %9s\n", "routine", "baseline ns", "now ns", "change" );
+	u32 dwRegressions = 0;
+	char line[1024];
+	while( fgets( line, sizeof(line), pFile ) )
+	{
+		const char *pName = strstr( line, "\"name\": \"" );
+		const char *pNs = strstr( line, "\"ns_per_op\": " );
+		if( !pName || !pNs )
+		{
+			continue;
+		}
+		pName += strlen( "\"name\": \"" );
+		const char *pNameEnd = strchr( pName, '"' );
+		f64 fBaselineNs;
+		if( !pNameEnd || sscanf( pNs + strlen( "\"ns_per_op\": " ), "%lf", &fBaselineNs ) != 1 )
+		{
+			continue;
+		}
+		for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+		{
+			if( strlen( pResults[dwIdx].pName ) == (size_t)( pNameEnd - pName ) && strncmp( pResults[dwIdx].pName, pName, pNameEnd - pName ) == 0 )
+			{
+				const f64 fChange = ( pResults[dwIdx].fNsPerOp / fBaselineNs - 1.0 ) * 100.0;
+				const bool bRegressed = fChange > fThreshold;
+				dwRegressions += bRegressed;
+				printf( "%-42s %12.3f %12.3f %+8.1f%% %s\n", pResults[dwIdx].pName, fBaselineNs, pResults[dwIdx].fNsPerOp, fChange, bRegressed ? "REGRESSED" : "" );
+			}
+		}
+	}
+	fclose( pFile );
+	return dwRegressions;
+}
+
+int main( int argc, char **argv )
+{
+	const char *pFilter = NULL;
+	const char *pJsonPath = NULL;
+	const char *pComparePath = NULL;
+	u64 qwMinNs = MICRO_DEFAULT_MIN_MS * 1000000ull;
+	u32 dwWorkers = 0;
+	f64 fThreshold = MICRO_DEFAULT_THRESHOLD;
+	for( int dwArg = 1; dwArg + 1 < argc; dwArg += 2 )
+	{
+		if( strcmp( argv[dwArg], "--filter" ) == 0 )
+		{
+			pFilter = argv[dwArg + 1];
+		}
+		else if( strcmp( argv[dwArg], "--min-ms" ) == 0 )
+		{
+			qwMinNs = strtoull( argv[dwArg + 1], NULL, 10 ) * 1000000ull;
+		}
+		else if( strcmp( argv[dwArg], "--workers" ) == 0 )
+		{
+			dwWorkers = (u32)strtoul( argv[dwArg + 1], NULL, 10 );
+		}
+		else if( strcmp( argv[dwArg], "--json" ) == 0 )
+		{
+			pJsonPath = argv[dwArg + 1];
+		}
+		else if( strcmp( argv[dwArg], "--compare" ) == 0 )
+		{
+			pComparePath = argv[dwArg + 1];
+		}
+		else if( strcmp( argv[dwArg], "--threshold" ) == 0 )
+		{
+			fThreshold = strtod( argv[dwArg + 1], NULL );
+		}
+	}
+
+	MicroBenchContext *pContext = new MicroBenchContext;
+	pContext->pData = (MicroBenchData*)malloc( sizeof(MicroBenchData) );
+	pContext->pDevice = new CpuComputeDevice;
+	pContext->pOut = (ModelOutData*)malloc( (u64)MICRO_READBACK_GROUPS * sizeof(ModelOutData) );
+	pContext->pReadback = (ModelOutData*)malloc( (u64)MICRO_READBACK_GROUPS * sizeof(ModelOutData) );
+	if( !pContext->pData || !pContext->pOut || !pContext->pReadback || !InitCpuComputeDevice( pContext->pDevice, dwWorkers ) )
+	{
+		printf( "Failed to create cpu compute device!\n" );
+		return -1;
+	}
+	InitMicroBenchData( pContext->pData );
+	InitCpuQueue( &pContext->queue );
+	InitCpuFence( &pContext->fence, 0 );
+	pContext->qwFenceValue = 0;
+	InitComputeShaderMainCpuKernel( &pContext->mainKernel );
+	memset( &pContext->writeKernel, 0, sizeof(CpuComputeKernel) );
+	pContext->writeKernel.pfnGroup = MicroWriteGroupCpu;
+	pContext->writeKernel.dwNumThreads[0] = 1;
+	pContext->writeKernel.dwNumThreads[1] = 1;
+	pContext->writeKernel.dwNumThreads[2] = 1;
+	memset( &pContext->root, 0, sizeof(CpuComputeRootArgs) );
+	pContext->root.pOut = pContext->pOut;
+	pContext->root.qwOutCount = MICRO_READBACK_GROUPS;
+
+	const f64 fTscGhz = MeasureTscGhz();
+	printf( "MicroBench, %u workers, rdtsc %.3f GHz (cycles are rdtsc reference cycles)\n", pContext->pDevice->dwNumWorkers, fTscGhz );
+	printf( "%-42s %10s %10s %10s %12s %12s\n", "routine", "ns/op", "median", "cycles/op", "Mops/s", "MB/s" );
+
+	static MicroBenchResult results[MICRO_MAX_RESULTS];
+	u32 dwResultCount = 0;
+	for( u32 dwBench = 0; dwBench < sizeof(microBenches) / sizeof(microBenches[0]); ++dwBench )
+	{
+		const MicroBench *pBench = &microBenches[dwBench];
+		if( pFilter && !strstr( pBench->pName, pFilter ) )
+		{
+			continue;
+		}
+		MicroBenchResult *pResult = &results[dwResultCount++];
+		RunMicroBench( pContext, pBench, qwMinNs, pResult );
+		printf( "%-42s %10.3f %10.3f %10.2f %12.2f", pResult->pName, pResult->fNsPerOp, pResult->fMedianNsPerOp, pResult->fCyclesPerOp, pResult->fMopsPerSec );
+		if( pBench->dwBytesPerOp )
+		{
+			printf( " %12.1f", pResult->fBytesPerSec / 1e6 );
+		}
+		printf( "\n" );
+	}
+
+	//keeps the outputs alive so the compiler cannot drop the stores
+	f32 fChecksum = 0.f;
+	for( u32 dwIdx = 0; dwIdx < MICRO_ELEMENTS; ++dwIdx )
+	{
+		fChecksum += pContext->pData->matsOut[dwIdx].m[0][0] + pContext->pData->vecsOut[dwIdx].x + pContext->pData->quatsOut[dwIdx].w +
+					 pContext->pData->fScalarsOut[dwIdx] + pContext->pData->mats3x4Out[dwIdx].m[0][0] + pContext->pData->planesOut[dwIdx][0].x;
+	}
+	printf( "checksum %g %u\n", fChecksum, pContext->pReadback[0].dwData[0] );
+
+	int iResult = 0;
+	if( pJsonPath && !WriteMicroBenchJson( pJsonPath, results, dwResultCount, pContext->pDevice->dwNumWorkers, fTscGhz ) )
+	{
+		printf( "Failed to write %s!\n", pJsonPath );
+		iResult = -1;
+	}
+	if( pComparePath && CompareMicroBenchJson( pComparePath, results, dwResultCount, fThreshold ) > 0 )
+	{
+		iResult = 1;
+	}
+
+	DestroyCpuQueue( &pContext->queue );
+	DestroyCpuComputeDevice( pContext->pDevice );
+	delete pContext->pDevice;
+	free( pContext->pData );
+	free( pContext->pOut );
+	free( pContext->pReadback );
+	delete pContext;
+	return iResult;
+}
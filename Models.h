@@ -0,0 +1,123 @@
+#ifndef MODELS_H
+#define MODELS_H
+
+#include "Common.h"
+
+//built in meshes, shared by UploadModels() and the cpu backend so both see the same verticesAndIndices
+//vertex layout is position3, normal3, color4 (40 bytes), indices are R32_UINT
+#define MODEL_VERTEX_STRIDE (3*sizeof(f32) + 3*sizeof(f32) + 4*sizeof(f32))
+
+#define BUILTIN_MESH_PLANE 0
+#define BUILTIN_MESH_CUBE 1
+#define BUILTIN_MESH_COUNT 2
+
+//a mesh laid out the way it is uploaded, vertices immediately followed by R32_UINT indices in one allocation
+typedef struct MeshData
+{
+	u8 *pVertices;
+	u32 *pIndices;
+	u32 dwVertexCount;
+	u32 dwVertexStride;
+	u32 dwIndexCount;
+} MeshData;
+
+inline
+u64 MeshDataVertexSize( const MeshData *pMesh )
+{
+	return (u64)pMesh->dwVertexCount * pMesh->dwVertexStride;
+}
+
+inline
+u64 MeshDataSize( const MeshData *pMesh )
+{
+	return MeshDataVertexSize( pMesh ) + (u64)pMesh->dwIndexCount * sizeof(u32);
+}
+
+static const f32 planeVertices[] =
+{
+        // positions              // vertex norms    // vertex colors
+         1000.0f,  -1.0f,  1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+        -1000.0f,  -1.0f,  1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+         1000.0f,  -1.0f, -1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+        -1000.0f,  -1.0f, -1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+         1000.0f,  -1.0f,  1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+        -1000.0f,  -1.0f,  1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+         1000.0f,  -1.0f, -1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
+        -1000.0f,  -1.0f, -1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f
+};
+
+static const u32 planeIndices[] = 
+{
+        0, 1, 2,
+        2, 1, 3,
+        4, 6, 5,
+        6, 7, 5
+};
+
+static const f32 cubeVertices[] = {
+    // positions          // vertex norms     //vertex colors
+    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f
+};
+
+static const u32 cubeIndicies[] =
+{
+     0,  1,  2, //back
+     3,  4,  5,
+
+     6,  7,  8,
+     9, 10, 11,
+
+    12, 13, 14,
+    15, 16, 17,
+
+    18, 20, 19,
+    21, 23, 22,
+
+    24, 25, 26, //bottom
+    27, 28, 29,
+
+    30, 31, 32, //top
+    33, 34, 35
+};
+
+#endif
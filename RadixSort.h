@@ -0,0 +1,325 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+//cpu version of RadixSort.hlsl, LSD radix sort of u32/u64 keys with optional u32 payloads in the same buffer layout
+//(RWStructuredBuffer<uint>, u64 keys as low/high pairs) with the same root constants: first key, key count, digit shift, RADIX_FLAG_*
+//the passes are the same three dispatches but the cpu blocks are RADIX_CPU_TILE keys so the histogram scan stays small,
+//digits are pulled out 8 keys at a time with AVX2 and a pass where every key has the same digit is skipped
+//the result is the same on both backends since a stable sort has only one answer
+
+#include "Common.h"
+#include "CpuCompute.h"
+#include "Scan.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define RADIX_THREADS 256
+#define RADIX_KEYS_PER_THREAD 8
+#define RADIX_BLOCK_SIZE 2048 //RADIX_THREADS * RADIX_KEYS_PER_THREAD, gpu
+#define RADIX_DIGITS 256
+#define RADIX_FLAG_KEY64 1    //keys are (low, high) uint pairs
+#define RADIX_FLAG_PAYLOAD 2
+#define RADIX_MAX_COUNT ( 65535u * RADIX_BLOCK_SIZE )
+
+#define RADIX_CPU_TILE 16384 //keys per cpu group, its digits fit in groupshared
+
+//t0 and u0..u4 of RadixSort.hlsl, pPayload/pPayloadAlt are NULL without payloads
+typedef struct RadixSortBuffers
+{
+	u32 *pKeys;
+	u32 *pPayload;
+	u32 *pKeysAlt;          //ping pong, sized like pKeys/pPayload
+	u32 *pPayloadAlt;
+	u32 *pBlockHistograms;  //RadixHistogramCount() u32s
+	u32 *pDigitOffsets;     //RadixHistogramCount() u32s
+	u8 *pScanPartials;      //RadixScanScratchSize() bytes
+} RadixSortBuffers;
+
+typedef struct RadixSortKernels
+{
+	CpuComputeKernel upsweep;
+	CpuComputeKernel scatter;
+	ScanKernels scan;
+} RadixSortKernels;
+
+typedef struct RadixSortStats
+{
+	u32 dwPasses;
+	u32 dwSkippedPasses; //every key had the same digit
+} RadixSortStats;
+
+//histogram entries for dwCount keys split in blocks of dwBlockSize (RADIX_BLOCK_SIZE on the gpu, RADIX_CPU_TILE here)
+inline
+u32 RadixHistogramCount( u32 dwCount, u32 dwBlockSize )
+{
+	return RADIX_DIGITS * ( ( dwCount + dwBlockSize - 1 ) / dwBlockSize );
+}
+
+inline
+u64 RadixScanScratchSize( u32 dwCount, u32 dwBlockSize )
+{
+	return ScanScratchSize( RadixHistogramCount( dwCount, dwBlockSize ) );
+}
+
+inline
+ComputeShaderCB MakeRadixSortCB( u32 dwFirst, u32 dwCount, u32 dwShift, u32 dwFlags )
+{
+	ComputeShaderCB cb;
+	cb.dwOffsetsAndStrides0[0] = dwFirst;
+	cb.dwOffsetsAndStrides0[1] = dwCount;
+	cb.dwOffsetsAndStrides0[2] = dwShift;
+	cb.dwOffsetsAndStrides0[3] = dwFlags;
+	return cb;
+}
+
+//digits of keys [dwBegin, dwEnd) of the dispatch into pDigits
+inline
+void RadixExtractDigits( const CpuComputeRootArgs *pRoot, u32 dwBegin, u32 dwEnd, u8 *pDigits )
+{
+	const u32 *pCB = pRoot->cb.dwOffsetsAndStrides0;
+	const u32 dwShift = pCB[2] & 31;
+	const u32 *pWords;
+	u32 dwStride = 1;
+	if( pCB[3] & RADIX_FLAG_KEY64 )
+	{
+		pWords = (const u32*)pRoot->pUavs[0] + ( (u64)pCB[0] + dwBegin ) * 2 + ( pCB[2] >= 32 );
+		dwStride = 2;
+	}
+	else
+	{
+		pWords = (const u32*)pRoot->pUavs[0] + pCB[0] + dwBegin;
+	}
+	const u32 dwCount = dwEnd - dwBegin;
+	u32 dwKey = 0;
+#if defined(__AVX2__)
+	const __m128i shift = _mm_cvtsi32_si128( (int)dwShift );
+	const __m256i mask = _mm256_set1_epi32( RADIX_DIGITS - 1 );
+	//packs the low byte of every lane, lanes 0-3 and 4-7 end up in the first dword of each 128 bit half
+	const __m256i packBytes = _mm256_setr_epi8( 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+												0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+	if( dwStride == 2 )
+	{
+		const __m256i index = _mm256_setr_epi32( 0, 2, 4, 6, 8, 10, 12, 14 );
+		for( ; dwKey + 8 <= dwCount; dwKey += 8 )
+		{
+			__m256i words = _mm256_i32gather_epi32( (const int*)( pWords + dwKey * 2 ), index, 4 );
+			__m256i digits = _mm256_shuffle_epi8( _mm256_and_si256( _mm256_srl_epi32( words, shift ), mask ), packBytes );
+			u32 dwLow = (u32)_mm256_extract_epi32( digits, 0 );
+			u32 dwHigh = (u32)_mm256_extract_epi32( digits, 4 );
+			memcpy( pDigits + dwKey, &dwLow, 4 );
+			memcpy( pDigits + dwKey + 4, &dwHigh, 4 );
+		}
+	}
+	else
+	{
+		for( ; dwKey + 8 <= dwCount; dwKey += 8 )
+		{
+			__m256i words = _mm256_loadu_si256( (const __m256i*)( pWords + dwKey ) );
+			__m256i digits = _mm256_shuffle_epi8( _mm256_and_si256( _mm256_srl_epi32( words, shift ), mask ), packBytes );
+			u32 dwLow = (u32)_mm256_extract_epi32( digits, 0 );
+			u32 dwHigh = (u32)_mm256_extract_epi32( digits, 4 );
+			memcpy( pDigits + dwKey, &dwLow, 4 );
+			memcpy( pDigits + dwKey + 4, &dwHigh, 4 );
+		}
+	}
+#endif
+	for( ; dwKey < dwCount; ++dwKey )
+	{
+		pDigits[dwKey] = (u8)( pWords[(u64)dwKey * dwStride] >> dwShift );
+	}
+}
+
+//keys of tile dwTile
+inline
+u32 RadixTileRange( const CpuComputeRootArgs *pRoot, u32 dwTile, u32 *pEnd )
+{
+	const u32 dwCount = pRoot->cb.dwOffsetsAndStrides0[1];
+	const u32 dwBegin = dwTile * RADIX_CPU_TILE;
+	*pEnd = dwCount - dwBegin < RADIX_CPU_TILE ? dwCount : dwBegin + RADIX_CPU_TILE;
+	return dwBegin;
+}
+
+//RadixUpsweep in RadixSort.hlsl
+inline
+void RadixUpsweepCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	u8 *pDigits = (u8*)pGroupShared;
+	u32 dwEnd;
+	const u32 dwBegin = RadixTileRange( pRoot, Gid.x, &dwEnd );
+	RadixExtractDigits( pRoot, dwBegin, dwEnd, pDigits );
+
+	//4 tables so runs of the same digit don't stall on one counter
+	u32 counts[4][RADIX_DIGITS];
+	memset( counts, 0, sizeof(counts) );
+	const u32 dwCount = dwEnd - dwBegin;
+	u32 dwKey = 0;
+	for( ; dwKey + 4 <= dwCount; dwKey += 4 )
+	{
+		++counts[0][pDigits[dwKey]];
+		++counts[1][pDigits[dwKey + 1]];
+		++counts[2][pDigits[dwKey + 2]];
+		++counts[3][pDigits[dwKey + 3]];
+	}
+	for( ; dwKey < dwCount; ++dwKey )
+	{
+		++counts[0][pDigits[dwKey]];
+	}
+	const u32 dwTiles = RadixHistogramCount( pRoot->cb.dwOffsetsAndStrides0[1], RADIX_CPU_TILE ) / RADIX_DIGITS;
+	u32 *pHistograms = (u32*)pRoot->pUavs[4];
+	for( u32 dwDigit = 0; dwDigit < RADIX_DIGITS; ++dwDigit )
+	{
+		pHistograms[dwDigit * dwTiles + Gid.x] = counts[0][dwDigit] + counts[1][dwDigit] + counts[2][dwDigit] + counts[3][dwDigit];
+	}
+}
+
+//RadixScatter in RadixSort.hlsl, a tile is walked in order so the ranks come out stable without the bit splits
+inline
+void RadixScatterCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	u8 *pDigits = (u8*)pGroupShared;
+	u32 dwEnd;
+	const u32 dwBegin = RadixTileRange( pRoot, Gid.x, &dwEnd );
+	RadixExtractDigits( pRoot, dwBegin, dwEnd, pDigits );
+
+	const u32 *pCB = pRoot->cb.dwOffsetsAndStrides0;
+	const u32 dwTiles = RadixHistogramCount( pCB[1], RADIX_CPU_TILE ) / RADIX_DIGITS;
+	const u32 *pDigitOffsets = (const u32*)pRoot->pVerticesAndIndices;
+	u32 offsets[RADIX_DIGITS];
+	for( u32 dwDigit = 0; dwDigit < RADIX_DIGITS; ++dwDigit )
+	{
+		offsets[dwDigit] = pDigitOffsets[dwDigit * dwTiles + Gid.x];
+	}
+
+	const u32 dwFirst = pCB[0];
+	const u32 dwCount = dwEnd - dwBegin;
+	if( pCB[3] & RADIX_FLAG_KEY64 )
+	{
+		const u64 *pKeysIn = (const u64*)pRoot->pUavs[0] + dwFirst + dwBegin;
+		u64 *pKeysOut = (u64*)pRoot->pUavs[2] + dwFirst;
+		for( u32 dwKey = 0; dwKey < dwCount; ++dwKey )
+		{
+			pKeysOut[offsets[pDigits[dwKey]]++] = pKeysIn[dwKey];
+		}
+	}
+	else
+	{
+		const u32 *pKeysIn = (const u32*)pRoot->pUavs[0] + dwFirst + dwBegin;
+		u32 *pKeysOut = (u32*)pRoot->pUavs[2] + dwFirst;
+		for( u32 dwKey = 0; dwKey < dwCount; ++dwKey )
+		{
+			pKeysOut[offsets[pDigits[dwKey]]++] = pKeysIn[dwKey];
+		}
+	}
+	if( pCB[3] & RADIX_FLAG_PAYLOAD )
+	{
+		//the offsets moved past this tile's keys, walk back to where they started
+		for( u32 dwDigit = 0; dwDigit < RADIX_DIGITS; ++dwDigit )
+		{
+			offsets[dwDigit] = pDigitOffsets[dwDigit * dwTiles + Gid.x];
+		}
+		const u32 *pPayloadIn = (const u32*)pRoot->pUavs[1] + dwFirst + dwBegin;
+		u32 *pPayloadOut = (u32*)pRoot->pUavs[3] + dwFirst;
+		for( u32 dwKey = 0; dwKey < dwCount; ++dwKey )
+		{
+			pPayloadOut[offsets[pDigits[dwKey]]++] = pPayloadIn[dwKey];
+		}
+	}
+}
+
+inline
+void InitRadixSortKernels( RadixSortKernels *pKernels )
+{
+	memset( &pKernels->upsweep, 0, sizeof(CpuComputeKernel) );
+	pKernels->upsweep.pfnGroup = RadixUpsweepCpu;
+	pKernels->upsweep.dwNumThreads[0] = RADIX_THREADS;
+	pKernels->upsweep.dwNumThreads[1] = 1;
+	pKernels->upsweep.dwNumThreads[2] = 1;
+	pKernels->upsweep.dwGroupSharedSize = RADIX_CPU_TILE; //the tile's digits
+	pKernels->scatter = pKernels->upsweep;
+	pKernels->scatter.pfnGroup = RadixScatterCpu;
+	InitScanKernels( &pKernels->scan );
+}
+
+//sorts keys [dwFirst, dwFirst + dwCount) of pBuffers->pKeys (and their payloads) in place, the same passes as RecordRadixSort() in main.cpp
+//pStats can be NULL
+inline
+void CpuRadixSort( CpuComputeDevice *pDevice, const RadixSortKernels *pKernels, const RadixSortBuffers *pBuffers, u32 dwFirst, u32 dwCount, bool bKey64,
+				   RadixSortStats *pStats = NULL )
+{
+	const u32 dwTiles = RadixHistogramCount( dwCount, RADIX_CPU_TILE ) / RADIX_DIGITS;
+	const u32 dwFlags = ( bKey64 ? RADIX_FLAG_KEY64 : 0 ) | ( pBuffers->pPayload ? RADIX_FLAG_PAYLOAD : 0 );
+	const u32 dwKeyWords = bKey64 ? 2 : 1;
+
+	u32 *pKeysIn = pBuffers->pKeys;
+	u32 *pPayloadIn = pBuffers->pPayload;
+	u32 *pKeysOut = pBuffers->pKeysAlt;
+	u32 *pPayloadOut = pBuffers->pPayloadAlt;
+
+	CpuComputeRootArgs scanRoot;
+	memset( &scanRoot, 0, sizeof(CpuComputeRootArgs) );
+	scanRoot.cb = MakeScanCB( 0, dwTiles * RADIX_DIGITS, SCAN_NO_SEGMENTS, 0 );
+	scanRoot.pVerticesAndIndices = (const u8*)pBuffers->pBlockHistograms;
+	scanRoot.qwVerticesAndIndicesSize = (u64)dwTiles * RADIX_DIGITS * sizeof(u32);
+	scanRoot.pUavs[0] = (u8*)pBuffers->pDigitOffsets;
+	scanRoot.pUavs[1] = pBuffers->pScanPartials;
+
+	RadixSortStats stats = { 0, 0 };
+	for( u32 dwShift = 0; dwShift < ( bKey64 ? 64u : 32u ); dwShift += 8 )
+	{
+		CpuComputeRootArgs root;
+		memset( &root, 0, sizeof(CpuComputeRootArgs) );
+		root.cb = MakeRadixSortCB( dwFirst, dwCount, dwShift, dwFlags );
+		root.pVerticesAndIndices = (const u8*)pBuffers->pDigitOffsets;
+		root.qwVerticesAndIndicesSize = (u64)dwTiles * RADIX_DIGITS * sizeof(u32);
+		root.pUavs[0] = (u8*)pKeysIn;
+		root.pUavs[1] = (u8*)pPayloadIn;
+		root.pUavs[2] = (u8*)pKeysOut;
+		root.pUavs[3] = (u8*)pPayloadOut;
+		root.pUavs[4] = (u8*)pBuffers->pBlockHistograms;
+
+		++stats.dwPasses;
+		CpuDispatch( pDevice, &pKernels->upsweep, &root, dwTiles, 1, 1 );
+		CpuScan( pDevice, &pKernels->scan, &scanRoot );
+
+		//a digit that starts at 0 and ends at dwCount holds every key, the scatter would be a copy
+		bool bSkip = false;
+		for( u32 dwDigit = 0; dwDigit < RADIX_DIGITS && dwCount > 0 && !bSkip; ++dwDigit )
+		{
+			const u32 dwDigitEnd = dwDigit + 1 < RADIX_DIGITS ? pBuffers->pDigitOffsets[( dwDigit + 1 ) * dwTiles] : dwCount;
+			bSkip = pBuffers->pDigitOffsets[dwDigit * dwTiles] == 0 && dwDigitEnd == dwCount;
+		}
+		if( bSkip )
+		{
+			++stats.dwSkippedPasses;
+			continue;
+		}
+
+		CpuDispatch( pDevice, &pKernels->scatter, &root, dwTiles, 1, 1 );
+		u32 *pSwap = pKeysIn;
+		pKeysIn = pKeysOut;
+		pKeysOut = pSwap;
+		pSwap = pPayloadIn;
+		pPayloadIn = pPayloadOut;
+		pPayloadOut = pSwap;
+	}
+
+	//an odd number of scatters leaves the result in the alt buffers
+	if( pKeysIn != pBuffers->pKeys )
+	{
+		memcpy( pBuffers->pKeys + (u64)dwFirst * dwKeyWords, pKeysIn + (u64)dwFirst * dwKeyWords, (u64)dwCount * dwKeyWords * sizeof(u32) );
+		if( pBuffers->pPayload )
+		{
+			memcpy( pBuffers->pPayload + dwFirst, pPayloadIn + dwFirst, (u64)dwCount * sizeof(u32) );
+		}
+	}
+	if( pStats )
+	{
+		*pStats = stats;
+	}
+}
+
+#endif
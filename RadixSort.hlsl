@@ -0,0 +1,175 @@
+//cs_5_0 way
+//LSD radix sort of u32/u64 keys with optional u32 payloads, 8 bits per pass, every pass is three dispatches:
+//RadixUpsweep  one group per RADIX_BLOCK_SIZE keys, counts the block's digits into BlockHistograms (digit major)
+//Scan.hlsl     an exclusive scan of BlockHistograms into DigitOffsets gives every (digit, block) its first output slot
+//RadixScatter  one group per block, ranks its keys stably by digit and writes them to their slots
+//onesweep chains the blocks with a decoupled look-back instead of the scan, that needs groups to make forward progress
+//while they spin on each other which cs_5_0 does not promise, so the digit offsets come from the scan library instead
+//RadixSort.h is the cpu version
+cbuffer globalCB : register(b0)
+{
+    uint4 dwOffsetsAndStrides0; //x first key, y key count, z digit shift (0, 8, .. 56), w RADIX_FLAG_*
+};
+
+#define RADIX_THREADS 256
+#define RADIX_KEYS_PER_THREAD 8
+#define RADIX_BLOCK_SIZE 2048 //RADIX_THREADS * RADIX_KEYS_PER_THREAD
+#define RADIX_DIGITS 256
+#define RADIX_FLAG_KEY64 1    //keys are (low, high) uint pairs
+#define RADIX_FLAG_PAYLOAD 2
+
+ByteAddressBuffer DigitOffsets : register( t0 );        //scan of BlockHistograms
+RWStructuredBuffer<uint> KeysIn : register( u0 );
+RWStructuredBuffer<uint> PayloadIn : register( u1 );
+RWStructuredBuffer<uint> KeysOut : register( u2 );
+RWStructuredBuffer<uint> PayloadOut : register( u3 );
+RWByteAddressBuffer BlockHistograms : register( u4 ); //RADIX_DIGITS * block count u32s, [digit * block count + block]
+
+#define RADIX_ROOT_SIGNATURE "RootFlags( 0 ), RootConstants( num32BitConstants=4, b0, space = 0, visibility=SHADER_VISIBILITY_ALL ), SRV(t0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u1, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u2, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u3, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u4, space=0, visibility=SHADER_VISIBILITY_ALL)"
+
+groupshared uint radixDigitCounts[RADIX_DIGITS];
+groupshared uint radixSums[RADIX_THREADS];
+groupshared uint radixRanked[RADIX_BLOCK_SIZE]; //digit << 16 | index in the block
+
+uint RadixBlockCount()
+{
+	return ( dwOffsetsAndStrides0.y + RADIX_BLOCK_SIZE - 1 ) / RADIX_BLOCK_SIZE;
+}
+
+uint RadixKeyDigit( uint dwKey )
+{
+	const uint dwIndex = dwOffsetsAndStrides0.x + dwKey;
+	const uint dwWord = ( dwOffsetsAndStrides0.w & RADIX_FLAG_KEY64 ) ? dwIndex * 2 + ( dwOffsetsAndStrides0.z >= 32 ) : dwIndex;
+	return ( KeysIn[dwWord] >> ( dwOffsetsAndStrides0.z & 31 ) ) & ( RADIX_DIGITS - 1 );
+}
+
+uint RadixGroupInclusiveSum( uint dwValue, uint GI )
+{
+	radixSums[GI] = dwValue;
+	GroupMemoryBarrierWithGroupSync();
+	[unroll]
+	for( uint dwOffset = 1; dwOffset < RADIX_THREADS; dwOffset <<= 1 )
+	{
+		//an if and not ?:, fxc evaluates both sides of ?: and GI - dwOffset wraps past the end of radixSums
+		uint dwPrev = 0;
+		if( GI >= dwOffset )
+		{
+			dwPrev = radixSums[GI - dwOffset];
+		}
+		GroupMemoryBarrierWithGroupSync();
+		dwValue += dwPrev;
+		radixSums[GI] = dwValue;
+		GroupMemoryBarrierWithGroupSync();
+	}
+	return dwValue;
+}
+
+[RootSignature(RADIX_ROOT_SIGNATURE)]
+[numthreads(RADIX_THREADS, 1, 1)]
+void RadixUpsweep( uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex )
+{
+	radixDigitCounts[GI] = 0;
+	GroupMemoryBarrierWithGroupSync();
+	//strided so neighbouring threads load neighbouring keys, the order does not matter for a count
+	[unroll]
+	for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+	{
+		const uint dwIndex = Gid.x * RADIX_BLOCK_SIZE + dwKey * RADIX_THREADS + GI;
+		if( dwIndex < dwOffsetsAndStrides0.y )
+		{
+			InterlockedAdd( radixDigitCounts[RadixKeyDigit( dwIndex )], 1 );
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+	BlockHistograms.Store( ( GI * RadixBlockCount() + Gid.x ) * 4, radixDigitCounts[GI] );
+}
+
+[RootSignature(RADIX_ROOT_SIGNATURE)]
+[numthreads(RADIX_THREADS, 1, 1)]
+void RadixScatter( uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex )
+{
+	const uint dwBlockFirst = Gid.x * RADIX_BLOCK_SIZE;
+	const uint dwBlockKeys = min( RADIX_BLOCK_SIZE, dwOffsetsAndStrides0.y - dwBlockFirst );
+
+	//every thread owns RADIX_KEYS_PER_THREAD consecutive keys, padding gets digit 0xFF and stays behind the real keys
+	radixDigitCounts[GI] = 0;
+	GroupMemoryBarrierWithGroupSync();
+	uint entries[RADIX_KEYS_PER_THREAD];
+	[unroll]
+	for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+	{
+		const uint dwLocal = GI * RADIX_KEYS_PER_THREAD + dwKey;
+		uint dwDigit = RADIX_DIGITS - 1;
+		if( dwLocal < dwBlockKeys )
+		{
+			dwDigit = RadixKeyDigit( dwBlockFirst + dwLocal );
+			InterlockedAdd( radixDigitCounts[dwDigit], 1 );
+		}
+		entries[dwKey] = ( dwDigit << 16 ) | dwLocal;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	const uint dwDigitCount = radixDigitCounts[GI];
+	const uint dwDigitStart = RadixGroupInclusiveSum( dwDigitCount, GI ) - dwDigitCount;
+	radixDigitCounts[GI] = dwDigitStart;
+
+	//stable rank inside the block, one split per digit bit
+	[unroll]
+	for( uint dwBit = 16; dwBit < 24; ++dwBit )
+	{
+		uint dwZeros = 0;
+		[unroll]
+		for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+		{
+			dwZeros += ( ( entries[dwKey] >> dwBit ) & 1 ) ^ 1;
+		}
+		uint dwZerosBefore = RadixGroupInclusiveSum( dwZeros, GI ) - dwZeros;
+		const uint dwTotalZeros = radixSums[RADIX_THREADS - 1];
+		[unroll]
+		for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+		{
+			const uint dwPos = GI * RADIX_KEYS_PER_THREAD + dwKey;
+			if( ( entries[dwKey] >> dwBit ) & 1 )
+			{
+				radixRanked[dwTotalZeros + dwPos - dwZerosBefore] = entries[dwKey];
+			}
+			else
+			{
+				radixRanked[dwZerosBefore++] = entries[dwKey];
+			}
+		}
+		GroupMemoryBarrierWithGroupSync();
+		[unroll]
+		for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+		{
+			entries[dwKey] = radixRanked[GI * RADIX_KEYS_PER_THREAD + dwKey];
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	const uint dwBlockCount = RadixBlockCount();
+	[unroll]
+	for( uint dwKey = 0; dwKey < RADIX_KEYS_PER_THREAD; ++dwKey )
+	{
+		const uint dwPos = GI * RADIX_KEYS_PER_THREAD + dwKey;
+		const uint dwLocal = entries[dwKey] & 0xFFFF;
+		if( dwLocal < dwBlockKeys )
+		{
+			const uint dwDigit = entries[dwKey] >> 16;
+			const uint dwDest = dwOffsetsAndStrides0.x + DigitOffsets.Load( ( dwDigit * dwBlockCount + Gid.x ) * 4 ) + dwPos - radixDigitCounts[dwDigit];
+			const uint dwSrc = dwOffsetsAndStrides0.x + dwBlockFirst + dwLocal;
+			if( dwOffsetsAndStrides0.w & RADIX_FLAG_KEY64 )
+			{
+				KeysOut[dwDest * 2] = KeysIn[dwSrc * 2];
+				KeysOut[dwDest * 2 + 1] = KeysIn[dwSrc * 2 + 1];
+			}
+			else
+			{
+				KeysOut[dwDest] = KeysIn[dwSrc];
+			}
+			if( dwOffsetsAndStrides0.w & RADIX_FLAG_PAYLOAD )
+			{
+				PayloadOut[dwDest] = PayloadIn[dwSrc];
+			}
+		}
+	}
+}
@@ -0,0 +1,535 @@
+#ifndef RAY_QUERY_H
+#define RAY_QUERY_H
+
+//cpu version of RayQuery.hlsl, closest hits of a batch of rays against a Bvh.h bvh over a mesh laid out like verticesAndIndices
+//the scalar kernel walks one ray at a time with a short stack, the packet kernel walks 8 consecutive rays together (a node is visited
+//when any of them hits its box) and tests boxes and triangles 8 lanes at a time with AVX2. Both do the triangle math with the same fmas
+//in the same order and equal t goes to the lower triangle index, so they return the same hits. Packets pay off for coherent rays
+//(camera, shadow rays of neighbouring pixels), for incoherent ones the scalar kernel visits fewer nodes
+//root constants: vertex byte offset, index byte offset, ray count, vertex stride. t0 is the mesh, u0 the hits,
+//the cpu root args have one srv so t1..t3 (nodes, parents, rays) go in pUavs[1..3]
+
+#include "Common.h"
+#include "CpuCompute.h"
+#include "Math3D.h"
+#include "Bvh.h"
+#include "TransientPlanner.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define RAY_QUERY_THREADS 64
+#define RAY_QUERY_BOX_SLACK 1.00000024f //grows the far slab distance by 2 ulp so rounding never loses a box a triangle is in
+#define RAY_QUERY_STACK_SIZE 128        //lbvh depth is bounded by the 30 code bits plus the 32 index bits of the tie break
+#define RAY_QUERY_PACKET_SIZE 8
+#define RAY_QUERY_CPU_TILE 1024          //rays per cpu group, a multiple of RAY_QUERY_PACKET_SIZE
+
+//must match the layouts in RayQuery.hlsl
+typedef struct BvhRay
+{
+	f32 fOrigin[3];
+	f32 fTMin;
+	f32 fDir[3];
+	f32 fTMax;
+} BvhRay;
+
+typedef struct BvhHit
+{
+	u32 dwTriangle; //BVH_INVALID_NODE for a miss
+	f32 fT;
+	f32 fU;
+	f32 fV;
+} BvhHit;
+
+typedef struct RayQueryKernels
+{
+	CpuComputeKernel closestHit;
+	CpuComputeKernel closestHitPacket;
+} RayQueryKernels;
+
+inline
+ComputeShaderCB MakeRayQueryCB( u32 dwVertexOffset, u32 dwIndexOffset, u32 dwRayCount, u32 dwVertexStride )
+{
+	ComputeShaderCB cb;
+	cb.dwOffsetsAndStrides0[0] = dwVertexOffset;
+	cb.dwOffsetsAndStrides0[1] = dwIndexOffset;
+	cb.dwOffsetsAndStrides0[2] = dwRayCount;
+	cb.dwOffsetsAndStrides0[3] = dwVertexStride;
+	return cb;
+}
+
+inline
+f32 RayQueryDot( const f32 *a, const f32 *b )
+{
+	return fmaf( a[0], b[0], fmaf( a[1], b[1], a[2] * b[2] ) );
+}
+
+inline
+void RayQueryCross( const f32 *a, const f32 *b, f32 *pOut )
+{
+	pOut[0] = fmaf( a[1], b[2], -( a[2] * b[1] ) );
+	pOut[1] = fmaf( a[2], b[0], -( a[0] * b[2] ) );
+	pOut[2] = fmaf( a[0], b[1], -( a[1] * b[0] ) );
+}
+
+inline
+bool RayQueryHitBox( const BvhNode *pNode, const f32 *pOrigin, const f32 *pInvDir, f32 fTMin, f32 fTMax )
+{
+	f32 fNear = fTMin;
+	f32 fFar = fTMax;
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		const f32 t0 = ( pNode->fMin[dwAxis] - pOrigin[dwAxis] ) * pInvDir[dwAxis];
+		const f32 t1 = ( pNode->fMax[dwAxis] - pOrigin[dwAxis] ) * pInvDir[dwAxis];
+		const f32 fSlabNear = t0 < t1 ? t0 : t1;
+		const f32 fSlabFar = ( t0 > t1 ? t0 : t1 ) * RAY_QUERY_BOX_SLACK;
+		fNear = fSlabNear > fNear ? fSlabNear : fNear;
+		fFar = fSlabFar < fFar ? fSlabFar : fFar;
+	}
+	return fNear <= fFar;
+}
+
+//moller trumbore, keeps the closer hit, equal t goes to the lower triangle index
+inline
+void RayQueryHitTriangle( const CpuComputeRootArgs *pRoot, u32 dwTriangle, const BvhRay *pRay, BvhHit *pHit )
+{
+	const f32 *v0, *v1, *v2;
+	BvhLoadTriangle( pRoot, dwTriangle, &v0, &v1, &v2 );
+	const f32 e1[3] = { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] };
+	const f32 e2[3] = { v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] };
+	f32 p[3];
+	RayQueryCross( pRay->fDir, e2, p );
+	const f32 fDet = RayQueryDot( e1, p );
+	if( fDet == 0.f )
+	{
+		return;
+	}
+	const f32 fInvDet = 1.f / fDet;
+	const f32 s[3] = { pRay->fOrigin[0] - v0[0], pRay->fOrigin[1] - v0[1], pRay->fOrigin[2] - v0[2] };
+	const f32 u = RayQueryDot( s, p ) * fInvDet;
+	f32 q[3];
+	RayQueryCross( s, e1, q );
+	const f32 v = RayQueryDot( pRay->fDir, q ) * fInvDet;
+	const f32 t = RayQueryDot( e2, q ) * fInvDet;
+	if( u >= 0.f && v >= 0.f && u + v <= 1.f && t >= pRay->fTMin && ( t < pHit->fT || ( t == pHit->fT && dwTriangle < pHit->dwTriangle ) ) )
+	{
+		pHit->dwTriangle = dwTriangle;
+		pHit->fT = t;
+		pHit->fU = u;
+		pHit->fV = v;
+	}
+}
+
+//true when the left child of pNode should be visited first for direction pDir
+inline
+bool RayQueryLeftFirst( const BvhNode *pNodes, const BvhNode *pNode, const f32 *pDir )
+{
+	const BvhNode *pLeft = &pNodes[pNode->dwLeft];
+	const BvhNode *pRight = &pNodes[pNode->dwRight];
+	f32 fDot = 0.f;
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		fDot += ( pLeft->fMin[dwAxis] + pLeft->fMax[dwAxis] - pRight->fMin[dwAxis] - pRight->fMax[dwAxis] ) * pDir[dwAxis];
+	}
+	return fDot <= 0.f;
+}
+
+inline
+void RayQueryClosestHitScalar( const CpuComputeRootArgs *pRoot, const BvhNode *pNodes, const BvhRay *pRay, BvhHit *pHit )
+{
+	f32 invDir[3];
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		invDir[dwAxis] = 1.f / pRay->fDir[dwAxis];
+	}
+	pHit->dwTriangle = BVH_INVALID_NODE;
+	pHit->fT = pRay->fTMax;
+	pHit->fU = 0.f;
+	pHit->fV = 0.f;
+
+	u32 stack[RAY_QUERY_STACK_SIZE];
+	u32 dwStackSize = 0;
+	stack[dwStackSize++] = 0;
+	while( dwStackSize )
+	{
+		const BvhNode *pNode = &pNodes[stack[--dwStackSize]];
+		if( !RayQueryHitBox( pNode, pRay->fOrigin, invDir, pRay->fTMin, pHit->fT ) )
+		{
+			continue;
+		}
+		if( pNode->dwLeft & BVH_LEAF_FLAG )
+		{
+			RayQueryHitTriangle( pRoot, pNode->dwLeft & ~BVH_LEAF_FLAG, pRay, pHit );
+			continue;
+		}
+		const bool bLeftFirst = RayQueryLeftFirst( pNodes, pNode, pRay->fDir );
+		stack[dwStackSize++] = bLeftFirst ? pNode->dwRight : pNode->dwLeft;
+		stack[dwStackSize++] = bLeftFirst ? pNode->dwLeft : pNode->dwRight;
+	}
+}
+
+//rays of tile dwTile
+inline
+u32 RayQueryTileRange( const CpuComputeRootArgs *pRoot, u32 dwTile, u32 *pEnd )
+{
+	const u32 dwCount = pRoot->cb.dwOffsetsAndStrides0[2];
+	const u32 dwBegin = dwTile * RAY_QUERY_CPU_TILE;
+	*pEnd = dwCount - dwBegin < RAY_QUERY_CPU_TILE ? dwCount : dwBegin + RAY_QUERY_CPU_TILE;
+	return dwBegin;
+}
+
+//RayQueryClosestHit in RayQuery.hlsl
+inline
+void RayQueryClosestHitCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const BvhNode *pNodes = (const BvhNode*)pRoot->pUavs[1];
+	const BvhRay *pRays = (const BvhRay*)pRoot->pUavs[3];
+	BvhHit *pHits = (BvhHit*)pRoot->pUavs[0];
+	u32 dwEnd;
+	for( u32 dwRay = RayQueryTileRange( pRoot, Gid.x, &dwEnd ); dwRay < dwEnd; ++dwRay )
+	{
+		RayQueryClosestHitScalar( pRoot, pNodes, &pRays[dwRay], &pHits[dwRay] );
+	}
+}
+
+#if defined(__AVX2__)
+//8 float4s dwStride floats apart into x, y, z, w registers
+inline
+void RayQueryTranspose8( const f32 *p, u32 dwStride, __m256 *pX, __m256 *pY, __m256 *pZ, __m256 *pW )
+{
+	const __m256 r0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p ) ), _mm_loadu_ps( p + 4 * dwStride ), 1 );
+	const __m256 r1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + dwStride ) ), _mm_loadu_ps( p + 5 * dwStride ), 1 );
+	const __m256 r2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 2 * dwStride ) ), _mm_loadu_ps( p + 6 * dwStride ), 1 );
+	const __m256 r3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 3 * dwStride ) ), _mm_loadu_ps( p + 7 * dwStride ), 1 );
+	const __m256 t0 = _mm256_unpacklo_ps( r0, r1 );
+	const __m256 t1 = _mm256_unpacklo_ps( r2, r3 );
+	const __m256 t2 = _mm256_unpackhi_ps( r0, r1 );
+	const __m256 t3 = _mm256_unpackhi_ps( r2, r3 );
+	*pX = _mm256_shuffle_ps( t0, t1, 0x44 );
+	*pY = _mm256_shuffle_ps( t0, t1, 0xEE );
+	*pZ = _mm256_shuffle_ps( t2, t3, 0x44 );
+	*pW = _mm256_shuffle_ps( t2, t3, 0xEE );
+}
+
+//8 rays as structure of arrays, the closest hit so far per lane
+typedef struct RayPacket8
+{
+	__m256 origin[3];
+	__m256 dir[3];
+	__m256 invDir[3];
+	__m256 tMin;
+	__m256 bestT;
+	__m256i bestTriangle;
+	__m256 bestU;
+	__m256 bestV;
+} RayPacket8;
+
+inline
+__m256 RayQueryDot8( const __m256 *a, const __m256 *b )
+{
+	return _mm256_fmadd_ps( a[0], b[0], _mm256_fmadd_ps( a[1], b[1], _mm256_mul_ps( a[2], b[2] ) ) );
+}
+
+inline
+void RayQueryCross8( const __m256 *a, const __m256 *b, __m256 *pOut )
+{
+	pOut[0] = _mm256_fmsub_ps( a[1], b[2], _mm256_mul_ps( a[2], b[1] ) );
+	pOut[1] = _mm256_fmsub_ps( a[2], b[0], _mm256_mul_ps( a[0], b[2] ) );
+	pOut[2] = _mm256_fmsub_ps( a[0], b[1], _mm256_mul_ps( a[1], b[0] ) );
+}
+
+//mask of the lanes whose ray hits the box before their closest hit, same ops as RayQueryHitBox()
+inline
+__m256 RayQueryHitBox8( const BvhNode *pNode, const RayPacket8 *pPacket )
+{
+	__m256 tNear = pPacket->tMin;
+	__m256 tFar = pPacket->bestT;
+	const __m256 slack = _mm256_set1_ps( RAY_QUERY_BOX_SLACK );
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		const __m256 t0 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( pNode->fMin[dwAxis] ), pPacket->origin[dwAxis] ), pPacket->invDir[dwAxis] );
+		const __m256 t1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_set1_ps( pNode->fMax[dwAxis] ), pPacket->origin[dwAxis] ), pPacket->invDir[dwAxis] );
+		//_mm256_min_ps( a, b ) is a < b ? a : b, the operand order matches the scalar ternaries
+		const __m256 slabNear = _mm256_blendv_ps( t1, t0, _mm256_cmp_ps( t0, t1, _CMP_LT_OQ ) );
+		const __m256 slabFar = _mm256_mul_ps( _mm256_blendv_ps( t1, t0, _mm256_cmp_ps( t0, t1, _CMP_GT_OQ ) ), slack );
+		tNear = _mm256_blendv_ps( tNear, slabNear, _mm256_cmp_ps( slabNear, tNear, _CMP_GT_OQ ) );
+		tFar = _mm256_blendv_ps( tFar, slabFar, _mm256_cmp_ps( slabFar, tFar, _CMP_LT_OQ ) );
+	}
+	return _mm256_cmp_ps( tNear, tFar, _CMP_LE_OQ );
+}
+
+//same math as RayQueryHitTriangle() for the lanes in active
+inline
+void RayQueryHitTriangle8( const CpuComputeRootArgs *pRoot, u32 dwTriangle, __m256 active, RayPacket8 *pPacket )
+{
+	const f32 *v0, *v1, *v2;
+	BvhLoadTriangle( pRoot, dwTriangle, &v0, &v1, &v2 );
+	__m256 vertex0[3];
+	__m256 e1[3];
+	__m256 e2[3];
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		vertex0[dwAxis] = _mm256_set1_ps( v0[dwAxis] );
+		e1[dwAxis] = _mm256_set1_ps( v1[dwAxis] - v0[dwAxis] );
+		e2[dwAxis] = _mm256_set1_ps( v2[dwAxis] - v0[dwAxis] );
+	}
+	__m256 p[3];
+	RayQueryCross8( pPacket->dir, e2, p );
+	const __m256 det = RayQueryDot8( e1, p );
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 invDet = _mm256_div_ps( _mm256_set1_ps( 1.f ), det );
+	__m256 s[3];
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		s[dwAxis] = _mm256_sub_ps( pPacket->origin[dwAxis], vertex0[dwAxis] );
+	}
+	const __m256 u = _mm256_mul_ps( RayQueryDot8( s, p ), invDet );
+	__m256 q[3];
+	RayQueryCross8( s, e1, q );
+	const __m256 v = _mm256_mul_ps( RayQueryDot8( pPacket->dir, q ), invDet );
+	const __m256 t = _mm256_mul_ps( RayQueryDot8( e2, q ), invDet );
+
+	const __m256i triangle = _mm256_set1_epi32( (int)dwTriangle );
+	//unsigned triangle < best, the miss value BVH_INVALID_NODE is the largest
+	const __m256i lower = _mm256_andnot_si256( _mm256_cmpeq_epi32( _mm256_max_epu32( triangle, pPacket->bestTriangle ), triangle ), _mm256_set1_epi32( -1 ) );
+	const __m256 closer = _mm256_or_ps( _mm256_cmp_ps( t, pPacket->bestT, _CMP_LT_OQ ),
+										_mm256_and_ps( _mm256_cmp_ps( t, pPacket->bestT, _CMP_EQ_OQ ), _mm256_castsi256_ps( lower ) ) );
+	__m256 hit = _mm256_and_ps( active, _mm256_cmp_ps( det, zero, _CMP_NEQ_OQ ) );
+	hit = _mm256_and_ps( hit, _mm256_cmp_ps( u, zero, _CMP_GE_OQ ) );
+	hit = _mm256_and_ps( hit, _mm256_cmp_ps( v, zero, _CMP_GE_OQ ) );
+	hit = _mm256_and_ps( hit, _mm256_cmp_ps( _mm256_add_ps( u, v ), _mm256_set1_ps( 1.f ), _CMP_LE_OQ ) );
+	hit = _mm256_and_ps( hit, _mm256_cmp_ps( t, pPacket->tMin, _CMP_GE_OQ ) );
+	hit = _mm256_and_ps( hit, closer );
+	pPacket->bestT = _mm256_blendv_ps( pPacket->bestT, t, hit );
+	pPacket->bestU = _mm256_blendv_ps( pPacket->bestU, u, hit );
+	pPacket->bestV = _mm256_blendv_ps( pPacket->bestV, v, hit );
+	pPacket->bestTriangle = _mm256_castps_si256( _mm256_blendv_ps( _mm256_castsi256_ps( pPacket->bestTriangle ), _mm256_castsi256_ps( triangle ), hit ) );
+}
+
+//8 consecutive rays through the bvh together, the lanes past dwCount are inactive
+inline
+void RayQueryClosestHitPacket8( const CpuComputeRootArgs *pRoot, const BvhNode *pNodes, const BvhRay *pRays, u32 dwCount, BvhHit *pHits )
+{
+	BvhRay rays[RAY_QUERY_PACKET_SIZE];
+	memcpy( rays, pRays, dwCount * sizeof(BvhRay) );
+	for( u32 dwLane = dwCount; dwLane < RAY_QUERY_PACKET_SIZE; ++dwLane )
+	{
+		rays[dwLane] = pRays[0];
+	}
+	RayPacket8 packet;
+	__m256 tMax;
+	RayQueryTranspose8( rays[0].fOrigin, 8, &packet.origin[0], &packet.origin[1], &packet.origin[2], &packet.tMin );
+	RayQueryTranspose8( rays[0].fDir, 8, &packet.dir[0], &packet.dir[1], &packet.dir[2], &tMax );
+	f32 dirSum[3] = { 0.f, 0.f, 0.f };
+	for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+	{
+		packet.invDir[dwAxis] = _mm256_div_ps( _mm256_set1_ps( 1.f ), packet.dir[dwAxis] );
+		for( u32 dwLane = 0; dwLane < dwCount; ++dwLane )
+		{
+			dirSum[dwAxis] += rays[dwLane].fDir[dwAxis];
+		}
+	}
+	//inactive lanes get an empty interval so they never hit anything
+	const __m256 active = _mm256_castsi256_ps( _mm256_cmpgt_epi32( _mm256_set1_epi32( (int)dwCount ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+	packet.bestT = _mm256_blendv_ps( _mm256_set1_ps( -1.f ), tMax, active );
+	packet.bestTriangle = _mm256_set1_epi32( (int)BVH_INVALID_NODE );
+	packet.bestU = _mm256_setzero_ps();
+	packet.bestV = _mm256_setzero_ps();
+
+	u32 stack[RAY_QUERY_STACK_SIZE];
+	u32 dwStackSize = 0;
+	stack[dwStackSize++] = 0;
+	while( dwStackSize )
+	{
+		const BvhNode *pNode = &pNodes[stack[--dwStackSize]];
+		const __m256 hitBox = RayQueryHitBox8( pNode, &packet );
+		if( _mm256_movemask_ps( hitBox ) == 0 )
+		{
+			continue;
+		}
+		if( pNode->dwLeft & BVH_LEAF_FLAG )
+		{
+			RayQueryHitTriangle8( pRoot, pNode->dwLeft & ~BVH_LEAF_FLAG, hitBox, &packet );
+			continue;
+		}
+		const bool bLeftFirst = RayQueryLeftFirst( pNodes, pNode, dirSum );
+		stack[dwStackSize++] = bLeftFirst ? pNode->dwRight : pNode->dwLeft;
+		stack[dwStackSize++] = bLeftFirst ? pNode->dwLeft : pNode->dwRight;
+	}
+
+	alignas(32) u32 triangles[RAY_QUERY_PACKET_SIZE];
+	alignas(32) f32 t[RAY_QUERY_PACKET_SIZE];
+	alignas(32) f32 u[RAY_QUERY_PACKET_SIZE];
+	alignas(32) f32 v[RAY_QUERY_PACKET_SIZE];
+	_mm256_store_si256( (__m256i*)triangles, packet.bestTriangle );
+	_mm256_store_ps( t, packet.bestT );
+	_mm256_store_ps( u, packet.bestU );
+	_mm256_store_ps( v, packet.bestV );
+	for( u32 dwLane = 0; dwLane < dwCount; ++dwLane )
+	{
+		pHits[dwLane].dwTriangle = triangles[dwLane];
+		pHits[dwLane].fT = t[dwLane];
+		pHits[dwLane].fU = u[dwLane];
+		pHits[dwLane].fV = v[dwLane];
+	}
+}
+#endif
+
+//packets of RAY_QUERY_PACKET_SIZE consecutive rays, the scalar kernel without AVX2
+inline
+void RayQueryClosestHitPacketCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+#if defined(__AVX2__)
+	const BvhNode *pNodes = (const BvhNode*)pRoot->pUavs[1];
+	const BvhRay *pRays = (const BvhRay*)pRoot->pUavs[3];
+	BvhHit *pHits = (BvhHit*)pRoot->pUavs[0];
+	u32 dwEnd;
+	for( u32 dwRay = RayQueryTileRange( pRoot, Gid.x, &dwEnd ); dwRay < dwEnd; dwRay += RAY_QUERY_PACKET_SIZE )
+	{
+		const u32 dwCount = dwEnd - dwRay < RAY_QUERY_PACKET_SIZE ? dwEnd - dwRay : RAY_QUERY_PACKET_SIZE;
+		RayQueryClosestHitPacket8( pRoot, pNodes, &pRays[dwRay], dwCount, &pHits[dwRay] );
+	}
+#else
+	RayQueryClosestHitCpu( pRoot, Gid, pGroupShared );
+#endif
+}
+
+inline
+void InitRayQueryKernels( RayQueryKernels *pKernels )
+{
+	memset( &pKernels->closestHit, 0, sizeof(CpuComputeKernel) );
+	pKernels->closestHit.pfnGroup = RayQueryClosestHitCpu;
+	pKernels->closestHit.dwNumThreads[0] = RAY_QUERY_THREADS;
+	pKernels->closestHit.dwNumThreads[1] = 1;
+	pKernels->closestHit.dwNumThreads[2] = 1;
+	pKernels->closestHitPacket = pKernels->closestHit;
+	pKernels->closestHitPacket.pfnGroup = RayQueryClosestHitPacketCpu;
+}
+
+//closest hits of the rays in pRays against a bvh of CpuBuildBvh() over the same mesh, the same dispatch as RecordRayQueryClosestHit() in main.cpp
+//pCB comes from MakeRayQueryCB(), bPackets picks the AVX2 packet kernel
+inline
+void CpuRayQueryClosestHit( CpuComputeDevice *pDevice, const RayQueryKernels *pKernels, bool bPackets, const u8 *pVerticesAndIndices, u64 qwSize,
+							const ComputeShaderCB *pCB, const BvhNode *pNodes, const u32 *pParents, const BvhRay *pRays, BvhHit *pHits )
+{
+	CpuComputeRootArgs root;
+	memset( &root, 0, sizeof(CpuComputeRootArgs) );
+	root.cb = *pCB;
+	root.pVerticesAndIndices = pVerticesAndIndices;
+	root.qwVerticesAndIndicesSize = qwSize;
+	root.pUavs[0] = (u8*)pHits;
+	root.pUavs[1] = (u8*)pNodes;
+	root.pUavs[2] = (u8*)pParents;
+	root.pUavs[3] = (u8*)pRays;
+	const u32 dwTiles = ( pCB->dwOffsetsAndStrides0[2] + RAY_QUERY_CPU_TILE - 1 ) / RAY_QUERY_CPU_TILE;
+	CpuDispatch( pDevice, bPackets ? &pKernels->closestHitPacket : &pKernels->closestHit, &root, dwTiles, 1, 1 );
+}
+
+//dwSide * dwSide camera rays at the mesh in a BvhNode's box, packets of 8 are 4x2 pixel tiles so they stay coherent (dwSide a multiple of 4)
+inline
+void MakeCameraRays( const BvhNode *pBounds, u32 dwSide, BvhRay *pRays )
+{
+	Vec3f center, extent;
+	center.x = ( pBounds->fMin[0] + pBounds->fMax[0] ) * 0.5f;
+	center.y = ( pBounds->fMin[1] + pBounds->fMax[1] ) * 0.5f;
+	center.z = ( pBounds->fMin[2] + pBounds->fMax[2] ) * 0.5f;
+	extent.x = pBounds->fMax[0] - center.x;
+	extent.y = pBounds->fMax[1] - center.y;
+	extent.z = pBounds->fMax[2] - center.z;
+	const f32 fRadius = sqrtf( Vec3fDot( &extent, &extent ) );
+	Vec3f eye = { center.x + 0.3f * fRadius, center.y + 0.7f * fRadius, center.z - 1.1f * fRadius };
+	Vec3f forward, right, up;
+	Vec3f worldUp = { 0.f, 1.f, 0.f };
+	Vec3fSub( &center, &eye, &forward );
+	Vec3fNormalize( &forward, &forward );
+	Vec3fCross( &forward, &worldUp, &right );
+	Vec3fNormalize( &right, &right );
+	Vec3fCross( &right, &forward, &up );
+	const f32 fTanHalfFov = 0.577f;
+	const u32 dwTilesPerRow = dwSide / 4;
+	for( u32 dwRay = 0; dwRay < dwSide * dwSide; ++dwRay )
+	{
+		const u32 dwTile = dwRay / 8;
+		const u32 dwLane = dwRay % 8;
+		const u32 dwX = ( dwTile % dwTilesPerRow ) * 4 + dwLane % 4;
+		const u32 dwY = ( dwTile / dwTilesPerRow ) * 2 + dwLane / 4;
+		const f32 fX = ( 2.f * ( dwX + 0.5f ) / dwSide - 1.f ) * fTanHalfFov;
+		const f32 fY = ( 1.f - 2.f * ( dwY + 0.5f ) / dwSide ) * fTanHalfFov;
+		Vec3f dir;
+		Vec3fScaleAdd( &right, fX, &forward, &dir );
+		Vec3fScaleAdd( &up, fY, &dir, &dir );
+		Vec3fNormalize( &dir, &dir );
+		BvhRay *pRay = &pRays[dwRay];
+		pRay->fOrigin[0] = eye.x;
+		pRay->fOrigin[1] = eye.y;
+		pRay->fOrigin[2] = eye.z;
+		pRay->fTMin = 0.f;
+		pRay->fDir[0] = dir.x;
+		pRay->fDir[1] = dir.y;
+		pRay->fDir[2] = dir.z;
+		pRay->fTMax = 1e30f;
+	}
+}
+
+//the passes of a bvh build followed by a ray query in recording order, for placing the buffers as transients
+enum RayQueryGraphPass
+{
+	RAY_QUERY_PASS_CENTROID_BOUNDS,
+	RAY_QUERY_PASS_MORTON_CODES,
+	RAY_QUERY_PASS_SORT,
+	RAY_QUERY_PASS_EMIT_HIERARCHY,
+	RAY_QUERY_PASS_REFIT,
+	RAY_QUERY_PASS_CLOSEST_HIT,
+	RAY_QUERY_PASS_COUNT
+};
+
+//indices of the graph's buffers in the plan
+typedef struct RayQueryTransients
+{
+	u32 dwNodes;
+	u32 dwParents;
+	u32 dwKeys;
+	u32 dwPayload;
+	u32 dwKeysAlt;
+	u32 dwPayloadAlt;
+	u32 dwBlockHistograms;
+	u32 dwDigitOffsets;
+	u32 dwScanPartials;
+	u32 dwScratch;
+	u32 dwRays;
+	u32 dwHits;
+} RayQueryTransients;
+
+//declares every buffer of the graph with the passes that use it, the sort temporaries end before the nodes and parents
+//are first written so they can share memory, and the hits can take over everything but the bvh and the rays
+//the rays live through the whole graph, the caller writes them outside of it (before the build or from the root box after it)
+//and no recorded pass could put an aliasing barrier in front of that write
+//dwRadixBlockSize/dwBvhBlockSize are RADIX_BLOCK_SIZE/BVH_BLOCK_SIZE on the gpu, RADIX_CPU_TILE/BVH_CPU_TILE on the cpu
+inline
+void DeclareRayQueryTransients( TransientPlan *pPlan, u32 dwTriangleCount, u32 dwRayCount, u32 dwRadixBlockSize, u32 dwBvhBlockSize, u64 qwAlignment,
+								RayQueryTransients *pTransients )
+{
+	const u64 qwNodeCount = BvhNodeCount( dwTriangleCount );
+	const u64 qwHistogramSize = (u64)RadixHistogramCount( dwTriangleCount, dwRadixBlockSize ) * sizeof(u32);
+	const u64 qwKeysSize = (u64)dwTriangleCount * sizeof(u32);
+	pTransients->dwScratch = TransientPlanDeclare( pPlan, "bvh scratch", BvhScratchSize( dwTriangleCount, dwBvhBlockSize ), qwAlignment,
+												   RAY_QUERY_PASS_CENTROID_BOUNDS, RAY_QUERY_PASS_REFIT );
+	pTransients->dwKeys = TransientPlanDeclare( pPlan, "morton codes", qwKeysSize, qwAlignment, RAY_QUERY_PASS_MORTON_CODES, RAY_QUERY_PASS_EMIT_HIERARCHY );
+	pTransients->dwPayload = TransientPlanDeclare( pPlan, "triangle indices", qwKeysSize, qwAlignment, RAY_QUERY_PASS_MORTON_CODES, RAY_QUERY_PASS_EMIT_HIERARCHY );
+	pTransients->dwKeysAlt = TransientPlanDeclare( pPlan, "sort keys alt", qwKeysSize, qwAlignment, RAY_QUERY_PASS_SORT, RAY_QUERY_PASS_SORT );
+	pTransients->dwPayloadAlt = TransientPlanDeclare( pPlan, "sort payload alt", qwKeysSize, qwAlignment, RAY_QUERY_PASS_SORT, RAY_QUERY_PASS_SORT );
+	pTransients->dwBlockHistograms = TransientPlanDeclare( pPlan, "block histograms", qwHistogramSize, qwAlignment, RAY_QUERY_PASS_SORT, RAY_QUERY_PASS_SORT );
+	pTransients->dwDigitOffsets = TransientPlanDeclare( pPlan, "digit offsets", qwHistogramSize, qwAlignment, RAY_QUERY_PASS_SORT, RAY_QUERY_PASS_SORT );
+	pTransients->dwScanPartials = TransientPlanDeclare( pPlan, "scan partials", RadixScanScratchSize( dwTriangleCount, dwRadixBlockSize ), qwAlignment,
+														RAY_QUERY_PASS_SORT, RAY_QUERY_PASS_SORT );
+	pTransients->dwNodes = TransientPlanDeclare( pPlan, "bvh nodes", qwNodeCount * sizeof(BvhNode), qwAlignment, RAY_QUERY_PASS_EMIT_HIERARCHY, RAY_QUERY_PASS_CLOSEST_HIT );
+	pTransients->dwParents = TransientPlanDeclare( pPlan, "bvh parents", qwNodeCount * sizeof(u32), qwAlignment, RAY_QUERY_PASS_EMIT_HIERARCHY, RAY_QUERY_PASS_CLOSEST_HIT );
+	pTransients->dwRays = TransientPlanDeclare( pPlan, "rays", (u64)dwRayCount * sizeof(BvhRay), qwAlignment, RAY_QUERY_PASS_CENTROID_BOUNDS, RAY_QUERY_PASS_CLOSEST_HIT );
+	pTransients->dwHits = TransientPlanDeclare( pPlan, "hits", (u64)dwRayCount * sizeof(BvhHit), qwAlignment, RAY_QUERY_PASS_CLOSEST_HIT, RAY_QUERY_PASS_CLOSEST_HIT );
+}
+
+#endif
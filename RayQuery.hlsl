@@ -0,0 +1,165 @@
+//cs_5_0 way
+//closest hit of a batch of rays against a Bvh.hlsl bvh, one thread per ray
+//the traversal is stackless: it walks the parent links (Hapala 2011) so a thread needs no local array, children are visited near one first
+//leaves are tested with moller trumbore, equal t goes to the lower triangle index so the result does not depend on the visit order
+//RayQuery.h is the cpu version, its scalar and packet paths do the same math
+cbuffer globalCB : register(b0)
+{
+    uint4 dwOffsetsAndStrides0; //x vertex byte offset, y index byte offset, z ray count, w vertex stride
+};
+
+#define RAY_QUERY_THREADS 64
+#define BVH_LEAF_FLAG 0x80000000
+#define BVH_INVALID_NODE 0xFFFFFFFF
+#define BVH_NODE_SIZE 32
+#define RAY_QUERY_RAY_SIZE 32   //origin, tMin, direction, tMax
+#define RAY_QUERY_HIT_SIZE 16   //triangle (BVH_INVALID_NODE for a miss), t, u, v
+#define RAY_QUERY_BOX_SLACK 1.00000024f //grows the far slab distance by 2 ulp so rounding never loses a box a triangle is in
+
+ByteAddressBuffer verticesAndIndices : register( t0 );
+ByteAddressBuffer Nodes : register( t1 );
+ByteAddressBuffer Parents : register( t2 );
+ByteAddressBuffer Rays : register( t3 );
+RWByteAddressBuffer Hits : register( u0 );
+
+#define RAY_QUERY_ROOT_SIGNATURE "RootFlags( 0 ), RootConstants( num32BitConstants=4, b0, space = 0, visibility=SHADER_VISIBILITY_ALL ), SRV(t0, space=0, visibility=SHADER_VISIBILITY_ALL), SRV(t1, space=0, visibility=SHADER_VISIBILITY_ALL), SRV(t2, space=0, visibility=SHADER_VISIBILITY_ALL), SRV(t3, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u0, space=0, visibility=SHADER_VISIBILITY_ALL)"
+
+#define STATE_FROM_PARENT 0
+#define STATE_FROM_SIBLING 1
+#define STATE_FROM_CHILD 2
+
+float3 LoadVertex( uint dwIndex )
+{
+	return asfloat( verticesAndIndices.Load3( dwOffsetsAndStrides0.x + dwIndex * dwOffsetsAndStrides0.w ) );
+}
+
+bool HitBox( uint dwNode, float3 origin, float3 invDir, float tMin, float tMax )
+{
+	const float3 t0 = ( asfloat( Nodes.Load3( dwNode * BVH_NODE_SIZE ) ) - origin ) * invDir;
+	const float3 t1 = ( asfloat( Nodes.Load3( dwNode * BVH_NODE_SIZE + 16 ) ) - origin ) * invDir;
+	const float3 tNear = min( t0, t1 );
+	const float3 tFar = max( t0, t1 );
+	return max( tMin, max( tNear.x, max( tNear.y, tNear.z ) ) ) <= min( tMax, min( tFar.x, min( tFar.y, tFar.z ) ) * RAY_QUERY_BOX_SLACK );
+}
+
+float3 BoxCenter( uint dwNode )
+{
+	return asfloat( Nodes.Load3( dwNode * BVH_NODE_SIZE ) ) + asfloat( Nodes.Load3( dwNode * BVH_NODE_SIZE + 16 ) );
+}
+
+uint NearChild( uint dwNode, float3 dir )
+{
+	const uint dwLeft = Nodes.Load( dwNode * BVH_NODE_SIZE + 12 );
+	const uint dwRight = Nodes.Load( dwNode * BVH_NODE_SIZE + 28 );
+	return dot( BoxCenter( dwLeft ) - BoxCenter( dwRight ), dir ) <= 0 ? dwLeft : dwRight;
+}
+
+uint Sibling( uint dwNode )
+{
+	const uint dwParent = Parents.Load( dwNode * 4 );
+	const uint dwLeft = Nodes.Load( dwParent * BVH_NODE_SIZE + 12 );
+	return dwLeft == dwNode ? Nodes.Load( dwParent * BVH_NODE_SIZE + 28 ) : dwLeft;
+}
+
+//moller trumbore, hit is (triangle, t, u, v) of the closest hit so far
+void HitTriangle( uint dwTriangle, float3 origin, float3 dir, float tMin, inout uint4 hit )
+{
+	const uint3 indices = verticesAndIndices.Load3( dwOffsetsAndStrides0.y + dwTriangle * 12 );
+	const float3 v0 = LoadVertex( indices.x );
+	const float3 e1 = LoadVertex( indices.y ) - v0;
+	const float3 e2 = LoadVertex( indices.z ) - v0;
+	const float3 p = cross( dir, e2 );
+	const float fDet = dot( e1, p );
+	if( fDet == 0 )
+	{
+		return;
+	}
+	const float fInvDet = 1.0 / fDet;
+	const float3 s = origin - v0;
+	const float u = dot( s, p ) * fInvDet;
+	const float3 q = cross( s, e1 );
+	const float v = dot( dir, q ) * fInvDet;
+	const float t = dot( e2, q ) * fInvDet;
+	const float fBestT = asfloat( hit.y );
+	if( u >= 0 && v >= 0 && u + v <= 1 && t >= tMin && ( t < fBestT || ( t == fBestT && dwTriangle < hit.x ) ) )
+	{
+		hit = uint4( dwTriangle, asuint( t ), asuint( u ), asuint( v ) );
+	}
+}
+
+[RootSignature(RAY_QUERY_ROOT_SIGNATURE)]
+[numthreads(RAY_QUERY_THREADS, 1, 1)]
+void RayQueryClosestHit( uint3 DTid : SV_DispatchThreadID )
+{
+	if( DTid.x >= dwOffsetsAndStrides0.z )
+	{
+		return;
+	}
+	const float4 originMin = asfloat( Rays.Load4( DTid.x * RAY_QUERY_RAY_SIZE ) );
+	const float4 dirMax = asfloat( Rays.Load4( DTid.x * RAY_QUERY_RAY_SIZE + 16 ) );
+	const float3 origin = originMin.xyz;
+	const float3 dir = dirMax.xyz;
+	const float3 invDir = 1.0 / dir;
+	const float tMin = originMin.w;
+	uint4 hit = uint4( BVH_INVALID_NODE, asuint( dirMax.w ), 0, 0 );
+
+	//the root is node 0, a single triangle mesh is just a leaf
+	uint dwNode = 0;
+	uint dwState = STATE_FROM_CHILD;
+	if( HitBox( 0, origin, invDir, tMin, asfloat( hit.y ) ) )
+	{
+		const uint dwLeft = Nodes.Load( 12 );
+		if( dwLeft & BVH_LEAF_FLAG )
+		{
+			HitTriangle( dwLeft & ~BVH_LEAF_FLAG, origin, dir, tMin, hit );
+		}
+		else
+		{
+			dwNode = NearChild( 0, dir );
+			dwState = STATE_FROM_PARENT;
+		}
+	}
+
+	[loop]
+	while( dwState != STATE_FROM_CHILD || dwNode != 0 )
+	{
+		if( dwState == STATE_FROM_CHILD )
+		{
+			//dwNode's subtree is done, the far sibling is next if it was the near child
+			const uint dwParent = Parents.Load( dwNode * 4 );
+			if( dwNode == NearChild( dwParent, dir ) )
+			{
+				dwNode = Sibling( dwNode );
+				dwState = STATE_FROM_SIBLING;
+			}
+			else
+			{
+				dwNode = dwParent;
+			}
+			continue;
+		}
+		const uint dwLeft = Nodes.Load( dwNode * BVH_NODE_SIZE + 12 );
+		const bool bDescend = HitBox( dwNode, origin, invDir, tMin, asfloat( hit.y ) );
+		if( bDescend && ( dwLeft & BVH_LEAF_FLAG ) == 0 )
+		{
+			dwNode = NearChild( dwNode, dir );
+			dwState = STATE_FROM_PARENT;
+			continue;
+		}
+		if( bDescend )
+		{
+			HitTriangle( dwLeft & ~BVH_LEAF_FLAG, origin, dir, tMin, hit );
+		}
+		if( dwState == STATE_FROM_PARENT )
+		{
+			dwNode = Sibling( dwNode );
+			dwState = STATE_FROM_SIBLING;
+		}
+		else
+		{
+			dwNode = Parents.Load( dwNode * 4 );
+			dwState = STATE_FROM_CHILD;
+		}
+	}
+	Hits.Store4( DTid.x * RAY_QUERY_HIT_SIZE, hit );
+}
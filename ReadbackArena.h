@@ -0,0 +1,87 @@
+#ifndef READBACK_ARENA_H
+#define READBACK_ARENA_H
+
+//persistently mapped readback buffer that copies land in and results are read from in place, no Map/Unmap or memcpy per result
+//it is the upload ring run the other way: spans are suballocated in order, tagged with the fence value of the copy that
+//writes them by ReadbackArenaSubmit() and handed back when the consumer releases that fence value, not when the fence completes,
+//so a span stays readable for as long as it is needed and the arena only ever fills up with results nobody released
+//spans are released in submission order, releasing a value also releases every span submitted at or before it
+//only the thread recording the readback copies should touch the arena
+
+#include "Common.h"
+#include "UploadRing.h"
+
+//CopyBufferRegion destinations only need 4 bytes, 256 keeps spans of different submits off the same cache lines
+//spans written to disk with O_DIRECT need the block size instead (RESULT_SINK_DIRECT_ALIGNMENT)
+#define READBACK_ARENA_ALIGNMENT 256
+
+typedef struct ReadbackSpan
+{
+	const u8 *pData;
+	u64 qwOffset; //from the start of the readback buffer, the destination offset for CopyBufferRegion
+	u64 qwSize;
+} ReadbackSpan;
+
+typedef struct ReadbackArena
+{
+	UploadRing ring; //retired by released fence values instead of completed ones
+	u64 qwReleasedFenceValue;
+} ReadbackArena;
+
+//pMapped stays mapped for the lifetime of the arena, qwSize is a multiple of every alignment that will be requested
+inline
+void InitReadbackArena( ReadbackArena *pArena, const u8 *pMapped, u64 qwSize )
+{
+	InitUploadRing( &pArena->ring, (u8*)pMapped, qwSize );
+	pArena->qwReleasedFenceValue = 0;
+}
+
+//fails when the arena is full of spans that were not released yet, waiting on the gpu does not help, the consumer has to
+//release something (ReadbackArenaOldestFenceValue() is the value that frees the most space first)
+inline
+bool ReadbackArenaAlloc( ReadbackArena *pArena, u64 qwSize, u64 qwAlignment, ReadbackSpan *pSpan )
+{
+	UploadRingAllocation allocation;
+	if( !UploadRingAlloc( &pArena->ring, qwSize, qwAlignment, &allocation ) )
+	{
+		return false;
+	}
+	pSpan->pData = allocation.pCpuAddress;
+	pSpan->qwOffset = allocation.qwOffset;
+	pSpan->qwSize = allocation.qwSize;
+	return true;
+}
+
+//call right after the queue Signal( fence, qwFenceValue ) that covers the copies into the spans allocated since the last submit
+//the spans are readable once the fence has completed qwFenceValue
+inline
+void ReadbackArenaSubmit( ReadbackArena *pArena, u64 qwFenceValue )
+{
+	UploadRingSubmit( &pArena->ring, qwFenceValue );
+}
+
+//the consumer is done with every span submitted with a fence value <= qwFenceValue, which has to have completed
+inline
+void ReadbackArenaRelease( ReadbackArena *pArena, u64 qwFenceValue )
+{
+	if( qwFenceValue > pArena->qwReleasedFenceValue )
+	{
+		pArena->qwReleasedFenceValue = qwFenceValue;
+	}
+	UploadRingRetire( &pArena->ring, pArena->qwReleasedFenceValue );
+}
+
+//0 when every submitted span was released
+inline
+u64 ReadbackArenaOldestFenceValue( const ReadbackArena *pArena )
+{
+	return UploadRingOldestFenceValue( &pArena->ring );
+}
+
+inline
+u64 ReadbackArenaUsed( const ReadbackArena *pArena )
+{
+	return UploadRingUsed( &pArena->ring );
+}
+
+#endif
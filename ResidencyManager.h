@@ -0,0 +1,324 @@
+#ifndef RESIDENCY_MANAGER_H
+#define RESIDENCY_MANAGER_H
+
+//memory budget accounting and lru eviction of heaps, the budget query, fence reads, Evict() and MakeResident() come in through
+//ResidencyCallbacks, main.cpp binds them to d3d12 and Bench to a mock budget and cpu queues
+//every heap the app creates is tracked with its size and memory segment (video memory or system memory), a heap is used
+//by declaring the fence value of the submission that needs it before the submit, which also makes it the most recently used
+//a heap only gets evicted once every queue has completed the last submission that used it, the least recently used first,
+//and made resident again (re-uploaded if the eviction did not keep its contents) the next time it is used
+//the budget of a segment is the smaller of the source's (IDXGIAdapter3::QueryVideoMemoryInfo()) and a configured limit
+//only one thread should use a manager
+
+#include "Common.h"
+
+#define RESIDENCY_MAX_HEAPS 256
+#define RESIDENCY_MAX_QUEUES 4
+#define RESIDENCY_NONE 0xFFFFFFFFu
+#define RESIDENCY_NO_LIMIT 0xFFFFFFFFFFFFFFFFull
+
+enum ResidencySegment
+{
+	RESIDENCY_SEGMENT_LOCAL,     //DXGI_MEMORY_SEGMENT_GROUP_LOCAL, default heaps on a discrete gpu
+	RESIDENCY_SEGMENT_NON_LOCAL, //DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, upload and readback heaps
+	RESIDENCY_SEGMENT_COUNT
+};
+
+typedef u64 (*PFN_ResidencyBudget)( void *pContext, u32 dwSegment );
+typedef u64 (*PFN_ResidencyCompletedFenceValue)( void *pContext, u32 dwQueue );
+typedef bool (*PFN_ResidencyEvict)( void *pContext, void *pHeap );
+//also re-uploads whatever the eviction did not keep
+typedef bool (*PFN_ResidencyMakeResident)( void *pContext, void *pHeap );
+
+typedef struct ResidencyCallbacks
+{
+	PFN_ResidencyBudget pfnBudget;
+	PFN_ResidencyCompletedFenceValue pfnCompletedFenceValue;
+	PFN_ResidencyEvict pfnEvict;
+	PFN_ResidencyMakeResident pfnMakeResident;
+	void *pContext;
+} ResidencyCallbacks;
+
+typedef struct ResidencyHeap
+{
+	void *pHeap;         //NULL when the slot is free
+	const char *pName;
+	u64 qwSize;
+	u64 qwFenceValues[RESIDENCY_MAX_QUEUES]; //of the last submission on every queue that used the heap
+	u32 dwPrev;          //lru list of the resident heaps of the segment, towards the most recently used
+	u32 dwNext;
+	u32 dwSegment;
+	bool bResident;
+	bool bPinned;        //counted but never evicted, persistently mapped heaps
+} ResidencyHeap;
+
+typedef struct ResidencyStats
+{
+	u64 qwUses;
+	u64 qwEvictions;
+	u64 qwEvictedBytes;
+	u64 qwRestores;
+	u64 qwRestoredBytes;
+	u64 qwFailedUses;    //no room without waiting for the gpu, see ResidencyOldestBusy()
+} ResidencyStats;
+
+typedef struct ResidencyManager
+{
+	ResidencyHeap heaps[RESIDENCY_MAX_HEAPS];
+	ResidencyCallbacks callbacks;
+	u32 dwQueueCount;
+	u64 qwBudgetLimits[RESIDENCY_SEGMENT_COUNT];
+	u64 qwResidentBytes[RESIDENCY_SEGMENT_COUNT];
+	u64 qwPeakResidentBytes[RESIDENCY_SEGMENT_COUNT];
+	u64 qwTrackedBytes[RESIDENCY_SEGMENT_COUNT];
+	u32 dwLru[RESIDENCY_SEGMENT_COUNT]; //oldest resident heap
+	u32 dwMru[RESIDENCY_SEGMENT_COUNT];
+	u64 qwCompletedCache[RESIDENCY_MAX_QUEUES]; //completed values only go up, refreshed when a heap looks busy
+	ResidencyStats stats;
+} ResidencyManager;
+
+inline
+void InitResidencyManager( ResidencyManager *pManager, const ResidencyCallbacks *pCallbacks, u32 dwQueueCount )
+{
+	memset( pManager, 0, sizeof(ResidencyManager) );
+	pManager->callbacks = *pCallbacks;
+	pManager->dwQueueCount = dwQueueCount < RESIDENCY_MAX_QUEUES ? dwQueueCount : RESIDENCY_MAX_QUEUES;
+	for( u32 dwSegment = 0; dwSegment < RESIDENCY_SEGMENT_COUNT; ++dwSegment )
+	{
+		pManager->qwBudgetLimits[dwSegment] = RESIDENCY_NO_LIMIT;
+		pManager->dwLru[dwSegment] = RESIDENCY_NONE;
+		pManager->dwMru[dwSegment] = RESIDENCY_NONE;
+	}
+}
+
+//on top of the source's budget, RESIDENCY_NO_LIMIT to only follow the source
+inline
+void ResidencySetBudgetLimit( ResidencyManager *pManager, u32 dwSegment, u64 qwBytes )
+{
+	pManager->qwBudgetLimits[dwSegment] = qwBytes;
+}
+
+inline
+u64 ResidencyBudget( const ResidencyManager *pManager, u32 dwSegment )
+{
+	const u64 qwSource = pManager->callbacks.pfnBudget( pManager->callbacks.pContext, dwSegment );
+	return qwSource < pManager->qwBudgetLimits[dwSegment] ? qwSource : pManager->qwBudgetLimits[dwSegment];
+}
+
+inline
+void ResidencyUnlink( ResidencyManager *pManager, u32 dwHeap )
+{
+	ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	if( pHeap->dwPrev != RESIDENCY_NONE )
+	{
+		pManager->heaps[pHeap->dwPrev].dwNext = pHeap->dwNext;
+	}
+	else
+	{
+		pManager->dwMru[pHeap->dwSegment] = pHeap->dwNext;
+	}
+	if( pHeap->dwNext != RESIDENCY_NONE )
+	{
+		pManager->heaps[pHeap->dwNext].dwPrev = pHeap->dwPrev;
+	}
+	else
+	{
+		pManager->dwLru[pHeap->dwSegment] = pHeap->dwPrev;
+	}
+	pHeap->dwPrev = RESIDENCY_NONE;
+	pHeap->dwNext = RESIDENCY_NONE;
+}
+
+inline
+void ResidencyLinkMru( ResidencyManager *pManager, u32 dwHeap )
+{
+	ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	pHeap->dwPrev = RESIDENCY_NONE;
+	pHeap->dwNext = pManager->dwMru[pHeap->dwSegment];
+	if( pHeap->dwNext != RESIDENCY_NONE )
+	{
+		pManager->heaps[pHeap->dwNext].dwPrev = dwHeap;
+	}
+	else
+	{
+		pManager->dwLru[pHeap->dwSegment] = dwHeap;
+	}
+	pManager->dwMru[pHeap->dwSegment] = dwHeap;
+}
+
+inline
+void ResidencyAddResident( ResidencyManager *pManager, u32 dwSegment, s64 qwBytes )
+{
+	pManager->qwResidentBytes[dwSegment] += qwBytes;
+	if( pManager->qwResidentBytes[dwSegment] > pManager->qwPeakResidentBytes[dwSegment] )
+	{
+		pManager->qwPeakResidentBytes[dwSegment] = pManager->qwResidentBytes[dwSegment];
+	}
+}
+
+//every queue is past the last submission that used the heap
+inline
+bool ResidencyIsIdle( ResidencyManager *pManager, u32 dwHeap )
+{
+	const ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	for( u32 dwQueue = 0; dwQueue < pManager->dwQueueCount; ++dwQueue )
+	{
+		if( pHeap->qwFenceValues[dwQueue] > pManager->qwCompletedCache[dwQueue] )
+		{
+			pManager->qwCompletedCache[dwQueue] = pManager->callbacks.pfnCompletedFenceValue( pManager->callbacks.pContext, dwQueue );
+			if( pHeap->qwFenceValues[dwQueue] > pManager->qwCompletedCache[dwQueue] )
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+inline
+bool ResidencyEvict( ResidencyManager *pManager, u32 dwHeap )
+{
+	ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	if( !pManager->callbacks.pfnEvict( pManager->callbacks.pContext, pHeap->pHeap ) )
+	{
+		return false;
+	}
+	ResidencyUnlink( pManager, dwHeap );
+	pHeap->bResident = false;
+	ResidencyAddResident( pManager, pHeap->dwSegment, -(s64)pHeap->qwSize );
+	++pManager->stats.qwEvictions;
+	pManager->stats.qwEvictedBytes += pHeap->qwSize;
+	return true;
+}
+
+//evicts idle heaps oldest first until qwBytes more fit in the segment's budget, false if the busy ones are in the way
+//dwExcept is never evicted (the heap that needs the room)
+inline
+bool ResidencyMakeRoom( ResidencyManager *pManager, u32 dwSegment, u64 qwBytes, u32 dwExcept )
+{
+	const u64 qwBudget = ResidencyBudget( pManager, dwSegment );
+	u32 dwHeap = pManager->dwLru[dwSegment];
+	while( pManager->qwResidentBytes[dwSegment] + qwBytes > qwBudget && dwHeap != RESIDENCY_NONE )
+	{
+		const u32 dwNewer = pManager->heaps[dwHeap].dwPrev;
+		if( dwHeap != dwExcept && !pManager->heaps[dwHeap].bPinned && ResidencyIsIdle( pManager, dwHeap ) )
+		{
+			ResidencyEvict( pManager, dwHeap );
+		}
+		dwHeap = dwNewer;
+	}
+	return pManager->qwResidentBytes[dwSegment] + qwBytes <= qwBudget;
+}
+
+//pHeap was just created, so it is resident, other heaps get evicted to make room for it when they can
+inline
+u32 ResidencyTrackHeap( ResidencyManager *pManager, void *pHeap, u64 qwSize, u32 dwSegment, const char *pName, bool bPinned )
+{
+	u32 dwHeap = 0;
+	while( dwHeap < RESIDENCY_MAX_HEAPS && pManager->heaps[dwHeap].pHeap )
+	{
+		++dwHeap;
+	}
+	if( dwHeap == RESIDENCY_MAX_HEAPS || !pHeap )
+	{
+		return RESIDENCY_NONE;
+	}
+	ResidencyMakeRoom( pManager, dwSegment, qwSize, RESIDENCY_NONE );
+	ResidencyHeap *pTracked = &pManager->heaps[dwHeap];
+	memset( pTracked, 0, sizeof(ResidencyHeap) );
+	pTracked->pHeap = pHeap;
+	pTracked->pName = pName;
+	pTracked->qwSize = qwSize;
+	pTracked->dwSegment = dwSegment;
+	pTracked->bResident = true;
+	pTracked->bPinned = bPinned;
+	ResidencyLinkMru( pManager, dwHeap );
+	ResidencyAddResident( pManager, dwSegment, qwSize );
+	pManager->qwTrackedBytes[dwSegment] += qwSize;
+	return dwHeap;
+}
+
+//the heap has to be idle, the caller releases it after this
+inline
+void ResidencyUntrackHeap( ResidencyManager *pManager, u32 dwHeap )
+{
+	ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	if( pHeap->bResident )
+	{
+		ResidencyUnlink( pManager, dwHeap );
+		ResidencyAddResident( pManager, pHeap->dwSegment, -(s64)pHeap->qwSize );
+	}
+	pManager->qwTrackedBytes[pHeap->dwSegment] -= pHeap->qwSize;
+	pHeap->pHeap = NULL;
+}
+
+//call before the submission on dwQueue that signals qwFenceValue, the heap is resident when this returns true
+//false when it only fits once the gpu is done with other heaps, wait for ResidencyOldestBusy() and try again
+inline
+bool ResidencyUse( ResidencyManager *pManager, u32 dwHeap, u32 dwQueue, u64 qwFenceValue )
+{
+	ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+	++pManager->stats.qwUses;
+	if( !pHeap->bResident )
+	{
+		if( !ResidencyMakeRoom( pManager, pHeap->dwSegment, pHeap->qwSize, dwHeap ) ||
+			!pManager->callbacks.pfnMakeResident( pManager->callbacks.pContext, pHeap->pHeap ) )
+		{
+			++pManager->stats.qwFailedUses;
+			return false;
+		}
+		pHeap->bResident = true;
+		ResidencyAddResident( pManager, pHeap->dwSegment, pHeap->qwSize );
+		++pManager->stats.qwRestores;
+		pManager->stats.qwRestoredBytes += pHeap->qwSize;
+	}
+	else
+	{
+		ResidencyUnlink( pManager, dwHeap );
+	}
+	ResidencyLinkMru( pManager, dwHeap );
+	if( qwFenceValue > pHeap->qwFenceValues[dwQueue] )
+	{
+		pHeap->qwFenceValues[dwQueue] = qwFenceValue;
+	}
+	return true;
+}
+
+//evicts idle heaps until every segment is within its budget again, call once per frame or batch of submissions
+//so a budget the os lowered is followed even when nothing new is made resident, false if the busy heaps alone are over it
+inline
+bool ResidencyTrim( ResidencyManager *pManager )
+{
+	bool bWithin = true;
+	for( u32 dwSegment = 0; dwSegment < RESIDENCY_SEGMENT_COUNT; ++dwSegment )
+	{
+		bWithin &= ResidencyMakeRoom( pManager, dwSegment, 0, RESIDENCY_NONE );
+	}
+	return bWithin;
+}
+
+//the queue and fence value to wait for so the least recently used busy heap of the segment becomes evictable
+inline
+bool ResidencyOldestBusy( ResidencyManager *pManager, u32 dwSegment, u32 *pdwQueue, u64 *pqwFenceValue )
+{
+	for( u32 dwHeap = pManager->dwLru[dwSegment]; dwHeap != RESIDENCY_NONE; dwHeap = pManager->heaps[dwHeap].dwPrev )
+	{
+		const ResidencyHeap *pHeap = &pManager->heaps[dwHeap];
+		if( pHeap->bPinned )
+		{
+			continue;
+		}
+		for( u32 dwQueue = 0; dwQueue < pManager->dwQueueCount; ++dwQueue )
+		{
+			if( pHeap->qwFenceValues[dwQueue] > pManager->callbacks.pfnCompletedFenceValue( pManager->callbacks.pContext, dwQueue ) )
+			{
+				*pdwQueue = dwQueue;
+				*pqwFenceValue = pHeap->qwFenceValues[dwQueue];
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+#endif
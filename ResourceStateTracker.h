@@ -0,0 +1,260 @@
+#ifndef RESOURCE_STATE_TRACKER_H
+#define RESOURCE_STATE_TRACKER_H
+
+//records the state of every resource a command list touches and turns declared usage into the barriers it needs
+//barriers are only collected when a use is declared and handed out in one batch by FlushResourceBarriers() right before
+//the Dispatch/Copy, a transition that is undone before the flush or that goes to a state the resource is already in is dropped
+//follows the implicit state rules (https://learn.microsoft.com/en-us/windows/win32/direct3d12/using-resource-barriers-to-synchronize-resource-states-in-direct3d-12#implicit-state-transitions):
+//buffers decay to COMMON after every ExecuteCommandLists and get promoted out of COMMON by their first use in a list,
+//so a buffer only needs a barrier when a single list uses it in two incompatible ways
+
+#include "Common.h"
+
+//same values as D3D12_RESOURCE_STATES so the backend can cast
+#define TRACKED_STATE_COMMON                     0x0
+#define TRACKED_STATE_VERTEX_AND_CONSTANT_BUFFER 0x1
+#define TRACKED_STATE_INDEX_BUFFER               0x2
+#define TRACKED_STATE_UNORDERED_ACCESS           0x8
+#define TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE  0x40
+#define TRACKED_STATE_INDIRECT_ARGUMENT          0x200
+#define TRACKED_STATE_COPY_DEST                  0x400
+#define TRACKED_STATE_COPY_SOURCE                0x800
+#define TRACKED_STATE_READ_ONLY_MASK             ( TRACKED_STATE_VERTEX_AND_CONSTANT_BUFFER | TRACKED_STATE_INDEX_BUFFER | \
+												   TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE | TRACKED_STATE_INDIRECT_ARGUMENT | TRACKED_STATE_COPY_SOURCE )
+
+#define RESOURCE_BARRIER_TRANSITION 0 //D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+#define RESOURCE_BARRIER_ALIASING 1   //D3D12_RESOURCE_BARRIER_TYPE_ALIASING
+#define RESOURCE_BARRIER_UAV 2        //D3D12_RESOURCE_BARRIER_TYPE_UAV
+
+#define RESOURCE_TRACKER_MAX_RESOURCES 256 //distinct resources one command list can touch
+#define RESOURCE_TRACKER_MAX_BARRIERS 64   //barriers between two flushes
+
+//one per resource, shared by every command list that uses it, lists have to be closed in the order they are executed
+typedef struct TrackedResource
+{
+	void *pResource; //ID3D12Resource*
+	u32 dwState;     //state between command lists
+	u32 bDecays;     //buffers (and simultaneous access textures) go back to COMMON after every ExecuteCommandLists
+} TrackedResource;
+
+typedef struct ResourceBarrierDesc
+{
+	u32 eType;
+	void *pResource;       //ResourceAfter of aliasing barriers
+	void *pResourceBefore; //aliasing barriers only, NULL is any placed resource that was in the memory
+	u32 dwStateBefore;
+	u32 dwStateAfter;
+} ResourceBarrierDesc;
+
+typedef struct ResourceTrackerEntry
+{
+	TrackedResource *pTracked;
+	u32 dwState;
+	u32 bUsed;     //declared since the list was reset, the state before that comes from the previous list
+	u32 bPromoted; //implicitly promoted out of COMMON, more read states can still be promoted into without a barrier
+	s32 dwPendingBarrier; //index in pending barriers, -1 when there is none
+} ResourceTrackerEntry;
+
+typedef struct ResourceStateTrackerStats
+{
+	u32 dwDeclaredUses;
+	u32 dwImplicitPromotions;
+	u32 dwDroppedTransitions; //redundant or collapsed before reaching a flush
+	u32 dwEmittedBarriers;
+	u32 dwBarrierCalls;       //flushes that had at least one barrier
+} ResourceStateTrackerStats;
+
+typedef struct ResourceStateTracker
+{
+	ResourceTrackerEntry entries[RESOURCE_TRACKER_MAX_RESOURCES];
+	u32 dwEntryCount;
+	ResourceBarrierDesc pending[RESOURCE_TRACKER_MAX_BARRIERS];
+	u32 dwPendingCount;
+	ResourceStateTrackerStats stats;
+} ResourceStateTracker;
+
+inline
+void InitTrackedResource( TrackedResource *pTracked, void *pResource, u32 dwInitialState, bool bDecays )
+{
+	pTracked->pResource = pResource;
+	pTracked->dwState = dwInitialState;
+	pTracked->bDecays = bDecays;
+}
+
+//call with every command list Reset
+inline
+void ResourceStateTrackerReset( ResourceStateTracker *pTracker )
+{
+	pTracker->dwEntryCount = 0;
+	pTracker->dwPendingCount = 0;
+}
+
+inline
+void InitResourceStateTracker( ResourceStateTracker *pTracker )
+{
+	ResourceStateTrackerReset( pTracker );
+	pTracker->stats = ResourceStateTrackerStats();
+}
+
+inline
+ResourceTrackerEntry *ResourceStateTrackerFind( ResourceStateTracker *pTracker, TrackedResource *pTracked )
+{
+	for( u32 dwEntry = 0; dwEntry < pTracker->dwEntryCount; ++dwEntry )
+	{
+		if( pTracker->entries[dwEntry].pTracked == pTracked )
+		{
+			return &pTracker->entries[dwEntry];
+		}
+	}
+	if( pTracker->dwEntryCount == RESOURCE_TRACKER_MAX_RESOURCES )
+	{
+		return NULL;
+	}
+	ResourceTrackerEntry *pEntry = &pTracker->entries[pTracker->dwEntryCount++];
+	pEntry->pTracked = pTracked;
+	pEntry->dwState = pTracked->dwState;
+	pEntry->bUsed = 0;
+	pEntry->bPromoted = 0;
+	pEntry->dwPendingBarrier = -1;
+	return pEntry;
+}
+
+inline
+bool TrackedStateIsReadOnly( u32 dwState )
+{
+	return dwState != TRACKED_STATE_COMMON && ( dwState & ~TRACKED_STATE_READ_ONLY_MASK ) == 0;
+}
+
+//declares the next Dispatch/Copy uses pTracked in dwState, consecutive UAV uses get a UAV barrier between them
+//false when the tracker is out of room, the caller has to flush (or the list touches too many resources)
+inline
+bool TrackResourceState( ResourceStateTracker *pTracker, TrackedResource *pTracked, u32 dwState )
+{
+	ResourceTrackerEntry *pEntry = ResourceStateTrackerFind( pTracker, pTracked );
+	if( !pEntry || pTracker->dwPendingCount == RESOURCE_TRACKER_MAX_BARRIERS )
+	{
+		return false;
+	}
+	++pTracker->stats.dwDeclaredUses;
+	const bool bUsed = pEntry->bUsed;
+	pEntry->bUsed = 1;
+
+	if( dwState == TRACKED_STATE_UNORDERED_ACCESS && pEntry->dwState == TRACKED_STATE_UNORDERED_ACCESS && bUsed )
+	{
+		//write after write/read between dispatches, one UAV barrier per flush is enough
+		if( pEntry->dwPendingBarrier < 0 )
+		{
+			pEntry->dwPendingBarrier = (s32)pTracker->dwPendingCount;
+			ResourceBarrierDesc *pBarrier = &pTracker->pending[pTracker->dwPendingCount++];
+			pBarrier->eType = RESOURCE_BARRIER_UAV;
+			pBarrier->pResource = pTracked->pResource;
+			pBarrier->dwStateBefore = TRACKED_STATE_UNORDERED_ACCESS;
+			pBarrier->dwStateAfter = TRACKED_STATE_UNORDERED_ACCESS;
+		}
+		return true;
+	}
+	if( pEntry->dwState == dwState || ( TrackedStateIsReadOnly( dwState ) && ( pEntry->dwState & dwState ) == dwState ) )
+	{
+		++pTracker->stats.dwDroppedTransitions;
+		return true;
+	}
+	//promotion out of COMMON, read states keep accumulating until something needs a write state
+	if( pTracked->bDecays && ( pEntry->dwState == TRACKED_STATE_COMMON || ( pEntry->bPromoted && TrackedStateIsReadOnly( pEntry->dwState ) && TrackedStateIsReadOnly( dwState ) ) ) &&
+		pEntry->dwPendingBarrier < 0 )
+	{
+		pEntry->dwState = pEntry->dwState | dwState;
+		pEntry->bPromoted = 1;
+		++pTracker->stats.dwImplicitPromotions;
+		return true;
+	}
+
+	if( pEntry->dwPendingBarrier >= 0 && pTracker->pending[pEntry->dwPendingBarrier].eType == RESOURCE_BARRIER_TRANSITION )
+	{
+		//the resource hasn't been used in the state of the pending transition yet, retarget it
+		ResourceBarrierDesc *pBarrier = &pTracker->pending[pEntry->dwPendingBarrier];
+		pBarrier->dwStateAfter = dwState;
+		pEntry->dwState = dwState;
+		++pTracker->stats.dwDroppedTransitions;
+		if( pBarrier->dwStateBefore == dwState )
+		{
+			//back where it started, drop the barrier by moving the last one into its place
+			const u32 dwLast = --pTracker->dwPendingCount;
+			if( (u32)pEntry->dwPendingBarrier != dwLast )
+			{
+				pTracker->pending[pEntry->dwPendingBarrier] = pTracker->pending[dwLast];
+				for( u32 dwOther = 0; dwOther < pTracker->dwEntryCount; ++dwOther )
+				{
+					if( pTracker->entries[dwOther].dwPendingBarrier == (s32)dwLast )
+					{
+						pTracker->entries[dwOther].dwPendingBarrier = pEntry->dwPendingBarrier;
+					}
+				}
+			}
+			pEntry->dwPendingBarrier = -1;
+		}
+		return true;
+	}
+
+	//a pending UAV barrier is covered by the transition out of UAV
+	s32 dwBarrier = pEntry->dwPendingBarrier >= 0 ? pEntry->dwPendingBarrier : (s32)pTracker->dwPendingCount++;
+	ResourceBarrierDesc *pBarrier = &pTracker->pending[dwBarrier];
+	pBarrier->eType = RESOURCE_BARRIER_TRANSITION;
+	pBarrier->pResource = pTracked->pResource;
+	pBarrier->dwStateBefore = pEntry->dwState;
+	pBarrier->dwStateAfter = dwState;
+	pEntry->dwPendingBarrier = dwBarrier;
+	pEntry->dwState = dwState;
+	pEntry->bPromoted = 0;
+	return true;
+}
+
+//pAfter takes over heap memory pBefore (or several resources, NULL) used, goes out with the next flush ahead of the
+//transitions declared after it, declare it before the first use of pAfter
+inline
+bool TrackResourceAliasing( ResourceStateTracker *pTracker, TrackedResource *pBefore, TrackedResource *pAfter )
+{
+	if( pTracker->dwPendingCount == RESOURCE_TRACKER_MAX_BARRIERS )
+	{
+		return false;
+	}
+	ResourceBarrierDesc *pBarrier = &pTracker->pending[pTracker->dwPendingCount++];
+	pBarrier->eType = RESOURCE_BARRIER_ALIASING;
+	pBarrier->pResource = pAfter->pResource;
+	pBarrier->pResourceBefore = pBefore ? pBefore->pResource : NULL;
+	pBarrier->dwStateBefore = TRACKED_STATE_COMMON;
+	pBarrier->dwStateAfter = TRACKED_STATE_COMMON;
+	return true;
+}
+
+//copies out the batch to record with a single ResourceBarrier() call, returns how many barriers there are
+inline
+u32 FlushResourceBarriers( ResourceStateTracker *pTracker, ResourceBarrierDesc *pBarriers )
+{
+	const u32 dwCount = pTracker->dwPendingCount;
+	for( u32 dwBarrier = 0; dwBarrier < dwCount; ++dwBarrier )
+	{
+		pBarriers[dwBarrier] = pTracker->pending[dwBarrier];
+	}
+	for( u32 dwEntry = 0; dwEntry < pTracker->dwEntryCount; ++dwEntry )
+	{
+		pTracker->entries[dwEntry].dwPendingBarrier = -1;
+	}
+	pTracker->dwPendingCount = 0;
+	pTracker->stats.dwEmittedBarriers += dwCount;
+	pTracker->stats.dwBarrierCalls += dwCount > 0;
+	return dwCount;
+}
+
+//call with the command list Close, after the last flush, stores the state every resource leaves the list in
+inline
+void ResourceStateTrackerClose( ResourceStateTracker *pTracker )
+{
+	for( u32 dwEntry = 0; dwEntry < pTracker->dwEntryCount; ++dwEntry )
+	{
+		ResourceTrackerEntry *pEntry = &pTracker->entries[dwEntry];
+		pEntry->pTracked->dwState = pEntry->pTracked->bDecays ? TRACKED_STATE_COMMON : pEntry->dwState;
+	}
+	ResourceStateTrackerReset( pTracker );
+}
+
+#endif
@@ -0,0 +1,611 @@
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+//appends completed readback regions to a file with many writes in flight, so the thread recycling the readback arena never
+//waits on the disk, it only hands a span over and later releases everything up to ResultSinkPoll()'s fence value
+//linux goes through io_uring (raw syscalls, no liburing), windows through overlapped WriteFile
+//writes whose memory, size and file offset are all RESULT_SINK_DIRECT_ALIGNMENT aligned bypass the page cache
+//(O_DIRECT / FILE_FLAG_NO_BUFFERING), the rest goes through a second, buffered handle to the same file
+//memory registered with ResultSinkRegisterBuffer() (the whole readback arena) is pinned once and written with
+//IORING_OP_WRITE_FIXED instead of being mapped for every write
+//only one thread should use a sink
+
+#include "Common.h"
+#include "Timer.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define RESULT_SINK_MAX_IN_FLIGHT 64
+#define RESULT_SINK_DIRECT_ALIGNMENT 4096 //logical block size of anything we write to, and the page size
+#define RESULT_SINK_LATENCY_SUB_LOG2 2    //4 linear steps inside every power of 2 of ns, percentiles are within 25%
+#define RESULT_SINK_LATENCY_BUCKETS ( 64 << RESULT_SINK_LATENCY_SUB_LOG2 )
+
+typedef struct ResultSinkWrite
+{
+	const u8 *pData;   //what is left to write, short writes move it forward and go out again
+	u64 qwOffset;      //in the file
+	u64 qwSize;
+	u64 qwFenceValue;
+	u64 qwSubmitNs;    //of the ResultSinkAppend(), the latency covers retries of short writes
+	bool bDirect;
+	bool bDone;
+#if defined(_WIN32)
+	OVERLAPPED overlapped;
+#endif
+} ResultSinkWrite;
+
+typedef struct ResultSink
+{
+	ResultSinkWrite writes[RESULT_SINK_MAX_IN_FLIGHT]; //in append order
+	u32 dwFirstWrite;
+	u32 dwWriteCount;
+	u32 dwQueueDepth;
+	u64 qwFileSize;            //bytes appended so far, the offset of the next append
+	u64 qwCompletedFenceValue; //every region appended with a value <= this was written
+	const u8 *pRegistered;     //0 or 1 registered buffer
+	u64 qwRegisteredSize;
+	bool bFailed;
+	//stats
+	u64 qwStartNs;
+	u64 qwBytesWritten;
+	u64 qwWrites;
+	u64 qwDirectWrites;
+	u64 qwFixedWrites;
+	u64 qwShortWrites;
+	u64 qwFullStalls;          //appends that waited for a write because dwQueueDepth were in flight
+	u64 qwMaxLatencyNs;
+	u32 dwLatencyBuckets[RESULT_SINK_LATENCY_BUCKETS];
+#if defined(_WIN32)
+	HANDLE hFile;
+	HANDLE hDirectFile;        //INVALID_HANDLE_VALUE when the volume does not take unbuffered writes
+#else
+	int fd;
+	int directFd;              //-1 when the file system does not take O_DIRECT (tmpfs)
+	int ringFd;
+	void *pSqRing;
+	u64 qwSqRingSize;
+	void *pCqRing;             //same as pSqRing with IORING_FEAT_SINGLE_MMAP
+	u64 qwCqRingSize;
+	struct io_uring_sqe *pSqes;
+	u64 qwSqesSize;
+	u32 *pSqHead;
+	u32 *pSqTail;
+	u32 *pSqArray;
+	u32 dwSqMask;
+	u32 *pCqHead;
+	u32 *pCqTail;
+	u32 dwCqMask;
+	struct io_uring_cqe *pCqes;
+#endif
+} ResultSink;
+
+inline
+u32 ResultSinkLatencyBucket( u64 qwNs )
+{
+	if( qwNs < ( 1ull << RESULT_SINK_LATENCY_SUB_LOG2 ) )
+	{
+		return (u32)qwNs;
+	}
+	u32 dwLog2 = 63;
+	while( !( qwNs >> dwLog2 ) )
+	{
+		--dwLog2;
+	}
+	const u32 dwSub = (u32)( qwNs >> ( dwLog2 - RESULT_SINK_LATENCY_SUB_LOG2 ) ) & ( ( 1u << RESULT_SINK_LATENCY_SUB_LOG2 ) - 1 );
+	return ( ( dwLog2 - RESULT_SINK_LATENCY_SUB_LOG2 + 1 ) << RESULT_SINK_LATENCY_SUB_LOG2 ) | dwSub;
+}
+
+//upper bound of the bucket
+inline
+u64 ResultSinkLatencyBucketNs( u32 dwBucket )
+{
+	if( dwBucket < ( 1u << RESULT_SINK_LATENCY_SUB_LOG2 ) )
+	{
+		return dwBucket;
+	}
+	const u32 dwLog2 = ( dwBucket >> RESULT_SINK_LATENCY_SUB_LOG2 ) + RESULT_SINK_LATENCY_SUB_LOG2 - 1;
+	const u64 qwSub = dwBucket & ( ( 1u << RESULT_SINK_LATENCY_SUB_LOG2 ) - 1 );
+	return ( ( ( 1ull << RESULT_SINK_LATENCY_SUB_LOG2 ) + qwSub + 1 ) << ( dwLog2 - RESULT_SINK_LATENCY_SUB_LOG2 ) ) - 1;
+}
+
+//append to completion time of the writes so far, fPercentile in 0..100
+inline
+u64 ResultSinkLatencyPercentileNs( const ResultSink *pSink, f64 fPercentile )
+{
+	if( pSink->qwWrites == 0 )
+	{
+		return 0;
+	}
+	u64 qwRank = (u64)( fPercentile / 100.0 * pSink->qwWrites + 0.5 );
+	qwRank = qwRank == 0 ? 1 : qwRank;
+	u64 qwSeen = 0;
+	for( u32 dwBucket = 0; dwBucket < RESULT_SINK_LATENCY_BUCKETS; ++dwBucket )
+	{
+		qwSeen += pSink->dwLatencyBuckets[dwBucket];
+		if( qwSeen >= qwRank )
+		{
+			const u64 qwNs = ResultSinkLatencyBucketNs( dwBucket );
+			return qwNs < pSink->qwMaxLatencyNs ? qwNs : pSink->qwMaxLatencyNs;
+		}
+	}
+	return pSink->qwMaxLatencyNs;
+}
+
+//marks the write done and moves qwCompletedFenceValue over the writes that are done in append order
+inline
+void ResultSinkRetireWrite( ResultSink *pSink, ResultSinkWrite *pWrite )
+{
+	const u64 qwLatencyNs = GetTimeNs() - pWrite->qwSubmitNs;
+	++pSink->dwLatencyBuckets[ResultSinkLatencyBucket( qwLatencyNs )];
+	pSink->qwMaxLatencyNs = qwLatencyNs > pSink->qwMaxLatencyNs ? qwLatencyNs : pSink->qwMaxLatencyNs;
+	++pSink->qwWrites;
+	pWrite->bDone = true;
+	while( pSink->dwWriteCount > 0 && pSink->writes[pSink->dwFirstWrite].bDone )
+	{
+		const u64 qwFenceValue = pSink->writes[pSink->dwFirstWrite].qwFenceValue;
+		pSink->qwCompletedFenceValue = qwFenceValue > pSink->qwCompletedFenceValue ? qwFenceValue : pSink->qwCompletedFenceValue;
+		pSink->dwFirstWrite = ( pSink->dwFirstWrite + 1 ) % RESULT_SINK_MAX_IN_FLIGHT;
+		--pSink->dwWriteCount;
+	}
+}
+
+inline
+void InitResultSinkStats( ResultSink *pSink )
+{
+	pSink->dwFirstWrite = 0;
+	pSink->dwWriteCount = 0;
+	pSink->qwFileSize = 0;
+	pSink->qwCompletedFenceValue = 0;
+	pSink->pRegistered = NULL;
+	pSink->qwRegisteredSize = 0;
+	pSink->bFailed = false;
+	pSink->qwStartNs = GetTimeNs();
+	pSink->qwBytesWritten = 0;
+	pSink->qwWrites = 0;
+	pSink->qwDirectWrites = 0;
+	pSink->qwFixedWrites = 0;
+	pSink->qwShortWrites = 0;
+	pSink->qwFullStalls = 0;
+	pSink->qwMaxLatencyNs = 0;
+	memset( pSink->dwLatencyBuckets, 0, sizeof(pSink->dwLatencyBuckets) );
+}
+
+inline
+bool ResultSinkIsDirect( const ResultSink *pSink, const u8 *pData, u64 qwSize, u64 qwOffset )
+{
+#if defined(_WIN32)
+	const bool bHasDirect = pSink->hDirectFile != INVALID_HANDLE_VALUE;
+#else
+	const bool bHasDirect = pSink->directFd >= 0;
+#endif
+	return bHasDirect && ( ( (u64)pData | qwSize | qwOffset ) & ( RESULT_SINK_DIRECT_ALIGNMENT - 1 ) ) == 0;
+}
+
+#if defined(_WIN32)
+
+inline
+bool ResultSinkSubmitWrite( ResultSink *pSink, ResultSinkWrite *pWrite )
+{
+	memset( &pWrite->overlapped, 0, sizeof(pWrite->overlapped) );
+	pWrite->overlapped.Offset = (DWORD)pWrite->qwOffset;
+	pWrite->overlapped.OffsetHigh = (DWORD)( pWrite->qwOffset >> 32 );
+	pWrite->overlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+	const DWORD dwSize = pWrite->qwSize > 0x80000000ull ? 0x80000000u : (DWORD)pWrite->qwSize; //bigger writes go out as short writes
+	if( !WriteFile( pWrite->bDirect ? pSink->hDirectFile : pSink->hFile, pWrite->pData, dwSize, NULL, &pWrite->overlapped ) &&
+		GetLastError() != ERROR_IO_PENDING )
+	{
+		CloseHandle( pWrite->overlapped.hEvent );
+		return false;
+	}
+	return true;
+}
+
+//bWait blocks for the oldest write in flight
+inline
+void ResultSinkReap( ResultSink *pSink, bool bWait )
+{
+	for( u32 dwWrite = 0; dwWrite < pSink->dwWriteCount; ++dwWrite )
+	{
+		ResultSinkWrite *pWrite = &pSink->writes[( pSink->dwFirstWrite + dwWrite ) % RESULT_SINK_MAX_IN_FLIGHT];
+		if( pWrite->bDone )
+		{
+			continue;
+		}
+		DWORD dwWritten;
+		if( !GetOverlappedResult( pWrite->bDirect ? pSink->hDirectFile : pSink->hFile, &pWrite->overlapped, &dwWritten, bWait && dwWrite == 0 ) )
+		{
+			if( GetLastError() == ERROR_IO_INCOMPLETE )
+			{
+				continue;
+			}
+			dwWritten = 0;
+			pSink->bFailed = true;
+		}
+		CloseHandle( pWrite->overlapped.hEvent );
+		pSink->qwBytesWritten += dwWritten;
+		if( dwWritten > 0 && dwWritten < pWrite->qwSize )
+		{
+			++pSink->qwShortWrites;
+			pWrite->pData += dwWritten;
+			pWrite->qwOffset += dwWritten;
+			pWrite->qwSize -= dwWritten;
+			pWrite->bDirect = ResultSinkIsDirect( pSink, pWrite->pData, pWrite->qwSize, pWrite->qwOffset );
+			if( ResultSinkSubmitWrite( pSink, pWrite ) )
+			{
+				continue;
+			}
+			pSink->bFailed = true;
+		}
+		ResultSinkRetireWrite( pSink, pWrite );
+		dwWrite = (u32)-1; //retiring moves dwFirstWrite, start over
+		bWait = false;
+	}
+}
+
+inline
+bool OpenResultSinkFile( ResultSink *pSink, const char *pPath, u32 dwQueueDepth )
+{
+	pSink->hFile = CreateFileA( pPath, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, NULL );
+	if( pSink->hFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+	pSink->hDirectFile = CreateFileA( pPath, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+									  FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, NULL );
+	return true;
+}
+
+inline
+void CloseResultSinkFile( ResultSink *pSink )
+{
+	if( pSink->hDirectFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( pSink->hDirectFile );
+	}
+	if( pSink->hFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( pSink->hFile );
+	}
+	pSink->hDirectFile = INVALID_HANDLE_VALUE;
+	pSink->hFile = INVALID_HANDLE_VALUE;
+}
+
+//overlapped WriteFile has nothing to register, the memory is locked per write
+inline
+bool ResultSinkRegisterBuffer( ResultSink *pSink, const u8 *pBase, u64 qwSize )
+{
+	return false;
+}
+
+#else
+
+inline
+int ResultSinkUringEnter( int ringFd, u32 dwToSubmit, u32 dwMinComplete )
+{
+	return (int)syscall( __NR_io_uring_enter, ringFd, dwToSubmit, dwMinComplete, dwMinComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+}
+
+//the write's index in pSink->writes goes in user_data
+inline
+bool ResultSinkSubmitWrite( ResultSink *pSink, ResultSinkWrite *pWrite )
+{
+	const u32 dwTail = *pSink->pSqTail; //only this thread moves the tail
+	if( dwTail - __atomic_load_n( pSink->pSqHead, __ATOMIC_ACQUIRE ) > pSink->dwSqMask )
+	{
+		return false;
+	}
+	const u32 dwIndex = dwTail & pSink->dwSqMask;
+	struct io_uring_sqe *pSqe = &pSink->pSqes[dwIndex];
+	memset( pSqe, 0, sizeof(*pSqe) );
+	const bool bFixed = pWrite->pData >= pSink->pRegistered && pWrite->pData + pWrite->qwSize <= pSink->pRegistered + pSink->qwRegisteredSize;
+	pSqe->opcode = bFixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	pSqe->fd = pWrite->bDirect ? pSink->directFd : pSink->fd;
+	pSqe->off = pWrite->qwOffset;
+	pSqe->addr = (u64)pWrite->pData;
+	pSqe->len = pWrite->qwSize > 0x7ffff000ull ? 0x7ffff000u : (u32)pWrite->qwSize; //what write() takes at most, the rest goes out as a short write
+	pSqe->buf_index = 0;
+	pSqe->user_data = (u64)( pWrite - pSink->writes );
+	pSink->pSqArray[dwIndex] = dwIndex;
+	__atomic_store_n( pSink->pSqTail, dwTail + 1, __ATOMIC_RELEASE );
+	int iSubmitted;
+	do
+	{
+		iSubmitted = ResultSinkUringEnter( pSink->ringFd, 1, 0 );
+	} while( iSubmitted < 0 && errno == EINTR );
+	if( iSubmitted != 1 )
+	{
+		return false;
+	}
+	pSink->qwFixedWrites += bFixed;
+	return true;
+}
+
+//bWait blocks until at least one write completes
+inline
+void ResultSinkReap( ResultSink *pSink, bool bWait )
+{
+	if( bWait )
+	{
+		while( ResultSinkUringEnter( pSink->ringFd, 0, 1 ) < 0 && errno == EINTR )
+		{
+		}
+	}
+	u32 dwHead = *pSink->pCqHead;
+	const u32 dwTail = __atomic_load_n( pSink->pCqTail, __ATOMIC_ACQUIRE );
+	for( ; dwHead != dwTail; ++dwHead )
+	{
+		const struct io_uring_cqe *pCqe = &pSink->pCqes[dwHead & pSink->dwCqMask];
+		ResultSinkWrite *pWrite = &pSink->writes[pCqe->user_data];
+		const s32 iResult = pCqe->res;
+		if( iResult == -EAGAIN || iResult == -EINTR || ( iResult > 0 && (u64)iResult < pWrite->qwSize ) )
+		{
+			//the rest goes out again, a direct write that came back short continues buffered if it is no longer aligned
+			if( iResult > 0 )
+			{
+				++pSink->qwShortWrites;
+				pSink->qwBytesWritten += (u64)iResult;
+				pWrite->pData += iResult;
+				pWrite->qwOffset += (u64)iResult;
+				pWrite->qwSize -= (u64)iResult;
+				pWrite->bDirect = ResultSinkIsDirect( pSink, pWrite->pData, pWrite->qwSize, pWrite->qwOffset );
+			}
+			if( ResultSinkSubmitWrite( pSink, pWrite ) )
+			{
+				continue;
+			}
+			pSink->bFailed = true;
+		}
+		else if( iResult <= 0 )
+		{
+			pSink->bFailed = true;
+		}
+		else
+		{
+			pSink->qwBytesWritten += (u64)iResult;
+		}
+		ResultSinkRetireWrite( pSink, pWrite );
+	}
+	__atomic_store_n( pSink->pCqHead, dwHead, __ATOMIC_RELEASE );
+}
+
+inline
+void CloseResultSinkFile( ResultSink *pSink )
+{
+	if( pSink->pSqes )
+	{
+		munmap( pSink->pSqes, pSink->qwSqesSize );
+	}
+	if( pSink->pCqRing && pSink->pCqRing != pSink->pSqRing )
+	{
+		munmap( pSink->pCqRing, pSink->qwCqRingSize );
+	}
+	if( pSink->pSqRing )
+	{
+		munmap( pSink->pSqRing, pSink->qwSqRingSize );
+	}
+	if( pSink->ringFd >= 0 )
+	{
+		close( pSink->ringFd ); //also unregisters the buffer
+	}
+	if( pSink->directFd >= 0 )
+	{
+		close( pSink->directFd );
+	}
+	if( pSink->fd >= 0 )
+	{
+		close( pSink->fd );
+	}
+	pSink->pSqes = NULL;
+	pSink->pCqRing = NULL;
+	pSink->pSqRing = NULL;
+	pSink->ringFd = -1;
+	pSink->directFd = -1;
+	pSink->fd = -1;
+}
+
+inline
+bool OpenResultSinkFile( ResultSink *pSink, const char *pPath, u32 dwQueueDepth )
+{
+	pSink->pSqes = NULL;
+	pSink->pCqRing = NULL;
+	pSink->pSqRing = NULL;
+	pSink->ringFd = -1;
+	pSink->directFd = -1;
+	pSink->fd = open( pPath, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( pSink->fd < 0 )
+	{
+		return false;
+	}
+	pSink->directFd = open( pPath, O_WRONLY | O_DIRECT );
+
+	struct io_uring_params params;
+	memset( &params, 0, sizeof(params) );
+	pSink->ringFd = (int)syscall( __NR_io_uring_setup, dwQueueDepth, &params );
+	if( pSink->ringFd < 0 )
+	{
+		CloseResultSinkFile( pSink );
+		return false;
+	}
+	pSink->qwSqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+	pSink->qwCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if( params.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		pSink->qwSqRingSize = pSink->qwCqRingSize > pSink->qwSqRingSize ? pSink->qwCqRingSize : pSink->qwSqRingSize;
+		pSink->qwCqRingSize = pSink->qwSqRingSize;
+	}
+	void *pSqRing = mmap( NULL, pSink->qwSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pSink->ringFd, IORING_OFF_SQ_RING );
+	if( pSqRing == MAP_FAILED )
+	{
+		CloseResultSinkFile( pSink );
+		return false;
+	}
+	pSink->pSqRing = pSqRing;
+	if( params.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		pSink->pCqRing = pSqRing;
+	}
+	else
+	{
+		void *pCqRing = mmap( NULL, pSink->qwCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pSink->ringFd, IORING_OFF_CQ_RING );
+		if( pCqRing == MAP_FAILED )
+		{
+			CloseResultSinkFile( pSink );
+			return false;
+		}
+		pSink->pCqRing = pCqRing;
+	}
+	pSink->qwSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *pSqes = mmap( NULL, pSink->qwSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pSink->ringFd, IORING_OFF_SQES );
+	if( pSqes == MAP_FAILED )
+	{
+		CloseResultSinkFile( pSink );
+		return false;
+	}
+	pSink->pSqes = (struct io_uring_sqe*)pSqes;
+
+	u8 *pSq = (u8*)pSink->pSqRing;
+	u8 *pCq = (u8*)pSink->pCqRing;
+	pSink->pSqHead = (u32*)( pSq + params.sq_off.head );
+	pSink->pSqTail = (u32*)( pSq + params.sq_off.tail );
+	pSink->pSqArray = (u32*)( pSq + params.sq_off.array );
+	pSink->dwSqMask = *(u32*)( pSq + params.sq_off.ring_mask );
+	pSink->pCqHead = (u32*)( pCq + params.cq_off.head );
+	pSink->pCqTail = (u32*)( pCq + params.cq_off.tail );
+	pSink->dwCqMask = *(u32*)( pCq + params.cq_off.ring_mask );
+	pSink->pCqes = (struct io_uring_cqe*)( pCq + params.cq_off.cqes );
+	return true;
+}
+
+//pins pBase..pBase + qwSize once, appends from inside it skip the per write page mapping
+//fails (and the sink keeps working without it) when the memlock limit is too low
+inline
+bool ResultSinkRegisterBuffer( ResultSink *pSink, const u8 *pBase, u64 qwSize )
+{
+	if( pSink->pRegistered )
+	{
+		return false;
+	}
+	struct iovec buffer;
+	buffer.iov_base = (void*)pBase;
+	buffer.iov_len = qwSize;
+	if( syscall( __NR_io_uring_register, pSink->ringFd, IORING_REGISTER_BUFFERS, &buffer, 1 ) != 0 )
+	{
+		return false;
+	}
+	pSink->pRegistered = pBase;
+	pSink->qwRegisteredSize = qwSize;
+	return true;
+}
+
+#endif
+
+//creates pPath, dwQueueDepth writes (1..RESULT_SINK_MAX_IN_FLIGHT) can be in flight at once
+inline
+bool OpenResultSink( ResultSink *pSink, const char *pPath, u32 dwQueueDepth )
+{
+	InitResultSinkStats( pSink );
+	if( dwQueueDepth == 0 || dwQueueDepth > RESULT_SINK_MAX_IN_FLIGHT )
+	{
+		return false;
+	}
+	pSink->dwQueueDepth = dwQueueDepth;
+	return OpenResultSinkFile( pSink, pPath, dwQueueDepth );
+}
+
+//reaps whatever completed without blocking, every region appended with a fence value <= the returned one was written
+//and can be released (ReadbackArenaRelease())
+inline
+u64 ResultSinkPoll( ResultSink *pSink )
+{
+	if( pSink->dwWriteCount > 0 )
+	{
+		ResultSinkReap( pSink, false );
+	}
+	return pSink->qwCompletedFenceValue;
+}
+
+//blocks until at least one more write completed, when nothing is in flight it returns right away
+inline
+u64 ResultSinkWait( ResultSink *pSink )
+{
+	if( pSink->dwWriteCount > 0 )
+	{
+		ResultSinkReap( pSink, true );
+	}
+	return pSink->qwCompletedFenceValue;
+}
+
+//queues a write of pData at the end of the file, pData has to stay valid until ResultSinkPoll() passes qwFenceValue
+//fence values can't go down between appends, only blocks when dwQueueDepth writes are in flight
+inline
+bool ResultSinkAppend( ResultSink *pSink, const u8 *pData, u64 qwSize, u64 qwFenceValue )
+{
+	if( pSink->bFailed || qwSize == 0 )
+	{
+		return !pSink->bFailed;
+	}
+	ResultSinkReap( pSink, false );
+	while( pSink->dwWriteCount == pSink->dwQueueDepth && !pSink->bFailed )
+	{
+		++pSink->qwFullStalls;
+		ResultSinkReap( pSink, true );
+	}
+	if( pSink->bFailed )
+	{
+		return false;
+	}
+	ResultSinkWrite *pWrite = &pSink->writes[( pSink->dwFirstWrite + pSink->dwWriteCount ) % RESULT_SINK_MAX_IN_FLIGHT];
+	pWrite->pData = pData;
+	pWrite->qwOffset = pSink->qwFileSize;
+	pWrite->qwSize = qwSize;
+	pWrite->qwFenceValue = qwFenceValue;
+	pWrite->qwSubmitNs = GetTimeNs();
+	pWrite->bDirect = ResultSinkIsDirect( pSink, pData, qwSize, pSink->qwFileSize );
+	pWrite->bDone = false;
+	if( !ResultSinkSubmitWrite( pSink, pWrite ) )
+	{
+		pSink->bFailed = true;
+		return false;
+	}
+	++pSink->dwWriteCount;
+	pSink->qwDirectWrites += pWrite->bDirect;
+	pSink->qwFileSize += qwSize;
+	return true;
+}
+
+//waits for every write in flight, false if any of them failed
+//keeps reaping after a failure, the kernel may still read the buffers of the other writes until they complete
+inline
+bool ResultSinkFlush( ResultSink *pSink )
+{
+	while( pSink->dwWriteCount > 0 )
+	{
+		ResultSinkReap( pSink, true );
+	}
+	return !pSink->bFailed;
+}
+
+inline
+bool CloseResultSink( ResultSink *pSink )
+{
+	const bool bFlushed = ResultSinkFlush( pSink );
+	CloseResultSinkFile( pSink );
+	return bFlushed;
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+//cpu version of Scan.hlsl, the same three passes with the same buffer layouts run as CpuDispatch()es
+//results are bit exact with the gpu (u32 adds wrap the same in any order), so either backend can produce data the other consumes
+//the root constants are the same 4 DWORDs: input byte offset, element count, head flags byte offset (or SCAN_NO_SEGMENTS), SCAN_FLAG_*
+//t0 is the input blob, u0 the u32 output, u1 the block partials (ScanScratchSize() bytes)
+
+#include "Common.h"
+#include "CpuCompute.h"
+
+#include <string.h>
+
+#define SCAN_THREADS 256
+#define SCAN_ITEMS_PER_THREAD 4
+#define SCAN_BLOCK_SIZE 1024 //SCAN_THREADS * SCAN_ITEMS_PER_THREAD
+#define SCAN_NO_SEGMENTS 0xFFFFFFFF
+#define SCAN_FLAG_INCLUSIVE 1
+#define SCAN_MAX_COUNT ( 65535u * SCAN_BLOCK_SIZE ) //one group per block and Dispatch() takes at most 65535 groups in x
+
+typedef struct ScanPair
+{
+	u32 dwHead;
+	u32 dwValue;
+} ScanPair;
+
+typedef struct ScanKernels
+{
+	CpuComputeKernel reduceBlocks;
+	CpuComputeKernel blockPartials;
+	CpuComputeKernel downsweep;
+} ScanKernels;
+
+inline
+u32 ScanBlockCount( u32 dwCount )
+{
+	return ( dwCount + SCAN_BLOCK_SIZE - 1 ) / SCAN_BLOCK_SIZE;
+}
+
+//one pair per block plus the total
+inline
+u64 ScanScratchSize( u32 dwCount )
+{
+	return ( (u64)ScanBlockCount( dwCount ) + 1 ) * sizeof(ScanPair);
+}
+
+inline
+ComputeShaderCB MakeScanCB( u32 dwInputOffset, u32 dwCount, u32 dwHeadsOffset, u32 dwFlags )
+{
+	ComputeShaderCB cb;
+	cb.dwOffsetsAndStrides0[0] = dwInputOffset;
+	cb.dwOffsetsAndStrides0[1] = dwCount;
+	cb.dwOffsetsAndStrides0[2] = dwHeadsOffset;
+	cb.dwOffsetsAndStrides0[3] = dwFlags;
+	return cb;
+}
+
+//(0,0) is the identity, a head in b drops everything before it
+inline
+ScanPair ScanCombine( ScanPair a, ScanPair b )
+{
+	ScanPair result;
+	result.dwHead = a.dwHead | b.dwHead;
+	result.dwValue = b.dwHead ? b.dwValue : a.dwValue + b.dwValue;
+	return result;
+}
+
+//block level scan of up to SCAN_BLOCK_SIZE elements starting at carry, pOut can be NULL, returns the carry out of the block
+//pHeads is NULL for an unsegmented scan
+inline
+ScanPair ScanBlock( const u32 *pValues, const u32 *pHeads, u32 dwCount, ScanPair carry, u32 dwFlags, u32 *pOut )
+{
+	if( !pHeads )
+	{
+		//a head can only come from the carry, which already restarted the segment, so this is a plain prefix sum
+		u32 dwRunning = carry.dwValue;
+		if( !pOut )
+		{
+			for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+			{
+				dwRunning += pValues[dwIdx];
+			}
+		}
+		else if( dwFlags & SCAN_FLAG_INCLUSIVE )
+		{
+			for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+			{
+				dwRunning += pValues[dwIdx];
+				pOut[dwIdx] = dwRunning;
+			}
+		}
+		else
+		{
+			for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+			{
+				pOut[dwIdx] = dwRunning;
+				dwRunning += pValues[dwIdx];
+			}
+		}
+		carry.dwValue = dwRunning;
+		return carry;
+	}
+
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		ScanPair item;
+		item.dwHead = pHeads[dwIdx] != 0;
+		item.dwValue = pValues[dwIdx];
+		const ScanPair inclusive = ScanCombine( carry, item );
+		if( pOut )
+		{
+			pOut[dwIdx] = ( dwFlags & SCAN_FLAG_INCLUSIVE ) ? inclusive.dwValue : item.dwHead ? 0 : carry.dwValue;
+		}
+		carry = inclusive;
+	}
+	return carry;
+}
+
+//elements of block dwBlock, where they go and how many there are
+inline
+u32 ScanBlockRange( const CpuComputeRootArgs *pRoot, u32 dwBlock, const u32 **ppValues, const u32 **ppHeads )
+{
+	const u32 *pCB = pRoot->cb.dwOffsetsAndStrides0;
+	const u32 dwFirst = dwBlock * SCAN_BLOCK_SIZE;
+	*ppValues = (const u32*)( pRoot->pVerticesAndIndices + pCB[0] ) + dwFirst;
+	*ppHeads = pCB[2] == SCAN_NO_SEGMENTS ? NULL : (const u32*)( pRoot->pVerticesAndIndices + pCB[2] ) + dwFirst;
+	return pCB[1] - dwFirst < SCAN_BLOCK_SIZE ? pCB[1] - dwFirst : SCAN_BLOCK_SIZE;
+}
+
+//ScanReduceBlocks in Scan.hlsl
+inline
+void ScanReduceBlocksCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 *pValues;
+	const u32 *pHeads;
+	const u32 dwCount = ScanBlockRange( pRoot, Gid.x, &pValues, &pHeads );
+	const ScanPair identity = { 0, 0 };
+	( (ScanPair*)pRoot->pUavs[1] )[Gid.x] = ScanBlock( pValues, pHeads, dwCount, identity, SCAN_FLAG_INCLUSIVE, NULL );
+}
+
+//ScanBlockPartials in Scan.hlsl, dispatched as (1,1,1)
+inline
+void ScanBlockPartialsCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 dwBlockCount = ScanBlockCount( pRoot->cb.dwOffsetsAndStrides0[1] );
+	ScanPair *pPartials = (ScanPair*)pRoot->pUavs[1];
+	ScanPair carry = { 0, 0 };
+	for( u32 dwBlock = 0; dwBlock < dwBlockCount; ++dwBlock )
+	{
+		const ScanPair block = pPartials[dwBlock];
+		pPartials[dwBlock] = carry;
+		carry = ScanCombine( carry, block );
+	}
+	pPartials[dwBlockCount] = carry;
+}
+
+//ScanDownsweep in Scan.hlsl
+inline
+void ScanDownsweepCpu( const CpuComputeRootArgs *pRoot, CpuUint3 Gid, void *pGroupShared )
+{
+	const u32 *pValues;
+	const u32 *pHeads;
+	const u32 dwCount = ScanBlockRange( pRoot, Gid.x, &pValues, &pHeads );
+	ScanBlock( pValues, pHeads, dwCount, ( (const ScanPair*)pRoot->pUavs[1] )[Gid.x], pRoot->cb.dwOffsetsAndStrides0[3], (u32*)pRoot->pUavs[0] + Gid.x * SCAN_BLOCK_SIZE );
+}
+
+inline
+void InitScanKernel( CpuComputeKernel *pKernel, PFN_CpuComputeGroup pfnGroup )
+{
+	memset( pKernel, 0, sizeof(CpuComputeKernel) );
+	pKernel->pfnGroup = pfnGroup;
+	pKernel->dwNumThreads[0] = SCAN_THREADS;
+	pKernel->dwNumThreads[1] = 1;
+	pKernel->dwNumThreads[2] = 1;
+}
+
+inline
+void InitScanKernels( ScanKernels *pKernels )
+{
+	InitScanKernel( &pKernels->reduceBlocks, ScanReduceBlocksCpu );
+	InitScanKernel( &pKernels->blockPartials, ScanBlockPartialsCpu );
+	InitScanKernel( &pKernels->downsweep, ScanDownsweepCpu );
+}
+
+//same passes as RecordScan() in main.cpp, pRoot->cb comes from MakeScanCB(), pUavs[0] gets the scan, pUavs[1] the partials
+inline
+void CpuScan( CpuComputeDevice *pDevice, const ScanKernels *pKernels, const CpuComputeRootArgs *pRoot )
+{
+	assert( pRoot->cb.dwOffsetsAndStrides0[1] <= SCAN_MAX_COUNT );
+	const u32 dwBlockCount = ScanBlockCount( pRoot->cb.dwOffsetsAndStrides0[1] );
+	CpuDispatch( pDevice, &pKernels->reduceBlocks, pRoot, dwBlockCount, 1, 1 );
+	CpuDispatch( pDevice, &pKernels->blockPartials, pRoot, 1, 1, 1 );
+	CpuDispatch( pDevice, &pKernels->downsweep, pRoot, dwBlockCount, 1, 1 );
+}
+
+//sum of every element (of the last segment for a segmented reduce), also left in the last pair of pUavs[1]
+inline
+u32 CpuReduce( CpuComputeDevice *pDevice, const ScanKernels *pKernels, const CpuComputeRootArgs *pRoot )
+{
+	assert( pRoot->cb.dwOffsetsAndStrides0[1] <= SCAN_MAX_COUNT );
+	const u32 dwBlockCount = ScanBlockCount( pRoot->cb.dwOffsetsAndStrides0[1] );
+	CpuDispatch( pDevice, &pKernels->reduceBlocks, pRoot, dwBlockCount, 1, 1 );
+	CpuDispatch( pDevice, &pKernels->blockPartials, pRoot, 1, 1, 1 );
+	return ( (const ScanPair*)pRoot->pUavs[1] )[dwBlockCount].dwValue;
+}
+
+#endif
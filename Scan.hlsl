@@ -0,0 +1,160 @@
+//cs_5_0 way
+//prefix sum / reduction primitives over u32s in a ByteAddressBuffer, reduce-then-scan in three dispatches:
+//ScanReduceBlocks  one group per SCAN_BLOCK_SIZE elements, writes the block's total to BlockPartials
+//ScanBlockPartials one group, turns the block totals into the carry into every block (exclusive), the grand total goes after them
+//ScanDownsweep     one group per block, scans the block again starting from its carry
+//a reduce is the first two. Segmented scans restart at every element whose head flag is not 0, the scan works on (head, value) pairs
+//so segments can span blocks. Scan.h is the cpu version with the same layouts, it has to stay bit exact with this file
+cbuffer globalCB : register(b0)
+{
+    uint4 dwOffsetsAndStrides0; //x input byte offset, y element count, z head flags byte offset or SCAN_NO_SEGMENTS, w SCAN_FLAG_*
+};
+
+#define SCAN_THREADS 256
+#define SCAN_ITEMS_PER_THREAD 4
+#define SCAN_BLOCK_SIZE 1024 //SCAN_THREADS * SCAN_ITEMS_PER_THREAD
+#define SCAN_NO_SEGMENTS 0xFFFFFFFF
+#define SCAN_FLAG_INCLUSIVE 1
+
+ByteAddressBuffer verticesAndIndices : register( t0 );
+RWByteAddressBuffer Out : register( u0 );           //one u32 per element
+RWByteAddressBuffer BlockPartials : register( u1 ); //one (head, value) uint2 per block, then the total
+
+#define SCAN_ROOT_SIGNATURE "RootFlags( 0 ), RootConstants( num32BitConstants=4, b0, space = 0, visibility=SHADER_VISIBILITY_ALL ), SRV(t0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u0, space=0, visibility=SHADER_VISIBILITY_ALL), UAV(u1, space=0, visibility=SHADER_VISIBILITY_ALL)"
+
+groupshared uint2 scanShared[SCAN_THREADS];
+
+//(0,0) is the identity, a head in b drops everything before it
+uint2 ScanCombine( uint2 a, uint2 b )
+{
+	return uint2( a.x | b.x, b.x ? b.y : a.y + b.y );
+}
+
+uint2 LoadScanItem( uint dwIndex )
+{
+	uint2 item = uint2( 0, 0 );
+	if( dwIndex < dwOffsetsAndStrides0.y )
+	{
+		item.y = verticesAndIndices.Load( dwOffsetsAndStrides0.x + dwIndex * 4 );
+		if( dwOffsetsAndStrides0.z != SCAN_NO_SEGMENTS )
+		{
+			item.x = verticesAndIndices.Load( dwOffsetsAndStrides0.z + dwIndex * 4 ) != 0;
+		}
+	}
+	return item;
+}
+
+//block level inclusive scan of one pair per thread, scanShared holds every thread's inclusive prefix afterwards
+uint2 ScanGroupInclusive( uint2 value, uint GI )
+{
+	scanShared[GI] = value;
+	GroupMemoryBarrierWithGroupSync();
+	[unroll]
+	for( uint dwOffset = 1; dwOffset < SCAN_THREADS; dwOffset <<= 1 )
+	{
+		//an if and not ?:, fxc evaluates both sides of ?: and GI - dwOffset wraps past the end of scanShared
+		uint2 prev = uint2( 0, 0 );
+		if( GI >= dwOffset )
+		{
+			prev = scanShared[GI - dwOffset];
+		}
+		GroupMemoryBarrierWithGroupSync();
+		value = ScanCombine( prev, value );
+		scanShared[GI] = value;
+		GroupMemoryBarrierWithGroupSync();
+	}
+	return value;
+}
+
+//every thread owns SCAN_ITEMS_PER_THREAD consecutive elements
+[RootSignature(SCAN_ROOT_SIGNATURE)]
+[numthreads(SCAN_THREADS, 1, 1)]
+void ScanReduceBlocks( uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex )
+{
+	const uint dwFirst = Gid.x * SCAN_BLOCK_SIZE + GI * SCAN_ITEMS_PER_THREAD;
+	uint2 total = uint2( 0, 0 );
+	[unroll]
+	for( uint dwItem = 0; dwItem < SCAN_ITEMS_PER_THREAD; ++dwItem )
+	{
+		total = ScanCombine( total, LoadScanItem( dwFirst + dwItem ) );
+	}
+	total = ScanGroupInclusive( total, GI );
+	if( GI == SCAN_THREADS - 1 )
+	{
+		BlockPartials.Store2( Gid.x * 8, total );
+	}
+}
+
+//dispatched as (1,1,1), walks the block totals SCAN_BLOCK_SIZE at a time
+[RootSignature(SCAN_ROOT_SIGNATURE)]
+[numthreads(SCAN_THREADS, 1, 1)]
+void ScanBlockPartials( uint GI : SV_GroupIndex )
+{
+	const uint dwBlockCount = ( dwOffsetsAndStrides0.y + SCAN_BLOCK_SIZE - 1 ) / SCAN_BLOCK_SIZE;
+	uint2 carry = uint2( 0, 0 );
+	for( uint dwChunk = 0; dwChunk < dwBlockCount; dwChunk += SCAN_BLOCK_SIZE )
+	{
+		const uint dwFirst = dwChunk + GI * SCAN_ITEMS_PER_THREAD;
+		uint2 items[SCAN_ITEMS_PER_THREAD];
+		uint2 total = uint2( 0, 0 );
+		[unroll]
+		for( uint dwItem = 0; dwItem < SCAN_ITEMS_PER_THREAD; ++dwItem )
+		{
+			items[dwItem] = dwFirst + dwItem < dwBlockCount ? BlockPartials.Load2( ( dwFirst + dwItem ) * 8 ) : uint2( 0, 0 );
+			total = ScanCombine( total, items[dwItem] );
+		}
+		ScanGroupInclusive( total, GI );
+		uint2 running = carry;
+		if( GI > 0 )
+		{
+			running = ScanCombine( carry, scanShared[GI - 1] );
+		}
+		[unroll]
+		for( uint dwItem = 0; dwItem < SCAN_ITEMS_PER_THREAD; ++dwItem )
+		{
+			if( dwFirst + dwItem < dwBlockCount )
+			{
+				BlockPartials.Store2( ( dwFirst + dwItem ) * 8, running );
+			}
+			running = ScanCombine( running, items[dwItem] );
+		}
+		carry = ScanCombine( carry, scanShared[SCAN_THREADS - 1] );
+		GroupMemoryBarrierWithGroupSync(); //the next chunk overwrites scanShared
+	}
+	if( GI == 0 )
+	{
+		BlockPartials.Store2( dwBlockCount * 8, carry );
+	}
+}
+
+[RootSignature(SCAN_ROOT_SIGNATURE)]
+[numthreads(SCAN_THREADS, 1, 1)]
+void ScanDownsweep( uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex )
+{
+	const uint dwFirst = Gid.x * SCAN_BLOCK_SIZE + GI * SCAN_ITEMS_PER_THREAD;
+	uint2 items[SCAN_ITEMS_PER_THREAD];
+	uint2 total = uint2( 0, 0 );
+	[unroll]
+	for( uint dwItem = 0; dwItem < SCAN_ITEMS_PER_THREAD; ++dwItem )
+	{
+		items[dwItem] = LoadScanItem( dwFirst + dwItem );
+		total = ScanCombine( total, items[dwItem] );
+	}
+	ScanGroupInclusive( total, GI );
+	uint2 running = BlockPartials.Load2( Gid.x * 8 );
+	if( GI > 0 )
+	{
+		running = ScanCombine( running, scanShared[GI - 1] );
+	}
+	[unroll]
+	for( uint dwItem = 0; dwItem < SCAN_ITEMS_PER_THREAD; ++dwItem )
+	{
+		const uint2 inclusive = ScanCombine( running, items[dwItem] );
+		if( dwFirst + dwItem < dwOffsetsAndStrides0.y )
+		{
+			const uint dwExclusive = items[dwItem].x ? 0 : running.y;
+			Out.Store( ( dwFirst + dwItem ) * 4, ( dwOffsetsAndStrides0.w & SCAN_FLAG_INCLUSIVE ) ? inclusive.y : dwExclusive );
+		}
+		running = inclusive;
+	}
+}
@@ -0,0 +1,344 @@
+#ifndef SOA_ANIMATION_H
+#define SOA_ANIMATION_H
+
+//batch sampling of rigid instance animation into model matrices (the InitModelMat4ByQuatf() layout)
+//every instance has a looping track of uniformly spaced keys (rotation quaternion + position), stored as structure of arrays
+//streams so 8 instances are interpolated and turned into matrices per AVX2 instruction
+
+#include "Common.h"
+#include "Math3D.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define ANIM_STREAM_ALIGNMENT 32 //one ymm register
+#define ANIM_NUM_STREAMS 7
+
+#define ANIM_SAMPLE_NLERP 0 //normalized lerp only, cheapest, drifts from constant angular velocity on big key to key angles
+#define ANIM_SAMPLE_SLERP 1 //slerp, blocks of 8 where every key pair is within QUATF_NLERP_MIN_COS take the nlerp path
+
+//key dwKey of instance dwIdx is at pStreams[stream][dwKey * dwCapacity + dwIdx]
+typedef struct AnimationStreamsSoA
+{
+	union
+	{
+		f32 *pStreams[ANIM_NUM_STREAMS];
+		struct
+		{
+			f32 *pRotW;
+			f32 *pRotX;
+			f32 *pRotY;
+			f32 *pRotZ;
+			f32 *pPosX;
+			f32 *pPosY;
+			f32 *pPosZ;
+		};
+	};
+	u32 dwCount;
+	u32 dwCapacity; //multiple of 8, streams are padded so kernels never need a masked tail on loads
+	u32 dwKeyCount;
+	void *pAllocation;
+} AnimationStreamsSoA;
+
+inline
+bool AllocAnimationStreamsSoA( AnimationStreamsSoA *pStreams, u32 dwCapacity, u32 dwKeyCount )
+{
+	dwCapacity = ( dwCapacity + 7 ) & ~7u;
+	const u64 qwStreamSize = (u64)dwCapacity * dwKeyCount * sizeof(f32);
+	u8 *pBase = (u8*)malloc( qwStreamSize * ANIM_NUM_STREAMS + ANIM_STREAM_ALIGNMENT );
+	if( !pBase )
+	{
+		return false;
+	}
+	u8 *pAligned = (u8*)( ( (uintptr_t)pBase + ANIM_STREAM_ALIGNMENT - 1 ) & ~(uintptr_t)( ANIM_STREAM_ALIGNMENT - 1 ) );
+	memset( pAligned, 0, qwStreamSize * ANIM_NUM_STREAMS );
+	for( u32 dwStream = 0; dwStream < ANIM_NUM_STREAMS; ++dwStream )
+	{
+		pStreams->pStreams[dwStream] = (f32*)( pAligned + qwStreamSize * dwStream );
+	}
+	pStreams->dwCount = 0;
+	pStreams->dwCapacity = dwCapacity;
+	pStreams->dwKeyCount = dwKeyCount;
+	pStreams->pAllocation = pBase;
+	return true;
+}
+
+inline
+void FreeAnimationStreamsSoA( AnimationStreamsSoA *pStreams )
+{
+	free( pStreams->pAllocation );
+	memset( pStreams, 0, sizeof(AnimationStreamsSoA) );
+}
+
+inline
+void SetAnimationKey( AnimationStreamsSoA *pStreams, u32 dwIdx, u32 dwKey, const Quatf *pRot, const Vec3f *pPos )
+{
+	const u64 qwOffset = (u64)dwKey * pStreams->dwCapacity + dwIdx;
+	pStreams->pRotW[qwOffset] = pRot->w;
+	pStreams->pRotX[qwOffset] = pRot->x;
+	pStreams->pRotY[qwOffset] = pRot->y;
+	pStreams->pRotZ[qwOffset] = pRot->z;
+	pStreams->pPosX[qwOffset] = pPos->x;
+	pStreams->pPosY[qwOffset] = pPos->y;
+	pStreams->pPosZ[qwOffset] = pPos->z;
+}
+
+//fKeyTime in keys, wraps around dwKeyCount, returns the first key of the pair, *pT is the blend towards *pKey1
+inline
+u32 AnimationKeyPair( f32 fKeyTime, u32 dwKeyCount, u32 *pKey1, f32 *pT )
+{
+	const f32 fKeyCount = (f32)dwKeyCount;
+	const f32 fWrapped = fKeyTime - floorf( fKeyTime / fKeyCount ) * fKeyCount;
+	f32 fKey0 = floorf( fWrapped );
+	fKey0 = fKey0 < fKeyCount - 1.f ? fKey0 : fKeyCount - 1.f; //rounding can land fWrapped on fKeyCount
+	const u32 dwKey0 = (u32)fKey0;
+	*pKey1 = dwKey0 + 1 == dwKeyCount ? 0 : dwKey0 + 1;
+	*pT = fWrapped - fKey0;
+	return dwKey0;
+}
+
+//scalar reference through the Math3D functions, instances [dwBegin, dwEnd) into pOut[dwBegin..dwEnd)
+//pKeyTimes has a key time per instance, NULL samples every instance at fKeyTime
+inline
+void SampleAnimationStreamsScalar( const AnimationStreamsSoA *pStreams, u32 dwBegin, u32 dwEnd, const f32 *pKeyTimes, f32 fKeyTime, u32 dwMode, Mat4f *pOut )
+{
+	for( u32 dwIdx = dwBegin; dwIdx < dwEnd; ++dwIdx )
+	{
+		u32 dwKey1;
+		f32 fT;
+		const u32 dwKey0 = AnimationKeyPair( pKeyTimes ? pKeyTimes[dwIdx] : fKeyTime, pStreams->dwKeyCount, &dwKey1, &fT );
+		const u64 qwOffset0 = (u64)dwKey0 * pStreams->dwCapacity + dwIdx;
+		const u64 qwOffset1 = (u64)dwKey1 * pStreams->dwCapacity + dwIdx;
+		Quatf qRot0 = { { { pStreams->pRotW[qwOffset0], pStreams->pRotX[qwOffset0], pStreams->pRotY[qwOffset0], pStreams->pRotZ[qwOffset0] } } };
+		Quatf qRot1 = { { { pStreams->pRotW[qwOffset1], pStreams->pRotX[qwOffset1], pStreams->pRotY[qwOffset1], pStreams->pRotZ[qwOffset1] } } };
+		Vec3f vPos0 = { { { pStreams->pPosX[qwOffset0], pStreams->pPosY[qwOffset0], pStreams->pPosZ[qwOffset0] } } };
+		Vec3f vPos1 = { { { pStreams->pPosX[qwOffset1], pStreams->pPosY[qwOffset1], pStreams->pPosZ[qwOffset1] } } };
+		Quatf qRot;
+		Vec3f vPos;
+		if( dwMode == ANIM_SAMPLE_SLERP )
+		{
+			QuatfSlerp( &qRot0, &qRot1, fT, &qRot );
+		}
+		else
+		{
+			//shortest path like QuatfSlerp()
+			if( QuatfDot( &qRot0, &qRot1 ) < 0.f )
+			{
+				qRot1.w = -qRot1.w;
+				qRot1.x = -qRot1.x;
+				qRot1.y = -qRot1.y;
+				qRot1.z = -qRot1.z;
+			}
+			QuatfNormLerp( &qRot0, &qRot1, fT, &qRot );
+		}
+		Vec3fLerp( &vPos0, &vPos1, fT, &vPos );
+		InitModelMat4ByQuatf( &pOut[dwIdx], &qRot, &vPos );
+	}
+}
+
+#if defined(__AVX2__)
+//8 registers of one component for 8 instances into 8 registers of 8 components for one instance
+inline
+void AnimationTranspose8x8( __m256 *r )
+{
+	const __m256 t0 = _mm256_unpacklo_ps( r[0], r[1] );
+	const __m256 t1 = _mm256_unpackhi_ps( r[0], r[1] );
+	const __m256 t2 = _mm256_unpacklo_ps( r[2], r[3] );
+	const __m256 t3 = _mm256_unpackhi_ps( r[2], r[3] );
+	const __m256 t4 = _mm256_unpacklo_ps( r[4], r[5] );
+	const __m256 t5 = _mm256_unpackhi_ps( r[4], r[5] );
+	const __m256 t6 = _mm256_unpacklo_ps( r[6], r[7] );
+	const __m256 t7 = _mm256_unpackhi_ps( r[6], r[7] );
+	const __m256 s0 = _mm256_shuffle_ps( t0, t2, 0x44 );
+	const __m256 s1 = _mm256_shuffle_ps( t0, t2, 0xEE );
+	const __m256 s2 = _mm256_shuffle_ps( t1, t3, 0x44 );
+	const __m256 s3 = _mm256_shuffle_ps( t1, t3, 0xEE );
+	const __m256 s4 = _mm256_shuffle_ps( t4, t6, 0x44 );
+	const __m256 s5 = _mm256_shuffle_ps( t4, t6, 0xEE );
+	const __m256 s6 = _mm256_shuffle_ps( t5, t7, 0x44 );
+	const __m256 s7 = _mm256_shuffle_ps( t5, t7, 0xEE );
+	r[0] = _mm256_permute2f128_ps( s0, s4, 0x20 );
+	r[1] = _mm256_permute2f128_ps( s1, s5, 0x20 );
+	r[2] = _mm256_permute2f128_ps( s2, s6, 0x20 );
+	r[3] = _mm256_permute2f128_ps( s3, s7, 0x20 );
+	r[4] = _mm256_permute2f128_ps( s0, s4, 0x31 );
+	r[5] = _mm256_permute2f128_ps( s1, s5, 0x31 );
+	r[6] = _mm256_permute2f128_ps( s2, s6, 0x31 );
+	r[7] = _mm256_permute2f128_ps( s3, s7, 0x31 );
+}
+
+//slerp weight of the far key, sin( fT * angle ) / sin( angle ) for fCos = cos( angle ) in [0, 1], polynomial without trig
+//(Eberly, "A Fast and Accurate Algorithm for Computing SLERP"), 13 terms with the last one scaled by fMu keep it under 4e-7 off
+//the trig version over the whole range, the 8 terms of the paper are 2e-5 off near 90 degrees
+#define ANIM_SLERP_TERMS 13
+inline
+__m256 AnimationSlerpWeight( __m256 t, __m256 cosMinusOne )
+{
+	static const f32 fMu = 1.90058f;
+	static const f32 u[ANIM_SLERP_TERMS] = { 1.f / 3, 1.f / 10, 1.f / 21, 1.f / 36, 1.f / 55, 1.f / 78, 1.f / 105, 1.f / 136, 1.f / 171, 1.f / 210, 1.f / 253, 1.f / 300, fMu / 351 };
+	static const f32 v[ANIM_SLERP_TERMS] = { 1.f / 3, 2.f / 5, 3.f / 7, 4.f / 9, 5.f / 11, 6.f / 13, 7.f / 15, 8.f / 17, 9.f / 19, 10.f / 21, 11.f / 23, 12.f / 25, fMu * 13 / 27 };
+	const __m256 one = _mm256_set1_ps( 1.f );
+	const __m256 tSquared = _mm256_mul_ps( t, t );
+	__m256 weight = one;
+	for( s32 iTerm = ANIM_SLERP_TERMS - 1; iTerm >= 0; --iTerm )
+	{
+		const __m256 b = _mm256_mul_ps( _mm256_fmsub_ps( _mm256_set1_ps( u[iTerm] ), tSquared, _mm256_set1_ps( v[iTerm] ) ), cosMinusOne );
+		weight = _mm256_fmadd_ps( b, weight, one );
+	}
+	return _mm256_mul_ps( t, weight );
+}
+#endif
+
+//instances [dwBegin, dwEnd) into pOut[dwBegin..dwEnd), dwBegin a multiple of 8 so ranges can be split over workers
+//a pOut aligned to ANIM_STREAM_ALIGNMENT is written with non temporal stores
+//pKeyTimes has a key time per instance (gathered keys), NULL samples every instance at fKeyTime (streamed keys)
+inline
+void SampleAnimationStreams( const AnimationStreamsSoA *pStreams, u32 dwBegin, u32 dwEnd, const f32 *pKeyTimes, f32 fKeyTime, u32 dwMode, Mat4f *pOut )
+{
+#if defined(__AVX2__)
+#if MAIN_DEBUG
+	assert( ( dwBegin & 7 ) == 0 && dwEnd <= pStreams->dwCount );
+#endif
+	const __m256 one = _mm256_set1_ps( 1.f );
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 signMask = _mm256_set1_ps( -0.f );
+	const __m256 nlerpMinCos = _mm256_set1_ps( QUATF_NLERP_MIN_COS );
+	const __m256 keyCount = _mm256_set1_ps( (f32)pStreams->dwKeyCount );
+	const __m256 lastKey = _mm256_set1_ps( (f32)pStreams->dwKeyCount - 1.f );
+	const __m256i capacity = _mm256_set1_epi32( (int)pStreams->dwCapacity );
+	const __m256i laneIndex = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+	//the matrices are usually headed for an upload buffer and not read back soon, non temporal stores skip the read for ownership
+	const bool bStream = ( (uintptr_t)pOut & ( ANIM_STREAM_ALIGNMENT - 1 ) ) == 0;
+
+	u32 dwSharedKey1;
+	f32 fSharedT;
+	const u32 dwSharedKey0 = AnimationKeyPair( fKeyTime, pStreams->dwKeyCount, &dwSharedKey1, &fSharedT );
+	const u64 qwSharedOffset0 = (u64)dwSharedKey0 * pStreams->dwCapacity;
+	const u64 qwSharedOffset1 = (u64)dwSharedKey1 * pStreams->dwCapacity;
+
+	for( u32 dwIdx = dwBegin; dwIdx < dwEnd; dwIdx += 8 )
+	{
+		const u32 dwLanes = dwEnd - dwIdx < 8 ? dwEnd - dwIdx : 8;
+		__m256 t;
+		__m256 key0[ANIM_NUM_STREAMS];
+		__m256 key1[ANIM_NUM_STREAMS];
+		if( pKeyTimes )
+		{
+			//same steps as AnimationKeyPair(), the times past dwEnd are masked off so pKeyTimes needs no padding
+			const __m256i loadMask = _mm256_cmpgt_epi32( _mm256_set1_epi32( (int)dwLanes ), laneIndex );
+			const __m256 time = _mm256_maskload_ps( pKeyTimes + dwIdx, loadMask );
+			const __m256 wrapped = _mm256_sub_ps( time, _mm256_mul_ps( _mm256_floor_ps( _mm256_div_ps( time, keyCount ) ), keyCount ) );
+			const __m256 fKey0 = _mm256_min_ps( _mm256_floor_ps( wrapped ), lastKey );
+			t = _mm256_sub_ps( wrapped, fKey0 );
+			const __m256i key0Index = _mm256_cvttps_epi32( fKey0 );
+			const __m256i key1Index = _mm256_andnot_si256( _mm256_castps_si256( _mm256_cmp_ps( fKey0, lastKey, _CMP_EQ_OQ ) ),
+														   _mm256_add_epi32( key0Index, _mm256_set1_epi32( 1 ) ) );
+			const __m256i instance = _mm256_add_epi32( _mm256_set1_epi32( (int)dwIdx ), laneIndex );
+			const __m256i offset0 = _mm256_add_epi32( _mm256_mullo_epi32( key0Index, capacity ), instance );
+			const __m256i offset1 = _mm256_add_epi32( _mm256_mullo_epi32( key1Index, capacity ), instance );
+			for( u32 dwStream = 0; dwStream < ANIM_NUM_STREAMS; ++dwStream )
+			{
+				key0[dwStream] = _mm256_i32gather_ps( pStreams->pStreams[dwStream], offset0, 4 );
+				key1[dwStream] = _mm256_i32gather_ps( pStreams->pStreams[dwStream], offset1, 4 );
+			}
+		}
+		else
+		{
+			t = _mm256_set1_ps( fSharedT );
+			for( u32 dwStream = 0; dwStream < ANIM_NUM_STREAMS; ++dwStream )
+			{
+				key0[dwStream] = _mm256_load_ps( pStreams->pStreams[dwStream] + qwSharedOffset0 + dwIdx );
+				key1[dwStream] = _mm256_load_ps( pStreams->pStreams[dwStream] + qwSharedOffset1 + dwIdx );
+			}
+		}
+
+		//shortest path: flip the far key into the hemisphere of the near one
+		const __m256 dot = _mm256_fmadd_ps( key0[3], key1[3], _mm256_fmadd_ps( key0[2], key1[2], _mm256_fmadd_ps( key0[1], key1[1], _mm256_mul_ps( key0[0], key1[0] ) ) ) );
+		const __m256 dotSign = _mm256_and_ps( dot, signMask );
+		const __m256 cosAngle = _mm256_xor_ps( dot, dotSign );
+		for( u32 dwComp = 0; dwComp < 4; ++dwComp )
+		{
+			key1[dwComp] = _mm256_xor_ps( key1[dwComp], dotSign );
+		}
+
+		__m256 q[4];
+		for( u32 dwComp = 0; dwComp < 4; ++dwComp )
+		{
+			q[dwComp] = _mm256_fmadd_ps( _mm256_sub_ps( key1[dwComp], key0[dwComp] ), t, key0[dwComp] );
+		}
+		//full precision sqrt + div like QuatfNormalize()
+		const __m256 mag = _mm256_sqrt_ps( _mm256_fmadd_ps( q[3], q[3], _mm256_fmadd_ps( q[2], q[2], _mm256_fmadd_ps( q[1], q[1], _mm256_mul_ps( q[0], q[0] ) ) ) ) );
+		const __m256 nonZero = _mm256_cmp_ps( mag, zero, _CMP_NEQ_OQ );
+		for( u32 dwComp = 0; dwComp < 4; ++dwComp )
+		{
+			q[dwComp] = _mm256_and_ps( _mm256_div_ps( q[dwComp], mag ), nonZero );
+		}
+
+		if( dwMode == ANIM_SAMPLE_SLERP )
+		{
+			const __m256 useSlerp = _mm256_cmp_ps( cosAngle, nlerpMinCos, _CMP_LE_OQ );
+			if( _mm256_movemask_ps( useSlerp ) )
+			{
+				const __m256 cosMinusOne = _mm256_sub_ps( cosAngle, one );
+				const __m256 weight0 = AnimationSlerpWeight( _mm256_sub_ps( one, t ), cosMinusOne );
+				const __m256 weight1 = AnimationSlerpWeight( t, cosMinusOne );
+				for( u32 dwComp = 0; dwComp < 4; ++dwComp )
+				{
+					const __m256 slerp = _mm256_fmadd_ps( key1[dwComp], weight1, _mm256_mul_ps( key0[dwComp], weight0 ) );
+					q[dwComp] = _mm256_blendv_ps( q[dwComp], slerp, useSlerp );
+				}
+			}
+		}
+
+		//InitModelMat4ByQuatf()
+		const __m256 w = q[0], x = q[1], y = q[2], z = q[3];
+		const __m256 x2 = _mm256_add_ps( x, x ), y2 = _mm256_add_ps( y, y ), z2 = _mm256_add_ps( z, z );
+		const __m256 xx2 = _mm256_mul_ps( x, x2 ), yy2 = _mm256_mul_ps( y, y2 ), zz2 = _mm256_mul_ps( z, z2 );
+		const __m256 xy2 = _mm256_mul_ps( x, y2 ), xz2 = _mm256_mul_ps( x, z2 ), yz2 = _mm256_mul_ps( y, z2 );
+		const __m256 wx2 = _mm256_mul_ps( w, x2 ), wy2 = _mm256_mul_ps( w, y2 ), wz2 = _mm256_mul_ps( w, z2 );
+		__m256 rows01[8] =
+		{
+			_mm256_sub_ps( one, _mm256_add_ps( yy2, zz2 ) ), _mm256_add_ps( xy2, wz2 ), _mm256_sub_ps( xz2, wy2 ), zero,
+			_mm256_sub_ps( xy2, wz2 ), _mm256_sub_ps( one, _mm256_add_ps( xx2, zz2 ) ), _mm256_add_ps( yz2, wx2 ), zero,
+		};
+		__m256 rows23[8] =
+		{
+			_mm256_add_ps( xz2, wy2 ), _mm256_sub_ps( yz2, wx2 ), _mm256_sub_ps( one, _mm256_add_ps( xx2, yy2 ) ), zero,
+			_mm256_fmadd_ps( _mm256_sub_ps( key1[4], key0[4] ), t, key0[4] ),
+			_mm256_fmadd_ps( _mm256_sub_ps( key1[5], key0[5] ), t, key0[5] ),
+			_mm256_fmadd_ps( _mm256_sub_ps( key1[6], key0[6] ), t, key0[6] ),
+			one,
+		};
+		AnimationTranspose8x8( rows01 );
+		AnimationTranspose8x8( rows23 );
+		if( bStream )
+		{
+			for( u32 dwLane = 0; dwLane < dwLanes; ++dwLane )
+			{
+				_mm256_stream_ps( &pOut[dwIdx + dwLane].m[0][0], rows01[dwLane] );
+				_mm256_stream_ps( &pOut[dwIdx + dwLane].m[2][0], rows23[dwLane] );
+			}
+		}
+		else
+		{
+			for( u32 dwLane = 0; dwLane < dwLanes; ++dwLane )
+			{
+				_mm256_storeu_ps( &pOut[dwIdx + dwLane].m[0][0], rows01[dwLane] );
+				_mm256_storeu_ps( &pOut[dwIdx + dwLane].m[2][0], rows23[dwLane] );
+			}
+		}
+	}
+	if( bStream )
+	{
+		_mm_sfence();
+	}
+#else
+	SampleAnimationStreamsScalar( pStreams, dwBegin, dwEnd, pKeyTimes, fKeyTime, dwMode, pOut );
+#endif
+}
+
+#endif
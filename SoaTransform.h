@@ -0,0 +1,188 @@
+#ifndef SOA_TRANSFORM_H
+#define SOA_TRANSFORM_H
+
+//batch transform of the interleaved vertex format from UploadModels() (position3, normal3, color4 = MODEL_VERTEX_STRIDE)
+//vertices are split into structure of arrays streams so 8 vertices can be transformed per AVX2 instruction
+
+#include "Common.h"
+#include "Math3D.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define SOA_STREAM_ALIGNMENT 32 //one ymm register
+#define SOA_NUM_STREAMS 10
+
+typedef struct VertexStreamsSoA
+{
+	union
+	{
+		f32 *pStreams[SOA_NUM_STREAMS];
+		struct
+		{
+			f32 *pPosX;
+			f32 *pPosY;
+			f32 *pPosZ;
+			f32 *pNrmX;
+			f32 *pNrmY;
+			f32 *pNrmZ;
+			f32 *pColR;
+			f32 *pColG;
+			f32 *pColB;
+			f32 *pColA;
+		};
+	};
+	u32 dwCount;
+	u32 dwCapacity; //multiple of 8, streams are padded so kernels never need a masked tail
+	void *pAllocation;
+} VertexStreamsSoA;
+
+inline
+bool AllocVertexStreamsSoA( VertexStreamsSoA *pStreams, u32 dwCapacity )
+{
+	dwCapacity = ( dwCapacity + 7 ) & ~7u;
+	const u64 qwStreamSize = (u64)dwCapacity * sizeof(f32);
+	u8 *pBase = (u8*)malloc( qwStreamSize * SOA_NUM_STREAMS + SOA_STREAM_ALIGNMENT );
+	if( !pBase )
+	{
+		return false;
+	}
+	u8 *pAligned = (u8*)( ( (uintptr_t)pBase + SOA_STREAM_ALIGNMENT - 1 ) & ~(uintptr_t)( SOA_STREAM_ALIGNMENT - 1 ) );
+	memset( pAligned, 0, qwStreamSize * SOA_NUM_STREAMS );
+	for( u32 dwStream = 0; dwStream < SOA_NUM_STREAMS; ++dwStream )
+	{
+		pStreams->pStreams[dwStream] = (f32*)( pAligned + qwStreamSize * dwStream );
+	}
+	pStreams->dwCount = 0;
+	pStreams->dwCapacity = dwCapacity;
+	pStreams->pAllocation = pBase;
+	return true;
+}
+
+inline
+void FreeVertexStreamsSoA( VertexStreamsSoA *pStreams )
+{
+	free( pStreams->pAllocation );
+	memset( pStreams, 0, sizeof(VertexStreamsSoA) );
+}
+
+inline
+void DeinterleaveVertices( const f32 *pInterleaved, u32 dwCount, VertexStreamsSoA *pOut )
+{
+#if MAIN_DEBUG
+	assert( dwCount <= pOut->dwCapacity );
+#endif
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		const f32 *pVertex = pInterleaved + (u64)dwIdx * SOA_NUM_STREAMS;
+		for( u32 dwStream = 0; dwStream < SOA_NUM_STREAMS; ++dwStream )
+		{
+			pOut->pStreams[dwStream][dwIdx] = pVertex[dwStream];
+		}
+	}
+	pOut->dwCount = dwCount;
+}
+
+inline
+void InterleaveVertices( const VertexStreamsSoA *pIn, f32 *pInterleaved )
+{
+	for( u32 dwIdx = 0; dwIdx < pIn->dwCount; ++dwIdx )
+	{
+		f32 *pVertex = pInterleaved + (u64)dwIdx * SOA_NUM_STREAMS;
+		for( u32 dwStream = 0; dwStream < SOA_NUM_STREAMS; ++dwStream )
+		{
+			pVertex[dwStream] = pIn->pStreams[dwStream][dwIdx];
+		}
+	}
+}
+
+//scalar reference, same math as Vec3fTransformPointMat4f/Vec3fTransformDirMat3x4f/Vec3fNormalize
+inline
+void TransformVertexStreamsScalar( const VertexStreamsSoA *pIn, Mat4f *pModel, bool bRenormalize, VertexStreamsSoA *pOut )
+{
+	Mat3x4f normalMat;
+	InverseTransposeUpper3x3Mat4f( pModel, &normalMat );
+	for( u32 dwIdx = 0; dwIdx < pIn->dwCount; ++dwIdx )
+	{
+		Vec3f vPos = { { { pIn->pPosX[dwIdx], pIn->pPosY[dwIdx], pIn->pPosZ[dwIdx] } } };
+		Vec3f vNrm = { { { pIn->pNrmX[dwIdx], pIn->pNrmY[dwIdx], pIn->pNrmZ[dwIdx] } } };
+		Vec3f vOutPos;
+		Vec3f vOutNrm;
+		Vec3fTransformPointMat4f( &vPos, pModel, &vOutPos );
+		Vec3fTransformDirMat3x4f( &vNrm, &normalMat, &vOutNrm );
+		if( bRenormalize )
+		{
+			Vec3fNormalize( &vOutNrm, &vOutNrm );
+		}
+		pOut->pPosX[dwIdx] = vOutPos.x;
+		pOut->pPosY[dwIdx] = vOutPos.y;
+		pOut->pPosZ[dwIdx] = vOutPos.z;
+		pOut->pNrmX[dwIdx] = vOutNrm.x;
+		pOut->pNrmY[dwIdx] = vOutNrm.y;
+		pOut->pNrmZ[dwIdx] = vOutNrm.z;
+	}
+	pOut->dwCount = pIn->dwCount;
+}
+
+//positions by pModel, normals by the inverse transpose of its upper 3x3, colors are left alone (pIn and pOut can share color streams)
+//pIn and pOut can be the same streams
+inline
+void TransformVertexStreams( const VertexStreamsSoA *pIn, Mat4f *pModel, bool bRenormalize, VertexStreamsSoA *pOut )
+{
+#if defined(__AVX2__)
+	Mat3x4f normalMat;
+	InverseTransposeUpper3x3Mat4f( pModel, &normalMat );
+
+	const __m256 m00 = _mm256_set1_ps( pModel->m[0][0] ), m01 = _mm256_set1_ps( pModel->m[0][1] ), m02 = _mm256_set1_ps( pModel->m[0][2] );
+	const __m256 m10 = _mm256_set1_ps( pModel->m[1][0] ), m11 = _mm256_set1_ps( pModel->m[1][1] ), m12 = _mm256_set1_ps( pModel->m[1][2] );
+	const __m256 m20 = _mm256_set1_ps( pModel->m[2][0] ), m21 = _mm256_set1_ps( pModel->m[2][1] ), m22 = _mm256_set1_ps( pModel->m[2][2] );
+	const __m256 m30 = _mm256_set1_ps( pModel->m[3][0] ), m31 = _mm256_set1_ps( pModel->m[3][1] ), m32 = _mm256_set1_ps( pModel->m[3][2] );
+
+	const __m256 n00 = _mm256_set1_ps( normalMat.m[0][0] ), n01 = _mm256_set1_ps( normalMat.m[0][1] ), n02 = _mm256_set1_ps( normalMat.m[0][2] );
+	const __m256 n10 = _mm256_set1_ps( normalMat.m[1][0] ), n11 = _mm256_set1_ps( normalMat.m[1][1] ), n12 = _mm256_set1_ps( normalMat.m[1][2] );
+	const __m256 n20 = _mm256_set1_ps( normalMat.m[2][0] ), n21 = _mm256_set1_ps( normalMat.m[2][1] ), n22 = _mm256_set1_ps( normalMat.m[2][2] );
+	const __m256 zero = _mm256_setzero_ps();
+
+	//streams are padded to a multiple of 8 so the last partial block is safe to process
+	for( u32 dwIdx = 0; dwIdx < pIn->dwCount; dwIdx += 8 )
+	{
+		__m256 px = _mm256_load_ps( pIn->pPosX + dwIdx );
+		__m256 py = _mm256_load_ps( pIn->pPosY + dwIdx );
+		__m256 pz = _mm256_load_ps( pIn->pPosZ + dwIdx );
+		__m256 ox = _mm256_fmadd_ps( pz, m20, _mm256_fmadd_ps( py, m10, _mm256_fmadd_ps( px, m00, m30 ) ) );
+		__m256 oy = _mm256_fmadd_ps( pz, m21, _mm256_fmadd_ps( py, m11, _mm256_fmadd_ps( px, m01, m31 ) ) );
+		__m256 oz = _mm256_fmadd_ps( pz, m22, _mm256_fmadd_ps( py, m12, _mm256_fmadd_ps( px, m02, m32 ) ) );
+		_mm256_store_ps( pOut->pPosX + dwIdx, ox );
+		_mm256_store_ps( pOut->pPosY + dwIdx, oy );
+		_mm256_store_ps( pOut->pPosZ + dwIdx, oz );
+
+		__m256 nx = _mm256_load_ps( pIn->pNrmX + dwIdx );
+		__m256 ny = _mm256_load_ps( pIn->pNrmY + dwIdx );
+		__m256 nz = _mm256_load_ps( pIn->pNrmZ + dwIdx );
+		__m256 onx = _mm256_fmadd_ps( nz, n20, _mm256_fmadd_ps( ny, n10, _mm256_mul_ps( nx, n00 ) ) );
+		__m256 ony = _mm256_fmadd_ps( nz, n21, _mm256_fmadd_ps( ny, n11, _mm256_mul_ps( nx, n01 ) ) );
+		__m256 onz = _mm256_fmadd_ps( nz, n22, _mm256_fmadd_ps( ny, n12, _mm256_mul_ps( nx, n02 ) ) );
+		if( bRenormalize )
+		{
+			//full precision sqrt + div like Vec3fNormalize, zero length normals stay zero
+			__m256 mag = _mm256_sqrt_ps( _mm256_fmadd_ps( onz, onz, _mm256_fmadd_ps( ony, ony, _mm256_mul_ps( onx, onx ) ) ) );
+			__m256 nonZero = _mm256_cmp_ps( mag, zero, _CMP_NEQ_OQ );
+			onx = _mm256_and_ps( _mm256_div_ps( onx, mag ), nonZero );
+			ony = _mm256_and_ps( _mm256_div_ps( ony, mag ), nonZero );
+			onz = _mm256_and_ps( _mm256_div_ps( onz, mag ), nonZero );
+		}
+		_mm256_store_ps( pOut->pNrmX + dwIdx, onx );
+		_mm256_store_ps( pOut->pNrmY + dwIdx, ony );
+		_mm256_store_ps( pOut->pNrmZ + dwIdx, onz );
+	}
+	pOut->dwCount = pIn->dwCount;
+#else
+	TransformVertexStreamsScalar( pIn, pModel, bRenormalize, pOut );
+#endif
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef STREAM_PIPELINE_H
+#define STREAM_PIPELINE_H
+
+//out of core processing of a file bigger than device memory: it goes through upload -> compute -> readback in fixed size chunks
+//and the results are appended to an output file in chunk order
+//every step submits one stage of three chunks, the upload of chunk n, the compute of n-1 and the readback of n-2, newest first,
+//so an upload is never queued behind a readback that waits for compute when both share the copy queue
+//chunk n owns slot n % dwDepth (staging and device buffers) from its upload until its output is written, so the memory in use is
+//dwDepth chunks of input and output no matter how big the file is. the slot is only reused after the host drained it, which also
+//means its readback, and so its compute, is done
+//the callbacks own everything api specific, each records + submits one stage and returns the fence value signaled after it,
+//the compute stage makes its queue wait for the upload value and the readback stage for the compute value (cross queue Wait)
+
+#include "Common.h"
+#include "MappedFile.h"
+#include "Timer.h"
+
+#include <stdio.h>
+
+#define STREAM_PIPELINE_MIN_DEPTH 3 //a slot is drained dwDepth steps after its upload, its readback goes out 2 steps after it
+#define STREAM_PIPELINE_MAX_DEPTH 8
+
+enum StreamStage
+{
+	STREAM_STAGE_UPLOAD,
+	STREAM_STAGE_COMPUTE,
+	STREAM_STAGE_READBACK,
+	STREAM_STAGE_COUNT
+};
+
+typedef struct StreamChunk
+{
+	u64 qwIndex;
+	u32 dwSlot;
+	u32 dwElementCount;
+	const u8 *pInput;    //in the mapped input file, what the upload stage copies into the slot's staging
+	u64 qwInputSize;
+	u64 qwOutputSize;    //bytes the output stage has to return
+	u64 qwFenceValues[STREAM_STAGE_COUNT]; //of the submitted stages
+} StreamChunk;
+
+//records and submits one stage of pChunk after qwWaitValue of the previous stage (0 for the upload), returns its fence value
+//0 fails the pipeline, whatever is in flight is left to the caller to wait for before the slots are freed
+typedef u64 (*PFN_StreamStage)( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue );
+//blocks until the readback of pChunk is done and returns its qwOutputSize bytes, valid until pfnReleaseOutput
+typedef const u8 *(*PFN_StreamAcquireOutput)( void *pContext, const StreamChunk *pChunk );
+typedef void (*PFN_StreamReleaseOutput)( void *pContext, const StreamChunk *pChunk );
+
+typedef struct StreamPipelineDesc
+{
+	PFN_StreamStage pfnStages[STREAM_STAGE_COUNT];
+	PFN_StreamAcquireOutput pfnAcquireOutput;
+	PFN_StreamReleaseOutput pfnReleaseOutput;
+	void *pContext;
+	u32 dwDepth;             //slots, STREAM_PIPELINE_MIN_DEPTH..STREAM_PIPELINE_MAX_DEPTH
+	u32 dwChunkElements;     //the last chunk can be smaller
+	u32 dwInputElementSize;  //the input file is a whole number of these
+	u32 dwOutputElementSize;
+} StreamPipelineDesc;
+
+typedef struct StreamPipeline
+{
+	StreamPipelineDesc desc;
+	MappedFile input;
+	FILE *pOutput;
+	StreamChunk chunks[STREAM_PIPELINE_MAX_DEPTH]; //by slot
+	u64 qwChunkCount;
+	u64 qwStep;
+	u64 qwDrainedChunks; //chunks whose output is in the file, the progress
+	u64 qwBytesRead;
+	u64 qwBytesWritten;
+	u64 qwStartNs;
+	u64 qwEndNs;
+	u64 qwOutputWaitNs;  //host blocked in pfnAcquireOutput
+	u64 qwWriteNs;
+	bool bFailed;
+} StreamPipeline;
+
+//staging the callbacks need per slot, times dwDepth is all the memory the pipeline keeps in flight
+inline
+u64 StreamSlotInputSize( const StreamPipelineDesc *pDesc )
+{
+	return (u64)pDesc->dwChunkElements * pDesc->dwInputElementSize;
+}
+
+inline
+u64 StreamSlotOutputSize( const StreamPipelineDesc *pDesc )
+{
+	return (u64)pDesc->dwChunkElements * pDesc->dwOutputElementSize;
+}
+
+inline
+void CloseStreamPipeline( StreamPipeline *pPipeline )
+{
+	CloseMappedFile( &pPipeline->input );
+	if( pPipeline->pOutput )
+	{
+		pPipeline->bFailed |= fclose( pPipeline->pOutput ) != 0;
+		pPipeline->pOutput = NULL;
+	}
+}
+
+//maps pInputPath (read on demand, never loaded as a whole) and creates pOutputPath
+inline
+bool OpenStreamPipeline( StreamPipeline *pPipeline, const StreamPipelineDesc *pDesc, const char *pInputPath, const char *pOutputPath )
+{
+	pPipeline->desc = *pDesc;
+	pPipeline->pOutput = NULL;
+	pPipeline->qwStep = 0;
+	pPipeline->qwDrainedChunks = 0;
+	pPipeline->qwBytesRead = 0;
+	pPipeline->qwBytesWritten = 0;
+	pPipeline->qwStartNs = 0;
+	pPipeline->qwEndNs = 0;
+	pPipeline->qwOutputWaitNs = 0;
+	pPipeline->qwWriteNs = 0;
+	pPipeline->bFailed = false;
+	if( pDesc->dwDepth < STREAM_PIPELINE_MIN_DEPTH || pDesc->dwDepth > STREAM_PIPELINE_MAX_DEPTH || pDesc->dwChunkElements == 0 ||
+		pDesc->dwInputElementSize == 0 || !OpenMappedFile( pInputPath, &pPipeline->input, false ) )
+	{
+		return false;
+	}
+	pPipeline->pOutput = fopen( pOutputPath, "wb" );
+	if( !pPipeline->pOutput || pPipeline->input.qwSize % pDesc->dwInputElementSize != 0 )
+	{
+		CloseStreamPipeline( pPipeline );
+		return false;
+	}
+	const u64 qwElementCount = pPipeline->input.qwSize / pDesc->dwInputElementSize;
+	pPipeline->qwChunkCount = ( qwElementCount + pDesc->dwChunkElements - 1 ) / pDesc->dwChunkElements;
+	return true;
+}
+
+inline
+bool StreamPipelineDone( const StreamPipeline *pPipeline )
+{
+	return pPipeline->bFailed || pPipeline->qwDrainedChunks == pPipeline->qwChunkCount;
+}
+
+//waits for the oldest chunk in flight and appends its output to the file, its slot is free after this
+inline
+void StreamPipelineDrainOldest( StreamPipeline *pPipeline )
+{
+	StreamChunk *pChunk = &pPipeline->chunks[pPipeline->qwDrainedChunks % pPipeline->desc.dwDepth];
+	u64 qwStartNs = GetTimeNs();
+	const u8 *pOutput = pPipeline->desc.pfnAcquireOutput( pPipeline->desc.pContext, pChunk );
+	const u64 qwAcquiredNs = GetTimeNs();
+	pPipeline->qwOutputWaitNs += qwAcquiredNs - qwStartNs;
+	if( !pOutput || fwrite( pOutput, 1, pChunk->qwOutputSize, pPipeline->pOutput ) != pChunk->qwOutputSize )
+	{
+		pPipeline->bFailed = true;
+	}
+	pPipeline->desc.pfnReleaseOutput( pPipeline->desc.pContext, pChunk );
+	pPipeline->qwWriteNs += GetTimeNs() - qwAcquiredNs;
+	pPipeline->qwBytesWritten += pChunk->qwOutputSize;
+	++pPipeline->qwDrainedChunks;
+}
+
+//one step of the pipeline, returns false once every chunk is in the output file (or something failed)
+//the caller can look at qwDrainedChunks/qwChunkCount between steps for progress
+inline
+bool StreamPipelineStep( StreamPipeline *pPipeline )
+{
+	if( StreamPipelineDone( pPipeline ) )
+	{
+		return false;
+	}
+	if( pPipeline->qwStep == 0 )
+	{
+		pPipeline->qwStartNs = GetTimeNs();
+	}
+	const StreamPipelineDesc *pDesc = &pPipeline->desc;
+	const u64 qwStep = pPipeline->qwStep++;
+
+	if( qwStep < pPipeline->qwChunkCount )
+	{
+		//the readback of the slot's previous chunk went out dwDepth - 2 steps ago
+		if( qwStep >= pDesc->dwDepth )
+		{
+			StreamPipelineDrainOldest( pPipeline );
+		}
+		StreamChunk *pChunk = &pPipeline->chunks[qwStep % pDesc->dwDepth];
+		const u64 qwFirstElement = qwStep * pDesc->dwChunkElements;
+		const u64 qwElementCount = pPipeline->input.qwSize / pDesc->dwInputElementSize;
+		pChunk->qwIndex = qwStep;
+		pChunk->dwSlot = (u32)( qwStep % pDesc->dwDepth );
+		pChunk->dwElementCount = (u32)( qwElementCount - qwFirstElement < pDesc->dwChunkElements ? qwElementCount - qwFirstElement : pDesc->dwChunkElements );
+		pChunk->pInput = pPipeline->input.pBase + qwFirstElement * pDesc->dwInputElementSize;
+		pChunk->qwInputSize = (u64)pChunk->dwElementCount * pDesc->dwInputElementSize;
+		pChunk->qwOutputSize = (u64)pChunk->dwElementCount * pDesc->dwOutputElementSize;
+		pChunk->qwFenceValues[STREAM_STAGE_UPLOAD] = pDesc->pfnStages[STREAM_STAGE_UPLOAD]( pDesc->pContext, pChunk, 0 );
+		pPipeline->bFailed |= pChunk->qwFenceValues[STREAM_STAGE_UPLOAD] == 0;
+		pPipeline->qwBytesRead += pChunk->qwInputSize;
+	}
+	for( u32 dwStage = STREAM_STAGE_COMPUTE; dwStage < STREAM_STAGE_COUNT; ++dwStage )
+	{
+		if( qwStep >= dwStage && qwStep - dwStage < pPipeline->qwChunkCount )
+		{
+			StreamChunk *pChunk = &pPipeline->chunks[( qwStep - dwStage ) % pDesc->dwDepth];
+			pChunk->qwFenceValues[dwStage] = pDesc->pfnStages[dwStage]( pDesc->pContext, pChunk, pChunk->qwFenceValues[dwStage - 1] );
+			pPipeline->bFailed |= pChunk->qwFenceValues[dwStage] == 0;
+		}
+	}
+	if( pPipeline->bFailed )
+	{
+		return false;
+	}
+
+	//every readback is out after the last step, what is left drains in order
+	if( qwStep + 1 >= pPipeline->qwChunkCount + STREAM_STAGE_READBACK )
+	{
+		while( !StreamPipelineDone( pPipeline ) )
+		{
+			StreamPipelineDrainOldest( pPipeline );
+		}
+		pPipeline->qwEndNs = GetTimeNs();
+		return false;
+	}
+	return true;
+}
+
+//streams the whole file, false if a stage failed or the output could not be written
+inline
+bool RunStreamPipeline( StreamPipeline *pPipeline )
+{
+	while( StreamPipelineStep( pPipeline ) )
+	{
+	}
+	return !pPipeline->bFailed;
+}
+
+#endif
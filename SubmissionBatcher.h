@@ -0,0 +1,153 @@
+#ifndef SUBMISSION_BATCHER_H
+#define SUBMISSION_BATCHER_H
+
+//packs a stream of small compute jobs into as few command lists / ExecuteCommandLists as possible
+//a batch goes out when it has dwMaxBatch jobs or when its oldest job has waited qwDeadlineNs, whichever is first,
+//so a busy stream gets full batches and a trickle still has bounded latency
+//the record callback owns everything api specific (one list, one execute, one signal) and returns the fence value of the batch
+//every job gets a ticket, SubmissionBatcherFenceValue() turns it into the fence value to wait on for its results
+//time is passed in by the caller so the batcher never reads a clock itself, call SubmissionBatcherPoll() whenever there is nothing to enqueue
+
+#include "Common.h"
+
+#define SUBMISSION_BATCHER_MAX_JOBS 1024   //largest dwMaxBatch
+#define SUBMISSION_BATCHER_MAX_BATCHES 256 //batches remembered for fence value lookups
+
+typedef struct SubmissionJob
+{
+	ComputeShaderCB constants; //root constants b0
+	void *pSrv;                //t0 and u0, whatever the record callback binds (TrackedResource* in main.cpp)
+	void *pUav;
+	u32 dwGroupCount;          //Dispatch( dwGroupCount, 1, 1 )
+} SubmissionJob;
+
+//records and submits pJobs in one command list, returns the fence value signaled after it
+typedef u64 (*PFN_SubmissionBatchRecord)( void *pContext, const SubmissionJob *pJobs, u32 dwJobCount );
+
+typedef struct SubmissionBatch
+{
+	u64 qwFirstTicket;
+	u64 qwFenceValue;
+	u64 qwSubmitNs;
+	u32 dwJobCount;
+} SubmissionBatch;
+
+typedef struct SubmissionBatcher
+{
+	SubmissionJob jobs[SUBMISSION_BATCHER_MAX_JOBS];
+	u32 dwJobCount;
+	u32 dwMaxBatch;
+	u64 qwDeadlineNs;
+	u64 qwOldestEnqueueNs; //enqueue time of jobs[0]
+	u64 qwNextTicket;
+	SubmissionBatch batches[SUBMISSION_BATCHER_MAX_BATCHES]; //indexed by batch number % SUBMISSION_BATCHER_MAX_BATCHES
+	u64 qwBatchCount;
+	PFN_SubmissionBatchRecord pfnRecord;
+	void *pContext;
+	u64 qwFullFlushes;
+	u64 qwDeadlineFlushes;
+} SubmissionBatcher;
+
+inline
+void InitSubmissionBatcher( SubmissionBatcher *pBatcher, u32 dwMaxBatch, u64 qwDeadlineNs, PFN_SubmissionBatchRecord pfnRecord, void *pContext )
+{
+	pBatcher->dwJobCount = 0;
+	pBatcher->dwMaxBatch = dwMaxBatch == 0 ? 1 : dwMaxBatch > SUBMISSION_BATCHER_MAX_JOBS ? SUBMISSION_BATCHER_MAX_JOBS : dwMaxBatch;
+	pBatcher->qwDeadlineNs = qwDeadlineNs;
+	pBatcher->qwOldestEnqueueNs = 0;
+	pBatcher->qwNextTicket = 1;
+	pBatcher->qwBatchCount = 0;
+	pBatcher->pfnRecord = pfnRecord;
+	pBatcher->pContext = pContext;
+	pBatcher->qwFullFlushes = 0;
+	pBatcher->qwDeadlineFlushes = 0;
+}
+
+//submits whatever is queued, e.g. at the end of a frame or before the cpu waits on the results
+inline
+void SubmissionBatcherFlush( SubmissionBatcher *pBatcher, u64 qwNowNs )
+{
+	if( pBatcher->dwJobCount == 0 )
+	{
+		return;
+	}
+	SubmissionBatch *pBatch = &pBatcher->batches[pBatcher->qwBatchCount % SUBMISSION_BATCHER_MAX_BATCHES];
+	pBatch->qwFirstTicket = pBatcher->qwNextTicket - pBatcher->dwJobCount;
+	pBatch->dwJobCount = pBatcher->dwJobCount;
+	pBatch->qwSubmitNs = qwNowNs;
+	pBatch->qwFenceValue = pBatcher->pfnRecord( pBatcher->pContext, pBatcher->jobs, pBatcher->dwJobCount );
+	++pBatcher->qwBatchCount;
+	pBatcher->dwJobCount = 0;
+}
+
+//returns the ticket of the job, the batch is submitted right away when this job fills it
+inline
+u64 SubmissionBatcherEnqueue( SubmissionBatcher *pBatcher, const SubmissionJob *pJob, u64 qwNowNs )
+{
+	if( pBatcher->dwJobCount == 0 )
+	{
+		pBatcher->qwOldestEnqueueNs = qwNowNs;
+	}
+	pBatcher->jobs[pBatcher->dwJobCount++] = *pJob;
+	const u64 qwTicket = pBatcher->qwNextTicket++;
+	if( pBatcher->dwJobCount == pBatcher->dwMaxBatch )
+	{
+		++pBatcher->qwFullFlushes;
+		SubmissionBatcherFlush( pBatcher, qwNowNs );
+	}
+	return qwTicket;
+}
+
+//submits the partial batch once its oldest job is due, true when it did
+inline
+bool SubmissionBatcherPoll( SubmissionBatcher *pBatcher, u64 qwNowNs )
+{
+	if( pBatcher->dwJobCount == 0 || qwNowNs - pBatcher->qwOldestEnqueueNs < pBatcher->qwDeadlineNs )
+	{
+		return false;
+	}
+	++pBatcher->qwDeadlineFlushes;
+	SubmissionBatcherFlush( pBatcher, qwNowNs );
+	return true;
+}
+
+//time left until the partial batch is due, how long the caller may sleep before the next poll
+inline
+u64 SubmissionBatcherTimeToDeadline( const SubmissionBatcher *pBatcher, u64 qwNowNs )
+{
+	if( pBatcher->dwJobCount == 0 )
+	{
+		return ~0ull;
+	}
+	const u64 qwWaited = qwNowNs - pBatcher->qwOldestEnqueueNs;
+	return qwWaited < pBatcher->qwDeadlineNs ? pBatcher->qwDeadlineNs - qwWaited : 0;
+}
+
+//fence value covering the job, 0 while it hasn't been submitted
+//tickets older than the remembered batches get the oldest remembered value, fence values only grow so that only ever waits longer
+inline
+u64 SubmissionBatcherFenceValue( const SubmissionBatcher *pBatcher, u64 qwTicket )
+{
+	if( qwTicket >= pBatcher->qwNextTicket - pBatcher->dwJobCount || pBatcher->qwBatchCount == 0 )
+	{
+		return 0;
+	}
+	u64 qwFirst = pBatcher->qwBatchCount > SUBMISSION_BATCHER_MAX_BATCHES ? pBatcher->qwBatchCount - SUBMISSION_BATCHER_MAX_BATCHES : 0;
+	u64 qwLast = pBatcher->qwBatchCount - 1;
+	//binary search for the last batch starting at or before the ticket
+	while( qwFirst < qwLast )
+	{
+		const u64 qwMiddle = qwFirst + ( qwLast - qwFirst + 1 ) / 2;
+		if( pBatcher->batches[qwMiddle % SUBMISSION_BATCHER_MAX_BATCHES].qwFirstTicket <= qwTicket )
+		{
+			qwFirst = qwMiddle;
+		}
+		else
+		{
+			qwLast = qwMiddle - 1;
+		}
+	}
+	return pBatcher->batches[qwFirst % SUBMISSION_BATCHER_MAX_BATCHES].qwFenceValue;
+}
+
+#endif
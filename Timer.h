@@ -0,0 +1,28 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+//portable replacement for the QueryPerformanceCounter/__rdtsc timing in main()
+
+#include "Common.h"
+
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+inline
+u64 GetTimeNs()
+{
+	return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+inline
+u64 ReadCycleCounter()
+{
+	return __rdtsc();
+}
+
+#endif
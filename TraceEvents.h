@@ -0,0 +1,284 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+//timeline instrumentation for queue submissions, fence waits and map/unmap, written out as chrome trace json
+//(chrome://tracing, ui.perfetto.dev)
+//every thread records into its own ring, so recording takes no lock and touches no shared cache line: rdtsc around the call,
+//one 64 byte slot and two release stores. a ring keeps the last TRACE_RING_CAPACITY events of its thread
+//rings are created on a thread's first event and live until the process exits, WriteTraceJson() can run while threads record
+//(a slot that is overwritten while it is read is skipped)
+//built in unless TRACE_EVENTS is 0, recording is off until TraceEnable( true )
+
+#include "Common.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 1
+#endif
+
+#define TRACE_RING_CAPACITY 16384 //power of 2, 1MB per thread
+#define TRACE_MAX_THREADS 64      //threads past this record nothing
+#define TRACE_MAX_THREAD_NAME 32
+
+//decides the args of the json event, the D3D12 call each one wraps
+enum TraceEventKind
+{
+	TRACE_KIND_SCOPE,      //no args
+	TRACE_KIND_RECORD,     //Reset..Close of a command list, arg0 commands recorded
+	TRACE_KIND_EXECUTE,    //ExecuteCommandLists, arg0 list count
+	TRACE_KIND_SIGNAL,     //ID3D12CommandQueue::Signal, arg0 fence value
+	TRACE_KIND_QUEUE_WAIT, //ID3D12CommandQueue::Wait, arg0 fence value
+	TRACE_KIND_HOST_WAIT,  //SetEventOnCompletion + WaitForSingleObject, arg0 fence value, arg1 completed value before the wait
+	TRACE_KIND_MAP,        //arg0 bytes of the read range
+	TRACE_KIND_UNMAP,      //arg0 bytes of the written range
+	TRACE_KIND_MEMCPY,     //arg0 bytes
+	TRACE_KIND_COUNT
+};
+
+typedef struct TraceEvent
+{
+	std::atomic<u64> qwSequence; //ring index + 1 once written, 0 while it is being written
+	u64 qwStartTicks;
+	u64 qwDurationTicks;
+	const char *pName;  //string literals only, they are written out by pointer
+	const char *pQueue; //queue the call went to, NULL for none
+	u64 qwArg0;
+	u64 qwArg1;
+	u32 eKind;
+	u32 dwPad;
+} TraceEvent;
+
+typedef struct TraceRing
+{
+	TraceEvent events[TRACE_RING_CAPACITY];
+	std::atomic<u64> qwHead; //events ever recorded, only the owning thread writes it
+	char threadName[TRACE_MAX_THREAD_NAME];
+} TraceRing;
+
+typedef struct TraceState
+{
+	std::atomic<bool> bEnabled;
+	std::atomic<u32> dwRingCount;
+	std::atomic<TraceRing*> rings[TRACE_MAX_THREADS];
+	std::atomic<u64> qwDroppedThreads;
+	u64 qwBaseTicks; //rdtsc and clock at the first TraceEnable( true ), for the tick rate and the zero of the timeline
+	u64 qwBaseNs;
+} TraceState;
+
+inline TraceState traceState;
+inline thread_local TraceRing *pTraceThreadRing;
+
+//0 while recording is off so a disabled event costs one relaxed load on each side
+inline
+u64 TraceBegin()
+{
+#if TRACE_EVENTS
+	return traceState.bEnabled.load( std::memory_order_relaxed ) ? ReadCycleCounter() : 0;
+#else
+	return 0;
+#endif
+}
+
+inline
+void TraceEnable( bool bEnable )
+{
+	if( bEnable && traceState.qwBaseNs == 0 )
+	{
+		traceState.qwBaseTicks = ReadCycleCounter();
+		traceState.qwBaseNs = GetTimeNs();
+	}
+	traceState.bEnabled.store( bEnable, std::memory_order_relaxed );
+}
+
+inline
+TraceRing *TraceCreateThreadRing()
+{
+	const u32 dwRing = traceState.dwRingCount.fetch_add( 1, std::memory_order_relaxed );
+	if( dwRing >= TRACE_MAX_THREADS )
+	{
+		traceState.qwDroppedThreads.fetch_add( 1, std::memory_order_relaxed );
+		return NULL;
+	}
+	TraceRing *pRing = (TraceRing*)calloc( 1, sizeof(TraceRing) );
+	if( !pRing )
+	{
+		return NULL;
+	}
+	snprintf( pRing->threadName, sizeof(pRing->threadName), "thread %u", dwRing );
+	traceState.rings[dwRing].store( pRing, std::memory_order_release );
+	return pRing;
+}
+
+//names the calling thread's track in the trace
+inline
+void TraceSetThreadName( const char *pName )
+{
+#if TRACE_EVENTS
+	if( !pTraceThreadRing )
+	{
+		pTraceThreadRing = TraceCreateThreadRing();
+	}
+	if( pTraceThreadRing )
+	{
+		snprintf( pTraceThreadRing->threadName, sizeof(pTraceThreadRing->threadName), "%s", pName );
+	}
+#endif
+}
+
+//the call that started at qwStartTicks (TraceBegin()) just returned
+inline
+void TraceEnd( u64 qwStartTicks, u32 eKind, const char *pName, const char *pQueue, u64 qwArg0 = 0, u64 qwArg1 = 0 )
+{
+#if TRACE_EVENTS
+	if( qwStartTicks == 0 || !traceState.bEnabled.load( std::memory_order_relaxed ) )
+	{
+		return;
+	}
+	const u64 qwEndTicks = ReadCycleCounter();
+	TraceRing *pRing = pTraceThreadRing;
+	if( !pRing )
+	{
+		pRing = pTraceThreadRing = TraceCreateThreadRing();
+		if( !pRing )
+		{
+			return;
+		}
+	}
+	const u64 qwIndex = pRing->qwHead.load( std::memory_order_relaxed );
+	TraceEvent *pEvent = &pRing->events[qwIndex & ( TRACE_RING_CAPACITY - 1 )];
+	//seqlock: a reader that sees the same nonzero sequence before and after its copy got a whole event
+	pEvent->qwSequence.store( 0, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	pEvent->qwStartTicks = qwStartTicks;
+	pEvent->qwDurationTicks = qwEndTicks - qwStartTicks;
+	pEvent->pName = pName;
+	pEvent->pQueue = pQueue;
+	pEvent->qwArg0 = qwArg0;
+	pEvent->qwArg1 = qwArg1;
+	pEvent->eKind = eKind;
+	pEvent->qwSequence.store( qwIndex + 1, std::memory_order_release );
+	pRing->qwHead.store( qwIndex + 1, std::memory_order_release );
+#endif
+}
+
+//copies the slot of ring index qwIndex, false if it does not hold that event (not written yet, overwritten, or being written)
+inline
+bool TraceReadEvent( TraceRing *pRing, u64 qwIndex, TraceEvent *pOut )
+{
+	TraceEvent *pEvent = &pRing->events[qwIndex & ( TRACE_RING_CAPACITY - 1 )];
+	if( pEvent->qwSequence.load( std::memory_order_acquire ) != qwIndex + 1 )
+	{
+		return false;
+	}
+	pOut->qwStartTicks = pEvent->qwStartTicks;
+	pOut->qwDurationTicks = pEvent->qwDurationTicks;
+	pOut->pName = pEvent->pName;
+	pOut->pQueue = pEvent->pQueue;
+	pOut->qwArg0 = pEvent->qwArg0;
+	pOut->qwArg1 = pEvent->qwArg1;
+	pOut->eKind = pEvent->eKind;
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return pEvent->qwSequence.load( std::memory_order_relaxed ) == qwIndex + 1;
+}
+
+//rdtsc ticks per ns since TraceEnable( true ), waits until at least 10ms passed so the rate is good to ~0.01%
+inline
+f64 TraceTicksPerNs()
+{
+	u64 qwNowNs = GetTimeNs();
+	while( qwNowNs - traceState.qwBaseNs < 10000000 )
+	{
+		qwNowNs = GetTimeNs();
+	}
+	return (f64)( ReadCycleCounter() - traceState.qwBaseTicks ) / (f64)( qwNowNs - traceState.qwBaseNs );
+}
+
+inline
+void WriteTraceEventArgs( FILE *pFile, const TraceEvent *pEvent )
+{
+	fprintf( pFile, "\"args\":{" );
+	if( pEvent->pQueue )
+	{
+		fprintf( pFile, "\"queue\":\"%s\"%s", pEvent->pQueue, pEvent->eKind != TRACE_KIND_SCOPE ? "," : "" );
+	}
+	switch( pEvent->eKind )
+	{
+		case TRACE_KIND_RECORD:
+			fprintf( pFile, "\"commands\":%llu", (unsigned long long)pEvent->qwArg0 );
+			break;
+		case TRACE_KIND_EXECUTE:
+			fprintf( pFile, "\"lists\":%llu", (unsigned long long)pEvent->qwArg0 );
+			break;
+		case TRACE_KIND_SIGNAL:
+		case TRACE_KIND_QUEUE_WAIT:
+			fprintf( pFile, "\"fence\":%llu", (unsigned long long)pEvent->qwArg0 );
+			break;
+		case TRACE_KIND_HOST_WAIT:
+			fprintf( pFile, "\"fence\":%llu,\"completed\":%llu", (unsigned long long)pEvent->qwArg0, (unsigned long long)pEvent->qwArg1 );
+			break;
+		case TRACE_KIND_MAP:
+		case TRACE_KIND_UNMAP:
+		case TRACE_KIND_MEMCPY:
+			fprintf( pFile, "\"bytes\":%llu", (unsigned long long)pEvent->qwArg0 );
+			break;
+		default:
+			break;
+	}
+	fprintf( pFile, "}" );
+}
+
+//chrome trace event format, one track per recording thread, times in us relative to the first TraceEnable( true )
+//returns the number of events written, -1 if the file could not be opened
+inline
+s64 WriteTraceJson( const char *pPath, const char *pProcessName )
+{
+	static const char *kindCategories[TRACE_KIND_COUNT] = { "scope", "record", "execute", "signal", "queue_wait", "host_wait", "map", "unmap", "memcpy" };
+	FILE *pFile = fopen( pPath, "w" );
+	if( !pFile )
+	{
+		return -1;
+	}
+	const f64 fUsPerTick = 1.0 / ( TraceTicksPerNs() * 1000.0 );
+	fprintf( pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+	fprintf( pFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"%s\"}}", pProcessName );
+	s64 qwWritten = 0;
+	u32 dwRingCount = traceState.dwRingCount.load( std::memory_order_acquire );
+	dwRingCount = dwRingCount < TRACE_MAX_THREADS ? dwRingCount : TRACE_MAX_THREADS;
+	for( u32 dwRing = 0; dwRing < dwRingCount; ++dwRing )
+	{
+		TraceRing *pRing = traceState.rings[dwRing].load( std::memory_order_acquire );
+		if( !pRing )
+		{
+			continue;
+		}
+		fprintf( pFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", dwRing + 1, pRing->threadName );
+		const u64 qwHead = pRing->qwHead.load( std::memory_order_acquire );
+		const u64 qwFirst = qwHead > TRACE_RING_CAPACITY ? qwHead - TRACE_RING_CAPACITY : 0;
+		for( u64 qwIndex = qwFirst; qwIndex < qwHead; ++qwIndex )
+		{
+			TraceEvent event;
+			if( !TraceReadEvent( pRing, qwIndex, &event ) || event.eKind >= TRACE_KIND_COUNT )
+			{
+				continue;
+			}
+			//events from before the base are clamped to it instead of going negative
+			const f64 fStartUs = event.qwStartTicks > traceState.qwBaseTicks ? (f64)( event.qwStartTicks - traceState.qwBaseTicks ) * fUsPerTick : 0.0;
+			fprintf( pFile, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,",
+					 event.pName, kindCategories[event.eKind], dwRing + 1, fStartUs, (f64)event.qwDurationTicks * fUsPerTick );
+			WriteTraceEventArgs( pFile, &event );
+			fprintf( pFile, "}" );
+			++qwWritten;
+		}
+	}
+	fprintf( pFile, "\n]}\n" );
+	fclose( pFile );
+	return qwWritten;
+}
+
+#endif
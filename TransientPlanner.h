@@ -0,0 +1,208 @@
+#ifndef TRANSIENT_PLANNER_H
+#define TRANSIENT_PLANNER_H
+
+//packs the transient buffers of a multi-pass job into one heap, buffers whose lifetimes don't overlap share offsets
+//a job declares every buffer with the first and last pass that use it (passes are numbered in recording order), the
+//planner places them biggest first, each at the lowest aligned offset that doesn't overlap the memory of a buffer already
+//placed with an overlapping lifetime (greedy, the usual heuristic, not optimal but never worse than one offset per buffer)
+//a buffer that takes over memory from earlier ones needs an aliasing barrier before its first pass, the plan lists them
+//by pass. what a buffer left behind is garbage to the next one, so nothing may read a transient before its first pass writes it
+//the plan is only offsets and pass numbers, the caller creates a heap of qwHeapSize with a placed resource per buffer at its
+//qwOffset (CreateTransientBuffers() in main.cpp) or carves a cpu allocation the same way
+
+#include "Common.h"
+
+#include <string.h>
+
+#define TRANSIENT_MAX_RESOURCES 64
+#define TRANSIENT_NONE 0xFFFFFFFFu
+
+typedef struct TransientResource
+{
+	const char *pName;
+	u64 qwSize;
+	u64 qwAlignment;  //D3D12_RESOURCE_ALLOCATION_INFO::Alignment, 64KB for buffers
+	u32 dwFirstPass;
+	u32 dwLastPass;   //inclusive
+	u64 qwOffset;     //in the heap, from TransientPlanBuild()
+} TransientResource;
+
+//before the first pass of dwAfter, dwBefore is TRANSIENT_NONE when the memory had more than one earlier owner
+//(a NULL ResourceBefore, any placed resource that was in it)
+typedef struct TransientAlias
+{
+	u32 dwPass;
+	u32 dwBefore;
+	u32 dwAfter;
+} TransientAlias;
+
+typedef struct TransientPlan
+{
+	TransientResource resources[TRANSIENT_MAX_RESOURCES];
+	u32 dwResourceCount;
+	u32 dwPassCount;
+	TransientAlias aliases[TRANSIENT_MAX_RESOURCES]; //sorted by pass
+	u32 dwAliasCount;
+	u64 qwHeapSize;      //with aliasing
+	u64 qwUnaliasedSize; //every buffer at its own offset
+	u64 qwPeakLiveBytes; //most bytes alive in one pass, what no packing can go under
+	u32 dwPeakPass;
+} TransientPlan;
+
+inline
+void InitTransientPlan( TransientPlan *pPlan )
+{
+	memset( pPlan, 0, sizeof(TransientPlan) );
+}
+
+//returns the resource's index in the plan, TRANSIENT_NONE when the plan is full
+inline
+u32 TransientPlanDeclare( TransientPlan *pPlan, const char *pName, u64 qwSize, u64 qwAlignment, u32 dwFirstPass, u32 dwLastPass )
+{
+	if( pPlan->dwResourceCount == TRANSIENT_MAX_RESOURCES || dwLastPass < dwFirstPass || qwAlignment == 0 )
+	{
+		return TRANSIENT_NONE;
+	}
+	TransientResource *pResource = &pPlan->resources[pPlan->dwResourceCount];
+	pResource->pName = pName;
+	pResource->qwSize = qwSize;
+	pResource->qwAlignment = qwAlignment;
+	pResource->dwFirstPass = dwFirstPass;
+	pResource->dwLastPass = dwLastPass;
+	pResource->qwOffset = 0;
+	if( dwLastPass + 1 > pPlan->dwPassCount )
+	{
+		pPlan->dwPassCount = dwLastPass + 1;
+	}
+	return pPlan->dwResourceCount++;
+}
+
+inline
+bool TransientLifetimesOverlap( const TransientResource *pA, const TransientResource *pB )
+{
+	return pA->dwFirstPass <= pB->dwLastPass && pB->dwFirstPass <= pA->dwLastPass;
+}
+
+inline
+bool TransientMemoryOverlaps( const TransientResource *pA, const TransientResource *pB )
+{
+	return pA->qwOffset < pB->qwOffset + pB->qwSize && pB->qwOffset < pA->qwOffset + pA->qwSize;
+}
+
+//places every declared resource and lists the aliasing barriers, call once after the last TransientPlanDeclare()
+inline
+void TransientPlanBuild( TransientPlan *pPlan )
+{
+	const u32 dwCount = pPlan->dwResourceCount;
+	TransientResource *pResources = pPlan->resources;
+
+	//biggest first, ties go to the earlier first use
+	u32 order[TRANSIENT_MAX_RESOURCES];
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		u32 dwPos = dwIdx;
+		while( dwPos > 0 && ( pResources[order[dwPos - 1]].qwSize < pResources[dwIdx].qwSize ||
+			   ( pResources[order[dwPos - 1]].qwSize == pResources[dwIdx].qwSize && pResources[order[dwPos - 1]].dwFirstPass > pResources[dwIdx].dwFirstPass ) ) )
+		{
+			order[dwPos] = order[dwPos - 1];
+			--dwPos;
+		}
+		order[dwPos] = dwIdx;
+	}
+
+	pPlan->qwHeapSize = 0;
+	for( u32 dwPlaced = 0; dwPlaced < dwCount; ++dwPlaced )
+	{
+		TransientResource *pResource = &pResources[order[dwPlaced]];
+		//what is already placed and alive at the same time, by offset
+		u32 conflicts[TRANSIENT_MAX_RESOURCES];
+		u32 dwConflictCount = 0;
+		for( u32 dwOther = 0; dwOther < dwPlaced; ++dwOther )
+		{
+			const u32 dwIdx = order[dwOther];
+			if( !TransientLifetimesOverlap( pResource, &pResources[dwIdx] ) )
+			{
+				continue;
+			}
+			u32 dwPos = dwConflictCount++;
+			while( dwPos > 0 && pResources[conflicts[dwPos - 1]].qwOffset > pResources[dwIdx].qwOffset )
+			{
+				conflicts[dwPos] = conflicts[dwPos - 1];
+				--dwPos;
+			}
+			conflicts[dwPos] = dwIdx;
+		}
+		//first gap it fits in
+		u64 qwCandidate = 0;
+		for( u32 dwConflict = 0; dwConflict < dwConflictCount; ++dwConflict )
+		{
+			const TransientResource *pOther = &pResources[conflicts[dwConflict]];
+			if( AlignUp( qwCandidate, pResource->qwAlignment ) + pResource->qwSize <= pOther->qwOffset )
+			{
+				break;
+			}
+			if( pOther->qwOffset + pOther->qwSize > qwCandidate )
+			{
+				qwCandidate = pOther->qwOffset + pOther->qwSize;
+			}
+		}
+		pResource->qwOffset = AlignUp( qwCandidate, pResource->qwAlignment );
+		if( pResource->qwOffset + pResource->qwSize > pPlan->qwHeapSize )
+		{
+			pPlan->qwHeapSize = pResource->qwOffset + pResource->qwSize;
+		}
+	}
+
+	pPlan->qwUnaliasedSize = 0;
+	for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+	{
+		pPlan->qwUnaliasedSize = AlignUp( pPlan->qwUnaliasedSize, pResources[dwIdx].qwAlignment ) + pResources[dwIdx].qwSize;
+	}
+	pPlan->qwPeakLiveBytes = 0;
+	pPlan->dwPeakPass = 0;
+	for( u32 dwPass = 0; dwPass < pPlan->dwPassCount; ++dwPass )
+	{
+		u64 qwLive = 0;
+		for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+		{
+			qwLive += pResources[dwIdx].dwFirstPass <= dwPass && dwPass <= pResources[dwIdx].dwLastPass ? pResources[dwIdx].qwSize : 0;
+		}
+		if( qwLive > pPlan->qwPeakLiveBytes )
+		{
+			pPlan->qwPeakLiveBytes = qwLive;
+			pPlan->dwPeakPass = dwPass;
+		}
+	}
+
+	//every resource that lands on memory an earlier one used, the most recent owner goes in the barrier when there is only one
+	pPlan->dwAliasCount = 0;
+	for( u32 dwPass = 0; dwPass < pPlan->dwPassCount; ++dwPass )
+	{
+		for( u32 dwIdx = 0; dwIdx < dwCount; ++dwIdx )
+		{
+			if( pResources[dwIdx].dwFirstPass != dwPass )
+			{
+				continue;
+			}
+			u32 dwBefore = TRANSIENT_NONE;
+			u32 dwOwners = 0;
+			for( u32 dwOther = 0; dwOther < dwCount; ++dwOther )
+			{
+				if( pResources[dwOther].dwLastPass < dwPass && TransientMemoryOverlaps( &pResources[dwIdx], &pResources[dwOther] ) )
+				{
+					++dwOwners;
+					dwBefore = dwOther;
+				}
+			}
+			if( dwOwners > 0 )
+			{
+				TransientAlias *pAlias = &pPlan->aliases[pPlan->dwAliasCount++];
+				pAlias->dwPass = dwPass;
+				pAlias->dwBefore = dwOwners == 1 ? dwBefore : TRANSIENT_NONE;
+				pAlias->dwAfter = dwIdx;
+			}
+		}
+	}
+}
+
+#endif
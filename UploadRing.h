@@ -0,0 +1,132 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+//ring buffer suballocator over a persistently mapped upload buffer
+//allocations made between two UploadRingSubmit() calls are tagged with the fence value of that submit and
+//are handed back once the fence has completed that value, so streaming never needs more than the ring size
+//head and tail are byte counts that only ever grow, the position in the buffer is the count modulo the ring size
+//only the thread recording the streaming command list should touch the ring, the fence is the only sync point
+
+#include "Common.h"
+
+#define UPLOAD_RING_ALIGNMENT 256 //enough for CopyBufferRegion and constant buffer views
+#define UPLOAD_RING_MAX_SUBMITS 64
+
+typedef struct UploadRingRetirePoint
+{
+	u64 qwFenceValue;
+	u64 qwEnd; //head at the time of the submit, everything before it retires with qwFenceValue
+} UploadRingRetirePoint;
+
+typedef struct UploadRingAllocation
+{
+	u8 *pCpuAddress;
+	u64 qwOffset; //from the start of the upload buffer, the source offset for CopyBufferRegion
+	u64 qwSize;
+} UploadRingAllocation;
+
+typedef struct UploadRing
+{
+	u8 *pMapped;
+	u64 qwSize;
+	u64 qwHead;
+	u64 qwTail;
+	u64 qwSubmittedHead;
+	UploadRingRetirePoint submits[UPLOAD_RING_MAX_SUBMITS];
+	u32 dwFirstSubmit;
+	u32 dwSubmitCount;
+	u64 qwPeakUsed;
+} UploadRing;
+
+//qwSize has to be a multiple of every alignment that will be requested
+inline
+void InitUploadRing( UploadRing *pRing, u8 *pMapped, u64 qwSize )
+{
+	pRing->pMapped = pMapped;
+	pRing->qwSize = qwSize;
+	pRing->qwHead = 0;
+	pRing->qwTail = 0;
+	pRing->qwSubmittedHead = 0;
+	pRing->dwFirstSubmit = 0;
+	pRing->dwSubmitCount = 0;
+	pRing->qwPeakUsed = 0;
+}
+
+inline
+u64 UploadRingUsed( const UploadRing *pRing )
+{
+	return pRing->qwHead - pRing->qwTail;
+}
+
+//fails when the ring is full, retire with the completed fence value or wait on UploadRingOldestFenceValue() and try again
+//an allocation never wraps, the end of the buffer is skipped and retires with the allocation that skipped it
+inline
+bool UploadRingAlloc( UploadRing *pRing, u64 qwSize, u64 qwAlignment, UploadRingAllocation *pAllocation )
+{
+	u64 qwOffset = AlignUp( pRing->qwHead, qwAlignment );
+	if( ( qwOffset % pRing->qwSize ) + qwSize > pRing->qwSize )
+	{
+		qwOffset = ( ( qwOffset / pRing->qwSize ) + 1 ) * pRing->qwSize;
+	}
+	if( qwSize > pRing->qwSize || qwOffset + qwSize - pRing->qwTail > pRing->qwSize )
+	{
+		return false;
+	}
+	pRing->qwHead = qwOffset + qwSize;
+	if( UploadRingUsed( pRing ) > pRing->qwPeakUsed )
+	{
+		pRing->qwPeakUsed = UploadRingUsed( pRing );
+	}
+	pAllocation->qwOffset = qwOffset % pRing->qwSize;
+	pAllocation->pCpuAddress = pRing->pMapped + pAllocation->qwOffset;
+	pAllocation->qwSize = qwSize;
+	return true;
+}
+
+//call right after the queue Signal( fence, qwFenceValue ) that covers the copies reading the allocations made since the last submit
+inline
+void UploadRingSubmit( UploadRing *pRing, u64 qwFenceValue )
+{
+	if( pRing->qwHead == pRing->qwSubmittedHead )
+	{
+		return;
+	}
+	pRing->qwSubmittedHead = pRing->qwHead;
+	if( pRing->dwSubmitCount > 0 )
+	{
+		//same fence value or no room, retiring later than needed is always safe
+		UploadRingRetirePoint *pNewest = &pRing->submits[( pRing->dwFirstSubmit + pRing->dwSubmitCount - 1 ) % UPLOAD_RING_MAX_SUBMITS];
+		if( pNewest->qwFenceValue == qwFenceValue || pRing->dwSubmitCount == UPLOAD_RING_MAX_SUBMITS )
+		{
+			pNewest->qwFenceValue = qwFenceValue;
+			pNewest->qwEnd = pRing->qwHead;
+			return;
+		}
+	}
+	UploadRingRetirePoint *pSubmit = &pRing->submits[( pRing->dwFirstSubmit + pRing->dwSubmitCount ) % UPLOAD_RING_MAX_SUBMITS];
+	pSubmit->qwFenceValue = qwFenceValue;
+	pSubmit->qwEnd = pRing->qwHead;
+	++pRing->dwSubmitCount;
+}
+
+//qwCompletedFenceValue is ID3D12Fence::GetCompletedValue()
+inline
+void UploadRingRetire( UploadRing *pRing, u64 qwCompletedFenceValue )
+{
+	while( pRing->dwSubmitCount > 0 && pRing->submits[pRing->dwFirstSubmit].qwFenceValue <= qwCompletedFenceValue )
+	{
+		pRing->qwTail = pRing->submits[pRing->dwFirstSubmit].qwEnd;
+		pRing->dwFirstSubmit = ( pRing->dwFirstSubmit + 1 ) % UPLOAD_RING_MAX_SUBMITS;
+		--pRing->dwSubmitCount;
+	}
+}
+
+//fence value to wait on before UploadRingRetire() frees anything, 0 when nothing submitted is in flight
+//(allocations that were never submitted can't be freed by waiting)
+inline
+u64 UploadRingOldestFenceValue( const UploadRing *pRing )
+{
+	return pRing->dwSubmitCount > 0 ? pRing->submits[pRing->dwFirstSubmit].qwFenceValue : 0;
+}
+
+#endif
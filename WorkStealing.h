@@ -0,0 +1,125 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+//Chase-Lev work stealing deque of group ranges, the owner pushes/pops at the bottom and thieves steal from the top
+//https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
+//https://fzn.fr/readings/ppopp13.pdf (memory orderings)
+
+#include "Common.h"
+
+#include <atomic>
+
+//ranges are split in halves before being pushed so a deque never holds more than log2(range) entries
+#define WORK_DEQUE_CAPACITY 128
+
+typedef struct WorkRange
+{
+	u64 qwBegin;
+	u64 qwEnd;
+} WorkRange;
+
+typedef struct alignas(64) WorkDeque
+{
+	std::atomic<s64> qwTop;
+	std::atomic<s64> qwBottom;
+	//split into two atomics so a thief reading a slot the owner is writing is not a data race
+	std::atomic<u64> qwBegin[WORK_DEQUE_CAPACITY];
+	std::atomic<u64> qwEnd[WORK_DEQUE_CAPACITY];
+} WorkDeque;
+
+inline
+void InitWorkDeque( WorkDeque *pDeque )
+{
+	pDeque->qwTop.store( 0, std::memory_order_relaxed );
+	pDeque->qwBottom.store( 0, std::memory_order_relaxed );
+}
+
+//owner only
+inline
+bool WorkDequePush( WorkDeque *pDeque, WorkRange range )
+{
+	s64 qwBottom = pDeque->qwBottom.load( std::memory_order_relaxed );
+	s64 qwTop = pDeque->qwTop.load( std::memory_order_acquire );
+	if( qwBottom - qwTop >= WORK_DEQUE_CAPACITY )
+	{
+		return false;
+	}
+	pDeque->qwBegin[qwBottom % WORK_DEQUE_CAPACITY].store( range.qwBegin, std::memory_order_relaxed );
+	pDeque->qwEnd[qwBottom % WORK_DEQUE_CAPACITY].store( range.qwEnd, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	pDeque->qwBottom.store( qwBottom + 1, std::memory_order_relaxed );
+	return true;
+}
+
+//owner only
+inline
+bool WorkDequePop( WorkDeque *pDeque, WorkRange *pRange )
+{
+	s64 qwBottom = pDeque->qwBottom.load( std::memory_order_relaxed ) - 1;
+	pDeque->qwBottom.store( qwBottom, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	s64 qwTop = pDeque->qwTop.load( std::memory_order_relaxed );
+	if( qwTop > qwBottom )
+	{
+		//empty
+		pDeque->qwBottom.store( qwBottom + 1, std::memory_order_relaxed );
+		return false;
+	}
+	pRange->qwBegin = pDeque->qwBegin[qwBottom % WORK_DEQUE_CAPACITY].load( std::memory_order_relaxed );
+	pRange->qwEnd = pDeque->qwEnd[qwBottom % WORK_DEQUE_CAPACITY].load( std::memory_order_relaxed );
+	if( qwTop == qwBottom )
+	{
+		//last entry, race the thieves for it
+		bool bWon = pDeque->qwTop.compare_exchange_strong( qwTop, qwTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+		pDeque->qwBottom.store( qwBottom + 1, std::memory_order_relaxed );
+		return bWon;
+	}
+	return true;
+}
+
+//any thread
+inline
+bool WorkDequeSteal( WorkDeque *pDeque, WorkRange *pRange )
+{
+	s64 qwTop = pDeque->qwTop.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	s64 qwBottom = pDeque->qwBottom.load( std::memory_order_acquire );
+	if( qwTop >= qwBottom )
+	{
+		return false;
+	}
+	pRange->qwBegin = pDeque->qwBegin[qwTop % WORK_DEQUE_CAPACITY].load( std::memory_order_relaxed );
+	pRange->qwEnd = pDeque->qwEnd[qwTop % WORK_DEQUE_CAPACITY].load( std::memory_order_relaxed );
+	return pDeque->qwTop.compare_exchange_strong( qwTop, qwTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+}
+
+//keeps the first qwGrain items of the range and pushes the rest back in halves, largest first so thieves take big pieces
+inline
+WorkRange WorkDequeSplit( WorkDeque *pDeque, WorkRange range, u64 qwGrain )
+{
+	while( range.qwEnd - range.qwBegin > qwGrain )
+	{
+		u64 qwMid = range.qwBegin + ( ( range.qwEnd - range.qwBegin ) >> 1 );
+		WorkRange upper = { qwMid, range.qwEnd };
+		if( !WorkDequePush( pDeque, upper ) )
+		{
+			break;
+		}
+		range.qwEnd = qwMid;
+	}
+	return range;
+}
+
+//xorshift for picking victims
+inline
+u32 WorkStealRandom( u32 *pState )
+{
+	u32 x = *pState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*pState = x;
+	return x;
+}
+
+#endif
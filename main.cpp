@@ -24,10 +24,36 @@
 #	else
 #		if !COMPILED_DEBUG_CSO
 #		include "computeShaderDebug.h"
+#		include "scanReduceBlocksShaderDebug.h"
+#		include "scanBlockPartialsShaderDebug.h"
+#		include "scanDownsweepShaderDebug.h"
+#		include "radixUpsweepShaderDebug.h"
+#		include "radixScatterShaderDebug.h"
+#		include "cullInstancesShaderDebug.h"
+#		include "cullCompactShaderDebug.h"
+#		include "cullGatherVisibleShaderDebug.h"
+#		include "bvhCentroidBoundsShaderDebug.h"
+#		include "bvhMortonCodesShaderDebug.h"
+#		include "bvhEmitHierarchyShaderDebug.h"
+#		include "bvhRefitShaderDebug.h"
+#		include "rayQueryClosestHitShaderDebug.h"
 #		endif
 #	endif
 #else
 #include "computeShader.h"
+#include "scanReduceBlocksShader.h"
+#include "scanBlockPartialsShader.h"
+#include "scanDownsweepShader.h"
+#include "radixUpsweepShader.h"
+#include "radixScatterShader.h"
+#include "cullInstancesShader.h"
+#include "cullCompactShader.h"
+#include "cullGatherVisibleShader.h"
+#include "bvhCentroidBoundsShader.h"
+#include "bvhMortonCodesShader.h"
+#include "bvhEmitHierarchyShader.h"
+#include "bvhRefitShader.h"
+#include "rayQueryClosestHitShader.h"
 #endif
 
 #include <stdint.h>
@@ -37,114 +63,36 @@
 #include <time.h>
 #include <assert.h>
 
-#define PI_F 3.1415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170679f
-#define PI_D 3.1415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170679
-
-typedef uint8_t  u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
-typedef int8_t   s8;
-typedef int16_t  s16;
-typedef int32_t  s32;
-typedef int64_t  s64;
-typedef float    f32; //floating 32
-typedef double   f64; //floating 64
-
-
-typedef struct Mat3f
-{
-	union
-	{
-		f32 m[3][3];
-	};
-} Mat3f;
-
-typedef struct Mat4f
-{
-	union
-	{
-		f32 m[4][4];
-	};
-} Mat4f;
-
-typedef struct Mat3x4f
-{
-	union
-	{
-		f32 m[3][4];
-	};
-} Mat3x4f;
-
-typedef struct Vec2f
-{
-	union
-	{
-		f32 v[2];
-		struct
-		{
-			f32 x;
-			f32 y;
-		};
-	};
-} Vec2f;
-
-typedef struct Vec3f
-{
-	union
-	{
-		f32 v[3];
-		struct
-		{
-			f32 x;
-			f32 y;
-			f32 z;
-		};
-	};
-} Vec3f;
-
-typedef struct Vec4f
-{
-	union
-	{
-		f32 v[4];
-		struct
-		{
-			f32 x;
-			f32 y;
-			f32 z;
-			f32 w;
-		};
-	};
-} Vec4f;
-
-typedef struct Quatf
-{
-	union
-	{
-		f32 q[4];
-		struct
-		{
-			f32 w; //real
-			f32 x;
-			f32 y;
-			f32 z;
-		};
-		struct
-		{
-			f32 real; //real;
-			Vec3f v;
-		};
-	};
-} Quatf;
+#include "Common.h"
+#include "Models.h"
+#include "Math3D.h"
+#include "MeshOptimize.h"
+#include "MeshPack.h"
+#include "UploadRing.h"
+#include "ReadbackArena.h"
+#include "ResultSink.h"
+#include "HeapAllocator.h"
+#include "ResidencyManager.h"
+#include "TransientPlanner.h"
+#include "ResourceStateTracker.h"
+#include "SubmissionBatcher.h"
+#include "CommandAllocatorPool.h"
+#include "Scan.h"
+#include "RadixSort.h"
+#include "Culling.h"
+#include "Bvh.h"
+#include "RayQuery.h"
+#include "StreamPipeline.h"
+#include "FenceTimeline.h"
+#include "Timer.h"
+#include "TraceEvents.h"
 
 //Amazing page https://learn.microsoft.com/en-us/windows/win32/direct3d12/user-mode-heap-synchronization?redirectedfrom=MSDN
 ID3D12Device2* device;
 ID3D12CommandQueue* computeQueue;
-ID3D12CommandAllocator* computeCommandAllocator[2];
 ID3D12GraphicsCommandList* computeCommandList;
 ID3D12CommandQueue* streamingQueue;
-ID3D12CommandAllocator* streamingCommandAllocator[2];
+ID3D12CommandAllocator* streamingCommandAllocator; //uploads, readback copies use the allocators of their compute slot
 ID3D12GraphicsCommandList* streamingCommandList;
 UINT cbvsrvuavDescriptorSize;
 
@@ -155,6 +103,15 @@ HANDLE computeFenceEvent;
 ID3D12Fence* streamingFence;
 u64 streamingFenceValue;
 HANDLE streamingFenceEvent;
+FenceTimeline fenceTimeline; //startup readbacks are handled on its waiter thread instead of blocking InitDirectX12()
+HANDLE fenceTimelineEvent;
+
+//queue names in the trace
+#define COMPUTE_QUEUE_NAME "compute"
+#define STREAMING_QUEUE_NAME "streaming"
+#define TRACE_PATH "Trace.json" //build with MAIN_TRACE=1 to record from startup and write the chrome trace here after InitDirectX12()
+#define RESULTS_PATH "Results.bin" //build with MAIN_RESULTS=1 to also write the InitDirectX12() readback values here
+#define RESULTS_QUEUE_DEPTH 16
 
 //All views
 //Remeber views are required so the gpu can see and understand a resourse (only exception is root constants), so if anything is to be used by a shader it must have a view
@@ -166,832 +123,2741 @@ D3D12_VERTEX_BUFFER_VIEW cubeVertexBufferView;
 D3D12_INDEX_BUFFER_VIEW cubeIndexBufferView;
 u32 cubeIndexCount;
 
+#define MODEL_PACK_PATH "Models.mpk" //baked with CpuCompute --bake-models, the built in meshes are used when it is missing
+
+#define UPLOAD_RING_SIZE (4u << 20) //multiple of the 64KB heap alignment, bounds all streaming uploads in flight
+#define UPLOAD_RING_MAX_ALLOC ( UPLOAD_RING_SIZE / 2 ) //allocations never wrap, half the ring always fits once it drained, wherever its head is
+
 ID3D12Heap* pModelDefaultHeap;
-ID3D12Heap* pModelUploadHeap; //will be <= size of the default heap
+ID3D12Heap* pUploadRingHeap;
 ID3D12Heap* pComputeOutputHeap;
 ID3D12Heap* pReadbackHeap;
 
+//every heap is tracked against the video memory budget, idle ones are evicted least recently used first when it is exceeded
+//and made resident again by the next submission that uses them
+#define RESIDENCY_QUEUE_COMPUTE 0
+#define RESIDENCY_QUEUE_STREAMING 1
+#define LOCAL_BUDGET_LIMIT RESIDENCY_NO_LIMIT //lower to run oversubscribed on a gpu with plenty of memory
+IDXGIAdapter3* videoMemoryAdapter; //for QueryVideoMemoryInfo()
+ResidencyManager residencyManager;
+u32 dwModelHeapResidency;
+u32 dwUploadRingHeapResidency;
+u32 dwComputeOutputHeapResidency;
+u32 dwReadbackHeapResidency;
+
+//the bvh build + ray query graph's buffers are transients placed in one heap, the sort temporaries share memory with the
+//nodes, parents and hits (DeclareRayQueryTransients()), RecordBuildBvh()/RecordRayQueryClosestHit() get the plan
+ID3D12Heap* pRayQueryHeap;
+u32 dwRayQueryHeapResidency;
+TransientPlan rayQueryPlan;
+RayQueryTransients rayQueryTransients;
+ID3D12Resource* rayQueryBuffers[TRANSIENT_MAX_RESOURCES];
+TrackedResource rayQueryBufferStates[TRANSIENT_MAX_RESOURCES];
+
 ID3D12Resource* defaultBuffer; //a default placed resource
-ID3D12Resource* uploadBuffer; //a tmp upload placed resource
-ID3D12Resource* computeOutputBuffer[2]; //a readback placed resource
-ID3D12Resource* readbackBuffer[2]; //a readback placed resource
+ID3D12Resource* uploadRingBuffer; //persistently mapped, suballocated by uploadRing
+UploadRing uploadRing;
+
+//compute output buffers are suballocated so many small buffers can share a heap
+#define COMPUTE_HEAP_SIZE (4u << 20) //multiple of the 64KB heap alignment
+#define COMPUTE_HEAP_MAX_BLOCKS 4096
+HeapAllocator computeOutputHeapAllocator;
+
+//readback copies land in one buffer over the whole readback heap, mapped once, results are read where they landed
+#define READBACK_ARENA_SIZE (16u << 20) //multiple of the 64KB heap alignment, a million ModelOutData
+ID3D12Resource* readbackArenaBuffer; //a readback placed resource
+TrackedResource readbackArenaState;
+ReadbackArena readbackArena;
+
+//every dispatch gets a slot that owns everything it touches until its readback copy is done
+//a slot is recycled once the streaming fence passes that copy, which also means its dispatch is done
+#define MAX_INFLIGHT_COMPUTE 4
+#define NUM_INFLIGHT_COMPUTE 3 //1 is lockstep: dispatch, copy, wait, read
+//build with MEASURE_COMPUTE_RATE=1 to print the sustained dispatch rate for 1 to MAX_INFLIGHT_COMPUTE slots
+typedef struct ComputeSlot
+{
+	ID3D12CommandAllocator* computeCommandAllocator;
+	ID3D12CommandAllocator* streamingCommandAllocator;
+	ID3D12Resource* computeOutputBuffer; //a default placed resource
+	HeapAllocation computeOutputAllocation;
+	TrackedResource computeOutputState;
+	u64 qwReadbackFenceValue; //0 when there is nothing to wait for
+} ComputeSlot;
+ComputeSlot computeSlots[MAX_INFLIGHT_COMPUTE];
+
+//barriers come from declared usage, flushed as one ResourceBarrier() call before every Dispatch/Copy
+TrackedResource modelBufferState;
+ResourceStateTracker computeStateTracker;
+ResourceStateTracker streamingStateTracker;
+
+//batched jobs record into the compute list with allocators from a pool, an allocator goes back to it
+//once the compute fence passed the last batch recorded with it
+#define COMPUTE_BATCH_ALLOCATORS 4
+typedef struct ComputeBatchRecorder
+{
+	CommandAllocatorPool allocatorPool;
+} ComputeBatchRecorder;
+ComputeBatchRecorder computeBatchRecorder;
+
+//big submissions are recorded by several threads, each into its own list with allocators from its own pool
+//the lists go to the queue in one ExecuteCommandLists in worker order
+#define COMPUTE_RECORD_WORKERS 4
+#define COMPUTE_RECORD_ALLOCATORS 4 //per worker
+typedef struct ComputeParallelRecorder
+{
+	ParallelRecorder recorder;
+	ID3D12GraphicsCommandList* commandLists[PARALLEL_RECORD_MAX_WORKERS];
+	ResourceStateTracker stateTrackers[PARALLEL_RECORD_MAX_WORKERS]; //closed in worker order once every list is recorded
+	const ComputeShaderCB *pCBs; //current submission
+} ComputeParallelRecorder;
 
 //pipeline info
 ID3D12RootSignature* computeRootSignature; // root signature defines data shaders will access
 ID3D12PipelineState* computePipelineStateObject; // pso containing a pipeline state
 
+//Scan.hlsl, the three passes share one root signature
+ID3D12RootSignature* scanRootSignature;
+ID3D12PipelineState* scanReduceBlocksPSO;
+ID3D12PipelineState* scanBlockPartialsPSO;
+ID3D12PipelineState* scanDownsweepPSO;
+
+//RadixSort.hlsl
+ID3D12RootSignature* radixSortRootSignature;
+ID3D12PipelineState* radixUpsweepPSO;
+ID3D12PipelineState* radixScatterPSO;
+
+//Culling.hlsl
+ID3D12RootSignature* cullRootSignature;
+ID3D12PipelineState* cullInstancesPSO;
+ID3D12PipelineState* cullCompactPSO;
+ID3D12PipelineState* cullGatherVisiblePSO; //the RecordDispatchVisibleInstances() consumer of the startup checks
+ID3D12CommandSignature* cullDispatchCommandSignature; //ExecuteIndirect() of the visible instance list header
+
+//Bvh.hlsl
+ID3D12RootSignature* bvhRootSignature;
+ID3D12PipelineState* bvhCentroidBoundsPSO;
+ID3D12PipelineState* bvhMortonCodesPSO;
+ID3D12PipelineState* bvhEmitHierarchyPSO;
+ID3D12PipelineState* bvhRefitPSO;
+
+//RayQuery.hlsl
+ID3D12RootSignature* rayQueryRootSignature;
+ID3D12PipelineState* rayQueryClosestHitPSO;
+
 #if MAIN_DEBUG
 ID3D12Debug *debugInterface;
 ID3D12InfoQueue *pIQueue; 
 #endif
 
-typedef struct ComputeShaderCB
-{
-	u32 dwOffsetsAndStrides0[4];
-} ComputeShaderCB;
+f32 clamp(f32 d, f32 min, f32 max) {
+  const f32 t = d < min ? min : d;
+  return t > max ? max : t;
+}
 
-typedef struct ModelOutData
+u32 max( u32 a, u32 b )
 {
-	u32 dwData[4];
-} ModelOutData;
+	return a > b ? a : b;
+}
 
-inline
-void InitMat3f( Mat3f *a_pMat )
+//TODO CHANGE TO A POPUP AND FILE LOG
+int logWindowsError(const char* msg)
 {
-	a_pMat->m[0][0] = 1; a_pMat->m[0][1] = 0; a_pMat->m[0][2] = 0;
-	a_pMat->m[1][0] = 0; a_pMat->m[1][1] = 1; a_pMat->m[1][2] = 0;
-	a_pMat->m[2][0] = 0; a_pMat->m[2][1] = 0; a_pMat->m[2][2] = 1;
+#if MAIN_DEBUG
+    LPVOID lpMsgBuf;
+    DWORD dw = GetLastError();
+
+    FormatMessage( FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        NULL, dw, MAKELANGID( LANG_NEUTRAL, SUBLANG_DEFAULT ), (LPTSTR)&lpMsgBuf, 0, NULL );
+    OutputDebugStringA( msg );
+    OutputDebugStringA( (LPCTSTR)lpMsgBuf );
+
+    LocalFree( lpMsgBuf );
+    //MessageBoxW(NULL, L"Error creating DXGI factory", L"Error", MB_OK | MB_ICONERROR);
+#endif
+    return -1;
 }
 
-inline
-void InitMat4f( Mat4f *a_pMat )
+int logError(const char* msg)
 {
-	a_pMat->m[0][0] = 1; a_pMat->m[0][1] = 0; a_pMat->m[0][2] = 0; a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0; a_pMat->m[1][1] = 1; a_pMat->m[1][2] = 0; a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0; a_pMat->m[2][1] = 0; a_pMat->m[2][2] = 1; a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = 0; a_pMat->m[3][1] = 0; a_pMat->m[3][2] = 0; a_pMat->m[3][3] = 1;
+#if MAIN_DEBUG
+	MessageBoxA(NULL, msg, "Error", MB_OK | MB_ICONERROR);
+#endif
+    return -1;
 }
 
+#if MAIN_DEBUG
 inline
-void InitTransMat4f( Mat4f *a_pMat, f32 x, f32 y, f32 z )
+bool EnableDebugLayer()
 {
-	a_pMat->m[0][0] = 1; a_pMat->m[0][1] = 0; a_pMat->m[0][2] = 0; a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0; a_pMat->m[1][1] = 1; a_pMat->m[1][2] = 0; a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0; a_pMat->m[2][1] = 0; a_pMat->m[2][2] = 1; a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = x; a_pMat->m[3][1] = y; a_pMat->m[3][2] = z; a_pMat->m[3][3] = 1;
+    // Always enable the debug layer before doing anything DX12 related
+    // so all possible errors generated while creating DX12 objects
+    // are caught by the debug layer.
+    if ( FAILED( D3D12GetDebugInterface( IID_PPV_ARGS( &debugInterface ) ) ) )
+    {
+    	logError( "Error creating DirectX12 Debug layer\n" );  
+        return false;
+    }
+    debugInterface->EnableDebugLayer();
+    return true;
 }
 
 inline
-void InitTransMat4f( Mat4f *a_pMat, Vec3f *a_pTrans )
+void ReportLiveObjects()
 {
-	a_pMat->m[0][0] = 1;           a_pMat->m[0][1] = 0;           a_pMat->m[0][2] = 0;           a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;           a_pMat->m[1][1] = 1;           a_pMat->m[1][2] = 0;           a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;           a_pMat->m[2][1] = 0;           a_pMat->m[2][2] = 1;           a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = a_pTrans->x; a_pMat->m[3][1] = a_pTrans->y; a_pMat->m[3][2] = a_pTrans->z; a_pMat->m[3][3] = 1;
+    IDXGIDebug1* dxgiDebug;
+    DXGIGetDebugInterface1(0, IID_PPV_ARGS(&dxgiDebug));
+
+    dxgiDebug->ReportLiveObjects(DXGI_DEBUG_ALL, DXGI_DEBUG_RLO_IGNORE_INTERNAL);
+    dxgiDebug->Release();
 }
+#endif
 
-/*
 inline
-void InitRotXMat4f( Mat4f *a_pMat, f32 angle )
+ID3D12CommandQueue *InitCopyCommandQueue( ID3D12Device2* dxd3Device, u32 dwGPUNumber )
 {
-	a_pMat->m[0][0] = 1; a_pMat->m[0][1] = 0;                        a_pMat->m[0][2] = 0;                       a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0; a_pMat->m[1][1] = cosf(angle*PI_F/180.0f);  a_pMat->m[1][2] = sinf(angle*PI_F/180.0f); a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0; a_pMat->m[2][1] = -sinf(angle*PI_F/180.0f); a_pMat->m[2][2] = cosf(angle*PI_F/180.0f); a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = 0; a_pMat->m[3][1] = 0;                        a_pMat->m[3][2] = 0;                       a_pMat->m[3][3] = 1;
+	ID3D12CommandQueue *cq;
+	D3D12_COMMAND_QUEUE_DESC cqDesc;
+    cqDesc.Type =     D3D12_COMMAND_LIST_TYPE_COPY;
+    cqDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    cqDesc.Flags =    D3D12_COMMAND_QUEUE_FLAG_NONE;
+    cqDesc.NodeMask = dwGPUNumber;
+
+    if( FAILED( dxd3Device->CreateCommandQueue( &cqDesc, IID_PPV_ARGS( &cq ) ) ) )
+	{
+		return NULL;
+	}
+	return cq;
 }
 
 inline
-void InitRotYMat4f( Mat4f *a_pMat, f32 angle )
+ID3D12CommandQueue *InitComputeCommandQueue( ID3D12Device2* dxd3Device, u32 dwGPUNumber )
 {
-	a_pMat->m[0][0] = cosf(angle*PI_F/180.0f);  a_pMat->m[0][1] = 0; a_pMat->m[0][2] = -sinf(angle*PI_F/180.0f); a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;                        a_pMat->m[1][1] = 1; a_pMat->m[1][2] = 0;                        a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = sinf(angle*PI_F/180.0f);  a_pMat->m[2][1] = 0; a_pMat->m[2][2] = cosf(angle*PI_F/180.0f);  a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = 0;                        a_pMat->m[3][1] = 0; a_pMat->m[3][2] = 0;                        a_pMat->m[3][3] = 1;
+	ID3D12CommandQueue *cq;
+	D3D12_COMMAND_QUEUE_DESC cqDesc;
+    cqDesc.Type =     D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    cqDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    cqDesc.Flags =    D3D12_COMMAND_QUEUE_FLAG_NONE;
+    cqDesc.NodeMask = dwGPUNumber;
+
+    if( FAILED( dxd3Device->CreateCommandQueue( &cqDesc, IID_PPV_ARGS( &cq ) ) ) )
+	{
+		return NULL;
+	}
+	return cq;
 }
 
 inline
-void InitRotZMat4f( Mat4f *a_pMat, f32 angle )
+void WaitForFenceValue( ID3D12Fence* fence, HANDLE fenceEvent, u64 qwValue, const char *pQueue )
 {
-	a_pMat->m[0][0] = cosf(angle*PI_F/180.0f);  a_pMat->m[0][1] = sinf(angle*PI_F/180.0f); a_pMat->m[0][2] = 0; a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = -sinf(angle*PI_F/180.0f); a_pMat->m[1][1] = cosf(angle*PI_F/180.0f); a_pMat->m[1][2] = 0; a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;                        a_pMat->m[2][1] = 0; 					   a_pMat->m[2][2] = 1; a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = 0;                        a_pMat->m[3][1] = 0;                       a_pMat->m[3][2] = 0; a_pMat->m[3][3] = 1;
+	const u64 qwCompletedValue = fence->GetCompletedValue();
+	if( qwCompletedValue < qwValue )
+	{
+		const u64 qwTraceStart = TraceBegin();
+		fence->SetEventOnCompletion( qwValue, fenceEvent );
+		WaitForSingleObject( fenceEvent, INFINITE );
+		TraceEnd( qwTraceStart, TRACE_KIND_HOST_WAIT, "WaitForFenceValue", pQueue, qwValue, qwCompletedValue );
+	}
 }
-*/
 
-inline
-void InitRotArbAxisMat4f( Mat4f *a_pMat, Vec3f *a_pAxis, f32 angle )
+//FenceTimelineCallbacks on ID3D12Fence + an auto reset event HANDLE
+u64 CompletedTimelineFenceValue( void *pContext, void *pFence )
 {
-	f32 c = cosf(angle*PI_F/180.0f);
-	f32 mC = 1.0f-c;
-	f32 s = sinf(angle*PI_F/180.0f);
-	a_pMat->m[0][0] = c                          + (a_pAxis->x*a_pAxis->x*mC); a_pMat->m[0][1] = (a_pAxis->y*a_pAxis->x*mC) + (a_pAxis->z*s);             a_pMat->m[0][2] = (a_pAxis->z*a_pAxis->x*mC) - (a_pAxis->y*s);             a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = (a_pAxis->x*a_pAxis->y*mC) - (a_pAxis->z*s);             a_pMat->m[1][1] = c                          + (a_pAxis->y*a_pAxis->y*mC); a_pMat->m[1][2] = (a_pAxis->z*a_pAxis->y*mC) + (a_pAxis->x*s);             a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = (a_pAxis->x*a_pAxis->z*mC) + (a_pAxis->y*s);             a_pMat->m[2][1] = (a_pAxis->y*a_pAxis->z*mC) - (a_pAxis->x*s);             a_pMat->m[2][2] = c                          + (a_pAxis->z*a_pAxis->z*mC); a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = 0;                                                       a_pMat->m[3][1] = 0;                                                       a_pMat->m[3][2] = 0;                                                       a_pMat->m[3][3] = 1;
+	return ( (ID3D12Fence*)pFence )->GetCompletedValue();
 }
 
-/*
-//can't use near and far cause of stupid msvc https://stackoverflow.com/questions/3869830/near-and-far-pointers/3869852
-//Following is OpenGL, but i need to verify that it is what the OpenGL standard gives!
-inline
-void InitPerspectiveProjectionMat4fOpenGL( Mat4f *a_pMat, u64 width, u64 height, f32 a_hFOV, f32 a_vFOV, f32 nearPlane, f32 farPlane )
-{
-	f32 thFOV = tanf(a_hFOV*0.5f);
-	f32 tvFOV = tanf(a_vFOV*0.5f);
-	f64 dNearPlane = (f64)nearPlane;
-	f64 dFarPlane = (f64)farPlane;
-	f64 nMinF = (dNearPlane-dFarPlane);
-  	f32 aspect = height / (f32)width;
-	a_pMat->m[0][0] = aspect/(thFOV*thFOV); a_pMat->m[0][1] = 0;                  a_pMat->m[0][2] = 0;                               		 a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;                    a_pMat->m[1][1] = 1.0f/(tvFOV*tvFOV); a_pMat->m[1][2] = 0;                               		 a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;                    a_pMat->m[2][1] = 0;                  a_pMat->m[2][2] = (f32)((dFarPlane+dNearPlane)/nMinF);     a_pMat->m[2][3] = -1.0f;
-	a_pMat->m[3][0] = 0;                    a_pMat->m[3][1] = 0;                  a_pMat->m[3][2] = (f32)(2.0*(dFarPlane*dNearPlane)/nMinF); a_pMat->m[3][3] = 0;
-}
-inline
-void InitInvPerspectiveProjectionMat4fOpenGL( Mat4f *a_pMat, u64 width, u64 height, f32 a_hFOV, f32 a_vFOV, f32 nearPlane, f32 farPlane )
-{
-	f32 thFOV = tanf(a_hFOV*0.5f);
-	f32 tvFOV = tanf(a_vFOV*0.5f);
-	f64 dNearPlane = (f64)nearPlane;
-	f64 dFarPlane = (f64)farPlane;
-	f64 nMinF = (dNearPlane-dFarPlane);
-	f64 fFarNearDoubled = (2.0*(dFarPlane*dNearPlane));
-  	f32 invAspect = (f32)width/height;
-	a_pMat->m[0][0] = thFOV*thFOV*invAspect; 		   a_pMat->m[0][1] = 0;             a_pMat->m[0][2] = 0;     a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;                               a_pMat->m[1][1] = tvFOV * tvFOV; a_pMat->m[1][2] = 0;     a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;                               a_pMat->m[2][1] = 0;             a_pMat->m[2][2] = 0;     a_pMat->m[2][3] = (f32)(nMinF/fFarNearDoubled);
-	a_pMat->m[3][0] = 0;                               a_pMat->m[3][1] = 0;             a_pMat->m[3][2] = -1.0f; a_pMat->m[3][3] = (f32)((dFarPlane+dNearPlane)/fFarNearDoubled);
+void SetTimelineEventOnCompletion( void *pContext, void *pFence, u64 qwValue, void *pEvent )
+{
+	( (ID3D12Fence*)pFence )->SetEventOnCompletion( qwValue, (HANDLE)pEvent );
 }
-*/
 
-//Following are DirectX Matrices
-inline
-void InitPerspectiveProjectionMat4fDirectXRH( Mat4f *a_pMat, u64 width, u64 height, f32 a_hFOV, f32 a_vFOV, f32 nearPlane, f32 farPlane )
+//a NULL event blocks until the value is reached
+void WaitForTimelineFence( void *pContext, void *pFence, u64 qwValue )
 {
-	f32 thFOV = tanf(a_hFOV*PI_F/360);
-	f32 tvFOV = tanf(a_vFOV*PI_F/360);
-	f32 nMinF = farPlane/(nearPlane-farPlane);
-  	f32 aspect = height / (f32)width;
-	a_pMat->m[0][0] = aspect/(thFOV); a_pMat->m[0][1] = 0;            a_pMat->m[0][2] = 0;               a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;              a_pMat->m[1][1] = 1.0f/(tvFOV); a_pMat->m[1][2] = 0;               a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;              a_pMat->m[2][1] = 0;            a_pMat->m[2][2] = nMinF;           a_pMat->m[2][3] = -1.0f;
-	a_pMat->m[3][0] = 0;              a_pMat->m[3][1] = 0;            a_pMat->m[3][2] = nearPlane*nMinF; a_pMat->m[3][3] = 0;
+	const u64 qwTraceStart = TraceBegin();
+	( (ID3D12Fence*)pFence )->SetEventOnCompletion( qwValue, NULL );
+	TraceEnd( qwTraceStart, TRACE_KIND_HOST_WAIT, "WaitForTimelineFence", NULL, qwValue );
 }
 
-inline
-void InitPerspectiveProjectionMat4fDirectXLH( Mat4f *a_pMat, u64 width, u64 height, f32 a_hFOV, f32 a_vFOV, f32 nearPlane, f32 farPlane )
+void SetTimelineEvent( void *pContext, void *pEvent )
 {
-	f32 thFOV = tanf(a_hFOV*PI_F/360);
-	f32 tvFOV = tanf(a_vFOV*PI_F/360);
-	f32 nMinF = farPlane/(nearPlane-farPlane);
-  	f32 aspect = height / (f32)width;
-	a_pMat->m[0][0] = aspect/(thFOV); a_pMat->m[0][1] = 0;            a_pMat->m[0][2] = 0;               a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;              a_pMat->m[1][1] = 1.0f/(tvFOV); a_pMat->m[1][2] = 0;               a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 0;              a_pMat->m[2][1] = 0;            a_pMat->m[2][2] = -nMinF;          a_pMat->m[2][3] = 1.0f;
-	a_pMat->m[3][0] = 0;              a_pMat->m[3][1] = 0;            a_pMat->m[3][2] = nearPlane*nMinF; a_pMat->m[3][3] = 0;
+	SetEvent( (HANDLE)pEvent );
 }
 
-/*
-inline
-void InitPerspectiveProjectionMat4fOculusDirectXLH( Mat4f *a_pMat, ovrFovPort tanHalfFov, f32 nearPlane, f32 farPlane )
+void WaitForTimelineEvent( void *pContext, void *pEvent )
 {
-    f32 projXScale = 2.0f / ( tanHalfFov.LeftTan + tanHalfFov.RightTan );
-    f32 projXOffset = ( tanHalfFov.LeftTan - tanHalfFov.RightTan ) * projXScale * 0.5f;
-    f32 projYScale = 2.0f / ( tanHalfFov.UpTan + tanHalfFov.DownTan );
-    f32 projYOffset = ( tanHalfFov.UpTan - tanHalfFov.DownTan ) * projYScale * 0.5f;
-	f32 nMinF = farPlane/(nearPlane-farPlane);
-	a_pMat->m[0][0] = projXScale;  a_pMat->m[0][1] = 0;            a_pMat->m[0][2] = 0;               a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;           a_pMat->m[1][1] = projYScale;   a_pMat->m[1][2] = 0;               a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = projXOffset; a_pMat->m[2][1] = -projYOffset; a_pMat->m[2][2] = -nMinF;          a_pMat->m[2][3] = 1.0f;
-	a_pMat->m[3][0] = 0;           a_pMat->m[3][1] = 0;            a_pMat->m[3][2] = nearPlane*nMinF; a_pMat->m[3][3] = 0;
+	WaitForSingleObject( (HANDLE)pEvent, INFINITE );
 }
 
-
 inline
-void InitPerspectiveProjectionMat4fOculusDirectXRH( Mat4f *a_pMat, ovrFovPort tanHalfFov, f32 nearPlane, f32 farPlane )
+void InitMainFenceTimeline()
 {
-    f32 projXScale = 2.0f / ( tanHalfFov.LeftTan + tanHalfFov.RightTan );
-    f32 projXOffset = ( tanHalfFov.LeftTan - tanHalfFov.RightTan ) * projXScale * 0.5f;
-    f32 projYScale = 2.0f / ( tanHalfFov.UpTan + tanHalfFov.DownTan );
-    f32 projYOffset = ( tanHalfFov.UpTan - tanHalfFov.DownTan ) * projYScale * 0.5f;
-	f32 nMinF = farPlane/(nearPlane-farPlane);
-	a_pMat->m[0][0] = projXScale;   a_pMat->m[0][1] = 0;           a_pMat->m[0][2] = 0;               a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 0;            a_pMat->m[1][1] = projYScale;  a_pMat->m[1][2] = 0;               a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = -projXOffset; a_pMat->m[2][1] = projYOffset; a_pMat->m[2][2] = nMinF;           a_pMat->m[2][3] = -1.0f;
-	a_pMat->m[3][0] = 0;            a_pMat->m[3][1] = 0;           a_pMat->m[3][2] = nearPlane*nMinF; a_pMat->m[3][3] = 0;
+	FenceTimelineCallbacks callbacks;
+	callbacks.pfnCompletedValue = CompletedTimelineFenceValue;
+	callbacks.pfnSetEventOnCompletion = SetTimelineEventOnCompletion;
+	callbacks.pfnWait = WaitForTimelineFence;
+	callbacks.pfnSetEvent = SetTimelineEvent;
+	callbacks.pfnWaitEvent = WaitForTimelineEvent;
+	callbacks.pContext = NULL;
+	fenceTimelineEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+	InitFenceTimeline( &fenceTimeline, &callbacks, fenceTimelineEvent );
 }
-*/
 
+//returns once every job on the timeline has finished
 inline
-f32 DeterminantUpper3x3Mat4f( Mat4f *a_pMat )
+void DestroyMainFenceTimeline()
 {
-	return (a_pMat->m[0][0] * ((a_pMat->m[1][1]*a_pMat->m[2][2]) - (a_pMat->m[1][2]*a_pMat->m[2][1]))) + 
-		   (a_pMat->m[0][1] * ((a_pMat->m[2][0]*a_pMat->m[1][2]) - (a_pMat->m[1][0]*a_pMat->m[2][2]))) + 
-		   (a_pMat->m[0][2] * ((a_pMat->m[1][0]*a_pMat->m[2][1]) - (a_pMat->m[2][0]*a_pMat->m[1][1])));
+	DestroyFenceTimeline( &fenceTimeline );
+	CloseHandle( fenceTimelineEvent );
 }
 
+//queue calls that also record their trace event
 inline
-void InverseUpper3x3Mat4f( Mat4f *__restrict a_pMat, Mat4f *__restrict out )
+void ExecuteCommandListsTraced( ID3D12CommandQueue* queue, const char *pQueue, u32 dwCount, ID3D12CommandList* const* ppCommandLists )
 {
-	f32 fDet = DeterminantUpper3x3Mat4f( a_pMat );
-#if MAIN_DEBUG
-	assert( fDet != 0.f );
-#endif
-	f32 fInvDet = 1.0f / fDet;
-	out->m[0][0] = fInvDet * ((a_pMat->m[1][1]*a_pMat->m[2][2]) - (a_pMat->m[1][2]*a_pMat->m[2][1]));
-	out->m[0][1] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[2][1]) - (a_pMat->m[0][1]*a_pMat->m[2][2]));
-	out->m[0][2] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[1][2]) - (a_pMat->m[0][2]*a_pMat->m[1][1]));
-	out->m[0][3] = 0.0f;
-
-	out->m[1][0] = fInvDet * ((a_pMat->m[2][0]*a_pMat->m[1][2]) - (a_pMat->m[2][2]*a_pMat->m[1][0]));
-	out->m[1][1] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[2][2]) - (a_pMat->m[0][2]*a_pMat->m[2][0])); 
-	out->m[1][2] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[1][0]) - (a_pMat->m[1][2]*a_pMat->m[0][0]));
-	out->m[1][3] = 0.0f;
-
-	out->m[2][0] = fInvDet * ((a_pMat->m[1][0]*a_pMat->m[2][1]) - (a_pMat->m[1][1]*a_pMat->m[2][0]));
-	out->m[2][1] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[2][0]) - (a_pMat->m[0][0]*a_pMat->m[2][1]));
-	out->m[2][2] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[1][1]) - (a_pMat->m[1][0]*a_pMat->m[0][1]));
-	out->m[2][3] = 0.0f;
-
-	out->m[3][0] = 0.0f;
-	out->m[3][1] = 0.0f;
-	out->m[3][2] = 0.0f;
-	out->m[3][3] = 1.0f;
+	const u64 qwTraceStart = TraceBegin();
+	queue->ExecuteCommandLists( dwCount, ppCommandLists );
+	TraceEnd( qwTraceStart, TRACE_KIND_EXECUTE, "ExecuteCommandLists", pQueue, dwCount );
 }
 
 inline
-void InverseTransposeUpper3x3Mat4f( Mat4f *__restrict a_pMat, Mat4f *__restrict out )
+void SignalTraced( ID3D12CommandQueue* queue, const char *pQueue, ID3D12Fence* fence, u64 qwValue )
 {
-	f32 fDet = DeterminantUpper3x3Mat4f( a_pMat );
-#if MAIN_DEBUG
-	assert( fDet != 0.f );
-#endif
-	f32 fInvDet = 1.0f / fDet;
-	out->m[0][0] = fInvDet * ((a_pMat->m[1][1]*a_pMat->m[2][2]) - (a_pMat->m[1][2]*a_pMat->m[2][1]));
-	out->m[0][1] = fInvDet * ((a_pMat->m[2][0]*a_pMat->m[1][2]) - (a_pMat->m[2][2]*a_pMat->m[1][0]));
-	out->m[0][2] = fInvDet * ((a_pMat->m[1][0]*a_pMat->m[2][1]) - (a_pMat->m[1][1]*a_pMat->m[2][0]));
-	out->m[0][3] = 0.0f;
-
-	out->m[1][0] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[2][1]) - (a_pMat->m[0][1]*a_pMat->m[2][2]));
-	out->m[1][1] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[2][2]) - (a_pMat->m[0][2]*a_pMat->m[2][0])); 
-	out->m[1][2] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[2][0]) - (a_pMat->m[0][0]*a_pMat->m[2][1]));
-	out->m[1][3] = 0.0f;
-
-	out->m[2][0] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[1][2]) - (a_pMat->m[0][2]*a_pMat->m[1][1]));
-	out->m[2][1] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[1][0]) - (a_pMat->m[1][2]*a_pMat->m[0][0]));
-	out->m[2][2] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[1][1]) - (a_pMat->m[1][0]*a_pMat->m[0][1]));
-	out->m[2][3] = 0.0f;
-
-	out->m[3][0] = 0.0f;
-	out->m[3][1] = 0.0f;
-	out->m[3][2] = 0.0f;
-	out->m[3][3] = 1.0f;
+	const u64 qwTraceStart = TraceBegin();
+	queue->Signal( fence, qwValue );
+	TraceEnd( qwTraceStart, TRACE_KIND_SIGNAL, "Signal", pQueue, qwValue );
 }
 
 inline
-void InverseTransposeUpper3x3Mat4f( Mat4f *__restrict a_pMat, Mat3x4f *__restrict out )
+void QueueWaitTraced( ID3D12CommandQueue* queue, const char *pQueue, ID3D12Fence* fence, u64 qwValue )
 {
-	f32 fDet = DeterminantUpper3x3Mat4f( a_pMat );
-#if MAIN_DEBUG
-	assert( fDet != 0.f );
-#endif
-	f32 fInvDet = 1.0f / fDet;
-	out->m[0][0] = fInvDet * ((a_pMat->m[1][1]*a_pMat->m[2][2]) - (a_pMat->m[1][2]*a_pMat->m[2][1]));
-	out->m[0][1] = fInvDet * ((a_pMat->m[2][0]*a_pMat->m[1][2]) - (a_pMat->m[2][2]*a_pMat->m[1][0]));
-	out->m[0][2] = fInvDet * ((a_pMat->m[1][0]*a_pMat->m[2][1]) - (a_pMat->m[1][1]*a_pMat->m[2][0]));
-	out->m[0][3] = 0.0f;
-
-	out->m[1][0] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[2][1]) - (a_pMat->m[0][1]*a_pMat->m[2][2]));
-	out->m[1][1] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[2][2]) - (a_pMat->m[0][2]*a_pMat->m[2][0])); 
-	out->m[1][2] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[2][0]) - (a_pMat->m[0][0]*a_pMat->m[2][1]));
-	out->m[1][3] = 0.0f;
-
-	out->m[2][0] = fInvDet * ((a_pMat->m[0][1]*a_pMat->m[1][2]) - (a_pMat->m[0][2]*a_pMat->m[1][1]));
-	out->m[2][1] = fInvDet * ((a_pMat->m[0][2]*a_pMat->m[1][0]) - (a_pMat->m[1][2]*a_pMat->m[0][0]));
-	out->m[2][2] = fInvDet * ((a_pMat->m[0][0]*a_pMat->m[1][1]) - (a_pMat->m[1][0]*a_pMat->m[0][1]));
-	out->m[2][3] = 0.0f;
+	const u64 qwTraceStart = TraceBegin();
+	queue->Wait( fence, qwValue );
+	TraceEnd( qwTraceStart, TRACE_KIND_QUEUE_WAIT, "Wait", pQueue, qwValue );
 }
 
-
-inline
-void Mat4fMult( Mat4f *__restrict a, Mat4f *__restrict b, Mat4f *__restrict out)
+//PFN_ResidencyBudget, what the os currently lets the process keep resident in the segment
+u64 QueryResidencyBudget( void *pContext, u32 dwSegment )
 {
-	out->m[0][0] = a->m[0][0]*b->m[0][0] + a->m[0][1]*b->m[1][0] + a->m[0][2]*b->m[2][0] + a->m[0][3]*b->m[3][0];
-	out->m[0][1] = a->m[0][0]*b->m[0][1] + a->m[0][1]*b->m[1][1] + a->m[0][2]*b->m[2][1] + a->m[0][3]*b->m[3][1];
-	out->m[0][2] = a->m[0][0]*b->m[0][2] + a->m[0][1]*b->m[1][2] + a->m[0][2]*b->m[2][2] + a->m[0][3]*b->m[3][2];
-	out->m[0][3] = a->m[0][0]*b->m[0][3] + a->m[0][1]*b->m[1][3] + a->m[0][2]*b->m[2][3] + a->m[0][3]*b->m[3][3];
-
-	out->m[1][0] = a->m[1][0]*b->m[0][0] + a->m[1][1]*b->m[1][0] + a->m[1][2]*b->m[2][0] + a->m[1][3]*b->m[3][0];
-	out->m[1][1] = a->m[1][0]*b->m[0][1] + a->m[1][1]*b->m[1][1] + a->m[1][2]*b->m[2][1] + a->m[1][3]*b->m[3][1];
-	out->m[1][2] = a->m[1][0]*b->m[0][2] + a->m[1][1]*b->m[1][2] + a->m[1][2]*b->m[2][2] + a->m[1][3]*b->m[3][2];
-	out->m[1][3] = a->m[1][0]*b->m[0][3] + a->m[1][1]*b->m[1][3] + a->m[1][2]*b->m[2][3] + a->m[1][3]*b->m[3][3];
-
-	out->m[2][0] = a->m[2][0]*b->m[0][0] + a->m[2][1]*b->m[1][0] + a->m[2][2]*b->m[2][0] + a->m[2][3]*b->m[3][0];
-	out->m[2][1] = a->m[2][0]*b->m[0][1] + a->m[2][1]*b->m[1][1] + a->m[2][2]*b->m[2][1] + a->m[2][3]*b->m[3][1];
-	out->m[2][2] = a->m[2][0]*b->m[0][2] + a->m[2][1]*b->m[1][2] + a->m[2][2]*b->m[2][2] + a->m[2][3]*b->m[3][2];
-	out->m[2][3] = a->m[2][0]*b->m[0][3] + a->m[2][1]*b->m[1][3] + a->m[2][2]*b->m[2][3] + a->m[2][3]*b->m[3][3];
-
-	out->m[3][0] = a->m[3][0]*b->m[0][0] + a->m[3][1]*b->m[1][0] + a->m[3][2]*b->m[2][0] + a->m[3][3]*b->m[3][0];
-	out->m[3][1] = a->m[3][0]*b->m[0][1] + a->m[3][1]*b->m[1][1] + a->m[3][2]*b->m[2][1] + a->m[3][3]*b->m[3][1];
-	out->m[3][2] = a->m[3][0]*b->m[0][2] + a->m[3][1]*b->m[1][2] + a->m[3][2]*b->m[2][2] + a->m[3][3]*b->m[3][2];
-	out->m[3][3] = a->m[3][0]*b->m[0][3] + a->m[3][1]*b->m[1][3] + a->m[3][2]*b->m[2][3] + a->m[3][3]*b->m[3][3];
+	DXGI_QUERY_VIDEO_MEMORY_INFO info;
+	const DXGI_MEMORY_SEGMENT_GROUP segmentGroup = dwSegment == RESIDENCY_SEGMENT_LOCAL ? DXGI_MEMORY_SEGMENT_GROUP_LOCAL : DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL;
+	if( !videoMemoryAdapter || FAILED( videoMemoryAdapter->QueryVideoMemoryInfo( 0, segmentGroup, &info ) ) )
+	{
+		return RESIDENCY_NO_LIMIT;
+	}
+	return info.Budget;
 }
 
-inline
-void Vec3fAdd( Vec3f *a, Vec3f *b, Vec3f *out )
+//PFN_ResidencyCompletedFenceValue
+u64 CompletedResidencyFenceValue( void *pContext, u32 dwQueue )
 {
-	out->x = a->x + b->x;
-	out->y = a->y + b->y;
-	out->z = a->z + b->z;
+	ID3D12Fence* fence = dwQueue == RESIDENCY_QUEUE_COMPUTE ? computeFence : streamingFence;
+	return fence ? fence->GetCompletedValue() : 0;
 }
 
-inline
-void Vec3fSub( Vec3f *a, Vec3f *b, Vec3f *out )
+//PFN_ResidencyEvict, evicted heaps keep their contents so MakeResident() is all a restore needs, nothing is uploaded again
+bool EvictHeap( void *pContext, void *pHeap )
 {
-	out->x = a->x - b->x;
-	out->y = a->y - b->y;
-	out->z = a->z - b->z;
+	ID3D12Pageable* pPageable = (ID3D12Heap*)pHeap;
+	return SUCCEEDED( device->Evict( 1, &pPageable ) );
 }
 
-inline
-void Vec3fMult( Vec3f *a, Vec3f *b, Vec3f *out )
+//PFN_ResidencyMakeResident
+bool MakeHeapResident( void *pContext, void *pHeap )
 {
-	out->x = a->x * b->x;
-	out->y = a->y * b->y;
-	out->z = a->z * b->z;
+	ID3D12Pageable* pPageable = (ID3D12Heap*)pHeap;
+	const u64 qwTraceStart = TraceBegin();
+	const bool bResident = SUCCEEDED( device->MakeResident( 1, &pPageable ) );
+	TraceEnd( qwTraceStart, TRACE_KIND_SCOPE, "MakeResident", NULL, 0 );
+	return bResident;
 }
 
 inline
-void Vec3fCross( Vec3f *a, Vec3f *b, Vec3f *out )
+void InitResidency()
 {
-	out->x = (a->y * b->z) - (a->z * b->y);
-	out->y = (a->z * b->x) - (a->x * b->z);
-	out->z = (a->x * b->y) - (a->y * b->x);
+	ResidencyCallbacks callbacks;
+	callbacks.pfnBudget = QueryResidencyBudget;
+	callbacks.pfnCompletedFenceValue = CompletedResidencyFenceValue;
+	callbacks.pfnEvict = EvictHeap;
+	callbacks.pfnMakeResident = MakeHeapResident;
+	callbacks.pContext = NULL;
+	InitResidencyManager( &residencyManager, &callbacks, 2 );
+	ResidencySetBudgetLimit( &residencyManager, RESIDENCY_SEGMENT_LOCAL, LOCAL_BUDGET_LIMIT );
 }
 
+//call before the submission on dwQueue that signals qwFenceValue, waits for the gpu to be done with older heaps while
+//the budget is full, false if the heap does not fit next to the ones already used by this submission
 inline
-void Vec3fScale( Vec3f *a, f32 scale, Vec3f *out )
+bool UseResidentHeap( u32 dwHeap, u32 dwQueue, u64 qwFenceValue )
 {
-	out->x = a->x * scale;
-	out->y = a->y * scale;
-	out->z = a->z * scale;
+	if( dwHeap == RESIDENCY_NONE )
+	{
+		return true; //not tracked, was created resident and stays that way
+	}
+	while( !ResidencyUse( &residencyManager, dwHeap, dwQueue, qwFenceValue ) )
+	{
+		u32 dwBusyQueue;
+		u64 qwBusyValue;
+		const bool bBusy = ResidencyOldestBusy( &residencyManager, residencyManager.heaps[dwHeap].dwSegment, &dwBusyQueue, &qwBusyValue );
+		if( !bBusy || qwBusyValue > ( dwBusyQueue == RESIDENCY_QUEUE_COMPUTE ? computeFenceValue : streamingFenceValue ) )
+		{
+			logError( "A heap does not fit in the video memory budget!\n" );
+			return false;
+		}
+		if( dwBusyQueue == RESIDENCY_QUEUE_COMPUTE )
+		{
+			WaitForFenceValue( computeFence, computeFenceEvent, qwBusyValue, COMPUTE_QUEUE_NAME );
+		}
+		else
+		{
+			WaitForFenceValue( streamingFence, streamingFenceEvent, qwBusyValue, STREAMING_QUEUE_NAME );
+		}
+	}
+	return true;
 }
 
-
+//one upload heap for every streaming copy, mapped once and never unmapped (upload heaps can stay mapped while the gpu reads them)
 inline
-void Vec3fScaleAdd( Vec3f *a, f32 scale, Vec3f *b, Vec3f *out )
+bool InitUploadRingBuffer( u32 dwGPUNumber, u32 dwVisibleGPUMask )
 {
-	out->x = (a->x * scale) + b->x;
-	out->y = (a->y * scale) + b->y;
-	out->z = (a->z * scale) + b->z;
+	D3D12_HEAP_DESC uploadHeapDesc;
+	uploadHeapDesc.SizeInBytes = UPLOAD_RING_SIZE;
+	uploadHeapDesc.Properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+	uploadHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	uploadHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	uploadHeapDesc.Properties.CreationNodeMask = dwGPUNumber;
+	uploadHeapDesc.Properties.VisibleNodeMask = dwVisibleGPUMask;
+	uploadHeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	uploadHeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS | D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
+	if( FAILED( device->CreateHeap( &uploadHeapDesc, IID_PPV_ARGS(&pUploadRingHeap) ) ) )
+	{
+		return false;
+	}
+#if MAIN_DEBUG
+	pUploadRingHeap->SetName( L"Upload Ring Heap" );
+#endif
+	//persistently mapped, never evicted
+	dwUploadRingHeapResidency = ResidencyTrackHeap( &residencyManager, pUploadRingHeap, UPLOAD_RING_SIZE, RESIDENCY_SEGMENT_NON_LOCAL, "Upload Ring Heap", true );
+
+	D3D12_RESOURCE_DESC uploadRingDesc;
+  	uploadRingDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  	uploadRingDesc.Alignment = 0;
+  	uploadRingDesc.Width = UPLOAD_RING_SIZE;
+  	uploadRingDesc.Height = 1;
+  	uploadRingDesc.DepthOrArraySize = 1;
+  	uploadRingDesc.MipLevels = 1;
+  	uploadRingDesc.Format = DXGI_FORMAT_UNKNOWN;
+  	uploadRingDesc.SampleDesc.Count = 1;
+  	uploadRingDesc.SampleDesc.Quality = 0;
+  	uploadRingDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  	uploadRingDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	if( FAILED( device->CreatePlacedResource( pUploadRingHeap, 0, &uploadRingDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadRingBuffer) ) ) )
+	{
+		return false;
+	}
+
+	D3D12_RANGE emptyRange;
+    emptyRange.Begin = 0;
+    emptyRange.End = 0;
+	u8 *pUploadRingData;
+	const u64 qwTraceStart = TraceBegin();
+	if( FAILED( uploadRingBuffer->Map( 0, &emptyRange, (void**) &pUploadRingData ) ) ) //we never read it
+	{
+		return false;
+	}
+	TraceEnd( qwTraceStart, TRACE_KIND_MAP, "Map upload ring", NULL, 0 );
+	InitUploadRing( &uploadRing, pUploadRingData, UPLOAD_RING_SIZE );
+	return true;
 }
 
+//blocks on the streaming fence while the ring is full of copies that are still in flight
 inline
-f32 Vec3fDot( Vec3f *a, Vec3f *b )
+bool AllocStreamingUpload( u64 qwSize, UploadRingAllocation *pAllocation )
 {
-	return (a->x * b->x) + (a->y * b->y) + (a->z * b->z);
+	UploadRingRetire( &uploadRing, streamingFence->GetCompletedValue() );
+	while( !UploadRingAlloc( &uploadRing, qwSize, UPLOAD_RING_ALIGNMENT, pAllocation ) )
+	{
+		const u64 qwWaitValue = UploadRingOldestFenceValue( &uploadRing );
+		if( qwWaitValue == 0 )
+		{
+			return false; //bigger than the ring or the ring is full of copies that were never submitted
+		}
+		WaitForFenceValue( streamingFence, streamingFenceEvent, qwWaitValue, STREAMING_QUEUE_NAME );
+		UploadRingRetire( &uploadRing, streamingFence->GetCompletedValue() );
+	}
+	return true;
 }
 
+//records everything the tracker collected since the last flush as a single ResourceBarrier() call
 inline
-void Vec3fNormalize( Vec3f *a, Vec3f *out )
+void FlushTrackedBarriers( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker )
 {
-
-	f32 mag = sqrtf((a->x*a->x) + (a->y*a->y) + (a->z*a->z));
-	if(mag == 0)
+	ResourceBarrierDesc trackedBarriers[RESOURCE_TRACKER_MAX_BARRIERS];
+	const u32 dwBarrierCount = FlushResourceBarriers( pTracker, trackedBarriers );
+	if( dwBarrierCount == 0 )
 	{
-		out->x = 0;
-		out->y = 0;
-		out->z = 0;
+		return;
 	}
-	else
+	D3D12_RESOURCE_BARRIER barriers[RESOURCE_TRACKER_MAX_BARRIERS];
+	for( u32 dwBarrier = 0; dwBarrier < dwBarrierCount; ++dwBarrier )
 	{
-		out->x = a->x/mag;
-		out->y = a->y/mag;
-		out->z = a->z/mag;
+		barriers[dwBarrier].Type = (D3D12_RESOURCE_BARRIER_TYPE)trackedBarriers[dwBarrier].eType;
+		barriers[dwBarrier].Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		if( trackedBarriers[dwBarrier].eType == RESOURCE_BARRIER_UAV )
+		{
+			barriers[dwBarrier].UAV.pResource = (ID3D12Resource*)trackedBarriers[dwBarrier].pResource;
+			continue;
+		}
+		if( trackedBarriers[dwBarrier].eType == RESOURCE_BARRIER_ALIASING )
+		{
+			barriers[dwBarrier].Aliasing.pResourceBefore = (ID3D12Resource*)trackedBarriers[dwBarrier].pResourceBefore;
+			barriers[dwBarrier].Aliasing.pResourceAfter = (ID3D12Resource*)trackedBarriers[dwBarrier].pResource;
+			continue;
+		}
+		barriers[dwBarrier].Transition.pResource = (ID3D12Resource*)trackedBarriers[dwBarrier].pResource;
+		barriers[dwBarrier].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		barriers[dwBarrier].Transition.StateBefore = (D3D12_RESOURCE_STATES)trackedBarriers[dwBarrier].dwStateBefore;
+		barriers[dwBarrier].Transition.StateAfter = (D3D12_RESOURCE_STATES)trackedBarriers[dwBarrier].dwStateAfter;
 	}
+	pCommandList->ResourceBarrier( dwBarrierCount, barriers );
 }
 
-
+//the aliasing barriers of dwPass go out with the next flush, pTransients are the plan's resources by index, nothing without a plan
 inline
-void Vec3fLerp( Vec3f *a, Vec3f *b, f32 fT, Vec3f *out )
+void TrackTransientAliases( ResourceStateTracker *pTracker, const TransientPlan *pPlan, u32 dwPass, TrackedResource *pTransients )
 {
-	Vec3f vTmp;
-	Vec3fSub(b,a,&vTmp);
-	Vec3fScaleAdd(&vTmp,fT,a,out);
+	if( !pPlan )
+	{
+		return;
+	}
+	for( u32 dwAlias = 0; dwAlias < pPlan->dwAliasCount; ++dwAlias )
+	{
+		const TransientAlias *pAlias = &pPlan->aliases[dwAlias];
+		if( pAlias->dwPass == dwPass )
+		{
+			TrackResourceAliasing( pTracker, pAlias->dwBefore != TRANSIENT_NONE ? &pTransients[pAlias->dwBefore] : NULL, &pTransients[pAlias->dwAfter] );
+		}
+	}
 }
 
+//submits the streaming copies recorded so far and waits for them, the ring drains and the list records again from the start
 inline
-void Vec3fRotByUnitQuat(Vec3f *v, Quatf *__restrict q, Vec3f *out)
+void FlushStreamingUploads()
 {
-    f32 fVecScalar = (2.0f*q->w*q->w)-1;
-    f32 fQuatVecScalar = 2.0f* Vec3fDot(v,&q->v);
-
-    Vec3f vScaledQuatVec;
-    Vec3f vScaledVec;
-    Vec3fScale(&q->v,fQuatVecScalar,&vScaledQuatVec);
-    Vec3fScale(v,fVecScalar,&vScaledVec);
-
-    Vec3f vQuatCrossVec;
-    Vec3fCross(&q->v, v, &vQuatCrossVec);
-
-    Vec3fScale(&vQuatCrossVec,2.0f*q->w,&vQuatCrossVec);
-
-    Vec3fAdd(&vScaledQuatVec,&vScaledVec,out);
-    Vec3fAdd(out,&vQuatCrossVec,out);
+	ResourceStateTrackerClose( &streamingStateTracker );
+	streamingCommandList->Close();
+	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
+	ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	UploadRingSubmit( &uploadRing, streamingFenceValue );
+	WaitForFenceValue( streamingFence, streamingFenceEvent, streamingFenceValue, STREAMING_QUEUE_NAME );
+	streamingCommandAllocator->Reset();
+	streamingCommandList->Reset( streamingCommandAllocator, NULL );
 }
 
-/*
+//records the model blob copy into streamingCommandList, a blob bigger than the ring goes in chunks and the list is
+//submitted whenever the ring is full of its own copies, returns false with nothing usable in defaultBuffer
 inline
-void Vec3fRotByUnitQuat(Vec3f *v, Quatf *__restrict q, Vec3f *out)
+bool UploadModels( u32 dwGPUNumber, u32 dwVisibleGPUMask )
 {
-	Vec3f vDoubleRot;
-	vDoubleRot.x = q->x + q->x;
-	vDoubleRot.y = q->y + q->y;
-	vDoubleRot.z = q->z + q->z;
-
-	Vec3f vScaledWRot;
-	vScaledWRot.x = q->w * vDoubleRot.x;
-	vScaledWRot.y = q->w * vDoubleRot.y;
-	vScaledWRot.z = q->w * vDoubleRot.z;
+	//prefer the baked mesh pack, it is mapped and copied into the upload heap as is
+	//otherwise weld + vertex cache/fetch reorder the built in meshes and lay them out the same way
+	MeshPackFile modelPack;
+	MeshPackEntry meshEntries[BUILTIN_MESH_COUNT];
+	const u8 *pModelBlob;
+	u8 *pBuiltinBlob = NULL;
+	u64 qwModelSize;
+	if( OpenMeshPack( MODEL_PACK_PATH, &modelPack ) && modelPack.pHeader->dwMeshCount >= BUILTIN_MESH_COUNT )
+	{
+		memcpy( meshEntries, modelPack.pEntries, sizeof(meshEntries) );
+		pModelBlob = MeshPackBlob( &modelPack );
+		qwModelSize = modelPack.pHeader->qwBlobSize;
+	}
+	else
+	{
+		CloseMeshPack( &modelPack );
+		MeshData builtinMeshes[BUILTIN_MESH_COUNT];
+		if( !OptimizeBuiltinMeshes( builtinMeshes ) )
+		{
+			return false;
+		}
+		qwModelSize = PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, NULL, NULL );
+		pBuiltinBlob = (u8*)malloc( qwModelSize );
+		if( pBuiltinBlob )
+		{
+			PackMeshBlob( builtinMeshes, BUILTIN_MESH_COUNT, pBuiltinBlob, meshEntries );
+		}
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_PLANE] );
+		FreeMeshData( &builtinMeshes[BUILTIN_MESH_CUBE] );
+		if( !pBuiltinBlob )
+		{
+			return false;
+		}
+		pModelBlob = pBuiltinBlob;
+	}
+	planeIndexCount = meshEntries[BUILTIN_MESH_PLANE].dwIndexCount;
+	cubeIndexCount = meshEntries[BUILTIN_MESH_CUBE].dwIndexCount;
 
-	Vec3f vScaledXRot;
-	vScaledXRot.x = q->x * vDoubleRot.x;
-	vScaledXRot.y = q->x * vDoubleRot.y;
-	vScaledXRot.z = q->x * vDoubleRot.z;
+	D3D12_RESOURCE_DESC resourceBufferDesc; //describes what is placed in heap
+  	resourceBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  	resourceBufferDesc.Alignment = 0;
+  	resourceBufferDesc.Width = qwModelSize;
+  	resourceBufferDesc.Height = 1;
+  	resourceBufferDesc.DepthOrArraySize = 1;
+  	resourceBufferDesc.MipLevels = 1;
+  	resourceBufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+  	resourceBufferDesc.SampleDesc.Count = 1;
+  	resourceBufferDesc.SampleDesc.Quality = 0;
+  	resourceBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  	resourceBufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE; //D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE
 
-	f32 fScaledYRot0 = q->y * vDoubleRot.y;
-	f32 fScaledYRot1 = q->y * vDoubleRot.z;
+	D3D12_RESOURCE_ALLOCATION_INFO allocInfo = device->GetResourceAllocationInfo( dwVisibleGPUMask, 1, &resourceBufferDesc );
+	const u64 qwHeapSize = AlignUp( allocInfo.SizeInBytes, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT );
 
-	f32 fScaledZRot0 = q->z * vDoubleRot.z;
+	//https://zhangdoa.com/posts/walking-through-the-heap-properties-in-directx-12
+	//https://asawicki.info/news_1726_secrets_of_direct3d_12_resource_alignment
+	//https://docs.microsoft.com/en-us/windows/win32/api/d3d12/ne-d3d12-d3d12_resource_heap_tier#D3D12_RESOURCE_HEAP_TIER_1
+	// we only allow buffers to stay within the first tier heap tier
+	D3D12_HEAP_DESC modelHeapDesc;
+	modelHeapDesc.SizeInBytes = qwHeapSize;
+	modelHeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+	modelHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	modelHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	modelHeapDesc.Properties.CreationNodeMask = dwGPUNumber;
+	modelHeapDesc.Properties.VisibleNodeMask = dwVisibleGPUMask;
+	modelHeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT; //64KB heap alignment, SizeInBytes should be a multiple of the heap alignment. is 64KB here 65536
+	modelHeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS | D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
 
-	out->x = ((v->x * ((1.f - fScaledYRot0) - fScaledZRot0)) + (v->y * (vScaledXRot.y - vScaledWRot.z))) + (v->z * (vScaledXRot.z + vScaledWRot.y));
-	out->y = ((v->x * (vScaledXRot.y + vScaledWRot.z)) + (v->y * ((1.f - vScaledXRot.x) - fScaledZRot0))) + (v->z * (fScaledYRot1 - vScaledWRot.x));
-	out->z = ((v->x * (vScaledXRot.z - vScaledWRot.y)) + (v->y * (fScaledYRot1 + vScaledWRot.x))) + (v->z * ((1.f - vScaledXRot.x) - fScaledYRot0));
-}
-*/
+	if( FAILED( device->CreateHeap( &modelHeapDesc, IID_PPV_ARGS(&pModelDefaultHeap) ) ) )
+	{
+		CloseMeshPack( &modelPack );
+		free( pBuiltinBlob );
+		return false;
+	}
+#if MAIN_DEBUG
+	pModelDefaultHeap->SetName( L"Model Buffer Default Resource Heap" );
+#endif
+	dwModelHeapResidency = ResidencyTrackHeap( &residencyManager, pModelDefaultHeap, qwHeapSize, RESIDENCY_SEGMENT_LOCAL, "Model Heap", false );
 
+  	//verify that we are using the advanced model!
+	if( FAILED( device->CreatePlacedResource( pModelDefaultHeap, 0, &resourceBufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&defaultBuffer) ) ) )
+	{
+		CloseMeshPack( &modelPack );
+		free( pBuiltinBlob );
+		return false;
+	}
+	InitTrackedResource( &modelBufferState, defaultBuffer, TRACKED_STATE_COPY_DEST, true );
 
-inline
-void InitUnitQuatf( Quatf *q, f32 angle, Vec3f *axis )
-{
-	f32 s = sinf(angle*PI_F/360.0f);
-	q->w = cosf(angle*PI_F/360.0f);
-	q->x = axis->x * s;
-	q->y = axis->y * s;
-	q->z = axis->z * s;
-}
+    //upload to upload heap (TODO is there a penalty from crossing a buffer alignment boundary with mesh data?)
+    //TODO is there a penatly for not having meshes at an alignment or their own resouce?
+	bool bUploaded = true;
+	for( u64 qwChunkOffset = 0; qwChunkOffset < qwModelSize; qwChunkOffset += UPLOAD_RING_MAX_ALLOC )
+	{
+		const u64 qwChunkSize = qwModelSize - qwChunkOffset < UPLOAD_RING_MAX_ALLOC ? qwModelSize - qwChunkOffset : UPLOAD_RING_MAX_ALLOC;
+		UploadRingAllocation chunkUpload;
+		if( !AllocStreamingUpload( qwChunkSize, &chunkUpload ) )
+		{
+			//the ring is full of earlier chunks that were only recorded, they have to execute before it can wrap
+			FlushStreamingUploads();
+			if( !AllocStreamingUpload( qwChunkSize, &chunkUpload ) )
+			{
+				logError( "Model blob chunk does not fit in the upload ring!\n" );
+				bUploaded = false;
+				break;
+			}
+		}
+		const u64 qwTraceStart = TraceBegin();
+		memcpy( chunkUpload.pCpuAddress, pModelBlob + qwChunkOffset, qwChunkSize );
+		TraceEnd( qwTraceStart, TRACE_KIND_MEMCPY, "Upload models", NULL, qwChunkSize );
+
+		if( !UseResidentHeap( dwModelHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) )
+		{
+			bUploaded = false;
+			break;
+		}
+		TrackResourceState( &streamingStateTracker, &modelBufferState, TRACKED_STATE_COPY_DEST );
+		FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+		streamingCommandList->CopyBufferRegion( defaultBuffer, qwChunkOffset, uploadRingBuffer, chunkUpload.qwOffset, qwChunkSize );
+	}
+	CloseMeshPack( &modelPack );
+	free( pBuiltinBlob );
+	if( !bUploaded )
+	{
+		return false;
+	}
+
+    //does this apply in my case https://twitter.com/MyNameIsMJP/status/1574431011579928580 ?
+    MeshVertexBufferView vertexView;
+    MeshIndexBufferView indexView;
+    GetMeshPackViews( &meshEntries[BUILTIN_MESH_PLANE], defaultBuffer->GetGPUVirtualAddress(), &vertexView, &indexView );
+    planeVertexBufferView.BufferLocation = vertexView.BufferLocation;
+    planeVertexBufferView.StrideInBytes = vertexView.StrideInBytes; //size of s single vertex
+    planeVertexBufferView.SizeInBytes = vertexView.SizeInBytes;
+
+	planeIndexBufferView.BufferLocation = indexView.BufferLocation;
+    planeIndexBufferView.SizeInBytes = indexView.SizeInBytes;
+    planeIndexBufferView.Format = (DXGI_FORMAT)indexView.Format; 
+
+    GetMeshPackViews( &meshEntries[BUILTIN_MESH_CUBE], defaultBuffer->GetGPUVirtualAddress(), &vertexView, &indexView );
+    cubeVertexBufferView.BufferLocation = vertexView.BufferLocation;
+    cubeVertexBufferView.StrideInBytes = vertexView.StrideInBytes; //size of s single vertex
+    cubeVertexBufferView.SizeInBytes = vertexView.SizeInBytes;
+
+	cubeIndexBufferView.BufferLocation = indexView.BufferLocation;
+    cubeIndexBufferView.SizeInBytes = indexView.SizeInBytes;
+    cubeIndexBufferView.Format = (DXGI_FORMAT)indexView.Format;
+	return true;
+}
+
+//dwCount results read in place from the readback arena, valid from WaitForModelOutSpan() until ReleaseModelOutSpan()
+typedef struct ModelOutSpan
+{
+	const ModelOutData *pResults;
+	u32 dwCount;
+	u64 qwFenceValue; //streaming fence value of the last copy into the span
+} ModelOutSpan;
+
+//blocks until every copy into the span is done
+inline
+void WaitForModelOutSpan( const ModelOutSpan *pSpan )
+{
+	WaitForFenceValue( streamingFence, streamingFenceEvent, pSpan->qwFenceValue, STREAMING_QUEUE_NAME );
+}
+
+//prints the results once the copies into the span are done, runs on the fence timeline's waiter thread
+//the span stays valid because it is only released after DestroyMainFenceTimeline()
+FenceTimelineJob PrintModelOutSpan( ModelOutSpan span )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, span.qwFenceValue );
+	for( u32 dwResult = 0; dwResult < span.dwCount; ++dwResult )
+	{
+		const ModelOutData *pResult = &span.pResults[dwResult];
+		printf( "%u %u %u %u\n", pResult->dwData[0], pResult->dwData[1], pResult->dwData[2], pResult->dwData[3] );
+	}
+}
+
+//also releases every span that was handed out before this one
+inline
+void ReleaseModelOutSpan( const ModelOutSpan *pSpan )
+{
+	ReadbackArenaRelease( &readbackArena, pSpan->qwFenceValue );
+}
+
+//hands the span to the sink instead of releasing it, PumpResultSink() releases it once it is written
+//the span has to be done (WaitForModelOutSpan())
+inline
+bool SinkModelOutSpan( ResultSink *pSink, const ModelOutSpan *pSpan )
+{
+	return ResultSinkAppend( pSink, (const u8*)pSpan->pResults, (u64)pSpan->dwCount * sizeof(ModelOutData), pSpan->qwFenceValue );
+}
+
+//never blocks, call between submissions so written spans go back to the readback arena
+inline
+void PumpResultSink( ResultSink *pSink )
+{
+	ReadbackArenaRelease( &readbackArena, ResultSinkPoll( pSink ) );
+}
+
+//waits for the slot's readback copy, after this the slot can be recorded into again
+inline
+void RecycleComputeSlot( ComputeSlot *pSlot )
+{
+	if( pSlot->qwReadbackFenceValue == 0 )
+	{
+		return;
+	}
+	WaitForFenceValue( streamingFence, streamingFenceEvent, pSlot->qwReadbackFenceValue, STREAMING_QUEUE_NAME );
+	pSlot->qwReadbackFenceValue = 0;
+}
+
+//one dispatch + readback copy per cb, up to dwInFlight of them are queued before the oldest slot is waited on
+//pResults->pResults[i] is the output of pCBs[i] once WaitForModelOutSpan() returns, fails when the readback arena
+//is full of spans that were not released
+inline
+bool RunComputeDispatches( const ComputeShaderCB *pCBs, u32 dwDispatchCount, u32 dwInFlight, ModelOutSpan *pResults )
+{
+	ID3D12CommandList* ppComputeCommandLists[] = { computeCommandList };
+	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
+
+	ReadbackSpan span;
+	if( dwDispatchCount == 0 || !ReadbackArenaAlloc( &readbackArena, (u64)dwDispatchCount * sizeof(ModelOutData), READBACK_ARENA_ALIGNMENT, &span ) )
+	{
+		return false;
+	}
+	for( u32 dwDispatch = 0; dwDispatch < dwDispatchCount; ++dwDispatch )
+	{
+		ComputeSlot *pSlot = &computeSlots[dwDispatch % dwInFlight];
+		RecycleComputeSlot( pSlot );
+		if( !UseResidentHeap( dwModelHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) ||
+			!UseResidentHeap( dwComputeOutputHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) )
+		{
+			//the span is tagged with the copies already queued so the next release hands it back
+			ReadbackArenaSubmit( &readbackArena, streamingFenceValue );
+			return false;
+		}
+
+		u64 qwTraceStart = TraceBegin();
+		pSlot->computeCommandAllocator->Reset();
+		computeCommandList->Reset( pSlot->computeCommandAllocator, computePipelineStateObject );
+		computeCommandList->SetComputeRootSignature( computeRootSignature ); //is this set with the pso?
+		computeCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),&pCBs[dwDispatch],0);
+		computeCommandList->SetComputeRootShaderResourceView(1,defaultBuffer->GetGPUVirtualAddress());
+		computeCommandList->SetComputeRootUnorderedAccessView(2,pSlot->computeOutputBuffer->GetGPUVirtualAddress());
+		TrackResourceState( &computeStateTracker, &modelBufferState, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+		TrackResourceState( &computeStateTracker, &pSlot->computeOutputState, TRACKED_STATE_UNORDERED_ACCESS );
+		FlushTrackedBarriers( computeCommandList, &computeStateTracker );
+		computeCommandList->Dispatch(1,1,1);
+		//the copy reads the output on the streaming queue after this list is done, by then it has decayed back to COMMON
+		ResourceStateTrackerClose( &computeStateTracker );
+	    computeCommandList->Close();
+		TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record dispatch", COMPUTE_QUEUE_NAME, 1 );
+		ExecuteCommandListsTraced( computeQueue, COMPUTE_QUEUE_NAME, _countof( ppComputeCommandLists ), ppComputeCommandLists );
+		//Stick at the end of the queue so we know when Our list will be ready
+		SignalTraced( computeQueue, COMPUTE_QUEUE_NAME, computeFence, ++computeFenceValue );
+
+		//the copy queue waits on the gpu, the cpu only ever waits for a slot it needs back
+		if( !UseResidentHeap( dwComputeOutputHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) ||
+			!UseResidentHeap( dwReadbackHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) )
+		{
+			ReadbackArenaSubmit( &readbackArena, streamingFenceValue );
+			return false;
+		}
+		qwTraceStart = TraceBegin();
+		pSlot->streamingCommandAllocator->Reset();
+	    streamingCommandList->Reset( pSlot->streamingCommandAllocator, NULL );
+		TrackResourceState( &streamingStateTracker, &pSlot->computeOutputState, TRACKED_STATE_COPY_SOURCE );
+		TrackResourceState( &streamingStateTracker, &readbackArenaState, TRACKED_STATE_COPY_DEST );
+		FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+		streamingCommandList->CopyBufferRegion( readbackArenaBuffer, span.qwOffset + dwDispatch * sizeof(ModelOutData), pSlot->computeOutputBuffer, 0, sizeof(ModelOutData) );
+		//readback buffers can be mapped in any state, the decay to COMMON needs no barrier either
+		ResourceStateTrackerClose( &streamingStateTracker );
+		streamingCommandList->Close();
+		TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record readback copy", STREAMING_QUEUE_NAME, 1 );
+		QueueWaitTraced( streamingQueue, STREAMING_QUEUE_NAME, computeFence, computeFenceValue );
+		ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	    SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	    pSlot->qwReadbackFenceValue = streamingFenceValue;
+	}
+	ReadbackArenaSubmit( &readbackArena, streamingFenceValue );
+	ResidencyTrim( &residencyManager ); //follows a budget the os lowered since the last batch
+	pResults->pResults = (const ModelOutData*)span.pData;
+	pResults->dwCount = dwDispatchCount;
+	pResults->qwFenceValue = streamingFenceValue;
+	return true;
+}
+
+//PFN_SubmissionBatchRecord for the compute queue, every job is a Dispatch in one list, jobs bind TrackedResource*s
+//so consecutive jobs writing the same output get the UAV barrier between them
+inline
+u64 RecordComputeBatch( void *pContext, const SubmissionJob *pJobs, u32 dwJobCount )
+{
+	ComputeBatchRecorder *pRecorder = (ComputeBatchRecorder*)pContext;
+	ID3D12CommandAllocator *pAllocator = (ID3D12CommandAllocator*)CommandAllocatorPoolAcquire( &pRecorder->allocatorPool, computeFence->GetCompletedValue() );
+	while( !pAllocator )
+	{
+		WaitForFenceValue( computeFence, computeFenceEvent, CommandAllocatorPoolOldestFenceValue( &pRecorder->allocatorPool ), COMPUTE_QUEUE_NAME );
+		pAllocator = (ID3D12CommandAllocator*)CommandAllocatorPoolAcquire( &pRecorder->allocatorPool, computeFence->GetCompletedValue() );
+	}
+	const u64 qwTraceStart = TraceBegin();
+	pAllocator->Reset();
+	computeCommandList->Reset( pAllocator, computePipelineStateObject );
+	computeCommandList->SetComputeRootSignature( computeRootSignature );
+	for( u32 dwJob = 0; dwJob < dwJobCount; ++dwJob )
+	{
+		TrackedResource *pSrv = (TrackedResource*)pJobs[dwJob].pSrv;
+		TrackedResource *pUav = (TrackedResource*)pJobs[dwJob].pUav;
+		computeCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),&pJobs[dwJob].constants,0);
+		computeCommandList->SetComputeRootShaderResourceView(1,((ID3D12Resource*)pSrv->pResource)->GetGPUVirtualAddress());
+		computeCommandList->SetComputeRootUnorderedAccessView(2,((ID3D12Resource*)pUav->pResource)->GetGPUVirtualAddress());
+		TrackResourceState( &computeStateTracker, pSrv, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+		TrackResourceState( &computeStateTracker, pUav, TRACKED_STATE_UNORDERED_ACCESS );
+		FlushTrackedBarriers( computeCommandList, &computeStateTracker );
+		computeCommandList->Dispatch( pJobs[dwJob].dwGroupCount, 1, 1 );
+	}
+	ResourceStateTrackerClose( &computeStateTracker );
+	computeCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record batch", COMPUTE_QUEUE_NAME, dwJobCount );
+	ID3D12CommandList* ppComputeCommandLists[] = { computeCommandList };
+	ExecuteCommandListsTraced( computeQueue, COMPUTE_QUEUE_NAME, _countof( ppComputeCommandLists ), ppComputeCommandLists );
+	SignalTraced( computeQueue, COMPUTE_QUEUE_NAME, computeFence, ++computeFenceValue );
+	CommandAllocatorPoolRelease( &pRecorder->allocatorPool, pAllocator, computeFenceValue );
+	return computeFenceValue;
+}
+
+//PFN_CreateCommandAllocator
+void *CreateComputeCommandAllocator( void *pContext )
+{
+	ID3D12CommandAllocator *pAllocator;
+	if( FAILED( device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &pAllocator ) ) ) )
+	{
+		return NULL;
+	}
+	return pAllocator;
+}
+
+//PFN_RecordCommandRange, runs on the recorder's threads, only touches the list and tracker of dwWorker
+//the TrackedResource states are only read here, ComputeParallelSubmit() writes them back after the join
+void RecordComputeRange( void *pContext, u32 dwWorker, void *pAllocator, u32 dwBegin, u32 dwEnd )
+{
+	ComputeParallelRecorder *pParallel = (ComputeParallelRecorder*)pContext;
+	ID3D12GraphicsCommandList *pCommandList = pParallel->commandLists[dwWorker];
+	ResourceStateTracker *pTracker = &pParallel->stateTrackers[dwWorker];
+	const u64 qwTraceStart = TraceBegin();
+	( (ID3D12CommandAllocator*)pAllocator )->Reset();
+	pCommandList->Reset( (ID3D12CommandAllocator*)pAllocator, computePipelineStateObject );
+	pCommandList->SetComputeRootSignature( computeRootSignature );
+	pCommandList->SetComputeRootShaderResourceView(1,defaultBuffer->GetGPUVirtualAddress());
+	for( u32 dwDispatch = dwBegin; dwDispatch < dwEnd; ++dwDispatch )
+	{
+		ComputeSlot *pSlot = &computeSlots[dwDispatch % NUM_INFLIGHT_COMPUTE];
+		pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),&pParallel->pCBs[dwDispatch],0);
+		pCommandList->SetComputeRootUnorderedAccessView(2,pSlot->computeOutputBuffer->GetGPUVirtualAddress());
+		TrackResourceState( pTracker, &modelBufferState, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+		TrackResourceState( pTracker, &pSlot->computeOutputState, TRACKED_STATE_UNORDERED_ACCESS );
+		FlushTrackedBarriers( pCommandList, pTracker );
+		pCommandList->Dispatch(1,1,1);
+	}
+	pCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record range", COMPUTE_QUEUE_NAME, dwEnd - dwBegin );
+}
+
+//PFN_CompletedFenceValue
+u64 CompletedComputeFenceValue( void *pContext )
+{
+	return computeFence->GetCompletedValue();
+}
+
+//PFN_WaitForFenceValue, several workers can wait at once so no shared event, a NULL event blocks until the value is reached
+void WaitForComputeFenceValue( void *pContext, u64 qwValue )
+{
+	const u64 qwTraceStart = TraceBegin();
+	computeFence->SetEventOnCompletion( qwValue, NULL );
+	TraceEnd( qwTraceStart, TRACE_KIND_HOST_WAIT, "WaitForComputeFenceValue", COMPUTE_QUEUE_NAME, qwValue );
+}
+
+//joins the workers and releases the pooled allocators and the first dwListCount lists, nothing may still use them
+inline
+void ReleaseComputeParallelRecorder( ComputeParallelRecorder *pParallel, u32 dwListCount )
+{
+	DestroyParallelRecorder( &pParallel->recorder );
+	for( u32 dwWorker = 0; dwWorker < pParallel->recorder.dwNumWorkers; ++dwWorker )
+	{
+		void *allocators[COMMAND_ALLOCATOR_POOL_CAPACITY];
+		const u32 dwAllocatorCount = CommandAllocatorPoolTakeAll( &pParallel->recorder.pools[dwWorker], allocators );
+		for( u32 dwAllocator = 0; dwAllocator < dwAllocatorCount; ++dwAllocator )
+		{
+			( (ID3D12CommandAllocator*)allocators[dwAllocator] )->Release();
+		}
+		if( dwWorker < dwListCount )
+		{
+			pParallel->commandLists[dwWorker]->Release();
+		}
+	}
+	delete pParallel;
+}
+
+inline
+ComputeParallelRecorder *CreateComputeParallelRecorder( u32 dwNumWorkers, u32 dwGPUNumber )
+{
+	ComputeParallelRecorder *pParallel = new ComputeParallelRecorder;
+	InitParallelRecorder( &pParallel->recorder, dwNumWorkers, COMPUTE_RECORD_ALLOCATORS, CreateComputeCommandAllocator,
+						  RecordComputeRange, CompletedComputeFenceValue, WaitForComputeFenceValue, pParallel );
+	for( u32 dwWorker = 0; dwWorker < pParallel->recorder.dwNumWorkers; ++dwWorker )
+	{
+		//a list needs an allocator to be created, borrow one from the worker's pool and hand it back as already completed
+		CommandAllocatorPool *pPool = &pParallel->recorder.pools[dwWorker];
+		ID3D12CommandAllocator *pAllocator = (ID3D12CommandAllocator*)CommandAllocatorPoolAcquire( pPool, 0 );
+		if( !pAllocator || FAILED( device->CreateCommandList( dwGPUNumber, D3D12_COMMAND_LIST_TYPE_COMPUTE, pAllocator, computePipelineStateObject, IID_PPV_ARGS( &pParallel->commandLists[dwWorker] ) ) ) )
+		{
+			logError( "Failed to create parallel compute command list!\n" );
+			if( pAllocator )
+			{
+				CommandAllocatorPoolRelease( pPool, pAllocator, 0 );
+			}
+			ReleaseComputeParallelRecorder( pParallel, dwWorker );
+			return NULL;
+		}
+		pParallel->commandLists[dwWorker]->Close();
+		CommandAllocatorPoolRelease( pPool, pAllocator, 0 );
+		InitResourceStateTracker( &pParallel->stateTrackers[dwWorker] );
+	}
+	return pParallel;
+}
+
+inline
+void DestroyComputeParallelRecorder( ComputeParallelRecorder *pParallel )
+{
+	WaitForFenceValue( computeFence, computeFenceEvent, computeFenceValue, COMPUTE_QUEUE_NAME );
+	ReleaseComputeParallelRecorder( pParallel, pParallel->recorder.dwNumWorkers );
+}
+
+//one Dispatch per cb without readback, recorded in parallel and submitted in order, returns the fence value signaled after them
+inline
+u64 ComputeParallelSubmit( ComputeParallelRecorder *pParallel, const ComputeShaderCB *pCBs, u32 dwDispatchCount )
+{
+	pParallel->pCBs = pCBs;
+	ParallelRecord( &pParallel->recorder, dwDispatchCount, computeFenceValue + 1 );
+	for( u32 dwWorker = 0; dwWorker < pParallel->recorder.dwNumWorkers; ++dwWorker )
+	{
+		ResourceStateTrackerClose( &pParallel->stateTrackers[dwWorker] );
+	}
+	ExecuteCommandListsTraced( computeQueue, COMPUTE_QUEUE_NAME, pParallel->recorder.dwNumWorkers, (ID3D12CommandList* const*)pParallel->commandLists );
+	SignalTraced( computeQueue, COMPUTE_QUEUE_NAME, computeFence, ++computeFenceValue );
+	return computeFenceValue;
+}
+
+inline
+ID3D12PipelineState *CreateComputePipeline( u32 dwGPUNumber, ID3D12RootSignature *pRootSignature, const void *pBytecode, u64 qwBytecodeSize )
+{
+	D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc;
+	pipelineStateDesc.pRootSignature = pRootSignature;
+	pipelineStateDesc.CS.pShaderBytecode = pBytecode;
+	pipelineStateDesc.CS.BytecodeLength = qwBytecodeSize;
+	pipelineStateDesc.NodeMask = dwGPUNumber;
+	pipelineStateDesc.CachedPSO.pCachedBlob = NULL;
+	pipelineStateDesc.CachedPSO.CachedBlobSizeInBytes = 0;
+	pipelineStateDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ID3D12PipelineState *pPipelineState;
+	if( FAILED( device->CreateComputePipelineState( &pipelineStateDesc, IID_PPV_ARGS( &pPipelineState ) ) ) )
+	{
+		return NULL;
+	}
+	return pPipelineState;
+}
+
+inline
+bool InitScanPipelines( u32 dwGPUNumber )
+{
+	if( FAILED( device->CreateRootSignature( dwGPUNumber, scanReduceBlocksBlob, sizeof(scanReduceBlocksBlob), IID_PPV_ARGS( &scanRootSignature ) ) ) )
+	{
+		logError( "Failed to create scan root signature!\n" );
+		return false;
+	}
+	scanReduceBlocksPSO = CreateComputePipeline( dwGPUNumber, scanRootSignature, scanReduceBlocksBlob, sizeof(scanReduceBlocksBlob) );
+	scanBlockPartialsPSO = CreateComputePipeline( dwGPUNumber, scanRootSignature, scanBlockPartialsBlob, sizeof(scanBlockPartialsBlob) );
+	scanDownsweepPSO = CreateComputePipeline( dwGPUNumber, scanRootSignature, scanDownsweepBlob, sizeof(scanDownsweepBlob) );
+	return scanReduceBlocksPSO && scanBlockPartialsPSO && scanDownsweepPSO;
+}
+
+//device wide scan (bReduceOnly: reduce) of the u32s in pInput, pCB comes from MakeScanCB() and is what CpuScan() takes too
+//pPartials needs ScanScratchSize() bytes, the total ends up in its last 8 bytes
+inline
+void RecordScan( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const ComputeShaderCB *pCB,
+				 TrackedResource *pInput, TrackedResource *pOutput, TrackedResource *pPartials, bool bReduceOnly )
+{
+	assert( pCB->dwOffsetsAndStrides0[1] <= SCAN_MAX_COUNT );
+	const u32 dwBlockCount = ScanBlockCount( pCB->dwOffsetsAndStrides0[1] );
+	pCommandList->SetComputeRootSignature( scanRootSignature );
+	pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),pCB,0);
+	pCommandList->SetComputeRootShaderResourceView(1,((ID3D12Resource*)pInput->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(2,((ID3D12Resource*)pOutput->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(3,((ID3D12Resource*)pPartials->pResource)->GetGPUVirtualAddress());
+
+	TrackResourceState( pTracker, pInput, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pPartials, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( scanReduceBlocksPSO );
+	pCommandList->Dispatch( dwBlockCount, 1, 1 );
+
+	TrackResourceState( pTracker, pPartials, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( scanBlockPartialsPSO );
+	pCommandList->Dispatch( 1, 1, 1 );
+	if( bReduceOnly || dwBlockCount == 0 )
+	{
+		return;
+	}
+
+	TrackResourceState( pTracker, pPartials, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pOutput, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( scanDownsweepPSO );
+	pCommandList->Dispatch( dwBlockCount, 1, 1 );
+}
+
+inline
+bool InitRadixSortPipelines( u32 dwGPUNumber )
+{
+	if( FAILED( device->CreateRootSignature( dwGPUNumber, radixUpsweepBlob, sizeof(radixUpsweepBlob), IID_PPV_ARGS( &radixSortRootSignature ) ) ) )
+	{
+		logError( "Failed to create radix sort root signature!\n" );
+		return false;
+	}
+	radixUpsweepPSO = CreateComputePipeline( dwGPUNumber, radixSortRootSignature, radixUpsweepBlob, sizeof(radixUpsweepBlob) );
+	radixScatterPSO = CreateComputePipeline( dwGPUNumber, radixSortRootSignature, radixScatterBlob, sizeof(radixScatterBlob) );
+	return radixUpsweepPSO && radixScatterPSO;
+}
+
+//buffers of RecordRadixSort(), pPayload/pPayloadAlt are NULL without payloads
+typedef struct RadixSortResources
+{
+	TrackedResource *pKeys;
+	TrackedResource *pPayload;
+	TrackedResource *pKeysAlt;          //ping pong, sized like pKeys/pPayload
+	TrackedResource *pPayloadAlt;
+	TrackedResource *pBlockHistograms;  //RadixHistogramCount( count, RADIX_BLOCK_SIZE ) u32s
+	TrackedResource *pDigitOffsets;     //as many u32s
+	TrackedResource *pScanPartials;     //RadixScanScratchSize( count, RADIX_BLOCK_SIZE ) bytes
+} RadixSortResources;
+
+inline
+void SetRadixSortRootArgs( ID3D12GraphicsCommandList *pCommandList, const ComputeShaderCB *pCB, const RadixSortResources *pResources,
+						   TrackedResource *pKeysIn, TrackedResource *pPayloadIn, TrackedResource *pKeysOut, TrackedResource *pPayloadOut )
+{
+	pCommandList->SetComputeRootSignature( radixSortRootSignature );
+	pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),pCB,0);
+	pCommandList->SetComputeRootShaderResourceView(1,((ID3D12Resource*)pResources->pDigitOffsets->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(2,((ID3D12Resource*)pKeysIn->pResource)->GetGPUVirtualAddress());
+	//without payloads the slots are never read, the keys stand in so nothing is left unbound
+	pCommandList->SetComputeRootUnorderedAccessView(3,((ID3D12Resource*)( pPayloadIn ? pPayloadIn : pKeysIn )->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(4,((ID3D12Resource*)pKeysOut->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(5,((ID3D12Resource*)( pPayloadOut ? pPayloadOut : pKeysOut )->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(6,((ID3D12Resource*)pResources->pBlockHistograms->pResource)->GetGPUVirtualAddress());
+}
+
+//sorts keys [dwFirst, dwFirst + dwCount) of pKeys (and their payloads), an even number of passes leaves the result in pKeys
+//same passes as CpuRadixSort()
+inline
+void RecordRadixSort( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const RadixSortResources *pResources,
+					  u32 dwFirst, u32 dwCount, bool bKey64 )
+{
+	const u32 dwBlockCount = RadixHistogramCount( dwCount, RADIX_BLOCK_SIZE ) / RADIX_DIGITS;
+	const u32 dwFlags = ( bKey64 ? RADIX_FLAG_KEY64 : 0 ) | ( pResources->pPayload ? RADIX_FLAG_PAYLOAD : 0 );
+	const ComputeShaderCB scanCB = MakeScanCB( 0, dwBlockCount * RADIX_DIGITS, SCAN_NO_SEGMENTS, 0 );
+	TrackedResource *pKeysIn = pResources->pKeys;
+	TrackedResource *pPayloadIn = pResources->pPayload;
+	TrackedResource *pKeysOut = pResources->pKeysAlt;
+	TrackedResource *pPayloadOut = pResources->pPayloadAlt;
+	if( dwBlockCount == 0 )
+	{
+		return;
+	}
+	for( u32 dwShift = 0; dwShift < ( bKey64 ? 64u : 32u ); dwShift += 8 )
+	{
+		const ComputeShaderCB cb = MakeRadixSortCB( dwFirst, dwCount, dwShift, dwFlags );
+		SetRadixSortRootArgs( pCommandList, &cb, pResources, pKeysIn, pPayloadIn, pKeysOut, pPayloadOut );
+		TrackResourceState( pTracker, pKeysIn, TRACKED_STATE_UNORDERED_ACCESS );
+		TrackResourceState( pTracker, pResources->pBlockHistograms, TRACKED_STATE_UNORDERED_ACCESS );
+		FlushTrackedBarriers( pCommandList, pTracker );
+		pCommandList->SetPipelineState( radixUpsweepPSO );
+		pCommandList->Dispatch( dwBlockCount, 1, 1 );
+
+		RecordScan( pCommandList, pTracker, &scanCB, pResources->pBlockHistograms, pResources->pDigitOffsets, pResources->pScanPartials, false );
+
+		//the scan changed the root signature, which drops every root argument
+		SetRadixSortRootArgs( pCommandList, &cb, pResources, pKeysIn, pPayloadIn, pKeysOut, pPayloadOut );
+		TrackResourceState( pTracker, pResources->pDigitOffsets, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+		TrackResourceState( pTracker, pKeysOut, TRACKED_STATE_UNORDERED_ACCESS );
+		if( pPayloadIn )
+		{
+			TrackResourceState( pTracker, pPayloadIn, TRACKED_STATE_UNORDERED_ACCESS );
+			TrackResourceState( pTracker, pPayloadOut, TRACKED_STATE_UNORDERED_ACCESS );
+		}
+		FlushTrackedBarriers( pCommandList, pTracker );
+		pCommandList->SetPipelineState( radixScatterPSO );
+		pCommandList->Dispatch( dwBlockCount, 1, 1 );
+
+		TrackedResource *pSwap = pKeysIn;
+		pKeysIn = pKeysOut;
+		pKeysOut = pSwap;
+		pSwap = pPayloadIn;
+		pPayloadIn = pPayloadOut;
+		pPayloadOut = pSwap;
+	}
+}
+
+inline
+bool InitCullingPipelines( u32 dwGPUNumber )
+{
+	if( FAILED( device->CreateRootSignature( dwGPUNumber, cullInstancesBlob, sizeof(cullInstancesBlob), IID_PPV_ARGS( &cullRootSignature ) ) ) )
+	{
+		logError( "Failed to create culling root signature!\n" );
+		return false;
+	}
+	cullInstancesPSO = CreateComputePipeline( dwGPUNumber, cullRootSignature, cullInstancesBlob, sizeof(cullInstancesBlob) );
+	cullCompactPSO = CreateComputePipeline( dwGPUNumber, cullRootSignature, cullCompactBlob, sizeof(cullCompactBlob) );
+	cullGatherVisiblePSO = CreateComputePipeline( dwGPUNumber, cullRootSignature, cullGatherVisibleBlob, sizeof(cullGatherVisibleBlob) );
+
+	//only dispatch arguments, so no root signature
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDesc;
+	argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc;
+	commandSignatureDesc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+	commandSignatureDesc.NumArgumentDescs = 1;
+	commandSignatureDesc.pArgumentDescs = &argumentDesc;
+	commandSignatureDesc.NodeMask = dwGPUNumber;
+	if( FAILED( device->CreateCommandSignature( &commandSignatureDesc, NULL, IID_PPV_ARGS( &cullDispatchCommandSignature ) ) ) )
+	{
+		logError( "Failed to create culling command signature!\n" );
+		return false;
+	}
+	return cullInstancesPSO && cullCompactPSO && cullGatherVisiblePSO;
+}
+
+//buffers of RecordCullInstances()
+typedef struct CullResources
+{
+	TrackedResource *pBounds;           //CULL_SHAPE_* per instance
+	TrackedResource *pVisibleFlags;     //a u32 per instance
+	TrackedResource *pVisibleOffsets;   //a u32 per instance
+	TrackedResource *pScanPartials;     //ScanScratchSize( count ) bytes
+	TrackedResource *pVisibleInstances; //CullListSize( count ) bytes
+} CullResources;
+
+inline
+void SetCullRootArgs( ID3D12GraphicsCommandList *pCommandList, const ComputeShaderCB *pCB, D3D12_GPU_VIRTUAL_ADDRESS planesAddress, const CullResources *pResources )
+{
+	pCommandList->SetComputeRootSignature( cullRootSignature );
+	pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),pCB,0);
+	pCommandList->SetComputeRootConstantBufferView(1,planesAddress);
+	pCommandList->SetComputeRootShaderResourceView(2,((ID3D12Resource*)pResources->pBounds->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootShaderResourceView(3,((ID3D12Resource*)pResources->pVisibleOffsets->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(4,((ID3D12Resource*)pResources->pVisibleFlags->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(5,((ID3D12Resource*)pResources->pVisibleInstances->pResource)->GetGPUVirtualAddress());
+}
+
+//culls instances [dwFirst, dwFirst + dwCount) of pBounds against the 6 ExtractFrustumPlanesMat4f() planes at planesAddress (256 byte aligned)
+//same result as CpuCullInstances(), pVisibleInstances is left in TRACKED_STATE_UNORDERED_ACCESS, see RecordDispatchVisibleInstances()
+inline
+void RecordCullInstances( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const CullResources *pResources,
+						  D3D12_GPU_VIRTUAL_ADDRESS planesAddress, u32 dwFirst, u32 dwCount, u32 dwShape )
+{
+	assert( dwCount <= CULL_MAX_COUNT );
+	const ComputeShaderCB cb = MakeCullCB( dwFirst, dwCount, dwShape, 0 );
+	const u32 dwGroupCount = ( dwCount + CULL_THREADS - 1 ) / CULL_THREADS;
+	if( dwGroupCount > 0 )
+	{
+		SetCullRootArgs( pCommandList, &cb, planesAddress, pResources );
+		TrackResourceState( pTracker, pResources->pBounds, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+		TrackResourceState( pTracker, pResources->pVisibleFlags, TRACKED_STATE_UNORDERED_ACCESS );
+		FlushTrackedBarriers( pCommandList, pTracker );
+		pCommandList->SetPipelineState( cullInstancesPSO );
+		pCommandList->Dispatch( dwGroupCount, 1, 1 );
+
+		const ComputeShaderCB scanCB = MakeScanCB( 0, dwCount, SCAN_NO_SEGMENTS, 0 );
+		RecordScan( pCommandList, pTracker, &scanCB, pResources->pVisibleFlags, pResources->pVisibleOffsets, pResources->pScanPartials, false );
+	}
+
+	//the scan changed the root signature, at least one group so an empty list still gets its header
+	SetCullRootArgs( pCommandList, &cb, planesAddress, pResources );
+	TrackResourceState( pTracker, pResources->pVisibleOffsets, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pResources->pVisibleFlags, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pVisibleInstances, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( cullCompactPSO );
+	pCommandList->Dispatch( dwGroupCount > 0 ? dwGroupCount : 1, 1, 1 );
+}
+
+//one thread group per CULL_INDIRECT_GROUP_SIZE visible instances of a RecordCullInstances() list, the pso and root arguments have to be set already
+inline
+void RecordDispatchVisibleInstances( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, TrackedResource *pVisibleInstances )
+{
+	TrackResourceState( pTracker, pVisibleInstances, TRACKED_STATE_INDIRECT_ARGUMENT | TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->ExecuteIndirect( cullDispatchCommandSignature, 1, (ID3D12Resource*)pVisibleInstances->pResource, offsetof( CullListHeader, dwThreadGroupCount ), NULL, 0 );
+}
+
+inline
+bool InitBvhPipelines( u32 dwGPUNumber )
+{
+	if( FAILED( device->CreateRootSignature( dwGPUNumber, bvhCentroidBoundsBlob, sizeof(bvhCentroidBoundsBlob), IID_PPV_ARGS( &bvhRootSignature ) ) ) )
+	{
+		logError( "Failed to create bvh root signature!\n" );
+		return false;
+	}
+	bvhCentroidBoundsPSO = CreateComputePipeline( dwGPUNumber, bvhRootSignature, bvhCentroidBoundsBlob, sizeof(bvhCentroidBoundsBlob) );
+	bvhMortonCodesPSO = CreateComputePipeline( dwGPUNumber, bvhRootSignature, bvhMortonCodesBlob, sizeof(bvhMortonCodesBlob) );
+	bvhEmitHierarchyPSO = CreateComputePipeline( dwGPUNumber, bvhRootSignature, bvhEmitHierarchyBlob, sizeof(bvhEmitHierarchyBlob) );
+	bvhRefitPSO = CreateComputePipeline( dwGPUNumber, bvhRootSignature, bvhRefitBlob, sizeof(bvhRefitBlob) );
+	return bvhCentroidBoundsPSO && bvhMortonCodesPSO && bvhEmitHierarchyPSO && bvhRefitPSO;
+}
+
+//buffers of RecordBuildBvh(), sort.pKeys are the morton codes and sort.pPayload the triangle indices
+typedef struct BvhResources
+{
+	TrackedResource *pMesh;    //verticesAndIndices, defaultBuffer for the built in meshes
+	TrackedResource *pNodes;   //BvhNodeCount() * sizeof(BvhNode) bytes
+	TrackedResource *pParents; //BvhNodeCount() u32s
+	TrackedResource *pScratch; //BvhScratchSize( count, BVH_BLOCK_SIZE ) bytes
+	RadixSortResources sort;   //for the triangle count with RADIX_BLOCK_SIZE
+} BvhResources;
+
+inline
+void SetBvhRootArgs( ID3D12GraphicsCommandList *pCommandList, const ComputeShaderCB *pCB, const BvhResources *pResources )
+{
+	pCommandList->SetComputeRootSignature( bvhRootSignature );
+	pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),pCB,0);
+	pCommandList->SetComputeRootShaderResourceView(1,((ID3D12Resource*)pResources->pMesh->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(2,((ID3D12Resource*)pResources->pNodes->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(3,((ID3D12Resource*)pResources->pParents->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(4,((ID3D12Resource*)pResources->sort.pKeys->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(5,((ID3D12Resource*)pResources->sort.pPayload->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(6,((ID3D12Resource*)pResources->pScratch->pResource)->GetGPUVirtualAddress());
+}
+
+//the refit half of a build, on its own it updates the boxes after the vertices moved
+inline
+void RecordRefitBvh( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const BvhResources *pResources, const ComputeShaderCB *pCB )
+{
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	if( dwCount == 0 )
+	{
+		return;
+	}
+	SetBvhRootArgs( pCommandList, pCB, pResources );
+	TrackResourceState( pTracker, pResources->pMesh, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pResources->pNodes, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pParents, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pScratch, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( bvhRefitPSO );
+	pCommandList->Dispatch( ( dwCount + BVH_THREADS - 1 ) / BVH_THREADS, 1, 1 );
+}
+
+//same passes as CpuBuildBvh(), pCB comes from MakeBvhCB()
+//with the buffers placed by a DeclareRayQueryTransients() plan, pTransients are its resources and the aliasing barriers go in before every pass
+inline
+void RecordBuildBvh( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const BvhResources *pResources, const ComputeShaderCB *pCB,
+					 const TransientPlan *pPlan = NULL, TrackedResource *pTransients = NULL )
+{
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	const u32 dwGroupCount = ( dwCount + BVH_THREADS - 1 ) / BVH_THREADS;
+	assert( dwCount <= BVH_MAX_TRIANGLES );
+	if( dwCount == 0 )
+	{
+		return;
+	}
+	SetBvhRootArgs( pCommandList, pCB, pResources );
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_CENTROID_BOUNDS, pTransients );
+	TrackResourceState( pTracker, pResources->pMesh, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pResources->pScratch, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( bvhCentroidBoundsPSO );
+	pCommandList->Dispatch( ( dwCount + BVH_BLOCK_SIZE - 1 ) / BVH_BLOCK_SIZE, 1, 1 );
+
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_MORTON_CODES, pTransients );
+	TrackResourceState( pTracker, pResources->pScratch, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->sort.pKeys, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->sort.pPayload, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( bvhMortonCodesPSO );
+	pCommandList->Dispatch( dwGroupCount, 1, 1 );
+
+	//4 passes, an even number so the sorted codes end up back in sort.pKeys
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_SORT, pTransients );
+	RecordRadixSort( pCommandList, pTracker, &pResources->sort, 0, dwCount, false );
+
+	//the sort changed the root signature
+	SetBvhRootArgs( pCommandList, pCB, pResources );
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_EMIT_HIERARCHY, pTransients );
+	TrackResourceState( pTracker, pResources->sort.pKeys, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->sort.pPayload, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pNodes, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pParents, TRACKED_STATE_UNORDERED_ACCESS );
+	TrackResourceState( pTracker, pResources->pScratch, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetPipelineState( bvhEmitHierarchyPSO );
+	pCommandList->Dispatch( dwGroupCount, 1, 1 );
+
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_REFIT, pTransients );
+	RecordRefitBvh( pCommandList, pTracker, pResources, pCB );
+}
+
+inline
+bool InitRayQueryPipelines( u32 dwGPUNumber )
+{
+	if( FAILED( device->CreateRootSignature( dwGPUNumber, rayQueryClosestHitBlob, sizeof(rayQueryClosestHitBlob), IID_PPV_ARGS( &rayQueryRootSignature ) ) ) )
+	{
+		logError( "Failed to create ray query root signature!\n" );
+		return false;
+	}
+	rayQueryClosestHitPSO = CreateComputePipeline( dwGPUNumber, rayQueryRootSignature, rayQueryClosestHitBlob, sizeof(rayQueryClosestHitBlob) );
+	return rayQueryClosestHitPSO != NULL;
+}
+
+//closest hits of pRays (BvhRay) into pHits (BvhHit) against a bvh RecordBuildBvh() built over pBvh->pMesh, same dispatch as CpuRayQueryClosestHit()
+//pCB comes from MakeRayQueryCB() with the vertex and index offsets of the build, pPlan/pTransients like RecordBuildBvh()
+inline
+void RecordRayQueryClosestHit( ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const ComputeShaderCB *pCB, const BvhResources *pBvh,
+							   TrackedResource *pRays, TrackedResource *pHits, const TransientPlan *pPlan = NULL, TrackedResource *pTransients = NULL )
+{
+	const u32 dwCount = pCB->dwOffsetsAndStrides0[2];
+	if( dwCount == 0 )
+	{
+		return;
+	}
+	TrackTransientAliases( pTracker, pPlan, RAY_QUERY_PASS_CLOSEST_HIT, pTransients );
+	TrackResourceState( pTracker, pBvh->pMesh, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pBvh->pNodes, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pBvh->pParents, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pRays, TRACKED_STATE_NON_PIXEL_SHADER_RESOURCE );
+	TrackResourceState( pTracker, pHits, TRACKED_STATE_UNORDERED_ACCESS );
+	FlushTrackedBarriers( pCommandList, pTracker );
+	pCommandList->SetComputeRootSignature( rayQueryRootSignature );
+	pCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),pCB,0);
+	pCommandList->SetComputeRootShaderResourceView(1,((ID3D12Resource*)pBvh->pMesh->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootShaderResourceView(2,((ID3D12Resource*)pBvh->pNodes->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootShaderResourceView(3,((ID3D12Resource*)pBvh->pParents->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootShaderResourceView(4,((ID3D12Resource*)pRays->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(5,((ID3D12Resource*)pHits->pResource)->GetGPUVirtualAddress());
+	pCommandList->SetPipelineState( rayQueryClosestHitPSO );
+	pCommandList->Dispatch( ( dwCount + RAY_QUERY_THREADS - 1 ) / RAY_QUERY_THREADS, 1, 1 );
+}
+
+//a default heap of the plan's size with a placed UAV buffer per resource at its offset
+inline
+bool CreateTransientBuffers( const TransientPlan *pPlan, u32 dwGPUNumber, u32 dwVisibleGPUMask, ID3D12Heap **ppHeap, ID3D12Resource **ppBuffers, TrackedResource *pStates )
+{
+	D3D12_HEAP_DESC transientHeapDesc;
+	transientHeapDesc.SizeInBytes = AlignUp( pPlan->qwHeapSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT );
+	transientHeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+	transientHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	transientHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	transientHeapDesc.Properties.CreationNodeMask = dwGPUNumber;
+	transientHeapDesc.Properties.VisibleNodeMask = dwVisibleGPUMask;
+	transientHeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	transientHeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS | D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
+	if( FAILED( device->CreateHeap( &transientHeapDesc, IID_PPV_ARGS( ppHeap ) ) ) )
+	{
+		return false;
+	}
+	for( u32 dwResource = 0; dwResource < pPlan->dwResourceCount; ++dwResource )
+	{
+		const TransientResource *pResource = &pPlan->resources[dwResource];
+		D3D12_RESOURCE_DESC transientDesc;
+		transientDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		transientDesc.Alignment = 0;
+		transientDesc.Width = pResource->qwSize > 0 ? pResource->qwSize : 4;
+		transientDesc.Height = 1;
+		transientDesc.DepthOrArraySize = 1;
+		transientDesc.MipLevels = 1;
+		transientDesc.Format = DXGI_FORMAT_UNKNOWN;
+		transientDesc.SampleDesc.Count = 1;
+		transientDesc.SampleDesc.Quality = 0;
+		transientDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		transientDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		if( FAILED( device->CreatePlacedResource( *ppHeap, pResource->qwOffset, &transientDesc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS( &ppBuffers[dwResource] ) ) ) )
+		{
+			return false;
+		}
+		InitTrackedResource( &pStates[dwResource], ppBuffers[dwResource], TRACKED_STATE_COMMON, true );
+	}
+	return true;
+}
+
+//whatever CreateTransientBuffers() got to before it returned
+inline
+void ReleaseRayQueryTransients()
+{
+	for( u32 dwResource = 0; dwResource < rayQueryPlan.dwResourceCount; ++dwResource )
+	{
+		if( rayQueryBuffers[dwResource] )
+		{
+			rayQueryBuffers[dwResource]->Release();
+			rayQueryBuffers[dwResource] = NULL;
+		}
+	}
+	if( pRayQueryHeap )
+	{
+		pRayQueryHeap->Release();
+		pRayQueryHeap = NULL;
+	}
+}
+
+//places the buffers of a build over dwTriangleCount triangles of pMesh followed by a query of dwRayCount rays, fills pBvh and the rays/hits
+inline
+bool InitRayQueryGraph( u32 dwTriangleCount, u32 dwRayCount, u32 dwGPUNumber, u32 dwVisibleGPUMask, TrackedResource *pMesh, BvhResources *pBvh,
+						TrackedResource **ppRays, TrackedResource **ppHits )
+{
+	InitTransientPlan( &rayQueryPlan );
+	DeclareRayQueryTransients( &rayQueryPlan, dwTriangleCount, dwRayCount, RADIX_BLOCK_SIZE, BVH_BLOCK_SIZE, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+							   &rayQueryTransients );
+	TransientPlanBuild( &rayQueryPlan );
+	if( !CreateTransientBuffers( &rayQueryPlan, dwGPUNumber, dwVisibleGPUMask, &pRayQueryHeap, rayQueryBuffers, rayQueryBufferStates ) )
+	{
+		logError( "Failed to create the ray query transients!\n" );
+		ReleaseRayQueryTransients();
+		return false;
+	}
+#if MAIN_DEBUG
+	pRayQueryHeap->SetName( L"Ray Query Transient Heap" );
+	printf( "Ray query transients: %llu KB aliased, %llu KB without aliasing, %u aliasing barriers\n", rayQueryPlan.qwHeapSize >> 10,
+			rayQueryPlan.qwUnaliasedSize >> 10, rayQueryPlan.dwAliasCount );
+#endif
+	dwRayQueryHeapResidency = ResidencyTrackHeap( &residencyManager, pRayQueryHeap, AlignUp( rayQueryPlan.qwHeapSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT ),
+												  RESIDENCY_SEGMENT_LOCAL, "Ray Query Transient Heap", false );
+	pBvh->pMesh = pMesh;
+	pBvh->pNodes = &rayQueryBufferStates[rayQueryTransients.dwNodes];
+	pBvh->pParents = &rayQueryBufferStates[rayQueryTransients.dwParents];
+	pBvh->pScratch = &rayQueryBufferStates[rayQueryTransients.dwScratch];
+	pBvh->sort.pKeys = &rayQueryBufferStates[rayQueryTransients.dwKeys];
+	pBvh->sort.pPayload = &rayQueryBufferStates[rayQueryTransients.dwPayload];
+	pBvh->sort.pKeysAlt = &rayQueryBufferStates[rayQueryTransients.dwKeysAlt];
+	pBvh->sort.pPayloadAlt = &rayQueryBufferStates[rayQueryTransients.dwPayloadAlt];
+	pBvh->sort.pBlockHistograms = &rayQueryBufferStates[rayQueryTransients.dwBlockHistograms];
+	pBvh->sort.pDigitOffsets = &rayQueryBufferStates[rayQueryTransients.dwDigitOffsets];
+	pBvh->sort.pScanPartials = &rayQueryBufferStates[rayQueryTransients.dwScanPartials];
+	*ppRays = &rayQueryBufferStates[rayQueryTransients.dwRays];
+	*ppHits = &rayQueryBufferStates[rayQueryTransients.dwHits];
+	return true;
+}
+
+//no submission may still use the graph's buffers, does nothing when InitRayQueryGraph() was not called
+inline
+void DestroyRayQueryGraph()
+{
+	if( !pRayQueryHeap )
+	{
+		return;
+	}
+	ResidencyUntrackHeap( &residencyManager, dwRayQueryHeapResidency );
+	ReleaseRayQueryTransients();
+}
+
+//out of core streaming through StreamPipeline.h, uploads and readback copies share the streaming queue and the upload ring
+//the caller creates dwDepth slots worth of default input/output buffers (StreamSlotInputSize()/StreamSlotOutputSize())
+//and readback buffers and records the kernel over one chunk in pfnRecordCompute
+typedef void (*PFN_RecordStreamCompute)( void *pContext, ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const StreamChunk *pChunk,
+										 TrackedResource *pInput, TrackedResource *pOutput );
+
+//a slot is only reused once its readback was drained, so its allocators are done with the lists of the previous chunk
+typedef struct StreamSlot
+{
+	ID3D12CommandAllocator* uploadCommandAllocator;
+	ID3D12CommandAllocator* computeCommandAllocator;
+	ID3D12CommandAllocator* readbackCommandAllocator;
+	TrackedResource inputState; //default placed resources
+	TrackedResource outputState;
+	TrackedResource readbackState; //a readback resource, mapped between pfnAcquireOutput and pfnReleaseOutput
+} StreamSlot;
+
+typedef struct StreamContext
+{
+	StreamSlot slots[STREAM_PIPELINE_MAX_DEPTH];
+	u32 dwDepth;
+	u32 dwSlotHeapResidency; //the heap the default input/output buffers are placed in, RESIDENCY_NONE when it is not tracked
+	PFN_RecordStreamCompute pfnRecordCompute;
+	void *pComputeContext;
+} StreamContext;
+
+//PFN_StreamStage for STREAM_STAGE_UPLOAD, the chunk goes through the upload ring so it blocks while the ring is full
+inline
+u64 RecordStreamUpload( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	StreamContext *pStream = (StreamContext*)pContext;
+	StreamSlot *pSlot = &pStream->slots[pChunk->dwSlot];
+	UploadRingAllocation upload;
+	if( !AllocStreamingUpload( pChunk->qwInputSize, &upload ) )
+	{
+		return 0;
+	}
+	u64 qwTraceStart = TraceBegin();
+	memcpy( upload.pCpuAddress, pChunk->pInput, pChunk->qwInputSize );
+	TraceEnd( qwTraceStart, TRACE_KIND_MEMCPY, "Upload chunk", STREAMING_QUEUE_NAME, pChunk->qwInputSize );
+
+	qwTraceStart = TraceBegin();
+	pSlot->uploadCommandAllocator->Reset();
+	streamingCommandList->Reset( pSlot->uploadCommandAllocator, NULL );
+	TrackResourceState( &streamingStateTracker, &pSlot->inputState, TRACKED_STATE_COPY_DEST );
+	FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+	streamingCommandList->CopyBufferRegion( (ID3D12Resource*)pSlot->inputState.pResource, 0, uploadRingBuffer, upload.qwOffset, pChunk->qwInputSize );
+	ResourceStateTrackerClose( &streamingStateTracker );
+	streamingCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record chunk upload", STREAMING_QUEUE_NAME, 1 );
+	if( !UseResidentHeap( pStream->dwSlotHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) )
+	{
+		return 0;
+	}
+	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
+	ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	UploadRingSubmit( &uploadRing, streamingFenceValue );
+	return streamingFenceValue;
+}
+
+//PFN_StreamStage for STREAM_STAGE_COMPUTE, the compute queue waits for the upload on the gpu
+inline
+u64 RecordStreamCompute( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	StreamContext *pStream = (StreamContext*)pContext;
+	StreamSlot *pSlot = &pStream->slots[pChunk->dwSlot];
+	const u64 qwTraceStart = TraceBegin();
+	pSlot->computeCommandAllocator->Reset();
+	computeCommandList->Reset( pSlot->computeCommandAllocator, NULL );
+	pStream->pfnRecordCompute( pStream->pComputeContext, computeCommandList, &computeStateTracker, pChunk, &pSlot->inputState, &pSlot->outputState );
+	//the readback copy reads the output on the streaming queue after this list is done, by then it has decayed back to COMMON
+	ResourceStateTrackerClose( &computeStateTracker );
+	computeCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record chunk compute", COMPUTE_QUEUE_NAME, 1 );
+	if( !UseResidentHeap( pStream->dwSlotHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) )
+	{
+		return 0;
+	}
+	QueueWaitTraced( computeQueue, COMPUTE_QUEUE_NAME, streamingFence, qwWaitValue );
+	ID3D12CommandList* ppComputeCommandLists[] = { computeCommandList };
+	ExecuteCommandListsTraced( computeQueue, COMPUTE_QUEUE_NAME, _countof( ppComputeCommandLists ), ppComputeCommandLists );
+	SignalTraced( computeQueue, COMPUTE_QUEUE_NAME, computeFence, ++computeFenceValue );
+	return computeFenceValue;
+}
+
+//PFN_StreamStage for STREAM_STAGE_READBACK
+inline
+u64 RecordStreamReadback( void *pContext, const StreamChunk *pChunk, u64 qwWaitValue )
+{
+	StreamContext *pStream = (StreamContext*)pContext;
+	StreamSlot *pSlot = &pStream->slots[pChunk->dwSlot];
+	const u64 qwTraceStart = TraceBegin();
+	pSlot->readbackCommandAllocator->Reset();
+	streamingCommandList->Reset( pSlot->readbackCommandAllocator, NULL );
+	TrackResourceState( &streamingStateTracker, &pSlot->outputState, TRACKED_STATE_COPY_SOURCE );
+	TrackResourceState( &streamingStateTracker, &pSlot->readbackState, TRACKED_STATE_COPY_DEST );
+	FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+	streamingCommandList->CopyBufferRegion( (ID3D12Resource*)pSlot->readbackState.pResource, 0, (ID3D12Resource*)pSlot->outputState.pResource, 0, pChunk->qwOutputSize );
+	ResourceStateTrackerClose( &streamingStateTracker );
+	streamingCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record chunk readback", STREAMING_QUEUE_NAME, 1 );
+	if( !UseResidentHeap( pStream->dwSlotHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) )
+	{
+		return 0;
+	}
+	QueueWaitTraced( streamingQueue, STREAMING_QUEUE_NAME, computeFence, qwWaitValue );
+	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
+	ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	return streamingFenceValue;
+}
+
+//PFN_StreamAcquireOutput
+inline
+const u8 *MapStreamOutput( void *pContext, const StreamChunk *pChunk )
+{
+	StreamSlot *pSlot = &((StreamContext*)pContext)->slots[pChunk->dwSlot];
+	WaitForFenceValue( streamingFence, streamingFenceEvent, pChunk->qwFenceValues[STREAM_STAGE_READBACK], STREAMING_QUEUE_NAME );
+	u8 *pMapped;
+	D3D12_RANGE readRange;
+	readRange.Begin = 0;
+	readRange.End = pChunk->qwOutputSize;
+	const u64 qwTraceStart = TraceBegin();
+	if( FAILED( ((ID3D12Resource*)pSlot->readbackState.pResource)->Map( 0, &readRange, (void**)&pMapped ) ) )
+	{
+		return NULL;
+	}
+	TraceEnd( qwTraceStart, TRACE_KIND_MAP, "Map chunk readback", STREAMING_QUEUE_NAME, pChunk->qwOutputSize );
+	return pMapped;
+}
+
+//PFN_StreamReleaseOutput
+inline
+void UnmapStreamOutput( void *pContext, const StreamChunk *pChunk )
+{
+	StreamSlot *pSlot = &((StreamContext*)pContext)->slots[pChunk->dwSlot];
+	D3D12_RANGE emptyRange;
+	emptyRange.Begin = 0;
+	emptyRange.End = 0;
+	const u64 qwTraceStart = TraceBegin();
+	((ID3D12Resource*)pSlot->readbackState.pResource)->Unmap( 0, &emptyRange ); //signal we didn't write anything
+	TraceEnd( qwTraceStart, TRACE_KIND_UNMAP, "Unmap chunk readback", STREAMING_QUEUE_NAME, 0 );
+}
+
+//releases the allocators every slot got so far, nothing may still use them
+inline
+void ReleaseStreamSlots( StreamContext *pStream )
+{
+	for( u32 dwSlot = 0; dwSlot < pStream->dwDepth; ++dwSlot )
+	{
+		StreamSlot *pSlot = &pStream->slots[dwSlot];
+		if( pSlot->uploadCommandAllocator )
+		{
+			pSlot->uploadCommandAllocator->Release();
+		}
+		if( pSlot->computeCommandAllocator )
+		{
+			pSlot->computeCommandAllocator->Release();
+		}
+		if( pSlot->readbackCommandAllocator )
+		{
+			pSlot->readbackCommandAllocator->Release();
+		}
+	}
+	pStream->dwDepth = 0;
+}
+
+//ppInputs/ppOutputs are default buffers in COMMON placed in the heap dwSlotHeapResidency tracks, ppReadbacks readback buffers in COPY_DEST, dwDepth of each
+//pDesc gets the callbacks, the element sizes and chunk size are set by the caller before, a chunk's input has to fit in the upload ring
+inline
+bool InitStreamContext( StreamContext *pStream, StreamPipelineDesc *pDesc, u32 dwDepth, ID3D12Resource **ppInputs, ID3D12Resource **ppOutputs, ID3D12Resource **ppReadbacks,
+						u32 dwSlotHeapResidency, PFN_RecordStreamCompute pfnRecordCompute, void *pComputeContext )
+{
+	if( dwDepth < STREAM_PIPELINE_MIN_DEPTH || dwDepth > STREAM_PIPELINE_MAX_DEPTH )
+	{
+		return false;
+	}
+	if( StreamSlotInputSize( pDesc ) == 0 || StreamSlotInputSize( pDesc ) > UPLOAD_RING_MAX_ALLOC )
+	{
+		logError( "Stream chunk does not fit in the upload ring!\n" );
+		return false;
+	}
+	memset( pStream->slots, 0, sizeof(pStream->slots) );
+	pStream->dwDepth = dwDepth;
+	for( u32 dwSlot = 0; dwSlot < dwDepth; ++dwSlot )
+	{
+		StreamSlot *pSlot = &pStream->slots[dwSlot];
+		if( FAILED( device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &pSlot->uploadCommandAllocator ) ) ) ||
+			FAILED( device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &pSlot->computeCommandAllocator ) ) ) ||
+			FAILED( device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &pSlot->readbackCommandAllocator ) ) ) )
+		{
+			logError( "Failed to create the stream command allocators!\n" );
+			ReleaseStreamSlots( pStream );
+			return false;
+		}
+		InitTrackedResource( &pSlot->inputState, ppInputs[dwSlot], TRACKED_STATE_COMMON, true );
+		InitTrackedResource( &pSlot->outputState, ppOutputs[dwSlot], TRACKED_STATE_COMMON, true );
+		InitTrackedResource( &pSlot->readbackState, ppReadbacks[dwSlot], TRACKED_STATE_COPY_DEST, true );
+	}
+	pStream->dwSlotHeapResidency = dwSlotHeapResidency;
+	pStream->pfnRecordCompute = pfnRecordCompute;
+	pStream->pComputeContext = pComputeContext;
+	pDesc->pfnStages[STREAM_STAGE_UPLOAD] = RecordStreamUpload;
+	pDesc->pfnStages[STREAM_STAGE_COMPUTE] = RecordStreamCompute;
+	pDesc->pfnStages[STREAM_STAGE_READBACK] = RecordStreamReadback;
+	pDesc->pfnAcquireOutput = MapStreamOutput;
+	pDesc->pfnReleaseOutput = UnmapStreamOutput;
+	pDesc->pContext = pStream;
+	pDesc->dwDepth = dwDepth;
+	return true;
+}
 
+//waits for everything the pipeline submitted, a failed run can leave stages in flight, the buffers stay with the caller
 inline
-void QuatfMult( Quatf *__restrict a, Quatf *__restrict b, Quatf *__restrict out )
+void DestroyStreamContext( StreamContext *pStream )
 {
-	out->w = (a->w * b->w) - (a->x* b->x) - (a->y* b->y) - (a->z* b->z);
-	out->x = (a->w * b->x) + (a->x* b->w) + (a->y* b->z) - (a->z* b->y);
-	out->y = (a->w * b->y) + (a->y* b->w) + (a->z* b->x) - (a->x* b->z);
-	out->z = (a->w * b->z) + (a->z* b->w) + (a->x* b->y) - (a->y* b->x);
+	WaitForFenceValue( streamingFence, streamingFenceEvent, streamingFenceValue, STREAMING_QUEUE_NAME );
+	WaitForFenceValue( computeFence, computeFenceEvent, computeFenceValue, COMPUTE_QUEUE_NAME );
+	ReleaseStreamSlots( pStream );
 }
 
+#if MAIN_GPU_CHECKS
+#define GPU_CHECK_MAX_BUFFERS 32
+#define GPU_CHECK_SCAN_COUNT 20000 //not a multiple of SCAN_BLOCK_SIZE so the last block is partial, every check shares the 4MB compute output heap
+#define GPU_CHECK_SCAN_SEGMENT_MEAN 300
+#define GPU_CHECK_RADIX_COUNT 20000 //a partial last block on both backends
+#define GPU_CHECK_CULL_FIRST 37
+#define GPU_CHECK_CULL_COUNT 5000
+#define GPU_CHECK_RAY_SIDE 64 //camera rays per side
+#define GPU_CHECK_RAY_EPSILON 1e-4f //the gpu's division is not exact and it need not fuse the fmas, hits only agree to about this
+#define GPU_CHECK_STREAM_DEPTH STREAM_PIPELINE_MIN_DEPTH
+#define GPU_CHECK_STREAM_CHUNK 4096 //elements, 16KB in and out per slot
+#define GPU_CHECK_STREAM_COUNT ( GPU_CHECK_STREAM_CHUNK * 5 + 1000 ) //more chunks than slots and a partial last chunk
+#define GPU_CHECK_STREAM_INPUT_PATH "GpuCheckStream.in"
+#define GPU_CHECK_STREAM_OUTPUT_PATH "GpuCheckStream.out"
+
+//a buffer of a startup check, placed in the compute output heap next to the compute slots
+typedef struct CheckBuffer
+{
+	ID3D12Resource* pResource;
+	HeapAllocation allocation;
+	TrackedResource state;
+} CheckBuffer;
+
+//startup checks, build with MAIN_GPU_CHECKS=1 (the Compile.bat debug build): every feature pipeline runs once over a small input,
+//its results are read back and compared with the cpu version by a job on the fence timeline while the next check is recorded
+//the pipelines are only created here, without the checks nothing in InitDirectX12() depends on them
+typedef struct GpuChecks
+{
+	CpuComputeDevice cpuDevice; //the cpu versions only run on the fence timeline's waiter thread, one job at a time
+	ID3D12CommandAllocator* computeCommandAllocator; //records every check's compute list
+	CheckBuffer buffers[GPU_CHECK_MAX_BUFFERS];
+	u32 dwBufferCount;
+	std::atomic<u32> dwFailedCount; //written by the jobs
+	u32 *pScanInput; //values then head flags
+	u32 *pRadixInput; //u64 keys as (low, high) pairs then payloads
+	f32 *pCullBounds; //GPU_CHECK_CULL_FIRST + GPU_CHECK_CULL_COUNT CULL_SHAPE_AABB boxes
+	ComputeShaderCB bvhCB; //the cube, offsets from the start of bvhMeshSpan
+	ComputeShaderCB bvhGpuCB; //the cube, offsets from the start of defaultBuffer
+	BvhResources bvh; //what RunBvhCheck() built in the InitRayQueryGraph() transients, traced by RunRayQueryCheck()
+	TrackedResource *pRayBuffer; //the graph's rays and hits
+	TrackedResource *pHitBuffer;
+	ReadbackSpan bvhMeshSpan;
+	ReadbackSpan bvhNodeSpan;
+	ReadbackSpan bvhParentSpan;
+	u64 qwBvhReadback; //streaming fence value the spans are filled at
+	BvhRay *pRays;
+	u32 *pStreamInput; //what was written to GPU_CHECK_STREAM_INPUT_PATH
+	TrackedResource *pStreamPartials; //every chunk's scan uses it, the compute queue runs them one after the other
+} GpuChecks;
+
+//a 90 degree frustum down -z from 1 to 100, not normalized: with integer boxes every dot product is exact, so the fmas of
+//the cpu and the mads of the gpu agree on boxes that touch a plane
+static const Vec4f gpuCheckCullPlanes[6] =
+{
+	{ 1.0f, 0.0f, -1.0f, 0.0f },
+	{ -1.0f, 0.0f, -1.0f, 0.0f },
+	{ 0.0f, 1.0f, -1.0f, 0.0f },
+	{ 0.0f, -1.0f, -1.0f, 0.0f },
+	{ 0.0f, 0.0f, -1.0f, -1.0f },
+	{ 0.0f, 0.0f, 1.0f, 100.0f },
+};
+
+//a COMMON UAV buffer, NULL when the compute output heap is full
+inline
+TrackedResource *CreateCheckBuffer( GpuChecks *pChecks, u64 qwSize )
+{
+	if( pChecks->dwBufferCount == GPU_CHECK_MAX_BUFFERS )
+	{
+		return NULL;
+	}
+	CheckBuffer *pBuffer = &pChecks->buffers[pChecks->dwBufferCount];
+	D3D12_RESOURCE_DESC checkDesc;
+	checkDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	checkDesc.Alignment = 0;
+	checkDesc.Width = qwSize;
+	checkDesc.Height = 1;
+	checkDesc.DepthOrArraySize = 1;
+	checkDesc.MipLevels = 1;
+	checkDesc.Format = DXGI_FORMAT_UNKNOWN;
+	checkDesc.SampleDesc.Count = 1;
+	checkDesc.SampleDesc.Quality = 0;
+	checkDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	checkDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	const D3D12_RESOURCE_ALLOCATION_INFO checkAllocInfo = device->GetResourceAllocationInfo( 0, 1, &checkDesc );
+	if( !HeapAlloc( &computeOutputHeapAllocator, checkAllocInfo.SizeInBytes, checkAllocInfo.Alignment, &pBuffer->allocation ) )
+	{
+		return NULL;
+	}
+	if( FAILED( device->CreatePlacedResource( pComputeOutputHeap, pBuffer->allocation.qwOffset, &checkDesc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS( &pBuffer->pResource ) ) ) )
+	{
+		HeapFree( &computeOutputHeapAllocator, &pBuffer->allocation );
+		return NULL;
+	}
+	InitTrackedResource( &pBuffer->state, pBuffer->pResource, TRACKED_STATE_COMMON, true );
+	++pChecks->dwBufferCount;
+	return &pBuffer->state;
+}
+
+//streamingCommandAllocator is not reset while the checks run, it only ever records one list at a time
+inline
+void BeginCheckStreaming()
+{
+	streamingCommandList->Reset( streamingCommandAllocator, NULL );
+}
+
+//false when the data does not fit in the upload ring
+inline
+bool RecordCheckUpload( TrackedResource *pDest, const void *pData, u64 qwSize )
+{
+	UploadRingAllocation upload;
+	if( qwSize > UPLOAD_RING_MAX_ALLOC || !AllocStreamingUpload( qwSize, &upload ) )
+	{
+		return false;
+	}
+	memcpy( upload.pCpuAddress, pData, qwSize );
+	TrackResourceState( &streamingStateTracker, pDest, TRACKED_STATE_COPY_DEST );
+	FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+	streamingCommandList->CopyBufferRegion( (ID3D12Resource*)pDest->pResource, 0, uploadRingBuffer, upload.qwOffset, qwSize );
+	return true;
+}
+
+//qwSize bytes of pSource from qwOffset into a new span of the readback arena, false when the arena is full
+inline
+bool RecordCheckReadback( TrackedResource *pSource, u64 qwOffset, u64 qwSize, ReadbackSpan *pSpan )
+{
+	if( !ReadbackArenaAlloc( &readbackArena, qwSize, READBACK_ARENA_ALIGNMENT, pSpan ) )
+	{
+		return false;
+	}
+	TrackResourceState( &streamingStateTracker, pSource, TRACKED_STATE_COPY_SOURCE );
+	TrackResourceState( &streamingStateTracker, &readbackArenaState, TRACKED_STATE_COPY_DEST );
+	FlushTrackedBarriers( streamingCommandList, &streamingStateTracker );
+	streamingCommandList->CopyBufferRegion( readbackArenaBuffer, pSpan->qwOffset, (ID3D12Resource*)pSource->pResource, qwOffset, qwSize );
+	return true;
+}
+
+//submits whatever was recorded, after the compute queue reached qwWaitValue (0 for no wait)
+//returns the streaming fence value the copies are done at, 0 when a heap does not fit in the budget
+inline
+u64 SubmitCheckStreaming( u64 qwWaitValue )
+{
+	ResourceStateTrackerClose( &streamingStateTracker );
+	streamingCommandList->Close();
+	if( !UseResidentHeap( dwModelHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) ||
+		!UseResidentHeap( dwComputeOutputHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) ||
+		!UseResidentHeap( dwReadbackHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) ||
+		( pRayQueryHeap && !UseResidentHeap( dwRayQueryHeapResidency, RESIDENCY_QUEUE_STREAMING, streamingFenceValue + 1 ) ) )
+	{
+		return 0;
+	}
+	if( qwWaitValue != 0 )
+	{
+		QueueWaitTraced( streamingQueue, STREAMING_QUEUE_NAME, computeFence, qwWaitValue );
+	}
+	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
+	ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	UploadRingSubmit( &uploadRing, streamingFenceValue );
+	ReadbackArenaSubmit( &readbackArena, streamingFenceValue );
+	return streamingFenceValue;
+}
+
+inline
+void BeginCheckCompute( GpuChecks *pChecks )
+{
+	computeCommandList->Reset( pChecks->computeCommandAllocator, NULL );
+}
+
+//submits the compute list after the streaming queue reached qwWaitValue, returns the compute fence value it is done at, 0 on failure
+inline
+u64 SubmitCheckCompute( u64 qwWaitValue )
+{
+	ResourceStateTrackerClose( &computeStateTracker );
+	computeCommandList->Close();
+	if( !UseResidentHeap( dwModelHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) ||
+		!UseResidentHeap( dwComputeOutputHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) ||
+		( pRayQueryHeap && !UseResidentHeap( dwRayQueryHeapResidency, RESIDENCY_QUEUE_COMPUTE, computeFenceValue + 1 ) ) )
+	{
+		return 0;
+	}
+	QueueWaitTraced( computeQueue, COMPUTE_QUEUE_NAME, streamingFence, qwWaitValue );
+	ID3D12CommandList* ppComputeCommandLists[] = { computeCommandList };
+	ExecuteCommandListsTraced( computeQueue, COMPUTE_QUEUE_NAME, _countof( ppComputeCommandLists ), ppComputeCommandLists );
+	SignalTraced( computeQueue, COMPUTE_QUEUE_NAME, computeFence, ++computeFenceValue );
+	return computeFenceValue;
+}
+
+inline
+void ReportGpuCheck( GpuChecks *pChecks, const char *pName, bool bPassed )
+{
+	printf( "GPU check %s: %s\n", pName, bPassed ? "ok" : "MISMATCH" );
+	if( !bPassed )
+	{
+		++pChecks->dwFailedCount;
+	}
+}
+
+//CpuScan() over the same input once the readback is done
+FenceTimelineJob CompareScanCheck( GpuChecks *pChecks, ComputeShaderCB cb, ReadbackSpan span, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	u32 *pReference = (u32*)malloc( (u64)GPU_CHECK_SCAN_COUNT * sizeof(u32) );
+	u8 *pPartials = (u8*)malloc( ScanScratchSize( GPU_CHECK_SCAN_COUNT ) );
+	bool bPassed = pReference && pPartials;
+	if( bPassed )
+	{
+		ScanKernels kernels;
+		InitScanKernels( &kernels );
+		CpuComputeRootArgs root;
+		memset( &root, 0, sizeof(CpuComputeRootArgs) );
+		root.cb = cb;
+		root.pVerticesAndIndices = (const u8*)pChecks->pScanInput;
+		root.qwVerticesAndIndicesSize = (u64)GPU_CHECK_SCAN_COUNT * 2 * sizeof(u32);
+		root.pUavs[0] = (u8*)pReference;
+		root.pUavs[1] = pPartials;
+		CpuScan( &pChecks->cpuDevice, &kernels, &root );
+		bPassed = memcmp( span.pData, pReference, (u64)GPU_CHECK_SCAN_COUNT * sizeof(u32) ) == 0;
+	}
+	ReportGpuCheck( pChecks, "segmented scan", bPassed );
+	free( pReference );
+	free( pPartials );
+}
+
+//segmented exclusive scan, wrapping sums and a partial last block
+inline
+bool RunScanCheck( GpuChecks *pChecks, u32 dwGPUNumber )
+{
+	if( !InitScanPipelines( dwGPUNumber ) )
+	{
+		logError( "Failed to create scan pipelines!\n" );
+		return false;
+	}
+	const u64 qwInputSize = (u64)GPU_CHECK_SCAN_COUNT * 2 * sizeof(u32);
+	pChecks->pScanInput = (u32*)malloc( qwInputSize );
+	TrackedResource *pInput = CreateCheckBuffer( pChecks, qwInputSize );
+	TrackedResource *pOutput = CreateCheckBuffer( pChecks, (u64)GPU_CHECK_SCAN_COUNT * sizeof(u32) );
+	TrackedResource *pPartials = CreateCheckBuffer( pChecks, ScanScratchSize( GPU_CHECK_SCAN_COUNT ) );
+	if( !pChecks->pScanInput || !pInput || !pOutput || !pPartials )
+	{
+		logError( "Failed to create the scan check buffers!\n" );
+		return false;
+	}
+	u32 *pHeads = pChecks->pScanInput + GPU_CHECK_SCAN_COUNT;
+	u32 dwState = 11;
+	for( u32 dwIdx = 0; dwIdx < GPU_CHECK_SCAN_COUNT; ++dwIdx )
+	{
+		dwState = dwState * 1664525u + 1013904223u;
+		pChecks->pScanInput[dwIdx] = dwState;
+		pHeads[dwIdx] = ( dwState >> 7 ) % GPU_CHECK_SCAN_SEGMENT_MEAN == 0;
+	}
+	const ComputeShaderCB cb = MakeScanCB( 0, GPU_CHECK_SCAN_COUNT, (u32)( GPU_CHECK_SCAN_COUNT * sizeof(u32) ), 0 );
+
+	BeginCheckStreaming();
+	bool bRecorded = RecordCheckUpload( pInput, pChecks->pScanInput, qwInputSize );
+	const u64 qwUploaded = SubmitCheckStreaming( 0 );
+	if( !bRecorded || qwUploaded == 0 )
+	{
+		return false;
+	}
+	BeginCheckCompute( pChecks );
+	RecordScan( computeCommandList, &computeStateTracker, &cb, pInput, pOutput, pPartials, false );
+	const u64 qwComputed = SubmitCheckCompute( qwUploaded );
+	if( qwComputed == 0 )
+	{
+		return false;
+	}
+	BeginCheckStreaming();
+	ReadbackSpan span;
+	bRecorded = RecordCheckReadback( pOutput, 0, (u64)GPU_CHECK_SCAN_COUNT * sizeof(u32), &span );
+	const u64 qwReadback = SubmitCheckStreaming( qwComputed );
+	if( !bRecorded || qwReadback == 0 )
+	{
+		return false;
+	}
+	CompareScanCheck( pChecks, cb, span, qwReadback );
+	return true;
+}
+
+//CpuRadixSort() of the same keys once the readback is done, a stable sort has one answer so keys and payloads match exactly
+FenceTimelineJob CompareRadixSortCheck( GpuChecks *pChecks, ReadbackSpan keySpan, ReadbackSpan payloadSpan, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	const u64 qwKeysSize = (u64)GPU_CHECK_RADIX_COUNT * 2 * sizeof(u32);
+	const u64 qwPayloadSize = (u64)GPU_CHECK_RADIX_COUNT * sizeof(u32);
+	RadixSortBuffers buffers;
+	buffers.pKeys = (u32*)malloc( qwKeysSize );
+	buffers.pKeysAlt = (u32*)malloc( qwKeysSize );
+	buffers.pPayload = (u32*)malloc( qwPayloadSize );
+	buffers.pPayloadAlt = (u32*)malloc( qwPayloadSize );
+	buffers.pBlockHistograms = (u32*)malloc( (u64)RadixHistogramCount( GPU_CHECK_RADIX_COUNT, RADIX_CPU_TILE ) * sizeof(u32) );
+	buffers.pDigitOffsets = (u32*)malloc( (u64)RadixHistogramCount( GPU_CHECK_RADIX_COUNT, RADIX_CPU_TILE ) * sizeof(u32) );
+	buffers.pScanPartials = (u8*)malloc( RadixScanScratchSize( GPU_CHECK_RADIX_COUNT, RADIX_CPU_TILE ) );
+	bool bPassed = buffers.pKeys && buffers.pKeysAlt && buffers.pPayload && buffers.pPayloadAlt && buffers.pBlockHistograms && buffers.pDigitOffsets && buffers.pScanPartials;
+	if( bPassed )
+	{
+		RadixSortKernels kernels;
+		InitRadixSortKernels( &kernels );
+		memcpy( buffers.pKeys, pChecks->pRadixInput, qwKeysSize );
+		memcpy( buffers.pPayload, pChecks->pRadixInput + (u64)GPU_CHECK_RADIX_COUNT * 2, qwPayloadSize );
+		CpuRadixSort( &pChecks->cpuDevice, &kernels, &buffers, 0, GPU_CHECK_RADIX_COUNT, true );
+		bPassed = memcmp( keySpan.pData, buffers.pKeys, qwKeysSize ) == 0 && memcmp( payloadSpan.pData, buffers.pPayload, qwPayloadSize ) == 0;
+	}
+	ReportGpuCheck( pChecks, "radix sort", bPassed );
+	free( buffers.pKeys );
+	free( buffers.pKeysAlt );
+	free( buffers.pPayload );
+	free( buffers.pPayloadAlt );
+	free( buffers.pBlockHistograms );
+	free( buffers.pDigitOffsets );
+	free( buffers.pScanPartials );
+}
+
+//u64 keys with payloads, the high words only use their low byte so the cpu skips the last 3 passes and the gpu does not
+//runs after RunScanCheck(), which created the scan pipelines the digit offsets need
+inline
+bool RunRadixSortCheck( GpuChecks *pChecks, u32 dwGPUNumber )
+{
+	if( !InitRadixSortPipelines( dwGPUNumber ) )
+	{
+		logError( "Failed to create radix sort pipelines!\n" );
+		return false;
+	}
+	const u64 qwKeysSize = (u64)GPU_CHECK_RADIX_COUNT * 2 * sizeof(u32);
+	const u64 qwPayloadSize = (u64)GPU_CHECK_RADIX_COUNT * sizeof(u32);
+	pChecks->pRadixInput = (u32*)malloc( qwKeysSize + qwPayloadSize );
+	RadixSortResources resources;
+	resources.pKeys = CreateCheckBuffer( pChecks, qwKeysSize );
+	resources.pKeysAlt = CreateCheckBuffer( pChecks, qwKeysSize );
+	resources.pPayload = CreateCheckBuffer( pChecks, qwPayloadSize );
+	resources.pPayloadAlt = CreateCheckBuffer( pChecks, qwPayloadSize );
+	resources.pBlockHistograms = CreateCheckBuffer( pChecks, (u64)RadixHistogramCount( GPU_CHECK_RADIX_COUNT, RADIX_BLOCK_SIZE ) * sizeof(u32) );
+	resources.pDigitOffsets = CreateCheckBuffer( pChecks, (u64)RadixHistogramCount( GPU_CHECK_RADIX_COUNT, RADIX_BLOCK_SIZE ) * sizeof(u32) );
+	resources.pScanPartials = CreateCheckBuffer( pChecks, RadixScanScratchSize( GPU_CHECK_RADIX_COUNT, RADIX_BLOCK_SIZE ) );
+	if( !pChecks->pRadixInput || !resources.pKeys || !resources.pKeysAlt || !resources.pPayload || !resources.pPayloadAlt ||
+		!resources.pBlockHistograms || !resources.pDigitOffsets || !resources.pScanPartials )
+	{
+		logError( "Failed to create the radix sort check buffers!\n" );
+		return false;
+	}
+	u32 *pPayload = pChecks->pRadixInput + (u64)GPU_CHECK_RADIX_COUNT * 2;
+	u64 qwState = 0x9E3779B97F4A7C15ull;
+	for( u32 dwIdx = 0; dwIdx < GPU_CHECK_RADIX_COUNT; ++dwIdx )
+	{
+		qwState = qwState * 6364136223846793005ull + 1442695040888963407ull;
+		pChecks->pRadixInput[dwIdx * 2] = (u32)( qwState >> 32 );
+		pChecks->pRadixInput[dwIdx * 2 + 1] = (u32)( qwState >> 56 );
+		pPayload[dwIdx] = dwIdx;
+	}
+
+	BeginCheckStreaming();
+	bool bRecorded = RecordCheckUpload( resources.pKeys, pChecks->pRadixInput, qwKeysSize ) &&
+					 RecordCheckUpload( resources.pPayload, pPayload, qwPayloadSize );
+	const u64 qwUploaded = SubmitCheckStreaming( 0 );
+	if( !bRecorded || qwUploaded == 0 )
+	{
+		return false;
+	}
+	BeginCheckCompute( pChecks );
+	RecordRadixSort( computeCommandList, &computeStateTracker, &resources, 0, GPU_CHECK_RADIX_COUNT, true );
+	const u64 qwComputed = SubmitCheckCompute( qwUploaded );
+	if( qwComputed == 0 )
+	{
+		return false;
+	}
+	BeginCheckStreaming();
+	ReadbackSpan keySpan;
+	ReadbackSpan payloadSpan;
+	bRecorded = RecordCheckReadback( resources.pKeys, 0, qwKeysSize, &keySpan ) &&
+				RecordCheckReadback( resources.pPayload, 0, qwPayloadSize, &payloadSpan );
+	const u64 qwReadback = SubmitCheckStreaming( qwComputed );
+	if( !bRecorded || qwReadback == 0 )
+	{
+		return false;
+	}
+	CompareRadixSortCheck( pChecks, keySpan, payloadSpan, qwReadback );
+	return true;
+}
+
+//CpuCullInstances() and CpuGatherVisible() of the same boxes once the readback is done
+FenceTimelineJob CompareCullCheck( GpuChecks *pChecks, ReadbackSpan listSpan, ReadbackSpan gatherSpan, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	u8 *pScratch = (u8*)malloc( CullScratchSize( GPU_CHECK_CULL_COUNT ) );
+	u8 *pList = (u8*)malloc( CullListSize( GPU_CHECK_CULL_COUNT ) );
+	u8 *pGathered = (u8*)malloc( (u64)GPU_CHECK_CULL_COUNT * 32 );
+	bool bPassed = pScratch && pList && pGathered;
+	if( bPassed )
+	{
+		CullKernels kernels;
+		InitCullKernels( &kernels );
+		const u32 dwVisible = CpuCullInstances( &pChecks->cpuDevice, &kernels, gpuCheckCullPlanes, pChecks->pCullBounds, GPU_CHECK_CULL_FIRST, GPU_CHECK_CULL_COUNT,
+												CULL_SHAPE_AABB, 0, pScratch, pList );
+		const u64 qwGathered = CpuGatherVisible( pChecks->pCullBounds, pList, CULL_SHAPE_AABB, pGathered );
+		bPassed = memcmp( listSpan.pData, pList, CullListSize( dwVisible ) ) == 0 && memcmp( gatherSpan.pData, pGathered, qwGathered ) == 0;
+	}
+	ReportGpuCheck( pChecks, "culling", bPassed );
+	free( pScratch );
+	free( pList );
+	free( pGathered );
+}
+
+//culls boxes from GPU_CHECK_CULL_FIRST on, then CullGatherVisible runs over the list with RecordDispatchVisibleInstances()
+//runs after RunScanCheck(), which created the scan pipelines the visible offsets need
+inline
+bool RunCullCheck( GpuChecks *pChecks, u32 dwGPUNumber )
+{
+	if( !InitCullingPipelines( dwGPUNumber ) )
+	{
+		logError( "Failed to create culling pipelines!\n" );
+		return false;
+	}
+	const u64 qwBoundsSize = (u64)( GPU_CHECK_CULL_FIRST + GPU_CHECK_CULL_COUNT ) * 32;
+	pChecks->pCullBounds = (f32*)malloc( qwBoundsSize );
+	TrackedResource *pPlanes = CreateCheckBuffer( pChecks, 256 ); //a CBV covers 256 bytes
+	TrackedResource *pGathered = CreateCheckBuffer( pChecks, (u64)GPU_CHECK_CULL_COUNT * 32 );
+	CullResources resources;
+	resources.pBounds = CreateCheckBuffer( pChecks, qwBoundsSize );
+	resources.pVisibleFlags = CreateCheckBuffer( pChecks, (u64)GPU_CHECK_CULL_COUNT * sizeof(u32) );
+	resources.pVisibleOffsets = CreateCheckBuffer( pChecks, (u64)GPU_CHECK_CULL_COUNT * sizeof(u32) );
+	resources.pScanPartials = CreateCheckBuffer( pChecks, ScanScratchSize( GPU_CHECK_CULL_COUNT ) );
+	resources.pVisibleInstances = CreateCheckBuffer( pChecks, CullListSize( GPU_CHECK_CULL_COUNT ) );
+	if( !pChecks->pCullBounds || !pPlanes || !pGathered || !resources.pBounds || !resources.pVisibleFlags || !resources.pVisibleOffsets ||
+		!resources.pScanPartials || !resources.pVisibleInstances )
+	{
+		logError( "Failed to create the culling check buffers!\n" );
+		return false;
+	}
+	//centers in a box around the first 127 units of the frustum and extents up to 7, so plenty of boxes cross or touch a plane
+	u32 dwState = 5;
+	for( u32 dwIdx = 0; dwIdx < GPU_CHECK_CULL_FIRST + GPU_CHECK_CULL_COUNT; ++dwIdx )
+	{
+		f32 *pBox = pChecks->pCullBounds + (u64)dwIdx * 8;
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			dwState = dwState * 1664525u + 1013904223u;
+			pBox[dwAxis] = dwAxis < 2 ? (f32)( (s32)( dwState >> 25 ) - 64 ) : -(f32)( dwState >> 25 );
+			pBox[4 + dwAxis] = (f32)( ( dwState >> 8 ) & 7 );
+		}
+		pBox[3] = 0.0f;
+		pBox[7] = 0.0f;
+	}
+	const D3D12_GPU_VIRTUAL_ADDRESS planesAddress = ( (ID3D12Resource*)pPlanes->pResource )->GetGPUVirtualAddress();
+
+	BeginCheckStreaming();
+	bool bRecorded = RecordCheckUpload( pPlanes, gpuCheckCullPlanes, sizeof(gpuCheckCullPlanes) ) &&
+					 RecordCheckUpload( resources.pBounds, pChecks->pCullBounds, qwBoundsSize );
+	const u64 qwUploaded = SubmitCheckStreaming( 0 );
+	if( !bRecorded || qwUploaded == 0 )
+	{
+		return false;
+	}
+	BeginCheckCompute( pChecks );
+	TrackResourceState( &computeStateTracker, pPlanes, TRACKED_STATE_VERTEX_AND_CONSTANT_BUFFER );
+	RecordCullInstances( computeCommandList, &computeStateTracker, &resources, planesAddress, GPU_CHECK_CULL_FIRST, GPU_CHECK_CULL_COUNT, CULL_SHAPE_AABB );
+
+	//the list is read through t1 and the gathered boxes written through u0, u1 only needs something bound
+	CullResources gatherResources = resources;
+	gatherResources.pVisibleFlags = pGathered;
+	gatherResources.pVisibleOffsets = resources.pVisibleInstances;
+	gatherResources.pVisibleInstances = pGathered;
+	const ComputeShaderCB gatherCB = MakeCullCB( GPU_CHECK_CULL_FIRST, GPU_CHECK_CULL_COUNT, CULL_SHAPE_AABB, 0 );
+	SetCullRootArgs( computeCommandList, &gatherCB, planesAddress, &gatherResources );
+	computeCommandList->SetPipelineState( cullGatherVisiblePSO );
+	TrackResourceState( &computeStateTracker, pGathered, TRACKED_STATE_UNORDERED_ACCESS );
+	RecordDispatchVisibleInstances( computeCommandList, &computeStateTracker, resources.pVisibleInstances );
+	const u64 qwComputed = SubmitCheckCompute( qwUploaded );
+	if( qwComputed == 0 )
+	{
+		return false;
+	}
+	//the whole list and every box, only the visible part is compared
+	BeginCheckStreaming();
+	ReadbackSpan listSpan;
+	ReadbackSpan gatherSpan;
+	bRecorded = RecordCheckReadback( resources.pVisibleInstances, 0, CullListSize( GPU_CHECK_CULL_COUNT ), &listSpan ) &&
+				RecordCheckReadback( pGathered, 0, (u64)GPU_CHECK_CULL_COUNT * 32, &gatherSpan );
+	const u64 qwReadback = SubmitCheckStreaming( qwComputed );
+	if( !bRecorded || qwReadback == 0 )
+	{
+		return false;
+	}
+	CompareCullCheck( pChecks, listSpan, gatherSpan, qwReadback );
+	return true;
+}
+
+//the cube's vertices and indices as a range of defaultBuffer, pCB is MakeBvhCB() with offsets from the start of the range
+inline
+void GetCubeMeshRange( u64 *pOffset, u64 *pSize, ComputeShaderCB *pCB )
+{
+	const u64 qwVertexOffset = cubeVertexBufferView.BufferLocation - defaultBuffer->GetGPUVirtualAddress();
+	const u64 qwIndexOffset = cubeIndexBufferView.BufferLocation - defaultBuffer->GetGPUVirtualAddress();
+	const u64 qwVertexEnd = qwVertexOffset + cubeVertexBufferView.SizeInBytes;
+	const u64 qwIndexEnd = qwIndexOffset + cubeIndexBufferView.SizeInBytes;
+	*pOffset = qwVertexOffset < qwIndexOffset ? qwVertexOffset : qwIndexOffset;
+	*pSize = ( qwVertexEnd > qwIndexEnd ? qwVertexEnd : qwIndexEnd ) - *pOffset;
+	*pCB = MakeBvhCB( (u32)( qwVertexOffset - *pOffset ), (u32)( qwIndexOffset - *pOffset ), cubeIndexCount / 3, cubeVertexBufferView.StrideInBytes );
+}
+
+//CheckBvh() of the gpu nodes over the mesh that was read back with them, the root box has to be the one CpuBuildBvh() gets
+//the morton codes come from divisions that may round differently on the gpu, so the rest of the hierarchy can differ
+FenceTimelineJob CompareBvhCheck( GpuChecks *pChecks, ReadbackSpan meshSpan, ReadbackSpan nodeSpan, ReadbackSpan parentSpan, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	const ComputeShaderCB *pCB = &pChecks->bvhCB;
+	BvhBuildBuffers buffers;
+	bool bPassed = AllocBvhBuildBuffers( pCB->dwOffsetsAndStrides0[2], &buffers );
+	if( bPassed )
+	{
+		BvhKernels kernels;
+		InitBvhKernels( &kernels );
+		CpuBuildBvh( &pChecks->cpuDevice, &kernels, meshSpan.pData, meshSpan.qwSize, pCB, &buffers );
+		const BvhNode *pRoot = (const BvhNode*)nodeSpan.pData;
+		bPassed = CheckBvh( pRoot, (const u32*)parentSpan.pData, meshSpan.pData, pCB );
+		for( u32 dwAxis = 0; dwAxis < 3; ++dwAxis )
+		{
+			bPassed = bPassed && pRoot->fMin[dwAxis] == buffers.pNodes->fMin[dwAxis] && pRoot->fMax[dwAxis] == buffers.pNodes->fMax[dwAxis];
+		}
+	}
+	ReportGpuCheck( pChecks, "bvh build", bPassed );
+	FreeBvhBuildBuffers( &buffers );
+}
+
+//a bvh over the cube in defaultBuffer, the cpu builds its own over the mesh bytes that are read back with the nodes
+//the buffers are the ray query graph's aliased transients, DestroyGpuChecks() releases them
+//runs after RunRadixSortCheck(), which created the pipelines the morton code sort needs
+inline
+bool RunBvhCheck( GpuChecks *pChecks, u32 dwGPUNumber, u32 dwVisibleGPUMask )
+{
+	if( !InitBvhPipelines( dwGPUNumber ) )
+	{
+		logError( "Failed to create bvh pipelines!\n" );
+		return false;
+	}
+	u64 qwMeshOffset;
+	u64 qwMeshSize;
+	GetCubeMeshRange( &qwMeshOffset, &qwMeshSize, &pChecks->bvhCB );
+	pChecks->bvhGpuCB = MakeBvhCB( pChecks->bvhCB.dwOffsetsAndStrides0[0] + (u32)qwMeshOffset, pChecks->bvhCB.dwOffsetsAndStrides0[1] + (u32)qwMeshOffset,
+								   pChecks->bvhCB.dwOffsetsAndStrides0[2], pChecks->bvhCB.dwOffsetsAndStrides0[3] );
+	const u32 dwTriangles = pChecks->bvhCB.dwOffsetsAndStrides0[2];
+	BvhResources resources;
+	if( !InitRayQueryGraph( dwTriangles, GPU_CHECK_RAY_SIDE * GPU_CHECK_RAY_SIDE, dwGPUNumber, dwVisibleGPUMask, &modelBufferState, &resources,
+							&pChecks->pRayBuffer, &pChecks->pHitBuffer ) )
+	{
+		return false;
+	}
+
+	//defaultBuffer was uploaded before the startup dispatches, nothing has to be copied in first
+	BeginCheckCompute( pChecks );
+	RecordBuildBvh( computeCommandList, &computeStateTracker, &resources, &pChecks->bvhGpuCB, &rayQueryPlan, rayQueryBufferStates );
+	const u64 qwComputed = SubmitCheckCompute( streamingFenceValue );
+	if( qwComputed == 0 )
+	{
+		return false;
+	}
+	BeginCheckStreaming();
+	ReadbackSpan meshSpan;
+	ReadbackSpan nodeSpan;
+	ReadbackSpan parentSpan;
+	bool bRecorded = RecordCheckReadback( &modelBufferState, qwMeshOffset, qwMeshSize, &meshSpan ) &&
+					 RecordCheckReadback( resources.pNodes, 0, (u64)BvhNodeCount( dwTriangles ) * sizeof(BvhNode), &nodeSpan ) &&
+					 RecordCheckReadback( resources.pParents, 0, (u64)BvhNodeCount( dwTriangles ) * sizeof(u32), &parentSpan );
+	const u64 qwReadback = SubmitCheckStreaming( qwComputed );
+	if( !bRecorded || qwReadback == 0 )
+	{
+		return false;
+	}
+	CompareBvhCheck( pChecks, meshSpan, nodeSpan, parentSpan, qwReadback );
+	pChecks->bvh = resources;
+	pChecks->bvhMeshSpan = meshSpan;
+	pChecks->bvhNodeSpan = nodeSpan;
+	pChecks->bvhParentSpan = parentSpan;
+	pChecks->qwBvhReadback = qwReadback;
+	return true;
+}
+
+//a ray that hits within GPU_CHECK_RAY_EPSILON of an edge of its triangle, rounding can move it to the neighbour or through the crack
+inline
+bool IsRayHitNearEdge( const BvhHit *pHit )
+{
+	return pHit->dwTriangle != BVH_INVALID_NODE &&
+		   ( pHit->fU < GPU_CHECK_RAY_EPSILON || pHit->fV < GPU_CHECK_RAY_EPSILON || 1.f - pHit->fU - pHit->fV < GPU_CHECK_RAY_EPSILON );
+}
+
+//CpuRayQueryClosestHit() against the gpu's nodes once the hits are read back: the same triangle with t, u and v close,
+//a different one (or a miss) only for rays that graze an edge
+FenceTimelineJob CompareRayQueryCheck( GpuChecks *pChecks, ReadbackSpan hitSpan, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	const u32 dwRayCount = GPU_CHECK_RAY_SIDE * GPU_CHECK_RAY_SIDE;
+	BvhHit *pHits = (BvhHit*)malloc( (u64)dwRayCount * sizeof(BvhHit) );
+	bool bPassed = pHits != NULL;
+	if( bPassed )
+	{
+		RayQueryKernels kernels;
+		InitRayQueryKernels( &kernels );
+		const ComputeShaderCB cb = MakeRayQueryCB( pChecks->bvhCB.dwOffsetsAndStrides0[0], pChecks->bvhCB.dwOffsetsAndStrides0[1], dwRayCount,
+												   pChecks->bvhCB.dwOffsetsAndStrides0[3] );
+		CpuRayQueryClosestHit( &pChecks->cpuDevice, &kernels, false, pChecks->bvhMeshSpan.pData, pChecks->bvhMeshSpan.qwSize, &cb,
+							   (const BvhNode*)pChecks->bvhNodeSpan.pData, (const u32*)pChecks->bvhParentSpan.pData, pChecks->pRays, pHits );
+		const BvhHit *pGpuHits = (const BvhHit*)hitSpan.pData;
+		for( u32 dwRay = 0; dwRay < dwRayCount && bPassed; ++dwRay )
+		{
+			const BvhHit *pGpu = &pGpuHits[dwRay];
+			const BvhHit *pCpu = &pHits[dwRay];
+			if( pGpu->dwTriangle != pCpu->dwTriangle )
+			{
+				bPassed = IsRayHitNearEdge( pGpu ) || IsRayHitNearEdge( pCpu );
+			}
+			else if( pGpu->dwTriangle != BVH_INVALID_NODE )
+			{
+				bPassed = fabsf( pGpu->fT - pCpu->fT ) <= GPU_CHECK_RAY_EPSILON * ( 1.f + fabsf( pCpu->fT ) ) &&
+						  fabsf( pGpu->fU - pCpu->fU ) <= GPU_CHECK_RAY_EPSILON && fabsf( pGpu->fV - pCpu->fV ) <= GPU_CHECK_RAY_EPSILON;
+			}
+		}
+	}
+	ReportGpuCheck( pChecks, "ray query", bPassed );
+	free( pHits );
+}
+
+//camera rays at the bvh RunBvhCheck() built, made from its root box so this waits for that readback first
+inline
+bool RunRayQueryCheck( GpuChecks *pChecks, u32 dwGPUNumber )
+{
+	if( !InitRayQueryPipelines( dwGPUNumber ) )
+	{
+		logError( "Failed to create ray query pipelines!\n" );
+		return false;
+	}
+	const u32 dwRayCount = GPU_CHECK_RAY_SIDE * GPU_CHECK_RAY_SIDE;
+	pChecks->pRays = (BvhRay*)malloc( (u64)dwRayCount * sizeof(BvhRay) );
+	if( !pChecks->pRays )
+	{
+		logError( "Failed to create the ray query check rays!\n" );
+		return false;
+	}
+	TrackedResource *pRays = pChecks->pRayBuffer;
+	TrackedResource *pHits = pChecks->pHitBuffer;
+	WaitForFenceValue( streamingFence, streamingFenceEvent, pChecks->qwBvhReadback, STREAMING_QUEUE_NAME );
+	MakeCameraRays( (const BvhNode*)pChecks->bvhNodeSpan.pData, GPU_CHECK_RAY_SIDE, pChecks->pRays );
+	const ComputeShaderCB cb = MakeRayQueryCB( pChecks->bvhGpuCB.dwOffsetsAndStrides0[0], pChecks->bvhGpuCB.dwOffsetsAndStrides0[1], dwRayCount,
+											   pChecks->bvhGpuCB.dwOffsetsAndStrides0[3] );
+
+	BeginCheckStreaming();
+	bool bRecorded = RecordCheckUpload( pRays, pChecks->pRays, (u64)dwRayCount * sizeof(BvhRay) );
+	const u64 qwUploaded = SubmitCheckStreaming( 0 );
+	if( !bRecorded || qwUploaded == 0 )
+	{
+		return false;
+	}
+	BeginCheckCompute( pChecks );
+	RecordRayQueryClosestHit( computeCommandList, &computeStateTracker, &cb, &pChecks->bvh, pRays, pHits, &rayQueryPlan, rayQueryBufferStates );
+	const u64 qwComputed = SubmitCheckCompute( qwUploaded );
+	if( qwComputed == 0 )
+	{
+		return false;
+	}
+	BeginCheckStreaming();
+	ReadbackSpan hitSpan;
+	bRecorded = RecordCheckReadback( pHits, 0, (u64)dwRayCount * sizeof(BvhHit), &hitSpan );
+	const u64 qwReadback = SubmitCheckStreaming( qwComputed );
+	if( !bRecorded || qwReadback == 0 )
+	{
+		return false;
+	}
+	CompareRayQueryCheck( pChecks, hitSpan, qwReadback );
+	return true;
+}
+
+//PFN_RecordStreamCompute of the stream check, an inclusive scan of the chunk on its own
+inline
+void RecordStreamCheckScan( void *pContext, ID3D12GraphicsCommandList *pCommandList, ResourceStateTracker *pTracker, const StreamChunk *pChunk,
+							TrackedResource *pInput, TrackedResource *pOutput )
+{
+	const ComputeShaderCB cb = MakeScanCB( 0, pChunk->dwElementCount, SCAN_NO_SEGMENTS, SCAN_FLAG_INCLUSIVE );
+	RecordScan( pCommandList, pTracker, &cb, pInput, pOutput, ((GpuChecks*)pContext)->pStreamPartials, false );
+}
+
+//CpuScan() of every chunk of the input against the output file, which is removed after
+FenceTimelineJob CompareStreamCheck( GpuChecks *pChecks, u64 qwFenceValue )
+{
+	co_await FenceTimelineAwait( &fenceTimeline, streamingFence, qwFenceValue );
+	u32 *pReference = (u32*)malloc( (u64)GPU_CHECK_STREAM_CHUNK * sizeof(u32) );
+	u8 *pPartials = (u8*)malloc( ScanScratchSize( GPU_CHECK_STREAM_CHUNK ) );
+	MappedFile output;
+	bool bPassed = pReference && pPartials && OpenMappedFile( GPU_CHECK_STREAM_OUTPUT_PATH, &output, true );
+	if( bPassed )
+	{
+		bPassed = output.qwSize == (u64)GPU_CHECK_STREAM_COUNT * sizeof(u32);
+		ScanKernels kernels;
+		InitScanKernels( &kernels );
+		CpuComputeRootArgs root;
+		memset( &root, 0, sizeof(CpuComputeRootArgs) );
+		root.pUavs[0] = (u8*)pReference;
+		root.pUavs[1] = pPartials;
+		for( u32 dwFirst = 0; dwFirst < GPU_CHECK_STREAM_COUNT && bPassed; dwFirst += GPU_CHECK_STREAM_CHUNK )
+		{
+			const u32 dwCount = GPU_CHECK_STREAM_COUNT - dwFirst < GPU_CHECK_STREAM_CHUNK ? GPU_CHECK_STREAM_COUNT - dwFirst : GPU_CHECK_STREAM_CHUNK;
+			root.cb = MakeScanCB( 0, dwCount, SCAN_NO_SEGMENTS, SCAN_FLAG_INCLUSIVE );
+			root.pVerticesAndIndices = (const u8*)( pChecks->pStreamInput + dwFirst );
+			root.qwVerticesAndIndicesSize = (u64)dwCount * sizeof(u32);
+			CpuScan( &pChecks->cpuDevice, &kernels, &root );
+			bPassed = memcmp( output.pBase + (u64)dwFirst * sizeof(u32), pReference, (u64)dwCount * sizeof(u32) ) == 0;
+		}
+		CloseMappedFile( &output );
+	}
+	remove( GPU_CHECK_STREAM_OUTPUT_PATH );
+	ReportGpuCheck( pChecks, "streamed scan", bPassed );
+	free( pReference );
+	free( pPartials );
+}
+
+//dwCount readback buffers of qwSize bytes in COPY_DEST, placed in a heap of their own that is tracked as pinned
 inline
-void QuatfSub( Quatf *a, Quatf *b, Quatf *out )
+bool CreateCheckReadbackBuffers( u32 dwGPUNumber, u32 dwVisibleGPUMask, u64 qwSize, u32 dwCount, ID3D12Heap **ppHeap, u32 *pdwResidency, ID3D12Resource **ppBuffers )
 {
-	out->w = a->w - b->w;
-	out->x = a->x - b->x;
-	out->y = a->y - b->y;
-	out->z = a->z - b->z;
+	const u64 qwStride = AlignUp( qwSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT );
+	D3D12_HEAP_DESC checkReadbackHeapDesc;
+	checkReadbackHeapDesc.SizeInBytes = qwStride * dwCount;
+	checkReadbackHeapDesc.Properties.Type = D3D12_HEAP_TYPE_READBACK;
+	checkReadbackHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	checkReadbackHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	checkReadbackHeapDesc.Properties.CreationNodeMask = dwGPUNumber;
+	checkReadbackHeapDesc.Properties.VisibleNodeMask = dwVisibleGPUMask;
+	checkReadbackHeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	checkReadbackHeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS | D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
+	if( FAILED( device->CreateHeap( &checkReadbackHeapDesc, IID_PPV_ARGS( ppHeap ) ) ) )
+	{
+		return false;
+	}
+	*pdwResidency = ResidencyTrackHeap( &residencyManager, *ppHeap, checkReadbackHeapDesc.SizeInBytes, RESIDENCY_SEGMENT_NON_LOCAL, "Check Readback Heap", true );
+	for( u32 dwBuffer = 0; dwBuffer < dwCount; ++dwBuffer )
+	{
+		D3D12_RESOURCE_DESC checkReadbackDesc;
+		checkReadbackDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		checkReadbackDesc.Alignment = 0;
+		checkReadbackDesc.Width = qwSize;
+		checkReadbackDesc.Height = 1;
+		checkReadbackDesc.DepthOrArraySize = 1;
+		checkReadbackDesc.MipLevels = 1;
+		checkReadbackDesc.Format = DXGI_FORMAT_UNKNOWN;
+		checkReadbackDesc.SampleDesc.Count = 1;
+		checkReadbackDesc.SampleDesc.Quality = 0;
+		checkReadbackDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		checkReadbackDesc.Flags = D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+		if( FAILED( device->CreatePlacedResource( *ppHeap, qwStride * dwBuffer, &checkReadbackDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS( &ppBuffers[dwBuffer] ) ) ) )
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
+//GPU_CHECK_STREAM_COUNT u32s go through a file and InitStreamContext() in GPU_CHECK_STREAM_CHUNK element chunks, chunk n uploads
+//while n-1 is scanned and n-2 read back. opened, run, drained and destroyed here, only the compare is left to the job
+//runs after RunScanCheck(), which created the scan pipelines
 inline
-void QuatfScaleAdd( Quatf *a, f32 scale, Quatf *b, Quatf *out )
+bool RunStreamCheck( GpuChecks *pChecks, u32 dwGPUNumber, u32 dwVisibleGPUMask )
 {
-	out->w = (a->w * scale) + b->w;
-	out->x = (a->x * scale) + b->x;
-	out->y = (a->y * scale) + b->y;
-	out->z = (a->z * scale) + b->z;
+	const u64 qwChunkSize = (u64)GPU_CHECK_STREAM_CHUNK * sizeof(u32);
+	pChecks->pStreamInput = (u32*)malloc( (u64)GPU_CHECK_STREAM_COUNT * sizeof(u32) );
+	pChecks->pStreamPartials = CreateCheckBuffer( pChecks, ScanScratchSize( GPU_CHECK_STREAM_CHUNK ) );
+	ID3D12Resource *ppInputs[GPU_CHECK_STREAM_DEPTH];
+	ID3D12Resource *ppOutputs[GPU_CHECK_STREAM_DEPTH];
+	bool bCreated = pChecks->pStreamInput && pChecks->pStreamPartials;
+	for( u32 dwSlot = 0; dwSlot < GPU_CHECK_STREAM_DEPTH && bCreated; ++dwSlot )
+	{
+		TrackedResource *pInput = CreateCheckBuffer( pChecks, qwChunkSize );
+		TrackedResource *pOutput = CreateCheckBuffer( pChecks, qwChunkSize );
+		bCreated = pInput && pOutput;
+		ppInputs[dwSlot] = bCreated ? (ID3D12Resource*)pInput->pResource : NULL;
+		ppOutputs[dwSlot] = bCreated ? (ID3D12Resource*)pOutput->pResource : NULL;
+	}
+	if( !bCreated )
+	{
+		logError( "Failed to create the stream check buffers!\n" );
+		return false;
+	}
+	u64 qwState = 0x2545F4914F6CDD1Dull;
+	for( u32 dwIdx = 0; dwIdx < GPU_CHECK_STREAM_COUNT; ++dwIdx )
+	{
+		qwState = qwState * 6364136223846793005ull + 1442695040888963407ull;
+		pChecks->pStreamInput[dwIdx] = (u32)( qwState >> 32 ); //big enough that the sums wrap
+	}
+	FILE *pInputFile = fopen( GPU_CHECK_STREAM_INPUT_PATH, "wb" );
+	if( !pInputFile )
+	{
+		logError( "Failed to create the stream check input!\n" );
+		return false;
+	}
+	bool bPassed = fwrite( pChecks->pStreamInput, sizeof(u32), GPU_CHECK_STREAM_COUNT, pInputFile ) == GPU_CHECK_STREAM_COUNT;
+	bPassed &= fclose( pInputFile ) == 0;
+
+	ID3D12Heap *pStreamReadbackHeap = NULL;
+	u32 dwReadbackResidency = RESIDENCY_NONE;
+	ID3D12Resource *ppReadbacks[GPU_CHECK_STREAM_DEPTH] = {};
+	bPassed = bPassed && CreateCheckReadbackBuffers( dwGPUNumber, dwVisibleGPUMask, qwChunkSize, GPU_CHECK_STREAM_DEPTH, &pStreamReadbackHeap, &dwReadbackResidency, ppReadbacks );
+	StreamContext stream;
+	StreamPipelineDesc desc;
+	memset( &desc, 0, sizeof(StreamPipelineDesc) );
+	desc.dwChunkElements = GPU_CHECK_STREAM_CHUNK;
+	desc.dwInputElementSize = sizeof(u32);
+	desc.dwOutputElementSize = sizeof(u32);
+	if( bPassed && InitStreamContext( &stream, &desc, GPU_CHECK_STREAM_DEPTH, ppInputs, ppOutputs, ppReadbacks, dwComputeOutputHeapResidency,
+									  RecordStreamCheckScan, pChecks ) )
+	{
+		StreamPipeline pipeline;
+		bPassed = OpenStreamPipeline( &pipeline, &desc, GPU_CHECK_STREAM_INPUT_PATH, GPU_CHECK_STREAM_OUTPUT_PATH );
+		if( bPassed )
+		{
+			bPassed = RunStreamPipeline( &pipeline );
+			CloseStreamPipeline( &pipeline );
+			bPassed &= !pipeline.bFailed;
+		}
+		DestroyStreamContext( &stream );
+	}
+	else
+	{
+		bPassed = false;
+	}
+	//every chunk was drained or DestroyStreamContext() waited for what a failed run left in flight
+	for( u32 dwSlot = 0; dwSlot < GPU_CHECK_STREAM_DEPTH; ++dwSlot )
+	{
+		if( ppReadbacks[dwSlot] )
+		{
+			ppReadbacks[dwSlot]->Release();
+		}
+	}
+	if( dwReadbackResidency != RESIDENCY_NONE )
+	{
+		ResidencyUntrackHeap( &residencyManager, dwReadbackResidency );
+	}
+	if( pStreamReadbackHeap )
+	{
+		pStreamReadbackHeap->Release();
+	}
+	remove( GPU_CHECK_STREAM_INPUT_PATH );
+	if( !bPassed )
+	{
+		logError( "Failed to run the stream check!\n" );
+		remove( GPU_CHECK_STREAM_OUTPUT_PATH );
+		return false;
+	}
+	CompareStreamCheck( pChecks, streamingFenceValue );
+	return true;
 }
 
 inline
-void QuatfNormalize( Quatf *a, Quatf *out )
+GpuChecks *InitGpuChecks()
 {
-
-	f32 mag = sqrtf((a->w*a->w) + (a->x*a->x) + (a->y*a->y) + (a->z*a->z));
-	if(mag == 0.f)
+	GpuChecks *pChecks = new GpuChecks;
+	pChecks->dwBufferCount = 0;
+	pChecks->dwFailedCount = 0;
+	pChecks->pScanInput = NULL;
+	pChecks->pRadixInput = NULL;
+	pChecks->pCullBounds = NULL;
+	pChecks->pRays = NULL;
+	pChecks->pRayBuffer = NULL;
+	pChecks->pHitBuffer = NULL;
+	pChecks->pStreamInput = NULL;
+	if( FAILED( device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &pChecks->computeCommandAllocator ) ) ) )
 	{
-		out->w = 0.f;
-		out->x = 0.f;
-		out->y = 0.f;
-		out->z = 0.f;
+		delete pChecks;
+		return NULL;
 	}
-	else
+	if( !InitCpuComputeDevice( &pChecks->cpuDevice, 0 ) )
 	{
-		out->w = a->w/mag;
-		out->x = a->x/mag;
-		out->y = a->y/mag;
-		out->z = a->z/mag;
+		pChecks->computeCommandAllocator->Release();
+		delete pChecks;
+		return NULL;
 	}
+	return pChecks;
 }
 
-//todo simplify to reduce floating point error
+//records and submits every check and starts its compare job, false when a check could not be run
+//the results are only known once DestroyMainFenceTimeline() returned
 inline
-void InitViewMat4ByQuatf( Mat4f *a_pMat, Quatf *a_qRot, Vec3f *a_pPos )
+bool RunGpuChecks( GpuChecks *pChecks, u32 dwGPUNumber, u32 dwVisibleGPUMask )
 {
-	a_pMat->m[0][0] = 1.0f - 2.0f*(a_qRot->y*a_qRot->y + a_qRot->z*a_qRot->z);                            a_pMat->m[0][1] = 2.0f*(a_qRot->x*a_qRot->y - a_qRot->w*a_qRot->z);                                   a_pMat->m[0][2] = 2.0f*(a_qRot->x*a_qRot->z + a_qRot->w*a_qRot->y);        		                      a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 2.0f*(a_qRot->x*a_qRot->y + a_qRot->w*a_qRot->z);                                   a_pMat->m[1][1] = 1.0f - 2.0f*(a_qRot->x*a_qRot->x + a_qRot->z*a_qRot->z);                            a_pMat->m[1][2] = 2.0f*(a_qRot->y*a_qRot->z - a_qRot->w*a_qRot->x);        		                      a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 2.0f*(a_qRot->x*a_qRot->z - a_qRot->w*a_qRot->y);                                   a_pMat->m[2][1] = 2.0f*(a_qRot->y*a_qRot->z + a_qRot->w*a_qRot->x);                                   a_pMat->m[2][2] = 1.0f - 2.0f*(a_qRot->x*a_qRot->x + a_qRot->y*a_qRot->y); 		                      a_pMat->m[2][3] = 0;
-	a_pMat->m[3][0] = -a_pPos->x*a_pMat->m[0][0] - a_pPos->y*a_pMat->m[1][0] - a_pPos->z*a_pMat->m[2][0]; a_pMat->m[3][1] = -a_pPos->x*a_pMat->m[0][1] - a_pPos->y*a_pMat->m[1][1] - a_pPos->z*a_pMat->m[2][1]; a_pMat->m[3][2] = -a_pPos->x*a_pMat->m[0][2] - a_pPos->y*a_pMat->m[1][2] - a_pPos->z*a_pMat->m[2][2]; a_pMat->m[3][3] = 1;
+	return RunScanCheck( pChecks, dwGPUNumber ) &&
+		   RunRadixSortCheck( pChecks, dwGPUNumber ) &&
+		   RunCullCheck( pChecks, dwGPUNumber ) &&
+		   RunBvhCheck( pChecks, dwGPUNumber, dwVisibleGPUMask ) &&
+		   RunRayQueryCheck( pChecks, dwGPUNumber ) &&
+		   RunStreamCheck( pChecks, dwGPUNumber, dwVisibleGPUMask );
 }
 
+//call after DestroyMainFenceTimeline() and after the spans handed out before the checks were released, the check spans
+//are released with everything the streaming queue copied, returns false when a check failed
 inline
-void InitModelMat4ByQuatf( Mat4f *a_pMat, Quatf *a_qRot, Vec3f *a_pPos )
+bool DestroyGpuChecks( GpuChecks *pChecks )
 {
-	a_pMat->m[0][0] = 1.0f - 2.0f*(a_qRot->y*a_qRot->y + a_qRot->z*a_qRot->z);                            a_pMat->m[0][1] = 2.0f*(a_qRot->x*a_qRot->y + a_qRot->w*a_qRot->z);                                   a_pMat->m[0][2] = 2.0f*(a_qRot->x*a_qRot->z - a_qRot->w*a_qRot->y);        		                      a_pMat->m[0][3] = 0;
-	a_pMat->m[1][0] = 2.0f*(a_qRot->x*a_qRot->y - a_qRot->w*a_qRot->z);                                   a_pMat->m[1][1] = 1.0f - 2.0f*(a_qRot->x*a_qRot->x + a_qRot->z*a_qRot->z);                            a_pMat->m[1][2] = 2.0f*(a_qRot->y*a_qRot->z + a_qRot->w*a_qRot->x);        		                      a_pMat->m[1][3] = 0;
-	a_pMat->m[2][0] = 2.0f*(a_qRot->x*a_qRot->z + a_qRot->w*a_qRot->y);                                   a_pMat->m[2][1] = 2.0f*(a_qRot->y*a_qRot->z - a_qRot->w*a_qRot->x);                                   a_pMat->m[2][2] = 1.0f - 2.0f*(a_qRot->x*a_qRot->x + a_qRot->y*a_qRot->y); 		                      a_pMat->m[2][3] = 0;
-	//a_pMat->m[3][0] = a_pPos->x*a_pMat->m[0][0] + a_pPos->y*a_pMat->m[1][0] + a_pPos->z*a_pMat->m[2][0];  a_pMat->m[3][1] = a_pPos->x*a_pMat->m[0][1] + a_pPos->y*a_pMat->m[1][1] + a_pPos->z*a_pMat->m[2][1]; a_pMat->m[3][2] = a_pPos->x*a_pMat->m[0][2] + a_pPos->y*a_pMat->m[1][2] + a_pPos->z*a_pMat->m[2][2]; a_pMat->m[3][3] = 1;
-	a_pMat->m[3][0] = a_pPos->x;  a_pMat->m[3][1] = a_pPos->y; a_pMat->m[3][2] = a_pPos->z; a_pMat->m[3][3] = 1.f;
+	if( !pChecks )
+	{
+		return false;
+	}
+	//a check that could not be run can still have copies in flight without a job waiting for them
+	WaitForFenceValue( computeFence, computeFenceEvent, computeFenceValue, COMPUTE_QUEUE_NAME );
+	WaitForFenceValue( streamingFence, streamingFenceEvent, streamingFenceValue, STREAMING_QUEUE_NAME );
+	ReadbackArenaRelease( &readbackArena, streamingFenceValue );
+	for( u32 dwBuffer = 0; dwBuffer < pChecks->dwBufferCount; ++dwBuffer )
+	{
+		pChecks->buffers[dwBuffer].pResource->Release();
+		HeapFree( &computeOutputHeapAllocator, &pChecks->buffers[dwBuffer].allocation );
+	}
+	DestroyRayQueryGraph();
+	pChecks->computeCommandAllocator->Release();
+	DestroyCpuComputeDevice( &pChecks->cpuDevice );
+	free( pChecks->pScanInput );
+	free( pChecks->pRadixInput );
+	free( pChecks->pCullBounds );
+	free( pChecks->pRays );
+	free( pChecks->pStreamInput );
+	const bool bPassed = pChecks->dwFailedCount == 0;
+	delete pChecks;
+	return bPassed;
 }
+#endif
 
-inline
-void QuatfNormLerp( Quatf *a, Quatf *b, f32 fT, Quatf *out )
-{
-	Quatf qTmp;
-	QuatfSub(b,a,&qTmp);
-	QuatfScaleAdd(&qTmp,fT,a,out);
-	QuatfNormalize(out,out);
-}
+#if MEASURE_COMPUTE_RATE
+#define COMPUTE_RATE_DISPATCHES 4096
+#define COMPUTE_RATE_DEADLINE_NS 500000
 
+//sustained dispatch + readback rate for every ring depth, 1 in flight is the old lockstep behaviour
 inline
-void QuatfSlerp( Vec3f *a, Vec3f *b, f32 fT, Vec3f *out )
-{
-	//todo
-}
-
-#if MAIN_DEBUG
-void PrintMat4f( Mat4f *a_pMat )
+void MeasureComputeDispatchRate()
 {
-	for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+	ComputeShaderCB *pCBs = (ComputeShaderCB*)malloc( COMPUTE_RATE_DISPATCHES * sizeof(ComputeShaderCB) );
+	for( u32 dwDispatch = 0; dwDispatch < COMPUTE_RATE_DISPATCHES; ++dwDispatch )
 	{
-		for( u32 dwJdx = 0; dwJdx < 4; ++dwJdx )
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
 		{
-			printf("%f ", a_pMat->m[dwIdx][dwJdx] );
+			pCBs[dwDispatch].dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
 		}
-		printf("\n");
 	}
+	for( u32 dwInFlight = 1; dwInFlight <= MAX_INFLIGHT_COMPUTE; ++dwInFlight )
+	{
+		u64 qwStart = GetTimeNs();
+		ModelOutSpan results;
+		bool bRan = RunComputeDispatches( pCBs, COMPUTE_RATE_DISPATCHES, dwInFlight, &results );
+		if( bRan )
+		{
+			WaitForModelOutSpan( &results );
+		}
+		u64 qwNs = GetTimeNs() - qwStart;
+		bool bMatch = bRan;
+		for( u32 dwDispatch = 0; bMatch && dwDispatch < COMPUTE_RATE_DISPATCHES; ++dwDispatch )
+		{
+			bMatch = results.pResults[dwDispatch].dwData[0] == 2 * pCBs[dwDispatch].dwOffsetsAndStrides0[0];
+		}
+		if( bRan )
+		{
+			ReleaseModelOutSpan( &results );
+		}
+		printf( "%u in flight: %.0f dispatches/s, %.1f us each%s\n", dwInFlight, COMPUTE_RATE_DISPATCHES / ( qwNs / 1e9 ), qwNs / 1e3 / COMPUTE_RATE_DISPATCHES, bMatch ? "" : " (readback mismatch!)" );
+	}
+	free( pCBs );
 }
-#endif
-
-f32 clamp(f32 d, f32 min, f32 max) {
-  const f32 t = d < min ? min : d;
-  return t > max ? max : t;
-}
-
-u32 max( u32 a, u32 b )
-{
-	return a > b ? a : b;
-}
-
-//TODO CHANGE TO A POPUP AND FILE LOG
-int logWindowsError(const char* msg)
-{
-#if MAIN_DEBUG
-    LPVOID lpMsgBuf;
-    DWORD dw = GetLastError();
-
-    FormatMessage( FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-        NULL, dw, MAKELANGID( LANG_NEUTRAL, SUBLANG_DEFAULT ), (LPTSTR)&lpMsgBuf, 0, NULL );
-    OutputDebugStringA( msg );
-    OutputDebugStringA( (LPCTSTR)lpMsgBuf );
-
-    LocalFree( lpMsgBuf );
-    //MessageBoxW(NULL, L"Error creating DXGI factory", L"Error", MB_OK | MB_ICONERROR);
-#endif
-    return -1;
-}
-
-int logError(const char* msg)
-{
-#if MAIN_DEBUG
-	MessageBoxA(NULL, msg, "Error", MB_OK | MB_ICONERROR);
-#endif
-    return -1;
-}
-
-#if MAIN_DEBUG
-inline
-bool EnableDebugLayer()
-{
-    // Always enable the debug layer before doing anything DX12 related
-    // so all possible errors generated while creating DX12 objects
-    // are caught by the debug layer.
-    if ( FAILED( D3D12GetDebugInterface( IID_PPV_ARGS( &debugInterface ) ) ) )
-    {
-    	logError( "Error creating DirectX12 Debug layer\n" );  
-        return false;
-    }
-    debugInterface->EnableDebugLayer();
-    return true;
-}
-
-inline
-void ReportLiveObjects()
-{
-    IDXGIDebug1* dxgiDebug;
-    DXGIGetDebugInterface1(0, IID_PPV_ARGS(&dxgiDebug));
-
-    dxgiDebug->ReportLiveObjects(DXGI_DEBUG_ALL, DXGI_DEBUG_RLO_IGNORE_INTERNAL);
-    dxgiDebug->Release();
-}
-#endif
 
+//the same dispatches without readback, packed into lists of up to dwMaxBatch by the submission batcher
 inline
-ID3D12CommandQueue *InitCopyCommandQueue( ID3D12Device2* dxd3Device, u32 dwGPUNumber )
+void MeasureBatchedSubmissionRate()
 {
-	ID3D12CommandQueue *cq;
-	D3D12_COMMAND_QUEUE_DESC cqDesc;
-    cqDesc.Type =     D3D12_COMMAND_LIST_TYPE_COPY;
-    cqDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
-    cqDesc.Flags =    D3D12_COMMAND_QUEUE_FLAG_NONE;
-    cqDesc.NodeMask = dwGPUNumber;
-
-    if( FAILED( dxd3Device->CreateCommandQueue( &cqDesc, IID_PPV_ARGS( &cq ) ) ) )
+	SubmissionBatcher *pBatcher = (SubmissionBatcher*)malloc( sizeof(SubmissionBatcher) );
+	for( u32 dwMaxBatch = 1; dwMaxBatch <= SUBMISSION_BATCHER_MAX_JOBS; dwMaxBatch *= 4 )
 	{
-		return NULL;
+		InitSubmissionBatcher( pBatcher, dwMaxBatch, COMPUTE_RATE_DEADLINE_NS, RecordComputeBatch, &computeBatchRecorder );
+		u64 qwStart = GetTimeNs();
+		for( u32 dwDispatch = 0; dwDispatch < COMPUTE_RATE_DISPATCHES; ++dwDispatch )
+		{
+			SubmissionJob job;
+			for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+			{
+				job.constants.dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
+			}
+			job.pSrv = &modelBufferState;
+			job.pUav = &computeSlots[dwDispatch % NUM_INFLIGHT_COMPUTE].computeOutputState;
+			job.dwGroupCount = 1;
+			SubmissionBatcherEnqueue( pBatcher, &job, GetTimeNs() );
+		}
+		SubmissionBatcherFlush( pBatcher, GetTimeNs() );
+		WaitForFenceValue( computeFence, computeFenceEvent, SubmissionBatcherFenceValue( pBatcher, COMPUTE_RATE_DISPATCHES ), COMPUTE_QUEUE_NAME );
+		u64 qwNs = GetTimeNs() - qwStart;
+		printf( "batches of %u: %.0f dispatches/s, %llu submits\n", dwMaxBatch, COMPUTE_RATE_DISPATCHES / ( qwNs / 1e9 ), (unsigned long long)pBatcher->qwBatchCount );
 	}
-	return cq;
+	free( pBatcher );
 }
 
+//the same dispatches recorded by 1..COMPUTE_RECORD_WORKERS threads, COMPUTE_RATE_SUBMITS submissions per run
+#define COMPUTE_RATE_SUBMITS 16
 inline
-ID3D12CommandQueue *InitComputeCommandQueue( ID3D12Device2* dxd3Device, u32 dwGPUNumber )
+void MeasureParallelRecordingRate( u32 dwGPUNumber )
 {
-	ID3D12CommandQueue *cq;
-	D3D12_COMMAND_QUEUE_DESC cqDesc;
-    cqDesc.Type =     D3D12_COMMAND_LIST_TYPE_COMPUTE;
-    cqDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
-    cqDesc.Flags =    D3D12_COMMAND_QUEUE_FLAG_NONE;
-    cqDesc.NodeMask = dwGPUNumber;
-
-    if( FAILED( dxd3Device->CreateCommandQueue( &cqDesc, IID_PPV_ARGS( &cq ) ) ) )
+	ComputeShaderCB *pCBs = (ComputeShaderCB*)malloc( COMPUTE_RATE_DISPATCHES * sizeof(ComputeShaderCB) );
+	for( u32 dwDispatch = 0; dwDispatch < COMPUTE_RATE_DISPATCHES; ++dwDispatch )
 	{
-		return NULL;
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			pCBs[dwDispatch].dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
+		}
 	}
-	return cq;
+	const u32 dwDispatchesPerSubmit = COMPUTE_RATE_DISPATCHES / COMPUTE_RATE_SUBMITS;
+	for( u32 dwWorkers = 1; dwWorkers <= COMPUTE_RECORD_WORKERS; dwWorkers *= 2 )
+	{
+		ComputeParallelRecorder *pParallel = CreateComputeParallelRecorder( dwWorkers, dwGPUNumber );
+		if( !pParallel )
+		{
+			break;
+		}
+		u64 qwStart = GetTimeNs();
+		u64 qwFenceValue = 0;
+		for( u32 dwSubmit = 0; dwSubmit < COMPUTE_RATE_SUBMITS; ++dwSubmit )
+		{
+			qwFenceValue = ComputeParallelSubmit( pParallel, &pCBs[dwSubmit * dwDispatchesPerSubmit], dwDispatchesPerSubmit );
+		}
+		WaitForFenceValue( computeFence, computeFenceEvent, qwFenceValue, COMPUTE_QUEUE_NAME );
+		u64 qwNs = GetTimeNs() - qwStart;
+		printf( "%u recording threads: %.0f dispatches/s, %u pool waits\n", dwWorkers, COMPUTE_RATE_DISPATCHES / ( qwNs / 1e9 ), pParallel->recorder.dwFenceWaits );
+		DestroyComputeParallelRecorder( pParallel );
+	}
+	free( pCBs );
 }
-
-inline
-void UploadModels( u32 dwGPUNumber, u32 dwVisibleGPUMask )
-{
-	f32 planeVertices[] =
-	{
-	        // positions              // vertex norms    // vertex colors
-	         1000.0f,  -1.0f,  1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	        -1000.0f,  -1.0f,  1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	         1000.0f,  -1.0f, -1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	        -1000.0f,  -1.0f, -1000.0f, 0.0f,  1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	         1000.0f,  -1.0f,  1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	        -1000.0f,  -1.0f,  1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	         1000.0f,  -1.0f, -1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f,
-	        -1000.0f,  -1.0f, -1000.0f, 0.0f, -1.0f, 0.0f, 0.5882f, 0.2941f, 0.0f, 1.0f
-	};
-	
-	u32 planeIndices[] = 
-	{
-	        0, 1, 2,
-	        2, 1, 3,
-	        4, 6, 5,
-	        6, 7, 5
-	};
-	planeIndexCount = 12;
-	
-	f32 cubeVertices[] = {
-	    // positions          // vertex norms     //vertex colors
-	    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	
-	    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	
-	    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	
-	     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	
-	    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	
-	    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-	    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, 0.0f, 1.0f
-	};
-	
-	u32 cubeIndicies[] =
-	{
-	     0,  1,  2, //back
-	     3,  4,  5,
-	
-	     6,  7,  8,
-	     9, 10, 11,
-	
-	    12, 13, 14,
-	    15, 16, 17,
-	
-	    18, 20, 19,
-	    21, 23, 22,
-	
-	    24, 25, 26, //bottom
-	    27, 28, 29,
-	
-	    30, 31, 32, //top
-	    33, 34, 35
-	};
-	cubeIndexCount = 36;
-
-
-	const u64 qwModelSize = sizeof(planeVertices) + sizeof(planeIndices) + sizeof(cubeVertices) + sizeof(cubeIndicies);
-
-	D3D12_RESOURCE_DESC resourceBufferDesc; //describes what is placed in heap
-  	resourceBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-  	resourceBufferDesc.Alignment = 0;
-  	resourceBufferDesc.Width = qwModelSize;
-  	resourceBufferDesc.Height = 1;
-  	resourceBufferDesc.DepthOrArraySize = 1;
-  	resourceBufferDesc.MipLevels = 1;
-  	resourceBufferDesc.Format = DXGI_FORMAT_UNKNOWN;
-  	resourceBufferDesc.SampleDesc.Count = 1;
-  	resourceBufferDesc.SampleDesc.Quality = 0;
-  	resourceBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-  	resourceBufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE; //D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE
-
-	D3D12_RESOURCE_ALLOCATION_INFO allocInfo = device->GetResourceAllocationInfo( dwVisibleGPUMask, 1, &resourceBufferDesc );
-	u64 qwNumFullAlignments = qwModelSize / allocInfo.Alignment;
-	const u64 qwAlignedModelSize = (qwNumFullAlignments * allocInfo.Alignment) + ((qwModelSize % allocInfo.Alignment) > 0 ? allocInfo.Alignment : 0);
-	const u64 qwHeapSize = qwAlignedModelSize;
-
-	//https://zhangdoa.com/posts/walking-through-the-heap-properties-in-directx-12
-	//https://asawicki.info/news_1726_secrets_of_direct3d_12_resource_alignment
-	//https://docs.microsoft.com/en-us/windows/win32/api/d3d12/ne-d3d12-d3d12_resource_heap_tier#D3D12_RESOURCE_HEAP_TIER_1
-	// we only allow buffers to stay within the first tier heap tier
-	D3D12_HEAP_DESC modelHeapDesc;
-	modelHeapDesc.SizeInBytes = qwHeapSize;
-	modelHeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
-	modelHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	modelHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	modelHeapDesc.Properties.CreationNodeMask = dwGPUNumber;
-	modelHeapDesc.Properties.VisibleNodeMask = dwVisibleGPUMask;
-	modelHeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT; //64KB heap alignment, SizeInBytes should be a multiple of the heap alignment. is 64KB here 65536
-	modelHeapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS | D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
-
-	device->CreateHeap( &modelHeapDesc, IID_PPV_ARGS(&pModelDefaultHeap) );
-#if MAIN_DEBUG
-	pModelDefaultHeap->SetName( L"Model Buffer Default Resource Heap" );
-#endif
-
-	modelHeapDesc.Properties.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-	device->CreateHeap( &modelHeapDesc, IID_PPV_ARGS(&pModelUploadHeap) );
-#if MAIN_DEBUG
-	pModelUploadHeap->SetName( L"Model Buffer Upload Resource Heap" );
 #endif
 
-  	//verify that we are using the advanced model!
-	device->CreatePlacedResource( pModelUploadHeap, 0, &resourceBufferDesc,D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadBuffer) );
-	device->CreatePlacedResource( pModelDefaultHeap, 0, &resourceBufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&defaultBuffer) );
-
-    //upload to upload heap (TODO is there a penalty from crossing a buffer alignment boundary with mesh data?)
-    //TODO is there a penatly for not having meshes at an alignment or their own resouce?
-    u8* pUploadBufferData;
-    if( FAILED( uploadBuffer->Map( 0, nullptr, (void**) &pUploadBufferData ) ) )
-    {
-        return;
-    }
-    memcpy(pUploadBufferData,planeVertices,sizeof(planeVertices));
-    memcpy(pUploadBufferData+sizeof(planeVertices),planeIndices,sizeof(planeIndices));
-    memcpy(pUploadBufferData+sizeof(planeVertices)+sizeof(planeIndices),cubeVertices,sizeof(cubeVertices));
-    memcpy(pUploadBufferData+sizeof(planeVertices)+sizeof(planeIndices)+sizeof(cubeVertices),cubeIndicies,sizeof(cubeIndicies));
-    uploadBuffer->Unmap( 0, nullptr );
-
-	streamingCommandList->CopyResource( defaultBuffer, uploadBuffer );
-
-    //does this apply in my case https://twitter.com/MyNameIsMJP/status/1574431011579928580 ?
-    planeVertexBufferView.BufferLocation = defaultBuffer->GetGPUVirtualAddress();
-    planeVertexBufferView.StrideInBytes = 3*sizeof(f32) + 3*sizeof(f32) + 4*sizeof(f32); //size of s single vertex
-    planeVertexBufferView.SizeInBytes = sizeof(planeVertices);
-
-	planeIndexBufferView.BufferLocation = planeVertexBufferView.BufferLocation + sizeof(planeVertices);
-    planeIndexBufferView.SizeInBytes = sizeof(planeIndices);
-    planeIndexBufferView.Format = DXGI_FORMAT_R32_UINT; 
-
-    cubeVertexBufferView.BufferLocation = planeIndexBufferView.BufferLocation+sizeof(planeIndices);
-    cubeVertexBufferView.StrideInBytes = 3*sizeof(f32) + 3*sizeof(f32) + 4*sizeof(f32); //size of s single vertex
-    cubeVertexBufferView.SizeInBytes = sizeof(cubeVertices);
-
-	cubeIndexBufferView.BufferLocation = cubeVertexBufferView.BufferLocation+sizeof(cubeVertices);
-    cubeIndexBufferView.SizeInBytes = sizeof(cubeIndicies);
-    cubeIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
-}
-
 inline
 bool InitDirectX12()
 {
@@ -1056,7 +2922,17 @@ bool InitDirectX12()
 		adapter3->Release();
 		return false;
 	}
+	//the release path above only has an IDXGIAdapter1, QueryInterface() works on either
+	if( FAILED( adapter3->QueryInterface( IID_PPV_ARGS( &videoMemoryAdapter ) ) ) )
+	{
+		videoMemoryAdapter = nullptr; //budgets are then only the configured limits
+	}
 	adapter3->Release();
+	InitResidency();
+#if MAIN_DEBUG
+	printf( "Video memory budget: %llu MB local, %llu MB non local\n", ResidencyBudget( &residencyManager, RESIDENCY_SEGMENT_LOCAL ) >> 20,
+		ResidencyBudget( &residencyManager, RESIDENCY_SEGMENT_NON_LOCAL ) >> 20 );
+#endif
 
 #if MAIN_DEBUG
 	//for getting errors from directx when debugging
@@ -1099,20 +2975,32 @@ bool InitDirectX12()
 #endif
 
 	streamingQueue = InitCopyCommandQueue( device,dwGPUNumber );
-	device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &streamingCommandAllocator[0] ) );
-	device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &streamingCommandAllocator[1] ) );
+	device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &streamingCommandAllocator ) );
 	streamingFenceValue = 0;
 	device->CreateFence( streamingFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS( &streamingFence ) );
 	streamingFenceEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
-	device->CreateCommandList( dwGPUNumber, D3D12_COMMAND_LIST_TYPE_COPY, streamingCommandAllocator[0], NULL, IID_PPV_ARGS( &streamingCommandList ) );
-	UploadModels(dwGPUNumber,dwVisibleGPUMask);
+	device->CreateCommandList( dwGPUNumber, D3D12_COMMAND_LIST_TYPE_COPY, streamingCommandAllocator, NULL, IID_PPV_ARGS( &streamingCommandList ) );
+	if( !InitUploadRingBuffer( dwGPUNumber, dwVisibleGPUMask ) )
+	{
+		logError( "Failed to create the upload ring!\n" );
+		return false;
+	}
+	InitResourceStateTracker( &streamingStateTracker );
+	const u64 qwTraceStart = TraceBegin();
+	if( !UploadModels( dwGPUNumber, dwVisibleGPUMask ) )
+	{
+		logError( "Failed to upload the models!\n" );
+		return false;
+	}
+	ResourceStateTrackerClose( &streamingStateTracker );
 	streamingCommandList->Close();
+	TraceEnd( qwTraceStart, TRACE_KIND_RECORD, "Record model upload", STREAMING_QUEUE_NAME, 1 );
 	ID3D12CommandList* ppStreamingCommandLists[] = { streamingCommandList };
-    streamingQueue->ExecuteCommandLists( _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
-	streamingQueue->Signal( streamingFence, ++streamingFenceValue );
+    ExecuteCommandListsTraced( streamingQueue, STREAMING_QUEUE_NAME, _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
+	SignalTraced( streamingQueue, STREAMING_QUEUE_NAME, streamingFence, ++streamingFenceValue );
+	UploadRingSubmit( &uploadRing, streamingFenceValue );
 	computeFenceValue = 0;
 	device->CreateFence( computeFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS( &computeFence ) );
-	streamingQueue->Wait( computeFence, 1 );
 
 	const u64 qwComputeOutputDataSize = sizeof(ModelOutData);
 
@@ -1130,13 +3018,9 @@ bool InitDirectX12()
   	computeOutputRsrcBufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS; //D3D12_RESOURCE_FLAG_NONE 
 
 	D3D12_RESOURCE_ALLOCATION_INFO computeAllocInfo = device->GetResourceAllocationInfo( dwVisibleGPUMask, 1, &computeOutputRsrcBufferDesc );
-	u64 qwNumFullAlignments = qwComputeOutputDataSize / computeAllocInfo.Alignment;
-	u64 qwExtraAlloc = qwComputeOutputDataSize % computeAllocInfo.Alignment;
-	const u64 qwAlignedComputeOutputSize = (qwNumFullAlignments * computeAllocInfo.Alignment) + (qwExtraAlloc > 0 ? computeAllocInfo.Alignment : 0);
-	const u64 qwComputeOutputHeapSize = qwAlignedComputeOutputSize * 2;
 
 	D3D12_HEAP_DESC computeOutputHeapDesc;
-	computeOutputHeapDesc.SizeInBytes = qwComputeOutputHeapSize;
+	computeOutputHeapDesc.SizeInBytes = COMPUTE_HEAP_SIZE;
 	computeOutputHeapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
 	computeOutputHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
 	computeOutputHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
@@ -1149,16 +3033,28 @@ bool InitDirectX12()
 #if MAIN_DEBUG
 	pComputeOutputHeap->SetName( L"Compute Output Resource Heap" );
 #endif
-	device->CreatePlacedResource( pComputeOutputHeap,                          0, &computeOutputRsrcBufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&computeOutputBuffer[0]) );
-	device->CreatePlacedResource( pComputeOutputHeap, qwAlignedComputeOutputSize, &computeOutputRsrcBufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&computeOutputBuffer[1]) );
-
+	dwComputeOutputHeapResidency = ResidencyTrackHeap( &residencyManager, pComputeOutputHeap, COMPUTE_HEAP_SIZE, RESIDENCY_SEGMENT_LOCAL, "Compute Output Heap", false );
+	if( !InitHeapAllocator( &computeOutputHeapAllocator, COMPUTE_HEAP_SIZE, COMPUTE_HEAP_MAX_BLOCKS ) )
+	{
+		return false;
+	}
+	for( u32 dwSlot = 0; dwSlot < MAX_INFLIGHT_COMPUTE; ++dwSlot )
+	{
+		ComputeSlot *pSlot = &computeSlots[dwSlot];
+		if( !HeapAlloc( &computeOutputHeapAllocator, computeAllocInfo.SizeInBytes, computeAllocInfo.Alignment, &pSlot->computeOutputAllocation ) )
+		{
+			logError( "Failed to suballocate the compute output heap!\n" );
+			return false;
+		}
+		device->CreatePlacedResource( pComputeOutputHeap, pSlot->computeOutputAllocation.qwOffset, &computeOutputRsrcBufferDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&pSlot->computeOutputBuffer) );
+		InitTrackedResource( &pSlot->computeOutputState, pSlot->computeOutputBuffer, TRACKED_STATE_UNORDERED_ACCESS, true );
+	}
 
-	const u64 qwReadbackDataSize = sizeof(ModelOutData);
 
 	D3D12_RESOURCE_DESC readbackRsrcBufferDesc; //describes what is placed in heap
   	readbackRsrcBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
   	readbackRsrcBufferDesc.Alignment = 0;
-  	readbackRsrcBufferDesc.Width = qwReadbackDataSize;
+  	readbackRsrcBufferDesc.Width = READBACK_ARENA_SIZE;
   	readbackRsrcBufferDesc.Height = 1;
   	readbackRsrcBufferDesc.DepthOrArraySize = 1;
   	readbackRsrcBufferDesc.MipLevels = 1;
@@ -1168,14 +3064,8 @@ bool InitDirectX12()
   	readbackRsrcBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
   	readbackRsrcBufferDesc.Flags = D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE; //D3D12_RESOURCE_FLAG_NONE 
 
-	D3D12_RESOURCE_ALLOCATION_INFO allocInfo = device->GetResourceAllocationInfo( dwVisibleGPUMask, 1, &readbackRsrcBufferDesc );
-	qwNumFullAlignments = qwReadbackDataSize / allocInfo.Alignment;
-	qwExtraAlloc = qwReadbackDataSize % allocInfo.Alignment;
-	const u64 qwAlignedReadbackSize = (qwNumFullAlignments * allocInfo.Alignment) + (qwExtraAlloc > 0 ? allocInfo.Alignment : 0);
-	const u64 qwReadbackHeapSize = qwAlignedReadbackSize * 2;
-
 	D3D12_HEAP_DESC readbackHeapDesc;
-	readbackHeapDesc.SizeInBytes = qwReadbackHeapSize;
+	readbackHeapDesc.SizeInBytes = READBACK_ARENA_SIZE;
 	readbackHeapDesc.Properties.Type = D3D12_HEAP_TYPE_READBACK;
 	readbackHeapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
 	readbackHeapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
@@ -1188,23 +3078,24 @@ bool InitDirectX12()
 #if MAIN_DEBUG
 	pReadbackHeap->SetName( L"Readback Resource Heap" );
 #endif
-	device->CreatePlacedResource( pReadbackHeap,                     0, &readbackRsrcBufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readbackBuffer[0]) );
-	device->CreatePlacedResource( pReadbackHeap, qwAlignedReadbackSize, &readbackRsrcBufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readbackBuffer[1]) );
-
-    streamingCommandList->Reset(streamingCommandAllocator[1],NULL);
-	streamingCommandList->CopyResource(readbackBuffer[0],computeOutputBuffer[0]);
-	D3D12_RESOURCE_BARRIER readbackTransferToReadbackReadBarrier; //TODO does the readback buffer need to be in the source state to map and readback?
-    readbackTransferToReadbackReadBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    readbackTransferToReadbackReadBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    readbackTransferToReadbackReadBarrier.Transition.pResource = readbackBuffer[0];
-   	readbackTransferToReadbackReadBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    readbackTransferToReadbackReadBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-    readbackTransferToReadbackReadBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
-    streamingCommandList->ResourceBarrier( 1, &readbackTransferToReadbackReadBarrier );
-    streamingCommandList->Close();
-	streamingQueue->ExecuteCommandLists( _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
-    streamingQueue->Signal( streamingFence, ++streamingFenceValue );
-
+	//persistently mapped, never evicted
+	dwReadbackHeapResidency = ResidencyTrackHeap( &residencyManager, pReadbackHeap, READBACK_ARENA_SIZE, RESIDENCY_SEGMENT_NON_LOCAL, "Readback Heap", true );
+	device->CreatePlacedResource( pReadbackHeap, 0, &readbackRsrcBufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&readbackArenaBuffer) );
+	InitTrackedResource( &readbackArenaState, readbackArenaBuffer, TRACKED_STATE_COPY_DEST, true );
+	//readback resources can stay mapped while the gpu copies into them, the fence wait before reading is all the sync needed
+	u8 *pReadbackArenaData;
+	if( FAILED( readbackArenaBuffer->Map( 0, nullptr, (void**)&pReadbackArenaData ) ) )
+	{
+		logError( "Failed to map the readback arena!\n" );
+		return false;
+	}
+	InitReadbackArena( &readbackArena, pReadbackArenaData, READBACK_ARENA_SIZE );
+	for( u32 dwSlot = 0; dwSlot < MAX_INFLIGHT_COMPUTE; ++dwSlot )
+	{
+		ComputeSlot *pSlot = &computeSlots[dwSlot];
+		device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS( &pSlot->streamingCommandAllocator ) );
+		pSlot->qwReadbackFenceValue = 0;
+	}
 
 	if( FAILED( device->CreateRootSignature(dwGPUNumber, computeShaderBlob, sizeof(computeShaderBlob), IID_PPV_ARGS( &computeRootSignature ) ) ) )
 	{
@@ -1222,119 +3113,72 @@ bool InitDirectX12()
 	computePipelineStateDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 
 	device->CreateComputePipelineState ( &computePipelineStateDesc, IID_PPV_ARGS( &computePipelineStateObject ) );
+	//the scan, radix sort, culling, bvh and ray query pipelines are created by whoever records them first (RunGpuChecks())
 
 
     //Create Compute pipeline
 	computeQueue = InitComputeCommandQueue( device, dwGPUNumber );
-	computeQueue->Wait( streamingFence, 1 ); 
-	device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &computeCommandAllocator[0] ) );
-	device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &computeCommandAllocator[1] ) );
+	QueueWaitTraced( computeQueue, COMPUTE_QUEUE_NAME, streamingFence, 1 );
+	for( u32 dwSlot = 0; dwSlot < MAX_INFLIGHT_COMPUTE; ++dwSlot )
+	{
+		device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS( &computeSlots[dwSlot].computeCommandAllocator ) );
+	}
 	computeFenceEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
-	device->CreateCommandList( dwGPUNumber, D3D12_COMMAND_LIST_TYPE_COMPUTE , computeCommandAllocator[0], computePipelineStateObject, IID_PPV_ARGS( &computeCommandList ) );
-	
-
-	D3D12_RESOURCE_BARRIER defaultHeapUploadToReadBarrier;
-    defaultHeapUploadToReadBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    defaultHeapUploadToReadBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    defaultHeapUploadToReadBarrier.Transition.pResource = defaultBuffer;
-   	defaultHeapUploadToReadBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    defaultHeapUploadToReadBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-    defaultHeapUploadToReadBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE; 
-    computeCommandList->ResourceBarrier( 1, &defaultHeapUploadToReadBarrier );
-	ComputeShaderCB cbValue;
-	cbValue.dwOffsetsAndStrides0[0] = 0;
-	cbValue.dwOffsetsAndStrides0[1] = 1;
-	cbValue.dwOffsetsAndStrides0[2] = 2;
-	cbValue.dwOffsetsAndStrides0[3] = 3;
-	computeCommandList->SetComputeRootSignature( computeRootSignature ); //is this set with the pso?
-	computeCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),&cbValue,0);
-	computeCommandList->SetComputeRootShaderResourceView(1,defaultBuffer->GetGPUVirtualAddress());
-	computeCommandList->SetComputeRootUnorderedAccessView(2,computeOutputBuffer[0]->GetGPUVirtualAddress());
-	computeCommandList->Dispatch(1,1,1);
-	D3D12_RESOURCE_BARRIER computeOutputToComputeReadBarrier;
-    computeOutputToComputeReadBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    computeOutputToComputeReadBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    computeOutputToComputeReadBarrier.Transition.pResource = computeOutputBuffer[0];
-   	computeOutputToComputeReadBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    computeOutputToComputeReadBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-    computeOutputToComputeReadBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-    computeCommandList->ResourceBarrier( 1, &computeOutputToComputeReadBarrier );
-    computeCommandList->Close();
-
-    ID3D12CommandList* ppComputeCommandLists[] = { computeCommandList };
-	computeQueue->ExecuteCommandLists( _countof( ppComputeCommandLists ), ppComputeCommandLists );
-	//Stick at the end of the queue so we know when Our list will be ready
-	computeQueue->Signal( computeFence, ++computeFenceValue ); 
-
-	//this could have easly been done within the same command list execute as above but then we lose out on the signal, to start the rightback copies early. what is more efficent?
-	computeCommandList->Reset(computeCommandAllocator[1],computePipelineStateObject);
-	cbValue.dwOffsetsAndStrides0[0] = 4;
-	cbValue.dwOffsetsAndStrides0[1] = 5;
-	cbValue.dwOffsetsAndStrides0[2] = 6;
-	cbValue.dwOffsetsAndStrides0[3] = 7;
-	computeCommandList->SetComputeRootSignature( computeRootSignature ); 
-	computeCommandList->SetComputeRoot32BitConstants(0,sizeof(ComputeShaderCB)/sizeof(u32),&cbValue,0);
-	computeCommandList->SetComputeRootShaderResourceView(1,defaultBuffer->GetGPUVirtualAddress());
-	computeCommandList->SetComputeRootUnorderedAccessView(2,computeOutputBuffer[1]->GetGPUVirtualAddress());
-	computeCommandList->Dispatch(1,1,1);
-	computeOutputToComputeReadBarrier.Transition.pResource = computeOutputBuffer[1];
-	computeCommandList->ResourceBarrier( 1, &computeOutputToComputeReadBarrier );
-	computeCommandList->Close();
-	computeQueue->ExecuteCommandLists( _countof( ppComputeCommandLists ), ppComputeCommandLists );
-	//Stick at the end of the queue so we know when Our list will be ready
-	computeQueue->Signal( computeFence, ++computeFenceValue ); //we will not wait on the compute queue since the streaming queue will wait on it
-
-	if( streamingFence->GetCompletedValue() < 1 )
-    {
-    	streamingFence->SetEventOnCompletion( 1, streamingFenceEvent );
-		WaitForSingleObject( streamingFenceEvent, INFINITE );
-    }
-
-    streamingCommandList->Reset(streamingCommandAllocator[0],NULL);
-    streamingQueue->Wait( computeFence, 2 );
-	streamingCommandList->CopyResource(readbackBuffer[1],computeOutputBuffer[1]);
-	readbackTransferToReadbackReadBarrier.Transition.pResource = readbackBuffer[1];
-	streamingCommandList->ResourceBarrier( 1, &readbackTransferToReadbackReadBarrier );
-	streamingCommandList->Close();
-	streamingQueue->ExecuteCommandLists( _countof( ppStreamingCommandLists ), ppStreamingCommandLists );
-    streamingQueue->Signal( streamingFence, ++streamingFenceValue );
-
-    //first readback is ready
-    if( streamingFence->GetCompletedValue() < 2 )
-    {
-    	streamingFence->SetEventOnCompletion( 2, streamingFenceEvent );
-		WaitForSingleObject( streamingFenceEvent, INFINITE );
-    }
-
-    ModelOutData readbackData[2];
-    u8* pOutputDataBufferData;
-    if( FAILED( readbackBuffer[0]->Map( 0, nullptr, (void**) &pOutputDataBufferData ) ) )
-    {
-        return false;
-    }
-    memcpy(&readbackData[0],pOutputDataBufferData,sizeof(ModelOutData));
-    D3D12_RANGE emptyRange;
-    emptyRange.Begin = 0;
-    emptyRange.End = 0;
-    readbackBuffer[0]->Unmap( 0, &emptyRange ); //signal we didn't write anything
-
-    //second readback is ready
-    if( streamingFence->GetCompletedValue() < 3 )
-    {
-    	streamingFence->SetEventOnCompletion( 3, streamingFenceEvent );
-		WaitForSingleObject( streamingFenceEvent, INFINITE );
-    }
-
-    if( FAILED( readbackBuffer[1]->Map( 0, nullptr, (void**) &pOutputDataBufferData ) ) )
-    {
-        return false;
-    }
-    memcpy(&readbackData[1],pOutputDataBufferData,sizeof(ModelOutData));
-    readbackBuffer[1]->Unmap( 0, &emptyRange ); //signal we didn't write anything
+	device->CreateCommandList( dwGPUNumber, D3D12_COMMAND_LIST_TYPE_COMPUTE , computeSlots[0].computeCommandAllocator, computePipelineStateObject, IID_PPV_ARGS( &computeCommandList ) );
+	computeCommandList->Close(); //every dispatch resets it with the allocator of its slot
+	InitResourceStateTracker( &computeStateTracker );
+	InitCommandAllocatorPool( &computeBatchRecorder.allocatorPool, COMPUTE_BATCH_ALLOCATORS, CreateComputeCommandAllocator, NULL );
 
-    printf("%u %u %u %u\n%u %u %u %u\n",readbackData[0].dwData[0],readbackData[0].dwData[1],readbackData[0].dwData[2],readbackData[0].dwData[3],
-    									readbackData[1].dwData[0],readbackData[1].dwData[1],readbackData[1].dwData[2],readbackData[1].dwData[3]);
+	ComputeShaderCB cbValues[2];
+	for( u32 dwDispatch = 0; dwDispatch < 2; ++dwDispatch )
+	{
+		for( u32 dwIdx = 0; dwIdx < 4; ++dwIdx )
+		{
+			cbValues[dwDispatch].dwOffsetsAndStrides0[dwIdx] = dwDispatch*4 + dwIdx;
+		}
+	}
+	InitMainFenceTimeline();
+    ModelOutSpan readbackSpan;
+	if( !RunComputeDispatches( cbValues, 2, NUM_INFLIGHT_COMPUTE, &readbackSpan ) )
+	{
+		DestroyMainFenceTimeline();
+		return false;
+	}
+	PrintModelOutSpan( readbackSpan );
+#if MAIN_GPU_CHECKS
+	GpuChecks *pGpuChecks = InitGpuChecks();
+	const bool bGpuChecksRun = pGpuChecks && RunGpuChecks( pGpuChecks, dwGPUNumber, dwVisibleGPUMask );
+#endif
+	DestroyMainFenceTimeline(); //the readback is done and printed and every check compared after this
+#if MAIN_RESULTS
+	ResultSink *pResultSink = (ResultSink*)malloc( sizeof(ResultSink) );
+	bool bResultsWritten = OpenResultSink( pResultSink, RESULTS_PATH, RESULTS_QUEUE_DEPTH );
+	if( bResultsWritten )
+	{
+		ResultSinkRegisterBuffer( pResultSink, readbackArena.ring.pMapped, READBACK_ARENA_SIZE );
+		bResultsWritten = SinkModelOutSpan( pResultSink, &readbackSpan );
+		bResultsWritten &= CloseResultSink( pResultSink ); //written or failed, ReleaseModelOutSpan() below hands the span back either way
+	}
+	free( pResultSink );
+	if( !bResultsWritten )
+	{
+		logError( "Failed to write the results!\n" );
+	}
+#endif
+	ReleaseModelOutSpan( &readbackSpan );
+#if MAIN_GPU_CHECKS
+	if( !DestroyGpuChecks( pGpuChecks ) || !bGpuChecksRun )
+	{
+		logError( "GPU checks failed!\n" );
+		return false;
+	}
+#endif
 
+#if MEASURE_COMPUTE_RATE
+	MeasureComputeDispatchRate();
+	MeasureBatchedSubmissionRate();
+	MeasureParallelRecordingRate( dwGPUNumber );
+#endif
 	return true;
 }
 
@@ -1349,12 +3193,28 @@ int main()
 	}
 #endif
 
+#if MAIN_TRACE
+	TraceSetThreadName( "main" );
+	TraceEnable( true );
+#endif
 
 	if( !InitDirectX12() )
 	{
 		return -1;
 	}
 
+#if MAIN_TRACE
+	const s64 qwTraceEvents = WriteTraceJson( TRACE_PATH, "FPSCameraBasic" );
+	if( qwTraceEvents < 0 )
+	{
+		logError( "Failed to write the trace!\n" );
+	}
+	else
+	{
+		printf( "%lld trace events written to %s\n", (long long)qwTraceEvents, TRACE_PATH );
+	}
+#endif
+
 /*
 
     LARGE_INTEGER PerfCountFrequencyResult;